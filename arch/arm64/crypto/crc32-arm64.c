@@ -38,9 +38,107 @@ MODULE_LICENSE("GPL v2");
 #define CRC32CH(crc, value) __asm__("crc32ch %w[c], %w[c], %w[v]":[c]"+r"(crc):[v]"r"(value))
 #define CRC32CB(crc, value) __asm__("crc32cb %w[c], %w[c], %w[v]":[c]"+r"(crc):[v]"r"(value))
 
+/*
+ * The CRC instructions take several cycles to produce a result but can
+ * issue every cycle, so a single dependent chain leaves most of the unit
+ * idle. Large buffers are therefore split into three equal streams that
+ * are folded in parallel and then combined: advancing a CRC over a fixed
+ * number of zero bytes is linear in the CRC, so it is done through four
+ * byte-indexed tables per stream length, built at init.
+ */
+#define CRC32_STRIDE_LONG	1024
+#define CRC32_STRIDE_SHORT	128
+
+#define CRC32_POLY_LE		0xedb88320
+#define CRC32C_POLY_LE		0x82f63b78
+
+struct crc32_shift_tbl {
+	u32 t[4][256];
+};
+
+/* [0] advances over CRC32_STRIDE_LONG bytes, [1] over CRC32_STRIDE_SHORT */
+static struct crc32_shift_tbl crc32_shift[2], crc32c_shift[2];
+
+static u32 __init crc32_shift_bits(u32 crc, u32 poly, unsigned int bytes)
+{
+	unsigned int i;
+
+	for (i = 0; i < bytes * 8; i++)
+		crc = (crc >> 1) ^ (poly & -(crc & 1));
+	return crc;
+}
+
+static void __init crc32_build_shift(struct crc32_shift_tbl *tbl, u32 poly,
+				     unsigned int bytes)
+{
+	u32 basis[32], v;
+	int i, j, b;
+
+	for (j = 0; j < 32; j++)
+		basis[j] = crc32_shift_bits(1U << j, poly, bytes);
+
+	for (i = 0; i < 4; i++) {
+		for (b = 0; b < 256; b++) {
+			v = 0;
+			for (j = 0; j < 8; j++)
+				if (b & (1 << j))
+					v ^= basis[i * 8 + j];
+			tbl->t[i][b] = v;
+		}
+	}
+}
+
+static inline u32 crc32_shift_apply(const struct crc32_shift_tbl *tbl, u32 crc)
+{
+	return tbl->t[0][crc & 0xff] ^ tbl->t[1][(crc >> 8) & 0xff] ^
+	       tbl->t[2][(crc >> 16) & 0xff] ^ tbl->t[3][crc >> 24];
+}
+
+static __always_inline u32 crc32_3way(u32 crc, const u8 *p,
+				      unsigned int stride,
+				      const struct crc32_shift_tbl *tbl,
+				      bool castagnoli)
+{
+	const u8 *p1 = p + stride;
+	const u8 *p2 = p + 2 * stride;
+	u32 crc1 = 0, crc2 = 0;
+	unsigned int i;
+
+	for (i = 0; i < stride; i += sizeof(u64)) {
+		if (castagnoli) {
+			CRC32CX(crc, get_unaligned_le64(p + i));
+			CRC32CX(crc1, get_unaligned_le64(p1 + i));
+			CRC32CX(crc2, get_unaligned_le64(p2 + i));
+		} else {
+			CRC32X(crc, get_unaligned_le64(p + i));
+			CRC32X(crc1, get_unaligned_le64(p1 + i));
+			CRC32X(crc2, get_unaligned_le64(p2 + i));
+		}
+	}
+
+	/* crc(a|b|c) = shift(shift(crc(a)) ^ crc(b)) ^ crc(c) */
+	crc = crc32_shift_apply(tbl, crc) ^ crc1;
+	return crc32_shift_apply(tbl, crc) ^ crc2;
+}
+
 static u32 crc32_arm64_le_hw(u32 crc, const u8 *p, unsigned int len)
 {
-	s64 length = len;
+	s64 length;
+
+	while (len >= 3 * CRC32_STRIDE_LONG) {
+		crc = crc32_3way(crc, p, CRC32_STRIDE_LONG, &crc32_shift[0],
+				 false);
+		p += 3 * CRC32_STRIDE_LONG;
+		len -= 3 * CRC32_STRIDE_LONG;
+	}
+	while (len >= 3 * CRC32_STRIDE_SHORT) {
+		crc = crc32_3way(crc, p, CRC32_STRIDE_SHORT, &crc32_shift[1],
+				 false);
+		p += 3 * CRC32_STRIDE_SHORT;
+		len -= 3 * CRC32_STRIDE_SHORT;
+	}
+
+	length = len;
 
 	while ((length -= sizeof(u64)) >= 0) {
 		CRC32X(crc, get_unaligned_le64(p));
@@ -64,7 +162,22 @@ static u32 crc32_arm64_le_hw(u32 crc, const u8 *p, unsigned int len)
 
 static u32 crc32c_arm64_le_hw(u32 crc, const u8 *p, unsigned int len)
 {
-	s64 length = len;
+	s64 length;
+
+	while (len >= 3 * CRC32_STRIDE_LONG) {
+		crc = crc32_3way(crc, p, CRC32_STRIDE_LONG, &crc32c_shift[0],
+				 true);
+		p += 3 * CRC32_STRIDE_LONG;
+		len -= 3 * CRC32_STRIDE_LONG;
+	}
+	while (len >= 3 * CRC32_STRIDE_SHORT) {
+		crc = crc32_3way(crc, p, CRC32_STRIDE_SHORT, &crc32c_shift[1],
+				 true);
+		p += 3 * CRC32_STRIDE_SHORT;
+		len -= 3 * CRC32_STRIDE_SHORT;
+	}
+
+	length = len;
 
 	while ((length -= sizeof(u64)) >= 0) {
 		CRC32CX(crc, get_unaligned_le64(p));
@@ -265,6 +378,12 @@ static int __init crc32_mod_init(void)
 {
 	int err;
 
+	crc32_build_shift(&crc32_shift[0], CRC32_POLY_LE, CRC32_STRIDE_LONG);
+	crc32_build_shift(&crc32_shift[1], CRC32_POLY_LE, CRC32_STRIDE_SHORT);
+	crc32_build_shift(&crc32c_shift[0], CRC32C_POLY_LE, CRC32_STRIDE_LONG);
+	crc32_build_shift(&crc32c_shift[1], CRC32C_POLY_LE,
+			  CRC32_STRIDE_SHORT);
+
 	err = crypto_register_shash(&crc32_alg);
 
 	if (err)
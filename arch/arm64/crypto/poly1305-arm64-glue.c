@@ -0,0 +1,286 @@
+/*
+ * Poly1305 authenticator algorithm, RFC7539, arm64 implementation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Based on the public domain poly1305-donna 64-bit implementation by
+ * Andrew Moon. The accumulator and key are kept in three 44/44/42 bit
+ * limbs so that each block needs nine 64x64->128 multiplications, which
+ * map onto mul/umulh pairs, instead of the 25 32x32->64 multiplications
+ * of the generic 26-bit limb code.
+ */
+
+#include <crypto/algapi.h>
+#include <crypto/internal/hash.h>
+#include <crypto/poly1305.h>
+#include <linux/crypto.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <asm/unaligned.h>
+
+typedef unsigned __int128 poly1305_u128;
+
+#define POLY1305_MASK44		((1ULL << 44) - 1)
+#define POLY1305_MASK42		((1ULL << 42) - 1)
+
+struct poly1305_arm64_desc_ctx {
+	/* key */
+	u64 r[3];
+	/* finalize key */
+	u64 s[2];
+	/* accumulator */
+	u64 h[3];
+	/* partial buffer */
+	u8 buf[POLY1305_BLOCK_SIZE];
+	/* bytes used in partial buffer */
+	unsigned int buflen;
+	/* r key has been set */
+	bool rset;
+	/* s key has been set */
+	bool sset;
+};
+
+static int poly1305_arm64_init(struct shash_desc *desc)
+{
+	struct poly1305_arm64_desc_ctx *dctx = shash_desc_ctx(desc);
+
+	memset(dctx->h, 0, sizeof(dctx->h));
+	dctx->buflen = 0;
+	dctx->rset = false;
+	dctx->sset = false;
+
+	return 0;
+}
+
+static void poly1305_arm64_setrkey(struct poly1305_arm64_desc_ctx *dctx,
+				   const u8 *key)
+{
+	u64 t0 = get_unaligned_le64(key + 0);
+	u64 t1 = get_unaligned_le64(key + 8);
+
+	/* r &= 0xffffffc0ffffffc0ffffffc0fffffff */
+	dctx->r[0] = t0 & 0xffc0fffffffULL;
+	dctx->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+	dctx->r[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+}
+
+/*
+ * As with the generic implementation, the key is expected as the first
+ * 32 bytes passed to update(), since it is unique for each tag.
+ */
+static unsigned int
+poly1305_arm64_setdesckey(struct poly1305_arm64_desc_ctx *dctx,
+			  const u8 *src, unsigned int srclen)
+{
+	if (!dctx->sset) {
+		if (!dctx->rset && srclen >= POLY1305_BLOCK_SIZE) {
+			poly1305_arm64_setrkey(dctx, src);
+			src += POLY1305_BLOCK_SIZE;
+			srclen -= POLY1305_BLOCK_SIZE;
+			dctx->rset = true;
+		}
+		if (srclen >= POLY1305_BLOCK_SIZE) {
+			dctx->s[0] = get_unaligned_le64(src + 0);
+			dctx->s[1] = get_unaligned_le64(src + 8);
+			src += POLY1305_BLOCK_SIZE;
+			srclen -= POLY1305_BLOCK_SIZE;
+			dctx->sset = true;
+		}
+	}
+	return srclen;
+}
+
+static unsigned int poly1305_arm64_blocks(struct poly1305_arm64_desc_ctx *dctx,
+					  const u8 *src, unsigned int srclen,
+					  u64 hibit)
+{
+	u64 r0, r1, r2, s1, s2, h0, h1, h2, t0, t1, c;
+	poly1305_u128 d0, d1, d2;
+	unsigned int datalen;
+
+	if (unlikely(!dctx->sset)) {
+		datalen = poly1305_arm64_setdesckey(dctx, src, srclen);
+		src += srclen - datalen;
+		srclen = datalen;
+	}
+
+	r0 = dctx->r[0];
+	r1 = dctx->r[1];
+	r2 = dctx->r[2];
+
+	s1 = r1 * (5 << 2);
+	s2 = r2 * (5 << 2);
+
+	h0 = dctx->h[0];
+	h1 = dctx->h[1];
+	h2 = dctx->h[2];
+
+	while (likely(srclen >= POLY1305_BLOCK_SIZE)) {
+		t0 = get_unaligned_le64(src + 0);
+		t1 = get_unaligned_le64(src + 8);
+
+		/* h += m[i] */
+		h0 += t0 & POLY1305_MASK44;
+		h1 += ((t0 >> 44) | (t1 << 20)) & POLY1305_MASK44;
+		h2 += ((t1 >> 24) & POLY1305_MASK42) | hibit;
+
+		/* h *= r */
+		d0 = (poly1305_u128)h0 * r0 + (poly1305_u128)h1 * s2 +
+		     (poly1305_u128)h2 * s1;
+		d1 = (poly1305_u128)h0 * r1 + (poly1305_u128)h1 * r0 +
+		     (poly1305_u128)h2 * s2;
+		d2 = (poly1305_u128)h0 * r2 + (poly1305_u128)h1 * r1 +
+		     (poly1305_u128)h2 * r0;
+
+		/* (partial) h %= p */
+		c = (u64)(d0 >> 44);
+		h0 = (u64)d0 & POLY1305_MASK44;
+		d1 += c;
+		c = (u64)(d1 >> 44);
+		h1 = (u64)d1 & POLY1305_MASK44;
+		d2 += c;
+		c = (u64)(d2 >> 42);
+		h2 = (u64)d2 & POLY1305_MASK42;
+		h0 += c * 5;
+		c = h0 >> 44;
+		h0 &= POLY1305_MASK44;
+		h1 += c;
+
+		src += POLY1305_BLOCK_SIZE;
+		srclen -= POLY1305_BLOCK_SIZE;
+	}
+
+	dctx->h[0] = h0;
+	dctx->h[1] = h1;
+	dctx->h[2] = h2;
+
+	return srclen;
+}
+
+static int poly1305_arm64_update(struct shash_desc *desc,
+				 const u8 *src, unsigned int srclen)
+{
+	struct poly1305_arm64_desc_ctx *dctx = shash_desc_ctx(desc);
+	unsigned int bytes;
+
+	if (unlikely(dctx->buflen)) {
+		bytes = min(srclen, POLY1305_BLOCK_SIZE - dctx->buflen);
+		memcpy(dctx->buf + dctx->buflen, src, bytes);
+		src += bytes;
+		srclen -= bytes;
+		dctx->buflen += bytes;
+
+		if (dctx->buflen == POLY1305_BLOCK_SIZE) {
+			poly1305_arm64_blocks(dctx, dctx->buf,
+					      POLY1305_BLOCK_SIZE, 1ULL << 40);
+			dctx->buflen = 0;
+		}
+	}
+
+	if (likely(srclen >= POLY1305_BLOCK_SIZE)) {
+		bytes = poly1305_arm64_blocks(dctx, src, srclen, 1ULL << 40);
+		src += srclen - bytes;
+		srclen = bytes;
+	}
+
+	if (unlikely(srclen)) {
+		dctx->buflen = srclen;
+		memcpy(dctx->buf, src, srclen);
+	}
+
+	return 0;
+}
+
+static int poly1305_arm64_final(struct shash_desc *desc, u8 *dst)
+{
+	struct poly1305_arm64_desc_ctx *dctx = shash_desc_ctx(desc);
+	u64 h0, h1, h2, g0, g1, g2, c, mask;
+
+	if (unlikely(!dctx->sset))
+		return -ENOKEY;
+
+	if (unlikely(dctx->buflen)) {
+		dctx->buf[dctx->buflen++] = 1;
+		memset(dctx->buf + dctx->buflen, 0,
+		       POLY1305_BLOCK_SIZE - dctx->buflen);
+		poly1305_arm64_blocks(dctx, dctx->buf, POLY1305_BLOCK_SIZE, 0);
+	}
+
+	h0 = dctx->h[0];
+	h1 = dctx->h[1];
+	h2 = dctx->h[2];
+
+	/* fully carry h */
+	c = h1 >> 44;     h1 &= POLY1305_MASK44;
+	h2 += c;          c = h2 >> 42; h2 &= POLY1305_MASK42;
+	h0 += c * 5;      c = h0 >> 44; h0 &= POLY1305_MASK44;
+	h1 += c;          c = h1 >> 44; h1 &= POLY1305_MASK44;
+	h2 += c;          c = h2 >> 42; h2 &= POLY1305_MASK42;
+	h0 += c * 5;      c = h0 >> 44; h0 &= POLY1305_MASK44;
+	h1 += c;
+
+	/* compute h + -p */
+	g0 = h0 + 5;      c = g0 >> 44; g0 &= POLY1305_MASK44;
+	g1 = h1 + c;      c = g1 >> 44; g1 &= POLY1305_MASK44;
+	g2 = h2 + c - (1ULL << 42);
+
+	/* select h if h < p, or h + -p if h >= p */
+	mask = (g2 >> 63) - 1;
+	g0 &= mask;
+	g1 &= mask;
+	g2 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+
+	/* mac = (h + s) % (2^128) */
+	h0 += dctx->s[0] & POLY1305_MASK44;
+	c = h0 >> 44;
+	h0 &= POLY1305_MASK44;
+	h1 += (((dctx->s[0] >> 44) | (dctx->s[1] << 20)) & POLY1305_MASK44) + c;
+	c = h1 >> 44;
+	h1 &= POLY1305_MASK44;
+	h2 += ((dctx->s[1] >> 24) & POLY1305_MASK42) + c;
+	h2 &= POLY1305_MASK42;
+
+	put_unaligned_le64(h0 | (h1 << 44), dst + 0);
+	put_unaligned_le64((h1 >> 20) | (h2 << 24), dst + 8);
+
+	return 0;
+}
+
+static struct shash_alg alg = {
+	.digestsize	= POLY1305_DIGEST_SIZE,
+	.init		= poly1305_arm64_init,
+	.update		= poly1305_arm64_update,
+	.final		= poly1305_arm64_final,
+	.descsize	= sizeof(struct poly1305_arm64_desc_ctx),
+	.base		= {
+		.cra_name		= "poly1305",
+		.cra_driver_name	= "poly1305-arm64",
+		.cra_priority		= 200,
+		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize		= POLY1305_BLOCK_SIZE,
+		.cra_module		= THIS_MODULE,
+	},
+};
+
+static int __init poly1305_arm64_mod_init(void)
+{
+	return crypto_register_shash(&alg);
+}
+
+static void __exit poly1305_arm64_mod_exit(void)
+{
+	crypto_unregister_shash(&alg);
+}
+
+module_init(poly1305_arm64_mod_init);
+module_exit(poly1305_arm64_mod_exit);
+
+MODULE_DESCRIPTION("Poly1305 authenticator, arm64 64-bit limb implementation");
+MODULE_LICENSE("GPL v2");
+MODULE_ALIAS_CRYPTO("poly1305");
@@ -651,6 +651,16 @@ static bool has_no_hw_prefetch(const struct arm64_cpu_capabilities *entry)
 	u32 midr = read_cpuid_id();
 	u32 rv_min, rv_max;
 
+	/*
+	 * Kryo 2xx does prefetch in hardware, but not far enough ahead to
+	 * keep streaming page and user copies from stalling on loads.
+	 */
+	switch (midr & MIDR_CPU_MODEL_MASK) {
+	case MIDR_KRYO2XX_GOLD:
+	case MIDR_KRYO2XX_SILVER:
+		return true;
+	}
+
 	/* Cavium ThunderX pass 1.x and 2.x */
 	rv_min = 0;
 	rv_max = (1 << MIDR_VARIANT_SHIFT) | MIDR_REVISION_MASK;
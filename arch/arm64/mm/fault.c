@@ -342,6 +342,21 @@ static int __kprobes do_page_fault(unsigned long addr, unsigned int esr,
 			die("Accessing user space memory outside uaccess.h routines", regs, esr);
 	}
 
+	/*
+	 * Most faults from a user thread just populate an anonymous page,
+	 * try those without mmap_sem first.
+	 */
+	if (mm_flags & FAULT_FLAG_USER) {
+		fault = handle_speculative_fault(mm, addr, mm_flags, vm_flags);
+		if (!(fault & VM_FAULT_RETRY)) {
+			perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS, 1, regs, addr);
+			tsk->min_flt++;
+			perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MIN, 1, regs,
+				      addr);
+			return 0;
+		}
+	}
+
 	/*
 	 * As per x86, we may deadlock here. However, since the kernel only
 	 * validly references user space from well defined areas of the code,
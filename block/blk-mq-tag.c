@@ -177,6 +177,26 @@ static int __bt_get_word(struct blk_align_bitmap *bm, unsigned int last_tag,
 
 #define BT_ALLOC_RR(tags) (tags->alloc_policy == BLK_TAG_ALLOC_RR)
 
+/*
+ * Writes and idle class reads may not take the last nr_sync_read_tags
+ * tags, so synchronous reads never wait behind them for a tag.
+ */
+static bool bt_get_async(struct blk_mq_bitmap_tags *bt,
+			 struct blk_mq_tags *tags)
+{
+	unsigned int depth = bt->depth;
+
+	if (depth > tags->nr_sync_read_tags)
+		depth -= tags->nr_sync_read_tags;
+
+	if (atomic_inc_return(&tags->nr_async) > depth) {
+		atomic_dec(&tags->nr_async);
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * Straight forward bitmap tag implementation, where each bit is a tag
  * (cleared == free, and set == busy). The small twist is using per-cpu
@@ -189,7 +209,8 @@ static int __bt_get_word(struct blk_align_bitmap *bm, unsigned int last_tag,
  * until the map is exhausted.
  */
 static int __bt_get(struct blk_mq_hw_ctx *hctx, struct blk_mq_bitmap_tags *bt,
-		    unsigned int *tag_cache, struct blk_mq_tags *tags)
+		    unsigned int *tag_cache, struct blk_mq_tags *tags,
+		    bool async)
 {
 	unsigned int last_tag, org_last_tag;
 	int index, i, tag;
@@ -197,6 +218,9 @@ static int __bt_get(struct blk_mq_hw_ctx *hctx, struct blk_mq_bitmap_tags *bt,
 	if (!hctx_may_queue(hctx, bt))
 		return -1;
 
+	if (async && !bt_get_async(bt, tags))
+		return -1;
+
 	last_tag = org_last_tag = *tag_cache;
 	index = TAG_TO_INDEX(bt, last_tag);
 
@@ -222,6 +246,8 @@ static int __bt_get(struct blk_mq_hw_ctx *hctx, struct blk_mq_bitmap_tags *bt,
 	}
 
 	*tag_cache = 0;
+	if (async)
+		atomic_dec(&tags->nr_async);
 	return -1;
 
 	/*
@@ -264,7 +290,7 @@ static int bt_get(struct blk_mq_alloc_data *data,
 	DEFINE_WAIT(wait);
 	int tag;
 
-	tag = __bt_get(hctx, bt, last_tag, tags);
+	tag = __bt_get(hctx, bt, last_tag, tags, data->async);
 	if (tag != -1)
 		return tag;
 
@@ -275,7 +301,7 @@ static int bt_get(struct blk_mq_alloc_data *data,
 	do {
 		prepare_to_wait(&bs->wait, &wait, TASK_UNINTERRUPTIBLE);
 
-		tag = __bt_get(hctx, bt, last_tag, tags);
+		tag = __bt_get(hctx, bt, last_tag, tags, data->async);
 		if (tag != -1)
 			break;
 
@@ -292,7 +318,7 @@ static int bt_get(struct blk_mq_alloc_data *data,
 		 * Retry tag allocation after running the hardware queue,
 		 * as running the queue may also have found completions.
 		 */
-		tag = __bt_get(hctx, bt, last_tag, tags);
+		tag = __bt_get(hctx, bt, last_tag, tags, data->async);
 		if (tag != -1)
 			break;
 
@@ -303,6 +329,7 @@ static int bt_get(struct blk_mq_alloc_data *data,
 		data->ctx = blk_mq_get_ctx(data->q);
 		data->hctx = data->q->mq_ops->map_queue(data->q,
 				data->ctx->cpu);
+		tags = data->hctx->tags;
 		if (data->reserved) {
 			bt = &data->hctx->tags->breserved_tags;
 		} else {
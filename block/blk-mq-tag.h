@@ -34,8 +34,10 @@ struct blk_mq_bitmap_tags {
 struct blk_mq_tags {
 	unsigned int nr_tags;
 	unsigned int nr_reserved_tags;
+	unsigned int nr_sync_read_tags;
 
 	atomic_t active_queues;
+	atomic_t nr_async;
 
 	struct blk_mq_bitmap_tags bitmap_tags;
 	struct blk_mq_bitmap_tags breserved_tags;
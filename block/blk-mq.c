@@ -221,6 +221,9 @@ __blk_mq_alloc_request(struct blk_mq_alloc_data *data, int rw)
 			atomic_inc(&data->hctx->nr_active);
 		}
 
+		if (data->async)
+			rq->cmd_flags |= REQ_MQ_ASYNC_TAG;
+
 		rq->tag = tag;
 		blk_mq_rq_ctx_init(data->q, data->ctx, rq, rw);
 		return rq;
@@ -276,6 +279,8 @@ static void __blk_mq_free_request(struct blk_mq_hw_ctx *hctx,
 
 	if (rq->cmd_flags & REQ_MQ_INFLIGHT)
 		atomic_dec(&hctx->nr_active);
+	if (rq->cmd_flags & REQ_MQ_ASYNC_TAG)
+		atomic_dec(&hctx->tags->nr_async);
 	rq->cmd_flags = 0;
 
 	clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
@@ -1162,6 +1167,19 @@ struct blk_map_ctx {
 	struct blk_mq_ctx *ctx;
 };
 
+/*
+ * Writes and idle class reads may not use the tags the driver kept for
+ * synchronous reads, see bt_get_async().
+ */
+static bool blk_mq_bio_async(struct blk_mq_hw_ctx *hctx, struct bio *bio)
+{
+	if (!hctx->tags->nr_sync_read_tags)
+		return false;
+
+	return bio_data_dir(bio) == WRITE ||
+		IOPRIO_PRIO_CLASS(bio_prio(bio)) == IOPRIO_CLASS_IDLE;
+}
+
 static struct request *blk_mq_map_request(struct request_queue *q,
 					  struct bio *bio,
 					  struct blk_map_ctx *data)
@@ -1182,6 +1200,7 @@ static struct request *blk_mq_map_request(struct request_queue *q,
 	trace_block_getrq(q, bio, rw);
 	blk_mq_set_alloc_data(&alloc_data, q, GFP_ATOMIC, false, ctx,
 			hctx);
+	alloc_data.async = blk_mq_bio_async(hctx, bio);
 	rq = __blk_mq_alloc_request(&alloc_data, rw);
 	if (unlikely(!rq)) {
 		__blk_mq_run_hw_queue(hctx);
@@ -1192,6 +1211,7 @@ static struct request *blk_mq_map_request(struct request_queue *q,
 		hctx = q->mq_ops->map_queue(q, ctx->cpu);
 		blk_mq_set_alloc_data(&alloc_data, q,
 				__GFP_RECLAIM|__GFP_HIGH, false, ctx, hctx);
+		alloc_data.async = blk_mq_bio_async(hctx, bio);
 		rq = __blk_mq_alloc_request(&alloc_data, rw);
 		ctx = alloc_data.ctx;
 		hctx = alloc_data.hctx;
@@ -1472,6 +1492,8 @@ static struct blk_mq_tags *blk_mq_init_rq_map(struct blk_mq_tag_set *set,
 	if (!tags)
 		return NULL;
 
+	tags->nr_sync_read_tags = set->sync_read_tags;
+
 	INIT_LIST_HEAD(&tags->page_list);
 
 	tags->rqs = kzalloc_node(set->queue_depth * sizeof(struct request *),
@@ -96,6 +96,7 @@ struct blk_mq_alloc_data {
 	struct request_queue *q;
 	gfp_t gfp;
 	bool reserved;
+	bool async;
 
 	/* input & output parameter */
 	struct blk_mq_ctx *ctx;
@@ -110,6 +111,7 @@ static inline void blk_mq_set_alloc_data(struct blk_mq_alloc_data *data,
 	data->q = q;
 	data->gfp = gfp;
 	data->reserved = reserved;
+	data->async = false;
 	data->ctx = ctx;
 	data->hctx = hctx;
 }
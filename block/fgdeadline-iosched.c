@@ -0,0 +1,517 @@
+/*
+ *  Foreground weighted deadline i/o scheduler.
+ *
+ *  Based on the deadline i/o scheduler,
+ *  Copyright (C) 2002 Jens Axboe <axboe@kernel.dk>
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/blk-cgroup.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/ioprio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+
+/*
+ * Requests are split by blkio cgroup and by sync/async into four queues,
+ * each run like a deadline direction: sector sorted batches, restarted
+ * from the FIFO head when a request expires. On Android foreground tasks
+ * sit in the root blkio cgroup and background ones below it.
+ */
+enum {
+	FGDL_FG,			/* root blkio cgroup */
+	FGDL_BG,			/* any other cgroup, or idle ioprio */
+	FGDL_CLASSES,
+};
+
+/* expiry and weight per class, indexed by BLK_RW_ASYNC/BLK_RW_SYNC */
+static const int fifo_expire[FGDL_CLASSES][2] = {
+	[FGDL_FG] = { 2 * HZ, HZ / 10 },
+	[FGDL_BG] = { 5 * HZ, HZ },
+};
+static const int weight[FGDL_CLASSES][2] = {
+	[FGDL_FG] = { 4, 8 },
+	[FGDL_BG] = { 1, 2 },
+};
+static const int fifo_batch = 16;       /* # of sequential requests treated as one
+				     by the above parameters. For throughput. */
+
+struct fgdl_queue {
+	struct rb_root sort_list;
+	struct list_head fifo_list;
+
+	/* next in sort order, NULL when the last dispatch was elsewhere */
+	struct request *next_rq;
+
+	/* batches left in this round */
+	int credit;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire;
+	int weight;
+};
+
+struct fgdl_data {
+	/*
+	 * requests are present on both sort_list and fifo_list of the
+	 * queue of their class
+	 */
+	struct fgdl_queue queues[FGDL_CLASSES][2];
+
+	struct fgdl_queue *cur;		/* queue being batched from */
+	unsigned int batching;		/* number of sequential requests made */
+
+	int fifo_batch;
+	int front_merges;
+};
+
+#define RQ_FGDLQ(rq)	((struct fgdl_queue *) (rq)->elv.priv[0])
+
+/* walk the queues from the most to the least latency sensitive */
+#define for_each_fgdl_queue(fd, fq, class, sync)			\
+	for (class = FGDL_FG; class < FGDL_CLASSES; class++)		\
+		for (sync = BLK_RW_SYNC;				\
+		     sync >= BLK_RW_ASYNC &&				\
+		     ((fq) = &(fd)->queues[class][sync]); sync--)
+
+static struct fgdl_queue *
+fgdl_rq_queue(struct fgdl_data *fd, struct request *rq)
+{
+	struct request_list *rl = blk_rq_rl(rq);
+	int class = FGDL_FG;
+
+	if ((rl && rl != &rq->q->root_rl) ||
+	    IOPRIO_PRIO_CLASS(req_get_ioprio(rq)) == IOPRIO_CLASS_IDLE)
+		class = FGDL_BG;
+
+	return &fd->queues[class][rq_is_sync(rq)];
+}
+
+/*
+ * get the request after `rq' in sector-sorted order
+ */
+static inline struct request *
+fgdl_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static inline void
+fgdl_del_rq_rb(struct request *rq)
+{
+	struct fgdl_queue *fq = RQ_FGDLQ(rq);
+
+	if (fq->next_rq == rq)
+		fq->next_rq = fgdl_latter_request(rq);
+
+	elv_rb_del(&fq->sort_list, rq);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+fgdl_add_request(struct request_queue *q, struct request *rq)
+{
+	struct fgdl_data *fd = q->elevator->elevator_data;
+	struct fgdl_queue *fq = fgdl_rq_queue(fd, rq);
+
+	rq->elv.priv[0] = fq;
+	elv_rb_add(&fq->sort_list, rq);
+
+	/*
+	 * set expire time and add to fifo list
+	 */
+	rq->fifo_time = jiffies + fq->fifo_expire;
+	list_add_tail(&rq->queuelist, &fq->fifo_list);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void fgdl_remove_request(struct request_queue *q, struct request *rq)
+{
+	rq_fifo_clear(rq);
+	fgdl_del_rq_rb(rq);
+}
+
+static int
+fgdl_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct fgdl_data *fd = q->elevator->elevator_data;
+	struct fgdl_queue *fq;
+	struct request *__rq;
+	int class, sync;
+
+	/*
+	 * check for front merge, the bio may land in any class
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio_end_sector(bio);
+
+		for_each_fgdl_queue(fd, fq, class, sync) {
+			__rq = elv_rb_find(&fq->sort_list, sector);
+			if (!__rq)
+				continue;
+
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_bio_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void fgdl_merged_request(struct request_queue *q,
+				struct request *req, int type)
+{
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(&RQ_FGDLQ(req)->sort_list, req);
+		elv_rb_add(&RQ_FGDLQ(req)->sort_list, req);
+	}
+}
+
+static void
+fgdl_merged_requests(struct request_queue *q, struct request *req,
+		     struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo.
+	 * Only within one queue, each fifo must stay sorted by expiry.
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    RQ_FGDLQ(req) == RQ_FGDLQ(next)) {
+		if (time_before(next->fifo_time, req->fifo_time)) {
+			list_move(&req->queuelist, &next->queuelist);
+			req->fifo_time = next->fifo_time;
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	fgdl_remove_request(q, next);
+}
+
+/*
+ * fgdl_check_fifo returns 1 if the head of the fifo has expired.
+ * Requires !list_empty(&fq->fifo_list)
+ */
+static inline int fgdl_check_fifo(struct fgdl_queue *fq)
+{
+	struct request *rq = rq_entry_fifo(fq->fifo_list.next);
+
+	return time_after_eq(jiffies, rq->fifo_time);
+}
+
+/*
+ * Pick the queue to start the next batch from: an expired request is
+ * always served first, otherwise queues share batches in proportion to
+ * their weight. An empty queue does not spend its credit, so the
+ * scheduler stays work conserving.
+ */
+static struct fgdl_queue *fgdl_select_queue(struct fgdl_data *fd)
+{
+	struct fgdl_queue *fq;
+	bool busy = false;
+	int class, sync, pass;
+
+	for_each_fgdl_queue(fd, fq, class, sync) {
+		if (list_empty(&fq->fifo_list))
+			continue;
+		if (fgdl_check_fifo(fq))
+			return fq;
+		busy = true;
+	}
+
+	if (!busy)
+		return NULL;
+
+	for (pass = 0; pass < 2; pass++) {
+		for_each_fgdl_queue(fd, fq, class, sync) {
+			if (!list_empty(&fq->fifo_list) && fq->credit > 0) {
+				fq->credit--;
+				return fq;
+			}
+		}
+
+		/* round over, everyone gets its weight back */
+		for_each_fgdl_queue(fd, fq, class, sync)
+			fq->credit = fq->weight;
+	}
+
+	return NULL;
+}
+
+/*
+ * A background or async batch is cut short as soon as foreground sync
+ * requests show up, their latency is what the user sees.
+ */
+static inline bool fgdl_preempt(struct fgdl_data *fd, struct fgdl_queue *fq)
+{
+	struct fgdl_queue *fg_sync = &fd->queues[FGDL_FG][BLK_RW_SYNC];
+
+	return fq != fg_sync && !list_empty(&fg_sync->fifo_list);
+}
+
+/*
+ * fgdl_dispatch_requests selects the best request according to
+ * expiry, class weights, fifo_batch, etc
+ */
+static int fgdl_dispatch_requests(struct request_queue *q, int force)
+{
+	struct fgdl_data *fd = q->elevator->elevator_data;
+	struct fgdl_queue *fq = fd->cur;
+	struct request *rq;
+
+	if (fq && fq->next_rq && fd->batching < fd->fifo_batch &&
+	    !fgdl_preempt(fd, fq)) {
+		/* we have a next request are still entitled to batch */
+		rq = fq->next_rq;
+		goto dispatch_request;
+	}
+
+	fq = fgdl_select_queue(fd);
+	if (!fq)
+		return 0;
+
+	BUG_ON(RB_EMPTY_ROOT(&fq->sort_list));
+
+	if (fgdl_check_fifo(fq) || fq != fd->cur || !fq->next_rq) {
+		/*
+		 * A deadline has expired, the last request was in another
+		 * queue, or we have run out of higher-sectored requests.
+		 * Start again from the request with the earliest expiry time.
+		 */
+		rq = rq_entry_fifo(fq->fifo_list.next);
+	} else {
+		/*
+		 * The last req was from this queue and we have a next request
+		 * in sort order. No expired requests so continue on from here.
+		 */
+		rq = fq->next_rq;
+	}
+
+	fd->cur = fq;
+	fd->batching = 0;
+
+dispatch_request:
+	/*
+	 * rq is the selected appropriate request.
+	 */
+	fd->batching++;
+	fq->next_rq = fgdl_latter_request(rq);
+
+	/*
+	 * take it off the sort and fifo list, move
+	 * to dispatch queue
+	 */
+	fgdl_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+
+	return 1;
+}
+
+static void fgdl_exit_queue(struct elevator_queue *e)
+{
+	struct fgdl_data *fd = e->elevator_data;
+	struct fgdl_queue *fq;
+	int class, sync;
+
+	for_each_fgdl_queue(fd, fq, class, sync)
+		BUG_ON(!list_empty(&fq->fifo_list));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (fgdl_data).
+ */
+static int fgdl_init_queue(struct request_queue *q, struct elevator_type *e)
+{
+	struct fgdl_data *fd;
+	struct fgdl_queue *fq;
+	struct elevator_queue *eq;
+	int class, sync;
+
+	eq = elevator_alloc(q, e);
+	if (!eq)
+		return -ENOMEM;
+
+	fd = kzalloc_node(sizeof(*fd), GFP_KERNEL, q->node);
+	if (!fd) {
+		kobject_put(&eq->kobj);
+		return -ENOMEM;
+	}
+	eq->elevator_data = fd;
+
+	for_each_fgdl_queue(fd, fq, class, sync) {
+		INIT_LIST_HEAD(&fq->fifo_list);
+		fq->sort_list = RB_ROOT;
+		fq->fifo_expire = fifo_expire[class][sync];
+		fq->weight = weight[class][sync];
+		fq->credit = fq->weight;
+	}
+	fd->front_merges = 1;
+	fd->fifo_batch = fifo_batch;
+
+	spin_lock_irq(q->queue_lock);
+	q->elevator = eq;
+	spin_unlock_irq(q->queue_lock);
+	return 0;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+fgdl_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static void
+fgdl_var_store(int *var, const char *page)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct fgdl_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return fgdl_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(fgdl_fg_sync_expire_show,
+	      fd->queues[FGDL_FG][BLK_RW_SYNC].fifo_expire, 1);
+SHOW_FUNCTION(fgdl_fg_async_expire_show,
+	      fd->queues[FGDL_FG][BLK_RW_ASYNC].fifo_expire, 1);
+SHOW_FUNCTION(fgdl_bg_sync_expire_show,
+	      fd->queues[FGDL_BG][BLK_RW_SYNC].fifo_expire, 1);
+SHOW_FUNCTION(fgdl_bg_async_expire_show,
+	      fd->queues[FGDL_BG][BLK_RW_ASYNC].fifo_expire, 1);
+SHOW_FUNCTION(fgdl_fg_sync_weight_show,
+	      fd->queues[FGDL_FG][BLK_RW_SYNC].weight, 0);
+SHOW_FUNCTION(fgdl_fg_async_weight_show,
+	      fd->queues[FGDL_FG][BLK_RW_ASYNC].weight, 0);
+SHOW_FUNCTION(fgdl_bg_sync_weight_show,
+	      fd->queues[FGDL_BG][BLK_RW_SYNC].weight, 0);
+SHOW_FUNCTION(fgdl_bg_async_weight_show,
+	      fd->queues[FGDL_BG][BLK_RW_ASYNC].weight, 0);
+SHOW_FUNCTION(fgdl_front_merges_show, fd->front_merges, 0);
+SHOW_FUNCTION(fgdl_fifo_batch_show, fd->fifo_batch, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct fgdl_data *fd = e->elevator_data;			\
+	int __data;							\
+	fgdl_var_store(&__data, (page));				\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return count;							\
+}
+STORE_FUNCTION(fgdl_fg_sync_expire_store,
+	       &fd->queues[FGDL_FG][BLK_RW_SYNC].fifo_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(fgdl_fg_async_expire_store,
+	       &fd->queues[FGDL_FG][BLK_RW_ASYNC].fifo_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(fgdl_bg_sync_expire_store,
+	       &fd->queues[FGDL_BG][BLK_RW_SYNC].fifo_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(fgdl_bg_async_expire_store,
+	       &fd->queues[FGDL_BG][BLK_RW_ASYNC].fifo_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(fgdl_fg_sync_weight_store,
+	       &fd->queues[FGDL_FG][BLK_RW_SYNC].weight, 1, INT_MAX, 0);
+STORE_FUNCTION(fgdl_fg_async_weight_store,
+	       &fd->queues[FGDL_FG][BLK_RW_ASYNC].weight, 1, INT_MAX, 0);
+STORE_FUNCTION(fgdl_bg_sync_weight_store,
+	       &fd->queues[FGDL_BG][BLK_RW_SYNC].weight, 1, INT_MAX, 0);
+STORE_FUNCTION(fgdl_bg_async_weight_store,
+	       &fd->queues[FGDL_BG][BLK_RW_ASYNC].weight, 1, INT_MAX, 0);
+STORE_FUNCTION(fgdl_front_merges_store, &fd->front_merges, 0, 1, 0);
+STORE_FUNCTION(fgdl_fifo_batch_store, &fd->fifo_batch, 0, INT_MAX, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, fgdl_##name##_show, \
+				      fgdl_##name##_store)
+
+static struct elv_fs_entry fgdl_attrs[] = {
+	FD_ATTR(fg_sync_expire),
+	FD_ATTR(fg_async_expire),
+	FD_ATTR(bg_sync_expire),
+	FD_ATTR(bg_async_expire),
+	FD_ATTR(fg_sync_weight),
+	FD_ATTR(fg_async_weight),
+	FD_ATTR(bg_sync_weight),
+	FD_ATTR(bg_async_weight),
+	FD_ATTR(front_merges),
+	FD_ATTR(fifo_batch),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_fgdeadline = {
+	.ops = {
+		.elevator_merge_fn = 		fgdl_merge,
+		.elevator_merged_fn =		fgdl_merged_request,
+		.elevator_merge_req_fn =	fgdl_merged_requests,
+		.elevator_dispatch_fn =		fgdl_dispatch_requests,
+		.elevator_add_req_fn =		fgdl_add_request,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		fgdl_init_queue,
+		.elevator_exit_fn =		fgdl_exit_queue,
+	},
+
+	.elevator_attrs = fgdl_attrs,
+	.elevator_name = "fgdeadline",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init fgdl_init(void)
+{
+	return elv_register(&iosched_fgdeadline);
+}
+
+static void __exit fgdl_exit(void)
+{
+	elv_unregister(&iosched_fgdeadline);
+}
+
+module_init(fgdl_init);
+module_exit(fgdl_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("foreground weighted deadline IO scheduler");
@@ -34,6 +34,11 @@
  *    node->async_todo), as well as thread->transaction_stack
  *    binder_inner_proc_lock() and binder_inner_proc_unlock()
  *    are used to acq/rel
+ * 4) proc->threads_lock : rwlock that also protects proc->threads,
+ *    so that the per-ioctl thread lookup does not need the
+ *    inner lock. proc->threads is only modified with both the
+ *    inner lock and threads_lock (for writing) held, so holding
+ *    either one is enough to walk it.
  *
  * Any lock under procA must never be nested under any lock at the same
  * level or below on procB.
@@ -46,6 +51,7 @@
  * foo_ilocked() : requires proc->inner_lock
  * foo_oilocked(): requires proc->outer_lock and proc->inner_lock
  * foo_nilocked(): requires node->lock and proc->inner_lock
+ * foo_tlocked() : requires proc->threads_lock
  * ...
  */
 
@@ -56,6 +62,8 @@
 #include <linux/file.h>
 #include <linux/freezer.h>
 #include <linux/fs.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
@@ -268,6 +276,124 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 	return e;
 }
 
+/*
+ * Per-interface transaction latency accounting, keyed by target node,
+ * target process and transaction code. Enabled with the txn_stats
+ * module parameter and reported in debugfs "transaction_stats"; writing
+ * to that file clears the table.
+ */
+#define BINDER_TXN_STATS_BITS	8
+#define BINDER_TXN_STATS_MAX	1024
+
+struct binder_txn_stat {
+	struct hlist_node hnode;
+	int node_debug_id;
+	int pid;
+	unsigned int code;
+	u64 count;
+	u64 oneway;
+	u64 queue_ns;
+	u64 queue_max_ns;
+	u64 exec_ns;
+	u64 exec_max_ns;
+	u64 reply_ns;
+	u64 reply_max_ns;
+};
+
+static bool binder_txn_stats_enabled;
+module_param_named(txn_stats, binder_txn_stats_enabled, bool, 0644);
+
+/* replies slower than this fire the trace snapshot trigger, 0 = never */
+static unsigned int binder_snapshot_reply_ms = 500;
+module_param_named(snapshot_reply_ms, binder_snapshot_reply_ms, uint, 0644);
+
+static DEFINE_HASHTABLE(binder_txn_stats, BINDER_TXN_STATS_BITS);
+static DEFINE_SPINLOCK(binder_txn_stats_lock);
+static unsigned int binder_txn_stats_nr;
+static unsigned long binder_txn_stats_dropped;
+
+static struct binder_txn_stat *binder_txn_stat_find(u32 key,
+						    int node_debug_id,
+						    int pid, unsigned int code)
+{
+	struct binder_txn_stat *s;
+
+	hash_for_each_possible(binder_txn_stats, s, hnode, key) {
+		if (s->node_debug_id == node_debug_id && s->pid == pid &&
+		    s->code == code)
+			return s;
+	}
+	return NULL;
+}
+
+/**
+ * binder_txn_stats_record() - account one transaction to its interface
+ * @node_debug_id:	debug_id of the target node
+ * @pid:		pid of the target process
+ * @code:		transaction code
+ * @oneway:		true for TF_ONE_WAY, which has no exec/reply time
+ * @queue_ns:		time from BC_TRANSACTION until the target dequeued it
+ * @exec_ns:		time from dequeue until BC_REPLY
+ * @reply_ns:		time from BC_TRANSACTION until BC_REPLY
+ *
+ * Must be called without any binder spinlocks held; a new entry is
+ * allocated with GFP_KERNEL outside binder_txn_stats_lock. Once
+ * BINDER_TXN_STATS_MAX entries exist, new keys are counted as dropped.
+ */
+static void binder_txn_stats_record(int node_debug_id, int pid,
+				    unsigned int code, bool oneway,
+				    u64 queue_ns, u64 exec_ns, u64 reply_ns)
+{
+	struct binder_txn_stat *s, *new = NULL;
+	u32 key = jhash_3words(node_debug_id, pid, code, 0);
+
+	spin_lock(&binder_txn_stats_lock);
+	s = binder_txn_stat_find(key, node_debug_id, pid, code);
+	if (!s) {
+		if (binder_txn_stats_nr >= BINDER_TXN_STATS_MAX)
+			goto dropped;
+		spin_unlock(&binder_txn_stats_lock);
+
+		new = kzalloc(sizeof(*new), GFP_KERNEL);
+		if (!new)
+			return;
+		new->node_debug_id = node_debug_id;
+		new->pid = pid;
+		new->code = code;
+
+		spin_lock(&binder_txn_stats_lock);
+		s = binder_txn_stat_find(key, node_debug_id, pid, code);
+		if (!s) {
+			if (binder_txn_stats_nr >= BINDER_TXN_STATS_MAX)
+				goto dropped;
+			hash_add(binder_txn_stats, &new->hnode, key);
+			binder_txn_stats_nr++;
+			s = new;
+			new = NULL;
+		}
+	}
+
+	s->count++;
+	s->queue_ns += queue_ns;
+	s->queue_max_ns = max(s->queue_max_ns, queue_ns);
+	if (oneway) {
+		s->oneway++;
+	} else {
+		s->exec_ns += exec_ns;
+		s->exec_max_ns = max(s->exec_max_ns, exec_ns);
+		s->reply_ns += reply_ns;
+		s->reply_max_ns = max(s->reply_max_ns, reply_ns);
+	}
+	spin_unlock(&binder_txn_stats_lock);
+	kfree(new);
+	return;
+
+dropped:
+	binder_txn_stats_dropped++;
+	spin_unlock(&binder_txn_stats_lock);
+	kfree(new);
+}
+
 struct binder_context {
 	struct binder_node *binder_context_mgr_node;
 	struct mutex context_mgr_node_lock;
@@ -497,7 +623,7 @@ struct binder_priority {
  * struct binder_proc - binder process bookkeeping
  * @proc_node:            element for binder_procs list
  * @threads:              rbtree of binder_threads in this proc
- *                        (protected by @inner_lock)
+ *                        (protected by @inner_lock and @threads_lock)
  * @nodes:                rbtree of binder nodes associated with
  *                        this proc ordered by node->ptr
  *                        (protected by @inner_lock)
@@ -544,6 +670,7 @@ struct binder_priority {
  * @context:              binder_context for this proc
  *                        (invariant after initialized)
  * @inner_lock:           can nest under outer_lock and/or node lock
+ * @threads_lock:         can nest under inner_lock
  * @outer_lock:           no nesting under innor or node lock
  *                        Lock order: 1) outer, 2) node, 3) inner
  *
@@ -577,6 +704,7 @@ struct binder_proc {
 	struct binder_context *context;
 	spinlock_t inner_lock;
 	spinlock_t outer_lock;
+	rwlock_t threads_lock;
 };
 
 enum {
@@ -663,6 +791,11 @@ struct binder_transaction {
 	bool    set_priority_called;
 	kuid_t	sender_euid;
 	binder_uintptr_t security_ctx;
+	/* target node/pid for transaction_stats, 0 for replies */
+	int stats_node;
+	int stats_pid;
+	u64 start_ns;	/* BC_TRANSACTION issued */
+	u64 deq_ns;	/* picked up by the target thread */
 	/**
 	 * @lock:  protects @from, @to_proc, and @to_thread
 	 *
@@ -1112,9 +1245,11 @@ static void binder_wakeup_thread_ilocked(struct binder_proc *proc,
 	assert_spin_locked(&proc->inner_lock);
 
 	if (thread) {
-		if (sync)
+		if (sync) {
+			/* the caller blocks for the reply: run next to it */
+			sched_set_wake_hint(thread->task, smp_processor_id());
 			wake_up_interruptible_sync(&thread->wait);
-		else
+		} else
 			wake_up_interruptible(&thread->wait);
 		return;
 	}
@@ -2142,6 +2277,32 @@ static void binder_free_transaction(struct binder_transaction *t)
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 }
 
+/**
+ * binder_txn_account() - report the latency of a finished transaction
+ * @t:		transaction being completed
+ * @reply_ns:	time of BC_REPLY, or 0 for a one-way transaction
+ *
+ * Called without locks held, either when the target dequeues a one-way
+ * transaction or when it replies to a synchronous one.
+ */
+static void binder_txn_account(struct binder_transaction *t, u64 reply_ns)
+{
+	u64 queue_ns = t->deq_ns - t->start_ns;
+	u64 exec_ns = reply_ns ? reply_ns - t->deq_ns : 0;
+	u64 total_ns = reply_ns ? reply_ns - t->start_ns : 0;
+
+	if (!t->stats_node)
+		return;
+	trace_binder_transaction_latency(t, queue_ns, exec_ns, total_ns);
+	if (binder_snapshot_reply_ms &&
+	    total_ns > (u64)binder_snapshot_reply_ms * NSEC_PER_MSEC)
+		tracing_snapshot_trigger("binder slow reply");
+	if (binder_txn_stats_enabled)
+		binder_txn_stats_record(t->stats_node, t->stats_pid, t->code,
+					!reply_ns, queue_ns, exec_ns,
+					total_ns);
+}
+
 static void binder_send_failed_reply(struct binder_transaction *t,
 				     uint32_t error_code)
 {
@@ -3137,6 +3298,11 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
+	t->start_ns = ktime_get_ns();
+	if (target_node) {
+		t->stats_node = target_node->debug_id;
+		t->stats_pid = target_proc->pid;
+	}
 	if (!(t->flags & TF_ONE_WAY) &&
 	    binder_supported_policy(current->policy)) {
 		/* Inherit supported policies for synchronous transactions */
@@ -3207,6 +3373,13 @@ static void binder_transaction(struct binder_proc *proc,
 				      ALIGN(tr->data_size, sizeof(void *)));
 	offp = off_start;
 
+	/*
+	 * This is the one copy a transaction costs. Handing the sender's
+	 * pages to the target instead is not an option: binder buffers are
+	 * mapped with vm_insert_page(), which refuses anonymous pages, and
+	 * the sender could keep modifying shared pages after the target
+	 * has validated the objects in them.
+	 */
 	if (copy_from_user(t->buffer->data, (const void __user *)(uintptr_t)
 			   tr->data.ptr.buffer, tr->data_size)) {
 		binder_user_error("%d:%d got transaction with invalid data ptr\n",
@@ -3409,8 +3582,10 @@ static void binder_transaction(struct binder_proc *proc,
 		binder_pop_transaction_ilocked(target_thread, in_reply_to);
 		binder_enqueue_thread_work_ilocked(target_thread, &t->work);
 		binder_inner_proc_unlock(target_proc);
+		sched_set_wake_hint(target_thread->task, raw_smp_processor_id());
 		wake_up_interruptible_sync(&target_thread->wait);
 		binder_restore_priority(current, in_reply_to->saved_priority);
+		binder_txn_account(in_reply_to, ktime_get_ns());
 		binder_free_transaction(in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -4387,6 +4562,9 @@ retry:
 		}
 		ptr += trsize;
 
+		t->deq_ns = ktime_get_ns();
+		if (t->flags & TF_ONE_WAY)
+			binder_txn_account(t, 0);
 		trace_binder_transaction_received(t);
 		binder_stat_br(proc, thread, cmd);
 		binder_debug(BINDER_DEBUG_TRANSACTION,
@@ -4492,7 +4670,7 @@ static void binder_release_work(struct binder_proc *proc,
 
 }
 
-static struct binder_thread *binder_get_thread_ilocked(
+static struct binder_thread *binder_get_thread_tlocked(
 		struct binder_proc *proc, struct binder_thread *new_thread)
 {
 	struct binder_thread *thread = NULL;
@@ -4537,15 +4715,17 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 	struct binder_thread *thread;
 	struct binder_thread *new_thread;
 
-	binder_inner_proc_lock(proc);
-	thread = binder_get_thread_ilocked(proc, NULL);
-	binder_inner_proc_unlock(proc);
+	read_lock(&proc->threads_lock);
+	thread = binder_get_thread_tlocked(proc, NULL);
+	read_unlock(&proc->threads_lock);
 	if (!thread) {
 		new_thread = kmem_cache_zalloc(binder_thread_pool, GFP_KERNEL);
 		if (new_thread == NULL)
 			return NULL;
 		binder_inner_proc_lock(proc);
-		thread = binder_get_thread_ilocked(proc, new_thread);
+		write_lock(&proc->threads_lock);
+		thread = binder_get_thread_tlocked(proc, new_thread);
+		write_unlock(&proc->threads_lock);
 		binder_inner_proc_unlock(proc);
 		if (thread != new_thread)
 			kmem_cache_free(binder_thread_pool, new_thread);
@@ -4593,7 +4773,9 @@ static int binder_thread_release(struct binder_proc *proc,
 	 * survives while we are releasing it
 	 */
 	atomic_inc(&thread->tmp_ref);
+	write_lock(&proc->threads_lock);
 	rb_erase(&thread->rb_node, &proc->threads);
+	write_unlock(&proc->threads_lock);
 	t = thread->transaction_stack;
 	if (t) {
 		spin_lock(&t->lock);
@@ -5082,6 +5264,7 @@ static int binder_open(struct inode *nodp, struct file *filp)
 		return -ENOMEM;
 	spin_lock_init(&proc->inner_lock);
 	spin_lock_init(&proc->outer_lock);
+	rwlock_init(&proc->threads_lock);
 	get_task_struct(current->group_leader);
 	proc->tsk = current->group_leader;
 	mutex_init(&proc->files_lock);
@@ -5903,6 +6086,72 @@ static int binder_transaction_log_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static int binder_transaction_stats_show(struct seq_file *m, void *unused)
+{
+	struct binder_txn_stat *s;
+	int bkt;
+
+	spin_lock(&binder_txn_stats_lock);
+	seq_printf(m, "binder transaction stats (%s, %u entries, %lu dropped)\n",
+		   binder_txn_stats_enabled ? "enabled" : "disabled",
+		   binder_txn_stats_nr, binder_txn_stats_dropped);
+	seq_puts(m, "node pid code count oneway queue_avg_us queue_max_us exec_avg_us exec_max_us reply_avg_us reply_max_us\n");
+	hash_for_each(binder_txn_stats, bkt, s, hnode) {
+		u64 sync = s->count - s->oneway;
+
+		seq_printf(m, "%d %d %u %llu %llu %llu %llu %llu %llu %llu %llu\n",
+			   s->node_debug_id, s->pid, s->code,
+			   s->count, s->oneway,
+			   div64_u64(s->queue_ns, s->count) / NSEC_PER_USEC,
+			   div_u64(s->queue_max_ns, NSEC_PER_USEC),
+			   sync ? div64_u64(s->exec_ns, sync) / NSEC_PER_USEC : 0,
+			   div_u64(s->exec_max_ns, NSEC_PER_USEC),
+			   sync ? div64_u64(s->reply_ns, sync) / NSEC_PER_USEC : 0,
+			   div_u64(s->reply_max_ns, NSEC_PER_USEC));
+	}
+	spin_unlock(&binder_txn_stats_lock);
+	return 0;
+}
+
+static int binder_transaction_stats_open(struct inode *inode,
+					 struct file *file)
+{
+	return single_open(file, binder_transaction_stats_show,
+			   inode->i_private);
+}
+
+static ssize_t binder_transaction_stats_write(struct file *file,
+					      const char __user *ubuf,
+					      size_t count, loff_t *ppos)
+{
+	struct binder_txn_stat *s;
+	struct hlist_node *tmp;
+	HLIST_HEAD(free_list);
+	int bkt;
+
+	spin_lock(&binder_txn_stats_lock);
+	hash_for_each_safe(binder_txn_stats, bkt, tmp, s, hnode) {
+		hash_del(&s->hnode);
+		hlist_add_head(&s->hnode, &free_list);
+	}
+	binder_txn_stats_nr = 0;
+	binder_txn_stats_dropped = 0;
+	spin_unlock(&binder_txn_stats_lock);
+
+	hlist_for_each_entry_safe(s, tmp, &free_list, hnode)
+		kfree(s);
+	return count;
+}
+
+static const struct file_operations binder_transaction_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = binder_transaction_stats_open,
+	.read = seq_read,
+	.write = binder_transaction_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static const struct file_operations binder_fops = {
 	.owner = THIS_MODULE,
 	.poll = binder_poll,
@@ -6066,6 +6315,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("transaction_stats",
+				    0644,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_transaction_stats_fops);
 	}
 
 	/*
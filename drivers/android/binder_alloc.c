@@ -19,6 +19,7 @@
 
 #include <asm/cacheflush.h>
 #include <linux/list.h>
+#include <linux/memcontrol.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/rtmutex.h>
@@ -282,6 +283,16 @@ static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
 				alloc->pid, page_addr);
 			goto err_alloc_page_failed;
 		}
+		/*
+		 * The buffer belongs to the receiving process even though
+		 * the sender is the one faulting it in, so charge it to the
+		 * memcg of the process that mapped it.
+		 */
+		if (memcg_kmem_charge_mm(page->page_ptr, GFP_KERNEL, 0, mm)) {
+			pr_err("%d: binder_alloc_buf failed to charge page at %pK\n",
+			       alloc->pid, page_addr);
+			goto err_charge_failed;
+		}
 		page->alloc = alloc;
 		INIT_LIST_HEAD(&page->lru);
 
@@ -336,6 +347,8 @@ free_range:
 err_vm_insert_page_failed:
 		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
 err_map_kernel_failed:
+		memcg_kmem_uncharge(page->page_ptr, 0);
+err_charge_failed:
 		__free_page(page->page_ptr);
 		page->page_ptr = NULL;
 err_alloc_page_failed:
@@ -350,6 +363,62 @@ err_no_vma:
 	return vma ? -ENOMEM : -ESRCH;
 }
 
+static void binder_release_buf_locked(struct binder_alloc *alloc,
+				      struct binder_buffer *buffer,
+				      size_t buffer_size);
+
+static struct binder_buffer *binder_alloc_cache_get(struct binder_alloc *alloc,
+						    size_t size)
+{
+	int class;
+
+	if (size > BINDER_CACHE_MIN_SIZE << (BINDER_CACHE_CLASSES - 1))
+		return NULL;
+
+	/* every buffer in this class is at least as big as the request */
+	class = max(order_base_2(size) - ilog2(BINDER_CACHE_MIN_SIZE), 0);
+	if (!alloc->cache_count[class])
+		return NULL;
+
+	return alloc->cache[class][--alloc->cache_count[class]];
+}
+
+static bool binder_alloc_cache_put(struct binder_alloc *alloc,
+				   struct binder_buffer *buffer,
+				   size_t buffer_size)
+{
+	int class;
+
+	if (!alloc->vma || buffer_size < BINDER_CACHE_MIN_SIZE)
+		return false;
+
+	class = ilog2(buffer_size) - ilog2(BINDER_CACHE_MIN_SIZE);
+	if (class >= BINDER_CACHE_CLASSES ||
+	    alloc->cache_count[class] == BINDER_CACHE_DEPTH)
+		return false;
+
+	alloc->cache[class][alloc->cache_count[class]++] = buffer;
+	return true;
+}
+
+static bool binder_alloc_cache_flush_locked(struct binder_alloc *alloc)
+{
+	struct binder_buffer *buffer;
+	bool flushed = false;
+	int class;
+
+	for (class = 0; class < BINDER_CACHE_CLASSES; class++) {
+		while (alloc->cache_count[class]) {
+			buffer = alloc->cache[class][--alloc->cache_count[class]];
+			binder_release_buf_locked(alloc, buffer,
+				binder_alloc_buffer_size(alloc, buffer));
+			flushed = true;
+		}
+	}
+
+	return flushed;
+}
+
 static struct binder_buffer *binder_alloc_new_buf_locked(
 				struct binder_alloc *alloc,
 				size_t data_size,
@@ -357,7 +426,7 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 				size_t extra_buffers_size,
 				int is_async)
 {
-	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
 	struct rb_node *best_fit = NULL;
@@ -400,6 +469,20 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 	/* Pad 0-size buffers so they get assigned unique addresses */
 	size = max(size, sizeof(void *));
 
+	/*
+	 * A cached buffer is as big as the request and all its pages are
+	 * still populated, so it can be handed out as it is.
+	 */
+	buffer = binder_alloc_cache_get(alloc, size);
+	if (buffer) {
+		binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
+			     "%d: binder_alloc_buf size %zd got cached buffer %pK\n",
+			      alloc->pid, size, buffer);
+		goto got_buffer;
+	}
+
+retry:
+	n = alloc->free_buffers.rb_node;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
@@ -415,6 +498,8 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 			break;
 		}
 	}
+	if (best_fit == NULL && binder_alloc_cache_flush_locked(alloc))
+		goto retry;
 	if (best_fit == NULL) {
 		size_t allocated_buffers = 0;
 		size_t largest_alloc_size = 0;
@@ -489,6 +574,7 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 
 	rb_erase(best_fit, &alloc->free_buffers);
 	buffer->free = 0;
+got_buffer:
 	buffer->allow_user_free = 0;
 	binder_insert_allocated_buffer_locked(alloc, buffer);
 	binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
@@ -628,11 +714,26 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 			      alloc->pid, size, alloc->free_async_space);
 	}
 
+	rb_erase(&buffer->rb_node, &alloc->allocated_buffers);
+
+	/*
+	 * Keep small buffers around as they are. They stay marked in use,
+	 * so neighbouring frees do not try to merge with them.
+	 */
+	if (binder_alloc_cache_put(alloc, buffer, buffer_size))
+		return;
+
+	binder_release_buf_locked(alloc, buffer, buffer_size);
+}
+
+static void binder_release_buf_locked(struct binder_alloc *alloc,
+				      struct binder_buffer *buffer,
+				      size_t buffer_size)
+{
 	binder_update_page_range(alloc, 0,
 		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
 		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK));
 
-	rb_erase(&buffer->rb_node, &alloc->allocated_buffers);
 	buffer->free = 1;
 	if (!list_is_last(&buffer->entry, &alloc->buffers)) {
 		struct binder_buffer *next = binder_buffer_next(buffer);
@@ -669,6 +770,20 @@ void binder_alloc_free_buf(struct binder_alloc *alloc,
 	mutex_unlock(&alloc->mutex);
 }
 
+/**
+ * binder_alloc_flush_cache() - release all cached buffers
+ * @alloc:	binder_alloc for this proc
+ *
+ * Return the buffers kept for reuse by binder_alloc_free_buf() to the
+ * free tree and put their pages on the binder LRU.
+ */
+void binder_alloc_flush_cache(struct binder_alloc *alloc)
+{
+	mutex_lock(&alloc->mutex);
+	binder_alloc_cache_flush_locked(alloc);
+	mutex_unlock(&alloc->mutex);
+}
+
 /**
  * binder_alloc_mmap_handler() - map virtual address space for proc
  * @alloc:	alloc structure for this proc
@@ -786,6 +901,7 @@ void binder_alloc_deferred_release(struct binder_alloc *alloc)
 		binder_free_buf_locked(alloc, buffer);
 		buffers++;
 	}
+	binder_alloc_cache_flush_locked(alloc);
 
 	while (!list_empty(&alloc->buffers)) {
 		buffer = list_first_entry(&alloc->buffers,
@@ -816,6 +932,7 @@ void binder_alloc_deferred_release(struct binder_alloc *alloc)
 				     __func__, alloc->pid, i, page_addr,
 				     on_lru ? "on lru" : "active");
 			unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+			memcg_kmem_uncharge(alloc->pages[i].page_ptr, 0);
 			__free_page(alloc->pages[i].page_ptr);
 			page_count++;
 		}
@@ -982,6 +1099,7 @@ enum lru_status binder_alloc_free_page(struct list_head *item,
 	trace_binder_unmap_kernel_start(alloc, index);
 
 	unmap_kernel_range(page_addr, PAGE_SIZE);
+	memcg_kmem_uncharge(page->page_ptr, 0);
 	__free_page(page->page_ptr);
 	page->page_ptr = NULL;
 
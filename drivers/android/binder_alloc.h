@@ -26,6 +26,15 @@
 extern struct list_lru binder_alloc_lru;
 struct binder_transaction;
 
+/*
+ * Recently freed small buffers are kept, with their pages still mapped,
+ * in per-size-class slots of their binder_alloc. Class n holds buffers
+ * of BINDER_CACHE_MIN_SIZE << n up to twice that many bytes.
+ */
+#define BINDER_CACHE_MIN_SIZE	128
+#define BINDER_CACHE_CLASSES	6
+#define BINDER_CACHE_DEPTH	2
+
 /**
  * struct binder_buffer - buffer used for binder transactions
  * @entry:              entry alloc->buffers
@@ -92,6 +101,9 @@ struct binder_lru_page {
  * @buffer_size:        size of address space specified via mmap
  * @pid:                pid for associated binder_proc (invariant after init)
  * @pages_high:         high watermark of offset in @pages
+ * @cache:              freed buffers kept for reuse, by size class; they
+ *                      are in neither @free_buffers nor @allocated_buffers
+ * @cache_count:        number of buffers in each @cache class
  *
  * Bookkeeping structure for per-proc address space management for binder
  * buffers. It is normally initialized during binder_init() and binder_mmap()
@@ -113,6 +125,8 @@ struct binder_alloc {
 	uint32_t buffer_free;
 	int pid;
 	size_t pages_high;
+	struct binder_buffer *cache[BINDER_CACHE_CLASSES][BINDER_CACHE_DEPTH];
+	int cache_count[BINDER_CACHE_CLASSES];
 };
 
 #ifdef CONFIG_ANDROID_BINDER_IPC_SELFTEST
@@ -136,6 +150,7 @@ binder_alloc_prepare_to_free(struct binder_alloc *alloc,
 			     uintptr_t user_ptr);
 extern void binder_alloc_free_buf(struct binder_alloc *alloc,
 				  struct binder_buffer *buffer);
+extern void binder_alloc_flush_cache(struct binder_alloc *alloc);
 extern int binder_alloc_mmap_handler(struct binder_alloc *alloc,
 				     struct vm_area_struct *vma);
 extern void binder_alloc_deferred_release(struct binder_alloc *alloc);
@@ -145,6 +145,7 @@ static void binder_selftest_free_buf(struct binder_alloc *alloc,
 
 	for (i = 0; i < BUFFER_NUM; i++)
 		binder_alloc_free_buf(alloc, buffers[seq[i]]);
+	binder_alloc_flush_cache(alloc);
 
 	for (i = 0; i < end / PAGE_SIZE; i++) {
 		/**
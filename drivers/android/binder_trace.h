@@ -169,6 +169,37 @@ TRACE_EVENT(binder_transaction_received,
 	TP_printk("transaction=%d", __entry->debug_id)
 );
 
+TRACE_EVENT(binder_transaction_latency,
+	TP_PROTO(struct binder_transaction *t, u64 queue_ns, u64 exec_ns,
+		 u64 total_ns),
+	TP_ARGS(t, queue_ns, exec_ns, total_ns),
+
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, target_node)
+		__field(int, to_proc)
+		__field(unsigned int, code)
+		__field(unsigned int, flags)
+		__field(u64, queue_ns)
+		__field(u64, exec_ns)
+		__field(u64, total_ns)
+	),
+	TP_fast_assign(
+		__entry->debug_id = t->debug_id;
+		__entry->target_node = t->stats_node;
+		__entry->to_proc = t->stats_pid;
+		__entry->code = t->code;
+		__entry->flags = t->flags;
+		__entry->queue_ns = queue_ns;
+		__entry->exec_ns = exec_ns;
+		__entry->total_ns = total_ns;
+	),
+	TP_printk("transaction=%d dest_node=%d dest_proc=%d code=0x%x flags=0x%x queue_ns=%llu exec_ns=%llu total_ns=%llu",
+		  __entry->debug_id, __entry->target_node, __entry->to_proc,
+		  __entry->code, __entry->flags, __entry->queue_ns,
+		  __entry->exec_ns, __entry->total_ns)
+);
+
 TRACE_EVENT(binder_transaction_node_to_ref,
 	TP_PROTO(struct binder_transaction *t, struct binder_node *node,
 		 struct binder_ref_data *rdata),
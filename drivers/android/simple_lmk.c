@@ -5,12 +5,15 @@
 
 #define pr_fmt(fmt) "simple_lmk: " fmt
 
+#include <linux/delay.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/mm.h>
 #include <linux/moduleparam.h>
 #include <linux/oom.h>
 #include <linux/sort.h>
 #include <linux/vmpressure.h>
+#include "../staging/android/ashmem.h"
 
 /* The minimum number of pages to free per reclaim */
 #define MIN_FREE_PAGES (CONFIG_ANDROID_SIMPLE_LMK_MINFREE * SZ_1M / PAGE_SIZE)
@@ -21,6 +24,22 @@
 /* Timeout in jiffies for each reclaim */
 #define RECLAIM_EXPIRES msecs_to_jiffies(CONFIG_ANDROID_SIMPLE_LMK_TIMEOUT_MSEC)
 
+#ifdef CONFIG_ANDROID_SIMPLE_LMK_PREKILL
+/* Length in jiffies of each stall accounting window */
+#define PREKILL_WINDOW \
+	msecs_to_jiffies(CONFIG_ANDROID_SIMPLE_LMK_PREKILL_WINDOW_MSEC)
+
+/* Total reclaim and compaction stall time allowed per window, in ns */
+#define PREKILL_STALL_NS \
+	(CONFIG_ANDROID_SIMPLE_LMK_PREKILL_STALL_MSEC * NSEC_PER_MSEC)
+#endif
+
+/* Only cached apps (adj >= CACHED_APP_MIN_ADJ) are killed by a pre-kill */
+#define PREKILL_BUCKETS 3
+
+/* Number of attempts to take a victim's mmap_sem before giving up on reaping */
+#define MAX_REAP_RETRIES 10
+
 struct victim_info {
 	struct task_struct *tsk;
 	struct mm_struct *mm;
@@ -45,13 +64,29 @@ static const short adjs[] = {
 	0     /* FOREGROUND_APP_ADJ */
 };
 
+/*
+ * Processes indexed by the adj band they currently fall into, so that finding
+ * victims only needs to look at processes with the targeted importance. Bucket
+ * zero holds every process with an adj outside of the bands and is never
+ * scanned. Only thread group leaders are indexed.
+ */
+static struct hlist_head adj_buckets[ARRAY_SIZE(adjs)];
+static DEFINE_SPINLOCK(adj_bucket_lock);
+
 static struct victim_info victims[MAX_VICTIMS];
+static struct mm_struct *reap_queue[MAX_VICTIMS];
+static struct mm_struct *reap_batch[MAX_VICTIMS];
+static DEFINE_SPINLOCK(reap_lock);
+static DECLARE_WAIT_QUEUE_HEAD(reap_waitq);
+static int nr_to_reap;
 static DECLARE_WAIT_QUEUE_HEAD(oom_waitq);
 static DECLARE_COMPLETION(reclaim_done);
 static DEFINE_RWLOCK(mm_free_lock);
 static int victims_to_kill;
 static atomic_t needs_reclaim = ATOMIC_INIT(0);
+static atomic_t needs_prekill = ATOMIC_INIT(0);
 static atomic_t nr_killed = ATOMIC_INIT(0);
+static atomic_t init_done = ATOMIC_INIT(0);
 
 static int victim_size_cmp(const void *lhs_ptr, const void *rhs_ptr)
 {
@@ -84,27 +119,64 @@ static unsigned long get_total_mm_pages(struct mm_struct *mm)
 	return pages;
 }
 
-static unsigned long find_victims(int *vindex, short target_adj_min,
-				  short target_adj_max)
+static int adj_to_bucket(short adj)
+{
+	int i;
+
+	for (i = 1; i < ARRAY_SIZE(adjs); i++) {
+		if (adj >= adjs[i] && adj < adjs[i - 1])
+			return i;
+	}
+
+	return 0;
+}
+
+/* Must be called with adj_bucket_lock held */
+static void bucket_task(struct task_struct *tsk)
 {
+	short adj = READ_ONCE(tsk->signal->oom_score_adj);
+
+	if (!hlist_unhashed(&tsk->simple_lmk_node))
+		hlist_del(&tsk->simple_lmk_node);
+	hlist_add_head(&tsk->simple_lmk_node, &adj_buckets[adj_to_bucket(adj)]);
+}
+
+static unsigned long find_victims(int *vindex, int bucket)
+{
+	short target_adj_min = adjs[bucket], target_adj_max = adjs[bucket - 1];
 	unsigned long pages_found = 0;
+	int i, nr_cands = *vindex;
 	int old_vindex = *vindex;
 	struct task_struct *tsk;
 
-	for_each_process(tsk) {
+	/*
+	 * Snapshot the bucket into the unused part of the victim array so that
+	 * task locks aren't taken while holding the bucket lock. The tasklist
+	 * lock held by the caller keeps the snapshotted tasks from being freed.
+	 */
+	spin_lock_irq(&adj_bucket_lock);
+	hlist_for_each_entry(tsk, &adj_buckets[bucket], simple_lmk_node) {
+		victims[nr_cands].tsk = tsk;
+		if (++nr_cands == MAX_VICTIMS)
+			break;
+	}
+	spin_unlock_irq(&adj_bucket_lock);
+
+	for (i = old_vindex; i < nr_cands; i++) {
 		struct signal_struct *sig;
 		struct task_struct *vtsk;
 		short adj;
 
 		/*
-		 * Search for suitable tasks with the targeted importance (adj).
-		 * Since only tasks with a positive adj can be targeted, that
-		 * naturally excludes tasks which shouldn't be killed, like init
-		 * and kthreads. Although oom_score_adj can still be changed
-		 * while this code runs, it doesn't really matter. We just need
-		 * to make sure that if the adj changes, we won't deadlock
-		 * trying to lock a task that we locked earlier.
+		 * Although oom_score_adj can still be changed while this code
+		 * runs, it doesn't really matter. We just need to make sure
+		 * that if the adj changes, we won't deadlock trying to lock a
+		 * task that we locked earlier. Since only tasks with a positive
+		 * adj are indexed into a targetable bucket, that naturally
+		 * excludes tasks which shouldn't be killed, like init and
+		 * kthreads.
 		 */
+		tsk = victims[i].tsk;
 		sig = tsk->signal;
 		adj = READ_ONCE(sig->oom_score_adj);
 		if (adj < target_adj_min || adj > target_adj_max - 1 ||
@@ -124,10 +196,7 @@ static unsigned long find_victims(int *vindex, short target_adj_min,
 
 		/* Keep track of the number of pages that have been found */
 		pages_found += victims[*vindex].size;
-
-		/* Make sure there's space left in the victim array */
-		if (++*vindex == MAX_VICTIMS)
-			break;
+		++*vindex;
 	}
 
 	/*
@@ -166,10 +235,115 @@ static int process_victims(int vlen, unsigned long pages_needed)
 	return nr_to_kill;
 }
 
-static void scan_and_kill(unsigned long pages_needed)
+static bool process_shares_mm(struct task_struct *p, struct mm_struct *mm)
+{
+	struct task_struct *t;
+
+	for_each_thread(p, t) {
+		struct mm_struct *t_mm = READ_ONCE(t->mm);
+
+		if (t_mm)
+			return t_mm == mm;
+	}
+
+	return false;
+}
+
+static bool mm_is_reapable(struct mm_struct *mm)
+{
+	struct task_struct *p;
+	bool ret = true;
+
+	/*
+	 * Reaping an mm that's shared with a process that isn't dying, such as
+	 * a vfork child, would corrupt the surviving process' memory.
+	 */
+	rcu_read_lock();
+	for_each_process(p) {
+		if (process_shares_mm(p, mm) && !fatal_signal_pending(p)) {
+			ret = false;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static void reap_mm(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	int retries = 0;
+
+	if (!mm_is_reapable(mm))
+		return;
+
+	while (!down_read_trylock(&mm->mmap_sem)) {
+		if (++retries == MAX_REAP_RETRIES)
+			return;
+		msleep(1);
+	}
+
+	/*
+	 * Zap private mappings the same way MADV_DONTNEED does. Mlocked, huge
+	 * TLB and PFN mappings need extra handling and are left for
+	 * exit_mmap() to clean up.
+	 */
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_flags & (VM_LOCKED | VM_HUGETLB | VM_PFNMAP))
+			continue;
+
+		if (vma_is_anonymous(vma) || !(vma->vm_flags & VM_SHARED))
+			zap_page_range(vma, vma->vm_start,
+				       vma->vm_end - vma->vm_start, NULL);
+	}
+	up_read(&mm->mmap_sem);
+}
+
+static int simple_lmk_reaper_thread(void *data)
+{
+	static const struct sched_param sched_reaper_prio = {
+		.sched_priority = MAX_RT_PRIO - 2
+	};
+
+	sched_setscheduler_nocheck(current, SCHED_FIFO, &sched_reaper_prio);
+
+	while (1) {
+		int i, nr;
+
+		wait_event(reap_waitq, READ_ONCE(nr_to_reap));
+
+		/* Grab the whole batch at once so new kills can be queued */
+		spin_lock(&reap_lock);
+		nr = nr_to_reap;
+		memcpy(reap_batch, reap_queue, nr * sizeof(*reap_batch));
+		nr_to_reap = 0;
+		spin_unlock(&reap_lock);
+
+		/*
+		 * Dropping the reference taken when the victim was queued will
+		 * most likely run exit_mmap() here rather than in the victim's
+		 * context, finishing the teardown on this thread.
+		 */
+		for (i = 0; i < nr; i++) {
+			reap_mm(reap_batch[i]);
+			mmput(reap_batch[i]);
+		}
+	}
+
+	return 0;
+}
+
+static void scan_and_kill(unsigned long pages_needed, int nr_buckets)
 {
 	int i, nr_to_kill = 0, nr_victims = 0, ret;
-	unsigned long pages_found = 0;
+	unsigned long pages_found = 0, pages_purged;
+
+	/* Drop the unpinned ashmem of every candidate before killing any */
+	pages_purged = ashmem_purge(pages_needed, adjs[nr_buckets - 1]);
+	if (pages_purged >= pages_needed)
+		return;
+	pages_needed -= pages_purged;
 
 	/*
 	 * Hold the tasklist lock so tasks don't disappear while scanning. This
@@ -177,16 +351,17 @@ static void scan_and_kill(unsigned long pages_needed)
 	 * is guaranteed to be up to date.
 	 */
 	read_lock(&tasklist_lock);
-	for (i = 1; i < ARRAY_SIZE(adjs); i++) {
-		pages_found += find_victims(&nr_victims, adjs[i], adjs[i - 1]);
+	for (i = 1; i < nr_buckets; i++) {
+		pages_found += find_victims(&nr_victims, i);
 		if (pages_found >= pages_needed || nr_victims == MAX_VICTIMS)
 			break;
 	}
 	read_unlock(&tasklist_lock);
 
-	/* Pretty unlikely but it can happen */
+	/* Pretty unlikely but it can happen; it is expected when pre-killing */
 	if (unlikely(!nr_victims)) {
-		pr_err("No processes available to kill!\n");
+		if (nr_buckets == ARRAY_SIZE(adjs))
+			pr_err("No processes available to kill!\n");
 		return;
 	}
 
@@ -233,10 +408,21 @@ static void scan_and_kill(unsigned long pages_needed)
 		/* Allow the victim to run on any CPU. This won't schedule. */
 		set_cpus_allowed_ptr(vtsk, cpu_all_mask);
 
+		/* Hand the victim's mm to the reaper; it's pinned by the lock */
+		spin_lock(&reap_lock);
+		if (nr_to_reap < MAX_VICTIMS) {
+			atomic_inc(&victim->mm->mm_users);
+			reap_queue[nr_to_reap++] = victim->mm;
+		}
+		spin_unlock(&reap_lock);
+
 		/* Finally release the victim's task lock acquired earlier */
 		task_unlock(vtsk);
 	}
 
+	/* Tear down the victims' memory without waiting for them to exit */
+	wake_up(&reap_waitq);
+
 	/* Wait until all the victims die or until the timeout is reached */
 	ret = wait_for_completion_timeout(&reclaim_done, RECLAIM_EXPIRES);
 	write_lock(&mm_free_lock);
@@ -260,9 +446,15 @@ static int simple_lmk_reclaim_thread(void *data)
 	sched_setscheduler_nocheck(current, SCHED_FIFO, &sched_max_rt_prio);
 
 	while (1) {
-		wait_event(oom_waitq, atomic_read(&needs_reclaim));
-		scan_and_kill(MIN_FREE_PAGES);
-		atomic_set_release(&needs_reclaim, 0);
+		wait_event(oom_waitq, atomic_read(&needs_reclaim) ||
+				      atomic_read(&needs_prekill));
+		if (atomic_read(&needs_reclaim)) {
+			scan_and_kill(MIN_FREE_PAGES, ARRAY_SIZE(adjs));
+			atomic_set_release(&needs_reclaim, 0);
+		} else {
+			scan_and_kill(MIN_FREE_PAGES, PREKILL_BUCKETS);
+		}
+		atomic_set_release(&needs_prekill, 0);
 	}
 
 	return 0;
@@ -285,6 +477,98 @@ void simple_lmk_mm_freed(struct mm_struct *mm)
 	read_unlock(&mm_free_lock);
 }
 
+void simple_lmk_task_fork(struct task_struct *tsk)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&adj_bucket_lock, flags);
+	bucket_task(tsk);
+	spin_unlock_irqrestore(&adj_bucket_lock, flags);
+}
+
+void simple_lmk_task_exit(struct task_struct *tsk)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&adj_bucket_lock, flags);
+	if (!hlist_unhashed(&tsk->simple_lmk_node))
+		hlist_del_init(&tsk->simple_lmk_node);
+	spin_unlock_irqrestore(&adj_bucket_lock, flags);
+}
+
+void simple_lmk_leader_change(struct task_struct *old, struct task_struct *tsk)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&adj_bucket_lock, flags);
+	if (!hlist_unhashed(&old->simple_lmk_node)) {
+		hlist_del_init(&old->simple_lmk_node);
+		bucket_task(tsk);
+	}
+	spin_unlock_irqrestore(&adj_bucket_lock, flags);
+}
+
+void simple_lmk_adj_changed(struct task_struct *tsk)
+{
+	struct task_struct *leader;
+	unsigned long flags;
+
+	/*
+	 * The group leader is read under the bucket lock so that a concurrent
+	 * exec switching leaders either sees the new adj or is seen by us.
+	 */
+	spin_lock_irqsave(&adj_bucket_lock, flags);
+	leader = READ_ONCE(tsk->group_leader);
+	if (!hlist_unhashed(&leader->simple_lmk_node))
+		bucket_task(leader);
+	spin_unlock_irqrestore(&adj_bucket_lock, flags);
+}
+
+#ifdef CONFIG_ANDROID_SIMPLE_LMK_PREKILL
+static DEFINE_SPINLOCK(stall_window_lock);
+static atomic64_t stall_ns = ATOMIC64_INIT(0);
+static unsigned long stall_window_expires = INITIAL_JIFFIES;
+
+u64 simple_lmk_stall_begin(void)
+{
+	if (!atomic_read(&init_done))
+		return 0;
+
+	return ktime_get_ns();
+}
+
+void simple_lmk_stall_end(u64 start)
+{
+	u64 delta;
+
+	if (!start)
+		return;
+
+	delta = ktime_get_ns() - start;
+
+	/* Start a new window if the current one has expired */
+	if (time_after_eq(jiffies, READ_ONCE(stall_window_expires))) {
+		spin_lock(&stall_window_lock);
+		if (time_after_eq(jiffies, stall_window_expires)) {
+			atomic64_set(&stall_ns, 0);
+			WRITE_ONCE(stall_window_expires, jiffies + PREKILL_WINDOW);
+		}
+		spin_unlock(&stall_window_lock);
+	}
+
+	/*
+	 * Kill cached apps when the stall budget for this window is exhausted,
+	 * before reclaim falls apart badly enough to generate vmpressure. The
+	 * budget is refilled so the next pre-kill needs another full budget.
+	 */
+	if (atomic64_add_return(delta, &stall_ns) >= PREKILL_STALL_NS) {
+		atomic64_set(&stall_ns, 0);
+		if (!atomic_cmpxchg_acquire(&needs_prekill, 0, 1))
+			wake_up(&oom_waitq);
+	}
+}
+#endif
+
 static int simple_lmk_vmpressure_cb(struct notifier_block *nb,
 				    unsigned long pressure, void *data)
 {
@@ -302,13 +586,15 @@ static struct notifier_block vmpressure_notif = {
 /* Initialize Simple LMK when lmkd in Android writes to the minfree parameter */
 static int simple_lmk_init_set(const char *val, const struct kernel_param *kp)
 {
-	static atomic_t init_done = ATOMIC_INIT(0);
 	struct task_struct *thread;
 
 	if (!atomic_cmpxchg(&init_done, 0, 1)) {
 		thread = kthread_run_perf_critical(simple_lmk_reclaim_thread,
 						   NULL, "simple_lmkd");
 		BUG_ON(IS_ERR(thread));
+		thread = kthread_run_perf_critical(simple_lmk_reaper_thread,
+						   NULL, "simple_lmkd_reaper");
+		BUG_ON(IS_ERR(thread));
 		BUG_ON(vmpressure_notifier_register(&vmpressure_notif));
 	}
 
@@ -246,6 +246,7 @@ static int __init rmem_cma_setup(struct reserved_mem *rmem)
 	phys_addr_t mask = align - 1;
 	unsigned long node = rmem->fdt_node;
 	struct cma *cma;
+	const __be32 *prop;
 	int err;
 
 	if (!of_get_flat_dt_prop(node, "reusable", NULL) ||
@@ -268,6 +269,10 @@ static int __init rmem_cma_setup(struct reserved_mem *rmem)
 	if (of_get_flat_dt_prop(node, "linux,cma-default", NULL))
 		dma_contiguous_set_default(cma);
 
+	prop = of_get_flat_dt_prop(node, "linux,cma-clean-size", NULL);
+	if (prop)
+		cma_set_clean_size(cma, be32_to_cpup(prop));
+
 	rmem->ops = &rmem_cma_ops;
 	rmem->priv = cma;
 
@@ -30,6 +30,7 @@
 #include <linux/reboot.h>
 #include <linux/security.h>
 #include <linux/io.h>
+#include <linux/sizes.h>
 
 #include <generated/utsrelease.h>
 
@@ -323,6 +324,9 @@ static const char * const fw_path[] = {
 module_param_string(path, fw_path_para, sizeof(fw_path_para), 0644);
 MODULE_PARM_DESC(path, "customized firmware image search path with a higher priority than default path");
 
+/* readahead window for images read straight into their destination */
+#define FW_DIRECT_RA_PAGES	(SZ_2M >> PAGE_SHIFT)
+
 static int fw_read_file_contents(struct file *file, struct firmware_buf *fw_buf)
 {
 	int size;
@@ -337,14 +341,24 @@ static int fw_read_file_contents(struct file *file, struct firmware_buf *fw_buf)
 	if (fw_buf->dest_size > 0 && fw_buf->dest_size < size)
 		return -EINVAL;
 
-	if (fw_buf->dest_addr)
+	if (fw_buf->dest_addr) {
+		/*
+		 * The image lands in the destination region and nothing reads
+		 * it through the page cache again, so fetch it in large
+		 * chunks and drop the cached copy once it has been consumed.
+		 */
+		file->f_ra.ra_pages = max_t(unsigned int, file->f_ra.ra_pages,
+					    FW_DIRECT_RA_PAGES);
 		buf = fw_buf->map_fw_mem(fw_buf->dest_addr,
 					   fw_buf->dest_size, fw_buf->map_data);
-	else
+	} else {
 		buf = vmalloc(size);
+	}
 	if (!buf)
 		return -ENOMEM;
 	rc = kernel_read(file, 0, buf, size);
+	if (fw_buf->dest_addr)
+		invalidate_mapping_pages(file->f_mapping, 0, -1);
 	if (rc != size) {
 		if (rc > 0)
 			rc = -EIO;
@@ -378,7 +378,7 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
-	ktime_t calltime;
+	ktime_t calltime, starttime;
 	int error;
 
 	if (!cb)
@@ -388,7 +388,11 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 
 	pm_dev_dbg(dev, state, info);
 	trace_device_pm_callback_start(dev, info, state.event);
+	starttime = ktime_get();
 	error = cb(dev);
+	if (state.event == PM_EVENT_RESUME)
+		log_resume_latency(dev, info,
+				   ktime_us_delta(ktime_get(), starttime));
 	trace_device_pm_callback_end(dev, error);
 	suspend_report_result(cb, error);
 
@@ -849,9 +853,24 @@ void dpm_resume(pm_message_t state)
 	pm_transition = state;
 	async_error = 0;
 
-	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
+	list_for_each_entry(dev, &dpm_suspended_list, power.entry)
 		reinit_completion(&dev->power.completion);
-		if (is_async(dev)) {
+
+	/*
+	 * Start the resume_first devices ahead of the other async ones, so
+	 * that the display does not queue up behind slow devices. Only
+	 * start anything after all the completions have been reset, or a
+	 * child could miss waiting for its parent.
+	 */
+	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
+		if (is_async(dev) && dev->power.resume_first) {
+			get_device(dev);
+			async_schedule(async_resume, dev);
+		}
+	}
+
+	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
+		if (is_async(dev) && !dev->power.resume_first) {
 			get_device(dev);
 			async_schedule(async_resume, dev);
 		}
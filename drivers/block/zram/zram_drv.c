@@ -32,6 +32,9 @@
 #include <linux/idr.h>
 #include <linux/sysfs.h>
 #include <linux/debugfs.h>
+#include <linux/freezer.h>
+#include <linux/kthread.h>
+#include <linux/xxhash.h>
 
 #include "zram_drv.h"
 
@@ -51,6 +54,8 @@ static unsigned int num_devices = 1;
 static size_t huge_class_size;
 
 static void zram_free_page(struct zram *zram, size_t index);
+static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
+				struct bio *bio, bool partial_io);
 
 static void zram_slot_lock(struct zram *zram, u32 index)
 {
@@ -132,6 +137,262 @@ static void zram_set_obj_size(struct zram *zram,
 	zram->table[index].value = (flags << ZRAM_FLAG_SHIFT) | size;
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+static struct kmem_cache *zram_dedup_cache;
+
+static bool zram_dedup_enabled(struct zram *zram)
+{
+	return zram->hash;
+}
+
+/* Returns the zsmalloc handle backing a slot, be it shared or not */
+static unsigned long zram_get_obj_handle(struct zram *zram, u32 index)
+{
+	unsigned long handle = zram_get_handle(zram, index);
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP))
+		return ((struct zram_dedup_entry *)handle)->handle;
+
+	return handle;
+}
+
+static struct zram_hash *zram_dedup_bucket(struct zram *zram, u64 checksum)
+{
+	return &zram->hash[checksum & (zram->hash_size - 1)];
+}
+
+/*
+ * Look for a stored object that is identical to the compressed data in
+ * @mem and take a reference to it. Identical compressed data means identical
+ * pages, since all objects are produced by the same compressor.
+ */
+static struct zram_dedup_entry *zram_dedup_find(struct zram *zram, void *mem,
+					unsigned int len, u64 checksum)
+{
+	struct zram_hash *hash = zram_dedup_bucket(zram, checksum);
+	struct zram_dedup_entry *entry;
+
+	spin_lock(&hash->lock);
+	hlist_for_each_entry(entry, &hash->head, node) {
+		bool match;
+		void *src;
+
+		if (entry->checksum != checksum || entry->len != len)
+			continue;
+
+		src = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+		match = !memcmp(src, mem, len);
+		zs_unmap_object(zram->mem_pool, entry->handle);
+		if (match) {
+			entry->refcount++;
+			spin_unlock(&hash->lock);
+			return entry;
+		}
+	}
+	spin_unlock(&hash->lock);
+
+	return NULL;
+}
+
+static struct zram_dedup_entry *zram_dedup_new(struct zram *zram,
+			unsigned long handle, unsigned int len, u64 checksum)
+{
+	struct zram_hash *hash = zram_dedup_bucket(zram, checksum);
+	struct zram_dedup_entry *entry;
+
+	entry = kmem_cache_alloc(zram_dedup_cache, GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->checksum = checksum;
+	entry->len = len;
+	entry->refcount = 1;
+
+	spin_lock(&hash->lock);
+	hlist_add_head(&entry->node, &hash->head);
+	spin_unlock(&hash->lock);
+
+	return entry;
+}
+
+static void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	struct zram_hash *hash = zram_dedup_bucket(zram, entry->checksum);
+
+	spin_lock(&hash->lock);
+	if (--entry->refcount) {
+		spin_unlock(&hash->lock);
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return;
+	}
+	hlist_del(&entry->node);
+	spin_unlock(&hash->lock);
+
+	zs_free(zram->mem_pool, entry->handle);
+	atomic64_sub(entry->len, &zram->stats.compr_data_size);
+	kmem_cache_free(zram_dedup_cache, entry);
+}
+
+/* Is the slot's object also used by other slots? */
+static bool zram_dedup_shared(struct zram *zram, u32 index)
+{
+	struct zram_dedup_entry *entry;
+	struct zram_hash *hash;
+	bool shared;
+
+	if (!zram_test_flag(zram, index, ZRAM_DEDUP))
+		return false;
+
+	entry = (struct zram_dedup_entry *)zram_get_handle(zram, index);
+	hash = zram_dedup_bucket(zram, entry->checksum);
+
+	spin_lock(&hash->lock);
+	shared = entry->refcount > 1;
+	spin_unlock(&hash->lock);
+
+	return shared;
+}
+
+/*
+ * Turn a slot that is the only user of its object back into a plain one,
+ * so the object can be replaced. Fails while it is shared.
+ */
+static bool zram_dedup_unshare(struct zram *zram, u32 index)
+{
+	struct zram_dedup_entry *entry;
+	struct zram_hash *hash;
+
+	if (!zram_test_flag(zram, index, ZRAM_DEDUP))
+		return true;
+
+	entry = (struct zram_dedup_entry *)zram_get_handle(zram, index);
+	hash = zram_dedup_bucket(zram, entry->checksum);
+
+	spin_lock(&hash->lock);
+	if (entry->refcount > 1) {
+		spin_unlock(&hash->lock);
+		return false;
+	}
+	hlist_del(&entry->node);
+	spin_unlock(&hash->lock);
+
+	zram_clear_flag(zram, index, ZRAM_DEDUP);
+	zram_set_handle(zram, index, entry->handle);
+	kmem_cache_free(zram_dedup_cache, entry);
+
+	return true;
+}
+
+static bool zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	size_t i;
+
+	if (!zram->use_dedup)
+		return true;
+
+	/* Aim for buckets holding a handful of objects when the disk is full */
+	zram->hash_size = roundup_pow_of_two(max_t(size_t, num_pages >> 3, 1));
+	zram->hash = vzalloc(zram->hash_size * sizeof(*zram->hash));
+	if (!zram->hash)
+		return false;
+
+	for (i = 0; i < zram->hash_size; i++) {
+		spin_lock_init(&zram->hash[i].lock);
+		INIT_HLIST_HEAD(&zram->hash[i].head);
+	}
+
+	return true;
+}
+
+static void zram_dedup_fini(struct zram *zram)
+{
+	vfree(zram->hash);
+	zram->hash = NULL;
+	zram->hash_size = 0;
+}
+
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static int zram_dedup_create_cache(void)
+{
+	zram_dedup_cache = KMEM_CACHE(zram_dedup_entry, 0);
+	return zram_dedup_cache ? 0 : -ENOMEM;
+}
+
+static void zram_dedup_destroy_cache(void)
+{
+	kmem_cache_destroy(zram_dedup_cache);
+}
+#else
+struct zram_dedup_entry;
+
+static bool zram_dedup_enabled(struct zram *zram) { return false; }
+static unsigned long zram_get_obj_handle(struct zram *zram, u32 index)
+{
+	return zram_get_handle(zram, index);
+}
+static struct zram_dedup_entry *zram_dedup_find(struct zram *zram, void *mem,
+					unsigned int len, u64 checksum)
+{
+	return NULL;
+}
+static struct zram_dedup_entry *zram_dedup_new(struct zram *zram,
+			unsigned long handle, unsigned int len, u64 checksum)
+{
+	return NULL;
+}
+static void zram_dedup_put(struct zram *zram,
+			   struct zram_dedup_entry *entry) {}
+static bool zram_dedup_shared(struct zram *zram, u32 index)
+{
+	return false;
+}
+static bool zram_dedup_unshare(struct zram *zram, u32 index)
+{
+	return true;
+}
+static bool zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	return true;
+}
+static void zram_dedup_fini(struct zram *zram) {}
+static int zram_dedup_create_cache(void) { return 0; }
+static void zram_dedup_destroy_cache(void) {}
+#endif
+
 #if PAGE_SIZE != 4096
 static inline bool is_partial_io(struct bio_vec *bvec)
 {
@@ -284,6 +545,37 @@ static ssize_t mem_used_max_store(struct device *dev,
 	return len;
 }
 
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (zram_allocated(zram, index) &&
+		    !zram_test_flag(zram, index, ZRAM_WB) &&
+		    !zram_test_flag(zram, index, ZRAM_SAME))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+		cond_resched();
+	}
+
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
 #ifdef CONFIG_ZRAM_WRITEBACK
 static bool zram_wb_enabled(struct zram *zram)
 {
@@ -462,6 +754,26 @@ static unsigned long get_entry_bdev(struct zram *zram)
 	return entry;
 }
 
+/* Allocate @nr contiguous blocks so they can be written with a single bio */
+static unsigned long get_entries_bdev(struct zram *zram, unsigned int nr)
+{
+	unsigned long entry;
+
+	spin_lock(&zram->bitmap_lock);
+	/* skip 0 bit to confuse zram.handle = 0 */
+	entry = bitmap_find_next_zero_area(zram->bitmap, zram->nr_pages, 1,
+					   nr, 0);
+	if (entry + nr > zram->nr_pages) {
+		spin_unlock(&zram->bitmap_lock);
+		return 0;
+	}
+
+	bitmap_set(zram->bitmap, entry, nr);
+	spin_unlock(&zram->bitmap_lock);
+
+	return entry;
+}
+
 static void put_entry_bdev(struct zram *zram, unsigned long entry)
 {
 	int was_set;
@@ -563,6 +875,7 @@ static int read_from_bdev_sync(struct zram *zram, struct bio_vec *bvec,
 static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 			unsigned long entry, struct bio *parent, bool sync)
 {
+	atomic64_inc(&zram->stats.bd_reads);
 	if (sync)
 		return read_from_bdev_sync(zram, bvec, entry, parent);
 	else
@@ -605,18 +918,324 @@ static int write_to_bdev(struct zram *zram, struct bio_vec *bvec,
 
 	submit_bio(WRITE, bio);
 	*pentry = entry;
+	atomic64_inc(&zram->stats.bd_count);
+	atomic64_inc(&zram->stats.bd_writes);
+
+	return 0;
+}
+
+static void zram_wb_clear(struct zram *zram, u32 index)
+{
+	unsigned long entry;
+
+	zram_clear_flag(zram, index, ZRAM_WB);
+	entry = zram_get_element(zram, index);
+	zram_set_element(zram, index, 0);
+	put_entry_bdev(zram, entry);
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+/* Number of pages written to the backing device with a single bio */
+#define ZRAM_WB_BATCH 32
+
+/* Interval between the idle aging passes of the writeback thread */
+#define ZRAM_WB_INTERVAL msecs_to_jiffies(60 * MSEC_PER_SEC)
+
+/* Default number of intervals a page has to stay idle to be written back */
+#define ZRAM_WB_IDLE_AGE 5
+
+/*
+ * The writeback thread keeps its own idle tracking in idle_age, separate
+ * from ZRAM_IDLE which belongs to userspace's "idle" marking: 0 means the
+ * slot was accessed since the last aging pass, n + 1 that it has been left
+ * alone for n whole intervals.
+ */
+static unsigned int zram_wb_slot_age(struct zram *zram, u32 index)
+{
+	return zram->idle_age[index] ? zram->idle_age[index] - 1 : 0;
+}
+
+static bool zram_wb_idle_slot(struct zram *zram, u32 index)
+{
+	return zram_get_handle(zram, index) &&
+	       zram_wb_slot_age(zram, index) &&
+	       !zram_test_flag(zram, index, ZRAM_WB) &&
+	       !zram_test_flag(zram, index, ZRAM_SAME);
+}
+
+/*
+ * Age every slot by one interval: slots that weren't touched since the last
+ * pass get older, the rest start over. The ages of the candidates for
+ * writeback are collected into @hist, except for incompressible ones which
+ * are always written first and only counted.
+ */
+static unsigned long zram_wb_age(struct zram *zram, unsigned int *hist)
+{
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index, nr_huge = 0;
+	unsigned int age;
+
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index) ||
+		    zram_test_flag(zram, index, ZRAM_WB) ||
+		    zram_test_flag(zram, index, ZRAM_SAME))
+			goto next;
+
+		if (zram->idle_age[index] < U8_MAX)
+			zram->idle_age[index]++;
+
+		age = zram_wb_slot_age(zram, index);
+		if (!age)
+			goto next;
+
+		if (zram_test_flag(zram, index, ZRAM_HUGE))
+			nr_huge++;
+		else if (age >= zram->wb_idle_age)
+			hist[age]++;
+next:
+		zram_slot_unlock(zram, index);
+		cond_resched();
+	}
+
+	return nr_huge;
+}
+
+/*
+ * Write a batch of slots to contiguous blocks on the backing device and then
+ * drop their in-memory copies, unless they changed while being written.
+ */
+static int zram_wb_batch(struct zram *zram, struct page **pages, u32 *indexes,
+			 unsigned long *handles, unsigned int nr)
+{
+	unsigned long entry;
+	struct bio *bio;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < nr; i++) {
+		ret = __zram_bvec_read(zram, pages[i], indexes[i], NULL, false);
+		if (ret)
+			return ret;
+	}
+
+	entry = get_entries_bdev(zram, nr);
+	if (!entry)
+		return -ENOSPC;
+
+	bio = bio_alloc(GFP_KERNEL, nr);
+	bio->bi_iter.bi_sector = entry * (PAGE_SIZE >> 9);
+	bio->bi_bdev = zram->bdev;
+	for (i = 0; i < nr; i++)
+		bio_add_page(bio, pages[i], PAGE_SIZE, 0);
+
+	ret = submit_bio_wait(WRITE, bio);
+	bio_put(bio);
+
+	for (i = 0; i < nr; i++) {
+		u32 index = indexes[i];
+
+		zram_slot_lock(zram, index);
+		if (ret || zram_get_handle(zram, index) != handles[i] ||
+		    !zram_wb_idle_slot(zram, index)) {
+			put_entry_bdev(zram, entry + i);
+			zram_slot_unlock(zram, index);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_set_element(zram, index, entry + i);
+		zram_slot_unlock(zram, index);
+
+		atomic64_inc(&zram->stats.pages_stored);
+		atomic64_inc(&zram->stats.bd_count);
+		atomic64_inc(&zram->stats.bd_writes);
+	}
+
+	return ret;
+}
+
+static void zram_wb_run(struct zram *zram, struct page **pages,
+			unsigned int *hist)
+{
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long budget = READ_ONCE(zram->wb_limit);
+	unsigned int min_age = READ_ONCE(zram->wb_idle_age);
+	unsigned long handles[ZRAM_WB_BATCH];
+	u32 indexes[ZRAM_WB_BATCH];
+	unsigned long index, nr_found;
+	unsigned int nr = 0, age;
+
+	if (!budget)
+		return;
+
+	/*
+	 * Incompressible pages go first. Then find the youngest age that
+	 * still fits in the budget so that the oldest pages are written.
+	 */
+	memset(hist, 0, (U8_MAX + 1) * sizeof(*hist));
+	nr_found = zram_wb_age(zram, hist);
+	for (age = U8_MAX; age > min_age; age--) {
+		if (nr_found + hist[age] >= budget)
+			break;
+		nr_found += hist[age];
+	}
+	min_age = age;
+
+	for (index = 0; index < nr_pages && budget; index++) {
+		zram_slot_lock(zram, index);
+		if (zram_wb_idle_slot(zram, index) &&
+		    (zram_test_flag(zram, index, ZRAM_HUGE) ||
+		     zram_wb_slot_age(zram, index) >= min_age)) {
+			handles[nr] = zram_get_handle(zram, index);
+			indexes[nr++] = index;
+			budget--;
+		}
+		zram_slot_unlock(zram, index);
+
+		if (nr == ZRAM_WB_BATCH || (nr && (!budget ||
+					   index == nr_pages - 1))) {
+			if (zram_wb_batch(zram, pages, indexes, handles, nr))
+				break;
+			nr = 0;
+		}
+		cond_resched();
+	}
+}
+
+static int zram_wb_thread(void *data)
+{
+	struct page *pages[ZRAM_WB_BATCH];
+	unsigned int hist[U8_MAX + 1];
+	struct zram *zram = data;
+	int i;
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i])
+			goto out;
+	}
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		freezable_schedule_timeout_interruptible(ZRAM_WB_INTERVAL);
+		if (kthread_should_stop())
+			break;
+
+		zram_wb_run(zram, pages, hist);
+	}
+
+out:
+	while (i--)
+		__free_page(pages[i]);
+
+	/* Stay around until kthread_stop() if the pages couldn't be had */
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(MAX_SCHEDULE_TIMEOUT);
+
+	return 0;
+}
+
+/* Must be called on an initialized device with a backing device */
+static void zram_wb_start(struct zram *zram)
+{
+	struct task_struct *thread;
+
+	zram->idle_age = vzalloc(zram->disksize >> PAGE_SHIFT);
+	if (!zram->idle_age)
+		goto err;
+
+	thread = kthread_run(zram_wb_thread, zram, "%s_wb",
+			     zram->disk->disk_name);
+	if (IS_ERR(thread)) {
+		vfree(zram->idle_age);
+		zram->idle_age = NULL;
+		goto err;
+	}
+
+	zram->wb_thread = thread;
+	return;
+err:
+	pr_warn("Cannot start writeback thread for %s\n",
+		zram->disk->disk_name);
+}
+
+static void zram_wb_stop(struct zram *zram)
+{
+	if (!zram->wb_thread)
+		return;
+
+	kthread_stop(zram->wb_thread);
+	zram->wb_thread = NULL;
+	vfree(zram->idle_age);
+	zram->idle_age = NULL;
+}
+
+static ssize_t writeback_limit_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%lu\n", READ_ONCE(zram->wb_limit));
+}
+
+static ssize_t writeback_limit_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long val;
+	int err;
+
+	err = kstrtoul(buf, 10, &val);
+	if (err)
+		return err;
+
+	WRITE_ONCE(zram->wb_limit, val);
+	return len;
+}
+
+static ssize_t writeback_idle_age_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			 READ_ONCE(zram->wb_idle_age));
+}
+
+static ssize_t writeback_idle_age_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+	int err;
+
+	err = kstrtouint(buf, 10, &val);
+	if (err)
+		return err;
+	if (!val || val > U8_MAX)
+		return -EINVAL;
 
-	return 0;
+	WRITE_ONCE(zram->wb_idle_age, val);
+	return len;
 }
 
-static void zram_wb_clear(struct zram *zram, u32 index)
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
 {
-	unsigned long entry;
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
 
-	zram_clear_flag(zram, index, ZRAM_WB);
-	entry = zram_get_element(zram, index);
-	zram_set_element(zram, index, 0);
-	put_entry_bdev(zram, entry);
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+		"%8llu %8llu %8llu\n",
+		(u64)atomic64_read(&zram->stats.bd_count) << (PAGE_SHIFT - 12),
+		(u64)atomic64_read(&zram->stats.bd_reads) << (PAGE_SHIFT - 12),
+		(u64)atomic64_read(&zram->stats.bd_writes) << (PAGE_SHIFT - 12));
+	up_read(&zram->init_lock);
+
+	return ret;
 }
 
 #else
@@ -636,6 +1255,8 @@ static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 	return -EIO;
 }
 static void zram_wb_clear(struct zram *zram, u32 index) {}
+static void zram_wb_start(struct zram *zram) {}
+static void zram_wb_stop(struct zram *zram) {}
 #endif
 
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
@@ -699,12 +1320,14 @@ static ssize_t read_block_state(struct file *file, char __user *buf,
 
 		ts = ktime_to_timespec64(zram->table[index].ac_time);
 		copied = snprintf(kbuf + written, count,
-			"%12zd %12lld.%06lu %c%c%c\n",
+			"%12zd %12lld.%06lu %c%c%c%c%c\n",
 			index, (s64)ts.tv_sec,
 			ts.tv_nsec / NSEC_PER_USEC,
 			zram_test_flag(zram, index, ZRAM_SAME) ? 's' : '.',
 			zram_test_flag(zram, index, ZRAM_WB) ? 'w' : '.',
-			zram_test_flag(zram, index, ZRAM_HUGE) ? 'h' : '.');
+			zram_test_flag(zram, index, ZRAM_HUGE) ? 'h' : '.',
+			zram_test_flag(zram, index, ZRAM_IDLE) ? 'i' : '.',
+			zram_test_flag(zram, index, ZRAM_RECOMP) ? 'r' : '.');
 
 		if (count < copied) {
 			zram_slot_unlock(zram, index);
@@ -817,6 +1440,206 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recomp_algorithm)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	if (!zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strcpy(zram->recomp_algorithm, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+/*
+ * Recompress a single slot with the secondary algorithm. The slot lock must
+ * be held. @page is a scratch page for the decompressed data. Returns true if
+ * the slot was replaced with a smaller object.
+ */
+static bool zram_recompress_slot(struct zram *zram, u32 index,
+				 struct page *page)
+{
+	unsigned long handle, new_handle;
+	unsigned int size, new_size;
+	struct zcomp_strm *zstrm;
+	void *src, *dst;
+	int ret;
+
+	handle = zram_get_obj_handle(zram, index);
+	size = zram_get_obj_size(zram, index);
+
+	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	zstrm = zcomp_stream_get(zram->comp);
+	dst = kmap_atomic(page);
+	ret = zcomp_decompress(zstrm, src, size, dst);
+	kunmap_atomic(dst);
+	zcomp_stream_put(zram->comp);
+	zs_unmap_object(zram->mem_pool, handle);
+	if (ret)
+		return false;
+
+	zstrm = zcomp_stream_get(zram->recomp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &new_size);
+	kunmap_atomic(src);
+
+	/* Only keep the result if it actually saves memory */
+	if (ret || new_size >= size)
+		goto out;
+
+	/* We can't sleep with the slot lock held, so don't try hard */
+	new_handle = zs_malloc(zram->mem_pool, new_size,
+			__GFP_KSWAPD_RECLAIM |
+			__GFP_NOWARN |
+			__GFP_HIGHMEM |
+			__GFP_MOVABLE);
+	if (!new_handle)
+		goto out;
+
+	dst = zs_map_object(zram->mem_pool, new_handle, ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, new_size);
+	zs_unmap_object(zram->mem_pool, new_handle);
+	zcomp_stream_put(zram->recomp);
+
+	/*
+	 * Only drop the dedup entry once the replacement exists, so a slot
+	 * that doesn't recompress stays shareable. The entry may have gained
+	 * users since recompress_store() checked it.
+	 */
+	if (!zram_dedup_unshare(zram, index)) {
+		zs_free(zram->mem_pool, new_handle);
+		return false;
+	}
+
+	zs_free(zram->mem_pool, handle);
+	atomic64_sub(size - new_size, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.recomp_pages);
+
+	zram_set_handle(zram, index, new_handle);
+	zram_set_obj_size(zram, index, new_size);
+	zram_set_flag(zram, index, ZRAM_RECOMP);
+	return true;
+
+out:
+	zcomp_stream_put(zram->recomp);
+	return false;
+}
+
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+	struct page *page;
+	ssize_t ret = len;
+
+	if (!sysfs_streq(buf, "idle"))
+		return -EINVAL;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->recomp) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (zram_get_handle(zram, index) &&
+		    zram_test_flag(zram, index, ZRAM_IDLE) &&
+		    !zram_test_flag(zram, index, ZRAM_WB) &&
+		    !zram_test_flag(zram, index, ZRAM_SAME) &&
+		    !zram_test_flag(zram, index, ZRAM_HUGE) &&
+		    !zram_test_flag(zram, index, ZRAM_RECOMP) &&
+		    !zram_dedup_shared(zram, index))
+			zram_recompress_slot(zram, index, page);
+		zram_slot_unlock(zram, index);
+		cond_resched();
+	}
+
+out:
+	up_read(&zram->init_lock);
+	__free_page(page);
+
+	return ret;
+}
+
+static struct zcomp *zram_slot_comp(struct zram *zram, u32 index)
+{
+	if (zram_test_flag(zram, index, ZRAM_RECOMP))
+		return zram->recomp;
+
+	return zram->comp;
+}
+
+static int zram_recomp_create(struct zram *zram)
+{
+	struct zcomp *comp;
+
+	if (!zram->recomp_algorithm[0])
+		return 0;
+
+	comp = zcomp_create(zram->recomp_algorithm);
+	if (IS_ERR(comp)) {
+		pr_err("Cannot initialise %s recompressing backend\n",
+				zram->recomp_algorithm);
+		return PTR_ERR(comp);
+	}
+
+	zram->recomp = comp;
+	return 0;
+}
+
+static void zram_recomp_destroy(struct zram *zram)
+{
+	if (zram->recomp)
+		zcomp_destroy(zram->recomp);
+	zram->recomp = NULL;
+}
+#else
+static struct zcomp *zram_slot_comp(struct zram *zram, u32 index)
+{
+	return zram->comp;
+}
+static int zram_recomp_create(struct zram *zram) { return 0; }
+static void zram_recomp_destroy(struct zram *zram) {}
+#endif
+
 static ssize_t compact_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -873,7 +1696,7 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
@@ -881,7 +1704,8 @@ static ssize_t mm_stat_show(struct device *dev,
 			max_used << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.same_pages),
 			pool_stats.pages_compacted,
-			(u64)atomic64_read(&zram->stats.huge_pages));
+			(u64)atomic64_read(&zram->stats.huge_pages),
+			(u64)atomic64_read(&zram->stats.dup_data_size));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -896,9 +1720,11 @@ static ssize_t debug_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-			"version: %d\n%8llu\n",
+			"version: %d\n%8llu %8llu %8llu\n",
 			version,
-			(u64)atomic64_read(&zram->stats.writestall));
+			(u64)atomic64_read(&zram->stats.writestall),
+			(u64)atomic64_read(&zram->stats.async_writes),
+			(u64)atomic64_read(&zram->stats.recomp_pages));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -917,6 +1743,7 @@ static void zram_meta_free(struct zram *zram, u64 disksize)
 	for (index = 0; index < num_pages; index++)
 		zram_free_page(zram, index);
 
+	zram_dedup_fini(zram);
 	zs_destroy_pool(zram->mem_pool);
 	vfree(zram->table);
 }
@@ -936,6 +1763,12 @@ static bool zram_meta_alloc(struct zram *zram, u64 disksize)
 		return false;
 	}
 
+	if (!zram_dedup_init(zram, num_pages)) {
+		zs_destroy_pool(zram->mem_pool);
+		vfree(zram->table);
+		return false;
+	}
+
 	if (!huge_class_size)
 		huge_class_size = zs_huge_class_size(zram->mem_pool);
 	return true;
@@ -951,6 +1784,12 @@ static void zram_free_page(struct zram *zram, size_t index)
 	unsigned long handle;
 
 	zram_reset_access(zram, index);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_clear_flag(zram, index, ZRAM_RECOMP);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	if (zram->idle_age)
+		zram->idle_age[index] = 0;
+#endif
 
 	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
 		zram_clear_flag(zram, index, ZRAM_HUGE);
@@ -979,10 +1818,14 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (!handle)
 		return;
 
-	zs_free(zram->mem_pool, handle);
-
-	atomic64_sub(zram_get_obj_size(zram, index),
-			&zram->stats.compr_data_size);
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		zram_dedup_put(zram, (struct zram_dedup_entry *)handle);
+	} else {
+		zs_free(zram->mem_pool, handle);
+		atomic64_sub(zram_get_obj_size(zram, index),
+				&zram->stats.compr_data_size);
+	}
 	atomic64_dec(&zram->stats.pages_stored);
 
 	zram_set_handle(zram, index, 0);
@@ -1030,6 +1873,7 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 
 	size = zram_get_obj_size(zram, index);
 
+	handle = zram_get_obj_handle(zram, index);
 	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE) {
 		dst = kmap_atomic(page);
@@ -1037,12 +1881,13 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		kunmap_atomic(dst);
 		ret = 0;
 	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
+		struct zcomp *comp = zram_slot_comp(zram, index);
+		struct zcomp_strm *zstrm = zcomp_stream_get(comp);
 
 		dst = kmap_atomic(page);
 		ret = zcomp_decompress(zstrm, src, size, dst);
 		kunmap_atomic(dst);
-		zcomp_stream_put(zram->comp);
+		zcomp_stream_put(comp);
 	}
 	zs_unmap_object(zram->mem_pool, handle);
 	zram_slot_unlock(zram, index);
@@ -1100,6 +1945,9 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
 	bool allow_wb = true;
+	struct zram_dedup_entry *entry;
+	bool dedup = false;
+	u64 checksum = 0;
 
 	mem = kmap_atomic(page);
 	if (page_same_filled(mem, &element)) {
@@ -1139,6 +1987,22 @@ compress_again:
 		}
 	}
 
+	if (zram_dedup_enabled(zram) && comp_len != PAGE_SIZE) {
+		checksum = xxh64(zstrm->buffer, comp_len, 0);
+		entry = zram_dedup_find(zram, zstrm->buffer, comp_len,
+					checksum);
+		if (entry) {
+			zcomp_stream_put(zram->comp);
+			/* Drop the handle allocated by the slow path */
+			if (handle)
+				zs_free(zram->mem_pool, handle);
+			handle = (unsigned long)entry;
+			dedup = true;
+			atomic64_add(comp_len, &zram->stats.dup_data_size);
+			goto out;
+		}
+	}
+
 	/*
 	 * handle allocation has 2 paths:
 	 * a) fast path is executed with preemption disabled (for
@@ -1190,6 +2054,15 @@ compress_again:
 	zcomp_stream_put(zram->comp);
 	zs_unmap_object(zram->mem_pool, handle);
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
+
+	/* Make the new object available to future duplicates */
+	if (zram_dedup_enabled(zram) && comp_len != PAGE_SIZE) {
+		entry = zram_dedup_new(zram, handle, comp_len, checksum);
+		if (entry) {
+			handle = (unsigned long)entry;
+			dedup = true;
+		}
+	}
 out:
 	/*
 	 * Free memory associated with this sector
@@ -1209,6 +2082,8 @@ out:
 	}  else {
 		zram_set_handle(zram, index, handle);
 		zram_set_obj_size(zram, index, comp_len);
+		if (dedup)
+			zram_set_flag(zram, index, ZRAM_DEDUP);
 	}
 	zram_slot_unlock(zram, index);
 
@@ -1323,6 +2198,11 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	zram_slot_lock(zram, index);
 	zram_accessed(zram, index);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	if (zram->idle_age)
+		zram->idle_age[index] = 0;
+#endif
 	zram_slot_unlock(zram, index);
 
 	if (unlikely(ret < 0)) {
@@ -1335,7 +2215,7 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	return ret;
 }
 
-static void __zram_make_request(struct zram *zram, struct bio *bio)
+static void zram_bio_rw(struct zram *zram, struct bio *bio)
 {
 	int offset, rw;
 	u32 index;
@@ -1346,12 +2226,6 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 	offset = (bio->bi_iter.bi_sector &
 		  (SECTORS_PER_PAGE - 1)) << SECTOR_SHIFT;
 
-	if (unlikely(bio->bi_rw & REQ_DISCARD)) {
-		zram_bio_discard(zram, index, offset, bio);
-		bio_endio(bio);
-		return;
-	}
-
 	rw = bio_data_dir(bio);
 	bio_for_each_segment(bvec, bio, iter) {
 		struct bio_vec bv = bvec;
@@ -1377,6 +2251,144 @@ out:
 	bio_io_error(bio);
 }
 
+#ifdef CONFIG_ZRAM_ASYNC_WRITE
+/* Maximum number of write bios queued to the workers per online CPU */
+#define ZRAM_ASYNC_DEPTH 32
+
+static struct workqueue_struct *zram_async_wq;
+
+static void zram_async_work(struct work_struct *work)
+{
+	struct zram_async_queue *q = container_of(work, typeof(*q), work);
+	struct zram *zram = q->zram;
+	struct bio_list bios;
+	struct bio *bio;
+
+	spin_lock_irq(&q->lock);
+	bios = q->bios;
+	bio_list_init(&q->bios);
+	spin_unlock_irq(&q->lock);
+
+	while ((bio = bio_list_pop(&bios))) {
+		zram_bio_rw(zram, bio);
+		atomic64_inc(&zram->stats.async_writes);
+		atomic_dec(&zram->async_inflight);
+	}
+}
+
+/*
+ * Hand a write bio off to a compression worker. Returns false when the
+ * workers are saturated, in which case the caller compresses the bio itself,
+ * throttling the submitter.
+ */
+static bool zram_async_write(struct zram *zram, struct bio *bio)
+{
+	struct zram_async_queue *q;
+	unsigned long flags;
+	unsigned int nr;
+	int cpu;
+
+	nr = atomic_inc_return(&zram->async_inflight);
+	if (nr > ZRAM_ASYNC_DEPTH * num_online_cpus()) {
+		atomic_dec(&zram->async_inflight);
+		return false;
+	}
+
+	/* Spread the writes over all online CPUs in turn */
+	cpu = cpumask_local_spread(atomic_inc_return(&zram->async_next_cpu) %
+				   num_online_cpus(), NUMA_NO_NODE);
+	q = per_cpu_ptr(zram->async_queue, cpu);
+
+	spin_lock_irqsave(&q->lock, flags);
+	bio_list_add(&q->bios, bio);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	queue_work_on(cpu, zram_async_wq, &q->work);
+	return true;
+}
+
+static void zram_async_flush(struct zram *zram)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		flush_work(&per_cpu_ptr(zram->async_queue, cpu)->work);
+}
+
+static bool zram_async_init(struct zram *zram)
+{
+	int cpu;
+
+	zram->async_queue = alloc_percpu(struct zram_async_queue);
+	if (!zram->async_queue)
+		return false;
+
+	for_each_possible_cpu(cpu) {
+		struct zram_async_queue *q = per_cpu_ptr(zram->async_queue,
+							 cpu);
+
+		spin_lock_init(&q->lock);
+		bio_list_init(&q->bios);
+		INIT_WORK(&q->work, zram_async_work);
+		q->zram = zram;
+	}
+
+	return true;
+}
+
+static void zram_async_destroy(struct zram *zram)
+{
+	free_percpu(zram->async_queue);
+}
+
+static bool zram_async_enabled(void)
+{
+	return true;
+}
+
+static int zram_async_create_wq(void)
+{
+	/* Workers are needed to make forward progress during swap-out */
+	zram_async_wq = alloc_workqueue("zram_async",
+					WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	return zram_async_wq ? 0 : -ENOMEM;
+}
+
+static void zram_async_destroy_wq(void)
+{
+	destroy_workqueue(zram_async_wq);
+}
+#else
+static bool zram_async_write(struct zram *zram, struct bio *bio)
+{
+	return false;
+}
+static void zram_async_flush(struct zram *zram) {}
+static bool zram_async_init(struct zram *zram) { return true; }
+static void zram_async_destroy(struct zram *zram) {}
+static bool zram_async_enabled(void) { return false; }
+static int zram_async_create_wq(void) { return 0; }
+static void zram_async_destroy_wq(void) {}
+#endif
+
+static void __zram_make_request(struct zram *zram, struct bio *bio)
+{
+	if (unlikely(bio->bi_rw & REQ_DISCARD)) {
+		u32 index = bio->bi_iter.bi_sector >> SECTORS_PER_PAGE_SHIFT;
+		int offset = (bio->bi_iter.bi_sector &
+			      (SECTORS_PER_PAGE - 1)) << SECTOR_SHIFT;
+
+		zram_bio_discard(zram, index, offset, bio);
+		bio_endio(bio);
+		return;
+	}
+
+	if (bio_data_dir(bio) == WRITE && zram_async_write(zram, bio))
+		return;
+
+	zram_bio_rw(zram, bio);
+}
+
 /*
  * Handler function for all zram I/O requests.
  */
@@ -1421,6 +2433,13 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 
 	zram = bdev->bd_disk->private_data;
 
+	/*
+	 * Decline writes so that they get resubmitted as bios, which can be
+	 * compressed asynchronously.
+	 */
+	if (zram_async_enabled() && (rw & WRITE))
+		return -EOPNOTSUPP;
+
 	if (!valid_io_request(zram, sector, PAGE_SIZE)) {
 		atomic64_inc(&zram->stats.invalid_io);
 		ret = -EINVAL;
@@ -1482,10 +2501,14 @@ static void zram_reset_device(struct zram *zram)
 	part_stat_set_all(&zram->disk->part0, 0);
 
 	up_write(&zram->init_lock);
+	zram_wb_stop(zram);
+	/* Let queued writes finish before tearing down their slots */
+	zram_async_flush(zram);
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(zram, disksize);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zcomp_destroy(comp);
+	zram_recomp_destroy(zram);
 	reset_bdev(zram);
 }
 
@@ -1522,9 +2545,17 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	err = zram_recomp_create(zram);
+	if (err) {
+		zcomp_destroy(comp);
+		goto out_free_meta;
+	}
+
 	zram->comp = comp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
+	if (zram_wb_enabled(zram))
+		zram_wb_start(zram);
 
 	revalidate_disk(zram->disk);
 	up_write(&zram->init_lock);
@@ -1613,8 +2644,19 @@ static DEVICE_ATTR_WO(mem_limit);
 static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_WO(idle);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(recompress);
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_RW(writeback_limit);
+static DEVICE_ATTR_RW(writeback_idle_age);
+static DEVICE_ATTR_RO(bd_stat);
 #endif
 
 static struct attribute *zram_disk_attrs[] = {
@@ -1626,8 +2668,19 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_idle.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recompress.attr,
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback_limit.attr,
+	&dev_attr_writeback_idle_age.attr,
+	&dev_attr_bd_stat.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
@@ -1664,13 +2717,21 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram->wb_idle_age = ZRAM_WB_IDLE_AGE;
+#endif
+
+	if (!zram_async_init(zram)) {
+		ret = -ENOMEM;
+		goto out_free_idr;
+	}
 
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
 		pr_err("Error allocating disk queue for device %d\n",
 			device_id);
 		ret = -ENOMEM;
-		goto out_free_idr;
+		goto out_free_async;
 	}
 
 	blk_queue_make_request(queue, zram_make_request);
@@ -1737,6 +2798,8 @@ static int zram_add(void)
 
 out_free_queue:
 	blk_cleanup_queue(queue);
+out_free_async:
+	zram_async_destroy(zram);
 out_free_idr:
 	idr_remove(&zram_index_idr, device_id);
 out_free_dev:
@@ -1774,6 +2837,7 @@ static int zram_remove(struct zram *zram)
 	del_gendisk(zram->disk);
 	blk_cleanup_queue(zram->disk->queue);
 	put_disk(zram->disk);
+	zram_async_destroy(zram);
 	kfree(zram);
 	return 0;
 }
@@ -1855,15 +2919,29 @@ static void destroy_devices(void)
 	zram_debugfs_destroy();
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
+	zram_async_destroy_wq();
+	zram_dedup_destroy_cache();
 }
 
 static int __init zram_init(void)
 {
 	int ret;
 
+	ret = zram_dedup_create_cache();
+	if (ret)
+		return ret;
+
+	ret = zram_async_create_wq();
+	if (ret) {
+		zram_dedup_destroy_cache();
+		return ret;
+	}
+
 	ret = class_register(&zram_control_class);
 	if (ret) {
 		pr_err("Unable to register zram-control class\n");
+		zram_async_destroy_wq();
+		zram_dedup_destroy_cache();
 		return ret;
 	}
 
@@ -1872,6 +2950,8 @@ static int __init zram_init(void)
 	if (zram_major <= 0) {
 		pr_err("Unable to get major number\n");
 		class_unregister(&zram_control_class);
+		zram_async_destroy_wq();
+		zram_dedup_destroy_cache();
 		return -EBUSY;
 	}
 
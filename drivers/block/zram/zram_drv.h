@@ -49,6 +49,9 @@ enum zram_pageflags {
 	ZRAM_SAME,	/* Page consists the same element */
 	ZRAM_WB,	/* page is stored on backing_device */
 	ZRAM_HUGE,	/* Incompressible page */
+	ZRAM_IDLE,	/* not accessed page since last idle marking */
+	ZRAM_RECOMP,	/* page is compressed with the secondary algorithm */
+	ZRAM_DEDUP,	/* handle points to a shared zram_dedup_entry */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -67,6 +70,22 @@ struct zram_table_entry {
 #endif
 };
 
+#ifdef CONFIG_ZRAM_DEDUP
+/* A compressed object that can be shared by several slots */
+struct zram_dedup_entry {
+	struct hlist_node node;
+	unsigned long handle;
+	u64 checksum;
+	unsigned int len;
+	unsigned int refcount;	/* Protected by the hash bucket lock */
+};
+
+struct zram_hash {
+	spinlock_t lock;
+	struct hlist_head head;
+};
+#endif
+
 struct zram_stats {
 	atomic64_t compr_data_size;	/* compressed size of pages stored */
 	atomic64_t num_reads;	/* failed + successful */
@@ -80,8 +99,26 @@ struct zram_stats {
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
+	atomic64_t async_writes;	/* no. of bios compressed by workers */
+	atomic64_t recomp_pages;	/* no. of recompressed pages */
+	atomic64_t dup_data_size;	/* compressed size of duplicate pages */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* no. of pages in backing device */
+	atomic64_t bd_reads;		/* no. of reads from backing device */
+	atomic64_t bd_writes;		/* no. of writes to backing device */
+#endif
 };
 
+#ifdef CONFIG_ZRAM_ASYNC_WRITE
+/* Write bios waiting to be compressed on one CPU */
+struct zram_async_queue {
+	spinlock_t lock;
+	struct bio_list bios;
+	struct work_struct work;
+	struct zram *zram;
+};
+#endif
+
 struct zram {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
@@ -101,6 +138,15 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[CRYPTO_MAX_ALG_NAME];
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+	struct zram_hash *hash;
+	size_t hash_size;
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	struct zcomp *recomp;
+	char recomp_algorithm[CRYPTO_MAX_ALG_NAME];
+#endif
 	/*
 	 * zram is claimed so open request will be failed
 	 */
@@ -112,9 +158,19 @@ struct zram {
 	unsigned long *bitmap;
 	unsigned long nr_pages;
 	spinlock_t bitmap_lock;
+	/* Background writeback of idle and incompressible pages */
+	struct task_struct *wb_thread;
+	u8 *idle_age;		/* writeback aging, see zram_wb_slot_age() */
+	unsigned long wb_limit;	/* max pages written back per interval */
+	unsigned int wb_idle_age;
 #endif
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
 #endif
+#ifdef CONFIG_ZRAM_ASYNC_WRITE
+	struct zram_async_queue __percpu *async_queue;
+	atomic_t async_inflight;
+	atomic_t async_next_cpu;
+#endif
 };
 #endif
@@ -881,6 +881,33 @@ static struct clk_osm perfcl_clk = {
 	},
 };
 
+bool clk_osm_fast_switch_capable(struct clk *clk)
+{
+	return clk == &pwrcl_clk.c || clk == &perfcl_clk.c;
+}
+EXPORT_SYMBOL(clk_osm_fast_switch_capable);
+
+/*
+ * A rate change is only a write of the desired performance state, so it can
+ * be done without the clock framework's prepare lock, and without the rate
+ * change notifiers. The caller must make sure it never races with
+ * clk_set_rate() on the same clock.
+ */
+int clk_osm_set_rate_fast(struct clk *clk, unsigned long rate)
+{
+	int rc;
+
+	if (!clk_osm_fast_switch_capable(clk))
+		return -EINVAL;
+
+	rc = clk_osm_set_rate(clk, rate);
+	if (!rc)
+		WRITE_ONCE(clk->rate, rate);
+
+	return rc;
+}
+EXPORT_SYMBOL(clk_osm_set_rate_fast);
+
 static struct clk_ops clk_ops_cpu_dbg_mux;
 
 static struct mux_clk cpu_debug_mux = {
@@ -24,6 +24,7 @@
 #include <linux/cpumask.h>
 #include <linux/suspend.h>
 #include <linux/clk.h>
+#include <linux/clk/msm-clk.h>
 #include <linux/err.h>
 #include <linux/platform_device.h>
 #include <linux/of.h>
@@ -57,9 +58,18 @@ static int set_cpu_freq(struct cpufreq_policy *policy, unsigned int new_freq,
 	trace_cpu_frequency_switch_start(freqs.old, freqs.new, policy->cpu);
 	cpufreq_freq_transition_begin(policy, &freqs);
 
+	/*
+	 * If the clock can be switched directly, always do so. Mixing in
+	 * clk_set_rate() could make the clock framework skip a switch based
+	 * on a rate cached before a fast switch.
+	 */
 	rate = new_freq * 1000;
-	rate = clk_round_rate(cpu_clk[policy->cpu], rate);
-	ret = clk_set_rate(cpu_clk[policy->cpu], rate);
+	if (policy->fast_switch_possible) {
+		ret = clk_osm_set_rate_fast(cpu_clk[policy->cpu], rate);
+	} else {
+		rate = clk_round_rate(cpu_clk[policy->cpu], rate);
+		ret = clk_set_rate(cpu_clk[policy->cpu], rate);
+	}
 	cpufreq_freq_transition_end(policy, &freqs, ret);
 	if (!ret) {
 		arch_set_freq_scale(policy->related_cpus, new_freq,
@@ -115,6 +125,34 @@ done:
 	return ret;
 }
 
+/* Called from scheduler context with interrupts disabled, must not sleep */
+static unsigned int msm_cpufreq_fast_switch(struct cpufreq_policy *policy,
+					    unsigned int target_freq)
+{
+	struct cpufreq_frequency_table *table = policy->freq_table;
+	unsigned int freq;
+	int index;
+
+	if (per_cpu(suspend_data, policy->cpu).device_suspended)
+		return 0;
+
+	if (cpufreq_frequency_table_target(policy, table, target_freq,
+					   CPUFREQ_RELATION_L, &index))
+		return 0;
+
+	freq = table[index].frequency;
+	if (freq == policy->cur)
+		return freq;
+
+	if (clk_osm_set_rate_fast(cpu_clk[policy->cpu], freq * 1000))
+		return 0;
+
+	arch_set_freq_scale(policy->related_cpus, freq,
+			    policy->cpuinfo.max_freq);
+
+	return freq;
+}
+
 static int msm_cpufreq_verify(struct cpufreq_policy *policy)
 {
 	cpufreq_verify_within_limits(policy, policy->cpuinfo.min_freq,
@@ -152,6 +190,9 @@ static int msm_cpufreq_init(struct cpufreq_policy *policy)
 		return ret;
 	}
 
+	policy->fast_switch_possible =
+		clk_osm_fast_switch_capable(cpu_clk[policy->cpu]);
+
 	cur_freq = clk_get_rate(cpu_clk[policy->cpu])/1000;
 
 	if (cpufreq_frequency_table_target(policy, table, cur_freq,
@@ -316,6 +357,7 @@ static struct cpufreq_driver msm_cpufreq_driver = {
 	.init		= msm_cpufreq_init,
 	.verify		= msm_cpufreq_verify,
 	.target		= msm_cpufreq_target,
+	.fast_switch	= msm_cpufreq_fast_switch,
 	.get		= msm_cpufreq_get_freq,
 	.name		= "msm",
 	.attr		= msm_freq_attr,
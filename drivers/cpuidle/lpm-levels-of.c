@@ -200,6 +200,23 @@ ssize_t lpm_enable_store(struct kobject *kobj, struct kobj_attribute *attr,
 	return ret ? ret : len;
 }
 
+static ssize_t lpm_flush_stats_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct lpm_level_avail *avail = container_of(attr,
+			struct lpm_level_avail, flush_stats_attr);
+	struct lpm_cluster_level *level = container_of(avail,
+			struct lpm_cluster_level, available);
+
+	return scnprintf(buf, PAGE_SIZE,
+			"entries: %u\nmispredicted: %u\navoided: %u\n"
+			"penalty_us: %u\n",
+			READ_ONCE(level->flush_entries),
+			READ_ONCE(level->flush_mispredicted),
+			READ_ONCE(level->flush_avoided),
+			READ_ONCE(level->flush_penalty_us));
+}
+
 static int create_lvl_avail_nodes(const char *name,
 			struct kobject *parent, struct lpm_level_avail *avail,
 			void *data, int index, bool cpu_node)
@@ -221,7 +238,7 @@ static int create_lvl_avail_nodes(const char *name,
 	}
 
 	attr = devm_kzalloc(&lpm_pdev->dev,
-		sizeof(*attr) * (LPM_TYPE_NR + 1), GFP_KERNEL);
+		sizeof(*attr) * (LPM_TYPE_NR + 2), GFP_KERNEL);
 	if (!attr) {
 		ret = -ENOMEM;
 		goto failed;
@@ -242,6 +259,16 @@ static int create_lvl_avail_nodes(const char *name,
 	attr[0] = &avail->idle_enabled_attr.attr;
 	attr[1] = &avail->suspend_enabled_attr.attr;
 	attr[2] = NULL;
+
+	/* Cluster levels also report how their L2 flushes paid off */
+	if (!cpu_node) {
+		sysfs_attr_init(&avail->flush_stats_attr.attr);
+		avail->flush_stats_attr.attr.name = "flush_stats";
+		avail->flush_stats_attr.attr.mode = 0444;
+		avail->flush_stats_attr.show = lpm_flush_stats_show;
+		attr[2] = &avail->flush_stats_attr.attr;
+		attr[3] = NULL;
+	}
 	attr_group->attrs = attr;
 
 	ret = sysfs_create_group(kobj, attr_group);
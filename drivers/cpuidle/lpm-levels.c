@@ -22,6 +22,7 @@
 #include <linux/cpu.h>
 #include <linux/of.h>
 #include <linux/irqchip/msm-mpm-irq.h>
+#include <linux/irqdesc.h>
 #include <linux/hrtimer.h>
 #include <linux/ktime.h>
 #include <linux/tick.h>
@@ -93,6 +94,34 @@ struct lpm_history {
 
 static DEFINE_PER_CPU(struct lpm_history, hist);
 
+/*
+ * Per-CPU history of the interrupts that wake the CPU up from idle. Each
+ * bucket tracks the average interval between idle wakeups caused by one
+ * interrupt, so that an imminent non-timer wakeup can be anticipated and
+ * deep states with an exit latency that would be wasted are avoided.
+ */
+#define LPM_IRQ_BUCKETS 16
+#define LPM_IRQ_CONF_MAX 4
+#define LPM_IRQ_CONF_MIN 2
+
+static bool lpm_irq_prediction = true;
+module_param_named(lpm_irq_prediction,
+	lpm_irq_prediction, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
+struct lpm_irq_bucket {
+	unsigned int irq;
+	uint32_t avg_us;
+	uint32_t conf;
+	int64_t last_us;
+};
+
+struct lpm_irq_history {
+	struct lpm_irq_bucket bucket[LPM_IRQ_BUCKETS];
+	uint32_t timer_us;
+};
+
+static DEFINE_PER_CPU(struct lpm_irq_history, irq_hist);
+
 static DEFINE_PER_CPU(struct lpm_cluster*, cpu_cluster);
 static bool suspend_in_progress;
 static struct hrtimer lpm_hrtimer;
@@ -628,6 +657,88 @@ static void clear_predict_history(void)
 	}
 }
 
+static uint32_t lpm_irq_predict(int cpu)
+{
+	struct lpm_irq_history *history = &per_cpu(irq_hist, cpu);
+	int64_t now = ktime_to_us(ktime_get());
+	uint32_t best = 0;
+	int i;
+
+	if (!lpm_irq_prediction)
+		return 0;
+
+	for (i = 0; i < LPM_IRQ_BUCKETS; i++) {
+		struct lpm_irq_bucket *b = &history->bucket[i];
+		int64_t next;
+
+		if (b->conf < LPM_IRQ_CONF_MIN)
+			continue;
+
+		/* Forget sources that stopped firing at their usual rate */
+		if (now - b->last_us > 4 * (int64_t)b->avg_us) {
+			b->conf = 0;
+			continue;
+		}
+
+		next = b->last_us + b->avg_us;
+		if (next <= now)
+			continue;
+
+		if (!best || next - now < best)
+			best = next - now;
+	}
+
+	return best;
+}
+
+static void lpm_irq_update_history(struct cpuidle_device *dev,
+		unsigned int irq)
+{
+	struct lpm_irq_history *history = &per_cpu(irq_hist, dev->cpu);
+	struct lpm_irq_bucket *b;
+	int64_t now, interval;
+
+	if (!lpm_irq_prediction || !irq)
+		return;
+
+	/*
+	 * Wakeups by the next timer event, or by the histtimer catching a
+	 * misprediction, are already accounted for by cpu_power_select().
+	 */
+	if (per_cpu(hist, dev->cpu).hinvalid ||
+			dev->last_residency + tmr_add >= history->timer_us)
+		return;
+
+	now = ktime_to_us(ktime_get());
+	b = &history->bucket[irq % LPM_IRQ_BUCKETS];
+	if (b->irq != irq) {
+		b->irq = irq;
+		b->avg_us = 0;
+		b->conf = 0;
+		b->last_us = now;
+		return;
+	}
+
+	interval = now - b->last_us;
+	b->last_us = now;
+	if (interval <= 0 || interval > UINT_MAX)
+		return;
+
+	if (!b->avg_us) {
+		b->avg_us = interval;
+		return;
+	}
+
+	if (abs(interval - b->avg_us) <= b->avg_us / 2) {
+		if (b->conf < LPM_IRQ_CONF_MAX)
+			b->conf++;
+	} else {
+		b->conf >>= 1;
+	}
+
+	b->avg_us = (7 * (uint64_t)b->avg_us + interval) >> 3;
+}
+
 static void update_history(struct cpuidle_device *dev, int idx);
 
 static int cpu_power_select(struct cpuidle_device *dev,
@@ -641,7 +752,7 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	uint32_t next_event_us = 0;
 	int i, idx_restrict;
 	uint32_t lvl_latency_us = 0;
-	uint64_t predicted = 0;
+	uint64_t predicted = 0, irq_predicted;
 	uint32_t htime = 0, idx_restrict_time = 0;
 	uint32_t next_wakeup_us = (uint32_t)sleep_us;
 	uint32_t *min_residency = get_per_cpu_min_residency(dev->cpu);
@@ -692,6 +803,10 @@ static int cpu_power_select(struct cpuidle_device *dev,
 			if (next_wakeup_us > max_residency[i]) {
 				predicted = lpm_cpuidle_predict(dev, cpu,
 					&idx_restrict, &idx_restrict_time);
+				irq_predicted = lpm_irq_predict(dev->cpu);
+				if (irq_predicted && (!predicted ||
+						irq_predicted < predicted))
+					predicted = irq_predicted;
 				if (predicted && (predicted < min_residency[i]))
 					predicted = min_residency[i];
 			} else
@@ -718,6 +833,9 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	if (modified_time_us)
 		msm_pm_set_timer(modified_time_us);
 
+	per_cpu(irq_hist, dev->cpu).timer_us = modified_time_us ?
+		modified_time_us : next_wakeup_us;
+
 	/*
 	 * Start timer to avoid staying in shallower mode forever
 	 * incase of misprediciton
@@ -957,6 +1075,74 @@ static void clear_cl_predict_history(void)
 	}
 }
 
+static bool cluster_level_flushes_l2(struct lpm_cluster_level *level)
+{
+	return level->is_reset;
+}
+
+/*
+ * Minimum idle time for which a mode that flushes the L2 pays off. The
+ * residency derived from the power model is corrected by the shortfall of
+ * recent mispredicted entries into the mode.
+ */
+static uint32_t cluster_break_even_us(struct lpm_cluster_level *level)
+{
+	struct power_params *pwr = &level->pwr;
+
+	return max(pwr->min_residency, pwr->time_overhead_us) +
+		level->flush_penalty_us;
+}
+
+/*
+ * The cluster stays idle only until its first CPU wakes up, so its expected
+ * idle time is the minimum of what is expected for each member CPU.
+ */
+static uint32_t cluster_expected_idle_us(struct lpm_cluster *cluster,
+		uint32_t sleep_us, uint32_t cpupred_us)
+{
+	uint32_t expected_us = sleep_us;
+	int cpu;
+
+	if (cpupred_us && cpupred_us < expected_us)
+		expected_us = cpupred_us;
+
+	for_each_cpu_and(cpu, &cluster->num_children_in_sync,
+			cpu_online_mask) {
+		uint32_t irq_us = lpm_irq_predict(cpu);
+
+		if (irq_us && irq_us < expected_us)
+			expected_us = irq_us;
+	}
+
+	return expected_us;
+}
+
+static void cluster_update_flush_stats(struct lpm_cluster_level *level,
+		int64_t sleep_ns)
+{
+	uint32_t break_even_us = cluster_break_even_us(level);
+	uint32_t residency_us;
+
+	if (sleep_ns <= 0)
+		return;
+
+	residency_us = div_s64(sleep_ns, NSEC_PER_USEC);
+	level->flush_entries++;
+
+	if (residency_us < break_even_us) {
+		level->flush_mispredicted++;
+		level->flush_penalty_us = min_t(uint32_t,
+			level->flush_penalty_us +
+			(break_even_us - residency_us) / 2,
+			level->pwr.min_residency);
+	} else if (level->flush_penalty_us >> 3) {
+		level->flush_penalty_us -= level->flush_penalty_us >> 3;
+	} else {
+		/* The 1/8 decay alone would never take it below 7us */
+		level->flush_penalty_us = 0;
+	}
+}
+
 static int cluster_select(struct lpm_cluster *cluster, bool from_idle,
 							int *ispred)
 {
@@ -965,7 +1151,7 @@ static int cluster_select(struct lpm_cluster *cluster, bool from_idle,
 	struct cpumask mask;
 	uint32_t latency_us = ~0U;
 	uint32_t sleep_us;
-	uint32_t cpupred_us = 0, pred_us = 0;
+	uint32_t cpupred_us = 0, pred_us = 0, expected_us = 0;
 	int pred_mode = 0, predicted = 0;
 
 	if (!cluster)
@@ -974,6 +1160,10 @@ static int cluster_select(struct lpm_cluster *cluster, bool from_idle,
 	sleep_us = (uint32_t)get_cluster_sleep_time(cluster, NULL,
 						from_idle, &cpupred_us);
 
+	if (from_idle)
+		expected_us = cluster_expected_idle_us(cluster, sleep_us,
+						      cpupred_us);
+
 	if (from_idle) {
 		pred_mode = cluster_predict(cluster, &pred_us);
 
@@ -1029,6 +1219,16 @@ static int cluster_select(struct lpm_cluster *cluster, bool from_idle,
 		if (level->notify_rpm && msm_rpm_waiting_for_ack())
 			continue;
 
+		/*
+		 * Flushing the L2 only pays off if every CPU in the cluster is
+		 * expected to stay idle past the break-even point.
+		 */
+		if (from_idle && cluster_level_flushes_l2(level) &&
+			expected_us < cluster_break_even_us(level)) {
+			level->flush_avoided++;
+			break;
+		}
+
 		best_level = i;
 
 		if (from_idle &&
@@ -1263,6 +1463,9 @@ static void cluster_unprepare(struct lpm_cluster *cluster,
 	lpm_stats_cluster_exit(cluster->stats, cluster->last_level, true);
 
 	level = &cluster->levels[cluster->last_level];
+	if (from_idle && cluster_level_flushes_l2(level))
+		cluster_update_flush_stats(level, cluster->stats->sleep_time);
+
 	if (level->notify_rpm) {
 		msm_rpm_exit_sleep();
 
@@ -1527,6 +1730,7 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 	if (need_resched())
 		goto exit;
 
+	irq_clear_wakeup_irq();
 	BUG_ON(!use_psci);
 	success = psci_enter_sleep(cluster, idx, true);
 
@@ -1542,6 +1746,9 @@ exit:
 	update_history(dev, idx);
 	trace_cpu_idle_exit(idx, success);
 	local_irq_enable();
+	/* The interrupt that woke us up has been handled by now */
+	if (success)
+		lpm_irq_update_history(dev, irq_wakeup_irq());
 	if (lpm_prediction) {
 		histtimer_cancel();
 		clusttimer_cancel();
@@ -60,6 +60,7 @@ struct lpm_level_avail {
 	struct kobject *kobj;
 	struct kobj_attribute idle_enabled_attr;
 	struct kobj_attribute suspend_enabled_attr;
+	struct kobj_attribute flush_stats_attr;
 	void *data;
 	int idx;
 	bool cpu_node;
@@ -79,6 +80,11 @@ struct lpm_cluster_level {
 	unsigned int psci_id;
 	bool is_reset;
 	int reset_level;
+	/* Break-even correction and counters for modes that flush the L2 */
+	uint32_t flush_penalty_us;
+	uint32_t flush_entries;
+	uint32_t flush_mispredicted;
+	uint32_t flush_avoided;
 };
 
 struct low_power_ops {
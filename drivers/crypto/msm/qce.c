@@ -1945,6 +1945,17 @@ void qce_clear_driver_stats(void *handle)
 }
 EXPORT_SYMBOL(qce_clear_driver_stats);
 
+void qce_batch_start(void *handle)
+{
+}
+EXPORT_SYMBOL(qce_batch_start);
+
+int qce_batch_flush(void *handle)
+{
+	return 0;
+}
+EXPORT_SYMBOL(qce_batch_flush);
+
 int qce_aead_req(void *handle, struct qce_req *q_req)
 {
 	struct qce_device *pce_dev = (struct qce_device *) handle;
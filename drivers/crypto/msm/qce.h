@@ -186,5 +186,7 @@ int qce_enable_clk(void *handle);
 int qce_disable_clk(void *handle);
 void qce_get_driver_stats(void *handle);
 void qce_clear_driver_stats(void *handle);
+void qce_batch_start(void *handle);
+int qce_batch_flush(void *handle);
 
 #endif /* __CRYPTO_MSM_QCE_H */
@@ -154,11 +154,17 @@ struct qce_device {
 	atomic_t last_intr_seq;
 	bool cadence_flag;
 	uint8_t *dummyreq_in_buf;
+	/* requests set up between qce_batch_start() and qce_batch_flush() */
+	bool batch_active;
+	unsigned int batch_cnt;
+	int batch_req[MAX_QCE_BAM_REQ];
 };
 
 static void print_notify_debug(struct sps_event_notify *notify);
 static void _sps_producer_callback(struct sps_event_notify *notify);
 static int qce_dummy_req(struct qce_device *pce_dev);
+static void _qce_req_complete(struct qce_device *pce_dev,
+				unsigned int req_info);
 
 static int _qce50_disp_stats;
 
@@ -2564,19 +2570,29 @@ static int _qce_sps_add_cmd(struct qce_device *pce_dev, uint32_t flag,
 	return 0;
 }
 
-static int _qce_sps_transfer(struct qce_device *pce_dev, int req_info)
+/*
+ * Queue the descriptors of a request on the consumer and producer pipes.
+ * With submit false the BAM write offsets are left alone and no interrupt
+ * is requested, so the descriptors are only started by the next submitted
+ * request, whose interrupt also reports their EOT.
+ */
+static int _qce_sps_submit(struct qce_device *pce_dev, int req_info,
+			   bool submit)
 {
 	int rc = 0;
 	struct ce_sps_data *pce_sps_data;
+	struct sps_transfer *out;
 
 	pce_sps_data = &pce_dev->ce_request_info[req_info].ce_sps;
-	pce_sps_data->out_transfer.user =
-		(void *)((uintptr_t)(CRYPTO_REQ_USER_PAT |
-					(unsigned int) req_info));
-	pce_sps_data->in_transfer.user =
-		(void *)((uintptr_t)(CRYPTO_REQ_USER_PAT |
-					(unsigned int) req_info));
-	_qce_dump_descr_fifos_dbg(pce_dev, req_info);
+	out = &pce_sps_data->out_transfer;
+	if (!submit) {
+		_qce_set_flag(&pce_sps_data->in_transfer,
+				SPS_IOVEC_FLAG_NO_SUBMIT);
+		_qce_set_flag(out, SPS_IOVEC_FLAG_NO_SUBMIT);
+		if (out->iovec_count)
+			out->iovec[out->iovec_count - 1].flags &=
+						~SPS_IOVEC_FLAG_INT;
+	}
 
 	if (pce_sps_data->in_transfer.iovec_count) {
 		rc = sps_transfer(pce_dev->ce_bam_info.consumer.pipe,
@@ -2588,8 +2604,7 @@ static int _qce_sps_transfer(struct qce_device *pce_dev, int req_info)
 			goto ret;
 		}
 	}
-	rc = sps_transfer(pce_dev->ce_bam_info.producer.pipe,
-					  &pce_sps_data->out_transfer);
+	rc = sps_transfer(pce_dev->ce_bam_info.producer.pipe, out);
 	if (rc)
 		pr_err("sps_xfr() fail (producer pipe=0x%lx) rc = %d\n",
 			(uintptr_t)pce_dev->ce_bam_info.producer.pipe, rc);
@@ -2599,6 +2614,113 @@ ret:
 	return rc;
 }
 
+static int _qce_sps_transfer(struct qce_device *pce_dev, int req_info)
+{
+	struct ce_sps_data *pce_sps_data;
+
+	pce_sps_data = &pce_dev->ce_request_info[req_info].ce_sps;
+	pce_sps_data->out_transfer.user =
+		(void *)((uintptr_t)(CRYPTO_REQ_USER_PAT |
+					(unsigned int) req_info));
+	pce_sps_data->in_transfer.user =
+		(void *)((uintptr_t)(CRYPTO_REQ_USER_PAT |
+					(unsigned int) req_info));
+	_qce_dump_descr_fifos_dbg(pce_dev, req_info);
+
+	/* the dummy request comes from the bunch mode timeout, never hold it */
+	if (pce_dev->batch_active && req_info != DUMMY_REQ_INDEX &&
+			pce_dev->batch_cnt < MAX_QCE_BAM_REQ) {
+		pce_dev->batch_req[pce_dev->batch_cnt++] = req_info;
+		return 0;
+	}
+	return _qce_sps_submit(pce_dev, req_info, true);
+}
+
+/*
+ * Batched submission. Requests set up by the client between
+ * qce_batch_start() and qce_batch_flush() are held back and then chained
+ * into the BAM pipes in one go: one write offset update per pipe and a
+ * single completion interrupt, raised by the last request. Only engines
+ * that complete a request with a single producer transfer
+ * (no_get_around) can do this, elsewhere both calls are no-ops.
+ *
+ * If a submission fails, qce_batch_flush() stops there and returns the
+ * error. Requests not submitted are completed through their callbacks
+ * with an error, so the caller does not have to track them.
+ *
+ * The caller must serialize batches against other submissions on the
+ * same handle, as it already must for single requests.
+ */
+void qce_batch_start(void *handle)
+{
+	struct qce_device *pce_dev = (struct qce_device *) handle;
+
+	if (!pce_dev->no_get_around)
+		return;
+	pce_dev->batch_cnt = 0;
+	pce_dev->batch_active = true;
+}
+EXPORT_SYMBOL(qce_batch_start);
+
+int qce_batch_flush(void *handle)
+{
+	struct qce_device *pce_dev = (struct qce_device *) handle;
+	struct ce_sps_data *pce_sps_data;
+	unsigned int i, n;
+	int rc = 0;
+
+	if (!pce_dev->batch_active)
+		return 0;
+	n = pce_dev->batch_cnt;
+	pce_dev->batch_active = false;
+	pce_dev->batch_cnt = 0;
+	if (!n)
+		return 0;
+
+	/* keep the bunch mode timeout from inserting its dummy request */
+again:
+	if (cmpxchg(&pce_dev->owner, QCE_OWNER_NONE, QCE_OWNER_CLIENT)
+							!= QCE_OWNER_NONE) {
+		ndelay(40);
+		goto again;
+	}
+	for (i = 0; i < n; i++) {
+		if (i == n - 1) {
+			pce_sps_data = &pce_dev->ce_request_info[
+					pce_dev->batch_req[i]].ce_sps;
+			_qce_set_flag(&pce_sps_data->out_transfer,
+					SPS_IOVEC_FLAG_INT);
+		}
+		rc = _qce_sps_submit(pce_dev, pce_dev->batch_req[i],
+				     i == n - 1);
+		if (rc)
+			break;
+	}
+
+	/*
+	 * The requests already queued were held back by NO_SUBMIT waiting
+	 * for the one that failed. Start them with the dummy request, whose
+	 * interrupt reports their EOT, and fail the rest.
+	 */
+	if (rc && i && qce_dummy_req(pce_dev))
+		pr_warn("pcedev %d: Failed to insert dummy req\n",
+				pce_dev->dev_no);
+	cmpxchg(&pce_dev->owner, QCE_OWNER_CLIENT, QCE_OWNER_NONE);
+
+	pce_dev->qce_stats.no_of_batches++;
+	pce_dev->qce_stats.no_of_batched_reqs += i;
+
+	for (; i < n; i++) {
+		pce_sps_data = &pce_dev->ce_request_info[
+				pce_dev->batch_req[i]].ce_sps;
+		pce_sps_data->consumer_status = rc;
+		pce_sps_data->producer_status = rc;
+		_qce_req_complete(pce_dev, pce_dev->batch_req[i]);
+	}
+	return rc;
+}
+EXPORT_SYMBOL(qce_batch_flush);
+
 /**
  * Allocate and Connect a CE peripheral's SPS endpoint
  *
@@ -3097,6 +3219,9 @@ void qce_get_driver_stats(void *handle)
 		pr_info("Engine %d is in INTERRUPT MODE\n", pce_dev->dev_no);
 	pr_info("Engine %d outstanding request %d\n", pce_dev->dev_no,
 			atomic_read(&pce_dev->no_of_queued_req));
+	pr_info("Engine %d batches %d with %d requests\n", pce_dev->dev_no,
+			pce_dev->qce_stats.no_of_batches,
+			pce_dev->qce_stats.no_of_batched_reqs);
 }
 EXPORT_SYMBOL(qce_get_driver_stats);
 
@@ -3106,6 +3231,8 @@ void qce_clear_driver_stats(void *handle)
 
 	pce_dev->qce_stats.no_of_timeouts = 0;
 	pce_dev->qce_stats.no_of_dummy_reqs = 0;
+	pce_dev->qce_stats.no_of_batches = 0;
+	pce_dev->qce_stats.no_of_batched_reqs = 0;
 }
 EXPORT_SYMBOL(qce_clear_driver_stats);
 
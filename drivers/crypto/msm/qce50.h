@@ -240,6 +240,8 @@ struct qce_driver_stats {
 	int no_of_dummy_reqs;
 	int current_mode;
 	int outstanding_reqs;
+	int no_of_batches;
+	int no_of_batched_reqs;
 };
 
 #endif /* _DRIVERS_CRYPTO_MSM_QCE50_H */
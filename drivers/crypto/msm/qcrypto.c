@@ -33,6 +33,8 @@
 #include <linux/platform_data/qcom_crypto_device.h>
 #include <linux/msm-bus.h>
 #include <linux/hardirq.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include <linux/qcrypto.h>
 
 #include <crypto/ctr.h>
@@ -49,6 +51,8 @@
 
 #include <linux/fips_status.h>
 
+#include <asm/simd.h>
+
 #include "qce.h"
 
 #define DEBUG_MAX_FNAME  16
@@ -114,6 +118,7 @@ struct crypto_stat {
 	u64 ablk_cipher_3des_dec;
 	u64 ablk_cipher_op_success;
 	u64 ablk_cipher_op_fail;
+	u64 ablk_cipher_aes_cpu;
 	u64 sha1_digest;
 	u64 sha256_digest;
 	u64 sha1_hmac_digest;
@@ -175,10 +180,47 @@ struct crypto_engine {
 	bool first_engine;	/* this engine is the first engine or not */
 	unsigned int irq_cpu;	/* the cpu running the irq of this engine */
 	unsigned int max_req_used; /* debug stats */
+
+	/* throughput stats, busy while any request is outstanding */
+	u64 total_bytes;
+	u64 busy_ns;
+	ktime_t busy_start;
+	u64 total_batches;
+	u64 batched_req;
 };
 
 #define MAX_SMP_CPU    8
 
+#define QCRYPTO_BATCH_MAX	4
+
+/*
+ * AES ECB/CBC/CTR requests either go to a crypto engine or run
+ * synchronously on the software fallback tfm. The fallback is allocated
+ * without CRYPTO_ALG_ASYNC, so it is the block mode template over the
+ * single block "aes" cipher (aes-ce where the CPU has it), not the
+ * ablk_helper based aes-ce-blk. For short requests the BAM descriptor
+ * setup costs more than the cipher itself, so they stay on the CPU.
+ * Between cpu_max_len and qce_min_len the path is picked from the measured
+ * cost of each for the request's log2 size bucket. The engine cost is
+ * scaled by the number of requests waiting per engine. Dispatch can be
+ * turned off through debugfs.
+ */
+#define QCRYPTO_DISPATCH_MIN_SHIFT	6	/* first bucket: below 128 bytes */
+#define QCRYPTO_DISPATCH_BUCKETS	10
+#define QCRYPTO_DISPATCH_PROBE_MASK	31	/* 1 in 32 requests re-measures */
+#define QCRYPTO_DISPATCH_CPU_MAX_LEN	512
+#define QCRYPTO_DISPATCH_QCE_MIN_LEN	32768
+
+struct qcrypto_dispatch {
+	u32 enable;
+	u32 cpu_max_len;	/* requests up to this length run on the CPU */
+	u32 qce_min_len;	/* requests from this length go to an engine */
+	atomic_t seq;
+	/* average cost in ns of each path, per size bucket */
+	u32 cpu_ns[QCRYPTO_DISPATCH_BUCKETS];
+	u32 qce_ns[QCRYPTO_DISPATCH_BUCKETS];
+};
+
 struct crypto_priv {
 	/* CE features supported by target device*/
 	struct msm_ce_hw_support platform_support;
@@ -232,8 +274,32 @@ struct crypto_priv {
 	unsigned int max_resp_qlen;
 	unsigned int max_reorder_cnt;
 	unsigned int cpu_req[MAX_SMP_CPU+1];
+
+	struct qcrypto_dispatch dispatch;
+	/* max requests chained into one engine submission */
+	u32 batch_max;
 };
 static struct crypto_priv qcrypto_dev;
+
+static unsigned int _qcrypto_dispatch_bucket(unsigned int nbytes)
+{
+	int b = ilog2(nbytes | 1) - QCRYPTO_DISPATCH_MIN_SHIFT;
+
+	return clamp(b, 0, QCRYPTO_DISPATCH_BUCKETS - 1);
+}
+
+/* Fold a sample in with 1/8 weight, racing updaters only lose precision */
+static void _qcrypto_dispatch_update(u32 *cost, unsigned int nbytes, s64 ns)
+{
+	u32 *p = &cost[_qcrypto_dispatch_bucket(nbytes)];
+	u32 old = ACCESS_ONCE(*p);
+	u32 val;
+
+	if (ns <= 0)
+		return;
+	val = min_t(s64, ns, U32_MAX);
+	ACCESS_ONCE(*p) = old ? old - (old >> 3) + (val >> 3) : val;
+}
 static struct crypto_engine *_qcrypto_static_assign_engine(
 					struct crypto_priv *cp);
 static struct crypto_engine *_avail_eng(struct crypto_priv *cp);
@@ -249,6 +315,8 @@ static struct qcrypto_req_control *qcrypto_alloc_req_control(
 			req_count = atomic_inc_return(&pce->req_count);
 			if (req_count > pce->max_req_used)
 				pce->max_req_used = req_count;
+			if (req_count == 1)
+				pce->busy_start = ktime_get();
 			return pqcrypto_req_control;
 		}
 		pqcrypto_req_control++;
@@ -266,7 +334,9 @@ static void qcrypto_free_req_control(struct crypto_engine *pce,
 	if (xchg(&preq->in_use, false) == false) {
 		pr_warn("request info %pK free already\n", preq);
 	} else {
-		atomic_dec(&pce->req_count);
+		if (atomic_dec_and_test(&pce->req_count))
+			pce->busy_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							pce->busy_start));
 	}
 }
 
@@ -421,6 +491,7 @@ struct qcrypto_cipher_ctx {
 	u8 ccm4309_nonce[QCRYPTO_CCM4309_NONCE_LEN];
 
 	struct crypto_ablkcipher *cipher_aes192_fb;
+	bool fb_key_valid;	/* fallback holds enc_key, may dispatch to CPU */
 
 	struct crypto_ahash *ahash_aead_aes192_fb;
 };
@@ -458,6 +529,7 @@ struct qcrypto_cipher_req_ctx {
 	struct scatterlist fb_ablkcipher_src_sg[2];
 	struct scatterlist fb_ablkcipher_dst_sg[2];
 	char *fb_aes_iv;
+	ktime_t qce_start;		/* handed to the engine */
 	unsigned int  fb_ahash_length;
 	struct ablkcipher_request *fb_aes_req;
 	struct scatterlist *fb_aes_src;
@@ -946,7 +1018,14 @@ static int _qcrypto_cra_aes_ablkcipher_init(struct crypto_tfm *tfm)
 		ctx->cipher_aes192_fb = NULL;
 		return ret;
 	}
-	return _qcrypto_cra_ablkcipher_init(tfm);
+	ctx->fb_key_valid = false;
+	ret = _qcrypto_cra_ablkcipher_init(tfm);
+
+	/* the fallback is run on our request, leave room for its context */
+	tfm->crt_ablkcipher.reqsize = max_t(unsigned int,
+			tfm->crt_ablkcipher.reqsize,
+			crypto_ablkcipher_reqsize(ctx->cipher_aes192_fb));
+	return ret;
 };
 
 static int _qcrypto_aead_cra_init(struct crypto_aead *tfm)
@@ -1112,6 +1191,7 @@ static int _disp_stats(int id)
 	unsigned long flags;
 	struct crypto_priv *cp = &qcrypto_dev;
 	struct crypto_engine *pe;
+	u64 busy_us;
 	int i;
 
 	pstat = &_qcrypto_stat;
@@ -1265,6 +1345,23 @@ static int _disp_stats(int id)
 			pe->unit,
 			pe->err_req
 		);
+		busy_us = div_u64(pe->busy_ns, NSEC_PER_USEC);
+		len += scnprintf(
+			_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Engine %4d Throughput KB/s         : %llu\n",
+			pe->unit,
+			busy_us ? div64_u64((pe->total_bytes >> 10) *
+					USEC_PER_SEC, busy_us) : 0
+		);
+		len += scnprintf(
+			_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Engine %4d Batches/Req             : %llu/%llu\n",
+			pe->unit,
+			pe->total_batches,
+			pe->batched_req
+		);
 		qce_get_driver_stats(pe->qce);
 	}
 	spin_unlock_irqrestore(&cp->lock, flags);
@@ -1276,6 +1373,17 @@ static int _disp_stats(int id)
 				DEBUG_MAX_RW_BUF - len - 1,
 				"CPU %d Issue Req                     : %d\n",
 				i, cp->cpu_req[i]);
+
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER AES run on CPU          : %llu\n",
+					pstat->ablk_cipher_aes_cpu);
+	for (i = 0; i < QCRYPTO_DISPATCH_BUCKETS; i++)
+		len += scnprintf(
+			_debug_read_buf + len,
+			DEBUG_MAX_RW_BUF - len - 1,
+			"   Dispatch < %6u bytes ns cpu/qce  : %u/%u\n",
+			1U << (i + QCRYPTO_DISPATCH_MIN_SHIFT + 1),
+			cp->dispatch.cpu_ns[i], cp->dispatch.qce_ns[i]);
 	return len;
 }
 #endif
@@ -1403,6 +1511,7 @@ static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 	if ((ctx->flags & QCRYPTO_CTX_USE_HW_KEY) == QCRYPTO_CTX_USE_HW_KEY)
 		return 0;
 
+	ctx->fb_key_valid = false;
 	if ((len == AES_KEYSIZE_192) && (!cp->ce_support.aes_key_192)
 					&& ctx->cipher_aes192_fb)
 		return _qcrypto_setkey_aes_192_fallback(cipher, key);
@@ -1418,6 +1527,13 @@ static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 				pr_err("%s Inavlid key pointer\n", __func__);
 				return -EINVAL;
 			}
+			/* keep the fallback in step for CPU dispatch */
+			if (ctx->cipher_aes192_fb) {
+				crypto_ablkcipher_clear_flags(
+					ctx->cipher_aes192_fb, ~0);
+				ctx->fb_key_valid = !crypto_ablkcipher_setkey(
+					ctx->cipher_aes192_fb, key, len);
+			}
 		}
 	}
 	return 0;
@@ -1793,6 +1909,11 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 	} else {
 		pqcrypto_req_control->res = 0;
 		pstat->ablk_cipher_op_success++;
+		if (ctx->fb_key_valid)
+			_qcrypto_dispatch_update(cp->dispatch.qce_ns,
+				areq->nbytes,
+				ktime_to_ns(ktime_sub(ktime_get(),
+						      rctx->qce_start)));
 	}
 
 	if (cp->ce_support.aligned_only)  {
@@ -1998,6 +2119,7 @@ static int _qcrypto_process_ablkcipher(struct crypto_engine *pengine,
 		req->src = &rctx->dsg;
 		req->dst = &rctx->dsg;
 	}
+	rctx->qce_start = ktime_get();
 	qreq.op = QCE_REQ_ABLK_CIPHER;
 	qreq.qce_cb = _qce_ablk_cipher_complete;
 	qreq.areq = req;
@@ -2193,6 +2315,25 @@ static struct crypto_engine *_qcrypto_static_assign_engine(
 	return pengine;
 }
 
+static unsigned int _qcrypto_req_bytes(u32 type,
+				struct crypto_async_request *async_req)
+{
+	struct aead_request *aead_req;
+
+	switch (type) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		return container_of(async_req, struct ablkcipher_request,
+				base)->nbytes;
+	case CRYPTO_ALG_TYPE_AHASH:
+		return container_of(async_req, struct ahash_request,
+				base)->nbytes;
+	case CRYPTO_ALG_TYPE_AEAD:
+	default:
+		aead_req = container_of(async_req, struct aead_request, base);
+		return aead_req->assoclen + aead_req->cryptlen;
+	}
+}
+
 static int _start_qcrypto_process(struct crypto_priv *cp,
 				struct crypto_engine *pengine)
 {
@@ -2212,6 +2353,9 @@ static int _start_qcrypto_process(struct crypto_priv *cp,
 	struct qcrypto_resp_ctx *arsp;
 	struct qcrypto_req_control *pqcrypto_req_control;
 	unsigned int cpu = MAX_SMP_CPU;
+	unsigned int nbytes;
+	unsigned int batched = 0;
+	bool batch = false;
 
 	if (ACCESS_ONCE(cp->ce_req_proc_sts) == STOPPED)
 		return 0;
@@ -2227,10 +2371,10 @@ static int _start_qcrypto_process(struct crypto_priv *cp,
 
 again:
 	spin_lock_irqsave(&cp->lock, flags);
-	if (pengine->issue_req ||
+	if ((pengine->issue_req && !batch) ||
 		atomic_read(&pengine->req_count) >= (pengine->max_req)) {
 		spin_unlock_irqrestore(&cp->lock, flags);
-		return 0;
+		goto out;
 	}
 
 	backlog_eng = crypto_get_backlog(&pengine->req_queue);
@@ -2238,7 +2382,7 @@ again:
 	/* make sure it is in high bandwidth state */
 	if (pengine->bw_state != BUS_HAS_BANDWIDTH) {
 		spin_unlock_irqrestore(&cp->lock, flags);
-		return 0;
+		goto out;
 	}
 
 	/* try to get request from request queue of the engine first */
@@ -2252,14 +2396,25 @@ again:
 		async_req = crypto_dequeue_request(&cp->req_queue);
 		if (!async_req) {
 			spin_unlock_irqrestore(&cp->lock, flags);
-			return 0;
+			goto out;
 		}
 	}
 	pqcrypto_req_control = qcrypto_alloc_req_control(pengine);
 	if (pqcrypto_req_control == NULL) {
 		pr_err("Allocation of request failed\n");
 		spin_unlock_irqrestore(&cp->lock, flags);
-		return 0;
+		goto out;
+	}
+
+	/*
+	 * More work is waiting and the engine has room for it: set up the
+	 * following requests too and hand them to the BAM as one chain.
+	 */
+	if (!batch && cp->batch_max > 1 &&
+		(pengine->req_queue.qlen || cp->req_queue.qlen) &&
+		atomic_read(&pengine->req_count) < pengine->max_req) {
+		batch = true;
+		qce_batch_start(pengine->qce);
 	}
 
 	/* add associated rsp entry to tfm response queue */
@@ -2316,6 +2471,8 @@ again:
 		backlog_eng->complete(backlog_eng, -EINPROGRESS);
 	if (backlog_cp)
 		backlog_cp->complete(backlog_cp, -EINPROGRESS);
+	/* the request may complete and go away once issued */
+	nbytes = _qcrypto_req_bytes(type, async_req);
 	switch (type) {
 	case CRYPTO_ALG_TYPE_ABLKCIPHER:
 		ret = _qcrypto_process_ablkcipher(pengine,
@@ -2331,8 +2488,10 @@ again:
 		ret = -EINVAL;
 	};
 
-	pengine->issue_req = false;
-	smp_mb(); /* make it visible */
+	if (!batch) {
+		pengine->issue_req = false;
+		smp_mb(); /* make it visible */
+	}
 
 	pengine->total_req++;
 	if (ret) {
@@ -2350,6 +2509,23 @@ again:
 		_qcrypto_tfm_complete(pengine, type, tfm_ctx, arsp, ret);
 		goto again;
 	};
+	pengine->total_bytes += nbytes;
+	if (batch && ++batched < cp->batch_max)
+		goto again;
+out:
+	if (!batch)
+		return 0;
+
+	/* requests it could not submit are completed with the error */
+	ret = qce_batch_flush(pengine->qce);
+	if (ret)
+		pengine->err_req++;
+	if (batched) {
+		pengine->total_batches++;
+		pengine->batched_req += batched;
+	}
+	pengine->issue_req = false;
+	smp_mb(); /* make it visible */
 	return ret;
 }
 
@@ -2468,6 +2644,79 @@ static int _qcrypto_dec_aes_192_fallback(struct ablkcipher_request *req)
 	return err;
 }
 
+static int _qcrypto_pending_reqs(struct crypto_priv *cp)
+{
+	struct crypto_engine *pe;
+	unsigned long flags;
+	int n;
+
+	spin_lock_irqsave(&cp->lock, flags);
+	n = cp->req_queue.qlen;
+	list_for_each_entry(pe, &cp->engine_list, elist)
+		n += pe->req_queue.qlen + atomic_read(&pe->req_count);
+	spin_unlock_irqrestore(&cp->lock, flags);
+	return n;
+}
+
+/*
+ * Returns true if the request should run on the CPU fallback. Only done
+ * outside interrupt context, where the CE cipher's NEON use does not have
+ * to save and restore the interrupted register state for every block.
+ */
+static bool _qcrypto_dispatch_cpu(struct qcrypto_cipher_ctx *ctx,
+				  unsigned int nbytes)
+{
+	struct qcrypto_dispatch *d = &ctx->cp->dispatch;
+	unsigned int b, units;
+	u32 cpu_ns, qce_ns, seq;
+
+	if (!d->enable || !ctx->fb_key_valid || !may_use_simd() ||
+		(ctx->flags & (QCRYPTO_CTX_USE_HW_KEY |
+				QCRYPTO_CTX_USE_PIPE_KEY)))
+		return false;
+	if (nbytes <= d->cpu_max_len)
+		return true;
+	if (nbytes >= d->qce_min_len)
+		return false;
+
+	b = _qcrypto_dispatch_bucket(nbytes);
+	cpu_ns = ACCESS_ONCE(d->cpu_ns[b]);
+	qce_ns = ACCESS_ONCE(d->qce_ns[b]);
+	seq = atomic_inc_return(&d->seq);
+
+	/* alternate until both are measured, then probe now and then */
+	if (!cpu_ns || !qce_ns)
+		return seq & 1;
+	if (!(seq & QCRYPTO_DISPATCH_PROBE_MASK))
+		return seq & (QCRYPTO_DISPATCH_PROBE_MASK + 1);
+
+	units = max_t(int, ctx->cp->total_units, 1);
+	return (u64)cpu_ns * units <
+		(u64)qce_ns * (units + _qcrypto_pending_reqs(ctx->cp));
+}
+
+static int _qcrypto_cpu_aes(struct ablkcipher_request *req, bool enc)
+{
+	struct crypto_tfm *tfm =
+		crypto_ablkcipher_tfm(crypto_ablkcipher_reqtfm(req));
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	ktime_t start = ktime_get();
+	int err;
+
+	_qcrypto_stat.ablk_cipher_aes_cpu++;
+	ablkcipher_request_set_tfm(req, ctx->cipher_aes192_fb);
+	if (enc)
+		err = crypto_ablkcipher_encrypt(req);
+	else
+		err = crypto_ablkcipher_decrypt(req);
+	ablkcipher_request_set_tfm(req, __crypto_ablkcipher_cast(tfm));
+
+	if (!err)
+		_qcrypto_dispatch_update(ctx->cp->dispatch.cpu_ns, req->nbytes,
+				ktime_to_ns(ktime_sub(ktime_get(), start)));
+	return err;
+}
+
 
 static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 {
@@ -2489,6 +2738,9 @@ static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 				ctx->cipher_aes192_fb)
 		return _qcrypto_enc_aes_192_fallback(req);
 
+	if (_qcrypto_dispatch_cpu(ctx, req->nbytes))
+		return _qcrypto_cpu_aes(req, true);
+
 	rctx = ablkcipher_request_ctx(req);
 	rctx->aead = 0;
 	rctx->alg = CIPHER_ALG_AES;
@@ -2519,6 +2771,9 @@ static int _qcrypto_enc_aes_cbc(struct ablkcipher_request *req)
 				ctx->cipher_aes192_fb)
 		return _qcrypto_enc_aes_192_fallback(req);
 
+	if (_qcrypto_dispatch_cpu(ctx, req->nbytes))
+		return _qcrypto_cpu_aes(req, true);
+
 	rctx = ablkcipher_request_ctx(req);
 	rctx->aead = 0;
 	rctx->alg = CIPHER_ALG_AES;
@@ -2549,6 +2804,9 @@ static int _qcrypto_enc_aes_ctr(struct ablkcipher_request *req)
 				ctx->cipher_aes192_fb)
 		return _qcrypto_enc_aes_192_fallback(req);
 
+	if (_qcrypto_dispatch_cpu(ctx, req->nbytes))
+		return _qcrypto_cpu_aes(req, true);
+
 	rctx = ablkcipher_request_ctx(req);
 	rctx->aead = 0;
 	rctx->alg = CIPHER_ALG_AES;
@@ -2737,6 +2995,9 @@ static int _qcrypto_dec_aes_ecb(struct ablkcipher_request *req)
 				ctx->cipher_aes192_fb)
 		return _qcrypto_dec_aes_192_fallback(req);
 
+	if (_qcrypto_dispatch_cpu(ctx, req->nbytes))
+		return _qcrypto_cpu_aes(req, false);
+
 	rctx = ablkcipher_request_ctx(req);
 	rctx->aead = 0;
 	rctx->alg = CIPHER_ALG_AES;
@@ -2767,6 +3028,9 @@ static int _qcrypto_dec_aes_cbc(struct ablkcipher_request *req)
 				ctx->cipher_aes192_fb)
 		return _qcrypto_dec_aes_192_fallback(req);
 
+	if (_qcrypto_dispatch_cpu(ctx, req->nbytes))
+		return _qcrypto_cpu_aes(req, false);
+
 	rctx = ablkcipher_request_ctx(req);
 	rctx->aead = 0;
 	rctx->alg = CIPHER_ALG_AES;
@@ -2797,6 +3061,9 @@ static int _qcrypto_dec_aes_ctr(struct ablkcipher_request *req)
 				ctx->cipher_aes192_fb)
 		return _qcrypto_dec_aes_192_fallback(req);
 
+	if (_qcrypto_dispatch_cpu(ctx, req->nbytes))
+		return _qcrypto_cpu_aes(req, false);
+
 	rctx = ablkcipher_request_ctx(req);
 	rctx->aead = 0;
 	rctx->alg = CIPHER_ALG_AES;
@@ -5464,6 +5731,10 @@ static ssize_t _debug_stats_write(struct file *file, const char __user *buf,
 		pe->err_req = 0;
 		qce_clear_driver_stats(pe->qce);
 		pe->max_req_used = 0;
+		pe->total_bytes = 0;
+		pe->busy_ns = 0;
+		pe->total_batches = 0;
+		pe->batched_req = 0;
 	}
 	cp->max_qlen = 0;
 	cp->resp_start = 0;
@@ -5509,6 +5780,19 @@ static int _qcrypto_debug_init(void)
 		rc = PTR_ERR(dent);
 		goto err;
 	}
+
+	if (!debugfs_create_u32("dispatch_enable", 0644, _debug_dent,
+				&qcrypto_dev.dispatch.enable) ||
+		!debugfs_create_u32("dispatch_cpu_max_len", 0644, _debug_dent,
+				&qcrypto_dev.dispatch.cpu_max_len) ||
+		!debugfs_create_u32("dispatch_qce_min_len", 0644, _debug_dent,
+				&qcrypto_dev.dispatch.qce_min_len) ||
+		!debugfs_create_u32("batch_max", 0644, _debug_dent,
+				&qcrypto_dev.batch_max)) {
+		pr_err("qcrypto debugfs dispatch files fail\n");
+		rc = -ENOMEM;
+		goto err;
+	}
 	return 0;
 err:
 	debugfs_remove_recursive(_debug_dent);
@@ -5541,6 +5825,10 @@ static int __init _qcrypto_init(void)
 	pcp->next_engine = NULL;
 	pcp->scheduled_eng = NULL;
 	pcp->ce_req_proc_sts = IN_PROGRESS;
+	pcp->dispatch.enable = 1;
+	pcp->dispatch.cpu_max_len = QCRYPTO_DISPATCH_CPU_MAX_LEN;
+	pcp->dispatch.qce_min_len = QCRYPTO_DISPATCH_QCE_MIN_LEN;
+	pcp->batch_max = QCRYPTO_BATCH_MAX;
 	crypto_init_queue(&pcp->req_queue, MSM_QCRYPTO_REQ_QUEUE_LENGTH);
 	return platform_driver_register(&_qualcomm_crypto);
 }
@@ -9,74 +9,160 @@
 #include <linux/fb.h>
 #include <linux/input.h>
 #include <linux/kthread.h>
+#include <linux/moduleparam.h>
+#include <linux/sched/sysctl.h>
 
 enum {
 	SCREEN_OFF,
 	INPUT_BOOST,
-	MAX_BOOST
+	MAX_BOOST,
+	/* Hint bits live in df_boost_drv's state, one bit per boost_hint */
+	HINT_BOOST
+};
+
+#define HINT_BOOST_MASK GENMASK(HINT_BOOST + BOOST_HINT_MAX - 1, HINT_BOOST)
+
+struct boost_hint_profile {
+	const char *name;
+	unsigned int duration_ms;
+	int stune_boost;
+};
+
+static const struct boost_hint_profile hint_profiles[BOOST_HINT_MAX] = {
+	[BOOST_HINT_LAUNCH] = {
+		.name = "launch",
+		.duration_ms = CONFIG_DEVFREQ_LAUNCH_BOOST_DURATION_MS,
+		.stune_boost = CONFIG_DEVFREQ_LAUNCH_STUNE_BOOST
+	},
+	[BOOST_HINT_FLING] = {
+		.name = "fling",
+		.duration_ms = CONFIG_DEVFREQ_FLING_BOOST_DURATION_MS,
+		.stune_boost = CONFIG_DEVFREQ_FLING_STUNE_BOOST
+	}
 };
 
 struct boost_dev {
 	struct devfreq *df;
+	devfreq_boost_update_t update;
 	struct delayed_work input_unboost;
 	struct delayed_work max_unboost;
-	wait_queue_head_t boost_waitq;
 	atomic_long_t max_boost_expires;
 	unsigned long boost_freq;
+	unsigned long hint_freq[BOOST_HINT_MAX];
+	unsigned long floor_freq;
+	unsigned int input_boost_ms;
 	unsigned long state;
+	unsigned long applied_state;
 };
 
 struct df_boost_drv {
 	struct boost_dev devices[DEVFREQ_MAX];
+	struct delayed_work hint_unboost;
+	wait_queue_head_t boost_waitq;
 	struct notifier_block fb_notif;
+	unsigned long state;
+	unsigned long applied_state;
 };
 
 static void devfreq_input_unboost(struct work_struct *work);
 static void devfreq_max_unboost(struct work_struct *work);
+static void devfreq_hint_unboost(struct work_struct *work);
 
-#define BOOST_DEV_INIT(b, dev, freq) .devices[dev] = {				\
+#define BOOST_DEV_INIT(b, dev, freq, duration_ms, launch_freq, fling_freq)	\
+	.devices[dev] = {							\
 	.input_unboost =							\
 		__DELAYED_WORK_INITIALIZER((b).devices[dev].input_unboost,	\
 					   devfreq_input_unboost, 0),		\
 	.max_unboost =								\
 		__DELAYED_WORK_INITIALIZER((b).devices[dev].max_unboost,	\
 					   devfreq_max_unboost, 0),		\
-	.boost_waitq =								\
-		__WAIT_QUEUE_HEAD_INITIALIZER((b).devices[dev].boost_waitq),	\
-	.boost_freq = freq							\
+	.boost_freq = freq,							\
+	.hint_freq = {								\
+		[BOOST_HINT_LAUNCH] = launch_freq,				\
+		[BOOST_HINT_FLING] = fling_freq					\
+	},									\
+	.input_boost_ms = duration_ms						\
 }
 
+#ifdef CONFIG_CPU_INPUT_BOOST
+#define CPU_INPUT_BOOST_DURATION_MS CONFIG_INPUT_BOOST_DURATION_MS
+#else
+#define CPU_INPUT_BOOST_DURATION_MS 0
+#endif
+
+/* UFS clock scaling only knows two states: scaled down (0) and up (UINT_MAX) */
+#define UFS_BOOST_FREQ (IS_ENABLED(CONFIG_DEVFREQ_UFS_BOOST) ? UINT_MAX : 0)
+
 static struct df_boost_drv df_boost_drv_g __read_mostly = {
+	BOOST_DEV_INIT(df_boost_drv_g, DEVFREQ_CPU,
+		       0, CPU_INPUT_BOOST_DURATION_MS, 0, 0),
 	BOOST_DEV_INIT(df_boost_drv_g, DEVFREQ_MSM_CPUBW,
-		       CONFIG_DEVFREQ_MSM_CPUBW_BOOST_FREQ)
+		       CONFIG_DEVFREQ_MSM_CPUBW_BOOST_FREQ,
+		       CONFIG_DEVFREQ_MSM_CPUBW_BOOST_DURATION_MS,
+		       CONFIG_DEVFREQ_MSM_CPUBW_LAUNCH_BOOST_FREQ,
+		       CONFIG_DEVFREQ_MSM_CPUBW_FLING_BOOST_FREQ),
+	BOOST_DEV_INIT(df_boost_drv_g, DEVFREQ_MSM_MEMLAT_CPU0,
+		       CONFIG_DEVFREQ_MSM_MEMLAT_BOOST_FREQ,
+		       CONFIG_DEVFREQ_MSM_MEMLAT_BOOST_DURATION_MS,
+		       CONFIG_DEVFREQ_MSM_MEMLAT_LAUNCH_BOOST_FREQ,
+		       CONFIG_DEVFREQ_MSM_MEMLAT_FLING_BOOST_FREQ),
+	BOOST_DEV_INIT(df_boost_drv_g, DEVFREQ_MSM_MEMLAT_CPU4,
+		       CONFIG_DEVFREQ_MSM_MEMLAT_BOOST_FREQ,
+		       CONFIG_DEVFREQ_MSM_MEMLAT_BOOST_DURATION_MS,
+		       CONFIG_DEVFREQ_MSM_MEMLAT_LAUNCH_BOOST_FREQ,
+		       CONFIG_DEVFREQ_MSM_MEMLAT_FLING_BOOST_FREQ),
+	BOOST_DEV_INIT(df_boost_drv_g, DEVFREQ_KGSL_GPU,
+		       CONFIG_DEVFREQ_KGSL_GPU_BOOST_FREQ,
+		       CONFIG_DEVFREQ_KGSL_GPU_BOOST_DURATION_MS, 0, 0),
+	BOOST_DEV_INIT(df_boost_drv_g, DEVFREQ_UFS,
+		       UFS_BOOST_FREQ,
+		       CONFIG_DEVFREQ_UFS_BOOST_DURATION_MS, 0, 0),
+	.hint_unboost =
+		__DELAYED_WORK_INITIALIZER(df_boost_drv_g.hint_unboost,
+					   devfreq_hint_unboost, 0),
+	.boost_waitq = __WAIT_QUEUE_HEAD_INITIALIZER(df_boost_drv_g.boost_waitq)
 };
 
-static void __devfreq_boost_kick(struct boost_dev *b)
+static bool boost_dev_active(struct boost_dev *b)
 {
-	if (!READ_ONCE(b->df) || test_bit(SCREEN_OFF, &b->state))
-		return;
+	return READ_ONCE(b->df) || READ_ONCE(b->update);
+}
+
+/*
+ * The kick helpers only update the domain's state and return whether the
+ * boost thread needs to be woken, so that callers kicking several domains at
+ * once wake it a single time.
+ */
+static bool __devfreq_boost_kick(struct boost_dev *b)
+{
+	if (!boost_dev_active(b) || test_bit(SCREEN_OFF, &b->state))
+		return false;
+
+	/* Domains with no input boost profile are left alone on input */
+	if (!b->input_boost_ms || (b->df && !b->boost_freq))
+		return false;
 
 	set_bit(INPUT_BOOST, &b->state);
-	if (!mod_delayed_work(system_unbound_wq, &b->input_unboost,
-		msecs_to_jiffies(CONFIG_DEVFREQ_INPUT_BOOST_DURATION_MS)))
-		wake_up(&b->boost_waitq);
+	return !mod_delayed_work(system_unbound_wq, &b->input_unboost,
+				 msecs_to_jiffies(b->input_boost_ms));
 }
 
 void devfreq_boost_kick(enum df_device device)
 {
 	struct df_boost_drv *d = &df_boost_drv_g;
 
-	__devfreq_boost_kick(d->devices + device);
+	if (__devfreq_boost_kick(d->devices + device))
+		wake_up(&d->boost_waitq);
 }
 
-static void __devfreq_boost_kick_max(struct boost_dev *b,
+static bool __devfreq_boost_kick_max(struct boost_dev *b,
 				     unsigned int duration_ms)
 {
 	unsigned long boost_jiffies = msecs_to_jiffies(duration_ms);
 	unsigned long curr_expires, new_expires;
 
-	if (!READ_ONCE(b->df) || test_bit(SCREEN_OFF, &b->state))
-		return;
+	if (!boost_dev_active(b) || test_bit(SCREEN_OFF, &b->state))
+		return false;
 
 	do {
 		curr_expires = atomic_long_read(&b->max_boost_expires);
@@ -84,21 +170,70 @@ static void __devfreq_boost_kick_max(struct boost_dev *b,
 
 		/* Skip this boost if there's a longer boost in effect */
 		if (time_after(curr_expires, new_expires))
-			return;
+			return false;
 	} while (atomic_long_cmpxchg(&b->max_boost_expires, curr_expires,
 				     new_expires) != curr_expires);
 
 	set_bit(MAX_BOOST, &b->state);
-	if (!mod_delayed_work(system_unbound_wq, &b->max_unboost,
-			      boost_jiffies))
-		wake_up(&b->boost_waitq);
+	return !mod_delayed_work(system_unbound_wq, &b->max_unboost,
+				 boost_jiffies);
 }
 
 void devfreq_boost_kick_max(enum df_device device, unsigned int duration_ms)
 {
 	struct df_boost_drv *d = &df_boost_drv_g;
 
-	__devfreq_boost_kick_max(d->devices + device, duration_ms);
+	if (__devfreq_boost_kick_max(d->devices + device, duration_ms))
+		wake_up(&d->boost_waitq);
+}
+
+static enum boost_hint devfreq_active_hint(unsigned long state)
+{
+	if (test_bit(SCREEN_OFF, &state) || !(state & HINT_BOOST_MASK))
+		return BOOST_HINT_NONE;
+
+	return __ffs(state & HINT_BOOST_MASK) - HINT_BOOST;
+}
+
+void devfreq_boost_kick_hint(enum boost_hint hint, unsigned int duration_ms)
+{
+	struct df_boost_drv *d = &df_boost_drv_g;
+	unsigned long curr_state, new_state;
+
+	if (hint >= BOOST_HINT_MAX)
+		return;
+
+	if (!duration_ms)
+		duration_ms = hint_profiles[hint].duration_ms;
+
+	/* A new hint replaces whichever hint is currently in effect */
+	do {
+		curr_state = READ_ONCE(d->state);
+		if (test_bit(SCREEN_OFF, &curr_state))
+			return;
+
+		new_state = (curr_state & ~HINT_BOOST_MASK) |
+			    BIT(HINT_BOOST + hint);
+	} while (cmpxchg(&d->state, curr_state, new_state) != curr_state);
+
+	mod_delayed_work(system_unbound_wq, &d->hint_unboost,
+			 msecs_to_jiffies(duration_ms));
+	wake_up(&d->boost_waitq);
+}
+
+static bool boost_dev_configured(struct boost_dev *b)
+{
+	int i;
+
+	if (b->boost_freq)
+		return true;
+
+	for (i = 0; i < BOOST_HINT_MAX; i++) {
+		if (b->hint_freq[i])
+			return true;
+	}
+
+	return false;
 }
 
 void devfreq_register_boost_device(enum df_device device, struct devfreq *df)
@@ -106,75 +241,224 @@ void devfreq_register_boost_device(enum df_device device, struct devfreq *df)
 	struct df_boost_drv *d = &df_boost_drv_g;
 	struct boost_dev *b;
 
-	df->is_boost_device = true;
 	b = d->devices + device;
+	/* Taking over min_freq only makes sense if there is a boost to apply */
+	if (!boost_dev_configured(b))
+		return;
+
+	df->is_boost_device = true;
+	/* Remember the floor set at registration so unboosting restores it */
+	b->floor_freq = df->min_freq;
 	WRITE_ONCE(b->df, df);
+	wake_up(&d->boost_waitq);
+}
+EXPORT_SYMBOL_GPL(devfreq_register_boost_device);
+
+void devfreq_register_boost_hook(enum df_device device,
+				 devfreq_boost_update_t update)
+{
+	struct df_boost_drv *d = &df_boost_drv_g;
+
+	WRITE_ONCE(d->devices[device].update, update);
+	wake_up(&d->boost_waitq);
 }
 
 static void devfreq_input_unboost(struct work_struct *work)
 {
+	struct df_boost_drv *d = &df_boost_drv_g;
 	struct boost_dev *b = container_of(to_delayed_work(work),
 					   typeof(*b), input_unboost);
 
 	clear_bit(INPUT_BOOST, &b->state);
-	wake_up(&b->boost_waitq);
+	wake_up(&d->boost_waitq);
 }
 
 static void devfreq_max_unboost(struct work_struct *work)
 {
+	struct df_boost_drv *d = &df_boost_drv_g;
 	struct boost_dev *b = container_of(to_delayed_work(work),
 					   typeof(*b), max_unboost);
 
 	clear_bit(MAX_BOOST, &b->state);
-	wake_up(&b->boost_waitq);
+	wake_up(&d->boost_waitq);
+}
+
+static void devfreq_clear_hints(struct df_boost_drv *d)
+{
+	int i;
+
+	for (i = 0; i < BOOST_HINT_MAX; i++)
+		clear_bit(HINT_BOOST + i, &d->state);
 }
 
-static void devfreq_update_boosts(struct boost_dev *b, unsigned long state)
+static void devfreq_hint_unboost(struct work_struct *work)
 {
+	struct df_boost_drv *d = container_of(to_delayed_work(work),
+					      typeof(*d), hint_unboost);
+
+	devfreq_clear_hints(d);
+	wake_up(&d->boost_waitq);
+}
+
+static unsigned long devfreq_cap_freq(struct devfreq *df, unsigned long freq)
+{
+	/* Devices without a freq table don't report a max_freq */
+	if (df->max_freq)
+		return min(freq, df->max_freq);
+
+	return freq;
+}
+
+static void devfreq_update_boosts(struct boost_dev *b, unsigned long state,
+				  enum boost_hint hint)
+{
+	bool input_boost = false, max_boost = false;
 	struct devfreq *df = b->df;
+	unsigned long min_freq;
 
-	mutex_lock(&df->lock);
-	if (test_bit(SCREEN_OFF, &state)) {
-		df->min_freq = df->profile->freq_table[0];
-		df->max_boost = false;
+	if (!test_bit(SCREEN_OFF, &state)) {
+		input_boost = test_bit(INPUT_BOOST, &state);
+		max_boost = test_bit(MAX_BOOST, &state);
 	} else {
-		df->min_freq = test_bit(INPUT_BOOST, &state) ?
-			       min(b->boost_freq, df->max_freq) :
-			       df->profile->freq_table[0];
-		df->max_boost = test_bit(MAX_BOOST, &state);
+		hint = BOOST_HINT_NONE;
+	}
+
+	if (!df) {
+		b->update(input_boost, max_boost, hint);
+		return;
+	}
+
+	mutex_lock(&df->lock);
+	if (max_boost && !df->profile->freq_table) {
+		/*
+		 * Without a freq table there is no known ceiling, so the
+		 * domain's boost frequency doubles as its max boost.
+		 */
+		input_boost = true;
+		max_boost = false;
 	}
-	update_devfreq(df);
+	min_freq = b->floor_freq;
+	if (input_boost)
+		min_freq = max(min_freq, devfreq_cap_freq(df, b->boost_freq));
+	if (hint != BOOST_HINT_NONE)
+		min_freq = max(min_freq,
+			       devfreq_cap_freq(df, b->hint_freq[hint]));
+	df->min_freq = min_freq;
+	df->max_boost = max_boost;
+	/* A suspended device picks up the new limits when it resumes */
+	if (!df->stop_polling)
+		update_devfreq(df);
 	mutex_unlock(&df->lock);
 }
 
+static bool devfreq_boost_pending(struct df_boost_drv *d)
+{
+	int i;
+
+	if (READ_ONCE(d->state) != d->applied_state)
+		return true;
+
+	for (i = 0; i < DEVFREQ_MAX; i++) {
+		struct boost_dev *b = d->devices + i;
+
+		if (boost_dev_active(b) &&
+		    READ_ONCE(b->state) != b->applied_state)
+			return true;
+	}
+
+	return false;
+}
+
 static int devfreq_boost_thread(void *data)
 {
 	static const struct sched_param sched_max_rt_prio = {
 		.sched_priority = MAX_RT_PRIO - 1
 	};
-	struct boost_dev *b = data;
-	unsigned long old_state = 0;
+	struct df_boost_drv *d = data;
 
 	sched_setscheduler_nocheck(current, SCHED_FIFO, &sched_max_rt_prio);
 
 	while (1) {
-		bool should_stop = false;
-		unsigned long curr_state;
+		bool should_stop = false, hint_changed;
+		unsigned long drv_state;
+		enum boost_hint hint;
+		int i;
 
-		wait_event(b->boost_waitq,
-			(curr_state = READ_ONCE(b->state)) != old_state ||
+		wait_event(d->boost_waitq,
+			devfreq_boost_pending(d) ||
 			(should_stop = kthread_should_stop()));
 
 		if (should_stop)
 			break;
 
-		old_state = curr_state;
-		devfreq_update_boosts(b, curr_state);
+		drv_state = READ_ONCE(d->state);
+		hint = devfreq_active_hint(drv_state);
+		hint_changed = drv_state != d->applied_state;
+		if (hint_changed) {
+			d->applied_state = drv_state;
+			schedtune_set_hint_boost(hint == BOOST_HINT_NONE ? 0 :
+				hint_profiles[hint].stune_boost);
+		}
+
+		/* Apply every domain whose state changed in a single pass */
+		for (i = 0; i < DEVFREQ_MAX; i++) {
+			struct boost_dev *b = d->devices + i;
+			unsigned long curr_state;
+
+			if (!boost_dev_active(b))
+				continue;
+
+			curr_state = READ_ONCE(b->state);
+			if (curr_state == b->applied_state && !hint_changed)
+				continue;
+
+			b->applied_state = curr_state;
+			devfreq_update_boosts(b, curr_state, hint);
+		}
 	}
 
 	return 0;
 }
 
+/*
+ * Userspace posts hints as "<name> [duration_ms]" through
+ * /sys/module/devfreq_boost/parameters/hint. Reading the node shows the hint
+ * currently in effect.
+ */
+static int set_boost_hint(const char *buf, const struct kernel_param *kp)
+{
+	unsigned int duration_ms = 0;
+	char name[16];
+	int i;
+
+	if (sscanf(buf, "%15s %u", name, &duration_ms) < 1)
+		return -EINVAL;
+
+	for (i = 0; i < BOOST_HINT_MAX; i++) {
+		if (!strcmp(name, hint_profiles[i].name)) {
+			devfreq_boost_kick_hint(i, duration_ms);
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static int get_boost_hint(char *buf, const struct kernel_param *kp)
+{
+	struct df_boost_drv *d = &df_boost_drv_g;
+	enum boost_hint hint = devfreq_active_hint(READ_ONCE(d->state));
+
+	return snprintf(buf, PAGE_SIZE, "%s\n", hint == BOOST_HINT_NONE ?
+			"none" : hint_profiles[hint].name);
+}
+
+static const struct kernel_param_ops param_ops_boost_hint = {
+	.set = set_boost_hint,
+	.get = get_boost_hint,
+};
+module_param_cb(hint, &param_ops_boost_hint, NULL, 0644);
+
 static int fb_notifier_cb(struct notifier_block *nb, unsigned long action,
 			  void *data)
 {
@@ -185,6 +469,15 @@ static int fb_notifier_cb(struct notifier_block *nb, unsigned long action,
 	if (action != FB_EARLY_EVENT_BLANK)
 		return NOTIFY_OK;
 
+	/* Hints are dropped when the screen turns off */
+	if (*blank == FB_BLANK_UNBLANK) {
+		clear_bit(SCREEN_OFF, &d->state);
+	} else {
+		set_bit(SCREEN_OFF, &d->state);
+		cancel_delayed_work(&d->hint_unboost);
+		devfreq_clear_hints(d);
+	}
+
 	/* Boost when the screen turns on and unboost when it turns off */
 	for (i = 0; i < DEVFREQ_MAX; i++) {
 		struct boost_dev *b = d->devices + i;
@@ -195,10 +488,12 @@ static int fb_notifier_cb(struct notifier_block *nb, unsigned long action,
 				CONFIG_DEVFREQ_WAKE_BOOST_DURATION_MS);
 		} else {
 			set_bit(SCREEN_OFF, &b->state);
-			wake_up(&b->boost_waitq);
 		}
 	}
 
+	/* The screen state changed for every domain, so always wake up */
+	wake_up(&d->boost_waitq);
+
 	return NOTIFY_OK;
 }
 
@@ -207,10 +502,14 @@ static void devfreq_boost_input_event(struct input_handle *handle,
 				      int value)
 {
 	struct df_boost_drv *d = handle->handler->private;
+	bool wake = false;
 	int i;
 
 	for (i = 0; i < DEVFREQ_MAX; i++)
-		__devfreq_boost_kick(d->devices + i);
+		wake |= __devfreq_boost_kick(d->devices + i);
+
+	if (wake)
+		wake_up(&d->boost_waitq);
 }
 
 static int devfreq_boost_input_connect(struct input_handler *handler,
@@ -289,26 +588,22 @@ static struct input_handler devfreq_boost_input_handler = {
 static int __init devfreq_boost_init(void)
 {
 	struct df_boost_drv *d = &df_boost_drv_g;
-	struct task_struct *thread[DEVFREQ_MAX];
-	int i, ret;
-
-	for (i = 0; i < DEVFREQ_MAX; i++) {
-		struct boost_dev *b = d->devices + i;
+	struct task_struct *thread;
+	int ret;
 
-		thread[i] = kthread_run_perf_critical(devfreq_boost_thread, b,
-						      "devfreq_boostd/%d", i);
-		if (IS_ERR(thread[i])) {
-			ret = PTR_ERR(thread[i]);
-			pr_err("Failed to create kthread, err: %d\n", ret);
-			goto stop_kthreads;
-		}
+	thread = kthread_run_perf_critical(devfreq_boost_thread, d,
+					   "devfreq_boostd");
+	if (IS_ERR(thread)) {
+		ret = PTR_ERR(thread);
+		pr_err("Failed to create kthread, err: %d\n", ret);
+		return ret;
 	}
 
 	devfreq_boost_input_handler.private = d;
 	ret = input_register_handler(&devfreq_boost_input_handler);
 	if (ret) {
 		pr_err("Failed to register input handler, err: %d\n", ret);
-		goto stop_kthreads;
+		goto stop_kthread;
 	}
 
 	d->fb_notif.notifier_call = fb_notifier_cb;
@@ -323,9 +618,8 @@ static int __init devfreq_boost_init(void)
 
 unregister_handler:
 	input_unregister_handler(&devfreq_boost_input_handler);
-stop_kthreads:
-	while (i--)
-		kthread_stop(thread[i]);
+stop_kthread:
+	kthread_stop(thread);
 	return ret;
 }
 late_initcall(devfreq_boost_init);
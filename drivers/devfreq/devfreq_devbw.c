@@ -234,6 +234,10 @@ int devfreq_add_devbw(struct device *dev)
 
 	if (!strcmp(dev_name(dev), "soc:qcom,cpubw"))
 		devfreq_register_boost_device(DEVFREQ_MSM_CPUBW, d->df);
+	else if (!strcmp(dev_name(dev), "soc:qcom,memlat-cpu0"))
+		devfreq_register_boost_device(DEVFREQ_MSM_MEMLAT_CPU0, d->df);
+	else if (!strcmp(dev_name(dev), "soc:qcom,memlat-cpu4"))
+		devfreq_register_boost_device(DEVFREQ_MSM_MEMLAT_CPU4, d->df);
 
 	return 0;
 }
@@ -29,6 +29,9 @@
 #include <linux/platform_device.h>
 #include <linux/of.h>
 #include <linux/devfreq.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
+#include <linux/bw_hwmon_hint.h>
 #include <trace/events/power.h>
 #include "governor.h"
 #include "governor_bw_hwmon.h"
@@ -52,6 +55,7 @@ struct hwmon_node {
 	unsigned int low_power_io_percent;
 	unsigned int low_power_delay;
 	unsigned int mbps_zones[NUM_MBPS_ZONES];
+	unsigned int hint_percent;
 
 	unsigned long prev_ab;
 	unsigned long *dev_ab;
@@ -73,6 +77,7 @@ struct hwmon_node {
 	ktime_t hist_max_ts;
 	bool sampled;
 	bool mon_started;
+	bool hint_met;
 	struct list_head list;
 	void *orig_data;
 	struct bw_hwmon *hw;
@@ -92,6 +97,12 @@ static DEFINE_MUTEX(sync_lock);
 static int use_cnt;
 static DEFINE_MUTEX(state_lock);
 
+static DEFINE_SPINLOCK(hint_lock);
+static unsigned long hint_mbps[BW_HWMON_HINT_MAX];
+static unsigned long hint_expires[BW_HWMON_HINT_MAX];
+static void bw_hwmon_hint_work(struct work_struct *work);
+static DECLARE_WORK(hint_work, bw_hwmon_hint_work);
+
 #define show_attr(name) \
 static ssize_t show_##name(struct device *dev,				\
 			struct device_attribute *attr, char *buf)	\
@@ -310,14 +321,30 @@ unsigned long to_mbps_zone(struct hwmon_node *node, unsigned long mbps)
 
 #define MIN_MBPS	500UL
 #define HIST_PEAK_TOL	60
+/* Sum of all the unexpired consumer hints */
+static unsigned long get_hint_mbps(void)
+{
+	unsigned long flags, mbps = 0;
+	int i;
+
+	spin_lock_irqsave(&hint_lock, flags);
+	for (i = 0; i < BW_HWMON_HINT_MAX; i++)
+		if (time_before(jiffies, hint_expires[i]))
+			mbps += hint_mbps[i];
+	spin_unlock_irqrestore(&hint_lock, flags);
+
+	return mbps;
+}
+
 static unsigned long get_bw_and_set_irq(struct hwmon_node *node,
 					unsigned long *freq, unsigned long *ab)
 {
 	unsigned long meas_mbps, thres, flags, req_mbps, adj_mbps;
-	unsigned long meas_mbps_zone;
+	unsigned long meas_mbps_zone, hint_floor;
 	unsigned long hist_lo_tol, hyst_lo_tol;
 	struct bw_hwmon *hw = node->hw;
 	unsigned int new_bw, io_percent;
+	bool hint_on;
 	ktime_t ts;
 	unsigned int ms = 0;
 
@@ -432,6 +459,17 @@ static unsigned long get_bw_and_set_irq(struct hwmon_node *node,
 			req_mbps = max(req_mbps, node->hyst_mbps);
 	}
 
+	/*
+	 * Hold the bandwidth pre-voted by known consumers until the traffic
+	 * actually shows up, then let the measurements take over. The
+	 * consumers already vote AB for their own traffic, so the hint only
+	 * raises the IB (frequency) vote, which is not summed across voters.
+	 */
+	hint_floor = (get_hint_mbps() * node->hint_percent) / 100;
+	if (meas_mbps >= hint_floor)
+		node->hint_met = true;
+	hint_on = !node->hint_met;
+
 	/* Stretch the short sample window size, if the traffic is too low */
 	if (meas_mbps < MIN_MBPS) {
 		hw->up_wake_mbps = (max(MIN_MBPS, req_mbps)
@@ -485,6 +523,8 @@ static unsigned long get_bw_and_set_irq(struct hwmon_node *node,
 		*ab = roundup(new_bw, node->bw_step);
 
 	*freq = (new_bw * 100) / io_percent;
+	if (hint_on)
+		*freq = max(*freq, (hint_floor * 100) / io_percent);
 	trace_bw_hwmon_update(dev_name(node->hw->df->dev.parent),
 				new_bw,
 				*freq,
@@ -544,6 +584,79 @@ int update_bw_hwmon(struct bw_hwmon *hwmon)
 	return 0;
 }
 
+static void bw_hwmon_hint_work(struct work_struct *work)
+{
+	struct hwmon_node *node;
+	unsigned long flags;
+
+	mutex_lock(&list_lock);
+	list_for_each_entry(node, &hwmon_list, list) {
+		if (!node->hint_percent || !node->hw->df ||
+		    !node->mon_started)
+			continue;
+
+		spin_lock_irqsave(&irq_lock, flags);
+		node->hint_met = false;
+		spin_unlock_irqrestore(&irq_lock, flags);
+
+		update_bw_hwmon(node->hw);
+	}
+	mutex_unlock(&list_lock);
+}
+
+/**
+ * bw_hwmon_hint() - pre-vote bandwidth ahead of a known traffic burst
+ * @client:		consumer posting the hint
+ * @mbps:		expected bandwidth, 0 withdraws the client's hint
+ * @duration_ms:	how long to hold the vote if the traffic never shows up
+ *
+ * The bw_hwmon governors only see traffic one sample window after it
+ * starts, which is too late for isochronous clients such as the display
+ * and camera. Hinted bandwidth sets a floor on the IB vote right away and
+ * is dropped once the measured traffic reaches it, or once the hint
+ * expires. The AB vote stays with the measured traffic, since the clients
+ * vote their own AB. Raising a hint re-evaluates every node immediately; a hint
+ * that doesn't go above the client's active one is ignored so that
+ * periodic callers don't keep the vote up forever.
+ *
+ * May be called from atomic context.
+ */
+int bw_hwmon_hint(enum bw_hwmon_hint_client client, unsigned long mbps,
+		  unsigned int duration_ms)
+{
+	unsigned long flags;
+	bool active, raise;
+
+	if (client >= BW_HWMON_HINT_MAX)
+		return -EINVAL;
+
+	spin_lock_irqsave(&hint_lock, flags);
+	active = time_before(jiffies, hint_expires[client]);
+	raise = mbps && (!active || mbps > hint_mbps[client]);
+	if (raise || !mbps) {
+		hint_mbps[client] = mbps;
+		hint_expires[client] = jiffies + msecs_to_jiffies(duration_ms);
+	}
+	spin_unlock_irqrestore(&hint_lock, flags);
+
+	if (raise)
+		queue_work(system_highpri_wq, &hint_work);
+
+	return 0;
+}
+EXPORT_SYMBOL(bw_hwmon_hint);
+
+/*
+ * Make sure the hint work is not updating a node that is being stopped.
+ * The work is shared by all nodes, so requeue it if it was pending; it
+ * skips nodes whose monitor is no longer started.
+ */
+static void sync_hint_work(void)
+{
+	if (cancel_work_sync(&hint_work))
+		queue_work(system_highpri_wq, &hint_work);
+}
+
 static int start_monitor(struct devfreq *df, bool init)
 {
 	struct hwmon_node *node = df->data;
@@ -652,6 +765,7 @@ static void gov_stop(struct devfreq *df)
 
 	sysfs_remove_group(&df->dev.kobj, node->attr_grp);
 	stop_monitor(df, true);
+	sync_hint_work();
 	df->data = node->orig_data;
 	node->orig_data = NULL;
 	hw->df = NULL;
@@ -681,6 +795,7 @@ static int gov_suspend(struct devfreq *df)
 	}
 
 	stop_monitor(df, false);
+	sync_hint_work();
 
 	mutex_lock(&df->lock);
 	update_devfreq(df);
@@ -789,6 +904,7 @@ gov_attr(idle_mbps, 0U, 2000U);
 gov_attr(low_power_ceil_mbps, 0U, 2500U);
 gov_attr(low_power_io_percent, 1U, 100U);
 gov_attr(low_power_delay, 1U, 60U);
+gov_attr(hint_percent, 0U, 100U);
 gov_list_attr(mbps_zones, NUM_MBPS_ZONES, 0U, UINT_MAX);
 
 static struct attribute *dev_attr[] = {
@@ -808,6 +924,7 @@ static struct attribute *dev_attr[] = {
 	&dev_attr_low_power_ceil_mbps.attr,
 	&dev_attr_low_power_io_percent.attr,
 	&dev_attr_low_power_delay.attr,
+	&dev_attr_hint_percent.attr,
 	&dev_attr_mbps_zones.attr,
 	&dev_attr_throttle_adj.attr,
 	NULL,
@@ -953,6 +1070,7 @@ int register_bw_hwmon(struct device *dev, struct bw_hwmon *hwmon)
 	node->hyst_trigger_count = 3;
 	node->hyst_length = 0;
 	node->idle_mbps = 400;
+	node->hint_percent = 100;
 	node->mbps_zones[0] = 0;
 	node->hw = hwmon;
 
@@ -35,6 +35,11 @@
 
 struct memlat_node {
 	unsigned int ratio_ceil;
+	unsigned int stall_floor;
+	unsigned int stall_boost;
+	unsigned int down_hyst;
+	unsigned int down_cnt;
+	unsigned long prev_freq;
 	bool mon_started;
 	struct list_head list;
 	void *orig_data;
@@ -155,6 +160,8 @@ static int start_monitor(struct devfreq *df)
 		return ret;
 	}
 
+	node->prev_freq = 0;
+	node->down_cnt = 0;
 	devfreq_monitor_start(df);
 
 	node->mon_started = true;
@@ -230,23 +237,36 @@ static int devfreq_memlat_get_freq(struct devfreq *df,
 	struct memlat_hwmon *hw = node->hw;
 	unsigned long max_freq = 0;
 	unsigned int ratio;
+	bool mem_bound;
 
 	hw->get_cnt(hw);
 
 	for (i = 0; i < hw->num_cores; i++) {
+		unsigned long stall_pct = hw->core_stats[i].stall_pct;
+
 		ratio = hw->core_stats[i].inst_count;
 
 		if (hw->core_stats[i].mem_count)
 			ratio /= hw->core_stats[i].mem_count;
 
+		/*
+		 * A low instruction to memory access ratio alone doesn't make
+		 * a core latency bound: it also has to be stalling on memory.
+		 * A core that stalls heavily is treated as memory bound even
+		 * if its ratio is above the ceiling.
+		 */
+		mem_bound = ratio && ratio <= node->ratio_ceil &&
+			    stall_pct >= node->stall_floor;
+		if (node->stall_boost && stall_pct >= node->stall_boost)
+			mem_bound = true;
+
 		trace_memlat_dev_meas(dev_name(df->dev.parent),
 					hw->core_stats[i].id,
 					hw->core_stats[i].inst_count,
 					hw->core_stats[i].mem_count,
 					hw->core_stats[i].freq, ratio);
 
-		if (ratio && ratio <= node->ratio_ceil
-		    && hw->core_stats[i].freq > max_freq) {
+		if (mem_bound && hw->core_stats[i].freq > max_freq) {
 			lat_dev = i;
 			max_freq = hw->core_stats[i].freq;
 		}
@@ -262,14 +282,32 @@ static int devfreq_memlat_get_freq(struct devfreq *df,
 					max_freq);
 	}
 
+	/*
+	 * Raise the vote as soon as a memory bound phase shows up, but only
+	 * drop it after down_hyst consecutive samples asked for less.
+	 */
+	if (max_freq < node->prev_freq && node->down_cnt < node->down_hyst) {
+		node->down_cnt++;
+		max_freq = node->prev_freq;
+	} else {
+		node->down_cnt = 0;
+		node->prev_freq = max_freq;
+	}
+
 	*freq = max_freq;
 	return 0;
 }
 
 gov_attr(ratio_ceil, 1U, 10000U);
+gov_attr(stall_floor, 0U, 100U);
+gov_attr(stall_boost, 0U, 100U);
+gov_attr(down_hyst, 0U, 20U);
 
 static struct attribute *dev_attr[] = {
 	&dev_attr_ratio_ceil.attr,
+	&dev_attr_stall_floor.attr,
+	&dev_attr_stall_boost.attr,
+	&dev_attr_down_hyst.attr,
 	&dev_attr_freq_map.attr,
 	NULL,
 };
@@ -383,6 +421,9 @@ int register_memlat(struct device *dev, struct memlat_hwmon *hw)
 	node->attr_grp = &dev_attr_group;
 
 	node->ratio_ceil = 10;
+	node->stall_floor = 0;
+	node->stall_boost = 0;
+	node->down_hyst = 0;
 	node->hw = hw;
 
 	hw->freq_map = init_core_dev_map(dev, "qcom,core-dev-table");
@@ -43,6 +43,12 @@ static DEFINE_SPINLOCK(suspend_lock);
  * frame length, but less than the idle timer.
  */
 #define CEILING			50000
+
+/*
+ * In frame aware mode stay on the last frame based decision for this long
+ * between frames before handing control back to the TZ algorithm.
+ */
+#define FRAME_HOLD_MS		100
 #define TZ_RESET_ID		0x3
 #define TZ_UPDATE_ID		0x4
 #define TZ_INIT_ID		0x6
@@ -134,15 +140,77 @@ static ssize_t suspend_time_show(struct device *dev,
 	return snprintf(buf, PAGE_SIZE, "%llu\n", time_diff);
 }
 
+static ssize_t frame_dcvs_show(struct device *dev,
+	struct device_attribute *attr,
+	char *buf)
+{
+	struct devfreq_msm_adreno_tz_data *priv = to_devfreq(dev)->data;
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", priv->frame.enable);
+}
+
+static ssize_t frame_dcvs_store(struct device *dev,
+	struct device_attribute *attr,
+	const char *buf, size_t count)
+{
+	struct devfreq_msm_adreno_tz_data *priv = to_devfreq(dev)->data;
+	bool enable;
+	int ret;
+
+	ret = strtobool(buf, &enable);
+	if (ret)
+		return ret;
+
+	priv->frame.enable = enable;
+	priv->frame.valid = false;
+	return count;
+}
+
+static ssize_t frame_dcvs_target_show(struct device *dev,
+	struct device_attribute *attr,
+	char *buf)
+{
+	struct devfreq_msm_adreno_tz_data *priv = to_devfreq(dev)->data;
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", priv->frame.target);
+}
+
+static ssize_t frame_dcvs_target_store(struct device *dev,
+	struct device_attribute *attr,
+	const char *buf, size_t count)
+{
+	struct devfreq_msm_adreno_tz_data *priv = to_devfreq(dev)->data;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	if (!val || val > 100)
+		return -EINVAL;
+
+	priv->frame.target = val;
+	return count;
+}
+
 static DEVICE_ATTR(gpu_load, 0444, gpu_load_show, NULL);
 
 static DEVICE_ATTR(suspend_time, 0444,
 		suspend_time_show,
 		NULL);
 
+static DEVICE_ATTR(frame_dcvs, 0644, frame_dcvs_show, frame_dcvs_store);
+
+static DEVICE_ATTR(frame_dcvs_target, 0644,
+		frame_dcvs_target_show,
+		frame_dcvs_target_store);
+
 static const struct device_attribute *adreno_tz_attr_list[] = {
 		&dev_attr_gpu_load,
 		&dev_attr_suspend_time,
+		&dev_attr_frame_dcvs,
+		&dev_attr_frame_dcvs_target,
 		NULL
 };
 
@@ -342,6 +410,38 @@ static int tz_init(struct devfreq_msm_adreno_tz_data *priv,
 	return ret;
 }
 
+/*
+ * Pick the lowest frequency that would have finished the last frame within
+ * frame.target percent of the time it had, assuming the busy time scales
+ * with the inverse of the frequency.
+ */
+static void tz_frame_target_freq(struct devfreq *devfreq,
+		struct devfreq_msm_adreno_tz_data *priv,
+		struct devfreq_dev_status *stats, unsigned long *freq)
+{
+	u64 budget = min_t(u64, priv->frame.budget, CEILING);
+	u64 required;
+	int level;
+
+	priv->frame.valid = false;
+	priv->frame.last = jiffies;
+	priv->bin.total_time = 0;
+	priv->bin.busy_time = 0;
+
+	if (budget == 0)
+		return;
+
+	required = div64_u64((u64)stats->current_frequency *
+			priv->frame.busy_time * 100, budget * priv->frame.target);
+
+	/* The frequency table is ordered from the highest frequency down */
+	for (level = devfreq->profile->max_state - 1; level > 0; level--)
+		if (devfreq->profile->freq_table[level] >= required)
+			break;
+
+	*freq = devfreq->profile->freq_table[level];
+}
+
 static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
 								u32 *flag)
 {
@@ -368,6 +468,24 @@ static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
 
 	/* Update the GPU load statistics */
 	compute_work_load(&stats, priv, devfreq);
+
+	/*
+	 * In frame aware mode act once per completed frame, and keep the
+	 * frequency between frames as long as frames keep coming.
+	 */
+	if (priv->frame.enable) {
+		if (priv->frame.valid) {
+			tz_frame_target_freq(devfreq, priv, &stats, freq);
+			return 0;
+		}
+
+		if (time_before(jiffies, priv->frame.last +
+				msecs_to_jiffies(FRAME_HOLD_MS))) {
+			priv->bin.total_time = 0;
+			priv->bin.busy_time = 0;
+			return 0;
+		}
+	}
 	/*
 	 * Do not waste CPU cycles running this algorithm if
 	 * the GPU just started, or if less than FLOOR time
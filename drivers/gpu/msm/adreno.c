@@ -864,6 +864,9 @@ static int adreno_probe(struct platform_device *pdev)
 	if (status)
 		goto out;
 
+	spin_lock_init(&adreno_dev->preempt.setup_latency.lock);
+	spin_lock_init(&adreno_dev->preempt.switch_latency.lock);
+
 	adreno_debugfs_init(adreno_dev);
 	adreno_profile_init(adreno_dev);
 
@@ -1904,6 +1907,36 @@ static int adreno_setproperty(struct kgsl_device_private *dev_priv,
 			kgsl_context_put(context);
 		}
 		break;
+	case KGSL_PROP_CONTEXT_DEADLINE: {
+			struct kgsl_context_deadline deadline;
+			struct kgsl_context *context;
+
+			if (sizebytes != sizeof(deadline))
+				break;
+
+			if (copy_from_user(&deadline, value, sizeof(deadline))) {
+				status = -EFAULT;
+				break;
+			}
+
+			/* Keep the reserved field usable for future flags */
+			if (deadline.__pad) {
+				status = -EINVAL;
+				break;
+			}
+
+			context = kgsl_context_get_owner(dev_priv,
+							deadline.context_id);
+			if (context == NULL)
+				break;
+
+			adreno_dispatcher_set_deadline(adreno_dev,
+				ADRENO_CONTEXT(context), deadline.deadline);
+			status = 0;
+
+			kgsl_context_put(context);
+		}
+		break;
 	default:
 		break;
 	}
@@ -236,6 +236,9 @@ enum adreno_preempt_states {
  * @work: A work struct for the preemption worker (for 5XX)
  * @token_submit: Indicates if a preempt token has been submitted in
  * current ringbuffer (for 4XX)
+ * @triggered: Time in ns when the current switch was handed to the CP
+ * @setup_latency: Time spent picking and programming the next ringbuffer
+ * @switch_latency: Time from the CP trigger to the switch completing
  */
 struct adreno_preemption {
 	atomic_t state;
@@ -243,6 +246,9 @@ struct adreno_preemption {
 	struct timer_list timer;
 	struct work_struct work;
 	bool token_submit;
+	u64 triggered;
+	struct kgsl_latency_hist setup_latency;
+	struct kgsl_latency_hist switch_latency;
 };
 
 
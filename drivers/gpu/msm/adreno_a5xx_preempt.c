@@ -88,6 +88,9 @@ static void _a5xx_preemption_done(struct adreno_device *adreno_dev)
 
 	del_timer_sync(&adreno_dev->preempt.timer);
 
+	kgsl_latency_hist_add(&adreno_dev->preempt.switch_latency,
+		ktime_get_ns() - adreno_dev->preempt.triggered);
+
 	trace_adreno_preempt_done(adreno_dev->cur_rb, adreno_dev->next_rb);
 
 	/* Clean up all the bits */
@@ -169,11 +172,15 @@ static void _a5xx_preemption_timer(unsigned long data)
 	queue_work(system_unbound_wq, &adreno_dev->preempt.work);
 }
 
-/* Find the highest priority active ringbuffer */
+/*
+ * Find the highest priority active ringbuffer, or with deadline scheduling
+ * the active ringbuffer with the nearest outstanding frame deadline
+ */
 static struct adreno_ringbuffer *a5xx_next_ringbuffer(
 		struct adreno_device *adreno_dev)
 {
-	struct adreno_ringbuffer *rb;
+	struct adreno_ringbuffer *rb, *next = NULL, *deadline_rb = NULL;
+	u64 now = ktime_get_ns();
 	unsigned long flags;
 	unsigned int i;
 
@@ -184,11 +191,22 @@ static struct adreno_ringbuffer *a5xx_next_ringbuffer(
 		empty = adreno_rb_empty(rb);
 		spin_unlock_irqrestore(&rb->preempt_lock, flags);
 
-		if (empty == false)
+		if (empty == true)
+			continue;
+
+		if (!adreno_dispatch_deadline_sched)
 			return rb;
+
+		if (next == NULL)
+			next = rb;
+
+		if (adreno_drawqueue_has_deadline(&rb->dispatch_q, now) &&
+			(deadline_rb == NULL || rb->dispatch_q.deadline <
+				deadline_rb->dispatch_q.deadline))
+			deadline_rb = rb;
 	}
 
-	return NULL;
+	return deadline_rb ? deadline_rb : next;
 }
 
 void a5xx_preemption_trigger(struct adreno_device *adreno_dev)
@@ -199,12 +217,15 @@ void a5xx_preemption_trigger(struct adreno_device *adreno_dev)
 	uint64_t ttbr0;
 	unsigned int contextidr;
 	unsigned long flags;
+	u64 start;
 
 	/* Put ourselves into a possible trigger state */
 	if (!adreno_move_preempt_state(adreno_dev,
 		ADRENO_PREEMPT_NONE, ADRENO_PREEMPT_START))
 		return;
 
+	start = ktime_get_ns();
+
 	/* Get the next ringbuffer to preempt in */
 	next = a5xx_next_ringbuffer(adreno_dev);
 
@@ -269,6 +290,10 @@ void a5xx_preemption_trigger(struct adreno_device *adreno_dev)
 
 	trace_adreno_preempt_trigger(adreno_dev->cur_rb, adreno_dev->next_rb);
 
+	adreno_dev->preempt.triggered = ktime_get_ns();
+	kgsl_latency_hist_add(&adreno_dev->preempt.setup_latency,
+		adreno_dev->preempt.triggered - start);
+
 	adreno_set_preempt_state(adreno_dev, ADRENO_PREEMPT_TRIGGERED);
 
 	/* Trigger the preemption */
@@ -302,6 +327,9 @@ void a5xx_preempt_callback(struct adreno_device *adreno_dev, int bit)
 
 	del_timer(&adreno_dev->preempt.timer);
 
+	kgsl_latency_hist_add(&adreno_dev->preempt.switch_latency,
+		ktime_get_ns() - adreno_dev->preempt.triggered);
+
 	trace_adreno_preempt_done(adreno_dev->cur_rb,
 		adreno_dev->next_rb);
 
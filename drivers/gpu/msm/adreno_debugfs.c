@@ -21,6 +21,7 @@
 #include "adreno.h"
 #include "kgsl_cffdump.h"
 #include "kgsl_sync.h"
+#include "kgsl_debugfs.h"
 
 static int _isdb_set(void *data, u64 val)
 {
@@ -391,4 +392,16 @@ void adreno_debugfs_init(struct adreno_device *adreno_dev)
 	if (adreno_is_a5xx(adreno_dev))
 		debugfs_create_file("isdb", 0644, device->d_debugfs,
 			device, &_isdb_fops);
+
+	if (kgsl_mmu_get_mmutype(device) == KGSL_MMU_TYPE_IOMMU)
+		kgsl_latency_hist_debugfs("iommu_fault_latency",
+			device->d_debugfs,
+			&KGSL_IOMMU_PRIV(device)->fault_latency);
+
+	if (ADRENO_FEATURE(adreno_dev, ADRENO_PREEMPTION)) {
+		kgsl_latency_hist_debugfs("preempt_setup_latency",
+			device->d_debugfs, &adreno_dev->preempt.setup_latency);
+		kgsl_latency_hist_debugfs("preempt_switch_latency",
+			device->d_debugfs, &adreno_dev->preempt.switch_latency);
+	}
 }
@@ -42,6 +42,14 @@ unsigned int adreno_dispatch_time_slice = 25;
  */
 unsigned int adreno_disp_preempt_fair_sched;
 
+/*
+ * If set then contexts that have attached a frame deadline are dispatched
+ * nearest deadline first, contexts without one are held to the low latency
+ * inflight while a deadline is outstanding on their RB and preemption
+ * prefers the RB with the nearest deadline over the highest priority one
+ */
+unsigned int adreno_dispatch_deadline_sched;
+
 /* Number of commands that can be queued in a context before it sleeps */
 static unsigned int _context_drawqueue_size = 50;
 
@@ -177,6 +185,22 @@ _drawqueue_inflight(struct adreno_dispatcher_drawqueue *drawqueue)
 		? _dispatcher_q_inflight_lo : _dispatcher_q_inflight_hi;
 }
 
+/*
+ * Contexts without a deadline get the low inflight while one is pending on
+ * the RB so that they cannot push the deadline out by a full window
+ */
+static inline int _context_inflight(struct adreno_context *drawctxt,
+		struct adreno_dispatcher_drawqueue *drawqueue)
+{
+	u64 now = ktime_get_ns();
+
+	if (drawctxt->deadline <= now &&
+		adreno_drawqueue_has_deadline(drawqueue, now))
+		return _dispatcher_q_inflight_lo;
+
+	return _drawqueue_inflight(drawqueue);
+}
+
 static void fault_detect_read(struct adreno_device *adreno_dev)
 {
 	int i;
@@ -533,6 +557,40 @@ static void  dispatcher_queue_context(struct adreno_device *adreno_dev,
 	spin_unlock(&dispatcher->plist_lock);
 }
 
+/**
+ * adreno_dispatcher_set_deadline() - Attach a frame deadline to a context
+ * @adreno_dev: Pointer to the adreno device struct
+ * @drawctxt: Pointer to the adreno draw context
+ * @deadline: ktime in nanoseconds the next frame should be done by, 0 clears
+ *
+ * Record the deadline on the context and fold it into the nearest deadline
+ * of the context's RB. The RB value is dropped once it has passed, so a
+ * context that stops setting deadlines stops affecting the others.
+ */
+void adreno_dispatcher_set_deadline(struct adreno_device *adreno_dev,
+		struct adreno_context *drawctxt, u64 deadline)
+{
+	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
+	struct adreno_dispatcher_drawqueue *dispatch_q =
+					&(drawctxt->rb->dispatch_q);
+	u64 now = ktime_get_ns();
+
+	spin_lock(&dispatcher->plist_lock);
+
+	drawctxt->deadline = deadline;
+
+	if (deadline && (dispatch_q->deadline <= now ||
+		deadline < dispatch_q->deadline))
+		WRITE_ONCE(dispatch_q->deadline, deadline);
+
+	spin_unlock(&dispatcher->plist_lock);
+
+	trace_adreno_context_deadline(drawctxt, deadline);
+
+	if (deadline)
+		adreno_dispatcher_schedule(KGSL_DEVICE(adreno_dev));
+}
+
 /**
  * sendcmd() - Send a drawobj to the GPU hardware
  * @dispatcher: Pointer to the adreno dispatcher struct
@@ -666,6 +724,7 @@ static int sendcmd(struct adreno_device *adreno_dev,
 	mutex_unlock(&device->mutex);
 
 	cmdobj->submit_ticks = time.ticks;
+	cmdobj->submit_time = time.ktime;
 
 	dispatch_q->cmd_q[dispatch_q->tail] = cmdobj;
 	dispatch_q->tail = (dispatch_q->tail + 1) %
@@ -777,7 +836,7 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 					&(drawctxt->rb->dispatch_q);
 	int count = 0;
 	int ret = 0;
-	int inflight = _drawqueue_inflight(dispatch_q);
+	int inflight = _context_inflight(drawctxt, dispatch_q);
 	unsigned int timestamp;
 
 	if (drawctxt->base.flags & KGSL_CONTEXT_SPARSE)
@@ -867,6 +926,39 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	return ret;
 }
 
+/**
+ * _dispatcher_next_context() - Pick the next pending context to service
+ * @dispatcher: Pointer to the adreno dispatcher struct
+ *
+ * Return the pending context with the nearest upcoming frame deadline if
+ * deadline scheduling is enabled and any pending context has one, otherwise
+ * the highest priority context. Must be called with the plist_lock held.
+ */
+static struct adreno_context *_dispatcher_next_context(
+		struct adreno_dispatcher *dispatcher)
+{
+	struct adreno_context *drawctxt, *next = NULL;
+
+	if (adreno_dispatch_deadline_sched) {
+		u64 now = ktime_get_ns();
+
+		plist_for_each_entry(drawctxt, &dispatcher->pending, pending) {
+			/* A missed deadline falls back to priority order */
+			if (drawctxt->deadline <= now)
+				continue;
+
+			if (next == NULL || drawctxt->deadline < next->deadline)
+				next = drawctxt;
+		}
+	}
+
+	if (next == NULL)
+		next = plist_first_entry(&dispatcher->pending,
+			struct adreno_context, pending);
+
+	return next;
+}
+
 /**
  * _adreno_dispatcher_issuecmds() - Issue commmands from pending contexts
  * @adreno_dev: Pointer to the adreno device struct
@@ -906,8 +998,7 @@ static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 		}
 
 		/* Get the next entry on the list */
-		drawctxt = plist_first_entry(&dispatcher->pending,
-			struct adreno_context, pending);
+		drawctxt = _dispatcher_next_context(dispatcher);
 
 		plist_del(&drawctxt->pending, &dispatcher->pending);
 
@@ -2315,9 +2406,36 @@ static void retire_cmdobj(struct adreno_device *adreno_dev,
 	drawctxt->ticks_index = (drawctxt->ticks_index + 1) %
 		SUBMIT_RETIRE_TICKS_SIZE;
 
+	/* Let frame aware DCVS know where the frame boundaries are */
+	if (drawobj->flags & KGSL_DRAWOBJ_END_OF_FRAME)
+		kgsl_pwrscale_frame_retired(KGSL_DEVICE(adreno_dev),
+			drawctxt->deadline);
+
 	kgsl_drawobj_destroy(drawobj);
 }
 
+/*
+ * Charge a retired command to its context and process. Commands on an RB
+ * execute in order, so a command runs from the later of its submission and
+ * the retirement of the one before it until it is seen to retire. This
+ * is only as precise as the retire detection and also charges any time the
+ * RB spent preempted out to the command.
+ */
+static void _account_gpu_time(struct adreno_dispatcher_drawqueue *drawqueue,
+		struct kgsl_drawobj_cmd *cmdobj, u64 now)
+{
+	struct kgsl_context *context = DRAWOBJ(cmdobj)->context;
+	u64 start = max(cmdobj->submit_time, drawqueue->retire_time);
+
+	drawqueue->retire_time = now;
+
+	if (now <= start)
+		return;
+
+	atomic64_add(now - start, &context->gpu_time);
+	atomic64_add(now - start, &context->proc_priv->gpu_time);
+}
+
 static int adreno_dispatch_retire_drawqueue(struct adreno_device *adreno_dev,
 		struct adreno_dispatcher_drawqueue *drawqueue)
 {
@@ -2334,6 +2452,7 @@ static int adreno_dispatch_retire_drawqueue(struct adreno_device *adreno_dev,
 			drawobj->timestamp))
 			break;
 
+		_account_gpu_time(drawqueue, cmdobj, local_clock());
 		retire_cmdobj(adreno_dev, cmdobj);
 
 		dispatcher->inflight--;
@@ -2672,6 +2791,14 @@ struct dispatcher_attribute {
 		.value = &(_value), \
 	}
 
+#define DISPATCHER_BOOL_ATTR(_name, _mode, _value) \
+	struct dispatcher_attribute dispatcher_attr_##_name =  { \
+		.attr = { .name = __stringify(_name), .mode = _mode }, \
+		.show = _show_uint, \
+		.store = _store_bool, \
+		.value = &(_value), \
+	}
+
 #define to_dispatcher_attr(_a) \
 	container_of((_a), struct dispatcher_attribute, attr)
 #define to_dispatcher(k) container_of(k, struct adreno_dispatcher, kobj)
@@ -2694,6 +2821,21 @@ static ssize_t _store_uint(struct adreno_dispatcher *dispatcher,
 	return size;
 }
 
+static ssize_t _store_bool(struct adreno_dispatcher *dispatcher,
+		struct dispatcher_attribute *attr,
+		const char *buf, size_t size)
+{
+	unsigned int val = 0;
+	int ret;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	*((unsigned int *) attr->value) = val ? 1 : 0;
+	return size;
+}
+
 static ssize_t _show_uint(struct adreno_dispatcher *dispatcher,
 		struct dispatcher_attribute *attr,
 		char *buf)
@@ -2732,6 +2874,8 @@ static DISPATCHER_UINT_ATTR(dispatch_time_slice, 0644, 0,
 	adreno_dispatch_time_slice);
 static DISPATCHER_UINT_ATTR(dispatch_starvation_time, 0644, 0,
 	adreno_dispatch_starvation_time);
+static DISPATCHER_BOOL_ATTR(deadline_sched, 0644,
+	adreno_dispatch_deadline_sched);
 
 static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_inflight.attr,
@@ -2746,6 +2890,7 @@ static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_disp_preempt_fair_sched.attr,
 	&dispatcher_attr_dispatch_time_slice.attr,
 	&dispatcher_attr_dispatch_starvation_time.attr,
+	&dispatcher_attr_deadline_sched.attr,
 	NULL,
 };
 
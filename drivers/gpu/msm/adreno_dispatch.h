@@ -18,6 +18,7 @@ extern unsigned int adreno_disp_preempt_fair_sched;
 extern unsigned int adreno_drawobj_timeout;
 extern unsigned int adreno_dispatch_starvation_time;
 extern unsigned int adreno_dispatch_time_slice;
+extern unsigned int adreno_dispatch_deadline_sched;
 
 /**
  * enum adreno_dispatcher_starve_timer_states - Starvation control states of
@@ -56,6 +57,9 @@ enum adreno_dispatcher_starve_timer_states {
  * @tail: Queues tail pointer
  * @active_context_count: Number of active contexts seen in this rb drawqueue
  * @expires: The jiffies value at which this drawqueue has run too long
+ * @deadline: Nearest frame deadline (ktime ns) of a context on this RB
+ * @retire_time: local_clock() when the last command on this RB was seen
+ * to retire
  */
 struct adreno_dispatcher_drawqueue {
 	struct kgsl_drawobj_cmd *cmd_q[ADRENO_DISPATCH_DRAWQUEUE_SIZE];
@@ -64,6 +68,8 @@ struct adreno_dispatcher_drawqueue {
 	unsigned int tail;
 	int active_context_count;
 	unsigned long expires;
+	u64 deadline;
+	u64 retire_time;
 };
 
 /**
@@ -123,9 +129,19 @@ void adreno_dispatcher_queue_context(struct kgsl_device *device,
 		struct adreno_context *drawctxt);
 void adreno_dispatcher_preempt_callback(struct adreno_device *adreno_dev,
 					int bit);
+void adreno_dispatcher_set_deadline(struct adreno_device *adreno_dev,
+		struct adreno_context *drawctxt, u64 deadline);
 void adreno_preempt_process_dispatch_queue(struct adreno_device *adreno_dev,
 	struct adreno_dispatcher_drawqueue *dispatch_q);
 
+/* True if the drawqueue has a deadline that has not passed yet */
+static inline bool adreno_drawqueue_has_deadline(
+		struct adreno_dispatcher_drawqueue *drawqueue, u64 now)
+{
+	return adreno_dispatch_deadline_sched &&
+		READ_ONCE(drawqueue->deadline) > now;
+}
+
 static inline bool adreno_drawqueue_is_empty(
 		struct adreno_dispatcher_drawqueue *drawqueue)
 {
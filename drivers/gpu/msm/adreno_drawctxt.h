@@ -53,6 +53,7 @@ struct kgsl_context;
  *		 be written.
  * @active_node: Linkage for nodes in active_list
  * @active_time: Time when this context last seen
+ * @deadline: Target completion time (ktime ns) of the next frame, 0 if none
  */
 struct adreno_context {
 	struct kgsl_context base;
@@ -82,6 +83,7 @@ struct adreno_context {
 
 	struct list_head active_node;
 	unsigned long active_time;
+	u64 deadline;
 };
 
 /* Flag definitions for flag field in adreno_context */
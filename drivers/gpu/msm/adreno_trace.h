@@ -17,6 +17,7 @@
 #define trace_adreno_cmdbatch_retired(...) {}
 #define trace_adreno_cmdbatch_submitted(...) {}
 #define trace_adreno_cmdbatch_sync(...) {}
+#define trace_adreno_context_deadline(...) {}
 #define trace_adreno_drawctxt_invalidate(...) {}
 #define trace_adreno_drawctxt_sleep(...) {}
 #define trace_adreno_drawctxt_switch(...) {}
@@ -274,6 +275,23 @@ DEFINE_EVENT(adreno_drawctxt_template, adreno_drawctxt_invalidate,
 	TP_ARGS(drawctxt)
 );
 
+TRACE_EVENT(adreno_context_deadline,
+	TP_PROTO(struct adreno_context *drawctxt, u64 deadline),
+	TP_ARGS(drawctxt, deadline),
+	TP_STRUCT__entry(
+		__field(unsigned int, id)
+		__field(unsigned int, rb_id)
+		__field(u64, deadline)
+	),
+	TP_fast_assign(
+		__entry->id = drawctxt->base.id;
+		__entry->rb_id = drawctxt->rb->id;
+		__entry->deadline = deadline;
+	),
+	TP_printk("ctx=%u rb=%u deadline=%llu",
+		__entry->id, __entry->rb_id, __entry->deadline)
+);
+
 TRACE_EVENT(adreno_drawctxt_wait_start,
 	TP_PROTO(unsigned int rb_id, unsigned int ctx_id, unsigned int ts),
 	TP_ARGS(rb_id, ctx_id, ts),
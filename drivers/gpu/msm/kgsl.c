@@ -1415,6 +1415,36 @@ long kgsl_ioctl_device_getproperty(struct kgsl_device_private *dev_priv,
 		kgsl_context_put(context);
 		break;
 	}
+	case KGSL_PROP_CONTEXT_GPU_TIME:
+	{
+		struct kgsl_context_gpu_time gpu_time;
+		struct kgsl_context *context;
+
+		if (param->sizebytes != sizeof(gpu_time)) {
+			result = -EINVAL;
+			break;
+		}
+
+		if (copy_from_user(&gpu_time, param->value,
+			sizeof(gpu_time))) {
+			result = -EFAULT;
+			break;
+		}
+
+		context = kgsl_context_get_owner(dev_priv,
+			gpu_time.context_id);
+		if (!context) {
+			result = -EINVAL;
+			break;
+		}
+
+		gpu_time.gpu_time = atomic64_read(&context->gpu_time);
+		kgsl_context_put(context);
+
+		if (copy_to_user(param->value, &gpu_time, sizeof(gpu_time)))
+			result = -EFAULT;
+		break;
+	}
 	case KGSL_PROP_SECURE_BUFFER_ALIGNMENT:
 	{
 		unsigned int align;
@@ -3086,6 +3116,28 @@ out:
 	return ret;
 }
 
+long kgsl_ioctl_gpuobj_commit(struct kgsl_device_private *dev_priv,
+		unsigned int cmd, void *data)
+{
+	struct kgsl_process_private *private = dev_priv->process_priv;
+	struct kgsl_gpuobj_commit *param = data;
+	struct kgsl_mem_entry *entry;
+	long ret;
+
+	entry = kgsl_sharedmem_find_id(private, param->id);
+	if (entry == NULL)
+		return -EINVAL;
+
+	if (kgsl_memdesc_is_lazy(&entry->memdesc))
+		ret = kgsl_sharedmem_commit(&entry->memdesc, param->offset,
+				param->length);
+	else
+		ret = -EINVAL;
+
+	kgsl_mem_entry_put(entry);
+	return ret;
+}
+
 #ifdef CONFIG_ARM64
 static uint64_t kgsl_filter_cachemode(uint64_t flags)
 {
@@ -3126,7 +3178,8 @@ static struct kgsl_mem_entry *gpumem_alloc_entry(
 		| KGSL_MEMALIGN_MASK
 		| KGSL_MEMFLAGS_USE_CPU_MAP
 		| KGSL_MEMFLAGS_SECURE
-		| KGSL_MEMFLAGS_FORCE_32BIT;
+		| KGSL_MEMFLAGS_FORCE_32BIT
+		| KGSL_MEMFLAGS_LAZY_COMMIT;
 
 	/* Turn off SVM if the system doesn't support it */
 	if (!kgsl_mmu_use_cpu_map(&dev_priv->device->mmu))
@@ -4617,7 +4670,9 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 		for (i = 0; i < m->page_count; i++) {
 			struct page *page = m->pages[i];
 
-			vm_insert_page(vma, addr, page);
+			/* Uncommitted pages are inserted on fault */
+			if (page != NULL)
+				vm_insert_page(vma, addr, page);
 			addr += PAGE_SIZE;
 		}
 	}
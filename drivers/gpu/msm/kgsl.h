@@ -27,6 +27,7 @@
 #include <linux/dma-attrs.h>
 #include <linux/uaccess.h>
 #include <linux/kthread.h>
+#include <linux/math64.h>
 #include <asm/cacheflush.h>
 
 /*
@@ -288,9 +289,17 @@ struct kgsl_event_group;
 typedef void (*kgsl_event_func)(struct kgsl_device *, struct kgsl_event_group *,
 		void *, int);
 
+/*
+ * KGSL_EVENT_ATOMIC_PRIORITY callbacks run straight from the context that
+ * retires the timestamp, or from kgsl_add_event() if it already retired,
+ * after the group lock is dropped. They must not sleep since that context
+ * may not be able to. Cancelled atomic events still go through the regular
+ * worker.
+ */
 enum kgsl_priority {
 	KGSL_EVENT_REGULAR_PRIORITY = 0,
 	KGSL_EVENT_LOW_PRIORITY,
+	KGSL_EVENT_ATOMIC_PRIORITY,
 	KGSL_EVENT_NUM_PRIORITIES
 };
 
@@ -452,6 +461,8 @@ long kgsl_ioctl_sparse_unbind(struct kgsl_device_private *dev_priv,
 					unsigned int cmd, void *data);
 long kgsl_ioctl_gpu_sparse_command(struct kgsl_device_private *dev_priv,
 					unsigned int cmd, void *data);
+long kgsl_ioctl_gpuobj_commit(struct kgsl_device_private *dev_priv,
+					unsigned int cmd, void *data);
 
 void kgsl_mem_entry_destroy(struct kref *kref);
 
@@ -605,6 +616,53 @@ static inline void kgsl_free(void *ptr)
 	kfree(ptr);
 }
 
+/* Number of power of two microsecond buckets in a latency histogram */
+#define KGSL_LATENCY_BUCKETS 16
+
+/**
+ * struct kgsl_latency_hist - Distribution of the latency of an event
+ * @lock: Protects the histogram, samples come from interrupt context
+ * @count: Number of samples
+ * @total: Sum of the samples in ns
+ * @min: Smallest sample in ns
+ * @max: Largest sample in ns
+ * @buckets: Bucket 0 counts samples under 1us, bucket i the samples in
+ * [2^(i-1), 2^i) us and the last bucket everything above
+ */
+struct kgsl_latency_hist {
+	spinlock_t lock;
+	u64 count;
+	u64 total;
+	u64 min;
+	u64 max;
+	unsigned int buckets[KGSL_LATENCY_BUCKETS];
+};
+
+/**
+ * kgsl_latency_hist_add() - Record a latency sample
+ * @hist: Histogram to add the sample to
+ * @ns: Latency in ns
+ */
+static inline void kgsl_latency_hist_add(struct kgsl_latency_hist *hist,
+		u64 ns)
+{
+	unsigned int bucket = fls64(div_u64(ns, NSEC_PER_USEC));
+	unsigned long flags;
+
+	if (bucket >= KGSL_LATENCY_BUCKETS)
+		bucket = KGSL_LATENCY_BUCKETS - 1;
+
+	spin_lock_irqsave(&hist->lock, flags);
+	if (hist->count == 0 || ns < hist->min)
+		hist->min = ns;
+	if (ns > hist->max)
+		hist->max = ns;
+	hist->count++;
+	hist->total += ns;
+	hist->buckets[bucket]++;
+	spin_unlock_irqrestore(&hist->lock, flags);
+}
+
 static inline int _copy_from_user(void *dest, void __user *src,
 		unsigned int ksize, unsigned int usize)
 {
@@ -379,6 +379,76 @@ static const struct file_operations global_fops = {
 	.release = globals_release,
 };
 
+static int latency_hist_print(struct seq_file *s, void *unused)
+{
+	struct kgsl_latency_hist *hist = s->private;
+	struct kgsl_latency_hist copy;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&hist->lock, flags);
+	copy = *hist;
+	spin_unlock_irqrestore(&hist->lock, flags);
+
+	seq_printf(s, "samples %llu min_us %llu avg_us %llu max_us %llu\n",
+		copy.count, div_u64(copy.min, NSEC_PER_USEC),
+		copy.count ? div64_u64(copy.total, copy.count * NSEC_PER_USEC)
+			: 0,
+		div_u64(copy.max, NSEC_PER_USEC));
+
+	for (i = 0; i < KGSL_LATENCY_BUCKETS - 1; i++)
+		seq_printf(s, "<%uus: %u\n", 1 << i, copy.buckets[i]);
+
+	seq_printf(s, ">=%uus: %u\n", 1 << (KGSL_LATENCY_BUCKETS - 2),
+		copy.buckets[KGSL_LATENCY_BUCKETS - 1]);
+
+	return 0;
+}
+
+static int latency_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, latency_hist_print, inode->i_private);
+}
+
+/* Any write clears the histogram */
+static ssize_t latency_hist_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct kgsl_latency_hist *hist = s->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&hist->lock, flags);
+	hist->count = 0;
+	hist->total = 0;
+	hist->min = 0;
+	hist->max = 0;
+	memset(hist->buckets, 0, sizeof(hist->buckets));
+	spin_unlock_irqrestore(&hist->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations latency_hist_fops = {
+	.open = latency_hist_open,
+	.read = seq_read,
+	.write = latency_hist_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * kgsl_latency_hist_debugfs() - Expose a latency histogram in debugfs
+ * @name: Name of the file
+ * @parent: Directory to create the file in
+ * @hist: Histogram to show, reset by writing to the file
+ */
+void kgsl_latency_hist_debugfs(const char *name, struct dentry *parent,
+		struct kgsl_latency_hist *hist)
+{
+	debugfs_create_file(name, 0644, parent, hist, &latency_hist_fops);
+}
+
 /**
  * kgsl_process_init_debugfs() - Initialize debugfs for a process
  * @private: Pointer to process private structure created for the process
@@ -32,6 +32,10 @@ static inline struct dentry *kgsl_get_debugfs_dir(void)
 }
 
 void kgsl_process_init_debugfs(struct kgsl_process_private *);
+
+struct kgsl_latency_hist;
+void kgsl_latency_hist_debugfs(const char *name, struct dentry *parent,
+		struct kgsl_latency_hist *hist);
 #else
 static inline void kgsl_core_debugfs_init(void) { }
 static inline void kgsl_device_debugfs_init(struct kgsl_device *device) { }
@@ -41,6 +45,8 @@ static inline struct dentry *kgsl_get_debugfs_dir(void) { return NULL; }
 static inline void kgsl_process_init_debugfs(struct kgsl_process_private *priv)
 {
 }
+static inline void kgsl_latency_hist_debugfs(const char *name,
+		struct dentry *parent, struct kgsl_latency_hist *hist) { }
 #endif
 
 #endif
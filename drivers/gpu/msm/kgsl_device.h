@@ -373,6 +373,7 @@ struct kgsl_process_private;
  * @pwr_constraint: power constraint from userspace for this context
  * @fault_count: number of times gpu hanged in last _context_throttle_time ms
  * @fault_time: time of the first gpu hang in last _context_throttle_time ms
+ * @gpu_time: Cumulative GPU execution time of the context in ns
  */
 struct kgsl_context {
 	struct kref refcount;
@@ -390,6 +391,7 @@ struct kgsl_context {
 	struct kgsl_pwr_constraint pwr_constraint;
 	unsigned int fault_count;
 	unsigned long fault_time;
+	atomic64_t gpu_time;
 };
 
 #define _context_comm(_c) \
@@ -424,6 +426,8 @@ struct kgsl_context {
  * @fd_count: Counter for the number of FDs for this process
  * @ctxt_count: Count for the number of contexts for this process
  * @ctxt_count_lock: Spinlock to protect ctxt_count
+ * @gpu_time: Cumulative GPU execution time in ns of all contexts of the
+ * process
  */
 struct kgsl_process_private {
 	unsigned long priv;
@@ -446,6 +450,7 @@ struct kgsl_process_private {
 	int fd_count;
 	atomic_t ctxt_count;
 	spinlock_t ctxt_count_lock;
+	atomic64_t gpu_time;
 };
 
 /**
@@ -654,6 +659,9 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 int kgsl_add_low_prio_event(struct kgsl_device *device,
 		struct kgsl_event_group *group, unsigned int timestamp,
 		kgsl_event_func func, void *priv);
+int kgsl_add_atomic_event(struct kgsl_device *device,
+		struct kgsl_event_group *group, unsigned int timestamp,
+		kgsl_event_func func, void *priv);
 void kgsl_process_event_group(struct kgsl_device *device,
 		struct kgsl_event_group *group);
 void kgsl_flush_event_group(struct kgsl_device *device,
@@ -68,6 +68,7 @@ struct kgsl_drawobj {
  * buffer
  * @submit_ticks: Variable to hold ticks at the time of
  *     command obj submit.
+ * @submit_time: local_clock() at the time of command obj submit
 
  */
 struct kgsl_drawobj_cmd {
@@ -83,6 +84,7 @@ struct kgsl_drawobj_cmd {
 	uint64_t profiling_buffer_gpuaddr;
 	unsigned int profile_index;
 	uint64_t submit_ticks;
+	u64 submit_time;
 };
 
 /**
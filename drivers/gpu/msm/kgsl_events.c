@@ -40,7 +40,8 @@ static inline void signal_event(struct kgsl_device *device,
 
 static const char *priorities[KGSL_EVENT_NUM_PRIORITIES] = {
 	"KGSL_EVENT_REGULAR_PRIORITY",
-	"KGSL_EVENT_LOW_PRIORITY"
+	"KGSL_EVENT_LOW_PRIORITY",
+	"KGSL_EVENT_ATOMIC_PRIORITY"
 };
 
 const char *prio_to_string(enum kgsl_priority prio)
@@ -51,6 +52,17 @@ const char *prio_to_string(enum kgsl_priority prio)
 		return "<invalid priority>";
 }
 
+static void _kgsl_event_run(struct kgsl_event *event)
+{
+	trace_kgsl_fire_event(id, event->timestamp, event->result,
+		jiffies - event->created, event->func, event->prio);
+
+	event->func(event->device, event->group, event->priv, event->result);
+
+	kgsl_context_put(event->context);
+	kmem_cache_free(events_cache, event);
+}
+
 /**
  * _kgsl_event_worker() - Work handler for processing GPU event callbacks
  * @work: Pointer to the work_struct for the event
@@ -62,13 +74,7 @@ static void _kgsl_event_worker(struct kthread_work *work)
 {
 	struct kgsl_event *event = container_of(work, struct kgsl_event, work);
 
-	trace_kgsl_fire_event(id, event->timestamp, event->result,
-		jiffies - event->created, event->func, event->prio);
-
-	event->func(event->device, event->group, event->priv, event->result);
-
-	kgsl_context_put(event->context);
-	kmem_cache_free(events_cache, event);
+	_kgsl_event_run(event);
 }
 
 /* return true if the group needs to be processed */
@@ -94,6 +100,7 @@ static void _process_event_group(struct kgsl_device *device,
 	struct kgsl_event *event, *tmp;
 	unsigned int timestamp;
 	struct kgsl_context *context;
+	LIST_HEAD(retired);
 
 	if (group == NULL)
 		return;
@@ -116,9 +123,13 @@ static void _process_event_group(struct kgsl_device *device,
 		goto out;
 
 	list_for_each_entry_safe(event, tmp, &group->events, node) {
-		if (timestamp_cmp(event->timestamp, timestamp) <= 0)
-			signal_event(device, event, KGSL_EVENT_RETIRED);
-		else if (flush)
+		if (timestamp_cmp(event->timestamp, timestamp) <= 0) {
+			if (event->prio == KGSL_EVENT_ATOMIC_PRIORITY) {
+				event->result = KGSL_EVENT_RETIRED;
+				list_move_tail(&event->node, &retired);
+			} else
+				signal_event(device, event, KGSL_EVENT_RETIRED);
+		} else if (flush)
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
 
 	}
@@ -127,6 +138,16 @@ static void _process_event_group(struct kgsl_device *device,
 
 out:
 	spin_unlock(&group->lock);
+
+	/*
+	 * Atomic callbacks don't wait for a worker. The group reference on the
+	 * context keeps their kgsl_context_put() from being the last one.
+	 */
+	list_for_each_entry_safe(event, tmp, &retired, node) {
+		list_del(&event->node);
+		_kgsl_event_run(event);
+	}
+
 	kgsl_context_put(context);
 }
 
@@ -308,7 +329,11 @@ static int kgsl_add_event_common(struct kgsl_device *device,
 
 	if (timestamp_cmp(retired, timestamp) >= 0) {
 		event->result = KGSL_EVENT_RETIRED;
-		if (prio == KGSL_EVENT_LOW_PRIORITY)
+		if (prio == KGSL_EVENT_ATOMIC_PRIORITY) {
+			spin_unlock(&group->lock);
+			_kgsl_event_run(event);
+			return 0;
+		} else if (prio == KGSL_EVENT_LOW_PRIORITY)
 			queue_kthread_work(
 				&kgsl_driver.low_prio_worker, &event->work);
 		else
@@ -350,6 +375,23 @@ int kgsl_add_low_prio_event(
 }
 EXPORT_SYMBOL(kgsl_add_low_prio_event);
 
+/**
+ * kgsl_add_atomic_event() - Add a GPU event that is signaled without a worker
+ * @device: Pointer to a KGSL device
+ * @group: Pointer to the group to add the event to
+ * @timestamp: Timestamp that the event will expire on
+ * @func: Callback function for the event, must not sleep
+ * @priv: Private data to send to the callback function
+ */
+int kgsl_add_atomic_event(struct kgsl_device *device,
+		struct kgsl_event_group *group, unsigned int timestamp,
+		kgsl_event_func func, void *priv)
+{
+	return kgsl_add_event_common(device, group, timestamp, func, priv,
+		KGSL_EVENT_ATOMIC_PRIORITY);
+}
+EXPORT_SYMBOL(kgsl_add_atomic_event);
+
 static DEFINE_RWLOCK(group_lock);
 static LIST_HEAD(group_list);
 
@@ -470,75 +470,91 @@ static int _iommu_unmap_sync_pc(struct kgsl_pagetable *pt,
 	return 0;
 }
 
-static int _iommu_map_sg_offset_sync_pc(struct kgsl_pagetable *pt,
-		uint64_t addr, struct kgsl_memdesc *memdesc,
-		struct scatterlist *sg, int nents,
-		uint64_t offset, uint64_t size, unsigned int flags)
+/* Largest run merged into a single scatterlist entry */
+#define KGSL_IOMMU_MAX_RUN	SZ_1G
+
+/*
+ * Walk the [offset, offset + size) window of a scatterlist merging
+ * physically contiguous entries. If @out is NULL only count the merged
+ * entries, otherwise fill @out which must have room for that many. Returns
+ * 0 if the scatterlist does not cover the whole window.
+ */
+static unsigned int _iommu_sg_coalesce(struct scatterlist *sg, int nents,
+		uint64_t offset, uint64_t size, struct scatterlist *out)
 {
-	struct kgsl_iommu_pt *iommu_pt = pt->priv;
-	uint64_t offset_tmp = offset;
-	uint64_t size_tmp = size;
-	size_t mapped = 0;
-	unsigned int i;
-	struct scatterlist *s;
-	phys_addr_t physaddr;
-	int ret;
+	struct scatterlist *s, *d = NULL;
+	phys_addr_t start = 0, end = 0;
+	uint64_t run = 0;
+	unsigned int count = 0;
+	int i;
 
-	ret = _lock_if_secure_mmu(memdesc, pt->mmu);
-	if (ret)
-		return ret;
+	for_each_sg(sg, s, nents, i) {
+		phys_addr_t phys;
+		uint64_t len;
 
-	_iommu_sync_mmu_pc(true);
+		if (size == 0)
+			break;
 
-	for_each_sg(sg, s, nents, i) {
 		/* Iterate until we find the offset */
-		if (offset_tmp >= s->length) {
-			offset_tmp -= s->length;
+		if (offset >= s->length) {
+			offset -= s->length;
 			continue;
 		}
 
-		/* How much mapping is needed in this sg? */
-		if (size < s->length - offset_tmp)
-			size_tmp = size;
-		else
-			size_tmp = s->length - offset_tmp;
-
-		/* Get the phys addr for the offset page */
-		if (offset_tmp != 0) {
-			physaddr = page_to_phys(nth_page(sg_page(s),
-					offset_tmp >> PAGE_SHIFT));
-			/* Reset offset_tmp */
-			offset_tmp = 0;
-		} else
-			physaddr = page_to_phys(sg_page(s));
-
-		/* Do the map for this sg */
-		ret = iommu_map(iommu_pt->domain, addr + mapped,
-				physaddr, size_tmp, flags);
-		if (ret)
-			break;
+		phys = page_to_phys(sg_page(s)) + s->offset + offset;
+		len = min_t(uint64_t, s->length - offset, size);
+		offset = 0;
+		size -= len;
 
-		mapped += size_tmp;
-		size -= size_tmp;
+		if (count && phys == end && run + len <= KGSL_IOMMU_MAX_RUN) {
+			run += len;
+		} else {
+			if (d != NULL)
+				sg_set_page(d, pfn_to_page(start >> PAGE_SHIFT),
+					run, start & ~PAGE_MASK);
+			if (out != NULL)
+				d = d ? sg_next(d) : out;
+			start = phys;
+			run = len;
+			count++;
+		}
 
-		if (size == 0)
-			break;
+		end = phys + len;
 	}
 
-	_iommu_sync_mmu_pc(false);
+	if (d != NULL)
+		sg_set_page(d, pfn_to_page(start >> PAGE_SHIFT), run,
+			start & ~PAGE_MASK);
 
-	_unlock_if_secure_mmu(memdesc, pt->mmu);
+	/* The window runs past the end of the scatterlist */
+	if (size != 0)
+		return 0;
 
-	if (size != 0) {
-		/* Cleanup on error */
-		_iommu_unmap_sync_pc(pt, memdesc, addr, mapped);
-		KGSL_CORE_ERR(
-			"map sg offset err: 0x%016llX, %d, %x, %zd\n",
-			addr, nents, flags, mapped);
-		return  -ENODEV;
-	}
+	return count;
+}
 
-	return 0;
+/*
+ * Build a scatterlist for the [offset, offset + size) window of @sg with
+ * physically contiguous entries merged so that the IOMMU driver can use
+ * the largest block mappings the layout allows. Returns the number of
+ * merged entries or a negative error.
+ */
+static int _iommu_sgt_coalesce(struct sg_table *sgt, struct scatterlist *sg,
+		int nents, uint64_t offset, uint64_t size)
+{
+	unsigned int count = _iommu_sg_coalesce(sg, nents, offset, size, NULL);
+	int ret;
+
+	if (count == 0)
+		return -EINVAL;
+
+	ret = sg_alloc_table(sgt, count, GFP_KERNEL);
+	if (ret)
+		return ret;
+
+	_iommu_sg_coalesce(sg, nents, offset, size, sgt->sgl);
+
+	return count;
 }
 
 static int _iommu_map_sg_sync_pc(struct kgsl_pagetable *pt,
@@ -571,6 +587,34 @@ static int _iommu_map_sg_sync_pc(struct kgsl_pagetable *pt,
 	return 0;
 }
 
+static int _iommu_map_sg_offset_sync_pc(struct kgsl_pagetable *pt,
+		uint64_t addr, struct kgsl_memdesc *memdesc,
+		struct scatterlist *sg, int nents,
+		uint64_t offset, uint64_t size, unsigned int flags)
+{
+	struct sg_table sgt;
+	int ret;
+
+	/*
+	 * Map the whole window in one go instead of one iommu_map() per
+	 * entry so the page table is walked and synced once
+	 */
+	ret = _iommu_sgt_coalesce(&sgt, sg, nents, offset, size);
+	if (ret < 0) {
+		KGSL_CORE_ERR(
+			"map sg offset err: 0x%016llX, %d, %x, %d\n",
+			addr, nents, flags, ret);
+		return ret == -EINVAL ? -ENODEV : ret;
+	}
+
+	ret = _iommu_map_sg_sync_pc(pt, addr, memdesc, sgt.sgl, sgt.nents,
+			flags);
+
+	sg_free_table(&sgt);
+
+	return ret;
+}
+
 /*
  * One page allocation for a guard region to protect against over-zealous
  * GPU pre-fetch
@@ -818,7 +862,7 @@ static struct kgsl_process_private *kgsl_iommu_identify_process(u64 ptbase)
 	return p;
 }
 
-static int kgsl_iommu_fault_handler(struct iommu_domain *domain,
+static int _iommu_fault_handler(struct iommu_domain *domain,
 	struct device *dev, unsigned long addr, int flags, void *token)
 {
 	int ret = 0;
@@ -966,6 +1010,22 @@ static int kgsl_iommu_fault_handler(struct iommu_domain *domain,
 	return ret;
 }
 
+static int kgsl_iommu_fault_handler(struct iommu_domain *domain,
+	struct device *dev, unsigned long addr, int flags, void *token)
+{
+	struct kgsl_pagetable *pt = token;
+	u64 start = ktime_get_ns();
+	int ret;
+
+	ret = _iommu_fault_handler(domain, dev, addr, flags, token);
+
+	if (pt->mmu != NULL)
+		kgsl_latency_hist_add(&_IOMMU_PRIV(pt->mmu)->fault_latency,
+			ktime_get_ns() - start);
+
+	return ret;
+}
+
 /*
  * kgsl_iommu_disable_clk() - Disable iommu clocks
  * Disable IOMMU clocks
@@ -1517,6 +1577,8 @@ static int kgsl_iommu_init(struct kgsl_mmu *mmu)
 
 	mmu->features |= KGSL_MMU_PAGED;
 
+	spin_lock_init(&iommu->fault_latency.lock);
+
 	if (ctx->name == NULL) {
 		KGSL_CORE_ERR("dt: gfx3d0_user context bank not found\n");
 		return -EINVAL;
@@ -1797,6 +1859,46 @@ static unsigned int _get_protection_flags(struct kgsl_memdesc *memdesc)
 	return flags;
 }
 
+static int kgsl_iommu_sparse_dummy_map(struct kgsl_pagetable *pt,
+		struct kgsl_memdesc *memdesc, uint64_t offset, uint64_t size)
+{
+	int ret = 0, i;
+	struct page **pages = NULL;
+	struct sg_table sgt;
+	int count = size >> PAGE_SHIFT;
+
+	/* verify the offset is within our range */
+	if (size + offset > memdesc->size)
+		return -EINVAL;
+
+	if (kgsl_dummy_page == NULL) {
+		kgsl_dummy_page = alloc_page(GFP_KERNEL | __GFP_ZERO |
+				__GFP_HIGHMEM);
+		if (kgsl_dummy_page == NULL)
+			return -ENOMEM;
+	}
+
+	pages = kcalloc(count, sizeof(struct page *), GFP_KERNEL);
+	if (pages == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++)
+		pages[i] = kgsl_dummy_page;
+
+	ret = sg_alloc_table_from_pages(&sgt, pages, count,
+			0, size, GFP_KERNEL);
+	if (ret == 0) {
+		ret = _iommu_map_sg_sync_pc(pt, memdesc->gpuaddr + offset,
+				memdesc, sgt.sgl, sgt.nents,
+				IOMMU_READ | IOMMU_NOEXEC);
+		sg_free_table(&sgt);
+	}
+
+	kfree(pages);
+
+	return ret;
+}
+
 static int
 kgsl_iommu_map(struct kgsl_pagetable *pt,
 			struct kgsl_memdesc *memdesc)
@@ -1806,6 +1908,23 @@ kgsl_iommu_map(struct kgsl_pagetable *pt,
 	uint64_t size = memdesc->size;
 	unsigned int flags = _get_protection_flags(memdesc);
 	struct sg_table *sgt = NULL;
+	struct sg_table merged;
+
+	/*
+	 * Lazily committed objects start out on the dummy page, the pages
+	 * already committed are swapped in by kgsl_sharedmem_lazy_map()
+	 */
+	if (kgsl_memdesc_is_lazy(memdesc)) {
+		ret = kgsl_iommu_sparse_dummy_map(pt, memdesc, 0, size);
+		if (ret)
+			return ret;
+
+		ret = _iommu_map_guard_page(pt, memdesc, addr + size, flags);
+		if (ret)
+			_iommu_unmap_sync_pc(pt, memdesc, addr, size);
+
+		return ret;
+	}
 
 	/*
 	 * For paged memory allocated through kgsl, memdesc->pages is not NULL.
@@ -1820,7 +1939,20 @@ kgsl_iommu_map(struct kgsl_pagetable *pt,
 	if (IS_ERR(sgt))
 		return PTR_ERR(sgt);
 
-	ret = _iommu_map_sg_sync_pc(pt, addr, memdesc, sgt->sgl,
+	/*
+	 * Imported tables list each chunk separately even when the chunks
+	 * are physically adjacent. Merge them when that helps, so that the
+	 * runs can go in as block mappings.
+	 */
+	if (memdesc->pages == NULL &&
+		_iommu_sg_coalesce(sgt->sgl, sgt->nents, 0, size, NULL) <
+			sgt->nents &&
+		_iommu_sgt_coalesce(&merged, sgt->sgl, sgt->nents, 0, size) > 0) {
+		ret = _iommu_map_sg_sync_pc(pt, addr, memdesc, merged.sgl,
+				merged.nents, flags);
+		sg_free_table(&merged);
+	} else
+		ret = _iommu_map_sg_sync_pc(pt, addr, memdesc, sgt->sgl,
 				sgt->nents, flags);
 	if (ret)
 		goto done;
@@ -1836,42 +1968,34 @@ done:
 	return ret;
 }
 
-static int kgsl_iommu_sparse_dummy_map(struct kgsl_pagetable *pt,
-		struct kgsl_memdesc *memdesc, uint64_t offset, uint64_t size)
+static int kgsl_iommu_map_pages(struct kgsl_pagetable *pt,
+		struct kgsl_memdesc *memdesc, uint64_t offset,
+		struct page **pages, unsigned int count)
 {
-	int ret = 0, i;
-	struct page **pages = NULL;
+	uint64_t addr = memdesc->gpuaddr + offset;
+	uint64_t size = (uint64_t) count << PAGE_SHIFT;
 	struct sg_table sgt;
-	int count = size >> PAGE_SHIFT;
+	int ret;
 
-	/* verify the offset is within our range */
-	if (size + offset > memdesc->size)
+	if (count == 0 || size + offset > memdesc->size)
 		return -EINVAL;
 
-	if (kgsl_dummy_page == NULL) {
-		kgsl_dummy_page = alloc_page(GFP_KERNEL | __GFP_ZERO |
-				__GFP_HIGHMEM);
-		if (kgsl_dummy_page == NULL)
-			return -ENOMEM;
-	}
-
-	pages = kcalloc(count, sizeof(struct page *), GFP_KERNEL);
-	if (pages == NULL)
-		return -ENOMEM;
-
-	for (i = 0; i < count; i++)
-		pages[i] = kgsl_dummy_page;
+	ret = sg_alloc_table_from_pages(&sgt, pages, count, 0, size,
+			GFP_KERNEL);
+	if (ret)
+		return ret;
 
-	ret = sg_alloc_table_from_pages(&sgt, pages, count,
-			0, size, GFP_KERNEL);
+	ret = _iommu_unmap_sync_pc(pt, memdesc, addr, size);
 	if (ret == 0) {
-		ret = _iommu_map_sg_sync_pc(pt, memdesc->gpuaddr + offset,
-				memdesc, sgt.sgl, sgt.nents,
-				IOMMU_READ | IOMMU_NOEXEC);
-		sg_free_table(&sgt);
+		ret = _iommu_map_sg_sync_pc(pt, addr, memdesc, sgt.sgl,
+				sgt.nents, _get_protection_flags(memdesc));
+
+		/* Put the dummy page back so the range stays mapped */
+		if (ret)
+			kgsl_iommu_sparse_dummy_map(pt, memdesc, offset, size);
 	}
 
-	kfree(pages);
+	sg_free_table(&sgt);
 
 	return ret;
 }
@@ -2725,4 +2849,5 @@ static struct kgsl_mmu_pt_ops iommu_pt_ops = {
 	.mmu_map_offset = kgsl_iommu_map_offset,
 	.mmu_unmap_offset = kgsl_iommu_unmap_offset,
 	.mmu_sparse_dummy_map = kgsl_iommu_sparse_dummy_map,
+	.mmu_map_pages = kgsl_iommu_map_pages,
 };
@@ -130,6 +130,7 @@ struct kgsl_iommu_context {
  * @protect: register protection settings for the iommu.
  * @pagefault_suppression_count: Total number of pagefaults
  *				 suppressed since boot.
+ * @fault_latency: Time spent in the pagefault handler
  */
 struct kgsl_iommu {
 	struct kgsl_iommu_context ctx[KGSL_IOMMU_CONTEXT_MAX];
@@ -144,6 +145,7 @@ struct kgsl_iommu {
 	unsigned int version;
 	struct kgsl_protected_registers protect;
 	u32 pagefault_suppression_count;
+	struct kgsl_latency_hist fault_latency;
 };
 
 /*
@@ -407,6 +407,15 @@ kgsl_mmu_map(struct kgsl_pagetable *pagetable,
 		if (ret)
 			return ret;
 
+		if (kgsl_memdesc_is_lazy(memdesc)) {
+			ret = kgsl_sharedmem_lazy_map(memdesc);
+			if (ret) {
+				pagetable->pt_ops->mmu_unmap(pagetable,
+						memdesc);
+				return ret;
+			}
+		}
+
 		atomic_inc(&pagetable->stats.entries);
 		KGSL_STATS_ADD(size, &pagetable->stats.mapped,
 				&pagetable->stats.max_mapped);
@@ -563,6 +572,26 @@ int kgsl_mmu_sparse_dummy_map(struct kgsl_pagetable *pagetable,
 }
 EXPORT_SYMBOL(kgsl_mmu_sparse_dummy_map);
 
+/**
+ * kgsl_mmu_map_pages() - Replace the dummy page mapping with real pages
+ * @pagetable: Pagetable the memdesc is mapped in
+ * @memdesc: Memory descriptor of the object
+ * @offset: Offset in the object of the first page
+ * @pages: Pages to map
+ * @count: Number of pages
+ */
+int kgsl_mmu_map_pages(struct kgsl_pagetable *pagetable,
+		struct kgsl_memdesc *memdesc, uint64_t offset,
+		struct page **pages, unsigned int count)
+{
+	if (PT_OP_VALID(pagetable, mmu_map_pages))
+		return pagetable->pt_ops->mmu_map_pages(pagetable, memdesc,
+				offset, pages, count);
+
+	return 0;
+}
+EXPORT_SYMBOL(kgsl_mmu_map_pages);
+
 void kgsl_mmu_remove_global(struct kgsl_device *device,
 		struct kgsl_memdesc *memdesc)
 {
@@ -110,6 +110,9 @@ struct kgsl_mmu_pt_ops {
 	int (*mmu_sparse_dummy_map)(struct kgsl_pagetable *pt,
 			struct kgsl_memdesc *memdesc, uint64_t offset,
 			uint64_t size);
+	int (*mmu_map_pages)(struct kgsl_pagetable *pt,
+			struct kgsl_memdesc *memdesc, uint64_t offset,
+			struct page **pages, unsigned int count);
 };
 
 /*
@@ -237,6 +240,9 @@ struct kgsl_memdesc *kgsl_mmu_get_qtimer_global_entry(
 
 int kgsl_mmu_sparse_dummy_map(struct kgsl_pagetable *pagetable,
 		struct kgsl_memdesc *memdesc, uint64_t offset, uint64_t size);
+int kgsl_mmu_map_pages(struct kgsl_pagetable *pagetable,
+		struct kgsl_memdesc *memdesc, uint64_t offset,
+		struct page **pages, unsigned int count);
 
 /*
  * Static inline functions of MMU that simply call the SMMU specific
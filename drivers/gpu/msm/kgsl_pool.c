@@ -15,7 +15,9 @@
 #include <asm/cacheflush.h>
 #include <linux/slab.h>
 #include <linux/highmem.h>
+#include <linux/percpu.h>
 #include <linux/version.h>
+#include <linux/prezero.h>
 
 #include "kgsl.h"
 #include "kgsl_device.h"
@@ -25,6 +27,22 @@
 #define KGSL_MAX_POOL_ORDER 8
 #define KGSL_MAX_RESERVED_PAGES 4096
 
+/* Per-CPU cache: refill/drain this many pool entries at a time */
+#define KGSL_POOL_PCP_BATCH 16
+#define KGSL_POOL_PCP_HIGH (2 * KGSL_POOL_PCP_BATCH)
+
+/**
+ * struct kgsl_pool_pcp - Per-CPU cache of zeroed pages in front of a pool
+ * @lock: Only contended when the shrinker drains a remote CPU
+ * @count: Number of pool entries in @list
+ * @list: Pages cached for this CPU
+ */
+struct kgsl_pool_pcp {
+	spinlock_t lock;
+	int count;
+	struct list_head list;
+};
+
 /**
  * struct kgsl_page_pool - Structure to hold information for the pool
  * @pool_order: Page order describing the size of the page
@@ -34,6 +52,7 @@
  * from system memory
  * @list_lock: Spinlock for page list in the pool
  * @page_list: List of pages held/reserved in this pool
+ * @pcp: Per-CPU caches, NULL if they could not be allocated
  */
 struct kgsl_page_pool {
 	unsigned int pool_order;
@@ -42,6 +61,7 @@ struct kgsl_page_pool {
 	bool allocation_allowed;
 	spinlock_t list_lock;
 	struct list_head page_list;
+	struct kgsl_pool_pcp __percpu *pcp;
 };
 
 static struct kgsl_page_pool kgsl_pools[KGSL_MAX_POOLS];
@@ -79,6 +99,34 @@ _kgsl_pool_zero_page(struct page *p, unsigned int pool_order)
 	}
 }
 
+/*
+ * Get a zeroed page of @order from the system, preferring the background
+ * zeroed reservoir. Reservoir pages were only zeroed through the cache so
+ * they still need to be flushed before the GPU sees them.
+ */
+static struct page *
+_kgsl_alloc_zeroed_page(unsigned int order)
+{
+	struct page *p = prezero_alloc_page(order);
+	int i;
+
+	if (p == NULL) {
+		p = alloc_pages(kgsl_gfp_mask(order), order);
+		if (p != NULL)
+			_kgsl_pool_zero_page(p, order);
+		return p;
+	}
+
+	for (i = 0; i < (1 << order); i++) {
+		void *addr = kmap_atomic(nth_page(p, i));
+
+		dmac_flush_range(addr, addr + PAGE_SIZE);
+		kunmap_atomic(addr);
+	}
+
+	return p;
+}
+
 /* Add a page to specified pool */
 static void
 _kgsl_pool_add_page(struct kgsl_page_pool *pool, struct page *p)
@@ -108,17 +156,122 @@ _kgsl_pool_get_page(struct kgsl_page_pool *pool)
 	return p;
 }
 
+/*
+ * Move up to @nr entries from the tail of the per-CPU list back to the
+ * pool. Called with pcp->lock held.
+ */
+static void
+_kgsl_pool_pcp_drain(struct kgsl_page_pool *pool, struct kgsl_pool_pcp *pcp,
+		int nr)
+{
+	struct page *p;
+
+	spin_lock(&pool->list_lock);
+	while (nr-- > 0 && pcp->count) {
+		p = list_last_entry(&pcp->list, struct page, lru);
+		list_move(&p->lru, &pool->page_list);
+		pcp->count--;
+		pool->page_count++;
+	}
+	spin_unlock(&pool->list_lock);
+}
+
+/* Take a zeroed page from this CPU's cache, refilling it in a batch */
+static struct page *
+_kgsl_pool_pcp_get_page(struct kgsl_page_pool *pool)
+{
+	struct kgsl_pool_pcp *pcp;
+	struct page *p, *page = NULL;
+
+	if (!pool->pcp)
+		return _kgsl_pool_get_page(pool);
+
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (!pcp->count) {
+		int nr = KGSL_POOL_PCP_BATCH;
+
+		spin_lock(&pool->list_lock);
+		while (nr-- > 0 && pool->page_count) {
+			p = list_first_entry(&pool->page_list, struct page,
+					lru);
+			list_move(&p->lru, &pcp->list);
+			pool->page_count--;
+			pcp->count++;
+		}
+		spin_unlock(&pool->list_lock);
+	}
+
+	if (pcp->count) {
+		page = list_first_entry(&pcp->list, struct page, lru);
+		list_del(&page->lru);
+		pcp->count--;
+	}
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+
+	return page;
+}
+
+/* Give a page back through this CPU's cache */
+static void
+_kgsl_pool_pcp_add_page(struct kgsl_page_pool *pool, struct page *p)
+{
+	struct kgsl_pool_pcp *pcp;
+
+	if (!pool->pcp) {
+		_kgsl_pool_add_page(pool, p);
+		return;
+	}
+
+	/* Zero outside the cache lock, it may be a high order page */
+	_kgsl_pool_zero_page(p, pool->pool_order);
+
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	list_add(&p->lru, &pcp->list);
+	pcp->count++;
+	if (pcp->count > KGSL_POOL_PCP_HIGH)
+		_kgsl_pool_pcp_drain(pool, pcp, KGSL_POOL_PCP_BATCH);
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+}
+
+/* Flush every CPU's cache of specified pool back to the pool list */
+static void
+kgsl_pool_pcp_drain_all(struct kgsl_page_pool *pool)
+{
+	int cpu;
+
+	if (!pool->pcp)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct kgsl_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		spin_lock(&pcp->lock);
+		_kgsl_pool_pcp_drain(pool, pcp, pcp->count);
+		spin_unlock(&pcp->lock);
+	}
+}
+
 /* Returns the number of pages in specified pool */
 static int
 kgsl_pool_size(struct kgsl_page_pool *kgsl_pool)
 {
-	int size;
+	int size, cpu;
 
 	spin_lock(&kgsl_pool->list_lock);
-	size = kgsl_pool->page_count * (1 << kgsl_pool->pool_order);
+	size = kgsl_pool->page_count;
 	spin_unlock(&kgsl_pool->list_lock);
 
-	return size;
+	/* The per-CPU counts are only read, a stale value is fine here */
+	if (kgsl_pool->pcp)
+		for_each_possible_cpu(cpu)
+			size += READ_ONCE(per_cpu_ptr(kgsl_pool->pcp,
+						cpu)->count);
+
+	return size * (1 << kgsl_pool->pool_order);
 }
 
 /* Returns the number of pages in all kgsl page pools */
@@ -178,6 +331,10 @@ kgsl_pool_reduce(unsigned int target_pages, bool exit)
 	struct kgsl_page_pool *pool;
 	unsigned long pcount = 0;
 
+	/* Let the per-CPU caches be reclaimed along with the pool lists */
+	for (i = 0; i < kgsl_num_pools; i++)
+		kgsl_pool_pcp_drain_all(&kgsl_pools[i]);
+
 	total_pages = kgsl_pool_size_total();
 
 	for (i = (kgsl_num_pools - 1); i >= 0; i--) {
@@ -317,9 +474,7 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 
 	/* If the pool is not configured get pages from the system */
 	if (!kgsl_num_pools) {
-		gfp_t gfp_mask = kgsl_gfp_mask(order);
-
-		page = alloc_pages(gfp_mask, order);
+		page = _kgsl_alloc_zeroed_page(order);
 		if (page == NULL) {
 			/* Retry with lower order pages */
 			if (order > 0) {
@@ -329,7 +484,6 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 			} else
 				return -ENOMEM;
 		}
-		_kgsl_pool_zero_page(page, order);
 		goto done;
 	}
 
@@ -344,23 +498,18 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 			 * Fall back to direct allocation in case
 			 * pool with zero order is not present
 			 */
-			gfp_t gfp_mask = kgsl_gfp_mask(order);
-
-			page = alloc_pages(gfp_mask, order);
+			page = _kgsl_alloc_zeroed_page(order);
 			if (page == NULL)
 				return -ENOMEM;
-			_kgsl_pool_zero_page(page, order);
 			goto done;
 		}
 	}
 
 	pool_idx = kgsl_pool_idx_lookup(order);
-	page = _kgsl_pool_get_page(pool);
+	page = _kgsl_pool_pcp_get_page(pool);
 
 	/* Allocate a new page if not allocated from pool */
 	if (page == NULL) {
-		gfp_t gfp_mask = kgsl_gfp_mask(order);
-
 		/* Only allocate non-reserved memory for certain pools */
 		if (!pool->allocation_allowed && pool_idx > 0) {
 			size = PAGE_SIZE <<
@@ -368,7 +517,7 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 			goto eagain;
 		}
 
-		page = alloc_pages(gfp_mask, order);
+		page = _kgsl_alloc_zeroed_page(order);
 
 		if (!page) {
 			if (pool_idx > 0) {
@@ -379,8 +528,6 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 			} else
 				return -ENOMEM;
 		}
-
-		_kgsl_pool_zero_page(page, order);
 	}
 
 done:
@@ -413,7 +560,7 @@ void kgsl_pool_free_page(struct page *page)
 			(kgsl_pool_size_total() < kgsl_pool_max_pages)) {
 		pool = _kgsl_get_pool_from_order(page_order);
 		if (pool != NULL) {
-			_kgsl_pool_add_page(pool, page);
+			_kgsl_pool_pcp_add_page(pool, page);
 			return;
 		}
 	}
@@ -495,6 +642,23 @@ static struct shrinker kgsl_pool_shrinker = {
 	.batch = 0,
 };
 
+static void kgsl_pool_pcp_init(struct kgsl_page_pool *pool)
+{
+	int cpu;
+
+	pool->pcp = alloc_percpu(struct kgsl_pool_pcp);
+	if (pool->pcp == NULL)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct kgsl_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		spin_lock_init(&pcp->lock);
+		INIT_LIST_HEAD(&pcp->list);
+		pcp->count = 0;
+	}
+}
+
 static void kgsl_pool_config(unsigned int order, unsigned int reserved_pages,
 		bool allocation_allowed)
 {
@@ -513,6 +677,7 @@ static void kgsl_pool_config(unsigned int order, unsigned int reserved_pages,
 	kgsl_pools[kgsl_num_pools].allocation_allowed = allocation_allowed;
 	spin_lock_init(&kgsl_pools[kgsl_num_pools].list_lock);
 	INIT_LIST_HEAD(&kgsl_pools[kgsl_num_pools].page_list);
+	kgsl_pool_pcp_init(&kgsl_pools[kgsl_num_pools]);
 	kgsl_num_pools++;
 }
 
@@ -574,10 +739,17 @@ void kgsl_init_page_pools(struct platform_device *pdev)
 
 void kgsl_exit_page_pools(void)
 {
+	int i;
+
 	/* Release all pages in pools, if any.*/
 	kgsl_pool_reduce(0, true);
 
 	/* Unregister shrinker */
 	unregister_shrinker(&kgsl_pool_shrinker);
+
+	for (i = 0; i < kgsl_num_pools; i++) {
+		free_percpu(kgsl_pools[i].pcp);
+		kgsl_pools[i].pcp = NULL;
+	}
 }
 
@@ -3085,3 +3085,46 @@ unsigned int kgsl_pwr_limits_get_freq(enum kgsl_deviceid id)
 	return freq;
 }
 EXPORT_SYMBOL(kgsl_pwr_limits_get_freq);
+
+/**
+ * kgsl_pwr_limits_get_level_freq() - Get the frequency of a power level
+ * @id: Device ID
+ * @level: Power level, 0 being the fastest
+ *
+ * Return the frequency of a power level that can be used as a limit, or 0
+ * if there is no such level.
+ */
+unsigned int kgsl_pwr_limits_get_level_freq(enum kgsl_deviceid id,
+	unsigned int level)
+{
+	struct kgsl_device *device = kgsl_get_device(id);
+	struct kgsl_pwrctrl *pwr;
+
+	if (IS_ERR_OR_NULL(device))
+		return 0;
+	pwr = &device->pwrctrl;
+	if (level > pwr->num_pwrlevels - 2)
+		return 0;
+
+	return pwr->pwrlevels[level].gpu_freq;
+}
+EXPORT_SYMBOL(kgsl_pwr_limits_get_level_freq);
+
+/**
+ * kgsl_pwr_limits_get_cur_freq() - Get the current frequency
+ * @id: Device ID
+ *
+ * Get the frequency of the active power level of the device
+ */
+unsigned int kgsl_pwr_limits_get_cur_freq(enum kgsl_deviceid id)
+{
+	struct kgsl_device *device = kgsl_get_device(id);
+	struct kgsl_pwrctrl *pwr;
+
+	if (IS_ERR_OR_NULL(device))
+		return 0;
+	pwr = &device->pwrctrl;
+
+	return pwr->pwrlevels[pwr->active_pwrlevel].gpu_freq;
+}
+EXPORT_SYMBOL(kgsl_pwr_limits_get_cur_freq);
@@ -14,6 +14,7 @@
 #include <linux/export.h>
 #include <linux/kernel.h>
 #include <linux/hrtimer.h>
+#include <linux/devfreq_boost.h>
 
 #include "kgsl.h"
 #include "kgsl_pwrscale.h"
@@ -168,6 +169,78 @@ void kgsl_pwrscale_update(struct kgsl_device *device)
 }
 EXPORT_SYMBOL(kgsl_pwrscale_update);
 
+/**
+ * kgsl_pwrscale_frame_retired() - Report the end of a frame
+ * @device: The device
+ * @deadline: ktime in ns the frame was meant to be done by, 0 if unknown
+ *
+ * Called by the dispatcher when an end of frame command retires. With frame
+ * aware DCVS enabled this also kicks the governor so that it can act on the
+ * frame that just completed instead of waiting for the next sample window.
+ * May be called without the device mutex held.
+ */
+void kgsl_pwrscale_frame_retired(struct kgsl_device *device, u64 deadline)
+{
+	struct kgsl_pwrscale *psc = &device->pwrscale;
+	struct devfreq_msm_adreno_tz_data *data = psc->gpu_profile.private_data;
+
+	if (!psc->enabled)
+		return;
+
+	spin_lock(&psc->frame.lock);
+	psc->frame.count++;
+	psc->frame.end = ktime_get();
+	psc->frame.deadline = deadline;
+	spin_unlock(&psc->frame.lock);
+
+	if (data->frame.enable && device->state == KGSL_STATE_ACTIVE)
+		queue_work(psc->devfreq_wq, &psc->devfreq_notify_ws);
+}
+EXPORT_SYMBOL(kgsl_pwrscale_frame_retired);
+
+/*
+ * Hand the last completed frame over to the governor: its busy time and the
+ * time it had to complete in, which is the interval since the previous frame
+ * or the frame deadline if that was tighter. Called with the device mutex
+ * held after the sample busy time was folded into @psc->frame.busy.
+ */
+static void _pwrscale_frame_sample(struct kgsl_pwrscale *psc,
+		struct devfreq_msm_adreno_tz_data *data)
+{
+	struct kgsl_pwrscale_frame *frame = &psc->frame;
+	ktime_t end, prev_end;
+	u64 deadline, budget;
+	unsigned int count;
+
+	spin_lock(&frame->lock);
+	count = frame->count;
+	end = frame->end;
+	deadline = frame->deadline;
+	frame->count = 0;
+	spin_unlock(&frame->lock);
+
+	if (!count)
+		return;
+
+	prev_end = frame->prev_end;
+	frame->prev_end = end;
+
+	if (ktime_to_ns(prev_end) != 0) {
+		budget = div_u64(ktime_us_delta(end, prev_end), count);
+
+		if (deadline > ktime_to_ns(prev_end))
+			budget = min_t(u64, budget,
+				div_u64(deadline - ktime_to_ns(prev_end),
+					NSEC_PER_USEC));
+
+		data->frame.busy_time = div_u64(frame->busy, count);
+		data->frame.budget = budget;
+		data->frame.valid = true;
+	}
+
+	frame->busy = 0;
+}
+
 void kgsl_pwrscale_midframe_timer_restart(struct kgsl_device *device)
 {
 	if (kgsl_midframe) {
@@ -395,6 +468,9 @@ int kgsl_devfreq_get_dev_status(struct device *dev,
 
 	stat->busy_time = pwrscale->accum_stats.busy_time;
 
+	pwrscale->frame.busy += stat->busy_time;
+	_pwrscale_frame_sample(pwrscale, pwrscale->gpu_profile.private_data);
+
 	stat->current_frequency = kgsl_pwrctrl_active_freq(&device->pwrctrl);
 
 	stat->private_data = &device->active_context_count;
@@ -682,6 +758,13 @@ int kgsl_pwrscale_init(struct device *dev, const char *governor)
 		of_property_read_bool(device->pdev->dev.of_node,
 			"qcom,enable-ca-jump");
 
+	data->frame.enable = of_property_read_bool(device->pdev->dev.of_node,
+		"qcom,enable-frame-dcvs");
+	if (of_property_read_u32(device->pdev->dev.of_node,
+			"qcom,frame-dcvs-target", &data->frame.target) ||
+		!data->frame.target || data->frame.target > 100)
+		data->frame.target = 90;
+
 	if (data->ctxt_aware_enable) {
 		if (of_property_read_u32(device->pdev->dev.of_node,
 				"qcom,ca-target-pwrlevel",
@@ -741,6 +824,7 @@ int kgsl_pwrscale_init(struct device *dev, const char *governor)
 	}
 
 	pwrscale->devfreqptr = devfreq;
+	devfreq_register_boost_device(DEVFREQ_KGSL_GPU, devfreq);
 
 	pwrscale->gpu_profile.bus_devfreq = NULL;
 	if (data->bus.num) {
@@ -762,6 +846,7 @@ int kgsl_pwrscale_init(struct device *dev, const char *governor)
 	INIT_WORK(&pwrscale->devfreq_suspend_ws, do_devfreq_suspend);
 	INIT_WORK(&pwrscale->devfreq_resume_ws, do_devfreq_resume);
 	INIT_WORK(&pwrscale->devfreq_notify_ws, do_devfreq_notify);
+	spin_lock_init(&pwrscale->frame.lock);
 	if (kgsl_midframe)
 		INIT_WORK(&kgsl_midframe->timer_check_ws,
 				kgsl_pwrscale_midframe_timer_check);
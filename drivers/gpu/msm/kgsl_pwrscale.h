@@ -52,6 +52,24 @@ struct kgsl_pwr_history {
 	unsigned int size;
 };
 
+/**
+ * struct kgsl_pwrscale_frame - Frame boundary tracking for frame aware DCVS
+ * @lock - Protects the fields written from frame retire
+ * @count - Frames retired since the last governor sample
+ * @end - Retire time of the most recent frame
+ * @deadline - Deadline of the most recent frame in ktime ns, 0 if none
+ * @prev_end - Retire time of the frame before the current one
+ * @busy - GPU busy time in usec accumulated since @prev_end
+ */
+struct kgsl_pwrscale_frame {
+	spinlock_t lock;
+	unsigned int count;
+	ktime_t end;
+	u64 deadline;
+	ktime_t prev_end;
+	u64 busy;
+};
+
 /**
  * struct kgsl_pwrscale - Power scaling settings for a KGSL device
  * @devfreqptr - Pointer to the devfreq device
@@ -72,6 +90,7 @@ struct kgsl_pwr_history {
  * @next_governor_call - Timestamp after which the governor may be notified of
  * a new sample
  * @history - History of power events with timestamps and durations
+ * @frame - Frame boundaries reported by the dispatcher
  */
 struct kgsl_pwrscale {
 	struct devfreq *devfreqptr;
@@ -91,6 +110,7 @@ struct kgsl_pwrscale {
 	struct work_struct devfreq_notify_ws;
 	ktime_t next_governor_call;
 	struct kgsl_pwr_history history[KGSL_PWREVENT_MAX];
+	struct kgsl_pwrscale_frame frame;
 };
 
 int kgsl_pwrscale_init(struct device *dev, const char *governor);
@@ -101,6 +121,7 @@ void kgsl_pwrscale_update_stats(struct kgsl_device *device);
 void kgsl_pwrscale_busy(struct kgsl_device *device);
 void kgsl_pwrscale_sleep(struct kgsl_device *device);
 void kgsl_pwrscale_wake(struct kgsl_device *device);
+void kgsl_pwrscale_frame_retired(struct kgsl_device *device, u64 deadline);
 
 void kgsl_pwrscale_midframe_timer_restart(struct kgsl_device *device);
 void kgsl_pwrscale_midframe_timer_cancel(struct kgsl_device *device);
@@ -40,6 +40,9 @@ static bool sharedmem_noretry_flag;
 
 static DEFINE_MUTEX(kernel_map_global_lock);
 
+/* Serializes committing pages to KGSL_MEMFLAGS_LAZY_COMMIT objects */
+static DEFINE_MUTEX(lazy_commit_lock);
+
 struct cp2_mem_chunks {
 	unsigned int chunk_list;
 	unsigned int chunk_list_size;
@@ -160,11 +163,19 @@ gpumem_unmapped_show(struct kgsl_process_private *priv, int type, char *buf)
 			priv->stats[type].cur - priv->gpumem_mapped);
 }
 
+static ssize_t
+gpu_time_show(struct kgsl_process_private *priv, int type, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%lld\n",
+			(long long) atomic64_read(&priv->gpu_time));
+}
+
 static struct kgsl_mem_entry_attribute debug_memstats[] = {
 	__MEM_ENTRY_ATTR(0, imported_mem, imported_mem_show),
 	__MEM_ENTRY_ATTR(0, gpumem_mapped, gpumem_mapped_show),
 	__MEM_ENTRY_ATTR(KGSL_MEM_ENTRY_KERNEL, gpumem_unmapped,
 				gpumem_unmapped_show),
+	__MEM_ENTRY_ATTR(0, gpu_time, gpu_time_show),
 };
 
 /**
@@ -416,6 +427,11 @@ int kgsl_allocate_user(struct kgsl_device *device,
 {
 	int ret;
 
+	/* The uncommitted range is backed by the IOMMU dummy page */
+	if (kgsl_mmu_get_mmutype(device) == KGSL_MMU_TYPE_NONE ||
+			(flags & KGSL_MEMFLAGS_SECURE))
+		flags &= ~((uint64_t) KGSL_MEMFLAGS_LAZY_COMMIT);
+
 	memdesc->flags = flags;
 
 	if (kgsl_mmu_get_mmutype(device) == KGSL_MMU_TYPE_NONE)
@@ -473,7 +489,7 @@ static void kgsl_page_alloc_unmap_kernel(struct kgsl_memdesc *memdesc)
 	memdesc->hostptr_count--;
 	if (memdesc->hostptr_count)
 		goto done;
-	vunmap(memdesc->hostptr);
+	vm_unmap_ram(memdesc->hostptr, memdesc->page_count);
 
 	atomic_long_sub(memdesc->size, &kgsl_driver.stats.vmalloc);
 	memdesc->hostptr = NULL;
@@ -544,8 +560,10 @@ static int kgsl_page_alloc_map_kernel(struct kgsl_memdesc *memdesc)
 	if ((!memdesc->hostptr) && (memdesc->pages != NULL)) {
 		pgprot_t page_prot = pgprot_writecombine(PAGE_KERNEL);
 
-		memdesc->hostptr = vmap(memdesc->pages, memdesc->page_count,
-					VM_IOREMAP, page_prot);
+		/* Small objects come from the per-cpu vmap blocks */
+		memdesc->hostptr = vm_map_ram(memdesc->pages,
+					memdesc->page_count, NUMA_NO_NODE,
+					page_prot);
 		if (memdesc->hostptr)
 			KGSL_STATS_ADD(memdesc->size,
 				&kgsl_driver.stats.vmalloc,
@@ -561,6 +579,186 @@ static int kgsl_page_alloc_map_kernel(struct kgsl_memdesc *memdesc)
 	return ret;
 }
 
+/*
+ * Back @count pages from @first with memory and, if the object is already in
+ * the GPU pagetable, swap them in for the dummy page. Called with
+ * lazy_commit_lock held.
+ */
+static int _lazy_commit_run(struct kgsl_memdesc *memdesc, unsigned int first,
+		unsigned int count)
+{
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < count; i++) {
+		int page_size = PAGE_SIZE;
+		unsigned int align = PAGE_SHIFT;
+
+		if (kgsl_pool_alloc_page(&page_size, &memdesc->pages[first + i],
+				1, &align) <= 0) {
+			ret = -ENOMEM;
+			break;
+		}
+	}
+
+	if (ret == 0 && (memdesc->priv & KGSL_MEMDESC_MAPPED))
+		ret = kgsl_mmu_map_pages(memdesc->pagetable, memdesc,
+				(uint64_t) first << PAGE_SHIFT,
+				&memdesc->pages[first], count);
+
+	if (ret) {
+		while (i--) {
+			kgsl_pool_free_page(memdesc->pages[first + i]);
+			memdesc->pages[first + i] = NULL;
+		}
+		return ret;
+	}
+
+	KGSL_STATS_ADD((uint64_t) count << PAGE_SHIFT,
+		&kgsl_driver.stats.page_alloc,
+		&kgsl_driver.stats.page_alloc_max);
+
+	return 0;
+}
+
+/**
+ * kgsl_sharedmem_commit() - Back a range of a lazily committed object
+ * @memdesc: Memory descriptor of the object
+ * @offset: Offset of the range in the object
+ * @size: Size of the range
+ *
+ * Allocate the pages in the range that are not backed yet and map them to
+ * the GPU in place of the dummy page. Does nothing for other objects.
+ *
+ * Return: 0 on success or negative error code
+ */
+int kgsl_sharedmem_commit(struct kgsl_memdesc *memdesc,
+		uint64_t offset, uint64_t size)
+{
+	unsigned int i, first, end;
+	int ret = 0;
+
+	if (!kgsl_memdesc_is_lazy(memdesc))
+		return 0;
+
+	if (size == 0 || offset + size < offset ||
+			offset + size > memdesc->size)
+		return -ERANGE;
+
+	i = offset >> PAGE_SHIFT;
+	end = PAGE_ALIGN(offset + size) >> PAGE_SHIFT;
+
+	mutex_lock(&lazy_commit_lock);
+	while (i < end && ret == 0) {
+		if (memdesc->pages[i] != NULL) {
+			i++;
+			continue;
+		}
+
+		/* Commit each run of missing pages with a single map */
+		first = i;
+		while (i < end && memdesc->pages[i] == NULL)
+			i++;
+
+		ret = _lazy_commit_run(memdesc, first, i - first);
+	}
+	mutex_unlock(&lazy_commit_lock);
+
+	return ret;
+}
+
+/**
+ * kgsl_sharedmem_lazy_map() - Map the committed pages of a lazy object
+ * @memdesc: Memory descriptor, already mapped to the dummy page
+ *
+ * Pages committed before the object was first mapped to the GPU replace the
+ * dummy page here, pages committed afterwards are mapped as they come.
+ *
+ * Return: 0 on success or negative error code
+ */
+int kgsl_sharedmem_lazy_map(struct kgsl_memdesc *memdesc)
+{
+	unsigned int i = 0, first;
+	int ret = 0;
+
+	mutex_lock(&lazy_commit_lock);
+	while (i < memdesc->page_count && ret == 0) {
+		if (memdesc->pages[i] == NULL) {
+			i++;
+			continue;
+		}
+
+		first = i;
+		while (i < memdesc->page_count && memdesc->pages[i] != NULL)
+			i++;
+
+		ret = kgsl_mmu_map_pages(memdesc->pagetable, memdesc,
+				(uint64_t) first << PAGE_SHIFT,
+				&memdesc->pages[first], i - first);
+	}
+
+	if (ret == 0)
+		memdesc->priv |= KGSL_MEMDESC_MAPPED;
+	mutex_unlock(&lazy_commit_lock);
+
+	return ret;
+}
+
+static int kgsl_lazy_vmfault(struct kgsl_memdesc *memdesc,
+				struct vm_area_struct *vma,
+				struct vm_fault *vmf)
+{
+	unsigned long offset;
+	int ret;
+
+	offset = ((unsigned long) vmf->virtual_address - vma->vm_start);
+
+	if (offset >= memdesc->size)
+		return VM_FAULT_SIGBUS;
+
+	/* The first CPU access commits the page */
+	ret = kgsl_sharedmem_commit(memdesc, offset & PAGE_MASK, PAGE_SIZE);
+	if (ret == -ENOMEM)
+		return VM_FAULT_OOM;
+	else if (ret)
+		return VM_FAULT_SIGBUS;
+
+	return kgsl_page_alloc_vmfault(memdesc, vma, vmf);
+}
+
+static void kgsl_lazy_free(struct kgsl_memdesc *memdesc)
+{
+	unsigned int i, count = 0;
+
+	kgsl_page_alloc_unmap_kernel(memdesc);
+	/* we certainly do not expect the hostptr to still be mapped */
+	BUG_ON(memdesc->hostptr);
+
+	/* Only the committed pages have anything to free */
+	for (i = 0; i < memdesc->page_count; i++) {
+		if (memdesc->pages[i] == NULL)
+			continue;
+
+		kgsl_pool_free_page(memdesc->pages[i]);
+		count++;
+	}
+
+	atomic_long_sub((long) count << PAGE_SHIFT,
+		&kgsl_driver.stats.page_alloc);
+}
+
+static int kgsl_lazy_map_kernel(struct kgsl_memdesc *memdesc)
+{
+	int ret;
+
+	/* vmap() needs every page so commit the whole object first */
+	ret = kgsl_sharedmem_commit(memdesc, 0, memdesc->size);
+	if (ret)
+		return ret;
+
+	return kgsl_page_alloc_map_kernel(memdesc);
+}
+
 static int kgsl_contiguous_vmfault(struct kgsl_memdesc *memdesc,
 				struct vm_area_struct *vma,
 				struct vm_fault *vmf)
@@ -613,6 +811,15 @@ static struct kgsl_memdesc_ops kgsl_page_alloc_ops = {
 	.unmap_kernel = kgsl_page_alloc_unmap_kernel,
 };
 
+/* Lazily committed paged memory */
+static struct kgsl_memdesc_ops kgsl_lazy_ops = {
+	.free = kgsl_lazy_free,
+	.vmflags = VM_DONTDUMP | VM_DONTEXPAND | VM_DONTCOPY,
+	.vmfault = kgsl_lazy_vmfault,
+	.map_kernel = kgsl_lazy_map_kernel,
+	.unmap_kernel = kgsl_page_alloc_unmap_kernel,
+};
+
 /* CMA ops - used during NOMMU mode */
 static struct kgsl_memdesc_ops kgsl_cma_ops = {
 	.free = kgsl_cma_coherent_free,
@@ -700,6 +907,28 @@ static int kgsl_do_cache_op(struct page *page, void *addr,
 	return 0;
 }
 
+/* Pages that are not committed yet have nothing in the CPU caches */
+static int _lazy_cache_range_op(struct kgsl_memdesc *memdesc,
+		uint64_t offset, uint64_t size, unsigned int op)
+{
+	int ret = 0;
+
+	while (size && ret == 0) {
+		uint64_t pg_offset = offset & ~PAGE_MASK;
+		uint64_t len = min_t(uint64_t, size, PAGE_SIZE - pg_offset);
+		struct page *page;
+
+		page = READ_ONCE(memdesc->pages[offset >> PAGE_SHIFT]);
+		if (page != NULL)
+			ret = kgsl_do_cache_op(page, NULL, pg_offset, len, op);
+
+		offset += len;
+		size -= len;
+	}
+
+	return ret;
+}
+
 int kgsl_cache_range_op(struct kgsl_memdesc *memdesc, uint64_t offset,
 		uint64_t size, unsigned int op)
 {
@@ -730,6 +959,9 @@ int kgsl_cache_range_op(struct kgsl_memdesc *memdesc, uint64_t offset,
 		return ret;
 	}
 
+	if (kgsl_memdesc_is_lazy(memdesc))
+		return _lazy_cache_range_op(memdesc, offset, size, op);
+
 	/*
 	 * If the buffer is not to mapped to kernel, perform cache
 	 * operations after mapping to kernel.
@@ -770,6 +1002,27 @@ int kgsl_cache_range_op(struct kgsl_memdesc *memdesc, uint64_t offset,
 }
 EXPORT_SYMBOL(kgsl_cache_range_op);
 
+/*
+ * Only reserve the page array, pages are allocated as the object is used.
+ * memdesc->size is the full size so the GPU range covers the whole object.
+ */
+static int _lazy_alloc_user(struct kgsl_memdesc *memdesc, uint64_t size)
+{
+	unsigned int count = size >> PAGE_SHIFT;
+
+	memdesc->pages = kgsl_malloc(count * sizeof(struct page *));
+	if (memdesc->pages == NULL)
+		return -ENOMEM;
+
+	memset(memdesc->pages, 0, count * sizeof(struct page *));
+
+	memdesc->ops = &kgsl_lazy_ops;
+	memdesc->page_count = count;
+	memdesc->size = size;
+
+	return 0;
+}
+
 int
 kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 			uint64_t size)
@@ -788,6 +1041,9 @@ kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 	if (size == 0 || size > UINT_MAX)
 		return -EINVAL;
 
+	if (kgsl_memdesc_is_lazy(memdesc))
+		return _lazy_alloc_user(memdesc, size);
+
 	align = (memdesc->flags & KGSL_MEMALIGN_MASK) >> KGSL_MEMALIGN_SHIFT;
 
 	page_size = kgsl_get_page_size(size, align);
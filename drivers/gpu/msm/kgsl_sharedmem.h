@@ -73,6 +73,10 @@ void kgsl_get_memory_usage(char *str, size_t len, uint64_t memflags);
 int kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 				uint64_t size);
 
+int kgsl_sharedmem_commit(struct kgsl_memdesc *memdesc,
+		uint64_t offset, uint64_t size);
+int kgsl_sharedmem_lazy_map(struct kgsl_memdesc *memdesc);
+
 #define MEMFLAGS(_flags, _mask, _shift) \
 	((unsigned int) (((_flags) & (_mask)) >> (_shift)))
 
@@ -246,6 +250,16 @@ kgsl_memdesc_use_cpu_map(const struct kgsl_memdesc *memdesc)
 	return (memdesc->flags & KGSL_MEMFLAGS_USE_CPU_MAP) != 0;
 }
 
+/*
+ * kgsl_memdesc_is_lazy - are the pages only committed on first use?
+ * @memdesc - the memdesc
+ */
+static inline int
+kgsl_memdesc_is_lazy(const struct kgsl_memdesc *memdesc)
+{
+	return (memdesc->flags & KGSL_MEMFLAGS_LAZY_COMMIT) != 0;
+}
+
 /*
  * kgsl_memdesc_footprint - get the size of the mmap region
  * @memdesc - the memdesc
@@ -314,9 +314,13 @@ int kgsl_snapshot_get_object(struct kgsl_snapshot *snapshot,
 		goto err_put;
 	}
 
-	/* Do not save sparse memory */
+	/*
+	 * Do not save sparse memory, or lazy memory which would have to be
+	 * committed in full to be mapped
+	 */
 	if (entry->memdesc.flags & KGSL_MEMFLAGS_SPARSE_VIRT ||
-			entry->memdesc.flags & KGSL_MEMFLAGS_SPARSE_PHYS) {
+			entry->memdesc.flags & KGSL_MEMFLAGS_SPARSE_PHYS ||
+			kgsl_memdesc_is_lazy(&entry->memdesc)) {
 		ret = 0;
 		goto err_put;
 	}
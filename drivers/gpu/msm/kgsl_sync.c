@@ -123,7 +123,8 @@ static int _add_fence_event(struct kgsl_device *device,
 	event->timestamp = timestamp;
 	event->context = context;
 
-	ret = kgsl_add_event(device, &context->events, timestamp,
+	/* Signaling the timeline doesn't sleep, skip the event worker */
+	ret = kgsl_add_atomic_event(device, &context->events, timestamp,
 		kgsl_fence_event_cb, event);
 
 	if (ret) {
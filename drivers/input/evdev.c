@@ -26,6 +26,7 @@
 #include <linux/major.h>
 #include <linux/device.h>
 #include <linux/cdev.h>
+#include <linux/hrtimer.h>
 #include "input-compat.h"
 
 enum evdev_clock_type {
@@ -46,6 +47,11 @@ struct evdev {
 	struct device dev;
 	struct cdev cdev;
 	bool exist;
+#ifdef CONFIG_INPUT_EVDEV_VSYNC
+	struct list_head vsync_node;
+	struct hrtimer vsync_timer;
+	atomic_t vsync_pending;
+#endif
 };
 
 struct evdev_client {
@@ -255,6 +261,118 @@ static void __pass_event(struct evdev_client *client,
 	}
 }
 
+#ifdef CONFIG_INPUT_EVDEV_VSYNC
+/*
+ * Touch controllers report several packets per display frame. With
+ * vsync_coalesce set, readers of direct touch devices are only woken
+ * on the next vsync and then read all packets of the frame at once.
+ * A reader is woken right away once half its buffer is used, and the
+ * timer bounds the wait when the display stops sending vsync.
+ */
+#define EVDEV_VSYNC_TIMEOUT_NS	(20 * NSEC_PER_MSEC)
+
+static bool vsync_coalesce;
+module_param(vsync_coalesce, bool, 0644);
+MODULE_PARM_DESC(vsync_coalesce, "Wake touchscreen readers on vsync only");
+
+static LIST_HEAD(evdev_vsync_list);
+static DEFINE_SPINLOCK(evdev_vsync_lock); /* protects evdev_vsync_list */
+
+static bool evdev_defer_wakeup(struct evdev *evdev, unsigned int queued,
+			       unsigned int bufsize)
+{
+	if (!READ_ONCE(vsync_coalesce) || list_empty(&evdev->vsync_node))
+		return false;
+
+	if (queued >= bufsize / 2)
+		return false;
+
+	if (!atomic_xchg(&evdev->vsync_pending, 1))
+		hrtimer_start(&evdev->vsync_timer,
+			      ns_to_ktime(EVDEV_VSYNC_TIMEOUT_NS),
+			      HRTIMER_MODE_REL);
+
+	return true;
+}
+
+static enum hrtimer_restart evdev_vsync_timeout(struct hrtimer *timer)
+{
+	struct evdev *evdev = container_of(timer, struct evdev, vsync_timer);
+
+	if (atomic_xchg(&evdev->vsync_pending, 0))
+		wake_up_interruptible(&evdev->wait);
+
+	return HRTIMER_NORESTART;
+}
+
+/* Called by the display driver from its vsync interrupt */
+void evdev_vsync(void)
+{
+	struct evdev *evdev;
+	unsigned long flags;
+
+	spin_lock_irqsave(&evdev_vsync_lock, flags);
+	list_for_each_entry(evdev, &evdev_vsync_list, vsync_node) {
+		if (atomic_xchg(&evdev->vsync_pending, 0)) {
+			hrtimer_try_to_cancel(&evdev->vsync_timer);
+			wake_up_interruptible(&evdev->wait);
+		}
+	}
+	spin_unlock_irqrestore(&evdev_vsync_lock, flags);
+}
+EXPORT_SYMBOL(evdev_vsync);
+
+static void evdev_vsync_init(struct evdev *evdev, struct input_dev *dev)
+{
+	unsigned long flags;
+
+	INIT_LIST_HEAD(&evdev->vsync_node);
+	hrtimer_init(&evdev->vsync_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	evdev->vsync_timer.function = evdev_vsync_timeout;
+
+	if (!test_bit(INPUT_PROP_DIRECT, dev->propbit))
+		return;
+
+	spin_lock_irqsave(&evdev_vsync_lock, flags);
+	list_add_tail(&evdev->vsync_node, &evdev_vsync_list);
+	spin_unlock_irqrestore(&evdev_vsync_lock, flags);
+}
+
+static void evdev_vsync_remove(struct evdev *evdev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&evdev_vsync_lock, flags);
+	list_del_init(&evdev->vsync_node);
+	spin_unlock_irqrestore(&evdev_vsync_lock, flags);
+}
+
+static void evdev_vsync_free(struct evdev *evdev)
+{
+	hrtimer_cancel(&evdev->vsync_timer);
+}
+#else
+static inline bool evdev_defer_wakeup(struct evdev *evdev,
+				      unsigned int queued,
+				      unsigned int bufsize)
+{
+	return false;
+}
+
+static inline void evdev_vsync_init(struct evdev *evdev,
+				    struct input_dev *dev)
+{
+}
+
+static inline void evdev_vsync_remove(struct evdev *evdev)
+{
+}
+
+static inline void evdev_vsync_free(struct evdev *evdev)
+{
+}
+#endif
+
 static void evdev_pass_values(struct evdev_client *client,
 			const struct input_value *vals, unsigned int count,
 			ktime_t *ev_time)
@@ -263,6 +381,7 @@ static void evdev_pass_values(struct evdev_client *client,
 	const struct input_value *v;
 	struct input_event event;
 	bool wakeup = false;
+	unsigned int queued;
 
 	if (client->revoked)
 		return;
@@ -290,9 +409,11 @@ static void evdev_pass_values(struct evdev_client *client,
 		__pass_event(client, &event);
 	}
 
+	queued = (client->head - client->tail) & (client->bufsize - 1);
+
 	spin_unlock(&client->buffer_lock);
 
-	if (wakeup)
+	if (wakeup && !evdev_defer_wakeup(evdev, queued, client->bufsize))
 		wake_up_interruptible(&evdev->wait);
 }
 
@@ -360,6 +481,7 @@ static void evdev_free(struct device *dev)
 {
 	struct evdev *evdev = container_of(dev, struct evdev, dev);
 
+	evdev_vsync_free(evdev);
 	input_put_device(evdev->handle.dev);
 	kfree(evdev);
 }
@@ -1393,6 +1515,7 @@ static int evdev_connect(struct input_handler *handler, struct input_dev *dev,
 	mutex_init(&evdev->mutex);
 	init_waitqueue_head(&evdev->wait);
 	evdev->exist = true;
+	evdev_vsync_init(evdev, dev);
 
 	dev_no = minor;
 	/* Normalize device number if it falls into legacy range */
@@ -1432,6 +1555,7 @@ static int evdev_connect(struct input_handler *handler, struct input_dev *dev,
  err_unregister_handle:
 	input_unregister_handle(&evdev->handle);
  err_free_evdev:
+	evdev_vsync_remove(evdev);
 	put_device(&evdev->dev);
  err_free_minor:
 	input_free_minor(minor);
@@ -1442,6 +1566,7 @@ static void evdev_disconnect(struct input_handle *handle)
 {
 	struct evdev *evdev = handle->private;
 
+	evdev_vsync_remove(evdev);
 	device_del(&evdev->dev);
 	evdev_cleanup(evdev);
 	input_free_minor(MINOR(evdev->dev.devt));
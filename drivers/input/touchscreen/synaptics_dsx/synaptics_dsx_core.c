@@ -27,6 +27,7 @@
 #include <linux/gpio.h>
 #include <linux/platform_device.h>
 #include <linux/regulator/consumer.h>
+#include <linux/cpu_input_boost.h>
 #include <linux/input/synaptics_dsx_v2.h>
 #include "synaptics_dsx_core.h"
 #ifdef KERNEL_ABOVE_2_6_38
@@ -152,6 +153,9 @@ static ssize_t synaptics_rmi4_0dbutton_show(struct device *dev,
 static ssize_t synaptics_rmi4_0dbutton_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t count);
 
+static ssize_t synaptics_rmi4_latency_show(struct device *dev,
+		struct device_attribute *attr, char *buf);
+
 static irqreturn_t synaptics_rmi4_irq(int irq, void *data);
 
 #if defined(CONFIG_SECURE_TOUCH)
@@ -396,6 +400,9 @@ static struct device_attribute attrs[] = {
 	__ATTR(0dbutton, (S_IRUGO | S_IWUSR | S_IWGRP),
 			synaptics_rmi4_0dbutton_show,
 			synaptics_rmi4_0dbutton_store),
+	__ATTR(latency, S_IRUGO,
+			synaptics_rmi4_latency_show,
+			synaptics_rmi4_store_error),
 #if defined(CONFIG_SECURE_TOUCH)
 	__ATTR(secure_touch_enable, (S_IRUGO | S_IWUSR | S_IWGRP),
 			synaptics_secure_touch_enable_show,
@@ -772,6 +779,23 @@ static ssize_t synaptics_rmi4_f01_productinfo_show(struct device *dev,
 			(rmi4_data->rmi4_mod_info.product_info[1]));
 }
 
+static ssize_t synaptics_rmi4_latency_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct synaptics_rmi4_data *rmi4_data = dev_get_drvdata(dev);
+	struct synaptics_rmi4_latency *read = &rmi4_data->read_latency;
+	struct synaptics_rmi4_latency *sync = &rmi4_data->sync_latency;
+
+	return snprintf(buf, PAGE_SIZE,
+			"stage count last_us max_us avg_us\n"
+			"read %u %u %u %llu\n"
+			"sync %u %u %u %llu\n",
+			read->count, read->last_us, read->max_us,
+			read->count ? div_u64(read->total_us, read->count) : 0,
+			sync->count, sync->last_us, sync->max_us,
+			sync->count ? div_u64(sync->total_us, sync->count) : 0);
+}
+
 static ssize_t synaptics_rmi4_f01_buildid_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -1343,6 +1367,18 @@ static void synaptics_rmi4_report_touch(struct synaptics_rmi4_data *rmi4_data,
 	return;
 }
 
+static void synaptics_rmi4_update_latency(struct synaptics_rmi4_latency *lat,
+		ktime_t irq_time)
+{
+	unsigned int us = ktime_us_delta(ktime_get(), irq_time);
+
+	lat->count++;
+	lat->last_us = us;
+	lat->total_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+}
+
  /**
  * synaptics_rmi4_sensor_report()
  *
@@ -1361,9 +1397,13 @@ static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 	struct synaptics_rmi4_fn *fhandler;
 	struct synaptics_rmi4_exp_fhandler *exp_fhandler;
 	struct synaptics_rmi4_device_info *rmi;
+	ktime_t irq_time = rmi4_data->irq_time;
 
 	rmi = &(rmi4_data->rmi4_mod_info);
 
+	/* Only reports raised through the hard irq handler are timed */
+	rmi4_data->irq_time = ktime_set(0, 0);
+
 	/*
 	 * Get interrupt status information from F01 Data1 register to
 	 * determine the source(s) that are flagging the interrupt.
@@ -1379,6 +1419,10 @@ static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 		return;
 	}
 
+	if (ktime_to_ns(irq_time))
+		synaptics_rmi4_update_latency(&rmi4_data->read_latency,
+				irq_time);
+
 	status.data[0] = data[0];
 	if (status.unconfigured && !status.flash_prog) {
 		pr_notice("%s: spontaneous reset detected\n", __func__);
@@ -1407,6 +1451,10 @@ static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 		}
 	}
 
+	if (ktime_to_ns(irq_time))
+		synaptics_rmi4_update_latency(&rmi4_data->sync_latency,
+				irq_time);
+
 	mutex_lock(&exp_data.mutex);
 	if (!list_empty(&exp_data.list)) {
 		list_for_each_entry(exp_fhandler, &exp_data.list, link) {
@@ -1421,6 +1469,25 @@ static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 	return;
 }
 
+ /**
+ * synaptics_rmi4_hardirq()
+ *
+ * Primary handler of the attention irq.
+ *
+ * This function stamps the interrupt for the latency statistics and
+ * kicks the CPU input boost before the ISR thread reads the report,
+ * so the frequency ramp overlaps the bus transfer.
+ */
+static irqreturn_t synaptics_rmi4_hardirq(int irq, void *data)
+{
+	struct synaptics_rmi4_data *rmi4_data = data;
+
+	rmi4_data->irq_time = ktime_get();
+	cpu_input_boost_kick();
+
+	return IRQ_WAKE_THREAD;
+}
+
  /**
  * synaptics_rmi4_irq()
  *
@@ -1473,8 +1540,9 @@ static int synaptics_rmi4_irq_enable(struct synaptics_rmi4_data *rmi4_data,
 		if (retval < 0)
 			return retval;
 
-		retval = request_threaded_irq(rmi4_data->irq, NULL,
-				synaptics_rmi4_irq, bdata->irq_flags,
+		retval = request_threaded_irq(rmi4_data->irq,
+				synaptics_rmi4_hardirq, synaptics_rmi4_irq,
+				bdata->irq_flags | IRQF_ONESHOT,
 				PLATFORM_DRIVER_NAME, rmi4_data);
 		if (retval < 0) {
 			dev_err(rmi4_data->pdev->dev.parent,
@@ -1483,10 +1551,14 @@ static int synaptics_rmi4_irq_enable(struct synaptics_rmi4_data *rmi4_data,
 			return retval;
 		}
 
+		/* The ISR thread follows the irq onto the big cluster */
+		irq_set_affinity_hint(rmi4_data->irq, cpu_perf_mask);
+
 		rmi4_data->irq_enabled = true;
 	} else {
 		if (rmi4_data->irq_enabled) {
 			disable_irq(rmi4_data->irq);
+			irq_set_affinity_hint(rmi4_data->irq, NULL);
 			free_irq(rmi4_data->irq, rmi4_data);
 			rmi4_data->irq_enabled = false;
 		}
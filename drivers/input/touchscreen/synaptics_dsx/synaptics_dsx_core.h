@@ -27,6 +27,7 @@
 
 #include <linux/version.h>
 #include <linux/debugfs.h>
+#include <linux/ktime.h>
 
 #if defined(CONFIG_FB)
 #include <linux/notifier.h>
@@ -211,6 +212,17 @@ struct synaptics_rmi4_device_info {
 	unsigned int package_id_rev;
 };
 
+/*
+ * struct synaptics_rmi4_latency - time from the attention irq to a stage
+ * of report handling
+ */
+struct synaptics_rmi4_latency {
+	unsigned int count;
+	unsigned int last_us;
+	unsigned int max_us;
+	unsigned long long total_us;
+};
+
 /*
  * struct synaptics_rmi4_data - rmi4 device instance data
  * @pdev: pointer to platform device
@@ -296,6 +308,9 @@ struct synaptics_rmi4_data {
 	bool fw_updating;
 	bool support_vkeys;
 	bool update_coords;
+	ktime_t irq_time;
+	struct synaptics_rmi4_latency read_latency;
+	struct synaptics_rmi4_latency sync_latency;
 	int (*irq_enable)(struct synaptics_rmi4_data *rmi4_data, bool enable);
 	int (*reset_device)(struct synaptics_rmi4_data *rmi4_data);
 
@@ -12,6 +12,12 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * In the file "/sys/module/dm_verity/parameters/pin_cache_kb" you can set how
+ * many kilobytes of the upper hash tree levels (all levels but the lowest)
+ * are kept in memory once verified, starting from the root. Those blocks are
+ * needed by nearly every verification and are then never evicted nor hashed
+ * again. The value is sampled when the target is created.
  */
 
 #include "dm-verity.h"
@@ -27,6 +33,7 @@
 #define DM_VERITY_ENV_VAR_NAME		"DM_VERITY_ERR_BLOCK_NR"
 
 #define DM_VERITY_DEFAULT_PREFETCH_SIZE	262144
+#define DM_VERITY_DEFAULT_PIN_CACHE_KB	1024
 
 #define DM_VERITY_MAX_CORRUPTED_ERRS	100
 
@@ -41,6 +48,10 @@ static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
 
+static unsigned dm_verity_pin_cache_kb = DM_VERITY_DEFAULT_PIN_CACHE_KB;
+
+module_param_named(pin_cache_kb, dm_verity_pin_cache_kb, uint, S_IRUGO | S_IWUSR);
+
 struct dm_verity_prefetch_work {
 	struct work_struct work;
 	struct dm_verity *v;
@@ -245,6 +256,26 @@ out:
 	return 1;
 }
 
+/*
+ * Keep an extra hold on a verified upper-level hash block so that dm-bufio
+ * never evicts it. Blocks of all levels but the lowest are stored
+ * contiguously from hash_start, root first.
+ */
+static void verity_pin_hash_block(struct dm_verity *v, sector_t hash_block)
+{
+	sector_t idx = hash_block - v->hash_start;
+	struct dm_buffer *buf;
+
+	if (idx >= v->n_pinned || READ_ONCE(v->pinned[idx]))
+		return;
+
+	if (!dm_bufio_get(v->bufio, hash_block, &buf))
+		return;
+
+	if (cmpxchg(&v->pinned[idx], NULL, buf))
+		dm_bufio_release(buf);
+}
+
 /*
  * Verify hash of a metadata block pertaining to the specified data block
  * ("block" argument) at a specified level ("level" argument).
@@ -302,6 +333,9 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 		}
 	}
 
+	if (level)
+		verity_pin_hash_block(v, hash_block);
+
 	data += offset;
 	memcpy(want_digest, data, v->digest_size);
 	r = 0;
@@ -505,6 +539,22 @@ static void verity_work(struct work_struct *w)
 	verity_finish_io(io, verity_verify_io(io));
 }
 
+/*
+ * With check_at_most_once, a read whose blocks have all been verified
+ * before needs no hashing and can be completed right from bio completion
+ * instead of waiting for kverityd.
+ */
+static bool verity_io_validated(struct dm_verity_io *io)
+{
+	struct dm_verity *v = io->v;
+	sector_t end = io->block + io->n_blocks;
+
+	if (!v->validated_blocks)
+		return false;
+
+	return find_next_zero_bit(v->validated_blocks, end, io->block) >= end;
+}
+
 static void verity_end_io(struct bio *bio)
 {
 	struct dm_verity_io *io = bio->bi_private;
@@ -514,6 +564,11 @@ static void verity_end_io(struct bio *bio)
 		return;
 	}
 
+	if (!bio->bi_error && verity_io_validated(io)) {
+		verity_finish_io(io, 0);
+		return;
+	}
+
 	INIT_WORK(&io->work, verity_work);
 	queue_work(io->v->verify_wq, &io->work);
 }
@@ -730,10 +785,16 @@ EXPORT_SYMBOL_GPL(verity_io_hints);
 void verity_dtr(struct dm_target *ti)
 {
 	struct dm_verity *v = ti->private;
+	unsigned i;
 
 	if (v->verify_wq)
 		destroy_workqueue(v->verify_wq);
 
+	for (i = 0; i < v->n_pinned; i++)
+		if (v->pinned[i])
+			dm_bufio_release(v->pinned[i]);
+	kfree(v->pinned);
+
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
@@ -1101,8 +1162,29 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
-	/* WQ_UNBOUND greatly improves performance when running on ramdisk */
-	v->verify_wq = alloc_workqueue("kverityd", WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM | WQ_UNBOUND, num_online_cpus());
+	if (v->levels > 1) {
+		sector_t n = v->hash_level_block[0] - v->hash_start;
+		unsigned max = (ACCESS_ONCE(dm_verity_pin_cache_kb) << 10) >>
+			       v->hash_dev_block_bits;
+
+		n = min_t(sector_t, n, max);
+		if (n) {
+			v->pinned = kcalloc(n, sizeof(*v->pinned), GFP_KERNEL);
+			if (!v->pinned) {
+				ti->error = "Cannot allocate pinned hash block array";
+				r = -ENOMEM;
+				goto bad;
+			}
+			v->n_pinned = n;
+		}
+	}
+
+	/*
+	 * Verify on the CPU that completed the read, where the data is still
+	 * cache hot. WQ_HIGHPRI keeps the reader from waiting behind normal
+	 * priority work on that CPU.
+	 */
+	v->verify_wq = alloc_workqueue("kverityd", WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM | WQ_HIGHPRI, num_online_cpus());
 	if (!v->verify_wq) {
 		ti->error = "Cannot allocate workqueue";
 		r = -ENOMEM;
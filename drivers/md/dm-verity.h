@@ -64,6 +64,8 @@ struct dm_verity {
 
 	struct dm_verity_fec *fec;	/* forward error correction */
 	unsigned long *validated_blocks; /* bitset blocks validated */
+	struct dm_buffer **pinned;	/* verified upper-level hash blocks */
+	unsigned n_pinned;		/* the number of slots in pinned */
 };
 
 struct dm_verity_io {
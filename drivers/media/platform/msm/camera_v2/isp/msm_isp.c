@@ -51,8 +51,8 @@ static const struct of_device_id msm_vfe_dt_match[] = {
 
 MODULE_DEVICE_TABLE(of, msm_vfe_dt_match);
 
-#define MAX_OVERFLOW_COUNTERS  29
-#define OVERFLOW_LENGTH 1024
+#define MAX_OVERFLOW_COUNTERS  31
+#define OVERFLOW_LENGTH 2048
 #define OVERFLOW_BUFFER_LENGTH 64
 
 struct msm_isp_statistics stats;
@@ -91,6 +91,8 @@ static char *stats_str[MAX_OVERFLOW_COUNTERS] = {
 	"ISP_last_overflow.ib",
 	"ISP_VFE_CLK_RATE",
 	"ISP_CPP_CLK_RATE",
+	"buf_mgr_empty_drop_cnt",
+	"axi_done_no_buf_drop_cnt",
 };
 
 #define MAX_DEPTH_BW_REQ_HISTORY 25
@@ -138,11 +140,11 @@ static ssize_t vfe_debugfs_statistics_read(struct file *t_file,
 		return -EINVAL;
 	}
 	for (i = 0; i < MAX_OVERFLOW_COUNTERS; i++) {
-		strlcat(stat_line, stats_str[i], sizeof(stat_line));
-		strlcat(stat_line, "     ", sizeof(stat_line));
+		strlcat(stat_line, stats_str[i], OVERFLOW_LENGTH);
+		strlcat(stat_line, "     ", OVERFLOW_LENGTH);
 		snprintf(buffer, sizeof(buffer), "%llu", ptr[i]);
-		strlcat(stat_line, buffer, sizeof(stat_line));
-		strlcat(stat_line, "\r\n", sizeof(stat_line));
+		strlcat(stat_line, buffer, OVERFLOW_LENGTH);
+		strlcat(stat_line, "\r\n", OVERFLOW_LENGTH);
 	}
 	rc = simple_read_from_buffer(t_char, t_size_t,
 		t_loff_t, stat_line, strlen(stat_line));
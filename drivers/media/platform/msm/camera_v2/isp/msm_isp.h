@@ -660,6 +660,14 @@ struct msm_isp_statistics {
 
 	int64_t vfe_clk_rate;
 	int64_t cpp_clk_rate;
+
+	/*
+	 * Frames lost to the scratch buffer, by the stage that lost them.
+	 * Counted from the IRQ and ioctl paths without common_dev_data_lock,
+	 * they read back as 64 bit counters like the fields above.
+	 */
+	atomic64_t buf_mgr_empty_drop;
+	atomic64_t axi_done_no_buf_drop;
 };
 
 struct msm_isp_bw_req_info {
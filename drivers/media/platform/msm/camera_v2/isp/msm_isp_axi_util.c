@@ -10,6 +10,7 @@
  * GNU General Public License for more details.
  */
 #include <linux/io.h>
+#include <linux/bw_hwmon_hint.h>
 #include <media/v4l2-subdev.h>
 #include <asm/div64.h>
 #include "msm_isp_util.h"
@@ -1966,6 +1967,7 @@ static int msm_isp_cfg_ping_pong_address(
 		buf = msm_isp_get_stream_buffer(vfe_dev, stream_info);
 
 	if (!buf) {
+		atomic64_inc(&vfe_dev->stats->buf_mgr_empty_drop);
 		msm_isp_cfg_stream_scratch(stream_info, pingpong_status);
 		return 0;
 	}
@@ -2458,6 +2460,7 @@ static void msm_isp_update_intf_stream_cnt(
 /*Factor in Q2 format*/
 #define ISP_DEFAULT_FORMAT_FACTOR 6
 #define ISP_BUS_UTILIZATION_FACTOR 6
+#define ISP_BW_HINT_MS 500
 static int msm_isp_update_stream_bandwidth(
 	struct msm_vfe_axi_stream *stream_info, int enable)
 {
@@ -2487,6 +2490,10 @@ static int msm_isp_update_stream_bandwidth(
 			pr_err("%s: update failed rc %d stream src %d vfe dev %d\n",
 				__func__, rc, stream_info->stream_src,
 				vfe_dev->pdev->id);
+		/* DDR has to be up before the first frame is written out */
+		if (enable)
+			bw_hwmon_hint(BW_HWMON_HINT_CAMERA,
+				total_bandwidth >> 20, ISP_BW_HINT_MS);
 	}
 	return rc;
 }
@@ -4248,6 +4255,7 @@ void msm_isp_process_axi_irq_stream(struct vfe_device *vfe_dev,
 	}
 
 	if (!done_buf) {
+		atomic64_inc(&vfe_dev->stats->axi_done_no_buf_drop);
 		if (stream_info->buf_divert) {
 			vfe_dev->error_info.stream_framedrop_count[
 				stream_info->bufq_handle[
@@ -1379,6 +1379,7 @@ static void sde_rotator_release_from_work_distribution(
 				entry->perf->work_distribution);
 			devm_kfree(&mgr->pdev->dev, entry->perf);
 			sde_rotator_update_perf(mgr);
+			sde_smmu_ctrl(0);
 			sde_rotator_clk_ctrl(mgr, false);
 			sde_rotator_resource_ctrl(mgr, false);
 			entry->perf = NULL;
@@ -2059,6 +2060,7 @@ static void sde_rotator_release_rotator_perf_session(
 		list_del_init(&perf->list);
 		devm_kfree(&mgr->pdev->dev, perf->work_distribution);
 		devm_kfree(&mgr->pdev->dev, perf);
+		sde_smmu_ctrl(0);
 	}
 }
 
@@ -2161,12 +2163,26 @@ static int sde_rotator_open_session(struct sde_rot_mgr *mgr,
 		goto enable_clk_err;
 	}
 
+	/*
+	 * Hold the smmu for the lifetime of the session so that back to back
+	 * frames do not power cycle the context banks in between commits.
+	 */
+	ret = sde_smmu_ctrl(1);
+	if (IS_ERR_VALUE(ret)) {
+		SDEROT_ERR("IOMMU attach failed %d\n", ret);
+		goto smmu_err;
+	}
+	ret = 0;
+
 	SDEROT_DBG("open session id=%u in{%u,%u}f:%u out{%u,%u}f:%u\n",
 		config.session_id, config.input.width, config.input.height,
 		config.input.format, config.output.width, config.output.height,
 		config.output.format);
 
 	goto done;
+smmu_err:
+	sde_smmu_ctrl(0);
+	sde_rotator_clk_ctrl(mgr, false);
 enable_clk_err:
 update_clk_err:
 	sde_rotator_resource_ctrl(mgr, false);
@@ -2206,6 +2222,7 @@ static int sde_rotator_close_session(struct sde_rot_mgr *mgr,
 	devm_kfree(&mgr->pdev->dev, perf->work_distribution);
 	devm_kfree(&mgr->pdev->dev, perf);
 	sde_rotator_update_perf(mgr);
+	sde_smmu_ctrl(0);
 	sde_rotator_clk_ctrl(mgr, false);
 	sde_rotator_update_clk(mgr);
 	sde_rotator_resource_ctrl(mgr, false);
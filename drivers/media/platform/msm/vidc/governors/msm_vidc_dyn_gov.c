@@ -375,7 +375,9 @@ static unsigned long __calculate_decoder(struct vidc_bus_vote_data *d,
 	lcu_per_frame = DIV_ROUND_UP(width, lcu_size) *
 		DIV_ROUND_UP(height, lcu_size);
 
-	bitrate = __lut(width, height)->bitrate[scenario];
+	/* Use the measured bitrate of the stream when it is known */
+	bitrate = d->bitrate ? DIV_ROUND_UP(d->bitrate, 1000000) :
+		__lut(width, height)->bitrate[scenario];
 
 	bins_to_bit_factor = FP(1, 60, 100);
 
@@ -703,7 +705,8 @@ static unsigned long __calculate_encoder(struct vidc_bus_vote_data *d,
 	/* Derived Parameters */
 	lcu_size = 16;
 	gop = b_frames_enabled ? GOP_IBBP : GOP_IPPP;
-	bitrate = __lut(width, height)->bitrate[bitrate_scenario];
+	bitrate = d->bitrate ? DIV_ROUND_UP(d->bitrate, 1000000) :
+		__lut(width, height)->bitrate[bitrate_scenario];
 	bins_to_bit_factor = FP(1, 6, 10);
 
 	/*
@@ -18,17 +18,33 @@
 #include <linux/iommu.h>
 #include <linux/msm_dma_iommu_mapping.h>
 #include <linux/msm_ion.h>
+#include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 #include "media/msm_vidc.h"
 #include "msm_vidc_debug.h"
 #include "msm_vidc_resources.h"
 
+/*
+ * Released user buffers stay mapped in a small per client cache, so that
+ * queueing the same buffer again skips the import, attach and map.
+ */
+#define SMEM_MAP_CACHE_SIZE 8
+/* References held by a cached buffer: the import and the dma-buf share */
+#define SMEM_MAP_CACHE_REFS 2
+/* How often cached buffers are checked for having been freed elsewhere */
+#define SMEM_MAP_CACHE_PRUNE_MS 1000
+
 struct smem_client {
 	int mem_type;
 	void *clnt;
 	struct msm_vidc_platform_resources *res;
 	enum session_type session_type;
+	struct mutex cache_lock;
+	struct msm_smem *map_cache[SMEM_MAP_CACHE_SIZE];
+	int map_cache_count;
+	struct delayed_work prune_work;
 };
 
 static int get_device_address(struct smem_client *smem_client,
@@ -246,6 +262,7 @@ static int ion_user_to_kernel(struct smem_client *client, int fd, u32 size,
 	mem->smem_priv = hndl;
 	mem->device_addr = iova;
 	mem->size = buffer_size;
+	mem->imported = true;
 	if ((u32)mem->device_addr != iova) {
 		dprintk(VIDC_ERR, "iova(%pa) truncated to %#x",
 			&iova, (u32)mem->device_addr);
@@ -440,6 +457,118 @@ static void ion_delete_client(struct smem_client *client)
 	ion_client_destroy(client->clnt);
 }
 
+static void smem_cache_del(struct smem_client *client, int idx)
+{
+	client->map_cache_count--;
+	memmove(&client->map_cache[idx], &client->map_cache[idx + 1],
+		(client->map_cache_count - idx) * sizeof(client->map_cache[0]));
+}
+
+static void smem_cache_evict(struct smem_client *client, int idx)
+{
+	struct msm_smem *mem = client->map_cache[idx];
+
+	smem_cache_del(client, idx);
+	free_ion_mem(client, mem);
+	kfree(mem);
+}
+
+/* Drop the buffers that were freed by everyone but the cache */
+static void smem_cache_prune(struct smem_client *client)
+{
+	int i;
+
+	for (i = client->map_cache_count - 1; i >= 0; i--) {
+		if (ion_handle_refcount(client->clnt,
+				client->map_cache[i]->smem_priv) <=
+				SMEM_MAP_CACHE_REFS)
+			smem_cache_evict(client, i);
+	}
+}
+
+static void smem_cache_prune_work(struct work_struct *work)
+{
+	struct smem_client *client = container_of(to_delayed_work(work),
+			struct smem_client, prune_work);
+
+	mutex_lock(&client->cache_lock);
+	smem_cache_prune(client);
+	if (client->map_cache_count)
+		schedule_delayed_work(&client->prune_work,
+			msecs_to_jiffies(SMEM_MAP_CACHE_PRUNE_MS));
+	mutex_unlock(&client->cache_lock);
+}
+
+static struct msm_smem *smem_cache_get(struct smem_client *client, int fd,
+		u32 size, enum hal_buffer buffer_type)
+{
+	struct msm_smem *mem = NULL, *temp;
+	void *hndl;
+	int i;
+
+	if (client->mem_type != SMEM_ION ||
+		!is_iommu_present(client->res))
+		return NULL;
+
+	hndl = ion_import_dma_buf(client->clnt, fd);
+	if (IS_ERR_OR_NULL(hndl))
+		return NULL;
+
+	mutex_lock(&client->cache_lock);
+	for (i = client->map_cache_count - 1; i >= 0; i--) {
+		temp = client->map_cache[i];
+		if (temp->smem_priv == hndl &&
+			temp->buffer_type == buffer_type &&
+			temp->size >= size) {
+			smem_cache_del(client, i);
+			mem = temp;
+			break;
+		}
+	}
+	mutex_unlock(&client->cache_lock);
+
+	ion_free(client->clnt, hndl);
+
+	if (mem)
+		dprintk(VIDC_DBG,
+			"%s: reusing mapping of fd = %d, device_addr = %pa\n",
+			__func__, fd, &mem->device_addr);
+	return mem;
+}
+
+static bool smem_cache_put(struct smem_client *client, struct msm_smem *mem)
+{
+	bool cached = false;
+
+	if (!mem->imported || !mem->mapping_info.buf || mem->kvaddr)
+		return false;
+
+	mutex_lock(&client->cache_lock);
+	smem_cache_prune(client);
+	if (ion_handle_refcount(client->clnt, mem->smem_priv) >
+			SMEM_MAP_CACHE_REFS) {
+		if (client->map_cache_count == SMEM_MAP_CACHE_SIZE)
+			smem_cache_evict(client, 0);
+		client->map_cache[client->map_cache_count++] = mem;
+		cached = true;
+		/* Don't keep buffers freed by everyone else pinned */
+		schedule_delayed_work(&client->prune_work,
+			msecs_to_jiffies(SMEM_MAP_CACHE_PRUNE_MS));
+	}
+	mutex_unlock(&client->cache_lock);
+
+	return cached;
+}
+
+static void smem_cache_flush(struct smem_client *client)
+{
+	cancel_delayed_work_sync(&client->prune_work);
+	mutex_lock(&client->cache_lock);
+	while (client->map_cache_count)
+		smem_cache_evict(client, client->map_cache_count - 1);
+	mutex_unlock(&client->cache_lock);
+}
+
 struct msm_smem *msm_smem_user_to_kernel(void *clt, int fd, u32 size,
 		enum hal_buffer buffer_type)
 {
@@ -450,6 +579,10 @@ struct msm_smem *msm_smem_user_to_kernel(void *clt, int fd, u32 size,
 		dprintk(VIDC_ERR, "Invalid fd: %d\n", fd);
 		return NULL;
 	}
+	mem = smem_cache_get(client, fd, size, buffer_type);
+	if (mem)
+		return mem;
+
 	mem = kzalloc(sizeof(*mem), GFP_KERNEL);
 	if (!mem) {
 		dprintk(VIDC_ERR, "Failed to allocte shared mem\n");
@@ -589,6 +722,9 @@ void *msm_smem_new_client(enum smem_type mtype,
 			client->clnt = clnt;
 			client->res = res;
 			client->session_type = stype;
+			mutex_init(&client->cache_lock);
+			INIT_DELAYED_WORK(&client->prune_work,
+				smem_cache_prune_work);
 		}
 	} else {
 		dprintk(VIDC_ERR, "Failed to create new client: mtype = %d\n",
@@ -645,6 +781,8 @@ void msm_smem_free(void *clt, struct msm_smem *mem)
 	}
 	switch (client->mem_type) {
 	case SMEM_ION:
+		if (smem_cache_put(client, mem))
+			return;
 		free_ion_mem(client, mem);
 		break;
 	default:
@@ -663,6 +801,7 @@ void msm_smem_delete_client(void *clt)
 	}
 	switch (client->mem_type) {
 	case SMEM_ION:
+		smem_cache_flush(client);
 		ion_delete_client(client);
 		break;
 	default:
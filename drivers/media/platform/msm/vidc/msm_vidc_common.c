@@ -16,6 +16,7 @@
 #include <linux/slab.h>
 #include <linux/kernel.h>
 #include <linux/bitops.h>
+#include <linux/bw_hwmon_hint.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <asm/div64.h>
 #include "msm_vidc_common.h"
@@ -47,6 +48,7 @@
 		V4L2_EVENT_MSM_VIDC_RELEASE_BUFFER_REFERENCE
 
 #define MAX_SUPPORTED_INSTANCES 16
+#define VIDC_BW_HINT_MS 300
 
 #ifndef CONFIG_DEBUG_KERNEL
 int msm_vidc_debug = 0;
@@ -67,6 +69,7 @@ bool msm_vidc_sys_idle_indicator = false;
 int msm_vidc_firmware_unload_delay = 15000;
 bool msm_vidc_thermal_mitigation_disabled = false;
 bool msm_vidc_bitrate_clock_scaling = true;
+bool msm_vidc_dcvs_feedback = false;
 bool msm_vidc_debug_timeout = false;
 #endif
 
@@ -583,6 +586,9 @@ static int msm_comm_vote_bus(struct msm_vidc_core *core)
 		 */
 		vote_data[i].color_formats[0] = get_hal_uncompressed(yuv);
 		vote_data[i].num_formats = 1;
+
+		if (inst->dcvs_mode && msm_vidc_dcvs_feedback)
+			vote_data[i].bitrate = inst->instant_bitrate;
 		i++;
 	}
 	mutex_unlock(&core->lock);
@@ -2231,6 +2237,7 @@ static void handle_fbd(enum hal_command_response cmd, void *data)
 		}
 
 		inst->count.fbd++;
+		msm_dcvs_feedback_fbd(inst, fill_buf_done);
 
 		if (extra_idx && extra_idx < VIDEO_MAX_PLANES) {
 			dprintk(VIDC_DBG,
@@ -2983,6 +2990,23 @@ exit:
 	return rc;
 }
 
+static unsigned long msm_comm_estimate_mbps(struct msm_vidc_inst *inst)
+{
+	u64 bytes;
+	u32 fps;
+
+	fps = inst->operating_rate >> 16 ?: inst->prop.fps;
+	bytes = (u64)max(inst->prop.width[CAPTURE_PORT],
+			inst->prop.width[OUTPUT_PORT]) *
+		max(inst->prop.height[CAPTURE_PORT],
+			inst->prop.height[OUTPUT_PORT]);
+
+	/* NV12 frame size, written once and read back as a reference */
+	bytes = bytes * 3 / 2 * 2 * fps;
+
+	return bytes >> 20;
+}
+
 static int msm_vidc_start(int flipped_state, struct msm_vidc_inst *inst)
 {
 	int rc = 0;
@@ -3007,6 +3031,10 @@ static int msm_vidc_start(int flipped_state, struct msm_vidc_inst *inst)
 			inst, inst->state);
 		goto exit;
 	}
+	/* Pre-vote DDR until the bus monitor sees the session's traffic */
+	bw_hwmon_hint(BW_HWMON_HINT_VIDEO, msm_comm_estimate_mbps(inst),
+			VIDC_BW_HINT_MS);
+
 	rc = call_hfi_op(hdev, session_start, (void *) inst->session);
 	if (rc) {
 		dprintk(VIDC_ERR,
@@ -3780,12 +3808,16 @@ static void log_frame(struct msm_vidc_inst *inst, struct vidc_frame_data *data,
 					data->filled_len * 8 * inst->prop.fps;
 		else
 			inst->instant_bitrate = 0;
+
+		msm_dcvs_feedback_etb(inst, data);
 	} else if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
 		dprintk(VIDC_DBG,
 				"Sending ftb (%pa) to hal: size: %d, ts: %lld, flags = %#x\n",
 				&data->device_addr, data->alloc_len,
 				data->timestamp, data->flags);
 		msm_vidc_debugfs_update(inst, MSM_VIDC_DEBUGFS_EVENT_FTB);
+
+		msm_dcvs_feedback_ftb(inst);
 	}
 
 	msm_dcvs_check_and_scale_clocks(inst,
@@ -22,6 +22,7 @@
 static bool msm_dcvs_check_supported(struct msm_vidc_inst *inst);
 static int msm_dcvs_enc_scale_clocks(struct msm_vidc_inst *inst);
 static int msm_dcvs_dec_scale_clocks(struct msm_vidc_inst *inst, bool fbd);
+static int msm_dcvs_feedback_scale_clocks(struct msm_vidc_inst *inst);
 
 int msm_dcvs_try_enable(struct msm_vidc_inst *inst)
 {
@@ -166,6 +167,14 @@ void msm_dcvs_check_and_scale_clocks(struct msm_vidc_inst *inst, bool is_etb)
 		return;
 	}
 
+	if (msm_vidc_dcvs_feedback &&
+		inst->dcvs.feedback_samples >= DCVS_FEEDBACK_MIN_SAMPLES) {
+		if (is_etb && msm_dcvs_feedback_scale_clocks(inst))
+			dprintk(VIDC_DBG,
+				"DCVS: error while scaling clocks\n");
+		return;
+	}
+
 	if (is_etb)
 		msm_dcvs_enc_check_and_scale_clocks(inst);
 	else
@@ -535,6 +544,190 @@ static int msm_dcvs_dec_scale_clocks(struct msm_vidc_inst *inst, bool fbd)
 	return rc;
 }
 
+static inline u32 msm_dcvs_get_fps(struct msm_vidc_inst *inst)
+{
+	u32 fps = inst->prop.fps;
+
+	if (inst->operating_rate)
+		fps = max(fps, inst->operating_rate >> 16);
+
+	return fps ? fps : DEFAULT_FPS;
+}
+
+static inline u32 msm_dcvs_feedback_avg(u32 avg, u32 sample)
+{
+	return avg ? (avg * 7 + sample) / 8 : sample;
+}
+
+/*
+ * Feedback DCVS measures how long the firmware takes for each frame. The
+ * work on a frame starts once its input is queued, an output buffer is
+ * available and the previous frame is done, and ends with the FBD. Time
+ * spent waiting for the client to return output buffers is not counted as
+ * busy. Inputs and outputs are matched in order, so streams with frame
+ * reordering read slightly high, which errs towards a higher clock.
+ */
+void msm_dcvs_feedback_etb(struct msm_vidc_inst *inst,
+		struct vidc_frame_data *data)
+{
+	struct dcvs_stats *dcvs;
+
+	if (!inst || !data || !msm_vidc_dcvs_feedback || !inst->dcvs_mode)
+		return;
+
+	if (!data->filled_len || (data->flags & HAL_BUFFERFLAG_CODECCONFIG))
+		return;
+
+	dcvs = &inst->dcvs;
+	dcvs->etb_time[dcvs->etb_queued % DCVS_FEEDBACK_WINDOW] = ktime_get();
+	/* pairs with smp_rmb() in msm_dcvs_feedback_fbd() */
+	smp_wmb();
+	dcvs->etb_queued++;
+
+	if (inst->session_type == MSM_VIDC_DECODER)
+		dcvs->frame_bits = msm_dcvs_feedback_avg(dcvs->frame_bits,
+				data->filled_len * 8);
+}
+
+/*
+ * Record when the firmware got an output buffer after running out of
+ * them. Until then it was starved, not busy.
+ */
+void msm_dcvs_feedback_ftb(struct msm_vidc_inst *inst)
+{
+	if (!inst || !msm_vidc_dcvs_feedback || !inst->dcvs_mode)
+		return;
+
+	if (inst->count.ftb - inst->count.fbd <= 1)
+		ACCESS_ONCE(inst->dcvs.ftb_time) = ktime_get();
+}
+
+void msm_dcvs_feedback_fbd(struct msm_vidc_inst *inst,
+		struct vidc_hal_fbd *fbd)
+{
+	struct dcvs_stats *dcvs;
+	ktime_t now, start, ftb;
+	u32 queued, budget_us;
+	s64 busy_us;
+
+	if (!inst || !fbd || !msm_vidc_dcvs_feedback || !inst->dcvs_mode)
+		return;
+
+	dcvs = &inst->dcvs;
+	queued = ACCESS_ONCE(dcvs->etb_queued);
+	smp_rmb();
+
+	/* flushed inputs never complete, start over with the next frame */
+	if (atomic_read(&inst->in_flush)) {
+		dcvs->etb_retired = queued;
+		dcvs->last_done = ktime_set(0, 0);
+		return;
+	}
+
+	if (!fbd->filled_len1 || (fbd->flags1 & HAL_BUFFERFLAG_CODECCONFIG))
+		return;
+
+	now = ktime_get();
+	start = dcvs->last_done;
+
+	if (queued - dcvs->etb_retired > DCVS_FEEDBACK_WINDOW)
+		dcvs->etb_retired = queued - DCVS_FEEDBACK_WINDOW;
+	if (queued != dcvs->etb_retired) {
+		ktime_t etb = dcvs->etb_time[dcvs->etb_retired %
+				DCVS_FEEDBACK_WINDOW];
+
+		if (ktime_compare(etb, start) > 0)
+			start = etb;
+		dcvs->etb_retired++;
+	}
+	dcvs->last_done = now;
+
+	ftb = ACCESS_ONCE(dcvs->ftb_time);
+	if (ktime_compare(ftb, start) > 0 && ktime_compare(ftb, now) < 0)
+		start = ftb;
+
+	if (!ktime_to_ns(start))
+		return;
+
+	/* don't let a stall, e.g. a pause, dominate the average */
+	budget_us = USEC_PER_SEC / msm_dcvs_get_fps(inst);
+	busy_us = min_t(s64, ktime_us_delta(now, start), 2 * budget_us);
+
+	dcvs->busy_us = msm_dcvs_feedback_avg(dcvs->busy_us, busy_us);
+	if (inst->session_type == MSM_VIDC_ENCODER)
+		dcvs->frame_bits = msm_dcvs_feedback_avg(dcvs->frame_bits,
+				fbd->filled_len1 * 8);
+	if (dcvs->feedback_samples < DCVS_FEEDBACK_MIN_SAMPLES)
+		dcvs->feedback_samples++;
+
+	dprintk(VIDC_PROF, "DCVS: frame busy %lld us avg %u us budget %u us\n",
+		busy_us, dcvs->busy_us, budget_us);
+}
+
+/*
+ * Scale the load so that the measured busy time of a frame settles at
+ * DCVS_FEEDBACK_TARGET_UTIL percent of the frame period. The averaged
+ * bitstream size is reported as the instant bitrate, which raises the
+ * clock for the entropy coder and the bandwidth vote for high bitrate
+ * content.
+ */
+static int msm_dcvs_feedback_scale_clocks(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core;
+	struct dcvs_stats *dcvs;
+	u32 fps, budget_us, util;
+	int load, min_load, max_load;
+	unsigned long bitrate;
+
+	if (!inst || !inst->core || !inst->core->device) {
+		dprintk(VIDC_ERR, "%s Invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	core = inst->core;
+	dcvs = &inst->dcvs;
+	fps = msm_dcvs_get_fps(inst);
+	budget_us = USEC_PER_SEC / fps;
+	util = dcvs->busy_us * 100 / budget_us;
+
+	bitrate = (unsigned long)dcvs->frame_bits * fps;
+	inst->instant_bitrate = bitrate;
+
+	load = dcvs->load;
+	if (util > DCVS_FEEDBACK_HIGH_UTIL || util < DCVS_FEEDBACK_LOW_UTIL) {
+		min_load = max(dcvs->load_low, 1);
+		max_load = max_t(int, core->resources.max_load, min_load);
+		load = (int)div_u64((u64)dcvs->load * util,
+				DCVS_FEEDBACK_TARGET_UTIL);
+		load = clamp(load, min_load, max_load);
+	}
+
+	dcvs->prev_freq_increased = load > dcvs->load;
+	dcvs->prev_freq_lowered = load < dcvs->load;
+
+	if (abs(load - dcvs->load) * 100 <
+			DCVS_FEEDBACK_HYSTERESIS * dcvs->load) {
+		dcvs->prev_freq_increased = false;
+		dcvs->prev_freq_lowered = false;
+		if (abs((long)(bitrate - dcvs->voted_bitrate)) * 100 <
+				DCVS_FEEDBACK_HYSTERESIS * dcvs->voted_bitrate)
+			return 0;
+	} else {
+		/* expect the busy time to follow the new clock */
+		if (load)
+			dcvs->busy_us = (u32)div_u64((u64)dcvs->busy_us *
+					dcvs->load, load);
+		dprintk(VIDC_PROF,
+			"DCVS: feedback load %d -> %d util %u%% bitrate %lu\n",
+			dcvs->load, load, util, bitrate);
+		dcvs->load = load;
+	}
+
+	dcvs->voted_bitrate = bitrate;
+	return msm_comm_scale_clocks_load(core, dcvs->load,
+			LOAD_CALC_NO_QUIRKS);
+}
+
 static bool msm_dcvs_check_supported(struct msm_vidc_inst *inst)
 {
 	int num_mbs_per_frame = 0, instance_count = 0;
@@ -31,10 +31,26 @@
 /* Considering one safeguard buffer */
 #define DCVS_BUFFER_SAFEGUARD (DCVS_DEC_EXTRA_OUTPUT_BUFFERS - 1)
 
+/* Frames measured before the feedback DCVS takes over */
+#define DCVS_FEEDBACK_MIN_SAMPLES 8
+/* Busy percentage of the frame period the feedback DCVS aims for */
+#define DCVS_FEEDBACK_TARGET_UTIL 70
+/* Clock is raised above this busy percentage of the frame period */
+#define DCVS_FEEDBACK_HIGH_UTIL 85
+/* Clock is lowered below this busy percentage of the frame period */
+#define DCVS_FEEDBACK_LOW_UTIL 50
+/* Minimum load change in percent worth a new clock vote */
+#define DCVS_FEEDBACK_HYSTERESIS 10
+
 void msm_dcvs_init(struct msm_vidc_inst *inst);
 void msm_dcvs_init_load(struct msm_vidc_inst *inst);
 void msm_dcvs_monitor_buffer(struct msm_vidc_inst *inst);
 void msm_dcvs_check_and_scale_clocks(struct msm_vidc_inst *inst, bool is_etb);
 int  msm_dcvs_get_extra_buff_count(struct msm_vidc_inst *inst);
 int msm_dcvs_try_enable(struct msm_vidc_inst *inst);
+void msm_dcvs_feedback_etb(struct msm_vidc_inst *inst,
+		struct vidc_frame_data *data);
+void msm_dcvs_feedback_ftb(struct msm_vidc_inst *inst);
+void msm_dcvs_feedback_fbd(struct msm_vidc_inst *inst,
+		struct vidc_hal_fbd *fbd);
 #endif
@@ -34,6 +34,7 @@ bool msm_vidc_sys_idle_indicator = false;
 int msm_vidc_firmware_unload_delay = 15000;
 bool msm_vidc_thermal_mitigation_disabled = false;
 bool msm_vidc_bitrate_clock_scaling = true;
+bool msm_vidc_dcvs_feedback = false;
 bool msm_vidc_debug_timeout = false;
 
 static struct mutex debugfs_lock;
@@ -181,6 +182,7 @@ struct dentry *msm_vidc_debugfs_init_drv(void)
 			&msm_vidc_thermal_mitigation_disabled) &&
 	__debugfs_create(bool, "bitrate_clock_scaling",
 			&msm_vidc_bitrate_clock_scaling) &&
+	__debugfs_create(bool, "dcvs_feedback", &msm_vidc_dcvs_feedback) &&
 	__debugfs_create(bool, "debug_timeout",
 			&msm_vidc_debug_timeout);
 
@@ -48,6 +48,8 @@
 
 /* Maintains the number of FTB's between each FBD over a window */
 #define DCVS_FTB_WINDOW 32
+/* Maintains the queue time of the inputs not yet processed by firmware */
+#define DCVS_FEEDBACK_WINDOW 16
 
 #define V4L2_EVENT_VIDC_BASE  10
 
@@ -209,6 +211,16 @@ struct dcvs_stats {
 	bool is_power_save_mode;
 	unsigned int extra_buffer_count;
 	u32 supported_codecs;
+	/* Feedback DCVS, inputs are queued and retired by separate threads */
+	ktime_t etb_time[DCVS_FEEDBACK_WINDOW];
+	u32 etb_queued;
+	u32 etb_retired;
+	ktime_t last_done;
+	ktime_t ftb_time;
+	u32 busy_us;
+	u32 frame_bits;
+	unsigned long voted_bitrate;
+	int feedback_samples;
 };
 
 struct profile_data {
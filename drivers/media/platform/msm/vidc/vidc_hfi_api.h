@@ -1450,6 +1450,7 @@ struct vidc_bus_vote_data {
 	struct imem_ab_table *imem_ab_tbl;
 	u32 imem_ab_tbl_size;
 	unsigned long core_freq;
+	unsigned long bitrate; /* measured bits/sec, 0 if unknown */
 };
 
 struct vidc_clk_scale_data {
@@ -135,12 +135,45 @@ static int cnss_stats_show_capability(struct seq_file *s,
 	return 0;
 }
 
+static int cnss_stats_show_link_pm(struct seq_file *s,
+				   struct cnss_plat_data *plat_priv)
+{
+	struct cnss_pci_data *pci_priv = plat_priv->bus_priv;
+	struct cnss_link_pm_stats *link_pm;
+	int i;
+
+	if (plat_priv->bus_type != CNSS_BUS_PCI || !pci_priv)
+		return 0;
+
+	link_pm = &pci_priv->link_pm;
+	seq_puts(s, "\n<---------- PCIe Link PM ----------->\n");
+	seq_printf(s, "Link wakes: %u (early: %u)\n",
+		   link_pm->wakes, link_pm->early_wakes);
+	seq_printf(s, "Resume latency avg: %llu us max: %u us\n",
+		   link_pm->wakes ?
+		   div_u64(link_pm->resume_total_us, link_pm->wakes) : 0,
+		   link_pm->resume_max_us);
+	seq_printf(s, "Autosuspend delay: %d ms\n",
+		   pci_priv->pci_dev->dev.power.autosuspend_delay);
+	seq_puts(s, "Link sleep histogram:\n");
+	for (i = 0; i < CNSS_LINK_GAP_BUCKETS - 1; i++)
+		seq_printf(s, "  < %5u ms: %u\n",
+			   CNSS_LINK_GAP_BASE_MS << (2 * i),
+			   link_pm->gap_hist[i]);
+	seq_printf(s, "  >=%5u ms: %u\n",
+		   CNSS_LINK_GAP_BASE_MS << (2 * (i - 1)),
+		   link_pm->gap_hist[i]);
+
+	return 0;
+}
+
 static int cnss_stats_show(struct seq_file *s, void *data)
 {
 	struct cnss_plat_data *plat_priv = s->private;
 
 	cnss_stats_show_state(s, plat_priv);
 	cnss_stats_show_capability(s, plat_priv);
+	cnss_stats_show_link_pm(s, plat_priv);
 	return 0;
 }
 
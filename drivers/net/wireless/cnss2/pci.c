@@ -1225,6 +1225,65 @@ static void cnss_dereg_pci_event(struct cnss_pci_data *pci_priv)
 }
 #endif /* CONFIG_PCI_MSM */
 
+/*
+ * A link woken again within the break-even time cost more in resume
+ * latency than the suspend saved, so the autosuspend delay is doubled;
+ * long sleeps walk it back towards the delay the WLAN driver set.
+ */
+#define CNSS_LINK_BREAK_EVEN_MS		50
+#define CNSS_LINK_LONG_SLEEP_MS		1000
+#define CNSS_AUTOSUSPEND_MAX_MS		2000
+
+static void cnss_pci_tune_autosuspend(struct cnss_pci_data *pci_priv,
+				      s64 gap_ms)
+{
+	struct device *dev = &pci_priv->pci_dev->dev;
+	struct cnss_link_pm_stats *link_pm = &pci_priv->link_pm;
+	int delay = dev->power.autosuspend_delay;
+
+	if (!dev->power.use_autosuspend || delay < 0)
+		return;
+
+	if (!link_pm->base_delay_ms)
+		link_pm->base_delay_ms = delay;
+
+	if (gap_ms < CNSS_LINK_BREAK_EVEN_MS) {
+		link_pm->early_wakes++;
+		delay = delay ? delay * 2 : CNSS_LINK_BREAK_EVEN_MS;
+		delay = min(delay, CNSS_AUTOSUSPEND_MAX_MS);
+	} else if (gap_ms >= CNSS_LINK_LONG_SLEEP_MS) {
+		delay = max(delay / 2, link_pm->base_delay_ms);
+	}
+
+	if (delay != dev->power.autosuspend_delay) {
+		cnss_pr_dbg("Link slept %lld ms, autosuspend delay %d ms\n",
+			    gap_ms, delay);
+		pm_runtime_set_autosuspend_delay(dev, delay);
+	}
+}
+
+static void cnss_pci_record_link_wake(struct cnss_pci_data *pci_priv,
+				      ktime_t start)
+{
+	struct cnss_link_pm_stats *link_pm = &pci_priv->link_pm;
+	ktime_t now = ktime_get();
+	s64 gap_ms = ktime_ms_delta(start, link_pm->suspend_time);
+	u32 resume_us = ktime_us_delta(now, start);
+	int i;
+
+	for (i = 0; i < CNSS_LINK_GAP_BUCKETS - 1; i++)
+		if (gap_ms < CNSS_LINK_GAP_BASE_MS << (2 * i))
+			break;
+	link_pm->gap_hist[i]++;
+
+	link_pm->wakes++;
+	link_pm->resume_total_us += resume_us;
+	if (resume_us > link_pm->resume_max_us)
+		link_pm->resume_max_us = resume_us;
+
+	cnss_pci_tune_autosuspend(pci_priv, gap_ms);
+}
+
 int cnss_auto_suspend(struct device *dev)
 {
 	int ret = 0;
@@ -1271,6 +1330,7 @@ int cnss_auto_suspend(struct device *dev)
 
 	cnss_pci_set_auto_suspended(pci_priv, 1);
 	cnss_pci_set_monitor_wake_intr(pci_priv, true);
+	pci_priv->link_pm.suspend_time = ktime_get();
 
 	bus_bw_info = &plat_priv->bus_bw_info;
 	msm_bus_scale_client_update_request(bus_bw_info->bus_client,
@@ -1294,6 +1354,7 @@ int cnss_auto_resume(struct device *dev)
 	struct pci_dev *pci_dev;
 	struct cnss_pci_data *pci_priv;
 	struct cnss_bus_bw_info *bus_bw_info;
+	ktime_t start;
 
 	if (!plat_priv)
 		return -ENODEV;
@@ -1303,6 +1364,7 @@ int cnss_auto_resume(struct device *dev)
 		return -ENODEV;
 
 	pci_dev = pci_priv->pci_dev;
+	start = ktime_get();
 	if (!pci_priv->pci_link_state) {
 		cnss_pr_dbg("Resuming PCI link\n");
 		if (cnss_set_pci_link(pci_priv, PCI_LINK_UP)) {
@@ -1322,6 +1384,8 @@ int cnss_auto_resume(struct device *dev)
 		cnss_pci_set_mhi_state(pci_priv, CNSS_MHI_RESUME);
 	}
 
+	if (cnss_pci_get_auto_suspended(pci_priv))
+		cnss_pci_record_link_wake(pci_priv, start);
 	cnss_pci_set_auto_suspended(pci_priv, 0);
 
 	bus_bw_info = &plat_priv->bus_bw_info;
@@ -45,6 +45,20 @@ enum cnss_mhi_state {
 	CNSS_MHI_RDDM_DONE,
 };
 
+/* Link sleep histogram buckets cover [0, 10), [10, 40), ... [2560, inf) ms */
+#define CNSS_LINK_GAP_BUCKETS		6
+#define CNSS_LINK_GAP_BASE_MS		10
+
+struct cnss_link_pm_stats {
+	ktime_t suspend_time;
+	u32 wakes;
+	u32 early_wakes;
+	u64 resume_total_us;
+	u32 resume_max_us;
+	u32 gap_hist[CNSS_LINK_GAP_BUCKETS];
+	int base_delay_ms;
+};
+
 struct cnss_msi_user {
 	char *name;
 	int num_vectors;
@@ -82,6 +96,7 @@ struct cnss_pci_data {
 	u32 msi_ep_base_data;
 	struct mhi_device mhi_dev;
 	unsigned long mhi_state;
+	struct cnss_link_pm_stats link_pm;
 };
 
 static inline void cnss_set_pci_priv(struct pci_dev *pci_dev, void *data)
@@ -17,6 +17,7 @@
 #include <linux/wcnss_wlan.h>
 #include <linux/spinlock.h>
 #include <linux/debugfs.h>
+#include <linux/bitmap.h>
 #include <net/cnss_prealloc.h>
 #ifdef	CONFIG_WCNSS_SKB_PRE_ALLOC
 #include <linux/skbuff.h>
@@ -34,7 +35,6 @@ static DEFINE_SPINLOCK(alloc_lock);
 static struct dentry *debug_base;
 
 struct wcnss_prealloc {
-	int occupied;
 	size_t size;
 	void *ptr;
 #ifdef CONFIG_SLUB_DEBUG
@@ -43,86 +43,58 @@ struct wcnss_prealloc {
 #endif
 };
 
+/*
+ * Pools of equally sized buffers, smallest first. A request is served from
+ * the smallest pool it fits in and only spills over into the next one up
+ * when that pool is exhausted.
+ */
+struct wcnss_prealloc_pool {
+	size_t size;
+	int count;
+	int first;
+	int used;
+	int max_used;
+	unsigned long spills;
+	unsigned long fails;
+};
+
 /* pre-alloced mem for WLAN driver */
-static struct wcnss_prealloc wcnss_allocs[] = {
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 128 * 1024, NULL},
-	{0, 128 * 1024, NULL},
+static struct wcnss_prealloc_pool wcnss_pools[] = {
+	{8 * 1024, 8},
+	{16 * 1024, 42},
+	{32 * 1024, 10},
+	{64 * 1024, 5},
+	{128 * 1024, 2},
 };
 
+static struct wcnss_prealloc *wcnss_allocs;
+static unsigned long *wcnss_occupied;
+static int wcnss_nr_allocs;
+static unsigned long wcnss_oversize;
+
 int wcnss_prealloc_init(void)
 {
-	int i;
-
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		wcnss_allocs[i].occupied = 0;
-		wcnss_allocs[i].ptr = kmalloc(wcnss_allocs[i].size, GFP_KERNEL);
-		if (wcnss_allocs[i].ptr == NULL)
-			return -ENOMEM;
+	struct wcnss_prealloc_pool *pool;
+	int i, j, n = 0;
+
+	for (i = 0; i < ARRAY_SIZE(wcnss_pools); i++)
+		n += wcnss_pools[i].count;
+
+	wcnss_allocs = kcalloc(n, sizeof(*wcnss_allocs), GFP_KERNEL);
+	wcnss_occupied = kcalloc(BITS_TO_LONGS(n), sizeof(long), GFP_KERNEL);
+	if (!wcnss_allocs || !wcnss_occupied)
+		return -ENOMEM;
+	wcnss_nr_allocs = n;
+
+	for (i = 0, n = 0; i < ARRAY_SIZE(wcnss_pools); i++) {
+		pool = &wcnss_pools[i];
+		pool->first = n;
+		for (j = 0; j < pool->count; j++, n++) {
+			wcnss_allocs[n].size = pool->size;
+			wcnss_allocs[n].ptr = kmalloc(pool->size, GFP_KERNEL);
+			if (wcnss_allocs[n].ptr == NULL)
+				return -ENOMEM;
+		}
 	}
 
 	return 0;
@@ -132,10 +104,14 @@ void wcnss_prealloc_deinit(void)
 {
 	int i = 0;
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
+	for (i = 0; i < wcnss_nr_allocs; i++)
 		kfree(wcnss_allocs[i].ptr);
-		wcnss_allocs[i].ptr = NULL;
-	}
+
+	kfree(wcnss_allocs);
+	kfree(wcnss_occupied);
+	wcnss_allocs = NULL;
+	wcnss_occupied = NULL;
+	wcnss_nr_allocs = 0;
 }
 
 #ifdef CONFIG_SLUB_DEBUG
@@ -160,24 +136,55 @@ static inline void wcnss_prealloc_save_stack_trace(struct wcnss_prealloc *entry)
 }
 #endif
 
+static struct wcnss_prealloc_pool *wcnss_prealloc_pool_of(int slot)
+{
+	int i;
+
+	for (i = ARRAY_SIZE(wcnss_pools) - 1; i > 0; i--)
+		if (slot >= wcnss_pools[i].first)
+			break;
+
+	return &wcnss_pools[i];
+}
+
 void *wcnss_prealloc_get(size_t size)
 {
-	int i = 0;
+	struct wcnss_prealloc_pool *pool, *fit = NULL;
+	int i, slot, end;
 	unsigned long flags;
 
+	/* The pools are gone if wcnss_prealloc_init() failed */
+	if (!wcnss_occupied)
+		return NULL;
+
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].occupied)
+	for (i = 0; i < ARRAY_SIZE(wcnss_pools); i++) {
+		pool = &wcnss_pools[i];
+		if (pool->size < size)
 			continue;
+		if (!fit)
+			fit = pool;
 
-		if (wcnss_allocs[i].size >= size) {
-			/* we found the slot */
-			wcnss_allocs[i].occupied = 1;
-			spin_unlock_irqrestore(&alloc_lock, flags);
-			wcnss_prealloc_save_stack_trace(&wcnss_allocs[i]);
-			return wcnss_allocs[i].ptr;
-		}
+		end = pool->first + pool->count;
+		slot = find_next_zero_bit(wcnss_occupied, end, pool->first);
+		if (slot >= end)
+			continue;
+
+		/* we found the slot */
+		set_bit(slot, wcnss_occupied);
+		if (++pool->used > pool->max_used)
+			pool->max_used = pool->used;
+		if (fit != pool)
+			fit->spills++;
+		spin_unlock_irqrestore(&alloc_lock, flags);
+		wcnss_prealloc_save_stack_trace(&wcnss_allocs[slot]);
+		return wcnss_allocs[slot].ptr;
 	}
+
+	if (fit)
+		fit->fails++;
+	else
+		wcnss_oversize++;
 	spin_unlock_irqrestore(&alloc_lock, flags);
 
 	pr_err("wcnss: %s: prealloc not available for size: %zu\n",
@@ -192,10 +199,14 @@ int wcnss_prealloc_put(void *ptr)
 	int i = 0;
 	unsigned long flags;
 
+	if (!wcnss_occupied)
+		return 0;
+
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
+	for_each_set_bit(i, wcnss_occupied, wcnss_nr_allocs) {
 		if (wcnss_allocs[i].ptr == ptr) {
-			wcnss_allocs[i].occupied = 0;
+			clear_bit(i, wcnss_occupied);
+			wcnss_prealloc_pool_of(i)->used--;
 			spin_unlock_irqrestore(&alloc_lock, flags);
 			return 1;
 		}
@@ -211,10 +222,7 @@ void wcnss_prealloc_check_memory_leak(void)
 {
 	int i, j = 0;
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (!wcnss_allocs[i].occupied)
-			continue;
-
+	for_each_set_bit(i, wcnss_occupied, wcnss_nr_allocs) {
 		if (j == 0) {
 			pr_err("wcnss_prealloc: Memory leak detected\n");
 			j++;
@@ -233,15 +241,18 @@ EXPORT_SYMBOL(wcnss_prealloc_check_memory_leak);
 
 int wcnss_pre_alloc_reset(void)
 {
-	int i, n = 0;
+	int i, n;
+	unsigned long flags;
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (!wcnss_allocs[i].occupied)
-			continue;
+	if (!wcnss_occupied)
+		return 0;
 
-		wcnss_allocs[i].occupied = 0;
-		n++;
-	}
+	spin_lock_irqsave(&alloc_lock, flags);
+	n = bitmap_weight(wcnss_occupied, wcnss_nr_allocs);
+	bitmap_zero(wcnss_occupied, wcnss_nr_allocs);
+	for (i = 0; i < ARRAY_SIZE(wcnss_pools); i++)
+		wcnss_pools[i].used = 0;
+	spin_unlock_irqrestore(&alloc_lock, flags);
 
 	return n;
 }
@@ -249,34 +260,21 @@ EXPORT_SYMBOL(wcnss_pre_alloc_reset);
 
 int prealloc_memory_stats_show(struct seq_file *fp, void *data)
 {
+	struct wcnss_prealloc_pool *pool;
 	int i = 0;
-	int used_slots = 0, free_slots = 0;
-	unsigned int tsize = 0, tused = 0, size = 0;
-
-	seq_puts(fp, "\nSlot_Size(Kb)\t\t[Used : Free]\n");
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		tsize += wcnss_allocs[i].size;
-		if (size != wcnss_allocs[i].size) {
-			if (size) {
-				seq_printf(
-					fp, "[%d : %d]\n",
-					used_slots, free_slots);
-			}
-
-			size = wcnss_allocs[i].size;
-			used_slots = 0;
-			free_slots = 0;
-			seq_printf(fp, "%d Kb\t\t\t", size / 1024);
-		}
-
-		if (wcnss_allocs[i].occupied) {
-			tused += wcnss_allocs[i].size;
-			++used_slots;
-		} else {
-			++free_slots;
-		}
+	unsigned int tsize = 0, tused = 0;
+
+	seq_puts(fp, "\nSlot_Size(Kb)\t\t[Used : Free]\tMax_Used\tSpills\tFails\n");
+	for (i = 0; i < ARRAY_SIZE(wcnss_pools); i++) {
+		pool = &wcnss_pools[i];
+		tsize += pool->size * pool->count;
+		tused += pool->size * pool->used;
+		seq_printf(fp, "%zu Kb\t\t\t[%d : %d]\t%d\t\t%lu\t%lu\n",
+			   pool->size / 1024, pool->used,
+			   pool->count - pool->used, pool->max_used,
+			   pool->spills, pool->fails);
 	}
-	seq_printf(fp, "[%d : %d]\n", used_slots, free_slots);
+	seq_printf(fp, "Larger than any slot: %lu\n", wcnss_oversize);
 
 	/* Convert byte to Kb */
 	if (tsize)
@@ -309,6 +307,7 @@ static int __init wcnss_pre_alloc_init(void)
 	ret = wcnss_prealloc_init();
 	if (ret) {
 		pr_err("%s: Failed to init the prealloc pool\n", __func__);
+		wcnss_prealloc_deinit();
 		return ret;
 	}
 
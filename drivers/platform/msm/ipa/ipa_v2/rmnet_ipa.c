@@ -2180,9 +2180,15 @@ static int ipa_wwan_probe(struct platform_device *pdev)
 		goto set_perf_err;
 	/* IPA_RM configuration ends */
 
-	/* Enable SG support in netdevice. */
-	if (ipa_rmnet_res.ipa_advertise_sg_support)
+	/*
+	 * Enable SG support in netdevice. Turn it on as well as making it
+	 * toggleable, otherwise the core linearizes every paged skb that
+	 * rmnet_data hands down before the tx path ever sees the frags.
+	 */
+	if (ipa_rmnet_res.ipa_advertise_sg_support) {
 		dev->hw_features |= NETIF_F_SG;
+		dev->features |= NETIF_F_SG;
+	}
 
 	/* Enable NAPI support in netdevice. */
 	if (ipa_rmnet_res.ipa_napi_enable) {
@@ -1076,6 +1076,9 @@ static ssize_t ipa3_read_stats(struct file *file, char __user *ubuf,
 		"wan_repl_rx_empty=%u\n"
 		"lan_rx_empty=%u\n"
 		"lan_repl_rx_empty=%u\n"
+		"rx_recycle_hit=%u\n"
+		"rx_recycle_remap=%u\n"
+		"rx_recycle_miss=%u\n"
 		"flow_enable=%u\n"
 		"flow_disable=%u\n",
 		ipa3_ctx->stats.tx_sw_pkts,
@@ -1092,6 +1095,9 @@ static ssize_t ipa3_read_stats(struct file *file, char __user *ubuf,
 		ipa3_ctx->stats.wan_repl_rx_empty,
 		ipa3_ctx->stats.lan_rx_empty,
 		ipa3_ctx->stats.lan_repl_rx_empty,
+		ipa3_ctx->stats.rx_recycle_hit,
+		ipa3_ctx->stats.rx_recycle_remap,
+		ipa3_ctx->stats.rx_recycle_miss,
 		ipa3_ctx->stats.flow_enable,
 		ipa3_ctx->stats.flow_disable);
 	cnt += nbytes;
@@ -63,6 +63,11 @@
 
 #define IPA_GSI_MAX_CH_LOW_WEIGHT 15
 #define IPA_GSI_EVT_RING_INT_MODT (32 * 1) /* 1ms under 32KHz clock */
+#define IPA_GSI_EVT_RING_INT_MODT_LOW_LAT 2 /* ~60us under 32KHz clock */
+/* polling sessions up to this many packets are treated as sparse traffic */
+#define IPA_RX_LOW_LAT_SESS_CNT (2 * IPA_WAN_AGGR_PKT_CNT)
+/* stay in poll mode this long after the last busy poll */
+#define IPA_RX_BUSY_POLL_HOLD_MS 20
 
 #define IPA_GSI_CH_20_WA_NUM_CH_TO_ALLOC 10
 /* The below virtual channel cannot be used by any entity */
@@ -70,6 +75,9 @@
 
 #define IPA_DEFAULT_SYS_YELLOW_WM 32
 
+/* Recycled RX buffers are handed back to HW this many at a time */
+#define IPA_RX_RECYCLE_BATCH 8
+
 static struct sk_buff *ipa3_get_skb_ipa_rx(unsigned int len, gfp_t flags);
 static void ipa3_replenish_wlan_rx_cache(struct ipa3_sys_context *sys);
 static void ipa3_replenish_rx_cache(struct ipa3_sys_context *sys);
@@ -1035,6 +1043,50 @@ static int ipa3_handle_rx_core(struct ipa3_sys_context *sys, bool process_all,
 	return cnt;
 }
 
+static bool ipa3_rx_busy_polled(struct ipa3_ep_context *ep)
+{
+	return ep->last_busy_poll && time_before(jiffies,
+		ep->last_busy_poll + msecs_to_jiffies(IPA_RX_BUSY_POLL_HOLD_MS));
+}
+
+/**
+ * ipa3_rx_adapt_intr_moderation() - pick the event ring moderation to use
+ * until the next polling session
+ * @sys: NAPI enabled system pipe going back to intr mode
+ *
+ * A session that saw only a few aggregates, or one driven by a busy polling
+ * socket, means latency sensitive traffic: the first packet after idle
+ * should not wait for the 1ms moderation timer. A busy session keeps the
+ * default so the next burst still costs a single interrupt.
+ */
+static void ipa3_rx_adapt_intr_moderation(struct ipa3_sys_context *sys)
+{
+	struct ipa3_ep_context *ep = sys->ep;
+	bool low_lat;
+	int ret;
+
+	low_lat = ep->poll_sess_cnt <= IPA_RX_LOW_LAT_SESS_CNT ||
+		ipa3_rx_busy_polled(ep);
+	ep->poll_sess_cnt = 0;
+	if (low_lat == ep->low_lat_intr)
+		return;
+
+	if (low_lat)
+		ret = gsi_set_evt_ring_intr_moderation(ep->gsi_evt_ring_hdl,
+			IPA_GSI_EVT_RING_INT_MODT_LOW_LAT, 1);
+	else
+		ret = gsi_set_evt_ring_intr_moderation(ep->gsi_evt_ring_hdl,
+			IPA_GSI_EVT_RING_INT_MODT, ep->dflt_int_modc);
+	if (ret != GSI_STATUS_SUCCESS) {
+		IPAERR("failed to set moderation %d\n", ret);
+		return;
+	}
+
+	ep->low_lat_intr = low_lat;
+	IPADBG_LOW("client=%d low latency moderation %d\n", ep->client,
+		low_lat);
+}
+
 /**
  * ipa3_rx_switch_to_intr_mode() - Operate the Rx data path in interrupt mode
  */
@@ -1047,6 +1099,8 @@ static void ipa3_rx_switch_to_intr_mode(struct ipa3_sys_context *sys)
 			IPAERR("already in intr mode\n");
 			goto fail;
 		}
+		if (sys->ep->napi_enabled)
+			ipa3_rx_adapt_intr_moderation(sys);
 		atomic_set(&sys->curr_polling_state, 0);
 		ret = gsi_config_channel_mode(sys->ep->gsi_chan_hdl,
 			GSI_CHAN_MODE_CALLBACK);
@@ -2275,19 +2329,32 @@ fail_kmem_cache_alloc:
 				msecs_to_jiffies(1));
 }
 
+/**
+ * ipa3_replenish_rx_cache_recycle() - Replenish the RX ring from recycled
+ * buffers
+ *
+ * LAN buffers coming back from the recycle list still hold their DMA
+ * mapping and only need a sync for the device. WAN buffers handed back by
+ * ipa3_recycle_wan_skb() were unmapped before going up the stack and are
+ * mapped again here. With GSI the doorbell is rung once per
+ * IPA_RX_RECYCLE_BATCH descriptors.
+ */
 static void ipa3_replenish_rx_cache_recycle(struct ipa3_sys_context *sys)
 {
 	void *ptr;
 	struct ipa3_rx_pkt_wrapper *rx_pkt;
 	int ret;
 	int rx_len_cached = 0;
+	int queued = 0;
+	bool recycled;
 	struct gsi_xfer_elem gsi_xfer_elem_one;
 	gfp_t flag = GFP_NOWAIT | __GFP_NOWARN;
 
 	rx_len_cached = sys->len;
 
 	while (rx_len_cached < sys->rx_pool_sz) {
-		if (list_empty(&sys->rcycl_list)) {
+		recycled = !list_empty(&sys->rcycl_list);
+		if (!recycled) {
 			rx_pkt = kmem_cache_zalloc(
 				ipa3_ctx->rx_pkt_wrapper_cache, flag);
 			if (!rx_pkt) {
@@ -2306,15 +2373,7 @@ static void ipa3_replenish_rx_cache_recycle(struct ipa3_sys_context *sys)
 					rx_pkt);
 				goto fail_kmem_cache_alloc;
 			}
-			ptr = skb_put(rx_pkt->data.skb, sys->rx_buff_sz);
-			rx_pkt->data.dma_addr = dma_map_single(ipa3_ctx->pdev,
-				ptr, sys->rx_buff_sz, DMA_FROM_DEVICE);
-			if (dma_mapping_error(ipa3_ctx->pdev,
-				rx_pkt->data.dma_addr)) {
-				IPAERR("dma_map_single failure %p for %p\n",
-					(void *)rx_pkt->data.dma_addr, ptr);
-				goto fail_dma_mapping;
-			}
+			IPA_STATS_INC_CNT(ipa3_ctx->stats.rx_recycle_miss);
 		} else {
 			spin_lock_bh(&sys->spinlock);
 			rx_pkt = list_first_entry(&sys->rcycl_list,
@@ -2322,7 +2381,15 @@ static void ipa3_replenish_rx_cache_recycle(struct ipa3_sys_context *sys)
 			list_del(&rx_pkt->link);
 			spin_unlock_bh(&sys->spinlock);
 			INIT_LIST_HEAD(&rx_pkt->link);
-			ptr = skb_put(rx_pkt->data.skb, sys->rx_buff_sz);
+		}
+
+		ptr = skb_put(rx_pkt->data.skb, sys->rx_buff_sz);
+		if (rx_pkt->data.dma_addr) {
+			dma_sync_single_for_device(ipa3_ctx->pdev,
+				rx_pkt->data.dma_addr, sys->rx_buff_sz,
+				DMA_FROM_DEVICE);
+			IPA_STATS_INC_CNT(ipa3_ctx->stats.rx_recycle_hit);
+		} else {
 			rx_pkt->data.dma_addr = dma_map_single(ipa3_ctx->pdev,
 				ptr, sys->rx_buff_sz, DMA_FROM_DEVICE);
 			if (dma_mapping_error(ipa3_ctx->pdev,
@@ -2331,6 +2398,9 @@ static void ipa3_replenish_rx_cache_recycle(struct ipa3_sys_context *sys)
 					(void *)rx_pkt->data.dma_addr, ptr);
 				goto fail_dma_mapping;
 			}
+			if (recycled)
+				IPA_STATS_INC_CNT(
+					ipa3_ctx->stats.rx_recycle_remap);
 		}
 
 		list_add_tail(&rx_pkt->link, &sys->head_desc_list);
@@ -2346,11 +2416,14 @@ static void ipa3_replenish_rx_cache_recycle(struct ipa3_sys_context *sys)
 			gsi_xfer_elem_one.type = GSI_XFER_ELEM_DATA;
 			gsi_xfer_elem_one.xfer_user_data = rx_pkt;
 
+			queued++;
 			ret = gsi_queue_xfer(sys->ep->gsi_chan_hdl,
-					1, &gsi_xfer_elem_one, true);
+					1, &gsi_xfer_elem_one,
+					!(queued % IPA_RX_RECYCLE_BATCH));
 			if (ret != GSI_STATUS_SUCCESS) {
 				IPAERR("failed to provide buffer: %d\n",
 					ret);
+				queued--;
 				goto fail_provide_rx_buffer;
 			}
 		} else {
@@ -2365,22 +2438,28 @@ static void ipa3_replenish_rx_cache_recycle(struct ipa3_sys_context *sys)
 		}
 	}
 
-	return;
+	goto ring_db;
 fail_provide_rx_buffer:
 	rx_len_cached = --sys->len;
 	list_del(&rx_pkt->link);
 	INIT_LIST_HEAD(&rx_pkt->link);
-	dma_unmap_single(ipa3_ctx->pdev, rx_pkt->data.dma_addr,
-		sys->rx_buff_sz, DMA_FROM_DEVICE);
+	/* the mapping is kept, the buffer goes back to the recycle list */
+	skb_trim(rx_pkt->data.skb, 0);
+	goto put_back;
 fail_dma_mapping:
+	rx_pkt->data.dma_addr = 0;
+	skb_trim(rx_pkt->data.skb, 0);
+put_back:
 	spin_lock_bh(&sys->spinlock);
 	list_add_tail(&rx_pkt->link, &sys->rcycl_list);
-	INIT_LIST_HEAD(&rx_pkt->link);
 	spin_unlock_bh(&sys->spinlock);
 fail_kmem_cache_alloc:
 	if (rx_len_cached == 0)
 		queue_delayed_work(sys->wq, &sys->replenish_rx_work,
 		msecs_to_jiffies(1));
+ring_db:
+	if (queued % IPA_RX_RECYCLE_BATCH)
+		gsi_start_xfer(sys->ep->gsi_chan_hdl);
 }
 
 static void ipa3_fast_replenish_rx_cache(struct ipa3_sys_context *sys)
@@ -2486,8 +2565,9 @@ static void ipa3_cleanup_rx(struct ipa3_sys_context *sys)
 	list_for_each_entry_safe(rx_pkt, r,
 				 &sys->rcycl_list, link) {
 		list_del(&rx_pkt->link);
-		dma_unmap_single(ipa3_ctx->pdev, rx_pkt->data.dma_addr,
-			sys->rx_buff_sz, DMA_FROM_DEVICE);
+		if (rx_pkt->data.dma_addr)
+			dma_unmap_single(ipa3_ctx->pdev, rx_pkt->data.dma_addr,
+				sys->rx_buff_sz, DMA_FROM_DEVICE);
 		sys->free_skb(rx_pkt->data.skb);
 		kmem_cache_free(ipa3_ctx->rx_pkt_wrapper_cache, rx_pkt);
 	}
@@ -3072,7 +3152,7 @@ void ipa3_lan_rx_cb(void *priv, enum ipa_dp_evt_type evt, unsigned long data)
 
 static void ipa3_recycle_rx_wrapper(struct ipa3_rx_pkt_wrapper *rx_pkt)
 {
-	rx_pkt->data.dma_addr = 0;
+	/* a non zero dma_addr means the buffer is still mapped */
 	ipa3_skb_recycle(rx_pkt->data.skb);
 	INIT_LIST_HEAD(&rx_pkt->link);
 	spin_lock_bh(&rx_pkt->sys->spinlock);
@@ -3092,6 +3172,7 @@ void ipa3_recycle_wan_skb(struct sk_buff *skb)
 		ipa_assert();
 	}
 
+	/* the skb went up the stack unmapped, dma_addr 0 gets it mapped */
 	rx_pkt = kmem_cache_zalloc(ipa3_ctx->rx_pkt_wrapper_cache,
 					flag);
 	if (!rx_pkt)
@@ -3121,15 +3202,25 @@ static void ipa3_wq_rx_common(struct ipa3_sys_context *sys, u32 size)
 	if (size)
 		rx_pkt_expected->len = size;
 	rx_skb = rx_pkt_expected->data.skb;
-	dma_unmap_single(ipa3_ctx->pdev, rx_pkt_expected->data.dma_addr,
+	if (sys->free_rx_wrapper == ipa3_recycle_rx_wrapper) {
+		/* keep the mapping, the buffer is back once pyld_hdlr returns */
+		dma_sync_single_for_cpu(ipa3_ctx->pdev,
+			rx_pkt_expected->data.dma_addr, sys->rx_buff_sz,
+			DMA_FROM_DEVICE);
+	} else {
+		dma_unmap_single(ipa3_ctx->pdev, rx_pkt_expected->data.dma_addr,
 			sys->rx_buff_sz, DMA_FROM_DEVICE);
+	}
 	skb_set_tail_pointer(rx_skb, rx_pkt_expected->len);
 	rx_skb->len = rx_pkt_expected->len;
 	*(unsigned int *)rx_skb->cb = rx_skb->len;
 	rx_skb->truesize = rx_pkt_expected->len + sizeof(struct sk_buff);
 	sys->pyld_hdlr(rx_skb, sys);
 	sys->free_rx_wrapper(rx_pkt_expected);
-	sys->repl_hdlr(sys);
+	/* recycled buffers go back to HW in batches, see ipa3_rx_poll() */
+	if (sys->repl_hdlr != ipa3_replenish_rx_cache_recycle ||
+	    sys->rx_pool_sz - sys->len >= IPA_RX_RECYCLE_BATCH)
+		sys->repl_hdlr(sys);
 }
 
 static void ipa3_wlan_wq_rx_common(struct ipa3_sys_context *sys, u32 size)
@@ -4016,6 +4107,8 @@ static int ipa_gsi_setup_channel(struct ipa_sys_connect_params *in,
 			gsi_evt_ring_props.int_modc = 248;
 		else
 			gsi_evt_ring_props.int_modc = 1;
+		ep->dflt_int_modc = gsi_evt_ring_props.int_modc;
+		ep->low_lat_intr = false;
 
 		IPADBG("client=%d moderation threshold cycles=%u cnt=%u\n",
 			ep->client,
@@ -4283,6 +4376,27 @@ static int ipa_handle_rx_core_sps(struct ipa3_sys_context *sys,
 	return cnt;
 }
 
+/*
+ * Complete the client NAPI and re-check the pipe. While a busy polling
+ * socket owns the NAPI, the napi_schedule() from the interrupt or from
+ * switch_to_intr_work is lost, so reschedule here if the pipe went back
+ * to poll mode or the ring already has new packets.
+ */
+static void ipa3_rx_napi_complete(struct ipa3_ep_context *ep)
+{
+	bool empty = true;
+
+	ep->client_notify(ep->priv, IPA_CLIENT_COMP_NAPI, 0);
+
+	if (!atomic_read(&ep->sys->curr_polling_state))
+		return;
+
+	if (ipa3_ctx->transport_prototype == IPA_TRANSPORT_TYPE_GSI)
+		gsi_is_channel_empty(ep->gsi_chan_hdl, &empty);
+	if (!empty)
+		ep->client_notify(ep->priv, IPA_CLIENT_START_POLL, 0);
+}
+
 /**
  * ipa3_rx_poll() - Poll the rx packets from IPA HW. This
  * function is exectued in the softirq context
@@ -4309,6 +4423,15 @@ int ipa3_rx_poll(u32 clnt_hdl, int weight)
 
 	ep = &ipa3_ctx->ep[clnt_hdl];
 
+	/*
+	 * A busy poll can race with the switch back to intr mode; there is
+	 * nothing to poll then and the interrupt will restart NAPI.
+	 */
+	if (!atomic_read(&ep->sys->curr_polling_state)) {
+		ipa3_rx_napi_complete(ep);
+		return cnt;
+	}
+
 	while (cnt < weight &&
 		   atomic_read(&ep->sys->curr_polling_state)) {
 
@@ -4323,15 +4446,25 @@ int ipa3_rx_poll(u32 clnt_hdl, int weight)
 		ipa3_wq_rx_common(ep->sys, mem_info.size);
 		cnt += IPA_WAN_AGGR_PKT_CNT;
 	};
+	ep->poll_sess_cnt += cnt;
+
+	/* top up what ipa3_wq_rx_common() left for the next batch */
+	if (ep->sys->repl_hdlr == ipa3_replenish_rx_cache_recycle)
+		ep->sys->repl_hdlr(ep->sys);
 
 	if (cnt == 0 || cnt < weight) {
 		ep->inactive_cycles++;
-		ep->client_notify(ep->priv, IPA_CLIENT_COMP_NAPI, 0);
+		ipa3_rx_napi_complete(ep);
 
-		if (ep->inactive_cycles > 3 || ep->sys->len == 0) {
+		/*
+		 * While a socket busy polls it pulls the packets itself, keep
+		 * the pipe in poll mode and only check it back every 1ms.
+		 */
+		if (ep->sys->len == 0 || (ep->inactive_cycles > 3 &&
+			!ipa3_rx_busy_polled(ep))) {
 			ep->switch_to_intr = true;
 			delay = 0;
-		} else if (cnt < weight) {
+		} else if (cnt < weight && ep->inactive_cycles <= 3) {
 			delay = 0;
 		}
 		queue_delayed_work(ep->sys->wq,
@@ -4342,6 +4475,30 @@ int ipa3_rx_poll(u32 clnt_hdl, int weight)
 	return cnt;
 }
 
+/**
+ * ipa3_rx_busy_poll() - Poll a NAPI pipe on behalf of a busy polling socket
+ * @clnt_hdl: [in] opaque client handle from ipa3_setup_sys_pipe
+ * @weight: [in] max number of packets to poll
+ *
+ * Same as ipa3_rx_poll(), the caller must own the client NAPI context. Also
+ * holds the pipe in poll mode for a while so the socket keeps finding the
+ * packets on the ring instead of waiting for the interrupt.
+ *
+ * Return: number of polled packets
+ */
+int ipa3_rx_busy_poll(u32 clnt_hdl, int weight)
+{
+	if (clnt_hdl >= ipa3_ctx->ipa_num_pipes ||
+		ipa3_ctx->ep[clnt_hdl].valid == 0) {
+		IPAERR("bad parm 0x%x\n", clnt_hdl);
+		return 0;
+	}
+
+	ipa3_ctx->ep[clnt_hdl].last_busy_poll = jiffies;
+
+	return ipa3_rx_poll(clnt_hdl, weight);
+}
+
 static unsigned long tag_to_pointer_wa(uint64_t tag)
 {
 	return 0xFFFF000000000000 | (unsigned long) tag;
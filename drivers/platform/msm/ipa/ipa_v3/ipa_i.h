@@ -548,6 +548,10 @@ struct ipa3_status_stats {
  * @qmi_request_sent: Indicates whether QMI request to enable clear data path
  *					request is sent or not.
  * @napi_enabled: when true, IPA call client callback to start polling
+ * @dflt_int_modc: event ring interrupt moderation counter set at connect
+ * @low_lat_intr: event ring currently uses the low latency moderation
+ * @poll_sess_cnt: packets polled since the last switch to intr mode
+ * @last_busy_poll: jiffies of the last poll done for a busy polling socket
  */
 struct ipa3_ep_context {
 	int valid;
@@ -587,6 +591,10 @@ struct ipa3_ep_context {
 	bool napi_enabled;
 	bool switch_to_intr;
 	int inactive_cycles;
+	u8 dflt_int_modc;
+	bool low_lat_intr;
+	u32 poll_sess_cnt;
+	unsigned long last_busy_poll;
 	u32 eot_in_poll_err;
 	bool ep_delay_set;
 
@@ -880,6 +888,9 @@ struct ipa3_stats {
 	u32 wan_repl_rx_empty;
 	u32 lan_rx_empty;
 	u32 lan_repl_rx_empty;
+	u32 rx_recycle_hit;
+	u32 rx_recycle_remap;
+	u32 rx_recycle_miss;
 	u32 flow_enable;
 	u32 flow_disable;
 	u32 tx_non_linear;
@@ -2120,6 +2131,7 @@ int ipa3_register_ipa_ready_cb(void (*ipa_ready_cb)(void *), void *user_data);
 const char *ipa_hw_error_str(enum ipa3_hw_errors err_type);
 int ipa_gsi_ch20_wa(void);
 int ipa3_rx_poll(u32 clnt_hdl, int budget);
+int ipa3_rx_busy_poll(u32 clnt_hdl, int budget);
 void ipa3_recycle_wan_skb(struct sk_buff *skb);
 int ipa3_smmu_map_peer_reg(phys_addr_t phys_addr, bool map);
 int ipa3_smmu_map_peer_buff(u64 iova, phys_addr_t phys_addr,
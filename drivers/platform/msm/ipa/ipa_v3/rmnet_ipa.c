@@ -28,6 +28,7 @@
 #include <linux/version.h>
 #include <linux/workqueue.h>
 #include <net/pkt_sched.h>
+#include <net/busy_poll.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/subsystem_notif.h>
 #include "ipa_qmi_service.h"
@@ -52,6 +53,11 @@
 #define DEFAULT_OUTSTANDING_LOW 64
 
 #define IPA_WWAN_DEV_NAME "rmnet_ipa%d"
+
+/* TX queues, all feeding APPS_WAN_PROD */
+#define IPA_WWAN_TXQ_PRIO 0 /* QMAP control and interactive traffic */
+#define IPA_WWAN_TXQ_BULK 1
+#define IPA_WWAN_TX_QUEUES 2
 #define IPA_UPSTEAM_WLAN_IFACE_NAME "wlan0"
 #define IPA_UPSTEAM_WLAN1_IFACE_NAME "wlan1"
 
@@ -74,6 +80,9 @@ static int ipa3_wwan_del_ul_flt_rule_to_ipa(void);
 static void ipa3_wwan_msg_free_cb(void*, u32, u32);
 static void ipa3_rmnet_rx_cb(void *priv);
 static int ipa3_rmnet_poll(struct napi_struct *napi, int budget);
+#ifdef CONFIG_NET_RX_BUSY_POLL
+static int ipa3_wwan_busy_poll(struct napi_struct *napi);
+#endif
 
 static void ipa3_wake_tx_queue(struct work_struct *work);
 static DECLARE_WORK(ipa3_tx_wakequeue_work, ipa3_wake_tx_queue);
@@ -998,6 +1007,18 @@ int ipa3_wwan_update_mux_channel_prop(void)
 #define reinit_completion(x) INIT_COMPLETION(*(x))
 #endif /* INIT_COMPLETION */
 
+/*
+ * Packets still in flight when the pipe goes down are never completed,
+ * so the byte queue limits must start over from an empty ring.
+ */
+static void ipa3_wwan_reset_tx_queues(struct net_device *dev)
+{
+	unsigned int i;
+
+	for (i = 0; i < dev->num_tx_queues; i++)
+		netdev_tx_reset_queue(netdev_get_tx_queue(dev, i));
+}
+
 static int __ipa_wwan_open(struct net_device *dev)
 {
 	struct ipa3_wwan_private *wwan_ptr = netdev_priv(dev);
@@ -1028,8 +1049,10 @@ static int ipa3_wwan_open(struct net_device *dev)
 
 	IPAWANDBG("[%s] wwan_open()\n", dev->name);
 	rc = __ipa_wwan_open(dev);
-	if (rc == 0)
-		netif_start_queue(dev);
+	if (rc == 0) {
+		ipa3_wwan_reset_tx_queues(dev);
+		netif_tx_start_all_queues(dev);
+	}
 	return rc;
 }
 
@@ -1074,7 +1097,8 @@ static int ipa3_wwan_stop(struct net_device *dev)
 	__ipa_wwan_close(dev);
 	if (ipa3_rmnet_res.ipa_napi_enable)
 		napi_disable(&(wwan_ptr->napi));
-	netif_stop_queue(dev);
+	netif_tx_stop_all_queues(dev);
+	ipa3_wwan_reset_tx_queues(dev);
 	return 0;
 }
 
@@ -1088,6 +1112,33 @@ static int ipa3_wwan_change_mtu(struct net_device *dev, int new_mtu)
 	return 0;
 }
 
+/**
+ * ipa3_wwan_select_queue() - Picks the TX queue of an skb
+ *
+ * @dev: network device
+ * @skb: skb to be transmitted
+ *
+ * QMAP commands and packets the stack marked as interactive get their own
+ * queue so they are not stuck behind bulk uploads in the qdisc. Each queue
+ * is byte limited, which bounds what bulk traffic can have in the pipe.
+ */
+static u16 ipa3_wwan_select_queue(struct net_device *dev, struct sk_buff *skb,
+	void *accel_priv, select_queue_fallback_t fallback)
+{
+	if (skb->protocol == htons(ETH_P_MAP) &&
+		skb_headlen(skb) >= sizeof(struct rmnet_map_header_s) &&
+		RMNET_MAP_GET_CD_BIT(skb))
+		return IPA_WWAN_TXQ_PRIO;
+
+	switch (skb->priority & TC_PRIO_MAX) {
+	case TC_PRIO_INTERACTIVE:
+	case TC_PRIO_CONTROL:
+		return IPA_WWAN_TXQ_PRIO;
+	default:
+		return IPA_WWAN_TXQ_BULK;
+	}
+}
+
 /**
  * ipa3_wwan_xmit() - Transmits an skb.
  *
@@ -1105,7 +1156,9 @@ static int ipa3_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 	int ret = 0;
 	bool qmap_check;
 	struct ipa3_wwan_private *wwan_ptr = netdev_priv(dev);
+	struct netdev_queue *txq = skb_get_tx_queue(dev, skb);
 	struct ipa_tx_meta meta;
+	unsigned int len;
 
 	if (skb->protocol != htons(ETH_P_MAP)) {
 		IPAWANDBG_LOW
@@ -1117,7 +1170,7 @@ static int ipa3_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 	}
 
 	qmap_check = RMNET_MAP_GET_CD_BIT(skb);
-	if (netif_queue_stopped(dev)) {
+	if (netif_tx_queue_stopped(txq)) {
 		if (qmap_check &&
 			atomic_read(&wwan_ptr->outstanding_pkts) <
 					wwan_ptr->outstanding_high_ctl) {
@@ -1137,9 +1190,17 @@ static int ipa3_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 			IPAWANDBG_LOW("pending(%d)/(%d)- stop(%d)\n",
 				atomic_read(&wwan_ptr->outstanding_pkts),
 				wwan_ptr->outstanding_high,
-				netif_queue_stopped(dev));
+				netif_tx_queue_stopped(txq));
 			IPAWANDBG_LOW("qmap_chk(%d)\n", qmap_check);
-			netif_stop_queue(dev);
+			netif_tx_stop_queue(txq);
+			/*
+			 * Completions only wake the queues when crossing the
+			 * low WM; if they all ran before the stop, nobody will.
+			 */
+			smp_mb__after_atomic();
+			if (atomic_read(&wwan_ptr->outstanding_pkts) <
+					wwan_ptr->outstanding_low)
+				netif_tx_wake_queue(txq);
 			return NETDEV_TX_BUSY;
 		}
 	}
@@ -1149,7 +1210,7 @@ send:
 	ret = ipa_rm_inactivity_timer_request_resource(
 		IPA_RM_RESOURCE_WWAN_0_PROD);
 	if (ret == -EINPROGRESS) {
-		netif_stop_queue(dev);
+		netif_tx_stop_queue(txq);
 		return NETDEV_TX_BUSY;
 	}
 	if (ret) {
@@ -1161,6 +1222,13 @@ send:
 	}
 	/* IPA_RM checking end */
 
+	/*
+	 * Account before handing the skb over, its TX complete may run on
+	 * another CPU before ipa3_tx_dp() returns.
+	 */
+	len = skb->len;
+	netdev_tx_sent_queue(txq, len);
+
 	if (RMNET_MAP_GET_CD_BIT(skb)) {
 		memset(&meta, 0, sizeof(meta));
 		meta.pkt_init_dst_ep_valid = true;
@@ -1173,13 +1241,14 @@ send:
 	}
 
 	if (ret) {
+		netdev_tx_completed_queue(txq, 1, len);
 		ret = NETDEV_TX_BUSY;
 		goto out;
 	}
 
 	atomic_inc(&wwan_ptr->outstanding_pkts);
 	dev->stats.tx_packets++;
-	dev->stats.tx_bytes += skb->len;
+	dev->stats.tx_bytes += len;
 	ret = NETDEV_TX_OK;
 out:
 	if (atomic_read(&wwan_ptr->outstanding_pkts) == 0)
@@ -1214,6 +1283,7 @@ static void apps_ipa_tx_complete_notify(void *priv,
 	struct sk_buff *skb = (struct sk_buff *)data;
 	struct net_device *dev = (struct net_device *)priv;
 	struct ipa3_wwan_private *wwan_ptr;
+	struct netdev_queue *txq;
 
 	if (dev != IPA_NETDEV()) {
 		IPAWANDBG("Received pre-SSR packet completion\n");
@@ -1223,27 +1293,32 @@ static void apps_ipa_tx_complete_notify(void *priv,
 
 	if (evt != IPA_WRITE_DONE) {
 		IPAWANERR("unsupported evt on Tx callback, Drop the packet\n");
+		txq = skb_get_tx_queue(dev, skb);
+		__netif_tx_lock_bh(txq);
+		netdev_tx_completed_queue(txq, 1, skb->len);
+		__netif_tx_unlock_bh(txq);
 		dev_kfree_skb_any(skb);
 		dev->stats.tx_dropped++;
 		return;
 	}
 
 	wwan_ptr = netdev_priv(dev);
+	txq = skb_get_tx_queue(dev, skb);
 	atomic_dec(&wwan_ptr->outstanding_pkts);
-	__netif_tx_lock_bh(netdev_get_tx_queue(dev, 0));
+	__netif_tx_lock_bh(txq);
+	netdev_tx_completed_queue(txq, 1, skb->len);
 	if (!atomic_read(&rmnet_ipa3_ctx->is_ssr) &&
-		netif_queue_stopped(wwan_ptr->net) &&
 		atomic_read(&wwan_ptr->outstanding_pkts) <
 					(wwan_ptr->outstanding_low)) {
-		IPAWANDBG_LOW("Outstanding low (%d) - waking up queue\n",
+		IPAWANDBG_LOW("Outstanding low (%d) - waking up queues\n",
 				wwan_ptr->outstanding_low);
-		netif_wake_queue(wwan_ptr->net);
+		netif_tx_wake_all_queues(wwan_ptr->net);
 	}
 
 	if (atomic_read(&wwan_ptr->outstanding_pkts) == 0)
 		ipa_rm_inactivity_timer_release_resource(
 			IPA_RM_RESOURCE_WWAN_0_PROD);
-	__netif_tx_unlock_bh(netdev_get_tx_queue(dev, 0));
+	__netif_tx_unlock_bh(txq);
 	dev_kfree_skb_any(skb);
 }
 
@@ -1814,11 +1889,15 @@ static const struct net_device_ops ipa3_wwan_ops_ip = {
 	.ndo_open = ipa3_wwan_open,
 	.ndo_stop = ipa3_wwan_stop,
 	.ndo_start_xmit = ipa3_wwan_xmit,
+	.ndo_select_queue = ipa3_wwan_select_queue,
 	.ndo_tx_timeout = ipa3_wwan_tx_timeout,
 	.ndo_do_ioctl = ipa3_wwan_ioctl,
 	.ndo_change_mtu = ipa3_wwan_change_mtu,
 	.ndo_set_mac_address = 0,
 	.ndo_validate_addr = 0,
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	.ndo_busy_poll = ipa3_wwan_busy_poll,
+#endif
 };
 
 /**
@@ -1995,9 +2074,9 @@ void ipa3_q6_deinitialize_rm(void)
 static void ipa3_wake_tx_queue(struct work_struct *work)
 {
 	if (IPA_NETDEV()) {
-		__netif_tx_lock_bh(netdev_get_tx_queue(IPA_NETDEV(), 0));
-		netif_wake_queue(IPA_NETDEV());
-		__netif_tx_unlock_bh(netdev_get_tx_queue(IPA_NETDEV(), 0));
+		netif_tx_lock_bh(IPA_NETDEV());
+		netif_tx_wake_all_queues(IPA_NETDEV());
+		netif_tx_unlock_bh(IPA_NETDEV());
 	}
 }
 
@@ -2215,10 +2294,11 @@ static int ipa3_wwan_probe(struct platform_device *pdev)
 	}
 
 	/* initialize wan-driver netdev */
-	dev = alloc_netdev(sizeof(struct ipa3_wwan_private),
+	dev = alloc_netdev_mqs(sizeof(struct ipa3_wwan_private),
 			   IPA_WWAN_DEV_NAME,
 			   NET_NAME_UNKNOWN,
-			   ipa3_wwan_setup);
+			   ipa3_wwan_setup,
+			   IPA_WWAN_TX_QUEUES, 1);
 	if (!dev) {
 		IPAWANERR("no memory for netdev\n");
 		ret = -ENOMEM;
@@ -2277,13 +2357,21 @@ static int ipa3_wwan_probe(struct platform_device *pdev)
 		goto set_perf_err;
 	/* IPA_RM configuration ends */
 
-	/* Enable SG support in netdevice. */
-	if (ipa3_rmnet_res.ipa_advertise_sg_support)
+	/*
+	 * Enable SG support in netdevice. Turn it on as well as making it
+	 * toggleable, otherwise the core linearizes every paged skb that
+	 * rmnet_data hands down before the tx path ever sees the frags.
+	 */
+	if (ipa3_rmnet_res.ipa_advertise_sg_support) {
 		dev->hw_features |= NETIF_F_SG;
+		dev->features |= NETIF_F_SG;
+	}
 
-	if (ipa3_rmnet_res.ipa_napi_enable)
+	if (ipa3_rmnet_res.ipa_napi_enable) {
 		netif_napi_add(dev, &(rmnet_ipa3_ctx->wwan_priv->napi),
 		       ipa3_rmnet_poll, NAPI_WEIGHT);
+		napi_hash_add(&(rmnet_ipa3_ctx->wwan_priv->napi));
+	}
 	ret = register_netdev(dev);
 	if (ret) {
 		IPAWANERR("unable to register ipa_netdev %d rc=%d\n",
@@ -2307,8 +2395,10 @@ static int ipa3_wwan_probe(struct platform_device *pdev)
 	pr_info("rmnet_ipa completed initialization\n");
 	return 0;
 config_err:
-	if (ipa3_rmnet_res.ipa_napi_enable)
+	if (ipa3_rmnet_res.ipa_napi_enable) {
+		napi_hash_del(&(rmnet_ipa3_ctx->wwan_priv->napi));
 		netif_napi_del(&(rmnet_ipa3_ctx->wwan_priv->napi));
+	}
 	unregister_netdev(dev);
 set_perf_err:
 	ret = ipa_rm_delete_dependency(IPA_RM_RESOURCE_WWAN_0_PROD,
@@ -2364,8 +2454,10 @@ static int ipa3_wwan_remove(struct platform_device *pdev)
 		IPAWANERR("Failed to teardown APPS->IPA pipe\n");
 	else
 		rmnet_ipa3_ctx->apps_to_ipa3_hdl = -1;
-	if (ipa3_rmnet_res.ipa_napi_enable)
+	if (ipa3_rmnet_res.ipa_napi_enable) {
+		napi_hash_del(&(rmnet_ipa3_ctx->wwan_priv->napi));
 		netif_napi_del(&(rmnet_ipa3_ctx->wwan_priv->napi));
+	}
 	mutex_unlock(&rmnet_ipa3_ctx->pipe_handle_guard);
 	unregister_netdev(IPA_NETDEV());
 	ret = ipa_rm_delete_dependency(IPA_RM_RESOURCE_WWAN_0_PROD,
@@ -2447,7 +2539,7 @@ static int rmnet_ipa_ap_suspend(struct device *dev)
 	}
 
 	/* Make sure that there is no Tx operation ongoing */
-	netif_stop_queue(netdev);
+	netif_tx_stop_all_queues(netdev);
         /* Stoppig Watch dog timer when pipe was in suspend state */
         if (del_timer(&netdev->watchdog_timer))
                 dev_put(netdev);
@@ -2477,7 +2569,7 @@ static int rmnet_ipa_ap_resume(struct device *dev)
 
 	IPAWANDBG("Enter...\n");
 	if (netdev) {
-		netif_wake_queue(netdev);
+		netif_tx_wake_all_queues(netdev);
 		/* Starting Watch dog timer, pipe was changes to resume state */
 		if (netif_running(netdev) && netdev->watchdog_timeo <= 0)
 			__netdev_watchdog_up(netdev);
@@ -2552,8 +2644,10 @@ static int ipa3_ssr_notifier_cb(struct notifier_block *this,
 		rmnet_ipa_send_ssr_notification(false);
 		atomic_set(&rmnet_ipa3_ctx->is_ssr, 1);
 		ipa3_q6_pre_shutdown_cleanup();
-		if (IPA_NETDEV())
-			netif_stop_queue(IPA_NETDEV());
+		if (IPA_NETDEV()) {
+			netif_tx_stop_all_queues(IPA_NETDEV());
+			ipa3_wwan_reset_tx_queues(IPA_NETDEV());
+		}
 		ipa3_qmi_stop_workqueues();
 		ipa3_wan_ioctl_stop_qmi_messages();
 		ipa_stop_polling_stats();
@@ -3956,6 +4050,28 @@ static int ipa3_rmnet_poll(struct napi_struct *napi, int budget)
 	return rcvd_pkts;
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/*
+ * Called from a busy polling socket. Owning the NAPI keeps ipa3_rmnet_poll()
+ * out while the ring is polled from here; the NAPI is completed by IPA
+ * below budget, above it the rest is left to softirq.
+ */
+static int ipa3_wwan_busy_poll(struct napi_struct *napi)
+{
+	int rcvd_pkts;
+
+	if (!napi_schedule_prep(napi))
+		return LL_FLUSH_BUSY;
+
+	rcvd_pkts = ipa3_rx_busy_poll(rmnet_ipa3_ctx->ipa3_to_apps_hdl,
+					NAPI_WEIGHT);
+	if (rcvd_pkts >= NAPI_WEIGHT)
+		__napi_schedule(napi);
+
+	return rcvd_pkts;
+}
+#endif
+
 late_initcall(ipa3_wwan_init);
 module_exit(ipa3_wwan_cleanup);
 MODULE_DESCRIPTION("WWAN Network Interface");
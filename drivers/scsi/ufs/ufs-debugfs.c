@@ -1446,6 +1446,77 @@ static int ufsdbg_req_stats_show(struct seq_file *file, void *data)
 	return 0;
 }
 
+static ssize_t ufsdbg_req_lat_hist_write(struct file *filp,
+		const char __user *ubuf, size_t cnt, loff_t *ppos)
+{
+	struct ufs_hba *hba = filp->f_mapping->host->i_private;
+	unsigned long flags;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	memset(hba->ufs_stats.req_lat_hist, 0,
+	       sizeof(hba->ufs_stats.req_lat_hist));
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return cnt;
+}
+
+static int ufsdbg_req_lat_hist_show(struct seq_file *file, void *data)
+{
+	static const char * const type_names[TS_NUM_STATS] = {
+		[TS_READ] = "Read", [TS_WRITE] = "Write",
+		[TS_URGENT_READ] = "Read(urg)", [TS_URGENT_WRITE] = "Write(urg)",
+		[TS_FLUSH] = "Flush", [TS_DISCARD] = "Discard",
+	};
+	struct ufs_hba *hba = (struct ufs_hba *)file->private;
+	u32 row[UFSHCD_LAT_HIST_BUCKETS];
+	unsigned long flags;
+	int lun, type, i;
+	u64 total;
+
+	/* Header: upper bound of each bucket in usec */
+	seq_printf(file, "%-4s %-10s", "LUN", "Type");
+	for (i = 0; i < UFSHCD_LAT_HIST_BUCKETS - 1; i++)
+		seq_printf(file, " <%-8lu", 1UL << i);
+	seq_printf(file, " >=%-7lu\n", 1UL << (UFSHCD_LAT_HIST_BUCKETS - 2));
+
+	for (lun = 0; lun < UFSHCD_LAT_HIST_LUNS; lun++) {
+		for (type = TS_READ; type < TS_NUM_STATS; type++) {
+			spin_lock_irqsave(hba->host->host_lock, flags);
+			memcpy(row, hba->ufs_stats.req_lat_hist[lun][type],
+			       sizeof(row));
+			spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+			for (i = 0, total = 0; i < UFSHCD_LAT_HIST_BUCKETS; i++)
+				total += row[i];
+			if (!total)
+				continue;
+
+			if (lun < UFS_UPIU_MAX_GENERAL_LUN)
+				seq_printf(file, "%-4d", lun);
+			else
+				seq_printf(file, "%-4s", "W");
+			seq_printf(file, " %-10s", type_names[type]);
+			for (i = 0; i < UFSHCD_LAT_HIST_BUCKETS; i++)
+				seq_printf(file, " %-9u", row[i]);
+			seq_puts(file, "\n");
+		}
+	}
+
+	return 0;
+}
+
+static int ufsdbg_req_lat_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ufsdbg_req_lat_hist_show, inode->i_private);
+}
+
+static const struct file_operations ufsdbg_req_lat_hist_desc = {
+	.open		= ufsdbg_req_lat_hist_open,
+	.read		= seq_read,
+	.write		= ufsdbg_req_lat_hist_write,
+	.release	= single_release,
+};
+
 static int ufsdbg_req_stats_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, ufsdbg_req_stats_show, inode->i_private);
@@ -1691,6 +1762,17 @@ void ufsdbg_add_debugfs(struct ufs_hba *hba)
 		goto err;
 	}
 
+	hba->debugfs_files.req_lat_hist =
+		debugfs_create_file("req_lat_hist", S_IRUSR | S_IWUSR,
+			hba->debugfs_files.stats_folder, hba,
+			&ufsdbg_req_lat_hist_desc);
+	if (!hba->debugfs_files.req_lat_hist) {
+		dev_err(hba->dev,
+			"%s:  failed create req_lat_hist debugfs entry\n",
+			__func__);
+		goto err;
+	}
+
 	hba->debugfs_files.reset_controller =
 		debugfs_create_file("reset_controller", S_IRUSR | S_IWUSR,
 			hba->debugfs_files.debugfs_root, hba,
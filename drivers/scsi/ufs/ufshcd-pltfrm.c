@@ -395,6 +395,12 @@ int ufshcd_pltfrm_init(struct platform_device *pdev,
 
 	platform_set_drvdata(pdev, hba);
 
+	/*
+	 * ICE and the UFS PHY are driven from the UFS callbacks, so nothing
+	 * orders the controller against other devices but its children.
+	 */
+	device_enable_async_suspend(&pdev->dev);
+
 	pm_runtime_set_active(&pdev->dev);
 	pm_runtime_enable(&pdev->dev);
 
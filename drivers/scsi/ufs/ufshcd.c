@@ -40,6 +40,7 @@
 #include <linux/async.h>
 #include <scsi/ufs/ioctl.h>
 #include <linux/devfreq.h>
+#include <linux/devfreq_boost.h>
 #include <linux/nls.h>
 #include <linux/of.h>
 #include <linux/blkdev.h>
@@ -110,7 +111,7 @@ static void ufshcd_update_tag_stats_completion(struct ufs_hba *hba,
 
 static void update_req_stats(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 {
-	int rq_type;
+	int rq_type, hist, bucket;
 	struct request *rq = lrbp->cmd ? lrbp->cmd->request : NULL;
 	s64 delta = ktime_us_delta(lrbp->complete_time_stamp,
 		lrbp->issue_time_stamp);
@@ -129,6 +130,11 @@ static void update_req_stats(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 	if (rq_type == TS_NOT_SUPPORTED)
 		return;
 
+	hist = lrbp->lun < UFS_UPIU_MAX_GENERAL_LUN ? lrbp->lun :
+		UFS_UPIU_MAX_GENERAL_LUN;
+	bucket = min_t(int, fls64(delta), UFSHCD_LAT_HIST_BUCKETS - 1);
+	hba->ufs_stats.req_lat_hist[hist][rq_type][bucket]++;
+
 	/* update request type specific statistics */
 	if (hba->ufs_stats.req_stats[rq_type].count == 0)
 		hba->ufs_stats.req_stats[rq_type].min = delta;
@@ -215,6 +221,12 @@ void ufshcd_update_query_stats(struct ufs_hba *hba,
 /* Interrupt aggregation default timeout, unit: 40us */
 #define INT_AGGR_DEF_TO	0x02
 
+/*
+ * Requests issued with fewer than this many others in flight bypass
+ * interrupt aggregation, there is nothing to aggregate them with.
+ */
+#define INT_AGGR_MIN_QD	2
+
 /* default value of auto suspend is 3 seconds */
 #define UFSHCD_AUTO_SUSPEND_DELAY_MS 3000 /* millisecs */
 
@@ -1622,6 +1634,106 @@ out:
 	return;
 }
 
+/*
+ * A fixed gating or hibern8 delay makes a request that arrives just after
+ * it expires pay for ungating and hibern8 exit. When recent idle periods
+ * were only a little longer than the delay, extend it to cover them; idle
+ * periods far beyond the delay keep the configured value.
+ */
+#define UFSHCD_IDLE_PREDICT_MAX_SCALE	4
+
+static unsigned long ufshcd_idle_predict_ms(struct ufs_hba *hba,
+					    unsigned long delay_ms)
+{
+	struct ufs_idle_predict *predict = &hba->idle_predict;
+	unsigned long predict_ms;
+
+	if (!predict->is_enabled || !predict->avg_us)
+		return 0;
+
+	/* leave a quarter of margin on top of the average */
+	predict_ms = DIV_ROUND_UP(predict->avg_us + predict->avg_us / 4,
+				  USEC_PER_MSEC);
+	if (predict_ms <= delay_ms ||
+	    predict_ms > delay_ms * UFSHCD_IDLE_PREDICT_MAX_SCALE)
+		return 0;
+
+	return predict_ms;
+}
+
+/* host lock must be held before calling this */
+static unsigned long ufshcd_clkgate_delay_ms(struct ufs_hba *hba)
+{
+	unsigned long delay_ms = hba->clk_gating.delay_ms;
+
+	hba->idle_predict.gate_ext_ms = ufshcd_idle_predict_ms(hba, delay_ms);
+
+	return hba->idle_predict.gate_ext_ms ? : delay_ms;
+}
+
+/* host lock must be held before calling this */
+static unsigned long ufshcd_hibern8_delay_ms(struct ufs_hba *hba)
+{
+	unsigned long delay_ms = hba->hibern8_on_idle.delay_ms;
+	unsigned long ext_ms = ufshcd_idle_predict_ms(hba, delay_ms);
+	unsigned long gate_ms;
+
+	/* hibern8 must still be entered before the clocks are gated */
+	if (ext_ms && ufshcd_is_clkgating_allowed(hba)) {
+		gate_ms = hba->idle_predict.gate_ext_ms ? :
+			  hba->clk_gating.delay_ms;
+		ext_ms = min(ext_ms, gate_ms - 1);
+		if (ext_ms <= delay_ms)
+			ext_ms = 0;
+	}
+	hba->idle_predict.hibern8_ext_ms = ext_ms;
+
+	return ext_ms ? : delay_ms;
+}
+
+static void ufshcd_idle_predict_account(unsigned long idle_us,
+					unsigned long delay_ms,
+					unsigned long ext_ms,
+					unsigned long *avoided,
+					unsigned long *missed)
+{
+	if (!ext_ms || idle_us <= delay_ms * USEC_PER_MSEC)
+		return;
+
+	if (idle_us < ext_ms * USEC_PER_MSEC)
+		(*avoided)++;
+	else
+		(*missed)++;
+}
+
+/* host lock must be held before calling this */
+static void ufshcd_idle_predict_update(struct ufs_hba *hba)
+{
+	struct ufs_idle_predict *predict = &hba->idle_predict;
+	unsigned long idle_us;
+
+	if (!predict->is_idle)
+		return;
+	predict->is_idle = false;
+
+	/* one long idle period is enough to push the average out of range */
+	idle_us = min_t(s64, ktime_us_delta(ktime_get(), predict->idle_start),
+			USEC_PER_SEC);
+
+	ufshcd_idle_predict_account(idle_us, hba->clk_gating.delay_ms,
+				    predict->gate_ext_ms,
+				    &predict->avoided_ungates, &predict->missed);
+	ufshcd_idle_predict_account(idle_us, hba->hibern8_on_idle.delay_ms,
+				    predict->hibern8_ext_ms,
+				    &predict->avoided_hibern8_exits,
+				    &predict->missed);
+
+	if (predict->avg_us)
+		predict->avg_us = (predict->avg_us * 3 + idle_us) >> 2;
+	else
+		predict->avg_us = idle_us;
+}
+
 /* host lock must be held before calling this variant */
 static void __ufshcd_release(struct ufs_hba *hba, bool no_sched)
 {
@@ -1642,7 +1754,7 @@ static void __ufshcd_release(struct ufs_hba *hba, bool no_sched)
 	hba->ufs_stats.clk_rel.ts = ktime_get();
 
 	hrtimer_start(&hba->clk_gating.gate_hrtimer,
-			ms_to_ktime(hba->clk_gating.delay_ms),
+			ms_to_ktime(ufshcd_clkgate_delay_ms(hba)),
 			HRTIMER_MODE_REL);
 }
 
@@ -1999,7 +2111,7 @@ static void __ufshcd_hibern8_release(struct ufs_hba *hba, bool no_sched)
 	 * work gets scheduled atleast after 2 jiffies (any time between
 	 * 1000/HZ ms to 2000/HZ ms).
 	 */
-	delay_in_jiffies = msecs_to_jiffies(hba->hibern8_on_idle.delay_ms);
+	delay_in_jiffies = msecs_to_jiffies(ufshcd_hibern8_delay_ms(hba));
 	if (delay_in_jiffies == 1)
 		delay_in_jiffies++;
 
@@ -2841,6 +2953,24 @@ static inline void ufshcd_prepare_utp_nop_upiu(struct ufshcd_lrb *lrbp)
 	memset(lrbp->ucd_rsp_ptr, 0, sizeof(struct utp_upiu_rsp));
 }
 
+/*
+ * Synchronous and metadata reads that are not idle class are sent as head
+ * of queue, so the device services them ahead of the writes it already has
+ * queued. Readahead and other async reads keep the normal ordering.
+ */
+static bool ufshcd_is_prio_read(struct scsi_cmnd *cmd)
+{
+	struct request *rq = cmd->request;
+
+	if (!rq || rq->cmd_type != REQ_TYPE_FS || rq_data_dir(rq) != READ)
+		return false;
+
+	if (!(rq->cmd_flags & (REQ_SYNC | REQ_META)))
+		return false;
+
+	return IOPRIO_PRIO_CLASS(req_get_ioprio(rq)) != IOPRIO_CLASS_IDLE;
+}
+
 /**
  * ufshcd_compose_upiu - form UFS Protocol Information Unit(UPIU)
  * @hba - per adapter instance
@@ -2856,6 +2986,8 @@ static int ufshcd_compose_upiu(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 		if (likely(lrbp->cmd)) {
 			ret = ufshcd_prepare_req_desc_hdr(hba, lrbp,
 				&upiu_flags, lrbp->cmd->sc_data_direction);
+			if (ufshcd_is_prio_read(lrbp->cmd))
+				upiu_flags |= UPIU_TASK_ATTR_HEADQ;
 			ufshcd_prepare_utp_scsi_cmd_upiu(lrbp, upiu_flags);
 		} else {
 			ret = -EINVAL;
@@ -3040,6 +3172,7 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 		cmd->scsi_done(cmd);
 		goto out_unlock;
 	}
+	ufshcd_idle_predict_update(hba);
 	spin_unlock_irqrestore(hba->host->host_lock, flags);
 
 	hba->req_abort_count = 0;
@@ -3099,7 +3232,8 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 	lrbp->sense_buffer = cmd->sense_buffer;
 	lrbp->task_tag = tag;
 	lrbp->lun = ufshcd_scsi_to_upiu_lun(cmd->device->lun);
-	lrbp->intr_cmd = !ufshcd_is_intr_aggr_allowed(hba) ? true : false;
+	lrbp->intr_cmd = !ufshcd_is_intr_aggr_allowed(hba) ||
+		hweight_long(hba->outstanding_reqs) < INT_AGGR_MIN_QD;
 	lrbp->command_type = UTP_CMD_TYPE_SCSI;
 	lrbp->req_abort_skip = false;
 
@@ -5287,7 +5421,11 @@ static int ufshcd_slave_configure(struct scsi_device *sdev)
 	blk_queue_max_segment_size(q, PRDT_DATA_BYTE_COUNT_MAX);
 
 	sdev->autosuspend_delay = UFSHCD_AUTO_SUSPEND_DELAY_MS;
-	sdev->use_rpm_auto = 1;
+	/*
+	 * Request based runtime PM only works on the legacy request path,
+	 * blk-mq would let the device suspend with requests in flight.
+	 */
+	sdev->use_rpm_auto = !shost_use_blk_mq(sdev->host);
 
 	return 0;
 }
@@ -5681,6 +5819,11 @@ static void __ufshcd_transfer_req_compl(struct ufs_hba *hba,
 	/* clear corresponding bits of completed commands */
 	hba->outstanding_reqs ^= completed_reqs;
 
+	if (!hba->outstanding_reqs && !hba->idle_predict.is_idle) {
+		hba->idle_predict.idle_start = ktime_get();
+		hba->idle_predict.is_idle = true;
+	}
+
 	ufshcd_clk_scaling_update_busy(hba);
 
 	/* we might have free'd some tags above */
@@ -5721,6 +5864,75 @@ static irqreturn_t ufshcd_transfer_req_compl(struct ufs_hba *hba)
 	}
 }
 
+/**
+ * ufshcd_transfer_req_intr - handle the transfer request completion interrupt
+ * @hba: per adapter instance
+ *
+ * Completes the finished requests and, when the interrupt completed a burst
+ * with more requests still in flight, masks the completion interrupt and
+ * switches to polling the doorbell from ufshcd_iopoll().
+ *
+ * Returns
+ *  IRQ_HANDLED - If interrupt is valid
+ *  IRQ_NONE    - If invalid interrupt
+ */
+static irqreturn_t ufshcd_transfer_req_intr(struct ufs_hba *hba)
+{
+	unsigned long outstanding = hba->outstanding_reqs;
+	irqreturn_t retval;
+
+	retval = ufshcd_transfer_req_compl(hba);
+
+	if (!hba->iopoll_thresh || !hba->outstanding_reqs ||
+	    hweight_long(outstanding & ~hba->outstanding_reqs) <
+	    hba->iopoll_thresh)
+		return retval;
+
+	if (!blk_iopoll_sched_prep(&hba->iopoll)) {
+		ufshcd_disable_intr(hba, UTP_TRANSFER_REQ_COMPL);
+		/* keep the clocks on while polling, see ufshcd_iopoll() */
+		if (ufshcd_is_clkgating_allowed(hba))
+			hba->clk_gating.active_reqs++;
+		blk_iopoll_sched(&hba->iopoll);
+	}
+
+	return retval;
+}
+
+static int ufshcd_iopoll(struct blk_iopoll *iop, int budget)
+{
+	struct ufs_hba *hba = container_of(iop, struct ufs_hba, iopoll);
+	unsigned long completed_reqs;
+	unsigned long flags;
+	int done;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	completed_reqs = ufshcd_readl(hba, REG_UTP_TRANSFER_REQ_DOOR_BELL) ^
+			 hba->outstanding_reqs;
+	done = hweight_long(completed_reqs);
+	if (done)
+		__ufshcd_transfer_req_compl(hba, completed_reqs);
+
+	/* Keep polling only while the burst keeps completing requests */
+	if (done && hba->outstanding_reqs) {
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+		return budget;
+	}
+
+	blk_iopoll_complete(iop);
+	/*
+	 * Clear the stale completion status, then pick up whatever finished
+	 * before it was cleared; anything later raises the interrupt again.
+	 */
+	ufshcd_writel(hba, UTP_TRANSFER_REQ_COMPL, REG_INTERRUPT_STATUS);
+	ufshcd_transfer_req_compl(hba);
+	ufshcd_enable_intr(hba, UTP_TRANSFER_REQ_COMPL);
+	__ufshcd_release(hba, false);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return min(done, budget - 1);
+}
+
 /**
  * ufshcd_disable_ee - disable exception event
  * @hba: per-adapter instance
@@ -6572,7 +6784,7 @@ static irqreturn_t ufshcd_sl_intr(struct ufs_hba *hba, u32 intr_status)
 		retval |= ufshcd_tmc_handler(hba);
 
 	if (intr_status & UTP_TRANSFER_REQ_COMPL)
-		retval |= ufshcd_transfer_req_compl(hba);
+		retval |= ufshcd_transfer_req_intr(hba);
 
 	return retval;
 }
@@ -7630,6 +7842,8 @@ static int ufshcd_probe_hba(struct ufs_hba *hba)
 						ret);
 					goto out;
 				}
+				devfreq_register_boost_device(DEVFREQ_UFS,
+							      hba->devfreq);
 			}
 			hba->clk_scaling.is_allowed = true;
 		}
@@ -7994,6 +8208,9 @@ static struct scsi_host_template ufshcd_driver_template = {
 	.can_queue		= UFSHCD_CAN_QUEUE,
 	.max_host_blocked	= 1,
 	.track_queue_depth	= 1,
+#ifdef CONFIG_SCSI_UFSHCD_BLK_MQ
+	.force_blk_mq		= true,
+#endif
 };
 
 static int ufshcd_config_vreg_load(struct device *dev, struct ufs_vreg *vreg,
@@ -9395,10 +9612,89 @@ static void ufshcd_add_desc_sysfs_nodes(struct device *dev)
 			__func__, ret);
 }
 
+static ssize_t ufshcd_iopoll_thresh_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", hba->iopoll_thresh);
+}
+
+static ssize_t ufshcd_iopoll_thresh_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	unsigned int value;
+
+	if (kstrtouint(buf, 0, &value) || value > hba->nutrs)
+		return -EINVAL;
+
+	/* a pending poll finishes by itself once the doorbell is idle */
+	hba->iopoll_thresh = value;
+	return count;
+}
+
+static void ufshcd_add_iopoll_sysfs_nodes(struct ufs_hba *hba)
+{
+	hba->iopoll_thresh_attr.show = ufshcd_iopoll_thresh_show;
+	hba->iopoll_thresh_attr.store = ufshcd_iopoll_thresh_store;
+	sysfs_attr_init(&hba->iopoll_thresh_attr.attr);
+	hba->iopoll_thresh_attr.attr.name = "iopoll_thresh";
+	hba->iopoll_thresh_attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(hba->dev, &hba->iopoll_thresh_attr))
+		dev_err(hba->dev, "Failed to create sysfs for iopoll_thresh\n");
+}
+
+static ssize_t ufshcd_idle_predict_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_idle_predict *predict = &hba->idle_predict;
+
+	return snprintf(buf, PAGE_SIZE,
+			"enabled: %d\npredicted_idle_us: %lu\navoided_ungates: %lu\navoided_hibern8_exits: %lu\nmissed: %lu\n",
+			predict->is_enabled, predict->avg_us,
+			predict->avoided_ungates,
+			predict->avoided_hibern8_exits, predict->missed);
+}
+
+static ssize_t ufshcd_idle_predict_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	unsigned long flags;
+	u32 value;
+
+	if (kstrtou32(buf, 0, &value))
+		return -EINVAL;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	hba->idle_predict.is_enabled = !!value;
+	hba->idle_predict.avoided_ungates = 0;
+	hba->idle_predict.avoided_hibern8_exits = 0;
+	hba->idle_predict.missed = 0;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+static void ufshcd_add_idle_predict_sysfs_nodes(struct ufs_hba *hba)
+{
+	hba->idle_predict.attr.show = ufshcd_idle_predict_show;
+	hba->idle_predict.attr.store = ufshcd_idle_predict_store;
+	sysfs_attr_init(&hba->idle_predict.attr.attr);
+	hba->idle_predict.attr.attr.name = "idle_predict";
+	hba->idle_predict.attr.attr.mode = S_IRUGO | S_IWUSR;
+	if (device_create_file(hba->dev, &hba->idle_predict.attr))
+		dev_err(hba->dev, "Failed to create sysfs for idle_predict\n");
+}
+
 static inline void ufshcd_add_sysfs_nodes(struct ufs_hba *hba)
 {
 	ufshcd_add_rpm_lvl_sysfs_nodes(hba);
 	ufshcd_add_spm_lvl_sysfs_nodes(hba);
+	ufshcd_add_iopoll_sysfs_nodes(hba);
+	ufshcd_add_idle_predict_sysfs_nodes(hba);
 	ufshcd_add_desc_sysfs_nodes(hba->dev);
 }
 
@@ -9540,6 +9836,7 @@ ufshcd_exit_latency_hist(struct ufs_hba *hba)
 void ufshcd_remove(struct ufs_hba *hba)
 {
 	scsi_remove_host(hba->host);
+	blk_iopoll_disable(&hba->iopoll);
 	/* disable interrupts */
 	ufshcd_disable_intr(hba, hba->intr_mask);
 	ufshcd_hba_stop(hba, true);
@@ -10154,8 +10451,18 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 	/* Configure LRB */
 	ufshcd_host_memory_configure(hba);
 
+	blk_iopoll_init(&hba->iopoll, hba->nutrs, ufshcd_iopoll);
+	blk_iopoll_enable(&hba->iopoll);
+
 	host->can_queue = hba->nutrs;
 	host->cmd_per_lun = hba->nutrs;
+	/*
+	 * There is a single transfer request doorbell, so all CPUs share one
+	 * hardware queue and the tags map 1:1 to the doorbell slots.
+	 */
+	host->nr_hw_queues = 1;
+	/* a write storm must not take every doorbell slot from reads */
+	host->sync_read_tags = hba->nutrs / 4;
 	host->max_id = UFSHCD_MAX_ID;
 	host->max_lun = UFS_MAX_LUNS;
 	host->max_channel = UFSHCD_MAX_CHANNEL;
@@ -52,6 +52,7 @@
 #include <linux/types.h>
 #include <linux/wait.h>
 #include <linux/bitops.h>
+#include <linux/blk-iopoll.h>
 #include <linux/pm_runtime.h>
 #include <linux/clk.h>
 #include <linux/completion.h>
@@ -472,6 +473,33 @@ struct ufs_hibern8_on_idle {
 	bool is_enabled;
 };
 
+/**
+ * struct ufs_idle_predict - predicts idle periods to tune gating delays
+ * @idle_start: time the last transfer request completed
+ * @is_idle: no transfer requests in flight since @idle_start
+ * @avg_us: moving average of recent idle periods in us, 0 while unknown
+ * @gate_ext_ms: clock gating delay when extended for this idle period
+ * @hibern8_ext_ms: hibern8 enter delay when extended for this idle period
+ * @avoided_ungates: idle periods an extended gating delay kept clocks on for
+ * @avoided_hibern8_exits: idle periods an extended hibern8 delay covered
+ * @missed: extended delays that expired before the next request
+ * @is_enabled: extend the delays to the predicted idle period, off until
+ *	enabled through @attr
+ * @attr: sysfs attribute to enable/disable prediction and read statistics
+ */
+struct ufs_idle_predict {
+	ktime_t idle_start;
+	bool is_idle;
+	unsigned long avg_us;
+	unsigned long gate_ext_ms;
+	unsigned long hibern8_ext_ms;
+	unsigned long avoided_ungates;
+	unsigned long avoided_hibern8_exits;
+	unsigned long missed;
+	bool is_enabled;
+	struct device_attribute attr;
+};
+
 struct ufs_saved_pwr_info {
 	struct ufs_pa_layer_attr info;
 	bool is_valid;
@@ -548,6 +576,7 @@ struct debugfs_files {
 	struct dentry *dme_peer_read;
 	struct dentry *dbg_print_en;
 	struct dentry *req_stats;
+	struct dentry *req_lat_hist;
 	struct dentry *query_stats;
 	u32 dme_local_attr_id;
 	u32 dme_peer_attr_id;
@@ -589,6 +618,14 @@ struct ufshcd_req_stat {
 	u64 sum;
 	u64 count;
 };
+
+/*
+ * Request handling time histogram: bucket n counts times below 2^n usec,
+ * the last bucket also takes everything longer.
+ */
+#define UFSHCD_LAT_HIST_BUCKETS	24
+/* one row per general LUN, plus one shared by the well known LUNs */
+#define UFSHCD_LAT_HIST_LUNS	(UFS_UPIU_MAX_GENERAL_LUN + 1)
 #endif
 
 enum ufshcd_ctx {
@@ -615,6 +652,7 @@ struct ufshcd_clk_ctx {
  * @q_depth: current amount of busy slots
  * @err_stats: counters to keep track of various errors
  * @req_stats: request handling time statistics per request type
+ * @req_lat_hist: request handling time histograms per LUN and request type
  * @query_stats_arr: array that holds query statistics
  * @hibern8_exit_cnt: Counter to keep track of number of exits,
  *		reset this after link-startup.
@@ -633,6 +671,8 @@ struct ufs_stats {
 	int q_depth;
 	int err_stats[UFS_ERR_MAX];
 	struct ufshcd_req_stat req_stats[TS_NUM_STATS];
+	u32 req_lat_hist[UFSHCD_LAT_HIST_LUNS][TS_NUM_STATS]
+			[UFSHCD_LAT_HIST_BUCKETS];
 	int query_stats_arr[UPIU_QUERY_OPCODE_MAX][MAX_QUERY_IDN];
 
 #endif
@@ -782,6 +822,15 @@ struct ufs_hba {
 	unsigned long outstanding_tasks;
 	unsigned long outstanding_reqs;
 
+	/*
+	 * Transfer completions are polled instead of interrupt driven while
+	 * an interrupt completes at least iopoll_thresh requests and leaves
+	 * others in flight. 0 disables polling.
+	 */
+	struct blk_iopoll iopoll;
+	int iopoll_thresh;
+	struct device_attribute iopoll_thresh_attr;
+
 	u32 capabilities;
 	int nutrs;
 	int nutmrs;
@@ -905,6 +954,7 @@ struct ufs_hba {
 
 	struct ufs_clk_gating clk_gating;
 	struct ufs_hibern8_on_idle hibern8_on_idle;
+	struct ufs_idle_predict idle_predict;
 	struct ufshcd_cmd_log cmd_log;
 
 	/* Control to enable/disable host capabilities */
@@ -0,0 +1,513 @@
+/*
+ * Energy model calibration
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Energy model calibration.
+ *
+ * Each cluster is pinned to each of its OPPs in turn while the battery power
+ * is sampled with the cluster idle, with one CPU spinning and with two CPUs
+ * spinning. The difference between the two busy runs is the cost of a core
+ * and the remainder of the first busy run is the cost of the cluster. The
+ * spin loop rate gives the relative capacity of each OPP. The result is
+ * printed in the layout of the sched-energy-costs busy-cost-data properties.
+ *
+ * The device should be unplugged, with the display off and nothing else
+ * running, since all other activity shows up as measurement noise.
+ */
+
+#define pr_fmt(fmt) "em-calibrate: " fmt
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/power_supply.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+
+#define SAMPLE_PERIOD_MS	20
+#define SPIN_BATCH		1024
+
+struct em_opp {
+	unsigned int khz;
+	unsigned long loops_per_ms;
+	unsigned long cap;
+	unsigned long core_mw;
+	unsigned long cluster_mw;
+};
+
+struct em_cluster {
+	struct cpumask cpus;
+	unsigned int first_cpu;
+	unsigned int busy_cpu[2];
+	unsigned int nr_opps;
+	struct em_opp *opps;
+};
+
+struct em_spinner {
+	struct task_struct *task;
+	unsigned long loops;
+};
+
+static char *psy_name = "bms";
+module_param(psy_name, charp, 0644);
+
+static unsigned int settle_ms = 500;
+module_param(settle_ms, uint, 0644);
+
+static unsigned int sample_ms = 2000;
+module_param(sample_ms, uint, 0644);
+
+static DEFINE_MUTEX(em_lock);
+static struct em_cluster em_clusters[NR_CPUS];
+static unsigned int em_nr_clusters;
+static struct task_struct *em_thread;
+static bool em_running;
+static bool em_done;
+
+/* The frequency a cluster is pinned to, or 0 */
+static unsigned int pinned_khz[NR_CPUS];
+
+static int em_cpufreq_cb(struct notifier_block *nb, unsigned long val,
+			 void *data)
+{
+	struct cpufreq_policy *policy = data;
+	unsigned int khz = pinned_khz[policy->cpu];
+
+	if (val != CPUFREQ_ADJUST || !khz)
+		return NOTIFY_OK;
+
+	policy->min = policy->max = khz;
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block em_cpufreq_nb = {
+	.notifier_call = em_cpufreq_cb,
+	.priority = INT_MIN + 1,
+};
+
+static void em_pin(struct em_cluster *c, unsigned int khz)
+{
+	struct cpufreq_policy *policy;
+	unsigned int cpu;
+
+	policy = cpufreq_cpu_get(c->first_cpu);
+	if (!policy)
+		return;
+
+	for_each_cpu(cpu, policy->related_cpus)
+		pinned_khz[cpu] = khz;
+	cpufreq_cpu_put(policy);
+
+	cpufreq_update_policy(c->first_cpu);
+}
+
+static int em_spin(void *data)
+{
+	struct em_spinner *s = data;
+	unsigned long i;
+
+	while (!kthread_should_stop()) {
+		for (i = 0; i < SPIN_BATCH; i++)
+			cpu_relax();
+		WRITE_ONCE(s->loops, s->loops + 1);
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int em_read_mw(struct power_supply *psy, unsigned long *mw)
+{
+	union power_supply_propval ua, uv;
+	int ret;
+
+	ret = power_supply_get_property(psy, POWER_SUPPLY_PROP_CURRENT_NOW,
+					&ua);
+	if (ret)
+		return ret;
+
+	ret = power_supply_get_property(psy, POWER_SUPPLY_PROP_VOLTAGE_NOW,
+					&uv);
+	if (ret)
+		return ret;
+
+	*mw = div_u64((u64)abs(ua.intval) * abs(uv.intval), 1000000000);
+	return 0;
+}
+
+/* Average battery power over sample_ms, along with the spin loop rate */
+static int em_measure(struct power_supply *psy, struct em_spinner *s,
+		      int nr_spinners, unsigned long *mw,
+		      unsigned long *loops_per_ms)
+{
+	unsigned long start_loops = 0, end_loops = 0, sample, sum = 0;
+	unsigned int i, nr_samples = 0;
+	ktime_t start;
+	s64 elapsed_ms;
+	int ret;
+
+	msleep(settle_ms);
+
+	start = ktime_get();
+	for (i = 0; i < nr_spinners; i++)
+		start_loops += READ_ONCE(s[i].loops);
+
+	while (ktime_ms_delta(ktime_get(), start) < sample_ms) {
+		ret = em_read_mw(psy, &sample);
+		if (ret)
+			return ret;
+		sum += sample;
+		nr_samples++;
+		msleep(SAMPLE_PERIOD_MS);
+	}
+
+	for (i = 0; i < nr_spinners; i++)
+		end_loops += READ_ONCE(s[i].loops);
+	elapsed_ms = ktime_ms_delta(ktime_get(), start);
+
+	*mw = sum / max(nr_samples, 1U);
+	if (loops_per_ms && nr_spinners)
+		*loops_per_ms = div64_u64((u64)(end_loops - start_loops) *
+					  SPIN_BATCH, max_t(s64, elapsed_ms, 1) *
+					  nr_spinners);
+
+	return 0;
+}
+
+static int em_start_spinner(struct em_spinner *s, unsigned int cpu)
+{
+	s->loops = 0;
+	s->task = kthread_create(em_spin, s, "em_spin/%u", cpu);
+	if (IS_ERR(s->task))
+		return PTR_ERR(s->task);
+
+	kthread_bind(s->task, cpu);
+	set_user_nice(s->task, MIN_NICE);
+	wake_up_process(s->task);
+
+	return 0;
+}
+
+static int em_calibrate_opp(struct power_supply *psy, struct em_cluster *c,
+			    struct em_opp *opp)
+{
+	unsigned long idle_mw, one_mw, two_mw = 0, core_mw;
+	struct em_spinner s[2] = { };
+	bool two = c->busy_cpu[1] < nr_cpu_ids;
+	int ret;
+
+	em_pin(c, opp->khz);
+
+	ret = em_measure(psy, NULL, 0, &idle_mw, NULL);
+	if (ret)
+		return ret;
+
+	ret = em_start_spinner(&s[0], c->busy_cpu[0]);
+	if (ret)
+		return ret;
+
+	ret = em_measure(psy, s, 1, &one_mw, &opp->loops_per_ms);
+	if (ret || !two)
+		goto stop;
+
+	ret = em_start_spinner(&s[1], c->busy_cpu[1]);
+	if (ret)
+		goto stop;
+
+	ret = em_measure(psy, s, 2, &two_mw, NULL);
+	kthread_stop(s[1].task);
+stop:
+	kthread_stop(s[0].task);
+	if (ret)
+		return ret;
+
+	/* Without a second CPU, the cluster gets the whole busy cost */
+	one_mw = max(one_mw, idle_mw) - idle_mw;
+	core_mw = two ? max(two_mw, idle_mw + one_mw) - idle_mw - one_mw : 0;
+	opp->core_mw = core_mw;
+	opp->cluster_mw = max(one_mw, core_mw) - core_mw;
+
+	pr_info("cpu%u %u kHz: %lu loops/ms, core %lu mW, cluster %lu mW\n",
+		c->first_cpu, opp->khz, opp->loops_per_ms, opp->core_mw,
+		opp->cluster_mw);
+
+	return 0;
+}
+
+static int em_setup_cluster(struct em_cluster *c, unsigned int cpu)
+{
+	struct cpufreq_frequency_table *pos, *table;
+	struct cpufreq_policy *policy;
+	unsigned int i, n = 0, busy = 0;
+
+	policy = cpufreq_cpu_get(cpu);
+	if (!policy)
+		return -ENODEV;
+
+	cpumask_copy(&c->cpus, policy->related_cpus);
+	c->first_cpu = cpumask_first(&c->cpus);
+	c->busy_cpu[0] = c->busy_cpu[1] = nr_cpu_ids;
+	for_each_cpu_and(i, policy->related_cpus, cpu_online_mask) {
+		c->busy_cpu[busy++] = i;
+		if (busy == ARRAY_SIZE(c->busy_cpu))
+			break;
+	}
+	cpufreq_cpu_put(policy);
+
+	table = cpufreq_frequency_get_table(c->first_cpu);
+	if (!table || !busy)
+		return -ENODEV;
+
+	cpufreq_for_each_valid_entry(pos, table)
+		n++;
+
+	c->opps = kcalloc(n, sizeof(*c->opps), GFP_KERNEL);
+	if (!c->opps)
+		return -ENOMEM;
+
+	/* Keep the OPPs in ascending order, as the energy model wants them */
+	cpufreq_for_each_valid_entry(pos, table) {
+		for (i = c->nr_opps; i && c->opps[i - 1].khz > pos->frequency;
+		     i--)
+			c->opps[i] = c->opps[i - 1];
+		c->opps[i].khz = pos->frequency;
+		c->nr_opps++;
+	}
+
+	return 0;
+}
+
+static void em_free_clusters(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < em_nr_clusters; i++)
+		kfree(em_clusters[i].opps);
+	memset(em_clusters, 0, sizeof(em_clusters));
+	em_nr_clusters = 0;
+}
+
+static int em_calibrate_thread(void *data)
+{
+	struct power_supply *psy;
+	unsigned long max_loops = 0;
+	unsigned int cpu, i, j;
+	int ret = 0;
+
+	psy = power_supply_get_by_name(psy_name);
+	if (!psy) {
+		pr_err("Power supply %s not found\n", psy_name);
+		ret = -ENODEV;
+		goto out;
+	}
+
+	mutex_lock(&em_lock);
+	em_free_clusters();
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		bool seen = false;
+
+		for (i = 0; i < em_nr_clusters; i++)
+			if (cpumask_test_cpu(cpu, &em_clusters[i].cpus))
+				seen = true;
+		if (seen)
+			continue;
+
+		ret = em_setup_cluster(&em_clusters[em_nr_clusters], cpu);
+		if (ret)
+			break;
+		em_nr_clusters++;
+	}
+	put_online_cpus();
+	mutex_unlock(&em_lock);
+	if (ret)
+		goto put_psy;
+
+	for (i = 0; i < em_nr_clusters && !ret; i++) {
+		struct em_cluster *c = &em_clusters[i];
+
+		for (j = 0; j < c->nr_opps && !ret; j++) {
+			if (kthread_should_stop())
+				ret = -EINTR;
+			else
+				ret = em_calibrate_opp(psy, c, &c->opps[j]);
+			max_loops = max(max_loops, c->opps[j].loops_per_ms);
+		}
+		em_pin(c, 0);
+	}
+
+	/* Capacities are relative to the fastest OPP in the system */
+	mutex_lock(&em_lock);
+	for (i = 0; i < em_nr_clusters && max_loops; i++)
+		for (j = 0; j < em_clusters[i].nr_opps; j++) {
+			struct em_opp *opp = &em_clusters[i].opps[j];
+
+			opp->cap = opp->loops_per_ms * SCHED_CAPACITY_SCALE /
+				   max_loops;
+		}
+	em_done = !ret;
+	mutex_unlock(&em_lock);
+
+put_psy:
+	power_supply_put(psy);
+out:
+	if (ret)
+		pr_err("Calibration failed, err: %d\n", ret);
+	else
+		pr_info("Calibration done\n");
+
+	mutex_lock(&em_lock);
+	em_running = false;
+	mutex_unlock(&em_lock);
+
+	return ret;
+}
+
+/* Writing 1 (re)starts a calibration, 0 aborts the one in progress */
+static int em_run_set(void *data, u64 val)
+{
+	static DEFINE_MUTEX(run_lock);
+	struct task_struct *task;
+
+	mutex_lock(&run_lock);
+
+	/* The reference taken at creation keeps an exited thread stoppable */
+	task = em_thread;
+	if (task) {
+		kthread_stop(task);
+		put_task_struct(task);
+		em_thread = NULL;
+	}
+
+	if (val) {
+		mutex_lock(&em_lock);
+		em_done = false;
+		em_running = true;
+		mutex_unlock(&em_lock);
+
+		task = kthread_create(em_calibrate_thread, NULL,
+				      "em_calibrate");
+		if (IS_ERR(task)) {
+			mutex_lock(&em_lock);
+			em_running = false;
+			mutex_unlock(&em_lock);
+			mutex_unlock(&run_lock);
+			return PTR_ERR(task);
+		}
+		get_task_struct(task);
+		em_thread = task;
+		wake_up_process(task);
+	}
+
+	mutex_unlock(&run_lock);
+
+	return 0;
+}
+
+static int em_run_get(void *data, u64 *val)
+{
+	mutex_lock(&em_lock);
+	*val = em_running;
+	mutex_unlock(&em_lock);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(em_run_fops, em_run_get, em_run_set, "%llu\n");
+
+static void em_show_costs(struct seq_file *m, struct em_cluster *c,
+			  bool cluster)
+{
+	unsigned int i;
+
+	seq_puts(m, "\t\tbusy-cost-data = <\n");
+	for (i = 0; i < c->nr_opps; i++)
+		seq_printf(m, "\t\t\t%4lu %5lu\t/* %u kHz */\n",
+			   c->opps[i].cap, cluster ? c->opps[i].cluster_mw :
+			   c->opps[i].core_mw, c->opps[i].khz);
+	seq_puts(m, "\t\t>;\n");
+}
+
+static int em_result_show(struct seq_file *m, void *unused)
+{
+	unsigned int i;
+
+	mutex_lock(&em_lock);
+	if (!em_done) {
+		mutex_unlock(&em_lock);
+		seq_puts(m, "No calibration result\n");
+		return 0;
+	}
+
+	for (i = 0; i < em_nr_clusters; i++) {
+		struct em_cluster *c = &em_clusters[i];
+
+		seq_printf(m, "\tCPU_COST_%u: core-cost%u {\n", i, i);
+		em_show_costs(m, c, false);
+		seq_puts(m, "\t};\n");
+		seq_printf(m, "\tCLUSTER_COST_%u: cluster-cost%u {\n", i, i);
+		em_show_costs(m, c, true);
+		seq_puts(m, "\t};\n");
+	}
+	mutex_unlock(&em_lock);
+
+	return 0;
+}
+
+static int em_result_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, em_result_show, NULL);
+}
+
+static const struct file_operations em_result_fops = {
+	.open = em_result_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init em_calibrate_init(void)
+{
+	struct dentry *dir;
+	int ret;
+
+	dir = debugfs_create_dir("em_calibrate", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return -ENOMEM;
+
+	if (!debugfs_create_file("run", 0600, dir, NULL, &em_run_fops) ||
+	    !debugfs_create_file("result", 0400, dir, NULL,
+				 &em_result_fops)) {
+		ret = -ENOMEM;
+		goto remove_dir;
+	}
+
+	ret = cpufreq_register_notifier(&em_cpufreq_nb,
+					CPUFREQ_POLICY_NOTIFIER);
+	if (ret)
+		goto remove_dir;
+
+	return 0;
+
+remove_dir:
+	debugfs_remove_recursive(dir);
+	return ret;
+}
+late_initcall(em_calibrate_init);
@@ -2302,6 +2302,16 @@ static int dummy_tx_cmd_tracer_pkt(struct glink_transport_if *if_ptr,
 	return 0;
 }
 
+/**
+ * dummy_tx_coalesce() - a dummy tx coalescing control for transports that
+ *			 signal every packet
+ * @if_ptr:	The transport interface handle for this transport.
+ * @enable:	Whether the core is starting or ending a batch.
+ */
+static void dummy_tx_coalesce(struct glink_transport_if *if_ptr, bool enable)
+{
+}
+
 /**
  * dummy_deallocate_rx_intent() - a dummy rx intent deallocation function that
  *				does not deallocate anything
@@ -4092,6 +4102,8 @@ int glink_core_register_transport(struct glink_transport_if *if_ptr,
 		if_ptr->rx_rt_vote = dummy_rx_rt_vote;
 	if (!if_ptr->rx_rt_unvote)
 		if_ptr->rx_rt_unvote = dummy_rx_rt_unvote;
+	if (!if_ptr->tx_coalesce)
+		if_ptr->tx_coalesce = dummy_tx_coalesce;
 	xprt_ptr->capabilities = 0;
 	xprt_ptr->ops = if_ptr;
 	spin_lock_init(&xprt_ptr->xprt_ctx_lock_lhb1);
@@ -4270,6 +4282,7 @@ static struct glink_core_xprt_ctx *glink_create_dummy_xprt_ctx(
 	if_ptr->get_power_vote_ramp_time = dummy_get_power_vote_ramp_time;
 	if_ptr->power_vote = dummy_power_vote;
 	if_ptr->power_unvote = dummy_power_unvote;
+	if_ptr->tx_coalesce = dummy_tx_coalesce;
 
 	xprt_ptr->ops = if_ptr;
 	xprt_ptr->log_ctx = log_ctx;
@@ -5678,6 +5691,8 @@ static void tx_func(struct kthread_work *work)
 
 	GLINK_PERF("%s: worker starting\n", __func__);
 
+	/* let the transport signal the remote once for the whole batch */
+	xprt_ptr->ops->tx_coalesce(xprt_ptr->ops, true);
 	while (1) {
 		prio = xprt_ptr->num_priority - 1;
 		spin_lock_irqsave(&xprt_ptr->tx_ready_lock_lhb3, flags);
@@ -5685,6 +5700,8 @@ static void tx_func(struct kthread_work *work)
 			if (prio == 0) {
 				spin_unlock_irqrestore(
 					&xprt_ptr->tx_ready_lock_lhb3, flags);
+				xprt_ptr->ops->tx_coalesce(xprt_ptr->ops,
+							   false);
 				return;
 			}
 			prio--;
@@ -5760,6 +5777,7 @@ static void tx_func(struct kthread_work *work)
 		transmitted_successfully = true;
 		rwref_put(&ch_ptr->ch_state_lhb2);
 	}
+	xprt_ptr->ops->tx_coalesce(xprt_ptr->ops, false);
 	glink_pm_qos_unvote(xprt_ptr);
 	GLINK_PERF("%s: worker exiting\n", __func__);
 }
@@ -53,6 +53,7 @@
 #define RPM_FIFO_ADDR_ALIGN_BYTES 3
 #define TRACER_PKT_FEATURE BIT(2)
 #define DEFERRED_CMDS_THRESHOLD 25
+#define TX_COALESCE_MAX_PKTS 8
 /**
  * enum command_types - definition of the types of commands sent/received
  * @VERSION_CMD:		Version and feature set supported
@@ -169,6 +170,12 @@ struct mailbox_config_info {
  * @tx_blocked_signal_sent:	Flag to indicate the flush signal has already
  *				been sent, and a response is pending from the
  *				remote side.  Protected by @write_lock.
+ * @tx_coalesce:		Data packets written to @tx_fifo only raise an
+ *				irq every TX_COALESCE_MAX_PKTS packets, or when
+ *				coalescing is turned off.  Protected by
+ *				@write_lock.
+ * @tx_coalesced:		Number of packets written to @tx_fifo since the
+ *				last irq.  Protected by @write_lock.
  * @kwork:			Work to be executed when an irq is received.
  * @kworker:			Handle to the entity processing of
 				deferred commands.
@@ -212,6 +219,8 @@ struct edge_info {
 	wait_queue_head_t tx_blocked_queue;
 	bool tx_resume_needed;
 	bool tx_blocked_signal_sent;
+	bool tx_coalesce;
+	uint32_t tx_coalesced;
 	struct kthread_work kwork;
 	struct kthread_worker kworker;
 	struct task_struct *task;
@@ -276,6 +285,25 @@ static void send_irq(struct edge_info *einfo)
 	einfo->tx_irq_count++;
 }
 
+/**
+ * tx_kick() - signal the remote that new data is in the tx fifo
+ * @einfo:	The concerned edge.
+ * @pkt:	True if a single data packet has just been written.
+ *
+ * Data packets are batched while the core has coalescing turned on, one irq
+ * covering every packet written since the previous one.  Must be called with
+ * @einfo->write_lock held.
+ */
+static void tx_kick(struct edge_info *einfo, bool pkt)
+{
+	if (pkt && einfo->tx_coalesce &&
+	    ++einfo->tx_coalesced < TX_COALESCE_MAX_PKTS)
+		return;
+
+	einfo->tx_coalesced = 0;
+	send_irq(einfo);
+}
+
 /**
  * read_from_fifo() - memcpy from fifo memory
  * @dest:	Destination address.
@@ -552,7 +580,7 @@ static int fifo_write(struct edge_info *einfo, const void *data, int len)
 	 */
 	wmb();
 	einfo->tx_ch_desc->write_index = write_index;
-	send_irq(einfo);
+	tx_kick(einfo, false);
 
 	return orig_len - len;
 }
@@ -593,7 +621,7 @@ static int fifo_write_complex(struct edge_info *einfo,
 	 */
 	wmb();
 	einfo->tx_ch_desc->write_index = write_index;
-	send_irq(einfo);
+	tx_kick(einfo, true);
 
 	return orig_len - len1 - len2 - len3;
 }
@@ -1546,6 +1574,7 @@ static int ssr(struct glink_transport_if *if_ptr)
 
 	einfo->tx_resume_needed = false;
 	einfo->tx_blocked_signal_sent = false;
+	einfo->tx_coalesced = 0;
 	einfo->rx_fifo = NULL;
 	einfo->rx_fifo_size = 0;
 	einfo->tx_ch_desc->write_index = 0;
@@ -2062,6 +2091,28 @@ static int tx(struct glink_transport_if *if_ptr, uint32_t lcid,
 	return tx_data(if_ptr, TX_DATA_CMD, lcid, pctx);
 }
 
+/**
+ * tx_coalesce() - batch the irqs of data packets
+ * @if_ptr:	The transport to transmit on.
+ * @enable:	True when the core starts draining its tx queues, false once
+ *		it is done.
+ *
+ * Turning coalescing off signals the remote for any packet still unannounced.
+ */
+static void tx_coalesce(struct glink_transport_if *if_ptr, bool enable)
+{
+	struct edge_info *einfo;
+	unsigned long flags;
+
+	einfo = container_of(if_ptr, struct edge_info, xprt_if);
+
+	spin_lock_irqsave(&einfo->write_lock, flags);
+	einfo->tx_coalesce = enable;
+	if (!enable && einfo->tx_coalesced)
+		tx_kick(einfo, false);
+	spin_unlock_irqrestore(&einfo->write_lock, flags);
+}
+
 /**
  * tx_cmd_tracer_pkt() - convert a tracer packet cmd to wire format and transmit
  * @if_ptr:	The transport to transmit on.
@@ -2202,6 +2253,7 @@ static void init_xprt_if(struct edge_info *einfo)
 	einfo->xprt_if.tx_cmd_local_rx_intent = tx_cmd_local_rx_intent;
 	einfo->xprt_if.tx_cmd_local_rx_done = tx_cmd_local_rx_done;
 	einfo->xprt_if.tx = tx;
+	einfo->xprt_if.tx_coalesce = tx_coalesce;
 	einfo->xprt_if.tx_cmd_rx_intent_req = tx_cmd_rx_intent_req;
 	einfo->xprt_if.tx_cmd_remote_rx_intent_req_ack =
 						tx_cmd_remote_rx_intent_req_ack;
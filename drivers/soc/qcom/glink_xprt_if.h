@@ -144,6 +144,7 @@ struct glink_transport_if {
 	int (*power_unvote)(struct glink_transport_if *if_ptr);
 	int (*rx_rt_vote)(struct glink_transport_if *if_ptr);
 	int (*rx_rt_unvote)(struct glink_transport_if *if_ptr);
+	void (*tx_coalesce)(struct glink_transport_if *if_ptr, bool enable);
 	/*
 	 * Keep data pointers at the end of the structure after all function
 	 * pointer to allow for in-place initialization.
@@ -4819,6 +4819,9 @@ static int icnss_probe(struct platform_device *pdev)
 		icnss_pr_err("Failed to init platform device wakeup source, err = %d\n",
 			     ret);
 
+	/* Nothing else waits on WLAN, let it resume in parallel */
+	device_enable_async_suspend(&priv->pdev->dev);
+
 	penv = priv;
 
 	init_completion(&priv->unblock_shutdown);
@@ -18,6 +18,15 @@
 #include <linux/kobject.h>
 #include <linux/spinlock.h>
 #include <linux/slab.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/kernel_stat.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/sort.h>
+#include <linux/topology.h>
+#include <linux/workqueue.h>
 #include <soc/qcom/irq-helper.h>
 
 struct irq_helper {
@@ -139,6 +148,195 @@ int irq_blacklist_off(void)
 }
 EXPORT_SYMBOL(irq_blacklist_off);
 
+/*
+ * IRQ balancer
+ *
+ * Every balance_ms milliseconds the interrupts that fired more than
+ * min_rate times per second are spread over the online CPUs, heaviest
+ * first, each onto the CPU whose interrupt load relative to its capacity
+ * is lowest. An interrupt stays where it is unless moving it makes a
+ * clear difference. Per-CPU and IRQF_NOBALANCING interrupts, those
+ * listed in pinned_irqs, and those with an affinity hint, a managed
+ * affinity or an affinity set by anyone but the balancer are never moved.
+ * Nothing is done while the blacklist is deployed, as user space then owns
+ * the affinities.
+ */
+#define IRQ_BALANCE_MAX		64
+
+struct irq_rate {
+	unsigned int irq;
+	unsigned int rate;
+};
+
+/* @cpu is where the balancer last put the interrupt, -1 if never */
+struct irq_sample {
+	unsigned int count;
+	int cpu;
+};
+
+static unsigned int balance_ms;
+static unsigned int min_rate = 100;
+module_param(min_rate, uint, 0644);
+static int pinned_irqs[16];
+static int nr_pinned_irqs;
+module_param_array(pinned_irqs, int, &nr_pinned_irqs, 0644);
+
+static void irq_balance_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(irq_balance_work, irq_balance_work_fn);
+
+static struct irq_sample *irq_samples;
+static unsigned int irq_nr_samples;
+static unsigned long irq_last_balance;
+
+static bool irq_is_pinned(unsigned int irq)
+{
+	int i;
+
+	for (i = 0; i < nr_pinned_irqs; i++)
+		if (pinned_irqs[i] == irq)
+			return true;
+	return false;
+}
+
+static bool irq_affinity_is_claimed(struct irq_desc *desc, int cpu)
+{
+	struct irq_data *data = irq_desc_get_irq_data(desc);
+
+	if (desc->affinity_hint || irqd_affinity_is_managed(data))
+		return true;
+	if (!irqd_affinity_was_set(data))
+		return false;
+	/* set through /proc or by a driver since the balancer last moved it */
+	return cpu < 0 ||
+	       !cpumask_equal(irq_data_get_affinity_mask(data), cpumask_of(cpu));
+}
+
+static int irq_rate_cmp(const void *a, const void *b)
+{
+	const struct irq_rate *ra = a, *rb = b;
+
+	if (ra->rate == rb->rate)
+		return 0;
+	return ra->rate < rb->rate ? 1 : -1;
+}
+
+static unsigned long irq_cpu_cost(unsigned long load, int cpu)
+{
+	return load * SCHED_CAPACITY_SCALE /
+		max_t(unsigned long, arch_scale_cpu_capacity(NULL, cpu), 1);
+}
+
+static void irq_balance(void)
+{
+	static struct irq_rate rates[IRQ_BALANCE_MAX];
+	static unsigned long load[NR_CPUS];
+	unsigned long elapsed = jiffies - irq_last_balance;
+	struct irq_desc *desc;
+	unsigned int irq, nr = 0;
+	int i, cpu;
+
+	get_online_cpus();
+	irq_lock_sparse();
+
+	if (irq_nr_samples < nr_irqs) {
+		struct irq_sample *samples;
+
+		samples = krealloc(irq_samples, nr_irqs * sizeof(*samples),
+				   GFP_KERNEL);
+		if (!samples)
+			goto out;
+		for (irq = irq_nr_samples; irq < nr_irqs; irq++) {
+			samples[irq].count = 0;
+			samples[irq].cpu = -1;
+		}
+		irq_samples = samples;
+		irq_nr_samples = nr_irqs;
+		/* no baseline yet, only sample the counts this time */
+		elapsed = 0;
+	}
+
+	for_each_irq_desc(irq, desc) {
+		unsigned int count = kstat_irqs(irq);
+		unsigned int delta = count - irq_samples[irq].count;
+
+		irq_samples[irq].count = count;
+		if (!desc->action || irq_balancing_disabled(irq) ||
+		    irq_is_pinned(irq) ||
+		    irq_affinity_is_claimed(desc, irq_samples[irq].cpu) ||
+		    !elapsed || nr >= IRQ_BALANCE_MAX)
+			continue;
+
+		rates[nr].irq = irq;
+		rates[nr].rate = div_u64((u64)delta * HZ, elapsed);
+		if (rates[nr].rate >= min_rate)
+			nr++;
+	}
+	irq_last_balance = jiffies;
+
+	sort(rates, nr, sizeof(*rates), irq_rate_cmp, NULL);
+	memset(load, 0, sizeof(load));
+
+	for (i = 0; i < nr; i++) {
+		struct irq_data *data = irq_get_irq_data(rates[i].irq);
+		unsigned long cost, best_cost = ULONG_MAX;
+		int cur, best = -1;
+
+		if (!data)
+			continue;
+
+		cur = cpumask_first_and(irq_data_get_affinity_mask(data),
+					cpu_online_mask);
+		for_each_online_cpu(cpu) {
+			cost = irq_cpu_cost(load[cpu] + rates[i].rate, cpu);
+			/* only move for a gain of more than a quarter */
+			if (cpu == cur)
+				cost -= cost / 4;
+			if (cost < best_cost) {
+				best_cost = cost;
+				best = cpu;
+			}
+		}
+		if (best < 0)
+			break;
+
+		load[best] += rates[i].rate;
+		if (best != cur &&
+		    !irq_set_affinity(rates[i].irq, cpumask_of(best)))
+			irq_samples[rates[i].irq].cpu = best;
+	}
+out:
+	irq_unlock_sparse();
+	put_online_cpus();
+}
+
+static void irq_balance_work_fn(struct work_struct *work)
+{
+	unsigned int period = READ_ONCE(balance_ms);
+
+	if (!period)
+		return;
+
+	if (!READ_ONCE(irq_h->deploy))
+		irq_balance();
+
+	schedule_delayed_work(&irq_balance_work, msecs_to_jiffies(period));
+}
+
+static int balance_ms_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret && balance_ms && irq_h)
+		mod_delayed_work(system_wq, &irq_balance_work, 0);
+	return ret;
+}
+
+static const struct kernel_param_ops balance_ms_ops = {
+	.set = balance_ms_set,
+	.get = param_get_uint,
+};
+module_param_cb(balance_ms, &balance_ms_ops, &balance_ms, 0644);
+
 static int __init irq_helper_init(void)
 {
 	int ret;
@@ -164,6 +362,8 @@ static int __init irq_helper_init(void)
 	spin_lock_init(&irq_h->lock);
 	irq_h->count = 0;
 	irq_h->enable = true;
+	if (balance_ms)
+		schedule_delayed_work(&irq_balance_work, 0);
 	return 0;
 out_put_kobj:
 	kobject_put(&irq_h->kobj);
@@ -175,6 +375,9 @@ module_init(irq_helper_init);
 
 static void __exit irq_helper_exit(void)
 {
+	balance_ms = 0;
+	cancel_delayed_work_sync(&irq_balance_work);
+	kfree(irq_samples);
 	sysfs_remove_file(&irq_h->kobj, &irq_helper_irq_blacklist_on.attr);
 	kobject_del(&irq_h->kobj);
 	kobject_put(&irq_h->kobj);
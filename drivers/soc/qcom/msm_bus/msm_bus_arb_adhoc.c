@@ -688,6 +688,29 @@ static void add_node_to_clist(struct msm_bus_node_device_type *node)
 	}
 }
 
+/*
+ * A hop whose aggregate did not move has nothing to send and nothing new to
+ * feed into its fabric's clock, so it is only committed when one of them
+ * changed. Fabric nodes have their clock recomputed on every commit and
+ * nodes with deferred QoS still need their first commit to program it, so
+ * those are always committed.
+ */
+static bool node_agg_changed(struct msm_bus_node_device_type *node,
+			     uint64_t *clk_hz, uint64_t *sum_ab)
+{
+	int i;
+
+	if (node->node_info->is_fab_dev || node->node_info->defer_qos)
+		return true;
+
+	for (i = 0; i < NUM_CTX; i++)
+		if (node->node_bw[i].cur_clk_hz != clk_hz[i] ||
+		    node->node_bw[i].sum_ab != sum_ab[i])
+			return true;
+
+	return false;
+}
+
 static int update_path(struct device *src_dev, int dest, uint64_t act_req_ib,
 			uint64_t act_req_bw, uint64_t slp_req_ib,
 			uint64_t slp_req_bw, uint64_t cur_ib, uint64_t cur_bw,
@@ -700,6 +723,7 @@ static int update_path(struct device *src_dev, int dest, uint64_t act_req_ib,
 	int ret = 0;
 	struct rule_update_path_info *rule_node;
 	bool rules_registered = msm_rule_are_rules_registered();
+	uint64_t old_clk_hz[NUM_CTX], old_sum_ab[NUM_CTX];
 
 	if (IS_ERR_OR_NULL(src_dev)) {
 		MSM_BUS_ERR("%s: No source device", __func__);
@@ -734,14 +758,27 @@ static int update_path(struct device *src_dev, int dest, uint64_t act_req_ib,
 			ret = -ENXIO;
 			goto exit_update_path;
 		}
+		/* This client's vote on the hop is unchanged */
+		if (lnode->lnode_ib[ACTIVE_CTX] == act_req_ib &&
+		    lnode->lnode_ab[ACTIVE_CTX] == act_req_bw &&
+		    lnode->lnode_ib[DUAL_CTX] == slp_req_ib &&
+		    lnode->lnode_ab[DUAL_CTX] == slp_req_bw)
+			goto next_hop;
+
 		lnode->lnode_ib[ACTIVE_CTX] = act_req_ib;
 		lnode->lnode_ab[ACTIVE_CTX] = act_req_bw;
 		lnode->lnode_ib[DUAL_CTX] = slp_req_ib;
 		lnode->lnode_ab[DUAL_CTX] = slp_req_bw;
 
-		for (i = 0; i < NUM_CTX; i++)
+		for (i = 0; i < NUM_CTX; i++) {
+			old_clk_hz[i] = dev_info->node_bw[i].cur_clk_hz;
+			old_sum_ab[i] = dev_info->node_bw[i].sum_ab;
 			dev_info->node_bw[i].cur_clk_hz =
 					aggregate_bus_req(dev_info, i);
+		}
+
+		if (!node_agg_changed(dev_info, old_clk_hz, old_sum_ab))
+			goto next_hop;
 
 		add_node_to_clist(dev_info);
 
@@ -758,6 +795,7 @@ static int update_path(struct device *src_dev, int dest, uint64_t act_req_ib,
 			}
 		}
 
+next_hop:
 		next_dev = lnode->next_dev;
 		curr_idx = lnode->next;
 	}
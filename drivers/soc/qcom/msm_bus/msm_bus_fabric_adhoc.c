@@ -220,10 +220,70 @@ static int setrate_nodeclk(struct nodeclk *nclk, long rate)
 	return ret;
 }
 
-static int send_rpm_msg(struct msm_bus_node_device_type *ndev, int ctx)
+/*
+ * Bandwidth votes of a commit are written to the RPM back to back and their
+ * acks are collected once the whole commit has been sent, rather than
+ * waiting a full round trip for every node. The number of votes in flight
+ * is bounded to keep the RPM channel from filling up.
+ */
+#define MAX_PENDING_RPM_MSGS	16
+
+struct rpm_msg_batch {
+	int count;
+	int error;
+	struct {
+		int msg_id;
+		int node_id;
+		int rpm_id;
+	} msgs[MAX_PENDING_RPM_MSGS];
+};
+
+static void wait_rpm_msgs(struct rpm_msg_batch *batch)
+{
+	int i, rc;
+
+	for (i = 0; i < batch->count; i++) {
+		rc = msm_rpm_wait_for_ack(batch->msgs[i].msg_id);
+		if (rc) {
+			MSM_BUS_ERR("%s: RPM ack failed for Node Id %d RPM id %d",
+				__func__, batch->msgs[i].node_id,
+				batch->msgs[i].rpm_id);
+			batch->error = rc;
+		}
+	}
+	batch->count = 0;
+}
+
+static int queue_rpm_msg(struct rpm_msg_batch *batch, int rpm_ctx,
+			int rsc_type, int node_id, int rpm_id,
+			struct msm_rpm_kvp *rpm_kvp)
+{
+	int msg_id;
+
+	if (batch->count == MAX_PENDING_RPM_MSGS)
+		wait_rpm_msgs(batch);
+
+	msg_id = msm_rpm_send_message_nowait(rpm_ctx, rsc_type, rpm_id,
+					     rpm_kvp, 1);
+	if (msg_id < 0) {
+		MSM_BUS_ERR("%s: Failed to send RPM message:", __func__);
+		MSM_BUS_ERR("%s: Node Id %d RPM id %d",
+			__func__, node_id, rpm_id);
+		return msg_id;
+	}
+
+	batch->msgs[batch->count].msg_id = msg_id;
+	batch->msgs[batch->count].node_id = node_id;
+	batch->msgs[batch->count].rpm_id = rpm_id;
+	batch->count++;
+
+	return 0;
+}
+
+static int send_rpm_msg(struct msm_bus_node_device_type *ndev, int ctx,
+			struct rpm_msg_batch *batch)
 {
 	int ret = 0;
-	int rsc_type;
 	struct msm_rpm_kvp rpm_kvp;
 	int rpm_ctx;
 
@@ -244,34 +304,22 @@ static int send_rpm_msg(struct msm_bus_node_device_type *ndev, int ctx)
 	rpm_kvp.data = (uint8_t *)&ndev->node_bw[ctx].sum_ab;
 
 	if (ndev->node_info->mas_rpm_id != -1) {
-		rsc_type = RPM_BUS_MASTER_REQ;
-		ret = msm_rpm_send_message(rpm_ctx, rsc_type,
-			ndev->node_info->mas_rpm_id, &rpm_kvp, 1);
-		if (ret) {
-			MSM_BUS_ERR("%s: Failed to send RPM message:",
-					__func__);
-			MSM_BUS_ERR("%s:Node Id %d RPM id %d",
-			__func__, ndev->node_info->id,
-				 ndev->node_info->mas_rpm_id);
+		ret = queue_rpm_msg(batch, rpm_ctx, RPM_BUS_MASTER_REQ,
+			ndev->node_info->id, ndev->node_info->mas_rpm_id,
+			&rpm_kvp);
+		if (ret)
 			goto exit_send_rpm_msg;
-		}
 		trace_bus_agg_bw(ndev->node_info->id,
 			ndev->node_info->mas_rpm_id, rpm_ctx,
 			ndev->node_bw[ctx].sum_ab);
 	}
 
 	if (ndev->node_info->slv_rpm_id != -1) {
-		rsc_type = RPM_BUS_SLAVE_REQ;
-		ret = msm_rpm_send_message(rpm_ctx, rsc_type,
-			ndev->node_info->slv_rpm_id, &rpm_kvp, 1);
-		if (ret) {
-			MSM_BUS_ERR("%s: Failed to send RPM message:",
-						__func__);
-			MSM_BUS_ERR("%s: Node Id %d RPM id %d",
-			__func__, ndev->node_info->id,
-				ndev->node_info->slv_rpm_id);
+		ret = queue_rpm_msg(batch, rpm_ctx, RPM_BUS_SLAVE_REQ,
+			ndev->node_info->id, ndev->node_info->slv_rpm_id,
+			&rpm_kvp);
+		if (ret)
 			goto exit_send_rpm_msg;
-		}
 		trace_bus_agg_bw(ndev->node_info->id,
 			ndev->node_info->slv_rpm_id, rpm_ctx,
 			ndev->node_bw[ctx].sum_ab);
@@ -280,7 +328,8 @@ exit_send_rpm_msg:
 	return ret;
 }
 
-static int flush_bw_data(struct msm_bus_node_device_type *node_info, int ctx)
+static int flush_bw_data(struct msm_bus_node_device_type *node_info, int ctx,
+			struct rpm_msg_batch *batch)
 {
 	int ret = 0;
 
@@ -313,7 +362,7 @@ static int flush_bw_data(struct msm_bus_node_device_type *node_info, int ctx)
 							fabdev->qos_off,
 							fabdev->qos_freq);
 		} else {
-			ret = send_rpm_msg(node_info, ctx);
+			ret = send_rpm_msg(node_info, ctx, batch);
 
 			if (ret)
 				MSM_BUS_ERR("%s: Failed to send RPM msg for%d",
@@ -482,6 +531,7 @@ int msm_bus_commit_data(struct list_head *clist)
 	int ctx;
 	struct msm_bus_node_device_type *node;
 	struct msm_bus_node_device_type *node_tmp;
+	struct rpm_msg_batch batch = { .count = 0, .error = 0 };
 
 	list_for_each_entry(node, clist, link) {
 		/* Aggregate the bus clocks */
@@ -500,7 +550,7 @@ int msm_bus_commit_data(struct list_head *clist)
 			if (ret)
 				MSM_BUS_ERR("%s: Err flushing clk data for:%d",
 						__func__, node->node_info->id);
-			ret = flush_bw_data(node, ctx);
+			ret = flush_bw_data(node, ctx, &batch);
 			if (ret)
 				MSM_BUS_ERR("%s: Error flushing bw data for %d",
 					__func__, node->node_info->id);
@@ -508,6 +558,10 @@ int msm_bus_commit_data(struct list_head *clist)
 		node->dirty = false;
 		list_del_init(&node->link);
 	}
+
+	wait_rpm_msgs(&batch);
+	if (batch.error)
+		ret = batch.error;
 	return ret;
 }
 
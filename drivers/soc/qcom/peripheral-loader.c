@@ -32,6 +32,8 @@
 #include <linux/of_address.h>
 #include <linux/io.h>
 #include <linux/dma-mapping.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
 #include <soc/qcom/ramdump.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/secure_buffer.h>
@@ -51,8 +53,12 @@
 
 #if defined(CONFIG_ARM)
 #define pil_memset_io(d, c, count) memset(d, c, count)
+#define pil_memcpy_toio(d, s, count) memcpy(d, s, count)
+#define pil_memcpy_fromio(d, s, count) memcpy(d, s, count)
 #else
 #define pil_memset_io(d, c, count) memset_io(d, c, count)
+#define pil_memcpy_toio(d, s, count) memcpy_toio(d, s, count)
+#define pil_memcpy_fromio(d, s, count) memcpy_fromio(d, s, count)
 #endif
 
 #define PIL_NUM_DESC		10
@@ -70,6 +76,7 @@ static int proxy_timeout_ms = -1;
 module_param(proxy_timeout_ms, int, S_IRUGO | S_IWUSR);
 
 static bool disable_timeouts;
+static struct workqueue_struct *pil_wq;
 static const char firmware_error_msg[] = "firmware_error\n";
 /**
  * struct pil_mdt - Representation of <name>.mdt file in memory
@@ -129,6 +136,13 @@ struct pil_seg {
  * non-relocatable images
  * @region: region allocated for relocatable images
  * @unvoted_flag: flag to keep track if we have unvoted or not.
+ * @num_segs: number of entries in @segs
+ * @cache_image: keep a copy of the image to restart from
+ * @cache_ready: @cache_mdt and @cache_blobs hold a complete image
+ * @cache_mdt: copy of the image's mdt
+ * @cache_mdt_size: size of @cache_mdt
+ * @cache_blobs: copies of the image's blobs, indexed by segment number
+ * @cache_nr_blobs: number of entries in @cache_blobs
  *
  * This struct contains data for a pil_desc that should not be exposed outside
  * of this file. This structure points to the descriptor and the descriptor
@@ -153,6 +167,27 @@ struct pil_priv {
 	int id;
 	int unvoted_flag;
 	size_t region_size;
+	int num_segs;
+	bool cache_image;
+	bool cache_ready;
+	void *cache_mdt;
+	size_t cache_mdt_size;
+	void **cache_blobs;
+	unsigned int cache_nr_blobs;
+};
+
+/**
+ * struct pil_seg_data - a segment being loaded on pil_wq
+ * @desc: descriptor the segment belongs to
+ * @seg: segment to load
+ * @load_seg_work: loads @seg into the image's memory region
+ * @retval: result of loading @seg
+ */
+struct pil_seg_data {
+	struct pil_desc *desc;
+	struct pil_seg *seg;
+	struct work_struct load_seg_work;
+	int retval;
 };
 
 static int pil_do_minidump(struct pil_desc *desc, void *ramdump_dev)
@@ -717,6 +752,7 @@ static int pil_init_mmap(struct pil_desc *desc, const struct pil_mdt *mdt)
 			return PTR_ERR(seg);
 
 		list_add_tail(&seg->list, &priv->segs);
+		priv->num_segs++;
 	}
 	list_sort(NULL, &priv->segs, pil_cmp_seg);
 
@@ -746,6 +782,7 @@ static void pil_release_mmap(struct pil_desc *desc)
 		list_del(&p->list);
 		kfree(p);
 	}
+	priv->num_segs = 0;
 }
 
 static void pil_clear_segment(struct pil_desc *desc)
@@ -779,6 +816,107 @@ static void pil_clear_segment(struct pil_desc *desc)
 
 #define IOMAP_SIZE SZ_1M
 
+/*
+ * With qcom,cache-image set, the mdt and every blob read from storage on
+ * the first successful boot are copied aside, and later boots copy them
+ * back into the region instead of going to the filesystem again. The copy
+ * is what was read from storage and still goes through the usual init,
+ * verify and authentication steps on every boot; only the file reads are
+ * skipped. A boot that fails drops the copy so the next one starts over
+ * from storage.
+ */
+static void pil_cache_free(struct pil_priv *priv)
+{
+	unsigned int i;
+
+	for (i = 0; i < priv->cache_nr_blobs; i++)
+		vfree(priv->cache_blobs[i]);
+	kfree(priv->cache_blobs);
+	vfree(priv->cache_mdt);
+	priv->cache_blobs = NULL;
+	priv->cache_nr_blobs = 0;
+	priv->cache_mdt = NULL;
+	priv->cache_mdt_size = 0;
+	priv->cache_ready = false;
+}
+
+static void pil_cache_init(struct pil_priv *priv, const void *mdt,
+			   size_t size, unsigned int nr_blobs)
+{
+	priv->cache_mdt = vmalloc(size);
+	priv->cache_blobs = kcalloc(nr_blobs, sizeof(*priv->cache_blobs),
+				    GFP_KERNEL);
+	if (!priv->cache_mdt || !priv->cache_blobs) {
+		pil_cache_free(priv);
+		return;
+	}
+
+	memcpy(priv->cache_mdt, mdt, size);
+	priv->cache_mdt_size = size;
+	priv->cache_nr_blobs = nr_blobs;
+}
+
+static int pil_cache_copy(struct pil_desc *desc, struct pil_seg *seg,
+			  void *map_data, u8 *cache, bool restore)
+{
+	size_t offset, size;
+	u8 __iomem *buf;
+
+	for (offset = 0; offset < seg->filesz; offset += size) {
+		size = min_t(size_t, IOMAP_SIZE, seg->filesz - offset);
+		buf = desc->map_fw_mem(seg->paddr + offset, size, map_data);
+		if (!buf) {
+			pil_err(desc, "Failed to map memory\n");
+			return -ENOMEM;
+		}
+		if (restore)
+			pil_memcpy_toio(buf, cache + offset, size);
+		else
+			pil_memcpy_fromio(cache + offset, buf, size);
+		desc->unmap_fw_mem(buf, size, map_data);
+	}
+
+	return 0;
+}
+
+/* Copy a blob that was just read from storage into the cache */
+static void pil_cache_blob(struct pil_desc *desc, struct pil_seg *seg,
+			   void *map_data)
+{
+	struct pil_priv *priv = desc->priv;
+	void *cache;
+
+	if (seg->num >= priv->cache_nr_blobs)
+		return;
+
+	cache = vmalloc(seg->filesz);
+	if (!cache)
+		return;
+
+	if (pil_cache_copy(desc, seg, map_data, cache, false)) {
+		vfree(cache);
+		return;
+	}
+	priv->cache_blobs[seg->num] = cache;
+}
+
+/* The cache is only usable once every blob of the image made it in */
+static void pil_cache_commit(struct pil_priv *priv)
+{
+	struct pil_seg *seg;
+
+	if (!priv->cache_blobs || priv->cache_ready)
+		return;
+
+	list_for_each_entry(seg, &priv->segs, list) {
+		if (seg->filesz && !priv->cache_blobs[seg->num]) {
+			pil_cache_free(priv);
+			return;
+		}
+	}
+	priv->cache_ready = true;
+}
+
 static void *map_fw_mem(phys_addr_t paddr, size_t size, void *data)
 {
 	struct pil_map_fw_info *info = data;
@@ -808,7 +946,12 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 	};
 	void *map_data = desc->map_data ? desc->map_data : &map_fw_info;
 
-	if (seg->filesz) {
+	if (seg->filesz && desc->priv->cache_ready) {
+		ret = pil_cache_copy(desc, seg, map_data,
+				     desc->priv->cache_blobs[num], true);
+		if (ret)
+			return ret;
+	} else if (seg->filesz) {
 		snprintf(fw_name, ARRAY_SIZE(fw_name), "%s.b%02d",
 				desc->fw_name, num);
 		ret = request_firmware_into_buf(fw_name, desc->dev, seg->paddr,
@@ -828,6 +971,9 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 			return -EPERM;
 		}
 		ret = 0;
+
+		if (desc->priv->cache_blobs)
+			pil_cache_blob(desc, seg, map_data);
 	}
 
 	/* Zero out trailing memory */
@@ -851,12 +997,69 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 		paddr += size;
 	}
 
-	if (desc->ops->verify_blob) {
+	return ret;
+}
+
+static void pil_load_seg_work_fn(struct work_struct *work)
+{
+	struct pil_seg_data *seg_data = container_of(work, struct pil_seg_data,
+						     load_seg_work);
+
+	seg_data->retval = pil_load_seg(seg_data->desc, seg_data->seg);
+}
+
+/*
+ * The blobs of an image are independent files, so read them all into the
+ * region at once instead of one after the other. Verification is stateful
+ * for some peripherals (the modem's MBA authenticates the image as one
+ * growing range), so it is still done in segment order once everything
+ * has been loaded.
+ */
+static int pil_load_segs(struct pil_desc *desc)
+{
+	struct pil_priv *priv = desc->priv;
+	struct pil_seg_data *seg_data = NULL;
+	struct pil_seg *seg;
+	int ret = 0, i = 0;
+
+	if (pil_wq && priv->num_segs > 1)
+		seg_data = kcalloc(priv->num_segs, sizeof(*seg_data),
+				   GFP_KERNEL);
+
+	if (seg_data) {
+		list_for_each_entry(seg, &priv->segs, list) {
+			seg_data[i].desc = desc;
+			seg_data[i].seg = seg;
+			INIT_WORK(&seg_data[i].load_seg_work,
+				  pil_load_seg_work_fn);
+			queue_work(pil_wq, &seg_data[i].load_seg_work);
+			i++;
+		}
+
+		/* wait for every load, even after one of them failed */
+		for (i = 0; i < priv->num_segs; i++) {
+			flush_work(&seg_data[i].load_seg_work);
+			if (seg_data[i].retval && !ret)
+				ret = seg_data[i].retval;
+		}
+		kfree(seg_data);
+	} else {
+		list_for_each_entry(seg, &priv->segs, list) {
+			ret = pil_load_seg(desc, seg);
+			if (ret)
+				break;
+		}
+	}
+	if (ret || !desc->ops->verify_blob)
+		return ret;
+
+	list_for_each_entry(seg, &priv->segs, list) {
 		ret = desc->ops->verify_blob(desc, seg->paddr, seg->sz);
 		if (ret) {
 			pil_err(desc, "Blob%u failed verification(rc:%d)\n",
-								num, ret);
+								seg->num, ret);
 			subsys_set_error(desc->subsys_dev, firmware_error_msg);
+			break;
 		}
 	}
 
@@ -898,6 +1101,8 @@ static int pil_parse_devicetree(struct pil_desc *desc)
 		}
 	}
 	desc->proxy_unvote_irq = clk_ready;
+	desc->priv->cache_image = of_property_read_bool(ofnode,
+						"qcom,cache-image");
 	return 0;
 }
 
@@ -917,10 +1122,13 @@ int pil_boot(struct pil_desc *desc)
 	const struct pil_mdt *mdt;
 	const struct elf32_hdr *ehdr;
 	struct pil_seg *seg;
-	const struct firmware *fw;
+	const struct firmware *fw = NULL;
+	const u8 *mdt_data;
+	size_t mdt_size;
 	struct pil_priv *priv = desc->priv;
 	bool mem_protect = false;
 	bool hyp_assign = false;
+	ktime_t load_start, auth_start;
 
 	if (desc->shutdown_fail)
 		pil_err(desc, "Subsystem shutdown failed previously!\n");
@@ -929,21 +1137,30 @@ int pil_boot(struct pil_desc *desc)
 	pil_release_mmap(desc);
 
 	down_read(&pil_pm_rwsem);
-	snprintf(fw_name, sizeof(fw_name), "%s.mdt", desc->fw_name);
-	ret = request_firmware(&fw, fw_name, desc->dev);
-	if (ret) {
-		pil_err(desc, "Failed to locate %s(rc:%d)\n", fw_name, ret);
-		goto out;
+	if (priv->cache_ready) {
+		pil_info(desc, "loading image from cache\n");
+		mdt_data = priv->cache_mdt;
+		mdt_size = priv->cache_mdt_size;
+	} else {
+		snprintf(fw_name, sizeof(fw_name), "%s.mdt", desc->fw_name);
+		ret = request_firmware(&fw, fw_name, desc->dev);
+		if (ret) {
+			pil_err(desc, "Failed to locate %s(rc:%d)\n",
+				fw_name, ret);
+			goto out;
+		}
+		mdt_data = fw->data;
+		mdt_size = fw->size;
 	}
 
-	if (fw->size < sizeof(*ehdr)) {
+	if (mdt_size < sizeof(*ehdr)) {
 		pil_err(desc, "Not big enough to be an elf header\n");
 		subsys_set_error(desc->subsys_dev, firmware_error_msg);
 		ret = -EIO;
 		goto release_fw;
 	}
 
-	mdt = (const struct pil_mdt *)fw->data;
+	mdt = (const struct pil_mdt *)mdt_data;
 	ehdr = &mdt->hdr;
 
 	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG)) {
@@ -960,7 +1177,7 @@ int pil_boot(struct pil_desc *desc)
 		goto release_fw;
 	}
 	if (sizeof(struct elf32_phdr) * ehdr->e_phnum +
-	    sizeof(struct elf32_hdr) > fw->size) {
+	    sizeof(struct elf32_hdr) > mdt_size) {
 		pil_err(desc, "Program headers not within mdt\n");
 		subsys_set_error(desc->subsys_dev, firmware_error_msg);
 		ret = -EIO;
@@ -971,6 +1188,9 @@ int pil_boot(struct pil_desc *desc)
 	if (ret)
 		goto release_fw;
 
+	if (priv->cache_image && !priv->cache_ready)
+		pil_cache_init(priv, mdt_data, mdt_size, ehdr->e_phnum);
+
 	desc->priv->unvoted_flag = 0;
 	ret = pil_proxy_vote(desc);
 	if (ret) {
@@ -980,7 +1200,7 @@ int pil_boot(struct pil_desc *desc)
 
 	trace_pil_event("before_init_image", desc);
 	if (desc->ops->init_image)
-		ret = desc->ops->init_image(desc, fw->data, fw->size,
+		ret = desc->ops->init_image(desc, mdt_data, mdt_size,
 			priv->region_start,
 			priv->region_end - priv->region_start);
 	if (ret) {
@@ -1011,11 +1231,10 @@ int pil_boot(struct pil_desc *desc)
 	}
 
 	trace_pil_event("before_load_seg", desc);
-	list_for_each_entry(seg, &desc->priv->segs, list) {
-		ret = pil_load_seg(desc, seg);
-		if (ret)
-			goto err_deinit_image;
-	}
+	load_start = ktime_get();
+	ret = pil_load_segs(desc);
+	if (ret)
+		goto err_deinit_image;
 
 	if (desc->subsys_vmid > 0) {
 		trace_pil_event("before_reclaim_mem", desc);
@@ -1031,6 +1250,7 @@ int pil_boot(struct pil_desc *desc)
 	}
 
 	trace_pil_event("before_auth_reset", desc);
+	auth_start = ktime_get();
 	ret = desc->ops->auth_and_reset(desc);
 	if (ret) {
 		pil_err(desc, "Failed to bring out of reset(rc:%d)\n", ret);
@@ -1038,8 +1258,11 @@ int pil_boot(struct pil_desc *desc)
 		goto err_auth_and_reset;
 	}
 	trace_pil_event("reset_done", desc);
-	pil_info(desc, "Brought out of reset\n");
+	pil_info(desc, "Brought out of reset (%d segments loaded in %lld ms, authenticated in %lld ms)\n",
+		 priv->num_segs, ktime_ms_delta(auth_start, load_start),
+		 ktime_ms_delta(ktime_get(), auth_start));
 	desc->modem_ssr = false;
+	pil_cache_commit(priv);
 err_auth_and_reset:
 	if (ret && desc->subsys_vmid > 0) {
 		pil_assign_mem_to_linux(desc, priv->region_start,
@@ -1074,6 +1297,7 @@ out:
 			priv->region = NULL;
 		}
 		pil_release_mmap(desc);
+		pil_cache_free(priv);
 	}
 	return ret;
 }
@@ -1253,6 +1477,7 @@ void pil_desc_release(struct pil_desc *desc)
 		ida_simple_remove(&pil_ida, priv->id);
 		flush_delayed_work(&priv->proxy);
 		wakeup_source_trash(&priv->ws);
+		pil_cache_free(priv);
 	}
 	desc->priv = NULL;
 	kfree(priv);
@@ -1282,6 +1507,10 @@ static int __init msm_pil_init(void)
 	struct resource res;
 	int i;
 
+	pil_wq = alloc_workqueue("pil_workqueue", WQ_HIGHPRI | WQ_UNBOUND, 0);
+	if (!pil_wq)
+		pr_warn("pil: failed to allocate workqueue, loading serially\n");
+
 	np = of_find_compatible_node(NULL, NULL, "qcom,msm-imem-pil");
 	if (!np) {
 		pr_warn("pil: failed to find qcom,msm-imem-pil node\n");
@@ -1325,6 +1554,8 @@ device_initcall(msm_pil_init);
 static void __exit msm_pil_exit(void)
 {
 	unregister_pm_notifier(&pil_pm_notifier);
+	if (pil_wq)
+		destroy_workqueue(pil_wq);
 	if (pil_info_base)
 		iounmap(pil_info_base);
 	if (pil_minidump_base)
@@ -31,6 +31,9 @@
 #include <linux/personality.h>
 #include <linux/bitops.h>
 #include <linux/mutex.h>
+#include <linux/oom.h>
+#include <linux/pid.h>
+#include <linux/sched.h>
 #include <linux/shmem_fs.h>
 #include "ashmem.h"
 
@@ -68,6 +71,7 @@ struct ashmem_area {
  * @lru:	         The entry in the LRU list
  * @unpinned:	         The entry in its area's unpinned list
  * @asma:	         The associated anonymous shared memory area.
+ * @owner:	         The thread group that unpinned the range
  * @pgstart:	         The starting page (inclusive)
  * @pgend:	         The ending page (inclusive)
  * @purged:	         The purge status (ASHMEM_NOT or ASHMEM_WAS_PURGED)
@@ -78,6 +82,7 @@ struct ashmem_range {
 	struct list_head lru;
 	struct list_head unpinned;
 	struct ashmem_area *asma;
+	struct pid *owner;
 	size_t pgstart;
 	size_t pgend;
 	unsigned int purged;
@@ -90,6 +95,16 @@ static DEFINE_MUTEX(list_lock);
 /* long lru_count - The count of pages on our LRU list. */
 static atomic_long_t lru_count;
 
+/*
+ * Owner oom_score_adj bands purged in turn: ranges of cached apps go
+ * first, then those of other background processes, then the rest.
+ */
+static const short purge_adj_bands[] = {
+	900,  /* CACHED_APP_MIN_ADJ */
+	200,  /* PERCEPTIBLE_APP_ADJ */
+	OOM_SCORE_ADJ_MIN
+};
+
 /* mmap_lock - protects mmap operations */
 static DEFINE_MUTEX(mmap_lock);
 
@@ -169,6 +184,7 @@ static inline void lru_del(struct ashmem_range *range)
  * @asma:	   The associated ashmem_area
  * @prev_range:	   The previous ashmem_range in the sorted asma->unpinned list
  * @purged:	   Initial purge status (ASMEM_NOT_PURGED or ASHMEM_WAS_PURGED)
+ * @owner:	   The thread group that unpinned the range
  * @start:	   The starting page (inclusive)
  * @end:	   The ending page (inclusive)
  *
@@ -178,7 +194,7 @@ static inline void lru_del(struct ashmem_range *range)
  */
 static int range_alloc(struct ashmem_area *asma,
 		       struct ashmem_range *prev_range, unsigned int purged,
-		       size_t start, size_t end)
+		       struct pid *owner, size_t start, size_t end)
 {
 	struct ashmem_range *range;
 
@@ -187,6 +203,7 @@ static int range_alloc(struct ashmem_area *asma,
 		return -ENOMEM;
 
 	range->asma = asma;
+	range->owner = get_pid(owner);
 	range->pgstart = start;
 	range->pgend = end;
 	range->purged = purged;
@@ -208,6 +225,7 @@ static void range_del(struct ashmem_range *range)
 	list_del(&range->unpinned);
 	if (range_on_lru(range))
 		lru_del(range);
+	put_pid(range->owner);
 	kmem_cache_free(ashmem_range_cachep, range);
 }
 
@@ -426,6 +444,87 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	return 0;
 }
 
+/* A range whose owner has exited is purged along with the cached apps */
+static short range_owner_adj(struct ashmem_range *range)
+{
+	struct task_struct *tsk;
+	short adj = OOM_SCORE_ADJ_MAX;
+
+	rcu_read_lock();
+	tsk = pid_task(range->owner, PIDTYPE_PID);
+	if (tsk)
+		adj = READ_ONCE(tsk->signal->oom_score_adj);
+	rcu_read_unlock();
+
+	return adj;
+}
+
+/*
+ * __ashmem_purge - purge up to @nr_pages of unpinned pages, walking the LRU
+ * once per band in purge_adj_bands and skipping ranges whose owner has a
+ * lower oom_score_adj than the band. No band below @min_adj is purged.
+ *
+ * Caller must hold list_lock.
+ */
+static unsigned long __ashmem_purge(unsigned long nr_pages, short min_adj)
+{
+	struct ashmem_range *range, *next;
+	unsigned long freed = 0;
+	short band;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(purge_adj_bands); i++) {
+		band = max(purge_adj_bands[i], min_adj);
+
+		list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
+			loff_t start = range->pgstart * PAGE_SIZE;
+			loff_t end = (range->pgend + 1) * PAGE_SIZE;
+
+			if (range_owner_adj(range) < band)
+				continue;
+
+			range->asma->file->f_op->fallocate(range->asma->file,
+				FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				start, end - start);
+			range->purged = ASHMEM_WAS_PURGED;
+			lru_del(range);
+
+			freed += range_size(range);
+			if (freed >= nr_pages)
+				return freed;
+		}
+
+		if (band == min_adj)
+			break;
+	}
+
+	return freed;
+}
+
+/**
+ * ashmem_purge() - purge unpinned pages ahead of killing processes
+ * @nr_pages:	    The number of pages wanted
+ * @min_adj:	    The lowest owner oom_score_adj whose ranges may be purged
+ *
+ * Lets the low memory killer take back the unpinned caches of processes
+ * it could kill before it kills any of them. Gives up rather than waiting
+ * if ashmem is busy, as list_lock is held across allocations.
+ *
+ * Return: the number of pages freed
+ */
+unsigned long ashmem_purge(unsigned long nr_pages, short min_adj)
+{
+	unsigned long freed;
+
+	if (!mutex_trylock(&list_lock))
+		return 0;
+
+	freed = __ashmem_purge(nr_pages, min_adj);
+	mutex_unlock(&list_lock);
+
+	return freed;
+}
+
 /*
  * ashmem_shrink - our cache shrinker, called from mm/vmscan.c
  *
@@ -443,8 +542,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 static unsigned long
 ashmem_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 {
-	struct ashmem_range *range, *next;
-	unsigned long freed = 0;
+	unsigned long freed;
 
 	/* We might recurse into filesystem code, so bail out if necessary */
 	if (!(sc->gfp_mask & __GFP_FS))
@@ -453,20 +551,7 @@ ashmem_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 	if (!mutex_trylock(&list_lock))
 		return -1;
 
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE;
-
-		range->asma->file->f_op->fallocate(range->asma->file,
-				FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
-				start, end - start);
-		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
-
-		freed += range_size(range);
-		if (--sc->nr_to_scan <= 0)
-			break;
-	}
+	freed = __ashmem_purge(sc->nr_to_scan, OOM_SCORE_ADJ_MIN);
 	mutex_unlock(&list_lock);
 	return freed;
 }
@@ -620,7 +705,7 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 			 * more complicated, we allocate a new range for the
 			 * second half and adjust the first chunk's endpoint.
 			 */
-			range_alloc(asma, range, range->purged,
+			range_alloc(asma, range, range->purged, range->owner,
 				    pgend + 1, range->pgend);
 			range_shrink(range, range->pgstart, pgstart - 1);
 			break;
@@ -661,7 +746,8 @@ restart:
 		}
 	}
 
-	return range_alloc(asma, range, purged, pgstart, pgend);
+	return range_alloc(asma, range, purged, task_tgid(current),
+			   pgstart, pgend);
 }
 
 /*
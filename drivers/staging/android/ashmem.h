@@ -24,4 +24,14 @@
 #define COMPAT_ASHMEM_SET_PROT_MASK	_IOW(__ASHMEMIOC, 5, unsigned int)
 #endif
 
+#ifdef CONFIG_ASHMEM
+unsigned long ashmem_purge(unsigned long nr_pages, short min_adj);
+#else
+static inline unsigned long ashmem_purge(unsigned long nr_pages,
+					 short min_adj)
+{
+	return 0;
+}
+#endif
+
 #endif	/* _LINUX_ASHMEM_H */
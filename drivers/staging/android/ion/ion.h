@@ -266,6 +266,20 @@ static inline void *ion_import_dma_buf(struct ion_client *client, int fd)
 	return __ion_import_dma_buf(fd);
 }
 
+/**
+ * ion_handle_refcount() - number of references held on the buffer
+ * @client:	the client
+ * @handle:	the handle
+ *
+ * Lets a client caching a handle find out if it holds the last references.
+ */
+static inline int ion_handle_refcount(struct ion_client *client, void *handle)
+{
+	struct ion_buffer *buffer = handle;
+
+	return atomic_read(&buffer->refcount);
+}
+
 #else
 static inline void ion_reserve(struct ion_platform_data *data)
 {
@@ -323,6 +337,12 @@ static inline struct ion_handle *ion_import_dma_buf(struct ion_client *client, i
 	return ERR_PTR(-ENODEV);
 }
 
+static inline int ion_handle_refcount(struct ion_client *client,
+	void *handle)
+{
+	return 0;
+}
+
 static inline int ion_handle_get_flags(struct ion_client *client,
 	struct ion_handle *handle, unsigned long *flags)
 {
@@ -57,7 +57,12 @@ void *ion_heap_map_kernel(struct ion_heap *heap,
 		for (j = 0; j < npages_this_entry; j++)
 			*(tmp++) = page++;
 	}
-	vaddr = vmap(pages, npages, VM_MAP, pgprot);
+	/*
+	 * vm_map_ram() serves small mappings from the per-cpu vmap blocks
+	 * and unmaps them lazily, without taking vmap_area_lock or flushing
+	 * the TLB for each buffer.
+	 */
+	vaddr = vm_map_ram(pages, npages, NUMA_NO_NODE, pgprot);
 	vfree(pages);
 
 	if (!vaddr)
@@ -69,7 +74,7 @@ void *ion_heap_map_kernel(struct ion_heap *heap,
 void ion_heap_unmap_kernel(struct ion_heap *heap,
 			   struct ion_buffer *buffer)
 {
-	vunmap(buffer->vaddr);
+	vm_unmap_ram(buffer->vaddr, PAGE_ALIGN(buffer->size) / PAGE_SIZE);
 }
 
 int ion_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
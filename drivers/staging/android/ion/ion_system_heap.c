@@ -19,8 +19,11 @@
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/highmem.h>
+#include <linux/memcontrol.h>
 #include <linux/mm.h>
+#include <linux/module.h>
 #include <linux/msm_ion.h>
+#include <linux/prezero.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
@@ -69,8 +72,26 @@ struct ion_system_heap {
 	struct ion_page_pool **secure_pools[VMID_LAST];
 	/* Prevents unnecessary page splitting */
 	struct mutex split_page_mutex;
+	/* Recently freed whole buffers, most recent first */
+	struct list_head buffer_cache;
+	struct mutex buffer_cache_lock;
+	size_t buffer_cache_size;
 };
 
+struct cached_buffer {
+	struct sg_table *table;
+	size_t size;
+	unsigned long flags;
+	struct list_head list;
+};
+
+/*
+ * Upper bound on the memory held in freed buffers waiting to be reused by an
+ * allocation of the same size and flags
+ */
+static unsigned int buffer_cache_kb = SZ_32M >> 10;
+module_param(buffer_cache_kb, uint, 0644);
+
 struct page_info {
 	struct page *page;
 	bool from_pool;
@@ -124,7 +145,28 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 		else
 			pool = heap->cached_pools[order_to_index(order)];
 
-		page = ion_page_pool_alloc(pool, from_pool);
+		/*
+		 * Non-secure pools can fall back to the background zeroed
+		 * reservoir before going to the buddy allocator. Such pages
+		 * only need their zeroing flushed and are then as good as
+		 * pool pages.
+		 */
+		page = NULL;
+		if (vmid <= 0) {
+			page = ion_page_pool_alloc_pool_only(pool);
+			if (!page) {
+				page = prezero_alloc_page(order);
+				if (page) {
+					ion_page_pool_alloc_set_cache_policy(
+								pool, page);
+					ion_pages_sync_for_device(dev, page,
+							PAGE_SIZE << order,
+							DMA_BIDIRECTIONAL);
+				}
+			}
+		}
+		if (!page)
+			page = ion_page_pool_alloc(pool, from_pool);
 	} else {
 		gfp_t gfp_mask = low_order_gfp_flags;
 		if (order)
@@ -145,14 +187,14 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
  * For secure pages that need to be freed and not added back to the pool; the
  *  hyp_unassign should be called before calling this function
  */
-static void free_buffer_page(struct ion_system_heap *heap,
-			     struct ion_buffer *buffer, struct page *page,
-			     unsigned int order)
+static void __free_buffer_page(struct ion_system_heap *heap,
+			       unsigned long flags, unsigned long private_flags,
+			       struct page *page, unsigned int order)
 {
-	bool cached = ion_buffer_cached(buffer);
-	int vmid = get_secure_vmid(buffer->flags);
+	bool cached = !!(flags & ION_FLAG_CACHED);
+	int vmid = get_secure_vmid(flags);
 
-	if (!(buffer->flags & ION_FLAG_POOL_FORCE_ALLOC)) {
+	if (!(flags & ION_FLAG_POOL_FORCE_ALLOC)) {
 		struct ion_page_pool *pool;
 		if (vmid > 0)
 			pool = heap->secure_pools[vmid][order_to_index(order)];
@@ -161,7 +203,7 @@ static void free_buffer_page(struct ion_system_heap *heap,
 		else
 			pool = heap->uncached_pools[order_to_index(order)];
 
-		if (buffer->private_flags & ION_PRIV_FLAG_SHRINKER_FREE)
+		if (private_flags & ION_PRIV_FLAG_SHRINKER_FREE)
 			ion_page_pool_free_immediate(pool, page);
 		else
 			ion_page_pool_free(pool, page);
@@ -170,6 +212,14 @@ static void free_buffer_page(struct ion_system_heap *heap,
 	}
 }
 
+static void free_buffer_page(struct ion_system_heap *heap,
+			     struct ion_buffer *buffer, struct page *page,
+			     unsigned int order)
+{
+	__free_buffer_page(heap, buffer->flags, buffer->private_flags, page,
+			   order);
+}
+
 static struct page *alloc_from_secure_pool_order(struct ion_system_heap *heap,
 						 struct ion_buffer *buffer,
 						 unsigned long order)
@@ -332,10 +382,116 @@ static void free_info(struct page_info *info, struct page_info *info_onstack,
 		kmem_cache_free(ion_page_info_pool, info);
 }
 
-static int ion_system_heap_allocate(struct ion_heap *heap,
-				     struct ion_buffer *buffer,
-				     unsigned long size, unsigned long align,
-				     unsigned long flags)
+/* Give the pages of a cached buffer back to the page pools */
+static void buffer_cache_release(struct ion_system_heap *sys_heap,
+				 struct cached_buffer *entry)
+{
+	struct scatterlist *sg;
+	int i;
+
+	for_each_sg(entry->table->sgl, sg, entry->table->nents, i)
+		__free_buffer_page(sys_heap, entry->flags, 0, sg_page(sg),
+				   get_order(sg->length));
+	sg_free_table(entry->table);
+	kfree(entry->table);
+	kfree(entry);
+}
+
+/*
+ * Keep the pages of a freed buffer together so a later allocation of the
+ * same size and flags gets them back without allocating, zeroing or
+ * assigning anything. The buffer must already be zeroed. Returns false if
+ * the caller has to free the buffer itself.
+ */
+static bool buffer_cache_put(struct ion_system_heap *sys_heap,
+			     struct ion_buffer *buffer)
+{
+	size_t limit = (size_t)buffer_cache_kb << 10;
+	struct cached_buffer *entry, *tmp;
+	LIST_HEAD(evict);
+
+	if (PAGE_ALIGN(buffer->size) > limit)
+		return false;
+
+	entry = kmalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return false;
+
+	entry->table = buffer->priv_virt;
+	entry->size = PAGE_ALIGN(buffer->size);
+	entry->flags = buffer->flags;
+
+	mutex_lock(&sys_heap->buffer_cache_lock);
+	list_add(&entry->list, &sys_heap->buffer_cache);
+	sys_heap->buffer_cache_size += entry->size;
+
+	/* Drop the least recently freed buffers to stay under the limit */
+	while (sys_heap->buffer_cache_size > limit) {
+		tmp = list_last_entry(&sys_heap->buffer_cache,
+				      struct cached_buffer, list);
+		list_move(&tmp->list, &evict);
+		sys_heap->buffer_cache_size -= tmp->size;
+	}
+	mutex_unlock(&sys_heap->buffer_cache_lock);
+
+	list_for_each_entry_safe(entry, tmp, &evict, list)
+		buffer_cache_release(sys_heap, entry);
+
+	return true;
+}
+
+static struct sg_table *buffer_cache_get(struct ion_system_heap *sys_heap,
+					 size_t size, unsigned long flags)
+{
+	struct cached_buffer *entry;
+	struct sg_table *table = NULL;
+
+	mutex_lock(&sys_heap->buffer_cache_lock);
+	list_for_each_entry(entry, &sys_heap->buffer_cache, list) {
+		if (entry->size == size && entry->flags == flags) {
+			list_del(&entry->list);
+			sys_heap->buffer_cache_size -= entry->size;
+			table = entry->table;
+			kfree(entry);
+			break;
+		}
+	}
+	mutex_unlock(&sys_heap->buffer_cache_lock);
+
+	return table;
+}
+
+/*
+ * Hand the oldest cached buffers back to the page pools, where the pool
+ * shrinking can free them. Returns the number of pages released.
+ */
+static unsigned long buffer_cache_shrink(struct ion_system_heap *sys_heap,
+					 unsigned long nr_to_scan)
+{
+	struct cached_buffer *entry, *tmp;
+	unsigned long nr = 0;
+	LIST_HEAD(evict);
+
+	mutex_lock(&sys_heap->buffer_cache_lock);
+	while (nr < nr_to_scan && !list_empty(&sys_heap->buffer_cache)) {
+		entry = list_last_entry(&sys_heap->buffer_cache,
+					struct cached_buffer, list);
+		list_move(&entry->list, &evict);
+		sys_heap->buffer_cache_size -= entry->size;
+		nr += entry->size >> PAGE_SHIFT;
+	}
+	mutex_unlock(&sys_heap->buffer_cache_lock);
+
+	list_for_each_entry_safe(entry, tmp, &evict, list)
+		buffer_cache_release(sys_heap, entry);
+
+	return nr;
+}
+
+static int __ion_system_heap_allocate(struct ion_heap *heap,
+				      struct ion_buffer *buffer,
+				      unsigned long size, unsigned long align,
+				      unsigned long flags)
 {
 	struct ion_system_heap *sys_heap = container_of(heap,
 							struct ion_system_heap,
@@ -364,6 +520,15 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	if (size / PAGE_SIZE > totalram_pages / 2)
 		return -ENOMEM;
 
+	if (!(buffer->flags & ION_FLAG_POOL_FORCE_ALLOC)) {
+		table = buffer_cache_get(sys_heap, PAGE_ALIGN(size),
+					 buffer->flags);
+		if (table) {
+			buffer->priv_virt = table;
+			return 0;
+		}
+	}
+
 	data.size = 0;
 	INIT_LIST_HEAD(&pages);
 	INIT_LIST_HEAD(&pages_from_pool);
@@ -531,10 +696,19 @@ void ion_system_heap_free(struct ion_buffer *buffer)
 	int vmid = get_secure_vmid(buffer->flags);
 	struct device *dev = heap->priv;
 
+	/* pages parked in the pools or the buffer cache belong to nobody */
+	for_each_sg(table->sgl, sg, table->nents, i)
+		memcg_kmem_uncharge(sg_page(sg), get_order(sg->length));
+
 	if (!(buffer->private_flags & ION_PRIV_FLAG_SHRINKER_FREE) &&
 	    !(buffer->flags & ION_FLAG_POOL_FORCE_ALLOC)) {
+		int ret = 0;
+
 		if (vmid < 0)
-			msm_ion_heap_sg_table_zero(dev, table, buffer->size);
+			ret = msm_ion_heap_sg_table_zero(dev, table,
+							 buffer->size);
+		if (!ret && buffer_cache_put(sys_heap, buffer))
+			return;
 	} else if (vmid > 0) {
 		if (ion_system_secure_heap_unassign_sg(table, vmid))
 			return;
@@ -547,6 +721,37 @@ void ion_system_heap_free(struct ion_buffer *buffer)
 	kfree(table);
 }
 
+/*
+ * Charge the buffer to the memcg of the allocating process, so that a
+ * per-app memory limit covers the graphics memory that app asked for.
+ */
+static int ion_system_heap_allocate(struct ion_heap *heap,
+				    struct ion_buffer *buffer,
+				    unsigned long size, unsigned long align,
+				    unsigned long flags)
+{
+	struct sg_table *table;
+	struct scatterlist *sg;
+	int i, ret;
+
+	ret = __ion_system_heap_allocate(heap, buffer, size, align, flags);
+	if (ret)
+		return ret;
+
+	table = buffer->priv_virt;
+	for_each_sg(table->sgl, sg, table->nents, i) {
+		ret = memcg_kmem_charge(sg_page(sg), GFP_KERNEL,
+					get_order(sg->length));
+		if (ret) {
+			/* uncharges whatever was charged so far */
+			ion_system_heap_free(buffer);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
 struct sg_table *ion_system_heap_map_dma(struct ion_heap *heap,
 					 struct ion_buffer *buffer)
 {
@@ -635,6 +840,12 @@ static int ion_system_heap_shrink(struct ion_heap *heap, gfp_t gfp_mask,
 	if (!nr_to_scan)
 		only_scan = 1;
 
+	/* Cached buffers go back to the pools first so they can be freed */
+	if (only_scan)
+		nr_total += sys_heap->buffer_cache_size >> PAGE_SHIFT;
+	else
+		buffer_cache_shrink(sys_heap, nr_to_scan);
+
 	for (i = 0; i < num_orders; i++) {
 		nr_freed = 0;
 
@@ -756,6 +967,8 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *data)
 		goto err_create_cached_pools;
 
 	mutex_init(&heap->split_page_mutex);
+	mutex_init(&heap->buffer_cache_lock);
+	INIT_LIST_HEAD(&heap->buffer_cache);
 
 	return &heap->heap;
 
@@ -786,6 +999,8 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 							heap);
 	int i, j;
 
+	buffer_cache_shrink(sys_heap, ULONG_MAX);
+
 	for (i = 0; i < VMID_LAST; i++) {
 		if (!is_secure_vmid_valid(i))
 			continue;
@@ -8,6 +8,9 @@
 #include <linux/cpu.h>
 #include <linux/cpufreq.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/msm_kgsl.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
@@ -27,6 +30,33 @@ struct thermal_zone {
 	s32 trip_deg;
 };
 
+enum pid_consumer_id {
+	PID_SILVER,
+	PID_GOLD,
+	PID_GPU,
+	PID_MAX
+};
+
+/* Power drawn at max_khz; power is modeled as scaling with the cube of freq */
+struct pid_consumer {
+	u32 max_mw;
+	u32 max_khz;
+	u32 cap_khz;
+};
+
+struct thermal_pid {
+	struct pid_consumer c[PID_MAX];
+	void *gpu_limit;
+	s32 setpoint_deg;
+	s32 integral;
+	s32 integral_max;
+	s32 prev_err;
+	u32 sustainable_mw;
+	u32 kp;
+	u32 ki;
+	u32 kd;
+};
+
 struct thermal_drv {
 	struct notifier_block cpu_notif;
 	struct delayed_work throttle_work;
@@ -34,12 +64,50 @@ struct thermal_drv {
 	struct thermal_zone *zones;
 	struct qpnp_vadc_chip *vadc_dev;
 	struct thermal_zone *curr_zone;
+	struct thermal_zone *sustained_zone;
+	struct thermal_pid *pid;
 	enum qpnp_vadc_channels adc_chan;
 	u32 poll_jiffies;
 	u32 start_delay;
 	u32 nr_zones;
+	bool sustained;
 };
 
+static struct thermal_drv *thermal_drv_instance;
+
+/*
+ * Sustained performance mode caps everything to what can be held
+ * indefinitely, trading peak performance for the absence of throttle cliffs.
+ */
+static bool sustained_mode __read_mostly;
+
+static int set_sustained_mode(const char *val, const struct kernel_param *kp)
+{
+	struct thermal_drv *t = thermal_drv_instance;
+	int ret;
+
+	ret = param_set_bool(val, kp);
+	if (!ret && t)
+		mod_delayed_work(t->wq, &t->throttle_work, 0);
+
+	return ret;
+}
+
+static const struct kernel_param_ops sustained_mode_ops = {
+	.set = set_sustained_mode,
+	.get = param_get_bool,
+};
+module_param_cb(sustained_mode, &sustained_mode_ops, &sustained_mode, 0644);
+
+/* The lower of two caps, where 0 means uncapped */
+static u32 min_cap(u32 a, u32 b)
+{
+	if (!a || !b)
+		return a ?: b;
+
+	return min(a, b);
+}
+
 static void update_online_cpu_policy(void)
 {
 	u32 cpu;
@@ -53,6 +121,197 @@ static void update_online_cpu_policy(void)
 	put_online_cpus();
 }
 
+static u32 pid_power_mw(struct pid_consumer *c, u32 khz)
+{
+	u64 r = min(khz, c->max_khz) * 1024ULL / c->max_khz;
+
+	return (c->max_mw * r * r * r) >> 30;
+}
+
+/* Highest CPU frequency that fits in the granted power, else the lowest */
+static u32 pid_cpu_cap(struct pid_consumer *c, u32 cpu, u32 grant_mw)
+{
+	struct cpufreq_frequency_table *pos, *table;
+	u32 best = 0, lowest = UINT_MAX;
+
+	table = cpufreq_frequency_get_table(cpu);
+	if (!table)
+		return 0;
+
+	cpufreq_for_each_valid_entry(pos, table) {
+		lowest = min(lowest, pos->frequency);
+		if (pos->frequency > best &&
+		    pid_power_mw(c, pos->frequency) <= grant_mw)
+			best = pos->frequency;
+	}
+
+	return best ?: lowest;
+}
+
+static u32 pid_gpu_cap(struct pid_consumer *c, u32 grant_mw)
+{
+	u32 khz, level, lowest = 0;
+
+	for (level = 0;; level++) {
+		khz = kgsl_pwr_limits_get_level_freq(KGSL_DEVICE_3D0, level);
+		if (!khz)
+			break;
+		khz /= 1000;
+		if (pid_power_mw(c, khz) <= grant_mw)
+			return khz;
+		lowest = khz;
+	}
+
+	return lowest;
+}
+
+/* Also refreshes the consumer's max frequency, which may not be known yet */
+static u32 pid_cur_khz(struct pid_consumer *c, u32 cpu)
+{
+	struct cpufreq_policy *policy;
+	u32 cur_khz;
+
+	if (cpu >= nr_cpu_ids)
+		return 0;
+
+	policy = cpufreq_cpu_get(cpu);
+	if (!policy)
+		return 0;
+
+	c->max_khz = policy->cpuinfo.max_freq;
+	cur_khz = policy->cur;
+	cpufreq_cpu_put(policy);
+
+	return cur_khz;
+}
+
+/*
+ * Turn the distance from the setpoint into a power budget and split it among
+ * the consumers in proportion to the power they're currently drawing. Caps
+ * are only lowered as far as the budget requires, so the frequency follows
+ * the temperature smoothly instead of jumping between zones.
+ */
+static void thermal_pid_update(struct thermal_drv *t, s32 temp_deg)
+{
+	struct thermal_pid *pid = t->pid;
+	u32 cpu[PID_MAX], cur_khz[PID_MAX], demand_mw[PID_MAX];
+	u32 old_caps[PID_MAX];
+	u64 budget_mw, total_mw = 0, max_mw = 0;
+	s64 out_mw;
+	s32 err;
+	int i;
+
+	err = temp_deg - pid->setpoint_deg;
+	pid->integral = clamp(pid->integral + err, -pid->integral_max,
+			      pid->integral_max);
+	out_mw = (s64)pid->kp * err + (s64)pid->ki * pid->integral +
+		 (s64)pid->kd * (err - pid->prev_err);
+	pid->prev_err = err;
+
+	get_online_cpus();
+	cpu[PID_SILVER] = cpumask_first_and(cpu_lp_mask, cpu_online_mask);
+	cpu[PID_GOLD] = cpumask_first_and(cpu_perf_mask, cpu_online_mask);
+	cur_khz[PID_SILVER] = pid_cur_khz(&pid->c[PID_SILVER], cpu[PID_SILVER]);
+	cur_khz[PID_GOLD] = pid_cur_khz(&pid->c[PID_GOLD], cpu[PID_GOLD]);
+	put_online_cpus();
+
+	/* KGSL may probe after us, so keep trying to get a GPU limit handle */
+	if (pid->c[PID_GPU].max_mw && !pid->gpu_limit) {
+		pid->gpu_limit = kgsl_pwr_limits_add(KGSL_DEVICE_3D0);
+		if (IS_ERR(pid->gpu_limit))
+			pid->gpu_limit = NULL;
+	}
+
+	cur_khz[PID_GPU] = 0;
+	if (pid->gpu_limit) {
+		pid->c[PID_GPU].max_khz = kgsl_pwr_limits_get_level_freq(
+						KGSL_DEVICE_3D0, 0) / 1000;
+		cur_khz[PID_GPU] = kgsl_pwr_limits_get_cur_freq(
+						KGSL_DEVICE_3D0) / 1000;
+	}
+
+	for (i = 0; i < PID_MAX; i++) {
+		struct pid_consumer *c = &pid->c[i];
+
+		demand_mw[i] = 0;
+		if (!c->max_mw || !c->max_khz || !cur_khz[i])
+			continue;
+
+		/*
+		 * A consumer sitting at its cap would run faster if it could,
+		 * so count its full power to keep the cap from being lifted
+		 * just because capping it made it draw less.
+		 */
+		if (c->cap_khz && cur_khz[i] >= c->cap_khz)
+			demand_mw[i] = c->max_mw;
+		else
+			demand_mw[i] = pid_power_mw(c, cur_khz[i]);
+		total_mw += demand_mw[i];
+		max_mw += c->max_mw;
+	}
+
+	budget_mw = clamp_t(s64, (s64)pid->sustainable_mw - out_mw, 0, max_mw);
+
+	for (i = 0; i < PID_MAX; i++) {
+		struct pid_consumer *c = &pid->c[i];
+		u32 grant_mw;
+
+		old_caps[i] = c->cap_khz;
+		if (!demand_mw[i] || total_mw <= budget_mw) {
+			c->cap_khz = 0;
+			continue;
+		}
+
+		grant_mw = div64_u64(budget_mw * demand_mw[i], total_mw);
+		if (i == PID_GPU)
+			c->cap_khz = pid_gpu_cap(c, grant_mw);
+		else
+			c->cap_khz = pid_cpu_cap(c, cpu[i], grant_mw);
+	}
+
+	/*
+	 * Splitting the sustainable power by each consumer's peak power gives
+	 * the caps the device settles at under a full load on everything.
+	 */
+	if (t->sustained) {
+		u64 all_mw = 0;
+
+		for (i = 0; i < PID_MAX; i++)
+			if (pid->c[i].max_khz)
+				all_mw += pid->c[i].max_mw;
+
+		for (i = 0; i < PID_MAX && all_mw; i++) {
+			struct pid_consumer *c = &pid->c[i];
+			u32 grant_mw, khz;
+
+			if (!c->max_mw || !c->max_khz)
+				continue;
+
+			grant_mw = div64_u64((u64)pid->sustainable_mw *
+					     c->max_mw, all_mw);
+			if (i == PID_GPU)
+				khz = pid_gpu_cap(c, grant_mw);
+			else if (cpu[i] < nr_cpu_ids)
+				khz = pid_cpu_cap(c, cpu[i], grant_mw);
+			else
+				continue;
+			c->cap_khz = min_cap(c->cap_khz, khz);
+		}
+	}
+
+	if (pid->c[PID_SILVER].cap_khz != old_caps[PID_SILVER] ||
+	    pid->c[PID_GOLD].cap_khz != old_caps[PID_GOLD])
+		update_online_cpu_policy();
+
+	if (pid->gpu_limit && pid->c[PID_GPU].cap_khz != old_caps[PID_GPU]) {
+		if (pid->c[PID_GPU].cap_khz)
+			kgsl_pwr_limits_set_freq(pid->gpu_limit,
+						 pid->c[PID_GPU].cap_khz * 1000);
+		else
+			kgsl_pwr_limits_set_default(pid->gpu_limit);
+	}
+}
+
 static void thermal_throttle_worker(struct work_struct *work)
 {
 	struct thermal_drv *t = container_of(to_delayed_work(work), typeof(*t),
@@ -69,6 +328,13 @@ static void thermal_throttle_worker(struct work_struct *work)
 	}
 
 	temp_deg = result.physical;
+
+	if (t->pid) {
+		t->sustained = sustained_mode;
+		thermal_pid_update(t, temp_deg);
+		goto reschedule;
+	}
+
 	old_zone = t->curr_zone;
 	new_zone = NULL;
 
@@ -79,9 +345,10 @@ static void thermal_throttle_worker(struct work_struct *work)
 		}
 	}
 
-	/* Update thermal zone if it changed */
-	if (new_zone != old_zone) {
+	/* Update thermal zone if it or the sustained mode changed */
+	if (new_zone != old_zone || t->sustained != sustained_mode) {
 		t->curr_zone = new_zone;
+		t->sustained = sustained_mode;
 		update_online_cpu_policy();
 	}
 
@@ -89,12 +356,25 @@ reschedule:
 	queue_delayed_work(t->wq, &t->throttle_work, t->poll_jiffies);
 }
 
-static u32 get_throttle_freq(struct thermal_zone *zone, u32 cpu)
+static u32 get_throttle_freq(struct thermal_drv *t, u32 cpu)
 {
-	if (cpumask_test_cpu(cpu, cpu_lp_mask))
-		return zone->silver_khz;
+	bool silver = cpumask_test_cpu(cpu, cpu_lp_mask);
+	struct thermal_zone *zone;
+	u32 khz = 0;
+
+	/* Sustained mode is already folded into the PID caps */
+	if (t->pid)
+		return t->pid->c[silver ? PID_SILVER : PID_GOLD].cap_khz;
 
-	return zone->gold_khz;
+	zone = t->curr_zone;
+	if (zone)
+		khz = silver ? zone->silver_khz : zone->gold_khz;
+
+	zone = t->sustained ? t->sustained_zone : NULL;
+	if (zone)
+		khz = min_cap(khz, silver ? zone->silver_khz : zone->gold_khz);
+
+	return khz;
 }
 
 static int cpu_notifier_cb(struct notifier_block *nb, unsigned long val,
@@ -102,14 +382,14 @@ static int cpu_notifier_cb(struct notifier_block *nb, unsigned long val,
 {
 	struct thermal_drv *t = container_of(nb, typeof(*t), cpu_notif);
 	struct cpufreq_policy *policy = data;
-	struct thermal_zone *zone;
+	u32 throttle_khz;
 
 	if (val != CPUFREQ_ADJUST)
 		return NOTIFY_OK;
 
-	zone = t->curr_zone;
-	if (zone)
-		policy->max = get_throttle_freq(zone, policy->cpu);
+	throttle_khz = get_throttle_freq(t, policy->cpu);
+	if (throttle_khz)
+		policy->max = throttle_khz;
 	else
 		policy->max = policy->user_policy.max;
 
@@ -119,10 +399,62 @@ static int cpu_notifier_cb(struct notifier_block *nb, unsigned long val,
 	return NOTIFY_OK;
 }
 
+static int msm_thermal_simple_parse_pid(struct device_node *node,
+					struct thermal_drv *t)
+{
+	struct thermal_pid *pid;
+	u32 imax;
+	int ret;
+
+	pid = kzalloc(sizeof(*pid), GFP_KERNEL);
+	if (!pid)
+		return -ENOMEM;
+
+	ret = OF_READ_U32(node, "qcom,pid-setpoint-deg", pid->setpoint_deg);
+	if (ret)
+		goto free_pid;
+
+	ret = OF_READ_U32(node, "qcom,sustainable-mw", pid->sustainable_mw);
+	if (ret)
+		goto free_pid;
+
+	ret = OF_READ_U32(node, "qcom,pid-kp", pid->kp);
+	if (ret)
+		goto free_pid;
+
+	ret = OF_READ_U32(node, "qcom,silver-max-mw",
+			  pid->c[PID_SILVER].max_mw);
+	if (ret)
+		goto free_pid;
+
+	ret = OF_READ_U32(node, "qcom,gold-max-mw", pid->c[PID_GOLD].max_mw);
+	if (ret)
+		goto free_pid;
+
+	/* The integral and derivative terms and GPU throttling are optional */
+	of_property_read_u32(node, "qcom,pid-ki", &pid->ki);
+	of_property_read_u32(node, "qcom,pid-kd", &pid->kd);
+	of_property_read_u32(node, "qcom,gpu-max-mw", &pid->c[PID_GPU].max_mw);
+
+	/* By default let the integral term cancel out the whole budget */
+	if (!of_property_read_u32(node, "qcom,pid-integral-max", &imax))
+		pid->integral_max = imax;
+	else if (pid->ki)
+		pid->integral_max = pid->sustainable_mw / pid->ki;
+
+	t->pid = pid;
+	return 0;
+
+free_pid:
+	kfree(pid);
+	return ret;
+}
+
 static int msm_thermal_simple_parse_dt(struct platform_device *pdev,
 				       struct thermal_drv *t)
 {
 	struct device_node *child, *node = pdev->dev.of_node;
+	u32 sustained;
 	int ret;
 
 	t->vadc_dev = qpnp_get_vadc(&pdev->dev, "thermal");
@@ -147,6 +479,10 @@ static int msm_thermal_simple_parse_dt(struct platform_device *pdev,
 	/* Convert polling milliseconds to jiffies */
 	t->poll_jiffies = msecs_to_jiffies(t->poll_jiffies);
 
+	/* A PID setpoint replaces the stepped zones */
+	if (of_find_property(node, "qcom,pid-setpoint-deg", NULL))
+		return msm_thermal_simple_parse_pid(node, t);
+
 	/* Calculate the number of zones */
 	for_each_child_of_node(node, child)
 		t->nr_zones++;
@@ -183,6 +519,16 @@ static int msm_thermal_simple_parse_dt(struct platform_device *pdev,
 			goto free_zones;
 	}
 
+	/* The zone that can be held indefinitely, for sustained mode */
+	if (!of_property_read_u32(node, "qcom,sustained-zone", &sustained)) {
+		if (sustained >= t->nr_zones) {
+			pr_err("Invalid sustained zone %u\n", sustained);
+			ret = -EINVAL;
+			goto free_zones;
+		}
+		t->sustained_zone = t->zones + sustained;
+	}
+
 	return 0;
 
 free_zones:
@@ -222,10 +568,12 @@ static int msm_thermal_simple_probe(struct platform_device *pdev)
 	/* Fire up the persistent worker */
 	INIT_DELAYED_WORK(&t->throttle_work, thermal_throttle_worker);
 	queue_delayed_work(t->wq, &t->throttle_work, t->start_delay * HZ);
+	thermal_drv_instance = t;
 
 	return 0;
 
 free_zones:
+	kfree(t->pid);
 	kfree(t->zones);
 destroy_wq:
 	destroy_workqueue(t->wq);
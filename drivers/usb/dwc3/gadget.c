@@ -2518,6 +2518,21 @@ static void dwc3_endpoint_transfer_complete(struct dwc3 *dwc,
 				usb_endpoint_xfer_isoc(dep->endpoint.desc)))
 		dep->flags &= ~DWC3_EP_BUSY;
 
+	/*
+	 * Requests queued while the previous batch was in flight only sit
+	 * on request_list. Start them as the next batch right away rather
+	 * than waiting for the host to poll and raise XferNotReady.
+	 */
+	if (is_xfer_complete && !(dep->flags & DWC3_EP_BUSY) &&
+			(dep->flags & DWC3_EP_ENABLED) &&
+			!usb_endpoint_xfer_isoc(dep->endpoint.desc) &&
+			!list_empty(&dep->request_list)) {
+		int ret = __dwc3_gadget_kick_transfer(dep, 0, 1);
+
+		if (ret && ret != -EBUSY)
+			dbg_event(dep->number, "XfC QUEUE", ret);
+	}
+
 	/*
 	 * WORKAROUND: This is the 2nd half of U1/U2 -> U0 workaround.
 	 * See dwc3_gadget_linksts_change_interrupt() for 1st half.
@@ -432,6 +432,7 @@ struct mdss_data_type {
 	bool hflip_buffer_reused;
 
 	u32 disable_prefill;
+	u32 disable_perf_cache;
 	u32 *clock_levels;
 	u32 nclk_lvl;
 
@@ -89,6 +89,10 @@
 bool __read_mostly backlight_dimmer = true;
 module_param(backlight_dimmer, bool, 0644);
 
+/* frames this many vsyncs late fire the trace snapshot trigger, 0 = never */
+static unsigned int snapshot_missed_vsync = 2;
+module_param(snapshot_missed_vsync, uint, 0644);
+
 static struct fb_info *fbi_list[MAX_FBI_LIST];
 static int fbi_list_index;
 
@@ -559,6 +563,59 @@ static ssize_t mdss_fb_get_fps_info(struct device *dev,
 
 }
 
+static ssize_t mdss_fb_get_frame_stats(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct msm_fb_frame_stats *stats = &mfd->frame_stats;
+	struct msm_fb_frame_stats snap;
+	unsigned long flags;
+	int i, cnt;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	snap = *stats;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	cnt = scnprintf(buf, PAGE_SIZE, "bins_ms:");
+	for (i = 0; i < MDSS_FB_FRAME_HIST_BINS - 1; i++)
+		cnt += scnprintf(buf + cnt, PAGE_SIZE - cnt, " <%d", 1 << i);
+	cnt += scnprintf(buf + cnt, PAGE_SIZE - cnt, " inf\ncommit:");
+	for (i = 0; i < MDSS_FB_FRAME_HIST_BINS; i++)
+		cnt += scnprintf(buf + cnt, PAGE_SIZE - cnt, " %u",
+			snap.commit_hist[i]);
+	cnt += scnprintf(buf + cnt, PAGE_SIZE - cnt, "\nkickoff_to_vsync:");
+	for (i = 0; i < MDSS_FB_FRAME_HIST_BINS; i++)
+		cnt += scnprintf(buf + cnt, PAGE_SIZE - cnt, " %u",
+			snap.vsync_hist[i]);
+	cnt += scnprintf(buf + cnt, PAGE_SIZE - cnt,
+		"\nframes: %u\nmissed_vsync: %u\ntimeouts: %u\nmax_vsync_us: %u\n",
+		snap.frames, snap.missed_vsync, snap.timeouts,
+		snap.max_vsync_us);
+
+	return cnt;
+}
+
+static ssize_t mdss_fb_reset_frame_stats(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct msm_fb_frame_stats *stats = &mfd->frame_stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	memset(stats->commit_hist, 0, sizeof(stats->commit_hist));
+	memset(stats->vsync_hist, 0, sizeof(stats->vsync_hist));
+	stats->frames = 0;
+	stats->missed_vsync = 0;
+	stats->timeouts = 0;
+	stats->max_vsync_us = 0;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	return count;
+}
+
 static ssize_t mdss_fb_get_idle_time(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -591,6 +648,35 @@ static ssize_t mdss_fb_set_idle_time(struct device *dev,
 	return count;
 }
 
+static ssize_t mdss_fb_get_commit_pipeline(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", mfd->commit_pipeline);
+}
+
+static ssize_t mdss_fb_set_commit_pipeline(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	bool enable;
+	int rc;
+
+	rc = strtobool(buf, &enable);
+	if (rc) {
+		pr_err("invalid input. rc=%d\n", rc);
+		return rc;
+	}
+
+	pr_debug("fb%d commit pipeline = %d\n", mfd->index, enable);
+	mfd->commit_pipeline = enable;
+
+	return count;
+}
+
 static ssize_t mdss_fb_get_idle_notify(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -960,6 +1046,8 @@ static DEVICE_ATTR(show_blank_event, S_IRUGO, mdss_mdp_show_blank_event, NULL);
 static DEVICE_ATTR(idle_time, S_IRUGO | S_IWUSR | S_IWGRP,
 	mdss_fb_get_idle_time, mdss_fb_set_idle_time);
 static DEVICE_ATTR(idle_notify, S_IRUGO, mdss_fb_get_idle_notify, NULL);
+static DEVICE_ATTR(commit_pipeline, S_IRUGO | S_IWUSR,
+	mdss_fb_get_commit_pipeline, mdss_fb_set_commit_pipeline);
 static DEVICE_ATTR(idle_state, S_IRUGO, mdss_fb_get_idle_state, NULL);
 static DEVICE_ATTR(msm_fb_panel_info, S_IRUGO, mdss_fb_get_panel_info, NULL);
 static DEVICE_ATTR(msm_fb_src_split_info, S_IRUGO, mdss_fb_get_src_split_info,
@@ -972,6 +1060,8 @@ static DEVICE_ATTR(msm_fb_dfps_mode, S_IRUGO | S_IWUSR,
 	mdss_fb_get_dfps_mode, mdss_fb_change_dfps_mode);
 static DEVICE_ATTR(measured_fps, S_IRUGO | S_IWUSR | S_IWGRP,
 	mdss_fb_get_fps_info, NULL);
+static DEVICE_ATTR(frame_stats, S_IRUGO | S_IWUSR | S_IWGRP,
+	mdss_fb_get_frame_stats, mdss_fb_reset_frame_stats);
 static DEVICE_ATTR(msm_fb_persist_mode, S_IRUGO | S_IWUSR,
 	mdss_fb_get_persist_mode, mdss_fb_change_persist_mode);
 static DEVICE_ATTR(idle_power_collapse, S_IRUGO, mdss_fb_idle_pc_notify, NULL);
@@ -982,6 +1072,7 @@ static struct attribute *mdss_fb_attrs[] = {
 	&dev_attr_show_blank_event.attr,
 	&dev_attr_idle_time.attr,
 	&dev_attr_idle_notify.attr,
+	&dev_attr_commit_pipeline.attr,
 	&dev_attr_idle_state.attr,
 	&dev_attr_msm_fb_panel_info.attr,
 	&dev_attr_msm_fb_src_split_info.attr,
@@ -989,6 +1080,7 @@ static struct attribute *mdss_fb_attrs[] = {
 	&dev_attr_msm_fb_panel_status.attr,
 	&dev_attr_msm_fb_dfps_mode.attr,
 	&dev_attr_measured_fps.attr,
+	&dev_attr_frame_stats.attr,
 	&dev_attr_msm_fb_persist_mode.attr,
 	&dev_attr_idle_power_collapse.attr,
 	NULL,
@@ -1362,11 +1454,13 @@ static int mdss_fb_probe(struct platform_device *pdev)
 	fbi_list[fbi_list_index++] = fbi;
 
 	platform_set_drvdata(pdev, mfd);
+	device_enable_resume_first(&pdev->dev);
 
 	rc = mdss_fb_register(mfd);
 	if (rc)
 		return rc;
 
+	spin_lock_init(&mfd->frame_stats.lock);
 	mdss_fb_create_sysfs(mfd);
 	mdss_fb_send_panel_event(mfd, MDSS_EVENT_FB_REGISTERED, fbi);
 
@@ -3138,6 +3232,92 @@ static void mdss_fb_release_kickoff(struct msm_fb_data_type *mfd)
 	}
 }
 
+static inline u32 __mdss_fb_frame_hist_bin(s64 us)
+{
+	int bin = us < 1000 ? 0 : fls((u32)min_t(s64, us / 1000, U16_MAX));
+
+	return min(bin, MDSS_FB_FRAME_HIST_BINS - 1);
+}
+
+/*
+ * mdss_fb_update_frame_stats() - account frame pacing of a display event
+ * @mfd:	Framebuffer data structure for display
+ * @event:	frame event sent by the interface
+ *
+ * Kickoffs are matched with the frame done or timeout events in order. As
+ * a failed kickoff never completes, a new kickoff retires the oldest one
+ * once more than MDSS_FB_FRAME_INFLIGHT kickoffs would be outstanding.
+ */
+static void mdss_fb_update_frame_stats(struct msm_fb_data_type *mfd,
+	unsigned long event)
+{
+	struct msm_fb_frame_stats *stats = &mfd->frame_stats;
+	ktime_t now, begin;
+	s64 commit_us = 0, vsync_us = 0;
+	u32 period_us, missed = 0;
+	unsigned long flags;
+
+	if ((event != MDP_NOTIFY_FRAME_BEGIN) &&
+	    (event != MDP_NOTIFY_FRAME_FLUSHED) &&
+	    (event != MDP_NOTIFY_FRAME_DONE) &&
+	    (event != MDP_NOTIFY_FRAME_TIMEOUT))
+		return;
+
+	now = ktime_get();
+	spin_lock_irqsave(&stats->lock, flags);
+	switch (event) {
+	case MDP_NOTIFY_FRAME_BEGIN:
+		if ((stats->begin_cnt - stats->done_cnt) >=
+				MDSS_FB_FRAME_INFLIGHT)
+			stats->done_cnt = stats->begin_cnt -
+				MDSS_FB_FRAME_INFLIGHT + 1;
+		stats->begin_time[stats->begin_cnt % MDSS_FB_FRAME_INFLIGHT] =
+			now;
+		stats->begin_cnt++;
+		stats->flush_pending = true;
+		break;
+	case MDP_NOTIFY_FRAME_FLUSHED:
+		if (!stats->flush_pending)
+			break;
+		stats->flush_pending = false;
+		begin = stats->begin_time[(stats->begin_cnt - 1) %
+			MDSS_FB_FRAME_INFLIGHT];
+		commit_us = ktime_us_delta(now, begin);
+		stats->commit_hist[__mdss_fb_frame_hist_bin(commit_us)]++;
+		break;
+	case MDP_NOTIFY_FRAME_TIMEOUT:
+		if (stats->begin_cnt == stats->done_cnt)
+			break;
+		stats->done_cnt++;
+		stats->timeouts++;
+		break;
+	case MDP_NOTIFY_FRAME_DONE:
+		if (stats->begin_cnt == stats->done_cnt)
+			break;
+		begin = stats->begin_time[stats->done_cnt %
+			MDSS_FB_FRAME_INFLIGHT];
+		stats->done_cnt++;
+		vsync_us = ktime_us_delta(now, begin);
+		stats->vsync_hist[__mdss_fb_frame_hist_bin(vsync_us)]++;
+		stats->max_vsync_us = max_t(u32, stats->max_vsync_us, vsync_us);
+		stats->frames++;
+
+		period_us = USEC_PER_SEC /
+			max_t(u32, mdss_panel_get_framerate(mfd->panel_info), 1);
+		missed = (u32)div_u64(vsync_us, period_us);
+		stats->missed_vsync += missed;
+		break;
+	}
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	if (commit_us || vsync_us)
+		trace_mdp_frame_stats(mfd->index, (u32)commit_us,
+			(u32)vsync_us, missed);
+
+	if (snapshot_missed_vsync && missed >= snapshot_missed_vsync)
+		tracing_snapshot_trigger("mdss missed vsync");
+}
+
 /**
  * __mdss_fb_sync_buf_done_callback() - process async display events
  * @p:		Notifier block registered for async events.
@@ -3158,6 +3338,8 @@ static int __mdss_fb_sync_buf_done_callback(struct notifier_block *p,
 	mfd = container_of(sync_pt_data, struct msm_fb_data_type,
 		mdp_sync_pt_data);
 
+	mdss_fb_update_frame_stats(mfd, event);
+
 	switch (event) {
 	case MDP_NOTIFY_FRAME_BEGIN:
 		if (mfd->idle_time && !mod_delayed_work(system_wq,
@@ -3438,6 +3620,55 @@ static void mdss_fb_update_resolution(struct msm_fb_data_type *mfd,
 	mdss_panelinfo_to_fb_var(pinfo, var);
 }
 
+/*
+ * __mdss_fb_can_pipeline_commit() - check if a commit can be prepared early
+ * @mfd:	Framebuffer data structure for display
+ * @commit:	atomic commit being processed
+ *
+ * With commit pipelining, layer validation, bandwidth calculation, buffer
+ * mapping and fence creation for the next frame run as soon as the current
+ * frame has been programmed, overlapping with its wait for completion. The
+ * frame is only handed to the display thread once the previous one retires,
+ * so at most one frame is in flight and one is prepared. Commits that change
+ * state read by the in-flight frame (brightness, mode switch, writeback
+ * output) are kept serial.
+ */
+static bool __mdss_fb_can_pipeline_commit(struct msm_fb_data_type *mfd,
+	struct mdp_layer_commit_v1 *commit)
+{
+	if (!mfd->commit_pipeline || !mfd->wait_for_kickoff)
+		return false;
+
+	if (commit->flags & MDP_COMMIT_UPDATE_BRIGHTNESS)
+		return false;
+
+	if ((mfd->panel.type == WRITEBACK_PANEL) ||
+		(mfd->switch_state != MDSS_MDP_NO_UPDATE_REQUESTED))
+		return false;
+
+	return true;
+}
+
+/*
+ * __mdss_fb_drop_commit() - drop a prepared commit that was never queued
+ * @mfd:	Framebuffer data structure for display
+ *
+ * Fences for a prepared frame were created assuming it would be committed,
+ * so account for it the same way as a commit that fails in the display
+ * thread to keep the timelines in step.
+ */
+static void __mdss_fb_drop_commit(struct msm_fb_data_type *mfd)
+{
+	struct msm_sync_pt_data *sync_pt_data = &mfd->mdp_sync_pt_data;
+
+	atomic_inc(&sync_pt_data->commit_cnt);
+	mdss_fb_signal_timeline(sync_pt_data);
+
+	if ((mfd->panel.type == MIPI_CMD_PANEL) &&
+		(mfd->mdp.signal_retire_fence))
+		mfd->mdp.signal_retire_fence(mfd, 1);
+}
+
 int mdss_fb_atomic_commit(struct fb_info *info,
 	struct mdp_layer_commit  *commit, struct file *file)
 {
@@ -3445,7 +3676,7 @@ int mdss_fb_atomic_commit(struct fb_info *info,
 	struct mdp_layer_commit_v1 *commit_v1;
 	struct mdp_output_layer *output_layer;
 	struct mdss_panel_info *pinfo;
-	bool wait_for_finish, wb_change = false;
+	bool wait_for_finish, wb_change = false, pipelined;
 	int ret = -EPERM;
 	u32 old_xres, old_yres, old_format;
 
@@ -3505,7 +3736,11 @@ int mdss_fb_atomic_commit(struct fb_info *info,
 		}
 		goto end;
 	} else {
-		ret = mdss_fb_pan_idle(mfd);
+		pipelined = __mdss_fb_can_pipeline_commit(mfd, commit_v1);
+		if (pipelined)
+			ret = mdss_fb_wait_for_kickoff(mfd);
+		else
+			ret = mdss_fb_pan_idle(mfd);
 		if (ret) {
 			pr_err("pan display idle call failed\n");
 			goto end;
@@ -3519,6 +3754,22 @@ int mdss_fb_atomic_commit(struct fb_info *info,
 			pr_err("atomic pre commit failed\n");
 			goto end;
 		}
+
+		/*
+		 * The frame is fully prepared; wait for the previous one to
+		 * retire before handing it to the display thread. If that
+		 * never happens the prepared frame is dropped rather than
+		 * queued behind a stuck one.
+		 */
+		if (pipelined) {
+			ret = mdss_fb_pan_idle(mfd);
+			if (ret) {
+				pr_err("fb%d: dropping prepared commit rc=%d\n",
+					mfd->index, ret);
+				__mdss_fb_drop_commit(mfd);
+				goto end;
+			}
+		}
 	}
 
 	wait_for_finish = commit_v1->flags & MDP_COMMIT_WAIT_FOR_FINISH;
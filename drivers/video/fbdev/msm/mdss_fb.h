@@ -266,6 +266,39 @@ struct msm_fb_fps_info {
 	u32 measured_fps;
 };
 
+/* log2 buckets of 1ms, 2ms, 4ms, ... with the last one open ended */
+#define MDSS_FB_FRAME_HIST_BINS	8
+/* kickoffs that can be outstanding, one on screen and one programmed */
+#define MDSS_FB_FRAME_INFLIGHT	2
+
+/*
+ * struct msm_fb_frame_stats - frame pacing statistics of a display
+ * @lock:		protects the stats, frame done may come from irq
+ * @begin_time:		kickoff start time of the outstanding frames
+ * @begin_cnt:		number of kickoffs started
+ * @done_cnt:		number of kickoffs retired by frame done or timeout
+ * @flush_pending:	latest kickoff has not been flushed yet
+ * @commit_hist:	kickoff start to hw flush, i.e. commit duration
+ * @vsync_hist:		kickoff start to frame done on the panel
+ * @frames:		frames done since the last reset
+ * @missed_vsync:	vsyncs passed while a frame was waiting to be shown
+ * @timeouts:		frames that timed out waiting for frame done
+ * @max_vsync_us:	worst kickoff to frame done latency
+ */
+struct msm_fb_frame_stats {
+	spinlock_t lock;
+	ktime_t begin_time[MDSS_FB_FRAME_INFLIGHT];
+	u32 begin_cnt;
+	u32 done_cnt;
+	bool flush_pending;
+	u32 commit_hist[MDSS_FB_FRAME_HIST_BINS];
+	u32 vsync_hist[MDSS_FB_FRAME_HIST_BINS];
+	u32 frames;
+	u32 missed_vsync;
+	u32 timeouts;
+	u32 max_vsync_us;
+};
+
 struct msm_fb_data_type {
 	u32 key;
 	u32 index;
@@ -285,6 +318,7 @@ struct msm_fb_data_type {
 	int idle_time;
 	u32 idle_state;
 	struct msm_fb_fps_info fps_info;
+	struct msm_fb_frame_stats frame_stats;
 	struct delayed_work idle_notify_work;
 
 	bool atomic_commit_pending;
@@ -364,6 +398,7 @@ struct msm_fb_data_type {
 	bool mdss_fb_split_stored;
 
 	u32 wait_for_kickoff;
+	bool commit_pipeline;
 	u32 thermal_level;
 
 	int fb_mmap_type;
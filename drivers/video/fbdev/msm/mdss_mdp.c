@@ -2952,6 +2952,8 @@ static int mdss_mdp_probe(struct platform_device *pdev)
 	mdata->pdev = pdev;
 	platform_set_drvdata(pdev, mdata);
 	mdss_res = mdata;
+	/* the fb devices are children of mdp and are ordered by the PM core */
+	device_enable_resume_first(&pdev->dev);
 	mutex_init(&mdata->reg_lock);
 	mutex_init(&mdata->reg_bus_lock);
 	mutex_init(&mdata->bus_lock);
@@ -387,6 +387,38 @@ struct mdss_mdp_perf_params {
 	DECLARE_BITMAP(bw_vote_mode, MDSS_MDP_BW_MODE_MAX);
 };
 
+/*
+ * Everything mdss_mdp_perf_calc_pipe() depends on. When a pipe is
+ * recalculated with an identical key its previous result is reused.
+ */
+struct mdss_mdp_perf_key {
+	struct mdss_mdp_mixer *mixer;
+	struct mdss_rect src;
+	struct mdss_rect dst;
+	struct mdss_rect roi;
+	u32 calc_flags;
+	u32 pipe_flags;
+	u32 format;
+	u32 vert_deci;
+	u32 bwc_mode;
+	u32 src_split_req;
+	u32 scaler_en;
+	u32 multirect_mode;
+	u32 multirect_next_y;
+	u32 frame_rate;
+	struct mult_factor comp_ratio;
+	struct mult_factor clk_factor;
+	u32 fps;
+	u32 v_total;
+	u32 h_total;
+	u32 xres;
+	u32 is_video_mode;
+	u32 disable_prefill;
+	u32 smp_bytes;
+	u32 vbp_fac;
+	u32 prefill_us;
+};
+
 struct mdss_mdp_writeback {
 	u32 num;
 	char __iomem *base;
@@ -883,6 +915,7 @@ struct mdss_mdp_pipe {
 
 	/* flag to re-store roi in case of pu dual-roi validation error */
 	bool restore_roi;
+	struct mdss_rect damage_dst; /* dst as of the last kickoff */
 
 	/* compression ratio from the source format */
 	struct mult_factor comp_ratio;
@@ -923,6 +956,10 @@ struct mdss_mdp_pipe {
 	u8 supported_formats[BITS_TO_BYTES(MDP_IMGTYPE_LIMIT1)];
 
 	struct mdss_mdp_pipe_multirect_params multirect;
+
+	struct mdss_mdp_perf_key perf_key;
+	struct mdss_mdp_perf_params perf_cache;
+	bool perf_cache_valid;
 };
 
 struct mdss_mdp_writeback_arg {
@@ -969,6 +1006,7 @@ struct mdss_overlay_private {
 
 	int ad_state;
 	int dyn_pu_state;
+	bool auto_pu;
 
 	bool handoff;
 	u32 splash_mem_addr;
@@ -1832,6 +1870,7 @@ int mdss_mdp_pp_resume(struct msm_fb_data_type *mfd);
 void mdss_mdp_pp_dest_scaler_resume(struct mdss_mdp_ctl *ctl);
 
 int mdss_mdp_pp_setup(struct mdss_mdp_ctl *ctl);
+bool mdss_mdp_pp_is_dirty(struct mdss_mdp_ctl *ctl);
 int mdss_mdp_pp_setup_locked(struct mdss_mdp_ctl *ctl,
 				struct mdss_mdp_pp_program_info *info);
 int mdss_mdp_pipe_pp_setup(struct mdss_mdp_pipe *pipe, u32 *op);
@@ -1960,6 +1999,7 @@ void mdss_mdp_crop_rect(struct mdss_rect *src_rect,
 void rect_copy_mdss_to_mdp(struct mdp_rect *user, struct mdss_rect *kernel);
 void rect_copy_mdp_to_mdss(struct mdp_rect *user, struct mdss_rect *kernel);
 bool mdss_rect_overlap_check(struct mdss_rect *rect1, struct mdss_rect *rect2);
+void mdss_rect_union(struct mdss_rect *res_rect, const struct mdss_rect *rect);
 void mdss_rect_split(struct mdss_rect *in_roi, struct mdss_rect *l_roi,
 	struct mdss_rect *r_roi, u32 splitpoint);
 
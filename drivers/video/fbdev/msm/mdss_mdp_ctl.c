@@ -21,6 +21,7 @@
 #include <linux/sort.h>
 #include <linux/clk.h>
 #include <linux/bitmap.h>
+#include <linux/bw_hwmon_hint.h>
 
 #include <soc/qcom/event_timer.h>
 #include "mdss_fb.h"
@@ -29,6 +30,7 @@
 #include "mdss_debug.h"
 #include "mdss_dsi.h"
 
+#define MDSS_BW_HINT_MS 100
 #define MDSS_MDP_QSEED3_VER_DOWNSCALE_LIM 2
 #define NUM_MIXERCFG_REGS 3
 #define MDSS_MDP_WB_OUTPUT_BPP	3
@@ -1099,6 +1101,57 @@ exit:
 	return prefill_per_pipe;
 }
 
+/*
+ * __mdss_mdp_perf_fill_key() - collect the inputs of a pipe perf calculation
+ *
+ * Static UI commits restage the same pipes with the same geometry every
+ * frame, so keep the inputs together with the last result per pipe. This
+ * includes state shared with other interfaces (prefill blanking factors)
+ * and the clock fudge factor tunable, so a change there is not masked.
+ */
+static void __mdss_mdp_perf_fill_key(struct mdss_mdp_pipe *pipe,
+	struct mdss_mdp_perf_key *key, struct mdss_rect *roi, u32 flags,
+	u32 fps, u32 v_total, u32 h_total, u32 xres)
+{
+	struct mdss_data_type *mdata = mdss_mdp_get_mdata();
+	struct mdss_mdp_mixer *mixer = pipe->mixer_left;
+
+	memset(key, 0, sizeof(*key));
+
+	key->mixer = mixer;
+	key->src = pipe->src;
+	key->dst = pipe->dst;
+	if (roi)
+		key->roi = *roi;
+	key->calc_flags = flags;
+	key->pipe_flags = pipe->flags;
+	key->format = pipe->src_fmt->format;
+	key->vert_deci = pipe->vert_deci;
+	key->bwc_mode = pipe->bwc_mode;
+	key->src_split_req = pipe->src_split_req;
+	key->scaler_en = pipe->scaler.enable;
+	key->multirect_mode = pipe->multirect.mode;
+	if ((pipe->multirect.mode == MDSS_MDP_PIPE_MULTIRECT_SERIAL) &&
+	    pipe->multirect.next) {
+		struct mdss_mdp_pipe *next_pipe = pipe->multirect.next;
+
+		key->multirect_next_y = next_pipe->src.y;
+	}
+	key->frame_rate = pipe->frame_rate;
+	key->comp_ratio = pipe->comp_ratio;
+	key->clk_factor = mdata->clk_factor;
+	key->fps = fps;
+	key->v_total = v_total;
+	key->h_total = h_total;
+	key->xres = xres;
+	key->is_video_mode = mixer->ctl->is_video_mode;
+	key->disable_prefill = mdata->disable_prefill ||
+		mixer->ctl->disable_prefill;
+	key->smp_bytes = mdss_mdp_smp_get_size(pipe);
+	key->vbp_fac = mdss_mdp_get_vbp_factor_max(mixer->ctl);
+	key->prefill_us = __get_min_prefill_line_time_us(mixer->ctl);
+}
+
 /**
  * mdss_mdp_perf_calc_pipe() - calculate performance numbers required by pipe
  * @pipe:	Source pipe struct containing updated pipe params
@@ -1135,6 +1188,8 @@ int mdss_mdp_perf_calc_pipe(struct mdss_mdp_pipe *pipe,
 	struct mdss_mdp_prefill_params prefill_params;
 	struct mdss_data_type *mdata = mdss_mdp_get_mdata();
 	bool calc_smp_size = false;
+	bool use_cache = !mdata->disable_perf_cache;
+	struct mdss_mdp_perf_key key;
 
 	if (!pipe || !perf || !pipe->mixer_left)
 		return -EINVAL;
@@ -1165,6 +1220,17 @@ int mdss_mdp_perf_calc_pipe(struct mdss_mdp_pipe *pipe,
 
 	mixer->ctl->frame_rate = fps;
 
+	if (use_cache) {
+		__mdss_mdp_perf_fill_key(pipe, &key, roi, flags, fps, v_total,
+			h_total, xres);
+		if (pipe->perf_cache_valid &&
+		    !memcmp(&key, &pipe->perf_key, sizeof(key))) {
+			*perf = pipe->perf_cache;
+			pr_debug("pnum=%d reusing cached perf\n", pipe->num);
+			return 0;
+		}
+	}
+
 	/* crop rectangles */
 	if (roi && !mixer->ctl->is_video_mode && !pipe->src_split_req)
 		mdss_mdp_crop_rect(&src, &dst, roi, true);
@@ -1243,6 +1309,14 @@ exit:
 		 perf->bw_prefill, perf->prefill_bytes, mdata->disable_prefill ?
 		 "prefill is disabled" : "");
 
+	if (use_cache) {
+		pipe->perf_key = key;
+		pipe->perf_cache = *perf;
+		pipe->perf_cache_valid = true;
+	} else {
+		pipe->perf_cache_valid = false;
+	}
+
 	return 0;
 }
 
@@ -2150,6 +2224,13 @@ static void mdss_mdp_ctl_update_client_vote(struct mdss_data_type *mdata,
 
 	mdss_bus_scale_set_quota(nrt_client ? MDSS_MDP_NRT : MDSS_MDP_RT,
 		bus_ab_quota, bus_ib_quota);
+	/*
+	 * Let the DDR monitor ramp ahead of a heavier frame; the hint is
+	 * only refreshed when the real time vote goes up.
+	 */
+	if (!nrt_client)
+		bw_hwmon_hint(BW_HWMON_HINT_DISPLAY, bus_ab_quota >> 20,
+			MDSS_BW_HINT_MS);
 	pr_debug("client:%s ab=%llu ib=%llu\n", nrt_client ? "nrt" : "rt",
 		bus_ab_quota, bus_ib_quota);
 }
@@ -26,6 +26,7 @@
 #include <linux/memblock.h>
 #include <linux/sort.h>
 #include <linux/kmemleak.h>
+#include <linux/input.h>
 #include <sw_sync.h>
 
 #include <soc/qcom/event_timer.h>
@@ -2153,6 +2154,236 @@ end:
 	return ret;
 }
 
+/*
+ * __overlay_auto_pu_active() - check if kernel ROI computation can be used
+ *
+ * Applies to single ROI partial update on command mode panels driven by a
+ * single layer mixer, once the panel has been updated at least once.
+ */
+static bool __overlay_auto_pu_active(struct msm_fb_data_type *mfd)
+{
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	struct mdss_mdp_ctl *ctl = mfd_to_ctl(mfd);
+	struct mdss_panel_info *pinfo = &ctl->panel_data->panel_info;
+
+	return mdp5_data->auto_pu && (pinfo->type == MIPI_CMD_PANEL) &&
+		(pinfo->partial_update_enabled == PU_SINGLE_ROI) &&
+		!is_split_lm(mfd) && ctl->play_cnt &&
+		(ctl->pending_mode_switch != SWITCH_RESOLUTION) &&
+		!is_dest_scaling_enable(ctl->mixer_left);
+}
+
+static bool __overlay_buf_same(struct mdss_mdp_data *a,
+	struct mdss_mdp_data *b)
+{
+	int i;
+
+	if (a->num_planes != b->num_planes)
+		return false;
+
+	for (i = 0; i < a->num_planes; i++) {
+		if (!a->p[i].srcp_dma_buf ||
+		    (a->p[i].srcp_dma_buf != b->p[i].srcp_dma_buf) ||
+		    (a->p[i].offset != b->p[i].offset))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * __overlay_pipe_damaged() - check if a pipe output changes on this kickoff
+ *
+ * A pipe is damaged if its configuration changed or if it flips to another
+ * buffer. Queueing the buffer that is already on screen again is not seen
+ * as a change; clients rendering into the displayed buffer must provide
+ * their own ROI.
+ */
+static bool __overlay_pipe_damaged(struct mdss_mdp_pipe *pipe)
+{
+	struct mdss_mdp_data *buf, *next;
+
+	if (pipe->params_changed || pipe->dirty)
+		return true;
+
+	buf = list_first_entry_or_null(&pipe->buf_queue,
+			struct mdss_mdp_data, pipe_list);
+	if (!buf)
+		return false;
+
+	if (buf->state != MDP_BUF_STATE_ACTIVE)
+		return true;
+
+	if (list_is_last(&buf->pipe_list, &pipe->buf_queue))
+		return false;
+
+	next = list_next_entry(buf, pipe_list);
+	if (!list_is_last(&next->pipe_list, &pipe->buf_queue))
+		return true;
+
+	return !__overlay_buf_same(buf, next);
+}
+
+static void __overlay_align_roi(struct mdss_panel_roi_alignment *align,
+	struct mdss_rect *roi, u32 full_w, u32 full_h)
+{
+	u32 l = roi->x, t = roi->y;
+	u32 r = roi->x + roi->w, b = roi->y + roi->h;
+
+	if (align->xstart_pix_align)
+		l = rounddown(l, align->xstart_pix_align);
+	if (align->width_pix_align)
+		r = l + roundup(r - l, align->width_pix_align);
+	if (align->min_width && ((r - l) < align->min_width))
+		r = l + align->min_width;
+
+	if (align->ystart_pix_align)
+		t = rounddown(t, align->ystart_pix_align);
+	if (align->height_pix_align)
+		b = t + roundup(b - t, align->height_pix_align);
+	if (align->min_height && ((b - t) < align->min_height))
+		b = t + align->min_height;
+
+	/* full width or height is always a valid ROI extent */
+	if (r > full_w) {
+		l = 0;
+		r = full_w;
+	}
+	if (b > full_h) {
+		t = 0;
+		b = full_h;
+	}
+
+	*roi = (struct mdss_rect){l, t, (r - l), (b - t)};
+}
+
+/*
+ * __overlay_calc_damage_roi() - derive the partial update ROI from layers
+ * @mfd:	Msm frame buffer structure associated with fb device
+ * @roi:	returns the ROI covering all changed pipes
+ *
+ * Used when user space does not provide an ROI. The ROI covers the old and
+ * new position of every changed pipe and of the pipes being removed. It is
+ * then grown until every staged pipe meets the partial update rules checked
+ * by __is_roi_valid(), i.e. overlaps the ROI and, if scaled, lies fully in
+ * it. Returns false if a full frame update should be done.
+ */
+static bool __overlay_calc_damage_roi(struct msm_fb_data_type *mfd,
+	struct mdss_rect *roi)
+{
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	struct mdss_mdp_ctl *ctl = mfd_to_ctl(mfd);
+	struct mdss_panel_info *pinfo = &ctl->panel_data->panel_info;
+	struct mdss_rect damage = {0}, res;
+	struct mdss_mdp_pipe *pipe;
+	u32 full_w = ctl->mixer_left->width;
+	u32 full_h = ctl->mixer_left->height;
+	bool grown, scaled;
+
+	if (!__overlay_auto_pu_active(mfd))
+		return false;
+
+	list_for_each_entry(pipe, &mdp5_data->pipes_cleanup, list)
+		mdss_rect_union(&damage, &pipe->damage_dst);
+
+	list_for_each_entry(pipe, &mdp5_data->pipes_used, list) {
+		if (!__overlay_pipe_damaged(pipe))
+			continue;
+
+		mdss_rect_union(&damage, &pipe->dst);
+		mdss_rect_union(&damage, &pipe->damage_dst);
+	}
+
+	if (!damage.w || !damage.h)
+		return false;
+
+	do {
+		grown = false;
+		__overlay_align_roi(&pinfo->roi_alignment, &damage,
+			full_w, full_h);
+
+		list_for_each_entry(pipe, &mdp5_data->pipes_used, list) {
+			scaled = pipe->scaler.enable ||
+				(pipe->src.w != pipe->dst.w) ||
+				(pipe->src.h != pipe->dst.h);
+
+			mdss_mdp_intersect_rect(&res, &pipe->dst, &damage);
+			if (mdss_rect_cmp(&res, &pipe->dst) ||
+			    (res.w && res.h && !scaled))
+				continue;
+
+			mdss_rect_union(&damage, &pipe->dst);
+			grown = true;
+		}
+	} while (grown);
+
+	if ((damage.w == full_w) && (damage.h == full_h))
+		return false;
+
+	pr_debug("fb%d damage roi: %d %d %d %d\n", mfd->index,
+		damage.x, damage.y, damage.w, damage.h);
+	*roi = damage;
+
+	return true;
+}
+
+/*
+ * __overlay_frame_unchanged() - check if a kickoff would repeat the screen
+ *
+ * Command mode panels keep the last frame in their own memory, so a commit
+ * that changes no pipe, ROI, post processing or brightness state does not
+ * need to be sent to the panel at all.
+ */
+static bool __overlay_frame_unchanged(struct msm_fb_data_type *mfd,
+	struct mdp_display_commit *data)
+{
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	struct mdp_rect zero_roi = {0};
+	struct mdss_mdp_pipe *pipe;
+
+	if (!data || !__overlay_auto_pu_active(mfd))
+		return false;
+
+	if (memcmp(&data->l_roi, &zero_roi, sizeof(zero_roi)) ||
+	    memcmp(&data->r_roi, &zero_roi, sizeof(zero_roi)) ||
+	    (data->flags & MDP_COMMIT_UPDATE_BRIGHTNESS))
+		return false;
+
+	if (mdp5_data->sd_enabled || mdp5_data->sc_enabled ||
+	    !list_empty(&mdp5_data->pipes_cleanup) ||
+	    list_empty(&mdp5_data->pipes_used))
+		return false;
+
+	list_for_each_entry(pipe, &mdp5_data->pipes_used, list) {
+		if (__overlay_pipe_damaged(pipe))
+			return false;
+	}
+
+	return !mdss_mdp_pp_is_dirty(mfd_to_ctl(mfd));
+}
+
+/*
+ * __overlay_drop_requeued_bufs() - release buffers of a skipped frame
+ *
+ * The frame only requeued the buffers already on screen, keep the active
+ * copies and let the new ones be freed with the next cleanup.
+ */
+static void __overlay_drop_requeued_bufs(struct msm_fb_data_type *mfd)
+{
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	struct mdss_mdp_pipe *pipe;
+	struct mdss_mdp_data *buf;
+
+	list_for_each_entry(pipe, &mdp5_data->pipes_used, list) {
+		buf = list_first_entry_or_null(&pipe->buf_queue,
+				struct mdss_mdp_data, pipe_list);
+		if (!buf || list_is_last(&buf->pipe_list, &pipe->buf_queue))
+			continue;
+
+		__pipe_buf_mark_cleanup(mfd, list_next_entry(buf, pipe_list));
+	}
+}
+
 static void __validate_and_set_roi(struct msm_fb_data_type *mfd,
 	struct mdp_display_commit *commit)
 {
@@ -2169,11 +2400,13 @@ static void __validate_and_set_roi(struct msm_fb_data_type *mfd,
 		goto set_roi;
 
 	if (!memcmp(&commit->l_roi, &tmp_roi, sizeof(tmp_roi)) &&
-	    !memcmp(&commit->r_roi, &tmp_roi, sizeof(tmp_roi)))
-		goto set_roi;
-
-	rect_copy_mdp_to_mdss(&commit->l_roi, &l_roi);
-	rect_copy_mdp_to_mdss(&commit->r_roi, &r_roi);
+	    !memcmp(&commit->r_roi, &tmp_roi, sizeof(tmp_roi))) {
+		if (!__overlay_calc_damage_roi(mfd, &l_roi))
+			goto set_roi;
+	} else {
+		rect_copy_mdp_to_mdss(&commit->l_roi, &l_roi);
+		rect_copy_mdp_to_mdss(&commit->r_roi, &r_roi);
+	}
 
 	/*
 	 * In case of dual partial update ROI, update the two ROIs to dual_roi
@@ -2307,6 +2540,14 @@ set_roi:
 			__restore_dest_scaler_roi(ctl);
 	}
 
+	list_for_each_entry(pipe, &mdp5_data->pipes_used, list) {
+		if (pipe->restore_roi)
+			rect_copy_mdp_to_mdss(&pipe->layer.dst_rect,
+				&pipe->damage_dst);
+		else
+			pipe->damage_dst = pipe->dst;
+	}
+
 	pr_debug("after processing: %s l_roi:-> %d %d %d %d r_roi:-> %d %d %d %d, dual_pu_roi:%d\n",
 		(l_roi.w && l_roi.h && r_roi.w && r_roi.h) ? "left+right" :
 			((l_roi.w && l_roi.h) ? "left-only" : "right-only"),
@@ -2542,6 +2783,24 @@ int mdss_mdp_overlay_kickoff(struct msm_fb_data_type *mfd,
 
 	mutex_lock(&mdp5_data->list_lock);
 
+	/*
+	 * Nothing to send to the panel. Returning without flushing lets the
+	 * display thread signal the fences of this commit.
+	 */
+	if (__overlay_frame_unchanged(mfd, data)) {
+		pr_debug("fb%d: skipping unchanged frame\n", mfd->index);
+		MDSS_XLOG(mfd->index, ctl->play_cnt);
+		__overlay_drop_requeued_bufs(mfd);
+		mutex_unlock(&mdp5_data->list_lock);
+		mfd->atomic_commit_pending = false;
+		mutex_unlock(&mdp5_data->ov_lock);
+		if (ctl->shared_lock)
+			mutex_unlock(ctl->shared_lock);
+		mdss_iommu_ctrl(0);
+		ATRACE_END(__func__);
+		return 0;
+	}
+
 	if (!ctl->shared_lock)
 		mdss_mdp_ctl_notify(ctl, MDP_NOTIFY_FRAME_BEGIN);
 
@@ -3264,6 +3523,9 @@ static void mdss_mdp_overlay_handle_vsync(struct mdss_mdp_ctl *ctl,
 
 	mdp5_data->vsync_time = t;
 	sysfs_notify_dirent(mdp5_data->vsync_event_sd);
+
+	if (mfd->panel_info->is_prim_panel)
+		evdev_vsync();
 }
 
 /* function is called in irq context should have minimum processing */
@@ -3873,6 +4135,37 @@ static ssize_t mdss_mdp_dyn_pu_store(struct device *dev,
 	return count;
 }
 
+static ssize_t mdss_mdp_auto_pu_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+
+	return scnprintf(buf, PAGE_SIZE, "%d", mdp5_data->auto_pu);
+}
+
+static ssize_t mdss_mdp_auto_pu_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	bool enable;
+	int ret;
+
+	ret = strtobool(buf, &enable);
+	if (ret) {
+		pr_err("Invalid input for auto partial update: ret = %d\n",
+			ret);
+		return ret;
+	}
+
+	mdp5_data->auto_pu = enable;
+
+	return count;
+}
+
 static ssize_t mdss_mdp_panel_disable_show(struct device *dev,
 	struct device_attribute *attr, char *buf)
 {
@@ -4179,6 +4472,8 @@ static DEVICE_ATTR(ad, S_IRUGO | S_IWUSR | S_IWGRP, mdss_mdp_ad_show,
 	mdss_mdp_ad_store);
 static DEVICE_ATTR(dyn_pu, S_IRUGO | S_IWUSR | S_IWGRP, mdss_mdp_dyn_pu_show,
 	mdss_mdp_dyn_pu_store);
+static DEVICE_ATTR(auto_pu, S_IRUGO | S_IWUSR | S_IWGRP, mdss_mdp_auto_pu_show,
+	mdss_mdp_auto_pu_store);
 static DEVICE_ATTR(hist_event, S_IRUGO, mdss_mdp_hist_show_event, NULL);
 static DEVICE_ATTR(bl_event, S_IRUGO, mdss_mdp_bl_show_event, NULL);
 static DEVICE_ATTR(ad_event, S_IRUGO, mdss_mdp_ad_show_event, NULL);
@@ -4190,6 +4485,7 @@ static struct attribute *mdp_overlay_sysfs_attrs[] = {
 	&dev_attr_lineptr_value.attr,
 	&dev_attr_ad.attr,
 	&dev_attr_dyn_pu.attr,
+	&dev_attr_auto_pu.attr,
 	&dev_attr_msm_misr_en.attr,
 	&dev_attr_msm_cmd_autorefresh_en.attr,
 	&dev_attr_msm_disable_panel.attr,
@@ -6482,6 +6778,7 @@ int mdss_mdp_overlay_init(struct msm_fb_data_type *mfd)
 
 	mfd->mdp.private1 = mdp5_data;
 	mfd->wait_for_kickoff = true;
+	mfd->commit_pipeline = true;
 
 	mdp5_data->hw_refresh = true;
 	mdp5_data->cursor_ndx[CURSOR_PIPE_LEFT] = MSMFB_NEW_REQUEST;
@@ -2725,6 +2725,37 @@ void mdss_mdp_pp_dest_scaler_resume(struct mdss_mdp_ctl *ctl)
 	}
 }
 
+/**
+ * mdss_mdp_pp_is_dirty() - check for post processing work on next kickoff
+ * @ctl: master ctl of the display
+ *
+ * Returns true if post processing configuration is waiting to be programmed
+ * for the display, or if assertive display is running and needs frames.
+ */
+bool mdss_mdp_pp_is_dirty(struct mdss_mdp_ctl *ctl)
+{
+	struct mdss_ad_info *ad;
+	u32 disp_num;
+	bool dirty;
+
+	if (!ctl || !ctl->mfd || !mdss_pp_res)
+		return false;
+
+	disp_num = ctl->mfd->index;
+	if (disp_num >= MDSS_BLOCK_DISP_NUM)
+		return false;
+
+	mutex_lock(&mdss_pp_mutex);
+	dirty = !!mdss_pp_res->pp_disp_flags[disp_num];
+	mutex_unlock(&mdss_pp_mutex);
+
+	if (!dirty && !mdss_mdp_get_ad(ctl->mfd, &ad) && ad &&
+	    (ad->state & PP_AD_STATE_RUN))
+		dirty = true;
+
+	return dirty;
+}
+
 int mdss_mdp_pp_setup(struct mdss_mdp_ctl *ctl)
 {
 	int ret = 0;
@@ -462,6 +462,28 @@ TRACE_EVENT(mdp_trace_counter,
 			__get_str(counter_name), __entry->value)
 );
 
+TRACE_EVENT(mdp_frame_stats,
+	TP_PROTO(u32 fb_idx, u32 commit_us, u32 vsync_us, u32 missed),
+	TP_ARGS(fb_idx, commit_us, vsync_us, missed),
+	TP_STRUCT__entry(
+			__field(u32, fb_idx)
+			__field(u32, commit_us)
+			__field(u32, vsync_us)
+			__field(u32, missed)
+	),
+	TP_fast_assign(
+			__entry->fb_idx = fb_idx;
+			__entry->commit_us = commit_us;
+			__entry->vsync_us = vsync_us;
+			__entry->missed = missed;
+	),
+	TP_printk("fb%d commit_us=%u vsync_us=%u missed=%u",
+			__entry->fb_idx,
+			__entry->commit_us,
+			__entry->vsync_us,
+			__entry->missed)
+);
+
 TRACE_EVENT(rotator_bw_ao_as_context,
 	TP_PROTO(u32 state),
 	TP_ARGS(state),
@@ -329,6 +329,31 @@ bool mdss_rect_overlap_check(struct mdss_rect *rect1, struct mdss_rect *rect2)
 	return true;
 }
 
+/*
+ * mdss_rect_union() - grow a rect to also cover another one
+ * @res_rect - rect to grow, an empty rect is replaced by @rect
+ * @rect     - rect to add
+ */
+void mdss_rect_union(struct mdss_rect *res_rect, const struct mdss_rect *rect)
+{
+	u32 l, t, r, b;
+
+	if (!rect->w || !rect->h)
+		return;
+
+	if (!res_rect->w || !res_rect->h) {
+		*res_rect = *rect;
+		return;
+	}
+
+	l = min(res_rect->x, rect->x);
+	t = min(res_rect->y, rect->y);
+	r = max(res_rect->x + res_rect->w, rect->x + rect->w);
+	b = max(res_rect->y + res_rect->h, rect->y + rect->h);
+
+	*res_rect = (struct mdss_rect){l, t, (r - l), (b - t)};
+}
+
 /*
  * mdss_rect_split() - split roi into two with regards to split-point.
  * @in_roi - input roi, non-split
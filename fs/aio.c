@@ -199,6 +199,14 @@ unsigned long aio_max_nr = 0x10000; /* system wide maximum number of aio request
 static struct kmem_cache	*kiocb_cachep;
 static struct kmem_cache	*kioctx_cachep;
 
+/*
+ * Buffered reads and writes and fsync on regular files and block devices
+ * never return -EIOCBQUEUED, so io_submit() would block on them. They are
+ * handed to this workqueue instead, which runs them in the submitter's mm
+ * and with its credentials.
+ */
+static struct workqueue_struct	*aio_wq;
+
 static struct vfsmount *aio_mnt;
 
 static const struct file_operations aio_ring_fops;
@@ -268,6 +276,11 @@ static int __init aio_setup(void)
 	kiocb_cachep = KMEM_CACHE(aio_kiocb, SLAB_HWCACHE_ALIGN|SLAB_PANIC);
 	kioctx_cachep = KMEM_CACHE(kioctx,SLAB_HWCACHE_ALIGN|SLAB_PANIC);
 
+	/* Without it, blocking requests simply run from io_submit() again */
+	aio_wq = alloc_workqueue("aio", WQ_UNBOUND, 0);
+	if (!aio_wq)
+		pr_warn("aio: no workqueue, buffered requests run inline\n");
+
 	pr_debug("sizeof(struct page) = %zu\n", sizeof(struct page));
 
 	return 0;
@@ -1419,6 +1432,138 @@ static int aio_setup_vectored_rw(int rw, char __user *buf, size_t len,
 				len, UIO_FASTIOV, iovec, iter);
 }
 
+static void aio_rw_done(struct kiocb *req, ssize_t ret)
+{
+	if (ret == -EIOCBQUEUED)
+		return;
+
+	/*
+	 * There's no easy way to restart the syscall since other AIO's
+	 * may be already running. Just fail this IO with EINTR.
+	 */
+	if (unlikely(ret == -ERESTARTSYS || ret == -ERESTARTNOINTR ||
+		     ret == -ERESTARTNOHAND ||
+		     ret == -ERESTART_RESTARTBLOCK))
+		ret = -EINTR;
+	aio_complete(req, ret, 0);
+}
+
+/*
+ * A request that would block the submitter. Everything iter_op() needs
+ * from the submitting task is captured here, including the iovec array,
+ * which would otherwise live on the io_submit() stack.
+ */
+struct aio_work {
+	struct work_struct	work;
+	struct kiocb		*req;
+	unsigned		opcode;
+	int			rw;
+	rw_iter_op		*iter_op;
+	struct mm_struct	*mm;
+	const struct cred	*cred;
+	struct iov_iter		iter;
+	struct iovec		*iovec;		/* to kfree(), or NULL */
+	struct iovec		inline_vecs[UIO_FASTIOV];
+};
+
+/*
+ * Nothing can be stopped once iter_op() is running, so cancelling only
+ * marks the request; aio_work_fn() skips it if it has not started yet.
+ */
+static int aio_work_cancel(struct kiocb *iocb)
+{
+	return 0;
+}
+
+static void aio_work_fn(struct work_struct *work)
+{
+	struct aio_work *w = container_of(work, struct aio_work, work);
+	struct kiocb *req = w->req;
+	struct aio_kiocb *iocb = container_of(req, struct aio_kiocb, common);
+	struct file *file = req->ki_filp;
+	struct mm_struct *mm = w->mm;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	/*
+	 * Once mm_users is zero exit_aio() has cancelled the request and
+	 * is waiting for it to complete.
+	 */
+	if (ACCESS_ONCE(iocb->ki_cancel) == KIOCB_CANCELLED ||
+	    !atomic_inc_not_zero(&mm->mm_users)) {
+		put_cred(w->cred);
+		kfree(w->iovec);
+		kfree(w);
+		aio_complete(req, -ECANCELED, 0);
+		mmdrop(mm);
+		return;
+	}
+
+	use_mm(mm);
+	old_cred = override_creds(w->cred);
+
+	switch (w->opcode) {
+	case IOCB_CMD_FDSYNC:
+	case IOCB_CMD_FSYNC:
+		ret = vfs_fsync(file, w->opcode == IOCB_CMD_FDSYNC);
+		break;
+	default:
+		get_file(file);
+		if (w->rw == WRITE)
+			file_start_write(file);
+		ret = w->iter_op(req, &w->iter);
+		if (w->rw == WRITE)
+			file_end_write(file);
+		fput(file);
+		break;
+	}
+
+	revert_creds(old_cred);
+	unuse_mm(mm);
+
+	put_cred(w->cred);
+	kfree(w->iovec);
+	kfree(w);
+
+	/* Completion drops the file and may free the kioctx */
+	aio_rw_done(req, ret);
+	mmput(mm);
+	mmdrop(mm);
+}
+
+static struct aio_work *aio_work_alloc(struct kiocb *req, unsigned opcode)
+{
+	umode_t mode = file_inode(req->ki_filp)->i_mode;
+	struct aio_work *w;
+
+	/*
+	 * Sockets, pipes and ttys can block for as long as the peer likes
+	 * and would tie up the workqueue, leave them to io_submit().
+	 */
+	if (!aio_wq || !(S_ISREG(mode) || S_ISBLK(mode)))
+		return NULL;
+
+	w = kmalloc(sizeof(*w), GFP_KERNEL);
+	if (!w)
+		return NULL;
+
+	INIT_WORK(&w->work, aio_work_fn);
+	w->req = req;
+	w->opcode = opcode;
+	w->iovec = NULL;
+	return w;
+}
+
+static void aio_work_queue(struct aio_work *w)
+{
+	/* Pin the mm_struct only, so exit_aio() still runs and cancels us */
+	w->mm = current->mm;
+	atomic_inc(&w->mm->mm_count);
+	w->cred = get_current_cred();
+	kiocb_set_cancel_fn(w->req, aio_work_cancel);
+	queue_work(aio_wq, &w->work);
+}
+
 /*
  * aio_run_iocb:
  *	Performs the initial checks and io submission.
@@ -1432,7 +1577,8 @@ static ssize_t aio_run_iocb(struct kiocb *req, unsigned opcode,
 	fmode_t mode;
 	rw_iter_op *iter_op;
 	struct iovec inline_vecs[UIO_FASTIOV], *iovec = inline_vecs;
-	struct iov_iter iter;
+	struct iov_iter iter, *iterp = &iter;
+	struct aio_work *w = NULL;
 
 	switch (opcode) {
 	case IOCB_CMD_PREAD:
@@ -1455,23 +1601,48 @@ rw_common:
 		if (!iter_op)
 			return -EINVAL;
 
+		/*
+		 * Only O_DIRECT gets queued by the filesystem itself,
+		 * everything else is punted so that io_submit() does not
+		 * wait for it. Writes under an RLIMIT_FSIZE stay inline:
+		 * generic_write_checks() would apply the kworker's limit
+		 * and send it the SIGXFSZ.
+		 */
+		if (!(req->ki_flags & IOCB_DIRECT) &&
+		    (rw == READ || rlimit(RLIMIT_FSIZE) == RLIM_INFINITY)) {
+			w = aio_work_alloc(req, opcode);
+			if (w) {
+				iovec = w->inline_vecs;
+				iterp = &w->iter;
+			}
+		}
+
 		if (opcode == IOCB_CMD_PREADV || opcode == IOCB_CMD_PWRITEV)
 			ret = aio_setup_vectored_rw(rw, buf, len,
-						&iovec, compat, &iter);
+						&iovec, compat, iterp);
 		else {
-			ret = import_single_range(rw, buf, len, iovec, &iter);
+			ret = import_single_range(rw, buf, len, iovec, iterp);
 			iovec = NULL;
 		}
 		if (!ret)
 			ret = rw_verify_area(rw, file, &req->ki_pos,
-					     iov_iter_count(&iter));
+					     iov_iter_count(iterp));
 		if (ret < 0) {
 			kfree(iovec);
+			kfree(w);
 			return ret;
 		}
 
 		len = ret;
 
+		if (w) {
+			w->rw = rw;
+			w->iter_op = iter_op;
+			w->iovec = iovec;
+			aio_work_queue(w);
+			return 0;
+		}
+
 		get_file(file);
 		if (rw == WRITE)
 			file_start_write(file);
@@ -1485,17 +1656,18 @@ rw_common:
 		break;
 
 	case IOCB_CMD_FDSYNC:
-		if (!file->f_op->aio_fsync)
-			return -EINVAL;
-
-		ret = file->f_op->aio_fsync(req, 1);
-		break;
-
 	case IOCB_CMD_FSYNC:
-		if (!file->f_op->aio_fsync)
-			return -EINVAL;
+		if (!file->f_op->aio_fsync) {
+			if (!file->f_op->fsync)
+				return -EINVAL;
+			w = aio_work_alloc(req, opcode);
+			if (!w)
+				return -EINVAL;
+			aio_work_queue(w);
+			return 0;
+		}
 
-		ret = file->f_op->aio_fsync(req, 0);
+		ret = file->f_op->aio_fsync(req, opcode == IOCB_CMD_FDSYNC);
 		break;
 
 	default:
@@ -1503,17 +1675,7 @@ rw_common:
 		return -EINVAL;
 	}
 
-	if (ret != -EIOCBQUEUED) {
-		/*
-		 * There's no easy way to restart the syscall since other AIO's
-		 * may be already running. Just fail this IO with EINTR.
-		 */
-		if (unlikely(ret == -ERESTARTSYS || ret == -ERESTARTNOINTR ||
-			     ret == -ERESTARTNOHAND ||
-			     ret == -ERESTART_RESTARTBLOCK))
-			ret = -EINTR;
-		aio_complete(req, ret, 0);
-	}
+	aio_rw_done(req, ret);
 
 	return 0;
 }
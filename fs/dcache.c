@@ -84,6 +84,14 @@
 int sysctl_vfs_cache_pressure __read_mostly = 100;
 EXPORT_SYMBOL_GPL(sysctl_vfs_cache_pressure);
 
+/*
+ * Maximum number of unused negative dentries a superblock keeps on its
+ * LRU, 0 for no limit. Past it, dput() evicts the oldest unused negative
+ * dentries, so a scan of nonexistent names cannot push the rest of the
+ * dcache out.
+ */
+unsigned long sysctl_negative_dentry_limit __read_mostly;
+
 __cacheline_aligned_in_smp DEFINE_SEQLOCK(rename_lock);
 
 EXPORT_SYMBOL(rename_lock);
@@ -411,14 +419,31 @@ static void dentry_unlink_inode(struct dentry * dentry)
  * The per-cpu "nr_dentry_unused" counters are updated with
  * the DCACHE_LRU_LIST bit.
  *
+ * The per-superblock s_nr_negative_dentry counter is updated with the
+ * DCACHE_NEGATIVE_LRU bit, which d_lru_add() sets for negative dentries.
+ * A dentry that turns positive while on the LRU stays counted until it
+ * leaves the LRU, so the count is only an estimate.
+ *
  * These helper functions make sure we always follow the
  * rules. d_lock must be held by the caller.
  */
 #define D_FLAG_VERIFY(dentry,x) WARN_ON_ONCE(((dentry)->d_flags & (DCACHE_LRU_LIST | DCACHE_SHRINK_LIST)) != (x))
+static void d_negative_uncount(struct dentry *dentry)
+{
+	if (dentry->d_flags & DCACHE_NEGATIVE_LRU) {
+		dentry->d_flags &= ~DCACHE_NEGATIVE_LRU;
+		atomic_long_dec(&dentry->d_sb->s_nr_negative_dentry);
+	}
+}
+
 static void d_lru_add(struct dentry *dentry)
 {
 	D_FLAG_VERIFY(dentry, 0);
 	dentry->d_flags |= DCACHE_LRU_LIST;
+	if (d_is_negative(dentry)) {
+		dentry->d_flags |= DCACHE_NEGATIVE_LRU;
+		atomic_long_inc(&dentry->d_sb->s_nr_negative_dentry);
+	}
 	this_cpu_inc(nr_dentry_unused);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
@@ -427,6 +452,7 @@ static void d_lru_del(struct dentry *dentry)
 {
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
+	d_negative_uncount(dentry);
 	this_cpu_dec(nr_dentry_unused);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
@@ -436,6 +462,7 @@ static void d_shrink_del(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_SHRINK_LIST | DCACHE_LRU_LIST);
 	list_del_init(&dentry->d_lru);
 	dentry->d_flags &= ~(DCACHE_SHRINK_LIST | DCACHE_LRU_LIST);
+	d_negative_uncount(dentry);
 	this_cpu_dec(nr_dentry_unused);
 }
 
@@ -457,6 +484,7 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 {
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
+	d_negative_uncount(dentry);
 	this_cpu_dec(nr_dentry_unused);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
@@ -751,6 +779,75 @@ static inline bool fast_dput(struct dentry *dentry)
 	return 0;
 }
 
+static void shrink_dentry_list(struct list_head *list);
+
+/* Max LRU entries looked at per dput() to get back under the limit */
+#define NEGATIVE_DENTRY_PRUNE_BATCH	32
+
+struct negative_dentry_prune {
+	struct list_head dispose;
+	long nr_to_free;
+};
+
+static enum lru_status dentry_lru_isolate_negative(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct negative_dentry_prune *np = arg;
+	struct dentry *dentry = container_of(item, struct dentry, d_lru);
+
+	if (np->nr_to_free <= 0 ||
+	    !(dentry->d_flags & DCACHE_NEGATIVE_LRU))
+		return LRU_SKIP;
+
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	/* Turned positive since it was counted, it is no longer one of ours */
+	if (!d_is_negative(dentry)) {
+		d_negative_uncount(dentry);
+		spin_unlock(&dentry->d_lock);
+		return LRU_SKIP;
+	}
+
+	if (dentry->d_lockref.count) {
+		spin_unlock(&dentry->d_lock);
+		return LRU_SKIP;
+	}
+
+	d_lru_shrink_move(lru, dentry, &np->dispose);
+	spin_unlock(&dentry->d_lock);
+	np->nr_to_free--;
+
+	return LRU_REMOVED;
+}
+
+/*
+ * Called by dput() with @dentry's d_lock and reference held, after adding
+ * it to the LRU. If its sb is over the negative dentry limit, move the
+ * oldest unused negative dentries, from the head of the LRU, to @dispose
+ * for the caller to free once d_lock is dropped.
+ */
+static void prune_negative_dentries(struct dentry *dentry,
+				    struct list_head *dispose)
+{
+	unsigned long limit = READ_ONCE(sysctl_negative_dentry_limit);
+	struct super_block *sb = dentry->d_sb;
+	struct negative_dentry_prune np;
+	long nr;
+
+	if (!limit || !(dentry->d_flags & DCACHE_NEGATIVE_LRU))
+		return;
+
+	nr = atomic_long_read(&sb->s_nr_negative_dentry);
+	if (nr <= limit)
+		return;
+
+	INIT_LIST_HEAD(&np.dispose);
+	np.nr_to_free = nr - limit;
+	list_lru_walk(&sb->s_dentry_lru, dentry_lru_isolate_negative, &np,
+		      NEGATIVE_DENTRY_PRUNE_BATCH);
+	list_splice(&np.dispose, dispose);
+}
 
 /* 
  * This is dput
@@ -780,6 +877,8 @@ static inline bool fast_dput(struct dentry *dentry)
  */
 void dput(struct dentry *dentry)
 {
+	LIST_HEAD(dispose);
+
 	if (unlikely(!dentry))
 		return;
 
@@ -810,9 +909,12 @@ repeat:
 	if (!(dentry->d_flags & DCACHE_REFERENCED))
 		dentry->d_flags |= DCACHE_REFERENCED;
 	dentry_lru_add(dentry);
+	prune_negative_dentries(dentry, &dispose);
 
 	dentry->d_lockref.count--;
 	spin_unlock(&dentry->d_lock);
+	if (unlikely(!list_empty(&dispose)))
+		shrink_dentry_list(&dispose);
 	return;
 
 kill_it:
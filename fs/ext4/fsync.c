@@ -82,6 +82,13 @@ static int ext4_sync_parent(struct inode *inode)
  *
  * What we do is just kick off a commit and wait on it.  This will snapshot the
  * inode to disk.
+ *
+ * That commit is a full jbd2 transaction, with every metadata block it
+ * touched, even when fsync only needs one inode's size and extents.
+ * Logging just those deltas takes a fast-commit area in the journal,
+ * which is an on-disk format change that neither jbd2 nor e2fsprogs know
+ * about here. Until then, the waits below are kept to transactions that
+ * actually hold this inode's (data)sync state.
  */
 
 int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
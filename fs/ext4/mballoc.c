@@ -2361,6 +2361,47 @@ const struct file_operations ext4_seq_mb_groups_fops = {
 	.release	= seq_release,
 };
 
+int ext4_seq_mb_stats_show(struct seq_file *seq, void *offset)
+{
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int cpu;
+
+	seq_puts(seq, "mballoc:\n");
+	seq_puts(seq, "\tlg_windows:");
+	for_each_possible_cpu(cpu) {
+		struct ext4_locality_group *lg;
+
+		lg = per_cpu_ptr(sbi->s_locality_groups, cpu);
+		seq_printf(seq, " %u", READ_ONCE(lg->lg_prealloc_win));
+	}
+	seq_putc(seq, '\n');
+
+	if (!sbi->s_mb_stats) {
+		seq_puts(seq, "\tmb_stats collection is off, "
+			 "write 1 to mb_stats to enable it\n");
+		return 0;
+	}
+	seq_printf(seq, "\treqs: %u\n", atomic_read(&sbi->s_bal_reqs));
+	seq_printf(seq, "\tsuccess: %u\n", atomic_read(&sbi->s_bal_success));
+	seq_printf(seq, "\tallocated: %u\n",
+		   atomic_read(&sbi->s_bal_allocated));
+	seq_printf(seq, "\textents_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_ex_scanned));
+	seq_printf(seq, "\tgoal_hits: %u\n", atomic_read(&sbi->s_bal_goals));
+	seq_printf(seq, "\t2^n_hits: %u\n", atomic_read(&sbi->s_bal_2orders));
+	seq_printf(seq, "\tbreaks: %u\n", atomic_read(&sbi->s_bal_breaks));
+	seq_printf(seq, "\tlost: %u\n", atomic_read(&sbi->s_mb_lost_chunks));
+	seq_printf(seq, "\tbuddies_generated: %lu\n",
+		   sbi->s_mb_buddies_generated);
+	seq_printf(seq, "\tbuddies_time_used: %llu\n",
+		   sbi->s_mb_generation_time);
+	seq_printf(seq, "\tpreallocated: %u\n",
+		   atomic_read(&sbi->s_mb_preallocated));
+	seq_printf(seq, "\tdiscarded: %u\n", atomic_read(&sbi->s_mb_discarded));
+	return 0;
+}
+
 static struct kmem_cache *get_groupinfo_cache(int blocksize_bits)
 {
 	int cache_index = blocksize_bits - EXT4_MIN_BLOCK_LOG_SIZE;
@@ -2664,6 +2705,8 @@ int ext4_mb_init(struct super_block *sb)
 		sbi->s_mb_group_prealloc = roundup(
 			sbi->s_mb_group_prealloc, sbi->s_stripe);
 	}
+	sbi->s_mb_group_prealloc_max = sbi->s_mb_group_prealloc <<
+					MB_DEFAULT_GROUP_PREALLOC_MAX_SHIFT;
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
@@ -2677,6 +2720,8 @@ int ext4_mb_init(struct super_block *sb)
 		for (j = 0; j < PREALLOC_TB_SIZE; j++)
 			INIT_LIST_HEAD(&lg->lg_prealloc_list[j]);
 		spin_lock_init(&lg->lg_prealloc_lock);
+		lg->lg_prealloc_win = sbi->s_mb_group_prealloc;
+		lg->lg_last_refill = jiffies;
 	}
 
 	/* init file for buddy data */
@@ -3008,15 +3053,38 @@ out_err:
  * s_mb_group_prealloc can be configured via
  * /sys/fs/ext4/<partition>/mb_group_prealloc
  *
+ * We only get here when the locality group ran out of preallocated
+ * space. If that keeps happening quickly, lots of small files are being
+ * created on this CPU, so double the window (up to mb_group_prealloc_max)
+ * to send them back to the buddy allocator and its group locks less
+ * often. Once refills are rare again the window halves back down.
+ *
  * XXX: should we try to preallocate more than the group has now?
  */
 static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 {
 	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct ext4_locality_group *lg = ac->ac_lg;
+	unsigned int base = sbi->s_mb_group_prealloc;
+	unsigned int max_win, win;
 
 	BUG_ON(lg == NULL);
-	ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_mb_group_prealloc;
+
+	/* keep the window a multiple of the base (and so of s_stripe) */
+	max_win = min_t(unsigned int, sbi->s_mb_group_prealloc_max,
+			EXT4_CLUSTERS_PER_GROUP(sb));
+	max_win = max(rounddown(max_win, base), base);
+
+	win = clamp(lg->lg_prealloc_win, base, max_win);
+	if (time_before(jiffies, lg->lg_last_refill + MB_LG_GROW_INTERVAL))
+		win = min(win << 1, max_win);
+	else if (time_after(jiffies, lg->lg_last_refill + MB_LG_SHRINK_INTERVAL))
+		win = max(win >> 1, base);
+	lg->lg_prealloc_win = win;
+	lg->lg_last_refill = jiffies;
+
+	ac->ac_g_ex.fe_len = win;
 	mb_debug(1, "#%u: goal %u blocks for locality group\n",
 		current->pid, ac->ac_g_ex.fe_len);
 }
@@ -89,6 +89,19 @@ extern ushort ext4_mballoc_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * a locality group may widen its preallocation window up to this
+ * many times s_mb_group_prealloc while small files keep coming
+ */
+#define MB_DEFAULT_GROUP_PREALLOC_MAX_SHIFT	2
+
+/*
+ * refills of a locality group closer than this widen its window,
+ * refills further apart than MB_LG_SHRINK_INTERVAL shrink it again
+ */
+#define MB_LG_GROW_INTERVAL	(HZ / 2)
+#define MB_LG_SHRINK_INTERVAL	(5 * HZ)
+
 
 struct ext4_free_data {
 	/* MUST be the first member */
@@ -157,6 +170,10 @@ struct ext4_locality_group {
 	/* list of preallocations */
 	struct list_head	lg_prealloc_list[PREALLOC_TB_SIZE];
 	spinlock_t		lg_prealloc_lock;
+	/* current preallocation size, protected by lg_mutex */
+	unsigned int		lg_prealloc_win;
+	/* when the group preallocation was last refilled */
+	unsigned long		lg_last_refill;
 };
 
 struct ext4_allocation_context {
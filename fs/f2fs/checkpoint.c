@@ -1154,6 +1154,36 @@ static bool __need_flush_quota(struct f2fs_sb_info *sbi)
 	return ret;
 }
 
+/*
+ * Do the bulk of the checkpoint I/O before block_operations() stops file
+ * operations: write back dirty dentry and node pages, and read in the NAT
+ * and SIT blocks the flush is going to copy. Whatever gets dirtied in the
+ * meantime is still written under the lock, this only shrinks that work.
+ */
+static void prepare_checkpoint(struct f2fs_sb_info *sbi)
+{
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+		.nr_to_write = LONG_MAX,
+		.for_reclaim = 0,
+	};
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+
+	if (get_pages(sbi, F2FS_DIRTY_DENTS) &&
+			f2fs_sync_dirty_inodes(sbi, DIR_INODE))
+		goto out;
+
+	if (get_pages(sbi, F2FS_DIRTY_NODES))
+		f2fs_sync_node_pages(sbi, &wbc, false, FS_CP_NODE_IO);
+
+	f2fs_ra_dirty_nat_pages(sbi);
+	f2fs_ra_dirty_sit_pages(sbi);
+out:
+	blk_finish_plug(&plug);
+}
+
 /*
  * Freeze all the FS-operations for checkpoint.
  */
@@ -1572,6 +1602,8 @@ int f2fs_write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 		goto out;
 	}
 
+	prepare_checkpoint(sbi);
+
 	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "start block_ops");
 
 	err = block_operations(sbi);
@@ -256,6 +256,7 @@ static struct extent_tree *__grab_extent_tree(struct inode *inode)
 		et->root = RB_ROOT;
 		et->cached_en = NULL;
 		rwlock_init(&et->lock);
+		seqcount_init(&et->largest_seq);
 		INIT_LIST_HEAD(&et->list);
 		atomic_set(&et->node_cnt, 0);
 		atomic_inc(&sbi->total_ext_tree);
@@ -281,7 +282,7 @@ static struct extent_node *__init_extent_tree(struct f2fs_sb_info *sbi,
 	if (!en)
 		return NULL;
 
-	et->largest = en->ei;
+	__set_largest_extent(et, &en->ei);
 	et->cached_en = en;
 	return en;
 }
@@ -309,7 +310,7 @@ static void __drop_largest_extent(struct extent_tree *et,
 {
 	if (fofs < et->largest.fofs + et->largest.len &&
 			fofs + len > et->largest.fofs) {
-		et->largest.len = 0;
+		__clear_largest_extent(et);
 		et->largest_updated = true;
 	}
 }
@@ -369,14 +370,34 @@ static bool f2fs_lookup_extent_tree(struct inode *inode, pgoff_t pgofs,
 	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
 	struct extent_tree *et = F2FS_I(inode)->extent_tree;
 	struct extent_node *en;
+	struct extent_info largest;
+	unsigned int seq;
 	bool ret = false;
 
 	f2fs_bug_on(sbi, !et);
 
 	trace_f2fs_lookup_extent_tree_start(inode, pgofs);
 
+	/*
+	 * Sequential readers of big media and APK files mostly hit the
+	 * largest extent, check it without bouncing et->lock around.
+	 */
+	do {
+		seq = read_seqcount_begin(&et->largest_seq);
+		largest = et->largest;
+	} while (read_seqcount_retry(&et->largest_seq, seq));
+
+	if (largest.fofs <= pgofs && largest.fofs + largest.len > pgofs) {
+		*ei = largest;
+		stat_inc_largest_node_hit(sbi);
+		stat_inc_total_hit(sbi);
+		trace_f2fs_lookup_extent_tree_end(inode, pgofs, ei);
+		return true;
+	}
+
 	read_lock(&et->lock);
 
+	/* it may have changed since, the rb-tree need not hold it */
 	if (et->largest.fofs <= pgofs &&
 			et->largest.fofs + et->largest.len > pgofs) {
 		*ei = et->largest;
@@ -592,7 +613,7 @@ static void f2fs_update_extent_tree_range(struct inode *inode,
 		if (dei.len >= 1 &&
 				prev.len < F2FS_MIN_EXTENT_LEN &&
 				et->largest.len < F2FS_MIN_EXTENT_LEN) {
-			et->largest.len = 0;
+			__clear_largest_extent(et);
 			et->largest_updated = true;
 			set_inode_flag(inode, FI_NO_EXTENT);
 		}
@@ -718,7 +739,7 @@ void f2fs_drop_extent_tree(struct inode *inode)
 	write_lock(&et->lock);
 	__free_extent_tree(sbi, et);
 	if (et->largest.len) {
-		et->largest.len = 0;
+		__clear_largest_extent(et);
 		updated = true;
 	}
 	write_unlock(&et->lock);
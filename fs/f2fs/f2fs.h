@@ -305,6 +305,8 @@ struct discard_entry {
 
 /* default discard granularity of inner discard thread, unit: block count */
 #define DEFAULT_DISCARD_GRANULARITY		16
+/* smallest discard issued in the background while the screen is on */
+#define DEF_ACTIVE_DISCARD_GRANULARITY		128
 
 /* max discard pend list number */
 #define MAX_PLIST_NUM		512
@@ -623,6 +625,7 @@ struct extent_tree {
 	struct rb_root root;		/* root of extent info rb-tree */
 	struct extent_node *cached_en;	/* recently accessed extent node */
 	struct extent_info largest;	/* largested extent info */
+	seqcount_t largest_seq;		/* lockless readers of largest */
 	struct list_head list;		/* to be used by sbi->zombie_list */
 	rwlock_t lock;			/* protect extent info rb-tree */
 	atomic_t node_cnt;		/* # of extent node in rb-tree*/
@@ -746,6 +749,10 @@ struct f2fs_inode_info {
 	int i_inline_xattr_size;	/* inline xattr size */
 	struct timespec i_crtime;	/* inode creation time */
 	struct timespec i_disk_time[4];	/* inode disk times */
+
+	/* decayed count of overwritten data blocks, see __get_segment_type */
+	unsigned int i_write_heat;
+	unsigned long i_write_heat_stamp;	/* jiffies of last decay */
 };
 
 static inline void get_extent_info(struct extent_info *ext,
@@ -810,12 +817,31 @@ static inline bool __is_front_mergeable(struct extent_info *cur,
 	return __is_extent_mergeable(cur, front);
 }
 
+/*
+ * The largest extent is checked by lookups without et->lock, so it is only
+ * changed with et->lock held for write and inside largest_seq.
+ */
+static inline void __set_largest_extent(struct extent_tree *et,
+					const struct extent_info *ei)
+{
+	write_seqcount_begin(&et->largest_seq);
+	et->largest = *ei;
+	write_seqcount_end(&et->largest_seq);
+}
+
+static inline void __clear_largest_extent(struct extent_tree *et)
+{
+	write_seqcount_begin(&et->largest_seq);
+	et->largest.len = 0;
+	write_seqcount_end(&et->largest_seq);
+}
+
 extern void f2fs_mark_inode_dirty_sync(struct inode *inode, bool sync);
 static inline void __try_update_largest_extent(struct extent_tree *et,
 						struct extent_node *en)
 {
 	if (en->ei.len > et->largest.len) {
-		et->largest = en->ei;
+		__set_largest_extent(et, &en->ei);
 		et->largest_updated = true;
 	}
 }
@@ -933,11 +959,15 @@ struct flush_cmd {
 	int ret;
 };
 
+/* how long the flush thread holds a flush for fsyncs still writing nodes */
+#define DEF_FLUSH_BATCH_WINDOW_US	500
+
 struct flush_cmd_control {
 	struct task_struct *f2fs_issue_flush;	/* flush thread */
 	wait_queue_head_t flush_wait_queue;	/* waiting queue for wake-up */
 	atomic_t issued_flush;			/* # of issued flushes */
 	atomic_t queued_flush;			/* # of queued flushes */
+	atomic_t pending_fsync;			/* # of fsyncs yet to flush */
 	struct llist_head issue_list;		/* list for command issue */
 	struct llist_node *dispatch_list;	/* list for command dispatch */
 };
@@ -2262,6 +2292,8 @@ static inline struct bio *f2fs_bio_alloc(struct f2fs_sb_info *sbi,
 
 static inline bool is_idle(struct f2fs_sb_info *sbi, int type)
 {
+	int own_inflight = 0;
+
 	if (sbi->gc_mode == GC_URGENT)
 		return true;
 
@@ -2280,6 +2312,15 @@ static inline bool is_idle(struct f2fs_sb_info *sbi, int type)
 			atomic_read(&SM_I(sbi)->fcc_info->queued_flush))
 		return false;
 
+	/*
+	 * I/O from other partitions or raw users of the same device, the
+	 * discard thread's own commands are in flight while it checks.
+	 */
+	if (type == DISCARD_TIME && SM_I(sbi) && SM_I(sbi)->dcc_info)
+		own_inflight = atomic_read(&SM_I(sbi)->dcc_info->queued_discard);
+	if (part_in_flight(&sbi->sb->s_bdev->bd_disk->part0) > own_inflight)
+		return false;
+
 	return f2fs_time_over(sbi, type);
 }
 
@@ -3104,6 +3145,7 @@ int f2fs_recover_inode_page(struct f2fs_sb_info *sbi, struct page *page);
 int f2fs_restore_node_summary(struct f2fs_sb_info *sbi,
 			unsigned int segno, struct f2fs_summary_block *sum);
 int f2fs_flush_nat_entries(struct f2fs_sb_info *sbi, struct cp_control *cpc);
+void f2fs_ra_dirty_nat_pages(struct f2fs_sb_info *sbi);
 int f2fs_build_node_manager(struct f2fs_sb_info *sbi);
 void f2fs_destroy_node_manager(struct f2fs_sb_info *sbi);
 int __init f2fs_create_node_manager_caches(void);
@@ -3121,6 +3163,8 @@ int f2fs_commit_inmem_pages(struct inode *inode);
 void f2fs_balance_fs(struct f2fs_sb_info *sbi, bool need);
 void f2fs_balance_fs_bg(struct f2fs_sb_info *sbi);
 int f2fs_issue_flush(struct f2fs_sb_info *sbi, nid_t ino);
+bool f2fs_fsync_batch_start(struct f2fs_sb_info *sbi);
+void f2fs_fsync_batch_end(struct f2fs_sb_info *sbi);
 int f2fs_create_flush_cmd_control(struct f2fs_sb_info *sbi);
 int f2fs_flush_device_cache(struct f2fs_sb_info *sbi);
 void f2fs_destroy_flush_cmd_control(struct f2fs_sb_info *sbi, bool free);
@@ -3172,6 +3216,7 @@ void f2fs_write_node_summaries(struct f2fs_sb_info *sbi, block_t start_blk);
 int f2fs_lookup_journal_in_cursum(struct f2fs_journal *journal, int type,
 			unsigned int val, int alloc);
 void f2fs_flush_sit_entries(struct f2fs_sb_info *sbi, struct cp_control *cpc);
+void f2fs_ra_dirty_sit_pages(struct f2fs_sb_info *sbi);
 int f2fs_build_segment_manager(struct f2fs_sb_info *sbi);
 void f2fs_destroy_segment_manager(struct f2fs_sb_info *sbi);
 int __init f2fs_create_segment_manager_caches(void);
@@ -3274,6 +3319,7 @@ int f2fs_start_gc_thread(struct f2fs_sb_info *sbi);
 void f2fs_stop_gc_thread(struct f2fs_sb_info *sbi);
 void f2fs_gc_sbi_list_add(struct f2fs_sb_info *sbi);
 void f2fs_gc_sbi_list_del(struct f2fs_sb_info *sbi);
+bool f2fs_in_idle_period(void);
 
 void __init f2fs_init_rapid_gc(void);
 void __exit f2fs_destroy_rapid_gc(void);
@@ -214,6 +214,7 @@ static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 		.for_reclaim = 0,
 	};
 	unsigned int seq_id = 0;
+	bool batched = false;
 
 	if (unlikely(f2fs_readonly(inode->i_sb) ||
 				is_sbi_flag_set(sbi, SBI_CP_DISABLED)))
@@ -278,6 +279,9 @@ go_write:
 		clear_inode_flag(inode, FI_UPDATE_WRITE);
 		goto out;
 	}
+
+	if (!atomic && F2FS_OPTION(sbi).fsync_mode != FSYNC_MODE_NOBARRIER)
+		batched = f2fs_fsync_batch_start(sbi);
 sync_nodes:
 	atomic_inc(&sbi->wb_sync_req[NODE]);
 	ret = f2fs_fsync_node_pages(sbi, inode, &wbc, atomic, &seq_id);
@@ -315,6 +319,10 @@ sync_nodes:
 	f2fs_remove_ino_entry(sbi, ino, APPEND_INO);
 	clear_inode_flag(inode, FI_APPEND_WRITE);
 flush_out:
+	if (batched) {
+		f2fs_fsync_batch_end(sbi);
+		batched = false;
+	}
 	if (!atomic && F2FS_OPTION(sbi).fsync_mode != FSYNC_MODE_NOBARRIER)
 		ret = f2fs_issue_flush(sbi, inode->i_ino);
 	if (!ret) {
@@ -324,6 +332,8 @@ flush_out:
 	}
 	f2fs_update_time(sbi, REQ_TIME);
 out:
+	if (batched)
+		f2fs_fsync_batch_end(sbi);
 	trace_f2fs_sync_file_exit(inode, cp_reason, datasync, ret);
 	f2fs_trace_ios(NULL, 1);
 	return ret;
@@ -1716,6 +1726,11 @@ static const struct {
 		FS_INLINE_DATA_FL |	\
 		FS_NOCOW_FL)
 
+/*
+ * FS_COMPR_FL is neither gettable nor settable on purpose: f2fs has no
+ * compressed cluster format in this tree, so accepting "chattr +c" would
+ * only make userspace believe the data takes less space than it does.
+ */
 #define F2FS_SETTABLE_FS_FL (		\
 		FS_SYNC_FL |		\
 		FS_IMMUTABLE_FL |	\
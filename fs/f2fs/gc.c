@@ -146,10 +146,19 @@ static int gc_thread_func(void *data)
 			goto next;
 		}
 
-		if (has_enough_invalid_blocks(sbi))
-			decrease_sleep_time(gc_th, &wait_ms);
-		else
+		if (!has_enough_invalid_blocks(sbi)) {
+			/* nothing worth reclaiming yet */
 			increase_sleep_time(gc_th, &wait_ms);
+			mutex_unlock(&sbi->gc_mutex);
+			stat_other_skip_bggc_count(sbi);
+			goto balance;
+		}
+
+		/* idle period, keep going while the device is quiet */
+		if (!screen_on)
+			wait_ms = gc_th->urgent_sleep_time;
+		else
+			decrease_sleep_time(gc_th, &wait_ms);
 do_gc:
 		stat_inc_bggc_count(sbi);
 
@@ -173,7 +182,7 @@ do_gc:
 
 		trace_f2fs_background_gc(sbi->sb, wait_ms,
 				prefree_segments(sbi), free_segments(sbi));
-
+balance:
 		/* balancing f2fs's metadata periodically */
 		f2fs_balance_fs_bg(sbi);
 next:
@@ -262,6 +271,25 @@ static void f2fs_start_rapid_gc(void)
 	mutex_unlock(&gc_sbi_mutex);
 }
 
+/*
+ * Screen off on battery: no wakelock and no urgent mode, but let the GC and
+ * discard threads use the idle period as long as the device stays quiet.
+ */
+static void f2fs_start_idle_gc(void)
+{
+	struct f2fs_sb_info *sbi;
+
+	mutex_lock(&gc_sbi_mutex);
+	list_for_each_entry(sbi, &gc_sbi_list, list) {
+		if (!test_opt(sbi, BG_GC) || f2fs_start_gc_thread(sbi))
+			continue;
+		sbi->gc_thread->gc_wake = 1;
+		wake_up_interruptible_all(&sbi->gc_thread->gc_wait_queue_head);
+		wake_up_discard_thread(sbi, true);
+	}
+	mutex_unlock(&gc_sbi_mutex);
+}
+
 static void f2fs_stop_rapid_gc(void)
 {
 	struct f2fs_sb_info *sbi;
@@ -295,6 +323,13 @@ static void rapid_gc_fb_work(struct work_struct *work)
 		f2fs_stop_rapid_gc();
 	else if (do_rapid_gc())
 		f2fs_start_rapid_gc();
+	else
+		f2fs_start_idle_gc();
+}
+
+bool f2fs_in_idle_period(void)
+{
+	return !screen_on;
 }
 
 static int fb_notifier_callback(struct notifier_block *self,
@@ -479,6 +514,71 @@ static unsigned int count_bits(const unsigned long *addr,
 	return sum;
 }
 
+static bool victim_usable(struct f2fs_sb_info *sbi, unsigned int segno,
+				struct victim_sel_policy *p, int gc_type)
+{
+	unsigned int secno = GET_SEC_FROM_SEG(sbi, segno);
+
+#ifdef CONFIG_F2FS_CHECK_FS
+	/*
+	 * skip selecting the invalid segno (that is failed due to block
+	 * validity check failure during GC) to avoid endless GC loop in
+	 * such cases.
+	 */
+	if (test_bit(segno, SIT_I(sbi)->invalid_segmap))
+		return false;
+#endif
+	if (sec_usage_check(sbi, secno))
+		return false;
+	/* Don't touch checkpointed data */
+	if (unlikely(is_sbi_flag_set(sbi, SBI_CP_DISABLED) &&
+				get_ckpt_valid_blocks(sbi, segno) &&
+				p->alloc_mode != SSR))
+		return false;
+	if (gc_type == BG_GC && test_bit(secno, DIRTY_I(sbi)->victim_secmap))
+		return false;
+	return true;
+}
+
+/*
+ * Pick an LFS victim section from the valid block buckets. Each bucket is
+ * ordered oldest first, so greedy takes the first usable section of the
+ * lowest bucket, and cost-benefit only has to weigh the oldest usable
+ * section of every bucket: for a given utilization, older always wins.
+ * Unusable sections count against max_search like in the bitmap scan.
+ */
+static void get_victim_from_buckets(struct f2fs_sb_info *sbi,
+			struct victim_sel_policy *p, int gc_type)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int nsearched = 0;
+	struct list_head *pos;
+	int i;
+
+	for (i = 0; i < NR_VICTIM_BUCKETS; i++) {
+		list_for_each(pos, &dirty_i->victim_bucket[i]) {
+			unsigned int secno = pos - dirty_i->victim_list;
+			unsigned int segno = GET_SEG_FROM_SEC(sbi, secno);
+			unsigned int cost;
+
+			if (nsearched++ >= p->max_search)
+				return;
+			if (!victim_usable(sbi, segno, p, gc_type))
+				continue;
+
+			cost = get_gc_cost(sbi, segno, p);
+			if (p->min_cost > cost) {
+				p->min_segno = segno;
+				p->min_cost = cost;
+			}
+			break;
+		}
+
+		if (p->gc_mode == GC_GREEDY && p->min_segno != NULL_SEGNO)
+			return;
+	}
+}
+
 /*
  * This function is called from two paths.
  * One is garbage collection and the other is SSR segment selection.
@@ -539,6 +639,11 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			goto got_it;
 	}
 
+	if (p.alloc_mode == LFS) {
+		get_victim_from_buckets(sbi, &p, gc_type);
+		goto done;
+	}
+
 	while (1) {
 		unsigned long cost;
 		unsigned int segno;
@@ -565,26 +670,7 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			nsearched++;
 		}
 
-#ifdef CONFIG_F2FS_CHECK_FS
-		/*
-		 * skip selecting the invalid segno (that is failed due to block
-		 * validity check failure during GC) to avoid endless GC loop in
-		 * such cases.
-		 */
-		if (test_bit(segno, sm->invalid_segmap))
-			goto next;
-#endif
-
-		secno = GET_SEC_FROM_SEG(sbi, segno);
-
-		if (sec_usage_check(sbi, secno))
-			goto next;
-		/* Don't touch checkpointed data */
-		if (unlikely(is_sbi_flag_set(sbi, SBI_CP_DISABLED) &&
-					get_ckpt_valid_blocks(sbi, segno) &&
-					p.alloc_mode != SSR))
-			goto next;
-		if (gc_type == BG_GC && test_bit(secno, dirty_i->victim_secmap))
+		if (!victim_usable(sbi, segno, &p, gc_type))
 			goto next;
 
 		cost = get_gc_cost(sbi, segno, &p);
@@ -604,6 +690,7 @@ next:
 			break;
 		}
 	}
+done:
 	if (p.min_segno != NULL_SEGNO) {
 got_it:
 		*result = (p.min_segno / p.ofs_unit) * p.ofs_unit;
@@ -2813,6 +2813,39 @@ static int __flush_nat_entry_set(struct f2fs_sb_info *sbi,
 	return 0;
 }
 
+/*
+ * Read in the NAT blocks that f2fs_flush_nat_entries() is going to copy,
+ * so that checkpoint does not wait for them with operations blocked.
+ */
+void f2fs_ra_dirty_nat_pages(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_nm_info *nm_i = NM_I(sbi);
+	struct curseg_info *curseg = CURSEG_I(sbi, CURSEG_HOT_DATA);
+	struct f2fs_journal *journal = curseg->journal;
+	struct nat_entry_set *setvec[SETVEC_SIZE];
+	unsigned int found, idx;
+	nid_t set_idx = 0;
+	struct blk_plug plug;
+
+	down_read(&nm_i->nat_tree_lock);
+
+	/* all of them will go to the journal */
+	if (__has_cursum_space(journal, nm_i->dirty_nat_cnt, NAT_JOURNAL))
+		goto out;
+
+	blk_start_plug(&plug);
+	while ((found = __gang_lookup_nat_set(nm_i,
+					set_idx, SETVEC_SIZE, setvec))) {
+		set_idx = setvec[found - 1]->set + 1;
+		for (idx = 0; idx < found; idx++)
+			f2fs_ra_meta_pages(sbi, setvec[idx]->set, 1,
+							META_NAT, true);
+	}
+	blk_finish_plug(&plug);
+out:
+	up_read(&nm_i->nat_tree_lock);
+}
+
 /*
  * This function is called during the checkpointing process.
  */
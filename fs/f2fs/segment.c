@@ -15,6 +15,7 @@
 #include <linux/timer.h>
 #include <linux/freezer.h>
 #include <linux/sched.h>
+#include <linux/list_sort.h>
 
 #include "f2fs.h"
 #include "segment.h"
@@ -599,6 +600,17 @@ repeat:
 		struct flush_cmd *cmd, *next;
 		int ret;
 
+		/*
+		 * Other fsyncs are still writing their node pages, hold the
+		 * flush for a short while so that they can share it.
+		 */
+		if (atomic_read(&fcc->pending_fsync))
+			wait_event_interruptible_hrtimeout(*q,
+				kthread_should_stop() ||
+				!atomic_read(&fcc->pending_fsync),
+				ns_to_ktime(DEF_FLUSH_BATCH_WINDOW_US *
+							NSEC_PER_USEC));
+
 		fcc->dispatch_list = llist_del_all(&fcc->issue_list);
 		fcc->dispatch_list = llist_reverse_order(fcc->dispatch_list);
 
@@ -639,7 +651,8 @@ int f2fs_issue_flush(struct f2fs_sb_info *sbi, nid_t ino)
 		return ret;
 	}
 
-	if (atomic_inc_return(&fcc->queued_flush) == 1 ||
+	if ((atomic_inc_return(&fcc->queued_flush) == 1 &&
+	     !atomic_read(&fcc->pending_fsync)) ||
 	    f2fs_is_multi_device(sbi)) {
 		ret = submit_flush_wait(sbi, ino);
 		atomic_dec(&fcc->queued_flush);
@@ -689,6 +702,32 @@ int f2fs_issue_flush(struct f2fs_sb_info *sbi, nid_t ino)
 	return cmd.ret;
 }
 
+/*
+ * Mark an fsync that will issue a flush once its node pages are written,
+ * so that the flush thread can batch it with the ones already queued.
+ * Returns true if f2fs_fsync_batch_end() has to be called.
+ */
+bool f2fs_fsync_batch_start(struct f2fs_sb_info *sbi)
+{
+	struct flush_cmd_control *fcc = SM_I(sbi)->fcc_info;
+
+	if (!test_opt(sbi, FLUSH_MERGE) || !fcc || !fcc->f2fs_issue_flush)
+		return false;
+
+	atomic_inc(&fcc->pending_fsync);
+	return true;
+}
+
+void f2fs_fsync_batch_end(struct f2fs_sb_info *sbi)
+{
+	struct flush_cmd_control *fcc = SM_I(sbi)->fcc_info;
+
+	/* don't leave the flush thread waiting out its window for us */
+	if (atomic_dec_and_test(&fcc->pending_fsync) &&
+			waitqueue_active(&fcc->flush_wait_queue))
+		wake_up(&fcc->flush_wait_queue);
+}
+
 int f2fs_create_flush_cmd_control(struct f2fs_sb_info *sbi)
 {
 	dev_t dev = sbi->sb->s_bdev->bd_dev;
@@ -707,6 +746,7 @@ int f2fs_create_flush_cmd_control(struct f2fs_sb_info *sbi)
 		return -ENOMEM;
 	atomic_set(&fcc->issued_flush, 0);
 	atomic_set(&fcc->queued_flush, 0);
+	atomic_set(&fcc->pending_fsync, 0);
 	init_waitqueue_head(&fcc->flush_wait_queue);
 	init_llist_head(&fcc->issue_list);
 	SM_I(sbi)->fcc_info = fcc;
@@ -764,6 +804,32 @@ int f2fs_flush_device_cache(struct f2fs_sb_info *sbi)
 	return ret;
 }
 
+/*
+ * Refile the section of @segno in the victim buckets after its valid blocks
+ * changed. Every change also stamps the segment mtime, so appending keeps
+ * each bucket sorted from the oldest to the youngest section.
+ * Must hold seglist_lock.
+ */
+static void __update_victim_index(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int secno = GET_SEC_FROM_SEG(sbi, segno);
+	unsigned int start = GET_SEG_FROM_SEC(sbi, secno);
+	unsigned int end = start + sbi->segs_per_sec;
+	unsigned int bucket;
+
+	if (find_next_bit(dirty_i->dirty_segmap[DIRTY], end, start) >= end) {
+		list_del_init(&dirty_i->victim_list[secno]);
+		return;
+	}
+
+	bucket = get_valid_blocks(sbi, segno, true) >>
+					dirty_i->victim_bucket_shift;
+	bucket = min_t(unsigned int, bucket, NR_VICTIM_BUCKETS - 1);
+	list_move_tail(&dirty_i->victim_list[secno],
+					&dirty_i->victim_bucket[bucket]);
+}
+
 static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		enum dirty_type dirty_type)
 {
@@ -786,6 +852,8 @@ static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		}
 		if (!test_and_set_bit(segno, dirty_i->dirty_segmap[t]))
 			dirty_i->nr_dirty[t]++;
+
+		__update_victim_index(sbi, segno);
 	}
 }
 
@@ -807,6 +875,8 @@ static void __remove_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		if (get_valid_blocks(sbi, segno, true) == 0)
 			clear_bit(GET_SEC_FROM_SEG(sbi, segno),
 						dirty_i->victim_secmap);
+
+		__update_victim_index(sbi, segno);
 	}
 }
 
@@ -1157,6 +1227,13 @@ static void __init_discard_policy(struct f2fs_sb_info *sbi,
 		if (utilization(sbi) > DEF_DISCARD_URGENT_UTIL) {
 			dpolicy->granularity = 1;
 			dpolicy->max_interval = DEF_MAX_DISCARD_URGENT_ISSUE_TIME;
+		} else if (f2fs_in_idle_period()) {
+			/* screen off, catch up on the small ones */
+			dpolicy->granularity = 1;
+		} else {
+			/* in use, only large discards are worth a command */
+			dpolicy->granularity = max_t(unsigned int, granularity,
+					DEF_ACTIVE_DISCARD_GRANULARITY);
 		}
 	} else if (discard_type == DPOLICY_FORCE) {
 		dpolicy->min_interval = 1;
@@ -3077,6 +3154,34 @@ static int __get_segment_type_4(struct f2fs_io_info *fio)
 	}
 }
 
+/* overwrites per half-life that make a file hot */
+#define HOT_WRITE_HEAT		32
+#define WRITE_HEAT_HALF_LIFE	(60 * HZ)
+
+/*
+ * Count overwrites of a file's existing blocks, halving the count every
+ * WRITE_HEAT_HALF_LIFE. Appends do not count, so SQLite databases and WAL
+ * files heat up while media written once stays in the warm log.
+ * Racy updates only cost an off-by-one on a heuristic.
+ */
+static bool update_write_heat(struct inode *inode, block_t old_blkaddr)
+{
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	unsigned long periods = (jiffies - fi->i_write_heat_stamp) /
+						WRITE_HEAT_HALF_LIFE;
+	unsigned int heat = fi->i_write_heat;
+
+	if (periods) {
+		heat = periods < 32 ? heat >> periods : 0;
+		fi->i_write_heat_stamp += periods * WRITE_HEAT_HALF_LIFE;
+	}
+	if (__is_valid_data_blkaddr(old_blkaddr) && heat < UINT_MAX)
+		heat++;
+	fi->i_write_heat = heat;
+
+	return heat >= HOT_WRITE_HEAT;
+}
+
 static int __get_segment_type_6(struct f2fs_io_info *fio)
 {
 	if (fio->type == DATA) {
@@ -3084,7 +3189,9 @@ static int __get_segment_type_6(struct f2fs_io_info *fio)
 
 		if (is_cold_data(fio->page) || file_is_cold(inode))
 			return CURSEG_COLD_DATA;
-		if (file_is_hot(inode) ||
+		if ((S_ISREG(inode->i_mode) &&
+				update_write_heat(inode, fio->old_blkaddr)) ||
+				file_is_hot(inode) ||
 				is_inode_flag_set(inode, FI_HOT_DATA) ||
 				f2fs_is_atomic_file(inode) ||
 				f2fs_is_volatile_file(inode))
@@ -3872,6 +3979,33 @@ static void remove_sits_in_journal(struct f2fs_sb_info *sbi)
 	up_write(&curseg->journal_rwsem);
 }
 
+/* SIT counterpart of f2fs_ra_dirty_nat_pages() */
+void f2fs_ra_dirty_sit_pages(struct f2fs_sb_info *sbi)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct curseg_info *curseg = CURSEG_I(sbi, CURSEG_COLD_DATA);
+	struct f2fs_journal *journal = curseg->journal;
+	struct blk_plug plug;
+	unsigned int segno;
+
+	down_read(&sit_i->sentry_lock);
+
+	if (__has_cursum_space(journal, sit_i->dirty_sentries, SIT_JOURNAL))
+		goto out;
+
+	blk_start_plug(&plug);
+	for_each_set_bit(segno, sit_i->dirty_sentries_bitmap, MAIN_SEGS(sbi)) {
+		unsigned int blkno = SIT_BLOCK_OFFSET(segno);
+
+		f2fs_ra_meta_pages(sbi, blkno, 1, META_SIT, true);
+		/* one read per SIT block */
+		segno = (blkno + 1) * SIT_ENTRY_PER_BLOCK - 1;
+	}
+	blk_finish_plug(&plug);
+out:
+	up_read(&sit_i->sentry_lock);
+}
+
 /*
  * CP calls this function, which flushes SIT entries including sit_journal,
  * and moves prefree segs to free segs.
@@ -4319,17 +4453,70 @@ static int init_victim_secmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
 	unsigned int bitmap_size = f2fs_bitmap_size(MAIN_SECS(sbi));
+	unsigned int blocks_per_sec = BLKS_PER_SEC(sbi);
+	unsigned int i;
 
 	dirty_i->victim_secmap = f2fs_kvzalloc(sbi, bitmap_size, GFP_KERNEL);
 	if (!dirty_i->victim_secmap)
 		return -ENOMEM;
+
+	dirty_i->victim_list = f2fs_kvzalloc(sbi, MAIN_SECS(sbi) *
+					sizeof(struct list_head), GFP_KERNEL);
+	if (!dirty_i->victim_list)
+		return -ENOMEM;
+
+	for (i = 0; i < MAIN_SECS(sbi); i++)
+		INIT_LIST_HEAD(&dirty_i->victim_list[i]);
+	for (i = 0; i < NR_VICTIM_BUCKETS; i++)
+		INIT_LIST_HEAD(&dirty_i->victim_bucket[i]);
+
+	while ((blocks_per_sec >> dirty_i->victim_bucket_shift) >
+							NR_VICTIM_BUCKETS)
+		dirty_i->victim_bucket_shift++;
 	return 0;
 }
 
+static unsigned long long get_sec_mtime(struct f2fs_sb_info *sbi,
+						unsigned int secno)
+{
+	unsigned int start = GET_SEG_FROM_SEC(sbi, secno);
+	unsigned long long mtime = 0;
+	unsigned int i;
+
+	for (i = 0; i < sbi->segs_per_sec; i++)
+		mtime += get_seg_entry(sbi, start + i)->mtime;
+
+	return div_u64(mtime, sbi->segs_per_sec);
+}
+
+static int victim_mtime_cmp(void *priv, struct list_head *a,
+						struct list_head *b)
+{
+	struct f2fs_sb_info *sbi = priv;
+	struct list_head *base = DIRTY_I(sbi)->victim_list;
+	unsigned long long mtime_a = get_sec_mtime(sbi, a - base);
+	unsigned long long mtime_b = get_sec_mtime(sbi, b - base);
+
+	if (mtime_a == mtime_b)
+		return 0;
+	return mtime_a < mtime_b ? -1 : 1;
+}
+
+/* Buckets were filled in segment order at mount, put them in mtime order */
+static void sort_victim_buckets(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	int i;
+
+	for (i = 0; i < NR_VICTIM_BUCKETS; i++)
+		list_sort(sbi, &dirty_i->victim_bucket[i], victim_mtime_cmp);
+}
+
 static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i;
 	unsigned int bitmap_size, i;
+	int err;
 
 	/* allocate memory for dirty segments list information */
 	dirty_i = f2fs_kzalloc(sbi, sizeof(struct dirty_seglist_info),
@@ -4349,8 +4536,13 @@ static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 			return -ENOMEM;
 	}
 
+	err = init_victim_secmap(sbi);
+	if (err)
+		return err;
+
 	init_dirty_segmap(sbi);
-	return init_victim_secmap(sbi);
+	sort_victim_buckets(sbi);
+	return 0;
 }
 
 static int sanity_check_curseg(struct f2fs_sb_info *sbi)
@@ -4506,6 +4698,7 @@ static void destroy_victim_secmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
 	kvfree(dirty_i->victim_secmap);
+	kvfree(dirty_i->victim_list);
 }
 
 static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
@@ -271,12 +271,22 @@ enum dirty_type {
 	NR_DIRTY_TYPE
 };
 
+/*
+ * Dirty sections are also kept in buckets of valid blocks, each bucket in
+ * last modification order, so that GC can pick a victim without scanning
+ * the dirty segmap.
+ */
+#define NR_VICTIM_BUCKETS	128
+
 struct dirty_seglist_info {
 	const struct victim_selection *v_ops;	/* victim selction operation */
 	unsigned long *dirty_segmap[NR_DIRTY_TYPE];
 	struct mutex seglist_lock;		/* lock for segment bitmaps */
 	int nr_dirty[NR_DIRTY_TYPE];		/* # of dirty segments */
 	unsigned long *victim_secmap;		/* background GC victims */
+	struct list_head *victim_list;		/* per-section bucket link */
+	struct list_head victim_bucket[NR_VICTIM_BUCKETS];
+	unsigned int victim_bucket_shift;	/* valid blocks to bucket */
 };
 
 /* victim selection function for cleaning and SSR */
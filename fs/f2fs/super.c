@@ -868,6 +868,8 @@ static struct inode *f2fs_alloc_inode(struct super_block *sb)
 	/* Will be used by directory only */
 	fi->i_dir_level = F2FS_SB(sb)->dir_level;
 
+	fi->i_write_heat_stamp = jiffies;
+
 	return &fi->vfs_inode;
 }
 
@@ -85,8 +85,10 @@ static ssize_t fuse_passthrough_read_write_iter(struct kiocb *iocb,
 	passthrough_inode = file_inode(passthrough_filp);
 
 	if (do_write) {
-		if (!passthrough_filp->f_op->write_iter)
-			return -EIO;
+		if (!passthrough_filp->f_op->write_iter) {
+			ret_val = -EIO;
+			goto out;
+		}
 		ret_val = passthrough_filp->f_op->write_iter(iocb, iter);
 
 		if (ret_val >= 0 || ret_val == -EIOCBQUEUED) {
@@ -96,13 +98,16 @@ static ssize_t fuse_passthrough_read_write_iter(struct kiocb *iocb,
 			fsstack_copy_attr_times(fuse_inode, passthrough_inode);
 		}
 	} else {
-		if (!passthrough_filp->f_op->read_iter)
-			return -EIO;
+		if (!passthrough_filp->f_op->read_iter) {
+			ret_val = -EIO;
+			goto out;
+		}
 		ret_val = passthrough_filp->f_op->read_iter(iocb, iter);
 		if (ret_val >= 0 || ret_val == -EIOCBQUEUED)
 			fsstack_copy_attr_atime(fuse_inode, passthrough_inode);
 	}
 
+out:
 	iocb->ki_filp = fuse_file;
 
 	/* unlock passthrough file */
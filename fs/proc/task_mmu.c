@@ -290,7 +290,6 @@ static int proc_map_release(struct inode *inode, struct file *file)
 	if (priv->mm)
 		mmdrop(priv->mm);
 
-	kfree(priv->rollup);
 	return seq_release_private(inode, file);
 }
 
@@ -482,7 +481,6 @@ const struct file_operations proc_tid_maps_operations = {
 
 #ifdef CONFIG_PROC_PAGE_MONITOR
 struct mem_size_stats {
-	bool first;
 	unsigned long resident;
 	unsigned long shared_clean;
 	unsigned long shared_dirty;
@@ -494,7 +492,6 @@ struct mem_size_stats {
 	unsigned long swap;
 	unsigned long shared_hugetlb;
 	unsigned long private_hugetlb;
-	unsigned long first_vma_start;
 	u64 pss;
 	u64 pss_locked;
 	u64 swap_pss;
@@ -704,106 +701,176 @@ static int smaps_hugetlb_range(pte_t *pte, unsigned long hmask,
 }
 #endif /* HUGETLB_PAGE */
 
-static int show_smap(struct seq_file *m, void *v, int is_pid)
+/*
+ * Gather the stats of @vma from @start on. mmap_sem must be held for
+ * reading.
+ */
+static void smap_gather_stats(struct vm_area_struct *vma,
+			      struct mem_size_stats *mss, unsigned long start)
 {
-	struct proc_maps_private *priv = m->private;
-	struct vm_area_struct *vma = v;
-	struct mem_size_stats mss_stack;
-	struct mem_size_stats *mss;
 	struct mm_walk smaps_walk = {
 		.pmd_entry = smaps_pte_range,
 #ifdef CONFIG_HUGETLB_PAGE
 		.hugetlb_entry = smaps_hugetlb_range,
 #endif
 		.mm = vma->vm_mm,
+		.private = mss,
 	};
-	int ret = 0;
-	bool rollup_mode;
-	bool last_vma;
-
-	if (priv->rollup) {
-		rollup_mode = true;
-		mss = priv->rollup;
-		if (mss->first) {
-			mss->first_vma_start = vma->vm_start;
-			mss->first = false;
-		}
-		last_vma = !m_next_vma(priv, vma);
-	} else {
-		rollup_mode = false;
-		memset(&mss_stack, 0, sizeof(mss_stack));
-		mss = &mss_stack;
-	}
+	u64 pss = mss->pss;
 
-	smaps_walk.private = mss;
+	if (start == vma->vm_start)
+		walk_page_vma(vma, &smaps_walk);
+	else
+		walk_page_range(start, vma->vm_end, &smaps_walk);
+	if (vma->vm_flags & VM_LOCKED)
+		mss->pss_locked += mss->pss - pss;
+}
+
+static void __show_smap(struct seq_file *m, const struct mem_size_stats *mss)
+{
+	seq_printf(m,
+		   "Rss:            %8lu kB\n"
+		   "Pss:            %8lu kB\n"
+		   "Shared_Clean:   %8lu kB\n"
+		   "Shared_Dirty:   %8lu kB\n"
+		   "Private_Clean:  %8lu kB\n"
+		   "Private_Dirty:  %8lu kB\n"
+		   "Referenced:     %8lu kB\n"
+		   "Anonymous:      %8lu kB\n"
+		   "AnonHugePages:  %8lu kB\n"
+		   "Shared_Hugetlb: %8lu kB\n"
+		   "Private_Hugetlb: %7lu kB\n"
+		   "Swap:           %8lu kB\n"
+		   "SwapPss:        %8lu kB\n"
+		   "Locked:         %8lu kB\n",
+		   mss->resident >> 10,
+		   (unsigned long)(mss->pss >> (10 + PSS_SHIFT)),
+		   mss->shared_clean  >> 10,
+		   mss->shared_dirty  >> 10,
+		   mss->private_clean >> 10,
+		   mss->private_dirty >> 10,
+		   mss->referenced >> 10,
+		   mss->anonymous >> 10,
+		   mss->anonymous_thp >> 10,
+		   mss->shared_hugetlb >> 10,
+		   mss->private_hugetlb >> 10,
+		   mss->swap >> 10,
+		   (unsigned long)(mss->swap_pss >> (10 + PSS_SHIFT)),
+		   (unsigned long)(mss->pss_locked >> (10 + PSS_SHIFT)));
+}
+
+static int show_smap(struct seq_file *m, void *v, int is_pid)
+{
+	struct vm_area_struct *vma = v;
+	struct mem_size_stats mss;
+
+	memset(&mss, 0, sizeof(mss));
 
 	/* mmap_sem is held in m_start */
-	walk_page_vma(vma, &smaps_walk);
-	if (vma->vm_flags & VM_LOCKED)
-		mss->pss_locked += mss->pss;
+	smap_gather_stats(vma, &mss, vma->vm_start);
 
-	if (!rollup_mode) {
-		show_map_vma(m, vma, is_pid);
-	} else if (last_vma) {
-		show_vma_header_prefix(
-			m, mss->first_vma_start, vma->vm_end, 0, 0, 0, 0);
-		seq_pad(m, ' ');
-		seq_puts(m, "[rollup]\n");
-	} else {
-		ret = SEQ_SKIP;
-	}
+	show_map_vma(m, vma, is_pid);
 
-	if (!rollup_mode && vma_get_anon_name(vma)) {
+	if (vma_get_anon_name(vma)) {
 		seq_puts(m, "Name:           ");
 		seq_print_vma_name(m, vma);
 		seq_putc(m, '\n');
 	}
 
-	if (!rollup_mode)
-		seq_printf(m,
-			   "Size:           %8lu kB\n"
-			   "KernelPageSize: %8lu kB\n"
-			   "MMUPageSize:    %8lu kB\n",
-			   (vma->vm_end - vma->vm_start) >> 10,
-			   vma_kernel_pagesize(vma) >> 10,
-			   vma_mmu_pagesize(vma) >> 10);
-
-
-	if (!rollup_mode || last_vma)
-		seq_printf(m,
-			   "Rss:            %8lu kB\n"
-			   "Pss:            %8lu kB\n"
-			   "Shared_Clean:   %8lu kB\n"
-			   "Shared_Dirty:   %8lu kB\n"
-			   "Private_Clean:  %8lu kB\n"
-			   "Private_Dirty:  %8lu kB\n"
-			   "Referenced:     %8lu kB\n"
-			   "Anonymous:      %8lu kB\n"
-			   "AnonHugePages:  %8lu kB\n"
-			   "Shared_Hugetlb: %8lu kB\n"
-			   "Private_Hugetlb: %7lu kB\n"
-			   "Swap:           %8lu kB\n"
-			   "SwapPss:        %8lu kB\n"
-			   "Locked:         %8lu kB\n",
-			   mss->resident >> 10,
-			   (unsigned long)(mss->pss >> (10 + PSS_SHIFT)),
-			   mss->shared_clean  >> 10,
-			   mss->shared_dirty  >> 10,
-			   mss->private_clean >> 10,
-			   mss->private_dirty >> 10,
-			   mss->referenced >> 10,
-			   mss->anonymous >> 10,
-			   mss->anonymous_thp >> 10,
-			   mss->shared_hugetlb >> 10,
-			   mss->private_hugetlb >> 10,
-			   mss->swap >> 10,
-			   (unsigned long)(mss->swap_pss >> (10 + PSS_SHIFT)),
-			   (unsigned long)(mss->pss >> (10 + PSS_SHIFT)));
-
-	if (!rollup_mode) {
-		show_smap_vma_flags(m, vma);
-	}
+	seq_printf(m,
+		   "Size:           %8lu kB\n"
+		   "KernelPageSize: %8lu kB\n"
+		   "MMUPageSize:    %8lu kB\n",
+		   (vma->vm_end - vma->vm_start) >> 10,
+		   vma_kernel_pagesize(vma) >> 10,
+		   vma_mmu_pagesize(vma) >> 10);
+
+	__show_smap(m, &mss);
+
+	show_smap_vma_flags(m, vma);
 	m_cache_vma(m, vma);
+	return 0;
+}
+
+/*
+ * smaps_rollup walks the whole address space in one read, which can take
+ * tens of milliseconds for a large app. Rather than holding mmap_sem for
+ * all of it, let writers (mmap, munmap, mprotect, page faults that expand
+ * the stack) in whenever they are waiting, and continue from where the
+ * walk stopped.
+ */
+static int show_smaps_rollup(struct seq_file *m, void *v)
+{
+	struct proc_maps_private *priv = m->private;
+	struct mem_size_stats mss;
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	unsigned long vma_start = 0, last_vma_end = 0;
+	int ret = 0;
+
+	priv->task = get_proc_task(priv->inode);
+	if (!priv->task)
+		return -ESRCH;
+
+	mm = priv->mm;
+	if (!mm || !atomic_inc_not_zero(&mm->mm_users)) {
+		ret = -ESRCH;
+		goto out_put_task;
+	}
+
+	memset(&mss, 0, sizeof(mss));
+
+	down_read(&mm->mmap_sem);
+	hold_task_mempolicy(priv);
+
+	if (mm->mmap)
+		vma_start = mm->mmap->vm_start;
+
+	for (vma = mm->mmap; vma;) {
+		smap_gather_stats(vma, &mss, vma->vm_start);
+		last_vma_end = vma->vm_end;
+
+		if (rwsem_is_contended(&mm->mmap_sem)) {
+			release_task_mempolicy(priv);
+			up_read(&mm->mmap_sem);
+			cond_resched();
+			down_read(&mm->mmap_sem);
+			hold_task_mempolicy(priv);
+
+			/*
+			 * The vma we just finished may have been unmapped,
+			 * merged with a neighbour or split while the lock
+			 * was dropped. Look up whatever now covers or
+			 * follows the last byte we walked: skip what has
+			 * already been counted and gather the rest of it.
+			 */
+			vma = find_vma(mm, last_vma_end - 1);
+			if (!vma)
+				break;
+			if (vma->vm_start >= last_vma_end)
+				continue;
+			if (vma->vm_end > last_vma_end) {
+				smap_gather_stats(vma, &mss, last_vma_end);
+				last_vma_end = vma->vm_end;
+			}
+		}
+		vma = vma->vm_next;
+	}
+
+	show_vma_header_prefix(m, vma_start, last_vma_end, 0, 0, 0, 0);
+	seq_pad(m, ' ');
+	seq_puts(m, "[rollup]\n");
+
+	__show_smap(m, &mss);
+
+	release_task_mempolicy(priv);
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+out_put_task:
+	put_task_struct(priv->task);
+	priv->task = NULL;
+
 	return ret;
 }
 
@@ -836,23 +903,44 @@ static int pid_smaps_open(struct inode *inode, struct file *file)
 	return do_maps_open(inode, file, &proc_pid_smaps_op);
 }
 
-static int pid_smaps_rollup_open(struct inode *inode, struct file *file)
+static int smaps_rollup_open(struct inode *inode, struct file *file)
 {
-	struct seq_file *seq;
 	struct proc_maps_private *priv;
-	int ret = do_maps_open(inode, file, &proc_pid_smaps_op);
-
-	if (ret < 0)
-		return ret;
-	seq = file->private_data;
-	priv = seq->private;
-	priv->rollup = kzalloc(sizeof(*priv->rollup), GFP_KERNEL);
-	if (!priv->rollup) {
-		proc_map_release(inode, file);
+	int ret;
+
+	priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+	if (!priv)
 		return -ENOMEM;
+
+	ret = single_open(file, show_smaps_rollup, priv);
+	if (ret)
+		goto out_free;
+
+	priv->inode = inode;
+	priv->mm = proc_mem_open(inode, PTRACE_MODE_READ);
+	if (IS_ERR(priv->mm)) {
+		ret = PTR_ERR(priv->mm);
+		single_release(inode, file);
+		goto out_free;
 	}
-	priv->rollup->first = true;
+
 	return 0;
+
+out_free:
+	kfree(priv);
+	return ret;
+}
+
+static int smaps_rollup_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *seq = file->private_data;
+	struct proc_maps_private *priv = seq->private;
+
+	if (priv->mm)
+		mmdrop(priv->mm);
+
+	kfree(priv);
+	return single_release(inode, file);
 }
 
 static int tid_smaps_open(struct inode *inode, struct file *file)
@@ -868,10 +956,10 @@ const struct file_operations proc_pid_smaps_operations = {
 };
 
 const struct file_operations proc_pid_smaps_rollup_operations = {
-	.open		= pid_smaps_rollup_open,
+	.open		= smaps_rollup_open,
 	.read		= seq_read,
 	.llseek		= seq_lseek,
-	.release	= proc_map_release,
+	.release	= smaps_rollup_release,
 };
 
 const struct file_operations proc_tid_smaps_operations = {
@@ -1103,8 +1191,10 @@ static ssize_t clear_refs_write(struct file *file, const char __user *buf,
 					goto out_mm;
 				}
 				for (vma = mm->mmap; vma; vma = vma->vm_next) {
+					vm_write_begin(vma);
 					vma->vm_flags &= ~VM_SOFTDIRTY;
 					vma_set_page_prot(vma);
+					vm_write_end(vma);
 				}
 				downgrade_write(&mm->mmap_sem);
 				break;
@@ -1508,6 +1598,39 @@ const struct file_operations proc_pagemap_operations = {
 #endif /* CONFIG_PROC_PAGE_MONITOR */
 
 #ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Age a page for idle-only reclaim. A page is only reclaimed once it has
+ * gone unreferenced since an earlier pass marked it idle; pages found in
+ * use are marked idle again so that a later pass can pick them up. Pages
+ * shared with other processes are left alone, their users are not seen
+ * through this page table.
+ */
+static bool reclaim_page_idle(struct vm_area_struct *vma, unsigned long addr,
+			      pte_t *pte, struct page *page)
+{
+	bool young;
+
+	if (page_mapcount(page) != 1)
+		return false;
+
+	young = ptep_test_and_clear_young(vma, addr, pte);
+#ifdef CONFIG_IDLE_PAGE_TRACKING
+	if (young) {
+		/* Keep the reference visible to vmscan */
+		set_page_young(page);
+		set_page_idle(page);
+		return false;
+	}
+	if (!page_is_idle(page)) {
+		set_page_idle(page);
+		return false;
+	}
+	return true;
+#else
+	return !young;
+#endif
+}
+
 static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
 				unsigned long end, struct mm_walk *walk)
 {
@@ -1535,6 +1658,12 @@ cont:
 		if (!page)
 			continue;
 
+		if (rp->idle_only &&
+		    !reclaim_page_idle(vma, addr, pte, page)) {
+			rp->nr_hot++;
+			continue;
+		}
+
 		if (isolate_lru_page(page))
 			continue;
 
@@ -1568,7 +1697,7 @@ enum reclaim_type {
 };
 
 struct reclaim_param reclaim_task_anon(struct task_struct *task,
-		int nr_to_reclaim)
+		int nr_to_reclaim, bool idle_only)
 {
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
@@ -1577,6 +1706,8 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 
 	rp.nr_reclaimed = 0;
 	rp.nr_scanned = 0;
+	rp.nr_hot = 0;
+	rp.idle_only = idle_only;
 	get_task_struct(task);
 	mm = get_task_mm(task);
 	if (!mm)
@@ -1609,6 +1740,13 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 
 	flush_tlb_mm(mm);
 	up_read(&mm->mmap_sem);
+
+	spin_lock(&mm->reclaim_stat.lock);
+	mm->reclaim_stat.last = rp.nr_reclaimed;
+	mm->reclaim_stat.scanned += rp.nr_scanned;
+	mm->reclaim_stat.reclaimed += rp.nr_reclaimed;
+	mm->reclaim_stat.hot += rp.nr_hot;
+	spin_unlock(&mm->reclaim_stat.lock);
 	mmput(mm);
 out:
 	put_task_struct(task);
@@ -1682,6 +1820,11 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 	if (!task)
 		return -ESRCH;
 
+	if (!ptrace_may_access(task, PTRACE_MODE_ATTACH_FSCREDS)) {
+		put_task_struct(task);
+		return -EACCES;
+	}
+
 	mm = get_task_mm(task);
 	if (!mm)
 		goto out;
@@ -1691,6 +1834,8 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 
 	rp.nr_to_reclaim = ~0;
 	rp.nr_reclaimed = 0;
+	rp.nr_hot = 0;
+	rp.idle_only = false;
 	reclaim_walk.private = &rp;
 
 	down_read(&mm->mmap_sem);
@@ -1736,9 +1881,51 @@ out_err:
 	return -EINVAL;
 }
 
+static int reclaim_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct task_struct *task;
+	struct mm_struct *mm;
+
+	task = get_proc_task(inode);
+	if (!task)
+		return -ESRCH;
+
+	mm = get_task_mm(task);
+	if (mm) {
+		struct mm_reclaim_stat *stat = &mm->reclaim_stat;
+		unsigned long scanned, reclaimed, hot, backoffs, last;
+
+		spin_lock(&stat->lock);
+		scanned = stat->scanned;
+		reclaimed = stat->reclaimed;
+		hot = stat->hot;
+		backoffs = stat->backoffs;
+		last = stat->last;
+		spin_unlock(&stat->lock);
+		mmput(mm);
+
+		seq_printf(m, "scanned %lu\n", scanned);
+		seq_printf(m, "reclaimed %lu\n", reclaimed);
+		seq_printf(m, "skipped_hot %lu\n", hot);
+		seq_printf(m, "backoffs %lu\n", backoffs);
+		seq_printf(m, "last %lu\n", last);
+	}
+	put_task_struct(task);
+	return 0;
+}
+
+static int reclaim_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, reclaim_show, inode);
+}
+
 const struct file_operations proc_reclaim_operations = {
+	.open		= reclaim_open,
+	.read		= seq_read,
 	.write		= reclaim_write,
-	.llseek		= noop_llseek,
+	.llseek		= seq_lseek,
+	.release	= single_release,
 };
 #endif
 
@@ -112,6 +112,9 @@ static int sdcardfs_d_revalidate(struct dentry *dentry, unsigned int flags)
 		}
 		if (data)
 			data_put(data);
+		/* the package list changed since this was derived */
+		if (err && package_perm_stale(dentry))
+			update_derived_permission_lock(dentry);
 		iput(inode);
 	}
 
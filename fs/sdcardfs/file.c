@@ -23,19 +23,11 @@
 #include <linux/backing-dev.h>
 #endif
 
-static ssize_t sdcardfs_read(struct file *file, char __user *buf,
-			   size_t count, loff_t *ppos)
-{
-	int err;
-	struct file *lower_file;
-	struct dentry *dentry = file->f_path.dentry;
 #ifdef CONFIG_SDCARD_FS_FADV_NOACTIVE
+static void sdcardfs_copy_noactive(struct file *file, struct file *lower_file)
+{
 	struct backing_dev_info *bdi;
-#endif
-
-	lower_file = sdcardfs_lower_file(file);
 
-#ifdef CONFIG_SDCARD_FS_FADV_NOACTIVE
 	if (file->f_mode & FMODE_NOACTIVE) {
 		if (!(lower_file->f_mode & FMODE_NOACTIVE)) {
 			bdi = lower_file->f_mapping->backing_dev_info;
@@ -45,8 +37,41 @@ static ssize_t sdcardfs_read(struct file *file, char __user *buf,
 			spin_unlock(&lower_file->f_lock);
 		}
 	}
+}
+#else
+static inline void sdcardfs_copy_noactive(struct file *file,
+					struct file *lower_file)
+{
+}
 #endif
 
+/* update our inode times+sizes upon a successful lower write */
+static void sdcardfs_copy_write_attrs(struct inode *inode,
+				struct file *lower_file)
+{
+	if (sizeof(loff_t) > sizeof(long))
+		inode_lock(inode);
+	fsstack_copy_inode_size(inode, file_inode(lower_file));
+	fsstack_copy_attr_times(inode, file_inode(lower_file));
+	if (sizeof(loff_t) > sizeof(long))
+		inode_unlock(inode);
+}
+
+/*
+ * Go through vfs_read()/vfs_write() on the lower file, so that its area
+ * checks, security hooks and fsnotify events apply as they would to a
+ * direct access. splice and sendfile end up here as well.
+ */
+static ssize_t sdcardfs_read(struct file *file, char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	int err;
+	struct file *lower_file;
+	struct dentry *dentry = file->f_path.dentry;
+
+	lower_file = sdcardfs_lower_file(file);
+	sdcardfs_copy_noactive(file, lower_file);
+
 	err = vfs_read(lower_file, buf, count, ppos);
 	/* update our inode atime upon a successful lower read */
 	if (err >= 0)
@@ -62,7 +87,6 @@ static ssize_t sdcardfs_write(struct file *file, const char __user *buf,
 	int err;
 	struct file *lower_file;
 	struct dentry *dentry = file->f_path.dentry;
-	struct inode *inode = d_inode(dentry);
 
 	/* check disk space */
 	if (!check_min_free_space(dentry, count, 0)) {
@@ -72,15 +96,8 @@ static ssize_t sdcardfs_write(struct file *file, const char __user *buf,
 
 	lower_file = sdcardfs_lower_file(file);
 	err = vfs_write(lower_file, buf, count, ppos);
-	/* update our inode times+sizes upon a successful lower write */
-	if (err >= 0) {
-		if (sizeof(loff_t) > sizeof(long))
-			inode_lock(inode);
-		fsstack_copy_inode_size(inode, file_inode(lower_file));
-		fsstack_copy_attr_times(inode, file_inode(lower_file));
-		if (sizeof(loff_t) > sizeof(long))
-			inode_unlock(inode);
-	}
+	if (err >= 0)
+		sdcardfs_copy_write_attrs(d_inode(dentry), lower_file);
 
 	return err;
 }
@@ -386,6 +403,8 @@ ssize_t sdcardfs_read_iter(struct kiocb *iocb, struct iov_iter *iter)
 		goto out;
 	}
 
+	sdcardfs_copy_noactive(file, lower_file);
+
 	get_file(lower_file); /* prevent lower_file from being released */
 	iocb->ki_filp = lower_file;
 	err = lower_file->f_op->read_iter(iocb, iter);
@@ -408,6 +427,13 @@ ssize_t sdcardfs_write_iter(struct kiocb *iocb, struct iov_iter *iter)
 	struct file *file = iocb->ki_filp, *lower_file;
 	struct inode *inode = file->f_path.dentry->d_inode;
 
+	/* check disk space */
+	if (!check_min_free_space(file->f_path.dentry,
+				iov_iter_count(iter), 0)) {
+		pr_err("No minimum free space.\n");
+		return -ENOSPC;
+	}
+
 	lower_file = sdcardfs_lower_file(file);
 	if (!lower_file->f_op->write_iter) {
 		err = -EINVAL;
@@ -416,18 +442,14 @@ ssize_t sdcardfs_write_iter(struct kiocb *iocb, struct iov_iter *iter)
 
 	get_file(lower_file); /* prevent lower_file from being released */
 	iocb->ki_filp = lower_file;
+	file_start_write(lower_file);
 	err = lower_file->f_op->write_iter(iocb, iter);
+	file_end_write(lower_file);
 	iocb->ki_filp = file;
 	fput(lower_file);
 	/* update upper inode times/sizes as needed */
-	if (err >= 0 || err == -EIOCBQUEUED) {
-		if (sizeof(loff_t) > sizeof(long))
-			inode_lock(inode);
-		fsstack_copy_inode_size(inode, file_inode(lower_file));
-		fsstack_copy_attr_times(inode, file_inode(lower_file));
-		if (sizeof(loff_t) > sizeof(long))
-			inode_unlock(inode);
-	}
+	if (err >= 0 || err == -EIOCBQUEUED)
+		sdcardfs_copy_write_attrs(inode, lower_file);
 out:
 	return err;
 }
@@ -20,6 +20,7 @@
 
 #include "sdcardfs.h"
 #include <linux/hashtable.h>
+#include <linux/hash.h>
 #include <linux/ctype.h>
 #include <linux/delay.h>
 #include <linux/radix-tree.h>
@@ -42,6 +43,15 @@ static DEFINE_HASHTABLE(package_to_appid, 8);
 static DEFINE_HASHTABLE(package_to_userid, 8);
 static DEFINE_HASHTABLE(ext_to_groupid, 8);
 
+/*
+ * Changes to the package list bump the generation of the package names
+ * they touch (hashed into buckets) instead of fixing up every mounted
+ * tree. Package directories compare against it on lookup.
+ */
+#define PACKAGE_GEN_BITS 8
+static atomic_t package_generation[1 << PACKAGE_GEN_BITS];
+static atomic_t package_generation_all;
+
 
 static struct kmem_cache *hashtable_entry_cachep;
 
@@ -95,6 +105,19 @@ appid_t get_appid(const char *key)
 	return __get_appid(&q);
 }
 
+/* Read before looking the package up, a racing change is then seen next time */
+unsigned int get_package_generation(const char *key)
+{
+	unsigned int hash = full_name_case_hash((const unsigned char *)key,
+						 strlen(key));
+	unsigned int gen;
+
+	gen = atomic_read(&package_generation_all) +
+		atomic_read(&package_generation[hash_32(hash, PACKAGE_GEN_BITS)]);
+	smp_rmb();
+	return gen;
+}
+
 static appid_t __get_ext_gid(const struct qstr *key)
 {
 	struct hashtable_entry *hash_cur;
@@ -249,44 +272,16 @@ static int insert_userid_exclude_entry_locked(const struct qstr *key, userid_t v
 	return 0;
 }
 
-static void fixup_all_perms_name(const struct qstr *key)
+static void bump_package_generation(const struct qstr *key)
 {
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_NAME,
-		.name = QSTR_INIT(key->name, key->len),
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
-}
-
-static void fixup_all_perms_name_userid(const struct qstr *key, userid_t userid)
-{
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_NAME | BY_USERID,
-		.name = QSTR_INIT(key->name, key->len),
-		.userid = userid,
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
+	/* the atomic op orders this after the hashtable update */
+	atomic_inc_return(&package_generation[hash_32(key->hash,
+						PACKAGE_GEN_BITS)]);
 }
 
-static void fixup_all_perms_userid(userid_t userid)
+static void bump_all_package_generations(void)
 {
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_USERID,
-		.userid = userid,
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
+	atomic_inc_return(&package_generation_all);
 }
 
 static int insert_packagelist_entry(const struct qstr *key, appid_t value)
@@ -296,7 +291,7 @@ static int insert_packagelist_entry(const struct qstr *key, appid_t value)
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_packagelist_appid_entry_locked(key, value);
 	if (!err)
-		fixup_all_perms_name(key);
+		bump_package_generation(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 
 	return err;
@@ -320,7 +315,7 @@ static int insert_userid_exclude_entry(const struct qstr *key, userid_t value)
 	mutex_lock(&sdcardfs_super_list_lock);
 	err = insert_userid_exclude_entry_locked(key, value);
 	if (!err)
-		fixup_all_perms_name_userid(key, value);
+		bump_package_generation(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 
 	return err;
@@ -361,7 +356,7 @@ static void remove_packagelist_entry(const struct qstr *key)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_packagelist_entry_locked(key);
-	fixup_all_perms_name(key);
+	bump_package_generation(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
@@ -410,7 +405,7 @@ static void remove_userid_all_entry(userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_all_entry_locked(userid);
-	fixup_all_perms_userid(userid);
+	bump_all_package_generations();
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
@@ -434,7 +429,7 @@ static void remove_userid_exclude_entry(const struct qstr *key, userid_t userid)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
 	remove_userid_exclude_entry_locked(key, userid);
-	fixup_all_perms_name_userid(key, userid);
+	bump_package_generation(key);
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
@@ -73,7 +73,7 @@ static long __estimate_accuracy(struct timespec *tv)
 
 u64 select_estimate_accuracy(struct timespec *tv)
 {
-	u64 ret;
+	u64 ret, slack;
 	struct timespec now;
 
 	/*
@@ -86,8 +86,9 @@ u64 select_estimate_accuracy(struct timespec *tv)
 	ktime_get_ts(&now);
 	now = timespec_sub(*tv, now);
 	ret = __estimate_accuracy(&now);
-	if (ret < current->timer_slack_ns)
-		return current->timer_slack_ns;
+	slack = task_get_effective_timer_slack(current);
+	if (ret < slack)
+		return slack;
 	return ret;
 }
 
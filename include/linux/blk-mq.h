@@ -69,6 +69,7 @@ struct blk_mq_tag_set {
 	unsigned int		nr_hw_queues;
 	unsigned int		queue_depth;	/* max hw supported */
 	unsigned int		reserved_tags;
+	unsigned int		sync_read_tags;	/* kept for sync reads */
 	unsigned int		cmd_size;	/* per-request extra data */
 	int			numa_node;
 	unsigned int		timeout;
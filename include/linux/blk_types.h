@@ -220,6 +220,7 @@ enum rq_flag_bits {
 	__REQ_MQ_INFLIGHT,	/* track inflight for MQ */
 	__REQ_NO_TIMEOUT,	/* requests may never expire */
 	__REQ_URGENT,		/* urgent request */
+	__REQ_MQ_ASYNC_TAG,	/* counted against the async tag depth */
 	__REQ_NR_BITS,		/* stops here */
 };
 
@@ -276,6 +277,7 @@ enum rq_flag_bits {
 #define REQ_PM			(1ULL << __REQ_PM)
 #define REQ_HASHED		(1ULL << __REQ_HASHED)
 #define REQ_MQ_INFLIGHT		(1ULL << __REQ_MQ_INFLIGHT)
+#define REQ_MQ_ASYNC_TAG	(1ULL << __REQ_MQ_ASYNC_TAG)
 #define REQ_NO_TIMEOUT		(1ULL << __REQ_NO_TIMEOUT)
 
 typedef unsigned int blk_qc_t;
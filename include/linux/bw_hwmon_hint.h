@@ -0,0 +1,40 @@
+/*
+ * Bandwidth hints for the bw_hwmon devfreq governor
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _BW_HWMON_HINT_H
+#define _BW_HWMON_HINT_H
+
+/*
+ * Bandwidth consumers whose traffic is known before it shows up on the
+ * bus. A hint raises the IB vote of every bw_hwmon node until it expires
+ * or until the measured traffic catches up with it.
+ */
+enum bw_hwmon_hint_client {
+	BW_HWMON_HINT_DISPLAY,
+	BW_HWMON_HINT_CAMERA,
+	BW_HWMON_HINT_VIDEO,
+	BW_HWMON_HINT_MAX
+};
+
+#ifdef CONFIG_DEVFREQ_GOV_QCOM_BW_HWMON
+int bw_hwmon_hint(enum bw_hwmon_hint_client client, unsigned long mbps,
+		  unsigned int duration_ms);
+#else
+static inline int bw_hwmon_hint(enum bw_hwmon_hint_client client,
+				unsigned long mbps, unsigned int duration_ms)
+{
+	return 0;
+}
+#endif
+
+#endif /* _BW_HWMON_HINT_H */
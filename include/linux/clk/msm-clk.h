@@ -135,4 +135,22 @@ int msm_clk_notif_register(struct clk *clk, struct notifier_block *nb);
 int msm_clk_notif_unregister(struct clk *clk, struct notifier_block *nb);
 
 #endif /* CONFIG_COMMON_CLK_MSM */
+
+struct clk;
+
+#if defined(CONFIG_COMMON_CLK_MSM) && defined(CONFIG_ARCH_MSM8998)
+/* Atomic rate switching of the OSM CPU clocks, for cpufreq fast switching */
+bool clk_osm_fast_switch_capable(struct clk *clk);
+int clk_osm_set_rate_fast(struct clk *clk, unsigned long rate);
+#else
+static inline bool clk_osm_fast_switch_capable(struct clk *clk)
+{
+	return false;
+}
+
+static inline int clk_osm_set_rate_fast(struct clk *clk, unsigned long rate)
+{
+	return -ENODEV;
+}
+#endif
 #endif
@@ -8,14 +8,42 @@
 #include <linux/devfreq.h>
 
 enum df_device {
+	DEVFREQ_CPU,
 	DEVFREQ_MSM_CPUBW,
+	DEVFREQ_MSM_MEMLAT_CPU0,
+	DEVFREQ_MSM_MEMLAT_CPU4,
+	DEVFREQ_KGSL_GPU,
+	DEVFREQ_UFS,
 	DEVFREQ_MAX
 };
 
+/*
+ * Typed boosts posted by userspace (or other drivers) ahead of a known burst
+ * of work. Each hint has its own per-domain frequency profile, duration and
+ * schedtune boost.
+ */
+enum boost_hint {
+	BOOST_HINT_LAUNCH,
+	BOOST_HINT_FLING,
+	BOOST_HINT_MAX,
+	BOOST_HINT_NONE = BOOST_HINT_MAX
+};
+
+/*
+ * Boost domains that aren't backed by a devfreq device (such as the CPU
+ * clusters) register an update hook instead. It is called from the boost
+ * thread, so it may sleep.
+ */
+typedef void (*devfreq_boost_update_t)(bool input_boost, bool max_boost,
+				       enum boost_hint hint);
+
 #ifdef CONFIG_DEVFREQ_BOOST
 void devfreq_boost_kick(enum df_device device);
 void devfreq_boost_kick_max(enum df_device device, unsigned int duration_ms);
+void devfreq_boost_kick_hint(enum boost_hint hint, unsigned int duration_ms);
 void devfreq_register_boost_device(enum df_device device, struct devfreq *df);
+void devfreq_register_boost_hook(enum df_device device,
+				 devfreq_boost_update_t update);
 #else
 static inline
 void devfreq_boost_kick(enum df_device device)
@@ -26,9 +54,18 @@ void devfreq_boost_kick_max(enum df_device device, unsigned int duration_ms)
 {
 }
 static inline
+void devfreq_boost_kick_hint(enum boost_hint hint, unsigned int duration_ms)
+{
+}
+static inline
 void devfreq_register_boost_device(enum df_device device, struct devfreq *df)
 {
 }
+static inline
+void devfreq_register_boost_hook(enum df_device device,
+				 devfreq_boost_update_t update)
+{
+}
 #endif
 
 #endif /* _DEVFREQ_BOOST_H_ */
@@ -959,6 +959,18 @@ static inline bool device_async_suspend_enabled(struct device *dev)
 	return !!dev->power.async_suspend;
 }
 
+/*
+ * Devices the user waits for on wakeup (display): resumed asynchronously
+ * and started before all other devices in the "resume" phase.
+ */
+static inline void device_enable_resume_first(struct device *dev)
+{
+	if (!dev->power.is_prepared) {
+		dev->power.async_suspend = true;
+		dev->power.resume_first = true;
+	}
+}
+
 static inline void pm_suspend_ignore_children(struct device *dev, bool enable)
 {
 	dev->power.ignore_children = enable;
@@ -1432,6 +1432,9 @@ struct super_block {
 	/* Number of inodes with nlink == 0 but still referenced */
 	atomic_long_t s_remove_count;
 
+	/* Number of dentries that were negative when put on s_dentry_lru */
+	atomic_long_t s_nr_negative_dentry;
+
 	/* Being remounted read-only */
 	int s_readonly_remount;
 
@@ -533,4 +533,12 @@ int input_ff_erase(struct input_dev *dev, int effect_id, struct file *file);
 int input_ff_create_memless(struct input_dev *dev, void *data,
 		int (*play_effect)(struct input_dev *, void *, struct ff_effect *));
 
+#ifdef CONFIG_INPUT_EVDEV_VSYNC
+void evdev_vsync(void);
+#else
+static inline void evdev_vsync(void)
+{
+}
+#endif
+
 #endif
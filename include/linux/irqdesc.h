@@ -1,6 +1,8 @@
 #ifndef _LINUX_IRQDESC_H
 #define _LINUX_IRQDESC_H
 
+#include <linux/percpu.h>
+
 /*
  * Core internal functions to deal with irq descriptors
  */
@@ -158,6 +160,33 @@ static inline int handle_domain_irq(struct irq_domain *domain,
 {
 	return __handle_domain_irq(domain, hwirq, true, regs);
 }
+
+/*
+ * The first interrupt handled through an IRQ domain on this CPU since the
+ * last irq_clear_wakeup_irq(). Idle governors clear it before entering idle
+ * and read it back after wakeup to learn which interrupt ended the idle
+ * period, whatever else was handled after it.
+ */
+DECLARE_PER_CPU(unsigned int, wakeup_domain_irq);
+
+static inline void irq_clear_wakeup_irq(void)
+{
+	__this_cpu_write(wakeup_domain_irq, 0);
+}
+
+static inline unsigned int irq_wakeup_irq(void)
+{
+	return __this_cpu_read(wakeup_domain_irq);
+}
+#else
+static inline void irq_clear_wakeup_irq(void)
+{
+}
+
+static inline unsigned int irq_wakeup_irq(void)
+{
+	return 0;
+}
 #endif
 
 /* Test to see if a driver has successfully requested an irq */
@@ -560,6 +560,7 @@ void tracing_off(void);
 int tracing_is_on(void);
 void tracing_snapshot(void);
 void tracing_snapshot_alloc(void);
+void tracing_snapshot_trigger(const char *reason);
 
 extern void tracing_start(void);
 extern void tracing_stop(void);
@@ -707,6 +708,7 @@ static inline void tracing_off(void) { }
 static inline int tracing_is_on(void) { return 0; }
 static inline void tracing_snapshot(void) { }
 static inline void tracing_snapshot_alloc(void) { }
+static inline void tracing_snapshot_trigger(const char *reason) { }
 
 static inline __printf(1, 2)
 int trace_printk(const char *fmt, ...)
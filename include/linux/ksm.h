@@ -21,12 +21,22 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
 void __ksm_exit(struct mm_struct *mm);
+int ksm_enable_merge_any(struct mm_struct *mm);
+int ksm_disable_merge_any(struct mm_struct *mm);
+unsigned long ksm_vma_flags(struct mm_struct *mm, struct file *file,
+			    unsigned long vm_flags);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
-	if (test_bit(MMF_VM_MERGEABLE, &oldmm->flags))
-		return __ksm_enter(mm);
-	return 0;
+	int err;
+
+	if (!test_bit(MMF_VM_MERGEABLE, &oldmm->flags))
+		return 0;
+
+	err = __ksm_enter(mm);
+	if (!err && test_bit(MMF_VM_MERGE_ANY, &oldmm->flags))
+		set_bit(MMF_VM_MERGE_ANY, &mm->flags);
+	return err;
 }
 
 static inline void ksm_exit(struct mm_struct *mm)
@@ -70,6 +80,13 @@ static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 	return 0;
 }
 
+static inline unsigned long ksm_vma_flags(struct mm_struct *mm,
+					  struct file *file,
+					  unsigned long vm_flags)
+{
+	return vm_flags;
+}
+
 static inline void ksm_exit(struct mm_struct *mm)
 {
 }
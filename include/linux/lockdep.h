@@ -486,6 +486,26 @@ static inline void lockdep_invariant_state(bool force) {}
 static inline void lockdep_init_task(struct task_struct *task) {}
 static inline void lockdep_free_task(struct task_struct *task) {}
 
+#ifdef CONFIG_LOCK_CONTENTION_SAMPLING
+/*
+ * Sampled contention profiling: only acquisitions whose trylock failed
+ * reach lock_contention_begin(), which returns 0 unless this one was
+ * picked to be timed.
+ */
+extern u64 lock_contention_begin(void);
+extern void lock_contention_end(void *lock, unsigned long ip, u64 start);
+#else
+static inline u64 lock_contention_begin(void)
+{
+	return 0;
+}
+
+static inline void lock_contention_end(void *lock, unsigned long ip,
+				       u64 start)
+{
+}
+#endif
+
 #ifdef CONFIG_LOCK_STAT
 
 extern void lock_contended(struct lockdep_map *lock, unsigned long ip);
@@ -512,6 +532,32 @@ do {								\
 	____err;						\
 })
 
+#elif defined(CONFIG_LOCK_CONTENTION_SAMPLING)
+
+#define lock_contended(lockdep_map, ip) do {} while (0)
+#define lock_acquired(lockdep_map, ip) do {} while (0)
+
+#define LOCK_CONTENDED(_lock, try, lock)			\
+do {								\
+	if (!try(_lock)) {					\
+		u64 ____start = lock_contention_begin();	\
+		lock(_lock);					\
+		lock_contention_end(_lock, _RET_IP_, ____start);	\
+	}							\
+} while (0)
+
+#define LOCK_CONTENDED_RETURN(_lock, try, lock)			\
+({								\
+	int ____err = 0;					\
+	if (!try(_lock)) {					\
+		u64 ____start = lock_contention_begin();	\
+		____err = lock(_lock);				\
+		if (!____err)					\
+			lock_contention_end(_lock, _RET_IP_, ____start); \
+	}							\
+	____err;						\
+})
+
 #else /* CONFIG_LOCK_STAT */
 
 #define lock_contended(lockdep_map, ip) do {} while (0)
@@ -535,6 +581,17 @@ do {								\
 #define LOCK_CONTENDED_FLAGS(_lock, try, lock, lockfl, flags) \
 	LOCK_CONTENDED((_lock), (try), (lock))
 
+#elif defined(CONFIG_LOCK_CONTENTION_SAMPLING)
+
+#define LOCK_CONTENDED_FLAGS(_lock, try, lock, lockfl, flags)	\
+do {								\
+	if (!try(_lock)) {					\
+		u64 ____start = lock_contention_begin();	\
+		lockfl((_lock), (flags));			\
+		lock_contention_end(_lock, _RET_IP_, ____start);	\
+	}							\
+} while (0)
+
 #else /* CONFIG_LOCKDEP */
 
 #define LOCK_CONTENDED_FLAGS(_lock, try, lock, lockfl, flags) \
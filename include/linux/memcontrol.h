@@ -766,6 +766,8 @@ static inline bool memcg_kmem_is_active(struct mem_cgroup *memcg)
 int __memcg_kmem_charge_memcg(struct page *page, gfp_t gfp, int order,
 			      struct mem_cgroup *memcg);
 int __memcg_kmem_charge(struct page *page, gfp_t gfp, int order);
+int __memcg_kmem_charge_mm(struct page *page, gfp_t gfp, int order,
+			   struct mm_struct *mm);
 void __memcg_kmem_uncharge(struct page *page, int order);
 
 /*
@@ -808,6 +810,25 @@ static __always_inline int memcg_kmem_charge(struct page *page,
 	return __memcg_kmem_charge(page, gfp, order);
 }
 
+/**
+ * memcg_kmem_charge_mm: charge a kmem page to the memcg of another mm
+ * @page: page to charge
+ * @gfp: reclaim mode
+ * @order: allocation order
+ * @mm: mm whose owner pays for the page
+ *
+ * For pages that are allocated on behalf of some other process, such as
+ * a binder buffer filled in by the sending thread. Returns 0 on success,
+ * an error code on failure.
+ */
+static __always_inline int memcg_kmem_charge_mm(struct page *page, gfp_t gfp,
+						int order, struct mm_struct *mm)
+{
+	if (!memcg_kmem_enabled() || (gfp & __GFP_NOACCOUNT) || !mm)
+		return 0;
+	return __memcg_kmem_charge_mm(page, gfp, order, mm);
+}
+
 /**
  * memcg_kmem_uncharge: uncharge a kmem page
  * @page: page to uncharge
@@ -858,6 +879,12 @@ static inline int memcg_kmem_charge(struct page *page, gfp_t gfp, int order)
 	return 0;
 }
 
+static inline int memcg_kmem_charge_mm(struct page *page, gfp_t gfp,
+				       int order, struct mm_struct *mm)
+{
+	return 0;
+}
+
 static inline void memcg_kmem_uncharge(struct page *page, int order)
 {
 }
@@ -1227,6 +1227,38 @@ static inline int fixup_user_fault(struct task_struct *tsk,
 }
 #endif
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Changes to a vma that a speculative fault relies on (its bounds, flags,
+ * protections or the page tables below it) are bracketed by these, with
+ * mmap_sem held for write.
+ */
+static inline void vm_write_begin(struct vm_area_struct *vma)
+{
+	raw_write_seqcount_begin(&vma->vm_sequence);
+}
+
+static inline void vm_write_end(struct vm_area_struct *vma)
+{
+	raw_write_seqcount_end(&vma->vm_sequence);
+}
+
+extern int handle_speculative_fault(struct mm_struct *mm,
+				    unsigned long address, unsigned int flags,
+				    unsigned long vm_flags);
+#else
+static inline void vm_write_begin(struct vm_area_struct *vma) {}
+static inline void vm_write_end(struct vm_area_struct *vma) {}
+
+static inline int handle_speculative_fault(struct mm_struct *mm,
+					   unsigned long address,
+					   unsigned int flags,
+					   unsigned long vm_flags)
+{
+	return VM_FAULT_RETRY;
+}
+#endif
+
 extern int access_process_vm(struct task_struct *tsk, unsigned long addr, void *buf, int len, int write);
 extern int access_remote_vm(struct mm_struct *mm, unsigned long addr,
 		void *buf, int len, unsigned int gup_flags);
@@ -2390,9 +2422,13 @@ struct reclaim_param {
 	int nr_to_reclaim;
 	/* pages reclaimed */
 	int nr_reclaimed;
+	/* pages skipped because they were recently used */
+	int nr_hot;
+	/* only reclaim pages that stayed idle since the previous pass */
+	bool idle_only;
 };
 extern struct reclaim_param reclaim_task_anon(struct task_struct *task,
-		int nr_to_reclaim);
+		int nr_to_reclaim, bool idle_only);
 #endif
 
 #endif /* __KERNEL__ */
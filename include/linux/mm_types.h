@@ -8,6 +8,7 @@
 #include <linux/spinlock.h>
 #include <linux/rbtree.h>
 #include <linux/rwsem.h>
+#include <linux/seqlock.h>
 #include <linux/completion.h>
 #include <linux/cpumask.h>
 #include <linux/uprobes.h>
@@ -360,6 +361,12 @@ struct vm_area_struct {
 	struct file * vm_file;		/* File we map to (can be NULL). */
 	void * vm_private_data;		/* was vm_pte (shared mem) */
 
+	/* Fault-around window state, see vma_fault_around_pages() */
+	unsigned int vm_fault_around_pages;
+	unsigned int vm_fault_around_ahead;
+	pgoff_t vm_fault_around_last;
+	pgoff_t vm_fault_around_next;
+
 #ifndef CONFIG_MMU
 	struct vm_region *vm_region;	/* NOMMU mapping region */
 #endif
@@ -367,6 +374,15 @@ struct vm_area_struct {
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
 	struct vm_userfaultfd_ctx vm_userfaultfd_ctx;
+#ifdef CONFIG_SWAP
+	/* last swap-in miss address | readahead window, see swap_state.c */
+	atomic_long_t swap_readahead_info;
+#endif
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	seqcount_t vm_sequence;		/* Odd while the vma is modified */
+	struct rcu_head vm_rcu;		/* Speculative faults look us up
+					   under RCU, see free_vma() */
+#endif
 };
 
 struct core_thread {
@@ -401,6 +417,19 @@ struct mm_rss_stat {
 };
 
 struct kioctx_table;
+#ifdef CONFIG_PROCESS_RECLAIM
+/* Per-mm process reclaim history, in pages unless noted otherwise */
+struct mm_reclaim_stat {
+	spinlock_t lock;
+	unsigned long maj_flt;		/* major faults when last considered */
+	unsigned long last;		/* reclaimed by the last run */
+	unsigned long scanned;
+	unsigned long reclaimed;
+	unsigned long hot;		/* skipped as recently used */
+	unsigned long backoffs;		/* runs skipped due to refaults */
+};
+#endif
+
 struct mm_struct {
 	struct vm_area_struct *mmap;		/* list of VMAs */
 	struct rb_root mm_rb;
@@ -531,6 +560,9 @@ struct mm_struct {
 #ifdef CONFIG_MSM_APP_SETTINGS
 	int app_setting;
 #endif
+#ifdef CONFIG_PROCESS_RECLAIM
+	struct mm_reclaim_stat reclaim_stat;
+#endif
 
 	struct work_struct async_put_work;
 };
@@ -35,6 +35,13 @@
  */
 #define PAGE_ALLOC_COSTLY_ORDER 3
 
+/*
+ * Orders for which kcompactd keeps a configurable number of free blocks
+ * around ahead of demand, starting at COMPACT_PROACTIVE_MIN_ORDER.
+ */
+#define COMPACT_PROACTIVE_MIN_ORDER 2
+#define COMPACT_PROACTIVE_ORDERS 3
+
 enum {
 	MIGRATE_UNMOVABLE,
 	MIGRATE_MOVABLE,
@@ -236,6 +243,8 @@ struct zone_reclaim_stat {
 struct lruvec {
 	struct list_head lists[NR_LRU_LISTS];
 	struct zone_reclaim_stat reclaim_stat;
+	/* Zone refault count at the last reclaim of this lruvec */
+	unsigned long refaults;
 #ifdef CONFIG_MEMCG
 	struct zone *zone;
 #endif
@@ -269,6 +278,12 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Orders 1..PCP_HIGH_ORDER are also cached on the pcp-lists so that
+ * kernel stacks, skb frags and GPU pool pages do not take zone->lock.
+ */
+#define PCP_HIGH_ORDER 3
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
@@ -276,6 +291,10 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* Base pages held on high_order_lists, bounded by high as well */
+	int high_order_count;
+	struct list_head high_order_lists[PCP_HIGH_ORDER][MIGRATE_PCPTYPES];
 };
 
 struct per_cpu_pageset {
@@ -515,6 +534,8 @@ struct zone {
 	unsigned int		compact_considered;
 	unsigned int		compact_defer_shift;
 	int			compact_order_failed;
+	/* Unusable free space index seen by the last proactive check */
+	int			compact_proactive_index[COMPACT_PROACTIVE_ORDERS];
 #endif
 
 #if defined CONFIG_COMPACTION || defined CONFIG_CMA
@@ -673,6 +694,7 @@ typedef struct pglist_data {
 	enum zone_type kcompactd_classzone_idx;
 	wait_queue_head_t kcompactd_wait;
 	struct task_struct *kcompactd;
+	bool kcompactd_proactive;
 #endif
 #ifdef CONFIG_NUMA_BALANCING
 	/* Lock serializing the migrate rate limiting window */
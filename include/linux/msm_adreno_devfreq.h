@@ -46,6 +46,14 @@ struct devfreq_msm_adreno_tz_data {
 		unsigned int *index;
 		uint64_t *ib;
 	} bus;
+	struct {
+		u64 busy_time;
+		u64 budget;
+		u32 target;
+		bool enable;
+		bool valid;
+		unsigned long last;
+	} frame;
 	unsigned int device_id;
 	bool is_64;
 	bool disable_busy_time_burst;
@@ -804,6 +804,25 @@ int gsi_get_evt_ring_cfg(unsigned long evt_ring_hdl,
 int gsi_set_evt_ring_cfg(unsigned long evt_ring_hdl,
 		struct gsi_evt_ring_props *props, union gsi_evt_scratch *scr);
 
+/**
+ * gsi_set_evt_ring_intr_moderation - Peripheral should call this function
+ * to change the interrupt moderation of an allocated event ring
+ *
+ * Unlike gsi_set_evt_ring_cfg the ring is not reset, so this can be used
+ * while channels on the ring are running
+ *
+ * @evt_ring_hdl:  Client handle previously obtained from
+ *             gsi_alloc_evt_ring
+ * @int_modt:      cycles base interrupt moderation (32KHz clock)
+ * @int_modc:      interrupt moderation packet counter
+ *
+ * This function can sleep
+ *
+ * @Return gsi_status
+ */
+int gsi_set_evt_ring_intr_moderation(unsigned long evt_ring_hdl,
+		uint16_t int_modt, uint8_t int_modc);
+
 /**
  * gsi_alloc_channel - Peripheral should call this function to
  * allocate a channel
@@ -1265,6 +1284,12 @@ static inline int gsi_set_evt_ring_cfg(unsigned long evt_ring_hdl,
 	return -GSI_STATUS_UNSUPPORTED_OP;
 }
 
+static inline int gsi_set_evt_ring_intr_moderation(unsigned long evt_ring_hdl,
+		uint16_t int_modt, uint8_t int_modc)
+{
+	return -GSI_STATUS_UNSUPPORTED_OP;
+}
+
 static inline int gsi_configure_regs(phys_addr_t gsi_base_addr, u32 gsi_size,
 		phys_addr_t per_base_addr)
 {
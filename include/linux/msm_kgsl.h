@@ -10,6 +10,9 @@ void kgsl_pwr_limits_del(void *limit);
 int kgsl_pwr_limits_set_freq(void *limit, unsigned int freq);
 void kgsl_pwr_limits_set_default(void *limit);
 unsigned int kgsl_pwr_limits_get_freq(enum kgsl_deviceid id);
+unsigned int kgsl_pwr_limits_get_level_freq(enum kgsl_deviceid id,
+	unsigned int level);
+unsigned int kgsl_pwr_limits_get_cur_freq(enum kgsl_deviceid id);
 #else
 static inline void *kgsl_pwr_limits_add(enum kgsl_deviceid id)
 {
@@ -29,6 +32,17 @@ static inline unsigned int kgsl_pwr_limits_get_freq(enum kgsl_deviceid id)
 {
 	return 0;
 }
+
+static inline unsigned int kgsl_pwr_limits_get_level_freq(
+	enum kgsl_deviceid id, unsigned int level)
+{
+	return 0;
+}
+
+static inline unsigned int kgsl_pwr_limits_get_cur_freq(enum kgsl_deviceid id)
+{
+	return 0;
+}
 #endif
 
 #endif /* _MSM_KGSL_H */
@@ -0,0 +1,21 @@
+#ifndef _LINUX_PREZERO_H
+#define _LINUX_PREZERO_H
+
+#include <linux/mm_types.h>
+
+#ifdef CONFIG_PREZERO_RESERVOIR
+/*
+ * Take a page of @order that was zeroed in the background. Higher orders
+ * are compound pages. The page is zeroed through the kernel mapping only;
+ * callers handing it to a device still own the cache maintenance.
+ * Returns NULL when the reservoir has nothing of that order, never blocks.
+ */
+struct page *prezero_alloc_page(unsigned int order);
+#else
+static inline struct page *prezero_alloc_page(unsigned int order)
+{
+	return NULL;
+}
+#endif
+
+#endif /* _LINUX_PREZERO_H */
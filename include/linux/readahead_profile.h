@@ -0,0 +1,29 @@
+#ifndef _LINUX_READAHEAD_PROFILE_H
+#define _LINUX_READAHEAD_PROFILE_H
+
+#include <linux/fs.h>
+#include <linux/atomic.h>
+
+#ifdef CONFIG_READAHEAD_PROFILE
+extern atomic_t ra_profile_recording;
+void __ra_profile_record(struct file *filp, pgoff_t offset,
+			 unsigned long nr_pages);
+
+/*
+ * Note readahead that was submitted for @filp. Only does anything while a
+ * launch is being recorded.
+ */
+static inline void ra_profile_record(struct file *filp, pgoff_t offset,
+				     unsigned long nr_pages)
+{
+	if (atomic_read(&ra_profile_recording) && filp)
+		__ra_profile_record(filp, offset, nr_pages);
+}
+#else
+static inline void ra_profile_record(struct file *filp, pgoff_t offset,
+				     unsigned long nr_pages)
+{
+}
+#endif
+
+#endif /* _LINUX_READAHEAD_PROFILE_H */
@@ -526,6 +526,7 @@ static inline int get_dumpable(struct mm_struct *mm)
 
 #define MMF_HAS_UPROBES		19	/* has uprobes */
 #define MMF_RECALC_UPROBES	20	/* MMF_HAS_UPROBES can be wrong */
+#define MMF_VM_MERGE_ANY	21	/* KSM may merge any anonymous vma */
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -1395,6 +1396,7 @@ struct sched_statistics {
 
 #ifdef CONFIG_SCHED_WALT
 #define RAVG_HIST_SIZE_MAX  5
+#define NUM_BUSY_BUCKETS 10
 
 /* ravg represents frequency scaled cpu-demand of tasks */
 struct ravg {
@@ -1419,13 +1421,31 @@ struct ravg {
 	 *
 	 * 'prev_window' represents task's contribution to cpu busy time
 	 * statistics (rq->prev_runnable_sum) in previous window
+	 *
+	 * 'pred_demand' is the busy time predicted for the next window from
+	 * 'busy_buckets', a decaying histogram of past window sums split into
+	 * NUM_BUSY_BUCKETS equal slices of the window
 	 */
 	u64 mark_start;
 	u32 sum, demand;
 	u32 sum_history[RAVG_HIST_SIZE_MAX];
 	u32 curr_window, prev_window;
 	u16 active_windows;
+	u32 pred_demand;
+	u8 busy_buckets[NUM_BUSY_BUCKETS];
 };
+
+extern unsigned int walt_ravg_window;
+extern unsigned int walt_cpu_ravg_window[NR_CPUS];
+
+/*
+ * WALT window size in ns used by @cpu: the walt_cluster_window= override
+ * for its cluster if one was given, walt_ravg_window otherwise.
+ */
+static inline unsigned int walt_window_of(int cpu)
+{
+	return walt_cpu_ravg_window[cpu] ? : walt_ravg_window;
+}
 #endif
 
 struct sched_entity {
@@ -1599,6 +1619,13 @@ struct task_struct {
 	 */
 	int recent_used_cpu;
 	int wake_cpu;
+	/*
+	 * wake_hint_cpu is set by a synchronous RPC partner (binder) right
+	 * before it wakes the task and goes to sleep waiting for the answer,
+	 * asking for the wakee to be placed close to that CPU. Consumed by
+	 * the next wakeup, -1 when unset.
+	 */
+	int wake_hint_cpu;
 #endif
 	int on_rq;
 
@@ -1651,8 +1678,15 @@ struct task_struct {
 #ifdef CONFIG_SCHED_INFO
 	struct sched_info sched_info;
 #endif
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+	u64 wake_hist_ts;
+	u8 wake_hist_path;
+#endif
 
 	struct list_head tasks;
+#ifdef CONFIG_ANDROID_SIMPLE_LMK
+	struct hlist_node simple_lmk_node;
+#endif
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 	struct rb_node pushable_dl_tasks;
@@ -2116,6 +2150,15 @@ static inline bool should_numa_migrate_memory(struct task_struct *p,
 }
 #endif
 
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+extern u64 task_get_effective_timer_slack(struct task_struct *tsk);
+#else
+static inline u64 task_get_effective_timer_slack(struct task_struct *tsk)
+{
+	return tsk->timer_slack_ns;
+}
+#endif
+
 static inline struct pid *task_pid(struct task_struct *task)
 {
 	return task->pids[PIDTYPE_PID].pid;
@@ -3452,6 +3495,11 @@ static inline int task_node(const struct task_struct *p)
 
 extern void set_task_cpu(struct task_struct *p, unsigned int cpu);
 
+static inline void sched_set_wake_hint(struct task_struct *p, int cpu)
+{
+	WRITE_ONCE(p->wake_hint_cpu, cpu);
+}
+
 #else
 
 static inline unsigned int task_cpu(const struct task_struct *p)
@@ -3463,6 +3511,10 @@ static inline void set_task_cpu(struct task_struct *p, unsigned int cpu)
 {
 }
 
+static inline void sched_set_wake_hint(struct task_struct *p, int cpu)
+{
+}
+
 #endif /* CONFIG_SMP */
 
 /*
@@ -109,6 +109,14 @@ static inline unsigned int get_sysctl_sched_cfs_boost(void)
 }
 #endif
 
+#ifdef CONFIG_CGROUP_SCHEDTUNE
+void schedtune_set_hint_boost(int boost);
+#else
+static inline void schedtune_set_hint_boost(int boost)
+{
+}
+#endif
+
 extern int sysctl_sched_rr_timeslice;
 extern int sched_rr_timeslice;
 
@@ -5,14 +5,47 @@
 #ifndef _SIMPLE_LMK_H_
 #define _SIMPLE_LMK_H_
 
+#include <linux/types.h>
+
 struct mm_struct;
+struct task_struct;
 
 #ifdef CONFIG_ANDROID_SIMPLE_LMK
 void simple_lmk_mm_freed(struct mm_struct *mm);
+void simple_lmk_task_fork(struct task_struct *tsk);
+void simple_lmk_task_exit(struct task_struct *tsk);
+void simple_lmk_leader_change(struct task_struct *old, struct task_struct *tsk);
+void simple_lmk_adj_changed(struct task_struct *tsk);
 #else
 static inline void simple_lmk_mm_freed(struct mm_struct *mm)
 {
 }
+static inline void simple_lmk_task_fork(struct task_struct *tsk)
+{
+}
+static inline void simple_lmk_task_exit(struct task_struct *tsk)
+{
+}
+static inline void simple_lmk_leader_change(struct task_struct *old,
+					    struct task_struct *tsk)
+{
+}
+static inline void simple_lmk_adj_changed(struct task_struct *tsk)
+{
+}
+#endif
+
+#ifdef CONFIG_ANDROID_SIMPLE_LMK_PREKILL
+u64 simple_lmk_stall_begin(void);
+void simple_lmk_stall_end(u64 start);
+#else
+static inline u64 simple_lmk_stall_begin(void)
+{
+	return 0;
+}
+static inline void simple_lmk_stall_end(u64 start)
+{
+}
 #endif
 
 #endif /* _SIMPLE_LMK_H_ */
@@ -35,6 +35,10 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	ALLOC_CPU_ARRAY,	/* Allocation from cpu array */
+	FREE_CPU_ARRAY,		/* Free to cpu array */
+	CPU_ARRAY_REFILL,	/* Refill cpu array from cpu slab */
+	CPU_ARRAY_FLUSH,	/* Flush cpu array to slabs */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
@@ -47,6 +51,17 @@ struct kmem_cache_cpu {
 #endif
 };
 
+#ifdef CONFIG_SLUB_CPU_ARRAY
+#define SLUB_CPU_ARRAY_SIZE	32
+#define SLUB_CPU_ARRAY_BATCH	(SLUB_CPU_ARRAY_SIZE / 2)
+
+/* Free objects kept in front of the cpu slab, accessed with irqs off */
+struct kmem_cache_array {
+	unsigned int count;
+	void *objects[SLUB_CPU_ARRAY_SIZE];
+};
+#endif
+
 /*
  * Word size structure that can be atomically updated or read and that
  * contains both the order and the number of objects that a slab of the
@@ -61,6 +76,9 @@ struct kmem_cache_order_objects {
  */
 struct kmem_cache {
 	struct kmem_cache_cpu __percpu *cpu_slab;
+#ifdef CONFIG_SLUB_CPU_ARRAY
+	struct kmem_cache_array __percpu *cpu_array;
+#endif
 	/* Used for retriving partial slabs etc */
 	unsigned long flags;
 	unsigned long min_partial;
@@ -490,8 +490,8 @@ do {									\
 	hrtimer_init_sleeper(&__t, current);				\
 	if ((timeout) != KTIME_MAX)				\
 		hrtimer_start_range_ns(&__t.timer, timeout,		\
-				       current->timer_slack_ns,		\
-				       HRTIMER_MODE_REL);		\
+			task_get_effective_timer_slack(current),	\
+			HRTIMER_MODE_REL);				\
 									\
 	__ret = ___wait_event(wq, condition, state, 0, 0,		\
 		if (!__t.task) {					\
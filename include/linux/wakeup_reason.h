@@ -20,9 +20,18 @@
 
 #define MAX_SUSPEND_ABORT_LEN 256
 
+struct device;
+
 void log_wakeup_reason(int irq);
 int check_wakeup_reason(int irq);
 
+#ifdef CONFIG_DEDUCE_WAKEUP_REASONS
+void log_resume_latency(struct device *dev, const char *info, s64 usecs);
+#else
+static inline void log_resume_latency(struct device *dev, const char *info,
+				      s64 usecs) { }
+#endif
+
 #ifdef DEDUCE_WAKEUP_REASONS
 void log_suspend_abort_reason(const char *fmt, ...);
 #else
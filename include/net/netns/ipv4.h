@@ -92,6 +92,7 @@ struct netns_ipv4 {
 	int sysctl_tcp_min_snd_mss;
 	int sysctl_tcp_probe_threshold;
 	u32 sysctl_tcp_probe_interval;
+	int sysctl_tcp_mobile_autotune;
 
 	struct ping_group_range ping_group_range;
 
@@ -498,6 +498,9 @@ struct scsi_host_template {
 
 	/* temporary flag to disable blk-mq I/O path */
 	bool disable_blk_mq;
+
+	/* use the blk-mq I/O path even if scsi_mod.use_blk_mq is off */
+	bool force_blk_mq;
 };
 
 /*
@@ -630,6 +633,12 @@ struct Scsi_Host {
 	 * is nr_hw_queues * can_queue.
 	 */
 	unsigned nr_hw_queues;
+
+	/*
+	 * In scsi-mq mode, the number of tags writes and idle class reads
+	 * may not use, kept for synchronous reads.
+	 */
+	unsigned sync_read_tags;
 	/* 
 	 * Used to assign serial numbers to the cmds.
 	 * Protected by the host lock.
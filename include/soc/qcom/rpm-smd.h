@@ -179,6 +179,25 @@ int msm_rpm_wait_for_ack_noirq(uint32_t msg_id);
 int msm_rpm_send_message(enum msm_rpm_set set, uint32_t rsc_type,
 		uint32_t rsc_id, struct msm_rpm_kvp *kvp, int nelems);
 
+/**
+ * msm_rpm_send_message_nowait() -Wrapper function for clients to send data
+ * given an array of key value pairs and collect the ack later. This lets
+ * clients with several resources to update have all the requests in flight
+ * at once instead of waiting for each ack in turn.
+ *
+ * @set: if the device is setting the active/sleep set parameter
+ * for the resource
+ * @rsc_type: unsigned 32 bit integer that identifies the type of the resource
+ * @rsc_id: unsigned 32 bit that uniquely identifies a resource within a type
+ * @kvp: array of KVP data.
+ * @nelem: number of KVPs pairs associated with the message.
+ *
+ * returns a msg id to be passed to msm_rpm_wait_for_ack() on success and
+ * errno on failure.
+ */
+int msm_rpm_send_message_nowait(enum msm_rpm_set set, uint32_t rsc_type,
+		uint32_t rsc_id, struct msm_rpm_kvp *kvp, int nelems);
+
 /**
  * msm_rpm_send_message_noack() -Wrapper function for clients to send data
  * given an array of key value pairs without waiting for ack.
@@ -277,6 +296,13 @@ static inline int msm_rpm_send_message(enum msm_rpm_set set, uint32_t rsc_type,
 	return 0;
 }
 
+static inline int msm_rpm_send_message_nowait(enum msm_rpm_set set,
+		uint32_t rsc_type, uint32_t rsc_id, struct msm_rpm_kvp *kvp,
+		int nelems)
+{
+	return 1;
+}
+
 static inline int msm_rpm_send_message_noirq(enum msm_rpm_set set,
 		uint32_t rsc_type, uint32_t rsc_id, struct msm_rpm_kvp *kvp,
 		int nelems)
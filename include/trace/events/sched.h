@@ -762,7 +762,7 @@ TRACE_EVENT(sched_load_avg_task,
 		__entry->util_avg_walt  = 0;
 #ifdef CONFIG_SCHED_WALT
 		__entry->util_avg_walt = (((unsigned long)((struct ravg*)_ravg)->demand) << SCHED_LOAD_SHIFT);
-		do_div(__entry->util_avg_walt, walt_ravg_window);
+		do_div(__entry->util_avg_walt, walt_window_of(task_cpu(tsk)));
 		if (!walt_disabled && sysctl_sched_use_walt_task_util)
 			__entry->util_avg = __entry->util_avg_walt;
 #endif
@@ -808,7 +808,7 @@ TRACE_EVENT(sched_load_avg_cpu,
 #ifdef CONFIG_SCHED_WALT
 		__entry->util_avg_walt =
 				div64_u64(cpu_rq(cpu)->cumulative_runnable_avg,
-						  walt_ravg_window >> SCHED_LOAD_SHIFT);
+						  walt_window_of(cpu) >> SCHED_LOAD_SHIFT);
 		if (!walt_disabled && sysctl_sched_use_walt_cpu_util)
 			__entry->util_avg		= __entry->util_avg_walt;
 #endif
@@ -1164,7 +1164,7 @@ TRACE_EVENT(walt_update_task_ravg,
 		__entry->cs             = rq->curr_runnable_sum;
 		__entry->ps             = rq->prev_runnable_sum;
 		__entry->util           = rq->prev_runnable_sum << SCHED_LOAD_SHIFT;
-		do_div(__entry->util, walt_ravg_window);
+		do_div(__entry->util, walt_window_of(cpu_of(rq)));
 		__entry->curr_window	= p->ravg.curr_window;
 		__entry->prev_window	= p->ravg.prev_window;
 		__entry->nt_cs		= rq->nt_curr_runnable_sum;
@@ -1199,6 +1199,7 @@ TRACE_EVENT(walt_update_history,
 		__field(	 int,	samples			)
 		__field(	 int,	evt			)
 		__field(	 u64,	demand			)
+		__field(	 u32,	pred_demand		)
 		__field(	 u64,	walt_avg		)
 		__field(unsigned int,	pelt_avg		)
 		__array(	 u32,	hist, RAVG_HIST_SIZE_MAX)
@@ -1212,8 +1213,9 @@ TRACE_EVENT(walt_update_history,
 		__entry->samples        = samples;
 		__entry->evt            = evt;
 		__entry->demand         = p->ravg.demand;
+		__entry->pred_demand    = p->ravg.pred_demand;
 		__entry->walt_avg	= (__entry->demand << 10);
-		do_div(__entry->walt_avg, walt_ravg_window);
+		do_div(__entry->walt_avg, walt_window_of(rq->cpu));
 		__entry->pelt_avg	= p->se.avg.util_avg;
 		memcpy(__entry->hist, p->ravg.sum_history,
 					RAVG_HIST_SIZE_MAX * sizeof(u32));
@@ -1221,10 +1223,10 @@ TRACE_EVENT(walt_update_history,
 	),
 
 	TP_printk("%d (%s): runtime %u samples %d event %d demand %llu"
-		" walt %llu pelt %u (hist: %u %u %u %u %u) cpu %d",
+		" pred_demand %u walt %llu pelt %u (hist: %u %u %u %u %u) cpu %d",
 		__entry->pid, __entry->comm,
 		__entry->runtime, __entry->samples, __entry->evt,
-		__entry->demand,
+		__entry->demand, __entry->pred_demand,
 		__entry->walt_avg,
 		__entry->pelt_avg,
 		__entry->hist[0], __entry->hist[1],
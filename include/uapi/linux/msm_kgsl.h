@@ -143,6 +143,13 @@
 #define KGSL_MEMFLAGS_SPARSE_PHYS 0x20000000ULL
 #define KGSL_MEMFLAGS_SPARSE_VIRT 0x40000000ULL
 
+/*
+ * Reserve the GPU range but only back it with memory on first CPU access or
+ * through IOCTL_KGSL_GPUOBJ_COMMIT. Until then the GPU reads zeros and
+ * writes fault.
+ */
+#define KGSL_MEMFLAGS_LAZY_COMMIT 0x800000000ULL
+
 /* Memory types for which allocations are made */
 #define KGSL_MEMTYPE_MASK		0x0000FF00
 #define KGSL_MEMTYPE_SHIFT		8
@@ -324,6 +331,8 @@ enum kgsl_timestamp_type {
 #define KGSL_PROP_IB_TIMEOUT 0x21
 #define KGSL_PROP_SECURE_BUFFER_ALIGNMENT 0x23
 #define KGSL_PROP_SECURE_CTXT_SUPPORT 0x24
+#define KGSL_PROP_CONTEXT_DEADLINE 0x25
+#define KGSL_PROP_CONTEXT_GPU_TIME 0x26
 
 struct kgsl_shadowprop {
 	unsigned long gpuaddr;
@@ -1118,6 +1127,34 @@ struct kgsl_device_constraint_pwrlevel {
 	unsigned int level;
 };
 
+/**
+ * struct kgsl_context_gpu_time - argument to KGSL_PROP_CONTEXT_GPU_TIME
+ * @context_id: KGSL context ID, set by the caller
+ * @gpu_time: Returned cumulative GPU execution time of the context in
+ * nanoseconds
+ */
+struct kgsl_context_gpu_time {
+	unsigned int context_id;
+/* private: reserved for future use */
+	unsigned int __pad;
+/* public: */
+	uint64_t gpu_time;
+};
+
+/**
+ * struct kgsl_context_deadline - argument to KGSL_PROP_CONTEXT_DEADLINE
+ * @context_id: KGSL context ID
+ * @deadline: CLOCK_MONOTONIC time in nanoseconds by which the next frame
+ * of the context should be done, 0 to clear
+ */
+struct kgsl_context_deadline {
+	unsigned int context_id;
+/* private: reserved for future use */
+	unsigned int __pad;
+/* public: */
+	uint64_t deadline;
+};
+
 /**
  * struct kgsl_syncsource_create - Argument to IOCTL_KGSL_SYNCSOURCE_CREATE
  * @id: returned id for the syncsource that was created.
@@ -1599,4 +1636,20 @@ struct kgsl_gpu_sparse_command {
 #define IOCTL_KGSL_GPU_SPARSE_COMMAND \
 	_IOWR(KGSL_IOC_TYPE, 0x55, struct kgsl_gpu_sparse_command)
 
+/**
+ * struct kgsl_gpuobj_commit - Argument for IOCTL_KGSL_GPUOBJ_COMMIT
+ * @offset: Offset into the object of the range to back with memory
+ * @length: Length of the range
+ * @id: GPU object ID, the object must have KGSL_MEMFLAGS_LAZY_COMMIT set
+ */
+struct kgsl_gpuobj_commit {
+	uint64_t offset;
+	uint64_t length;
+	unsigned int id;
+	unsigned int __pad;
+};
+
+#define IOCTL_KGSL_GPUOBJ_COMMIT \
+	_IOW(KGSL_IOC_TYPE, 0x56, struct kgsl_gpuobj_commit)
+
 #endif /* _UAPI_MSM_KGSL_H */
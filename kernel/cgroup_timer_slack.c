@@ -0,0 +1,96 @@
+/*
+ * Timer slack controller for cgroups.
+ *
+ * Tasks in a cgroup get at least timer_slack.min_slack_ns of slack on
+ * their sleeps (nanosleep, poll/select, futex and hrtimer based waits),
+ * whatever they set for themselves with PR_SET_TIMERSLACK. Putting the
+ * background tasks in a cgroup with a large minimum lets the hrtimer
+ * code fire their wakeups together with other pending ones, so idle CPUs
+ * stay in deep low power states for longer.
+ *
+ * A new cgroup starts with the minimum of its parent. The root cgroup has
+ * no minimum.
+ *
+ * This file is subject to the terms and conditions of version 2 of the GNU
+ * General Public License.  See the file COPYING in the main directory of the
+ * Linux distribution for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cgroup.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+struct tslack_cgroup {
+	struct cgroup_subsys_state	css;
+	u64				min_slack_ns;
+};
+
+static struct tslack_cgroup *css_tslack(struct cgroup_subsys_state *css)
+{
+	return container_of(css, struct tslack_cgroup, css);
+}
+
+static struct cgroup_subsys_state *
+tslack_css_alloc(struct cgroup_subsys_state *parent)
+{
+	struct tslack_cgroup *tslack;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	if (parent)
+		tslack->min_slack_ns = css_tslack(parent)->min_slack_ns;
+
+	return &tslack->css;
+}
+
+static void tslack_css_free(struct cgroup_subsys_state *css)
+{
+	kfree(css_tslack(css));
+}
+
+static u64 tslack_min_slack_read(struct cgroup_subsys_state *css,
+				 struct cftype *cft)
+{
+	return READ_ONCE(css_tslack(css)->min_slack_ns);
+}
+
+static int tslack_min_slack_write(struct cgroup_subsys_state *css,
+				  struct cftype *cft, u64 val)
+{
+	WRITE_ONCE(css_tslack(css)->min_slack_ns, val);
+	return 0;
+}
+
+u64 task_get_effective_timer_slack(struct task_struct *tsk)
+{
+	u64 min_slack;
+
+	rcu_read_lock();
+	min_slack = READ_ONCE(css_tslack(task_css(tsk,
+				timer_slack_cgrp_id))->min_slack_ns);
+	rcu_read_unlock();
+
+	return max(tsk->timer_slack_ns, min_slack);
+}
+EXPORT_SYMBOL_GPL(task_get_effective_timer_slack);
+
+static struct cftype tslack_files[] = {
+	{
+		.name = "min_slack_ns",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = tslack_min_slack_read,
+		.write_u64 = tslack_min_slack_write,
+	},
+	{ }	/* terminate */
+};
+
+struct cgroup_subsys timer_slack_cgrp_subsys = {
+	.css_alloc	= tslack_css_alloc,
+	.css_free	= tslack_css_free,
+	.legacy_cftypes	= tslack_files,
+	.dfl_cftypes	= tslack_files,
+};
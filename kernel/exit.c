@@ -56,6 +56,7 @@
 #include <linux/kcov.h>
 #include <linux/cpufreq.h>
 #include <linux/rcuwait.h>
+#include <linux/simple_lmk.h>
 
 #include "sched/tune.h"
 
@@ -75,6 +76,7 @@ static void __unhash_process(struct task_struct *p, bool group_dead)
 		detach_pid(p, PIDTYPE_SID);
 
 		list_del_rcu(&p->tasks);
+		simple_lmk_task_exit(p);
 		list_del_init(&p->sibling);
 		__this_cpu_dec(process_counts);
 	}
@@ -627,6 +627,10 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 	mm->locked_vm = 0;
 	mm->pinned_vm = 0;
 	memset(&mm->rss_stat, 0, sizeof(mm->rss_stat));
+#ifdef CONFIG_PROCESS_RECLAIM
+	memset(&mm->reclaim_stat, 0, sizeof(mm->reclaim_stat));
+	spin_lock_init(&mm->reclaim_stat.lock);
+#endif
 	spin_lock_init(&mm->page_table_lock);
 	mm_init_cpumask(mm);
 	mm_init_aio(mm);
@@ -1594,6 +1598,9 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 
 	p->pdeath_signal = 0;
 	INIT_LIST_HEAD(&p->thread_group);
+#ifdef CONFIG_ANDROID_SIMPLE_LMK
+	INIT_HLIST_NODE(&p->simple_lmk_node);
+#endif
 	p->task_works = NULL;
 
 	threadgroup_change_begin(current);
@@ -1676,6 +1683,7 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 			p->signal->tty = tty_kref_get(current->signal->tty);
 			list_add_tail(&p->sibling, &p->real_parent->children);
 			list_add_tail_rcu(&p->tasks, &init_task.tasks);
+			simple_lmk_task_fork(p);
 			attach_pid(p, PIDTYPE_PGID);
 			attach_pid(p, PIDTYPE_SID);
 			__this_cpu_inc(process_counts);
@@ -2743,7 +2743,7 @@ static int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 	q.bitset = bitset;
 
 	to = futex_setup_timer(abs_time, &timeout, flags,
-			       current->timer_slack_ns);
+			       task_get_effective_timer_slack(current));
 retry:
 	/*
 	 * Prepare to wait on uaddr. On success, holds hb lock and increments
@@ -2810,6 +2810,153 @@ static long futex_wait_restart(struct restart_block *restart)
 				restart->futex.val, tp, restart->futex.bitset);
 }
 
+/* Upper bound for one round of spinning in futex_lock() */
+#define FUTEX_SPIN_MAX_NS	(50 * NSEC_PER_USEC)
+
+#ifdef CONFIG_SMP
+/*
+ * Spin while the owner of a FUTEX_LOCK futex runs, like
+ * mutex_spin_on_owner() does for kernel mutexes: an owner that is on a
+ * CPU is likely to release the lock before we could even go to sleep.
+ *
+ * Return:
+ *  -  0 - the futex value changed, try to take the lock again;
+ *  -  1 - the owner is not running or we spun long enough, go to sleep.
+ */
+static int futex_spin_on_owner(u32 __user *uaddr, u32 uval, u64 deadline)
+{
+	struct task_struct *owner;
+	u32 curval;
+	int ret = 1;
+
+	rcu_read_lock();
+	owner = find_task_by_vpid(uval & FUTEX_TID_MASK);
+	while (owner && READ_ONCE(owner->on_cpu)) {
+		if (need_resched() || local_clock() > deadline)
+			break;
+		/* A fault is dealt with on the sleeping path */
+		if (get_futex_value_locked(&curval, uaddr))
+			break;
+		if (curval != uval) {
+			ret = 0;
+			break;
+		}
+		cpu_relax_lowlatency();
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+#else
+static inline int futex_spin_on_owner(u32 __user *uaddr, u32 uval,
+				      u64 deadline)
+{
+	return 1;
+}
+#endif
+
+/*
+ * FUTEX_LOCK is an adaptive mutex on a futex word that holds the owner's
+ * TID, like a PI futex but without the PI state. Userspace tries the
+ * 0 -> TID transition itself and calls in on contention. The kernel takes
+ * the lock for it, spinning first while the owner runs, and only then
+ * sets FUTEX_WAITERS and sleeps on the futex.
+ *
+ * To unlock, userspace swaps in 0 and does a FUTEX_WAKE of one waiter if
+ * FUTEX_WAITERS was set. A waiter that slept takes the lock with
+ * FUTEX_WAITERS set, since others may still be queued.
+ */
+static int futex_lock(u32 __user *uaddr, unsigned int flags,
+		      ktime_t *abs_time)
+{
+	struct hrtimer_sleeper timeout, *to;
+	struct futex_hash_bucket *hb;
+	struct futex_q q = futex_q_init;
+	u32 uval, curval, newval, vpid = task_pid_vnr(current);
+	u32 waiters = 0;
+	u64 deadline;
+	int ret;
+
+	to = futex_setup_timer(abs_time, &timeout, flags,
+			       task_get_effective_timer_slack(current));
+	deadline = local_clock() + FUTEX_SPIN_MAX_NS;
+retry:
+	ret = -EFAULT;
+	if (get_user(uval, uaddr))
+		goto out;
+
+	if (!(uval & FUTEX_TID_MASK)) {
+		newval = uval | waiters | vpid;
+		ret = cmpxchg_futex_value_locked(&curval, uaddr, uval, newval);
+		if (ret == -EFAULT) {
+			ret = fault_in_user_writeable(uaddr);
+			if (ret)
+				goto out;
+			goto retry;
+		}
+		if (ret || curval != uval)
+			goto retry;
+		goto out;
+	}
+
+	ret = -EDEADLK;
+	if ((uval & FUTEX_TID_MASK) == vpid)
+		goto out;
+
+	if (!futex_spin_on_owner(uaddr, uval, deadline))
+		goto retry;
+
+	if (!(uval & FUTEX_WAITERS)) {
+		newval = uval | FUTEX_WAITERS;
+		ret = cmpxchg_futex_value_locked(&curval, uaddr, uval, newval);
+		if (ret == -EFAULT) {
+			ret = fault_in_user_writeable(uaddr);
+			if (ret)
+				goto out;
+			goto retry;
+		}
+		if (ret || curval != uval)
+			goto retry;
+		uval = newval;
+	}
+
+	/* On success, holds hb lock and increments q.key refs. */
+	ret = futex_wait_setup(uaddr, uval, flags, &q, &hb);
+	if (ret == -EWOULDBLOCK)
+		goto retry;
+	if (ret)
+		goto out;
+
+	futex_wait_queue_me(hb, &q, to);
+	waiters = FUTEX_WAITERS;
+
+	/*
+	 * Woken by an unlock: go for the lock even if we timed out, or the
+	 * wakeup would be lost for the other waiters.
+	 */
+	if (!unqueue_me(&q))
+		goto respin;
+	ret = -ETIMEDOUT;
+	if (to && !to->task)
+		goto out;
+	if (!signal_pending(current))
+		goto respin;
+
+	/* The lock is not ours, just restart the whole operation. */
+	ret = -ERESTARTNOINTR;
+	goto out;
+
+respin:
+	deadline = local_clock() + FUTEX_SPIN_MAX_NS;
+	goto retry;
+out:
+	if (to) {
+		hrtimer_cancel(&to->timer);
+		destroy_hrtimer_on_stack(&to->timer);
+	}
+	return ret;
+}
+
 
 /*
  * Userspace tried a 0 -> TID atomic transition of the futex value
@@ -3251,7 +3398,7 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, unsigned int flags,
 		return -EINVAL;
 
 	to = futex_setup_timer(abs_time, &timeout, flags,
-			       current->timer_slack_ns);
+			       task_get_effective_timer_slack(current));
 
 	/*
 	 * The waiter is allocated on our stack, manipulated by the requeue
@@ -3646,11 +3793,12 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 	if (op & FUTEX_CLOCK_REALTIME) {
 		flags |= FLAGS_CLOCKRT;
 		if (cmd != FUTEX_WAIT && cmd != FUTEX_WAIT_BITSET && \
-		    cmd != FUTEX_WAIT_REQUEUE_PI)
+		    cmd != FUTEX_WAIT_REQUEUE_PI && cmd != FUTEX_LOCK)
 			return -ENOSYS;
 	}
 
 	switch (cmd) {
+	case FUTEX_LOCK:
 	case FUTEX_LOCK_PI:
 	case FUTEX_UNLOCK_PI:
 	case FUTEX_TRYLOCK_PI:
@@ -3689,6 +3837,8 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 					     uaddr2);
 	case FUTEX_CMP_REQUEUE_PI:
 		return futex_requeue(uaddr, flags, uaddr2, val, val2, &val3, 1);
+	case FUTEX_LOCK:
+		return futex_lock(uaddr, flags, timeout);
 	}
 	return -ENOSYS;
 }
@@ -3704,7 +3854,7 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	int cmd = op & FUTEX_CMD_MASK;
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
-		      cmd == FUTEX_WAIT_BITSET ||
+		      cmd == FUTEX_WAIT_BITSET || cmd == FUTEX_LOCK ||
 		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
 		if (unlikely(should_fail_futex(!(op & FUTEX_PRIVATE_FLAG))))
 			return -EFAULT;
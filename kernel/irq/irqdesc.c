@@ -361,6 +361,8 @@ int generic_handle_irq(unsigned int irq)
 EXPORT_SYMBOL_GPL(generic_handle_irq);
 
 #ifdef CONFIG_HANDLE_DOMAIN_IRQ
+DEFINE_PER_CPU(unsigned int, wakeup_domain_irq);
+
 /**
  * __handle_domain_irq - Invoke the handler for a HW irq belonging to a domain
  * @domain:	The domain where to perform the lookup
@@ -392,6 +394,8 @@ int __handle_domain_irq(struct irq_domain *domain, unsigned int hwirq,
 		ack_bad_irq(irq);
 		ret = -EINVAL;
 	} else {
+		if (!__this_cpu_read(wakeup_domain_irq))
+			__this_cpu_write(wakeup_domain_irq, irq);
 		generic_handle_irq(irq);
 	}
 
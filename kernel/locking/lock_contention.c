@@ -0,0 +1,224 @@
+/*
+ * Sampled lock contention profiling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Every contended acquisition of a spinlock, rwlock, mutex or rwsem (one
+ * whose trylock failed) calls lock_contention_begin(). With sample_rate
+ * set to N, one in N of those on each CPU is timed until the lock is
+ * taken, and the wait is accumulated under the acquiring call site in a
+ * small per-CPU hash table. Nothing is done on the uncontended paths.
+ *
+ * /proc/lock_contention merges the per-CPU tables and lists the call
+ * sites by total sampled wait time; writing to it clears the tables.
+ */
+
+#include <linux/cpu.h>
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/lockdep.h>
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+
+#define LC_HASH_BITS	8
+#define LC_SLOTS	(1 << LC_HASH_BITS)
+#define LC_PROBES	8
+
+struct lc_site {
+	unsigned long ip;
+	void *lock;
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+struct lc_table {
+	unsigned long dropped;
+	struct lc_site sites[LC_SLOTS];
+};
+
+static DEFINE_PER_CPU(unsigned int, lc_seq);
+static DEFINE_PER_CPU(struct lc_table, lc_tables);
+
+static unsigned int sample_rate __read_mostly;
+module_param(sample_rate, uint, 0644);
+
+u64 lock_contention_begin(void)
+{
+	unsigned int rate = READ_ONCE(sample_rate);
+
+	if (likely(!rate))
+		return 0;
+
+	/* a racy increment only skews which acquisition gets sampled */
+	if (raw_cpu_inc_return(lc_seq) % rate)
+		return 0;
+
+	return local_clock() ? : 1;
+}
+EXPORT_SYMBOL(lock_contention_begin);
+
+void lock_contention_end(void *lock, unsigned long ip, u64 start)
+{
+	struct lc_table *table;
+	struct lc_site *site;
+	unsigned long flags;
+	unsigned int hash, i;
+	s64 delta;
+
+	if (likely(!start))
+		return;
+
+	/* sleeping lock waiters may have moved to another CPU */
+	delta = local_clock() - start;
+	if (delta < 0)
+		delta = 0;
+
+	local_irq_save(flags);
+	table = this_cpu_ptr(&lc_tables);
+	hash = hash_long(ip, LC_HASH_BITS);
+	for (i = 0; i < LC_PROBES; i++) {
+		site = &table->sites[(hash + i) & (LC_SLOTS - 1)];
+		if (site->ip == ip)
+			goto found;
+		if (!site->ip) {
+			site->ip = ip;
+			goto found;
+		}
+	}
+	table->dropped++;
+	local_irq_restore(flags);
+	return;
+
+found:
+	site->lock = lock;
+	site->count++;
+	site->total_ns += delta;
+	if (delta > site->max_ns)
+		site->max_ns = delta;
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(lock_contention_end);
+
+static int lc_site_cmp(const void *a, const void *b)
+{
+	const struct lc_site *sa = a, *sb = b;
+
+	if (sa->total_ns == sb->total_ns)
+		return 0;
+	return sa->total_ns < sb->total_ns ? 1 : -1;
+}
+
+static int lc_show(struct seq_file *m, void *v)
+{
+	struct lc_site *merged, *site;
+	unsigned long dropped = 0;
+	unsigned int nr = 0, i, j;
+	int cpu;
+
+	merged = vzalloc(sizeof(*merged) * LC_SLOTS * num_possible_cpus());
+	if (!merged)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct lc_table *table = per_cpu_ptr(&lc_tables, cpu);
+
+		dropped += table->dropped;
+		for (i = 0; i < LC_SLOTS; i++) {
+			struct lc_site snap = table->sites[i];
+
+			if (!snap.ip)
+				continue;
+			for (j = 0; j < nr; j++)
+				if (merged[j].ip == snap.ip)
+					break;
+			site = &merged[j];
+			if (j == nr) {
+				site->ip = snap.ip;
+				nr++;
+			}
+			site->lock = snap.lock;
+			site->count += snap.count;
+			site->total_ns += snap.total_ns;
+			if (snap.max_ns > site->max_ns)
+				site->max_ns = snap.max_ns;
+		}
+	}
+
+	sort(merged, nr, sizeof(*merged), lc_site_cmp, NULL);
+
+	seq_printf(m, "# sample_rate: %u dropped: %lu\n",
+		   READ_ONCE(sample_rate), dropped);
+	seq_puts(m, "# count total_us max_us avg_us lock call_site\n");
+	for (i = 0; i < nr; i++) {
+		site = &merged[i];
+		seq_printf(m, "%llu %llu %llu %llu %pK %pS\n",
+			   site->count, div_u64(site->total_ns, NSEC_PER_USEC),
+			   div_u64(site->max_ns, NSEC_PER_USEC),
+			   div64_u64(site->total_ns, site->count) /
+			   NSEC_PER_USEC,
+			   site->lock, (void *)site->ip);
+	}
+
+	vfree(merged);
+	return 0;
+}
+
+static void lc_reset_cpu(void *unused)
+{
+	memset(this_cpu_ptr(&lc_tables), 0, sizeof(struct lc_table));
+}
+
+static ssize_t lc_write(struct file *file, const char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	get_online_cpus();
+	on_each_cpu(lc_reset_cpu, NULL, 1);
+	for_each_possible_cpu(cpu)
+		if (!cpu_online(cpu))
+			memset(per_cpu_ptr(&lc_tables, cpu), 0,
+			       sizeof(struct lc_table));
+	put_online_cpus();
+
+	return count;
+}
+
+static int lc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lc_show, NULL);
+}
+
+static const struct file_operations lc_fops = {
+	.open		= lc_open,
+	.read		= seq_read,
+	.write		= lc_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init lock_contention_init(void)
+{
+	if (!proc_create("lock_contention", S_IRUSR | S_IWUSR, NULL,
+			 &lc_fops))
+		return -ENOMEM;
+	return 0;
+}
+device_initcall(lock_contention_init);
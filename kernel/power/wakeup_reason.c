@@ -26,6 +26,7 @@
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
 #include <linux/suspend.h>
+#include <linux/device.h>
 
 
 #define MAX_WAKEUP_REASON_IRQS 32
@@ -36,6 +37,18 @@ static char abort_reason[MAX_SUSPEND_ABORT_LEN];
 static struct kobject *wakeup_reason;
 static DEFINE_SPINLOCK(resume_reason_lock);
 
+/* the slowest device resume callbacks of the last resume, slowest first */
+#define MAX_RESUME_LATENCY_DEVS 16
+#define RESUME_LATENCY_NAME_LEN 32
+struct resume_latency {
+	char name[RESUME_LATENCY_NAME_LEN];
+	const char *info;
+	s64 usecs;
+};
+static struct resume_latency resume_latency[MAX_RESUME_LATENCY_DEVS];
+static int resume_latency_count;
+static DEFINE_SPINLOCK(resume_latency_lock);
+
 static ktime_t last_monotime; /* monotonic time before last suspend */
 static ktime_t curr_monotime; /* monotonic time after last suspend */
 static ktime_t last_stime; /* monotonic boottime offset before last suspend */
@@ -92,12 +105,32 @@ static ssize_t last_suspend_time_show(struct kobject *kobj,
 				sleep_time.tv_sec, sleep_time.tv_nsec);
 }
 
+static ssize_t last_resume_latency_show(struct kobject *kobj,
+			struct kobj_attribute *attr, char *buf)
+{
+	unsigned long flags;
+	int i, buf_offset = 0;
+
+	spin_lock_irqsave(&resume_latency_lock, flags);
+	for (i = 0; i < resume_latency_count; i++)
+		buf_offset += scnprintf(buf + buf_offset,
+				PAGE_SIZE - buf_offset, "%s%s: %lld\n",
+				resume_latency[i].info ? : "",
+				resume_latency[i].name,
+				resume_latency[i].usecs);
+	spin_unlock_irqrestore(&resume_latency_lock, flags);
+	return buf_offset;
+}
+
 static struct kobj_attribute resume_reason = __ATTR_RO(last_resume_reason);
 static struct kobj_attribute suspend_time = __ATTR_RO(last_suspend_time);
+static struct kobj_attribute resume_latency_attr =
+	__ATTR_RO(last_resume_latency);
 
 static struct attribute *attrs[] = {
 	&resume_reason.attr,
 	&suspend_time.attr,
+	&resume_latency_attr.attr,
 	NULL,
 };
 static struct attribute_group attr_group = {
@@ -164,6 +197,34 @@ void log_suspend_abort_reason(const char *fmt, ...)
 	spin_unlock(&resume_reason_lock);
 }
 
+/*
+ * Records the time one resume callback of @dev took, keeping the
+ * MAX_RESUME_LATENCY_DEVS slowest ones of the current resume.
+ * Called from every resume phase, including noirq.
+ */
+void log_resume_latency(struct device *dev, const char *info, s64 usecs)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&resume_latency_lock, flags);
+	for (i = resume_latency_count; i > 0; i--) {
+		if (resume_latency[i - 1].usecs >= usecs)
+			break;
+		if (i < MAX_RESUME_LATENCY_DEVS)
+			resume_latency[i] = resume_latency[i - 1];
+	}
+	if (i < MAX_RESUME_LATENCY_DEVS) {
+		strlcpy(resume_latency[i].name, dev_name(dev),
+			RESUME_LATENCY_NAME_LEN);
+		resume_latency[i].info = info;
+		resume_latency[i].usecs = usecs;
+		if (resume_latency_count < MAX_RESUME_LATENCY_DEVS)
+			resume_latency_count++;
+	}
+	spin_unlock_irqrestore(&resume_latency_lock, flags);
+}
+
 /* Detects a suspend and clears all the previous wake up reasons*/
 static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		unsigned long pm_event, void *unused)
@@ -174,6 +235,9 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		irqcount = 0;
 		suspend_abort = false;
 		spin_unlock(&resume_reason_lock);
+		spin_lock_irq(&resume_latency_lock);
+		resume_latency_count = 0;
+		spin_unlock_irq(&resume_latency_lock);
 		/* monotonic time since boot */
 		last_monotime = ktime_get();
 		/* monotonic time since boot including the time spent in suspend */
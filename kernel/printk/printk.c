@@ -43,6 +43,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
@@ -1675,6 +1676,26 @@ static size_t cont_print_text(char *text, size_t size)
 	return textlen;
 }
 
+/*
+ * Once the system is up, printk() only stores the message and leaves the
+ * console output to printk_kthread, so that a message storm on a slow
+ * console does not stall the callers, many of which run with interrupts
+ * disabled. Boot, shutdown and oopses keep printing synchronously, as
+ * does printk.synchronous=1.
+ */
+static bool printk_sync;
+module_param_named(synchronous, printk_sync, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *printk_kthread __read_mostly;
+
+static bool printk_kthread_enabled(void)
+{
+	return !printk_sync && printk_kthread && !oops_in_progress &&
+		system_state == SYSTEM_RUNNING;
+}
+
+static void printk_kick_console(void);
+
 asmlinkage int vprintk_emit(int facility, int level,
 			    const char *dict, size_t dictlen,
 			    const char *fmt, va_list args)
@@ -1829,7 +1850,9 @@ asmlinkage int vprintk_emit(int facility, int level,
 	local_irq_restore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched) {
+	if (!in_sched && printk_kthread_enabled()) {
+		printk_kick_console();
+	} else if (!in_sched) {
 		lockdep_off();
 		/*
 		 * Disable preemption to avoid being preempted while holding
@@ -2747,14 +2770,50 @@ late_initcall(printk_late_init);
 
 static DEFINE_PER_CPU(int, printk_pending);
 
+static bool printk_kthread_pending;
+
+static int printk_kthread_func(void *data)
+{
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!READ_ONCE(printk_kthread_pending))
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		WRITE_ONCE(printk_kthread_pending, false);
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(tsk)) {
+		pr_err("printk: unable to create printing thread\n");
+		return PTR_ERR(tsk);
+	}
+	printk_kthread = tsk;
+	return 0;
+}
+late_initcall(printk_kthread_init);
+
 static void wake_up_klogd_work_func(struct irq_work *irq_work)
 {
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
-		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		if (printk_kthread_enabled()) {
+			WRITE_ONCE(printk_kthread_pending, true);
+			wake_up_process(printk_kthread);
+		} else if (console_trylock()) {
+			/* If trylock fails, someone else is doing the printing */
 			console_unlock();
+		}
 	}
 
 	if (pending & PRINTK_PENDING_WAKEUP)
@@ -2776,6 +2835,18 @@ void wake_up_klogd(void)
 	preempt_enable();
 }
 
+/*
+ * Hand the console output to printk_kthread. The wakeup goes through
+ * irq_work, as the caller may hold scheduler locks.
+ */
+static void printk_kick_console(void)
+{
+	preempt_disable();
+	__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
+	irq_work_queue(this_cpu_ptr(&wake_up_klogd_work));
+	preempt_enable();
+}
+
 int printk_deferred(const char *fmt, ...)
 {
 	va_list args;
@@ -29,6 +29,7 @@
 #include <linux/seqlock.h>
 #include <linux/swait.h>
 #include <linux/stop_machine.h>
+#include <linux/timer.h>
 #include "rcu_segcblist.h"
 
 /*
@@ -392,6 +393,8 @@ struct rcu_data {
 	struct swait_queue_head nocb_wq; /* For nocb kthreads to sleep on. */
 	struct task_struct *nocb_kthread;
 	int nocb_defer_wakeup;		/* Defer wakeup of nocb_kthread. */
+	bool nocb_lazy_pending;		/* Only lazy CBs, kthread not woken. */
+	struct timer_list nocb_lazy_timer; /* Eventually wakes it anyway. */
 
 	/* The following fields are used by the leader, hence own cacheline. */
 	struct rcu_head *nocb_gp_head ____cacheline_internodealigned_in_smp;
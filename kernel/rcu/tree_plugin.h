@@ -27,6 +27,7 @@
 #include <linux/delay.h>
 #include <linux/gfp.h>
 #include <linux/oom.h>
+#include <linux/shrinker.h>
 #include <linux/smpboot.h>
 #include "../time/tick-internal.h"
 
@@ -58,6 +59,8 @@ DEFINE_PER_CPU(char, rcu_cpu_has_work);
 #ifdef CONFIG_RCU_NOCB_CPU
 static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
 static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
+static cpumask_var_t rcu_nocb_affinity_mask; /* Where rcuo kthreads run. */
+static bool have_rcu_nocb_affinity_mask;
 static bool __read_mostly rcu_nocb_poll;    /* Offload kthread are to poll. */
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 
@@ -1705,6 +1708,20 @@ static int __init rcu_nocb_setup(char *str)
 }
 __setup("rcu_nocbs=", rcu_nocb_setup);
 
+/*
+ * Parse the boot-time CPU list the rcuo kthreads are confined to.  On
+ * asymmetric systems this is typically the little cluster, so that
+ * callback invocation does not keep waking the big cores.
+ */
+static int __init rcu_nocb_affinity_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_affinity_mask);
+	have_rcu_nocb_affinity_mask = true;
+	cpulist_parse(str, rcu_nocb_affinity_mask);
+	return 1;
+}
+__setup("rcu_nocb_affinity=", rcu_nocb_affinity_setup);
+
 static int __init parse_rcu_nocb_poll(char *arg)
 {
 	rcu_nocb_poll = 1;
@@ -1817,6 +1834,32 @@ static bool rcu_nocb_cpu_needs_barrier(struct rcu_state *rsp, int cpu)
 	return !!ret;
 }
 
+/*
+ * How long a no-CBs CPU may sit on lazy-only callbacks, that is kfree_rcu(),
+ * before its rcuo kthread is woken to deal with them.  Zero disables the
+ * batching.  The timer is deferrable, so it does not end idle periods on
+ * its own; non-lazy callbacks, rcu_barrier() and memory pressure all flush
+ * the batch early.
+ */
+static int rcu_nocb_lazy_delay = HZ;
+module_param(rcu_nocb_lazy_delay, int, 0644);
+
+static void rcu_nocb_lazy_flush(struct rcu_data *rdp)
+{
+	WRITE_ONCE(rdp->nocb_lazy_pending, false);
+	wake_nocb_leader(rdp, false);
+}
+
+static void do_nocb_lazy_wakeup(unsigned long data)
+{
+	struct rcu_data *rdp = (struct rcu_data *)data;
+
+	if (!READ_ONCE(rdp->nocb_lazy_pending))
+		return;
+	rcu_nocb_lazy_flush(rdp);
+	trace_rcu_nocb_wake(rdp->rsp->name, rdp->cpu, TPS("WakeLazy"));
+}
+
 /*
  * Enqueue the specified string of rcu_head structures onto the specified
  * CPU's no-CBs lists.  The CPU is specified by rdp, the head of the
@@ -1852,7 +1895,14 @@ static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
 	}
 	len = atomic_long_read(&rdp->nocb_q_count);
 	if (old_rhpp == &rdp->nocb_head) {
-		if (!irqs_disabled_flags(flags)) {
+		if (rhcount == rhcount_lazy && rcu_nocb_lazy_delay > 0) {
+			/* ... unless there is nothing but memory to free ... */
+			WRITE_ONCE(rdp->nocb_lazy_pending, true);
+			mod_timer(&rdp->nocb_lazy_timer,
+				  jiffies + rcu_nocb_lazy_delay);
+			trace_rcu_nocb_wake(rdp->rsp->name, rdp->cpu,
+					    TPS("WakeEmptyIsLazy"));
+		} else if (!irqs_disabled_flags(flags)) {
 			/* ... if queue was empty ... */
 			wake_nocb_leader(rdp, false);
 			trace_rcu_nocb_wake(rdp->rsp->name, rdp->cpu,
@@ -1875,12 +1925,86 @@ static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
 					    TPS("WakeOvfIsDeferred"));
 		}
 		rdp->qlen_last_fqs_check = LONG_MAX / 2;
+	} else if (rhcount != rhcount_lazy &&
+		   READ_ONCE(rdp->nocb_lazy_pending)) {
+		/* ... or if a non-lazy callback lands behind lazy ones. */
+		if (!irqs_disabled_flags(flags)) {
+			rcu_nocb_lazy_flush(rdp);
+			trace_rcu_nocb_wake(rdp->rsp->name, rdp->cpu,
+					    TPS("WakeNonLazy"));
+		} else {
+			WRITE_ONCE(rdp->nocb_lazy_pending, false);
+			if (rdp->nocb_defer_wakeup < RCU_NOGP_WAKE)
+				rdp->nocb_defer_wakeup = RCU_NOGP_WAKE;
+			trace_rcu_nocb_wake(rdp->rsp->name, rdp->cpu,
+					    TPS("WakeNonLazyIsDeferred"));
+		}
 	} else {
 		trace_rcu_nocb_wake(rdp->rsp->name, rdp->cpu, TPS("WakeNot"));
 	}
 	return;
 }
 
+/*
+ * Under memory pressure, hand every batch of lazy callbacks to its rcuo
+ * kthread right away.  As with rcu_oom_notify(), the memory comes back
+ * one grace period later, so nothing is ever reported as freed here.
+ */
+static unsigned long rcu_nocb_lazy_count(struct shrinker *shrink,
+					 struct shrink_control *sc)
+{
+	struct rcu_state *rsp;
+	struct rcu_data *rdp;
+	unsigned long count = 0;
+	int cpu;
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+
+	for_each_rcu_flavor(rsp) {
+		for_each_cpu(cpu, rcu_nocb_mask) {
+			rdp = per_cpu_ptr(rsp->rda, cpu);
+			if (READ_ONCE(rdp->nocb_lazy_pending))
+				count += atomic_long_read(&rdp->nocb_q_count_lazy);
+		}
+	}
+	return count;
+}
+
+static unsigned long rcu_nocb_lazy_scan(struct shrinker *shrink,
+					struct shrink_control *sc)
+{
+	struct rcu_state *rsp;
+	struct rcu_data *rdp;
+	int cpu;
+
+	if (!have_rcu_nocb_mask)
+		return SHRINK_STOP;
+
+	for_each_rcu_flavor(rsp) {
+		for_each_cpu(cpu, rcu_nocb_mask) {
+			rdp = per_cpu_ptr(rsp->rda, cpu);
+			if (!READ_ONCE(rdp->nocb_lazy_pending))
+				continue;
+			rcu_nocb_lazy_flush(rdp);
+			trace_rcu_nocb_wake(rsp->name, cpu, TPS("WakeLazyOOM"));
+		}
+	}
+	return SHRINK_STOP;
+}
+
+static struct shrinker rcu_nocb_lazy_shrinker = {
+	.count_objects	= rcu_nocb_lazy_count,
+	.scan_objects	= rcu_nocb_lazy_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+
+static int __init rcu_register_nocb_lazy_shrinker(void)
+{
+	return register_shrinker(&rcu_nocb_lazy_shrinker);
+}
+early_initcall(rcu_register_nocb_lazy_shrinker);
+
 /*
  * This is a helper for __call_rcu(), which invokes this when the normal
  * callback queue is inoperable.  If this is not a no-CBs CPU, this
@@ -2261,6 +2385,8 @@ static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
 	rdp->nocb_tail = &rdp->nocb_head;
 	init_swait_queue_head(&rdp->nocb_wq);
 	rdp->nocb_follower_tail = &rdp->nocb_follower_head;
+	setup_deferrable_timer(&rdp->nocb_lazy_timer, do_nocb_lazy_wakeup,
+			       (unsigned long)rdp);
 }
 
 /*
@@ -2308,6 +2434,9 @@ static void rcu_spawn_one_nocb_kthread(struct rcu_state *rsp, int cpu)
 	t = kthread_run(rcu_nocb_kthread, rdp_spawn,
 			"rcuo%c/%d", rsp->abbr, cpu);
 	BUG_ON(IS_ERR(t));
+	if (have_rcu_nocb_affinity_mask &&
+	    cpumask_intersects(rcu_nocb_affinity_mask, cpu_online_mask))
+		set_cpus_allowed_ptr(t, rcu_nocb_affinity_mask);
 	WRITE_ONCE(rdp_spawn->nocb_kthread, t);
 }
 
@@ -4208,16 +4208,30 @@ static inline u64 sched_cfs_bandwidth_slice(void)
 }
 
 /*
- * Replenish runtime according to assigned quota. We use sched_clock_cpu
- * directly instead of rq->clock to avoid adding additional synchronization
- * around rq->lock.
+ * Replenish runtime according to assigned quota. Quota left unused at
+ * the end of a period is carried over, up to quota + burst, so a group
+ * that was idle can run past its quota for a while without exceeding
+ * its average budget.
  *
  * requires cfs_b->lock
  */
 void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b)
 {
-	if (cfs_b->quota != RUNTIME_INF)
-		cfs_b->runtime = cfs_b->quota;
+	s64 runtime;
+
+	if (unlikely(cfs_b->quota == RUNTIME_INF))
+		return;
+
+	cfs_b->runtime += cfs_b->quota;
+	/* runtime consumed beyond this period's quota came out of the burst */
+	runtime = cfs_b->runtime_snap - cfs_b->runtime;
+	if (runtime > 0) {
+		cfs_b->burst_time += runtime;
+		cfs_b->nr_burst++;
+	}
+
+	cfs_b->runtime = min(cfs_b->runtime, cfs_b->quota + cfs_b->burst);
+	cfs_b->runtime_snap = cfs_b->runtime;
 }
 
 static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
@@ -4521,6 +4535,9 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 	throttled = !list_empty(&cfs_b->throttled_cfs_rq);
 	cfs_b->nr_periods += overrun;
 
+	/* refill extra burst quota even if cfs_b->idle */
+	__refill_cfs_bandwidth_runtime(cfs_b);
+
 	/*
 	 * idle depends on !throttled (for the case of a large deficit), and if
 	 * we're going inactive then everything else can be deferred
@@ -4528,8 +4545,6 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 	if (cfs_b->idle && !throttled)
 		goto out_deactivate;
 
-	__refill_cfs_bandwidth_runtime(cfs_b);
-
 	if (!throttled) {
 		/* mark as potentially idle for the upcoming period */
 		cfs_b->idle = 1;
@@ -4850,6 +4865,7 @@ void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 	cfs_b->runtime = 0;
 	cfs_b->quota = RUNTIME_INF;
 	cfs_b->period = ns_to_ktime(default_cfs_period());
+	cfs_b->burst = 0;
 
 	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
 	hrtimer_init(&cfs_b->period_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_PINNED);
@@ -5792,63 +5808,49 @@ long group_norm_util(struct energy_env *eenv, struct sched_group *sg)
 	return min_t(unsigned long, util_sum, SCHED_CAPACITY_SCALE);
 }
 
-static int find_new_capacity(struct energy_env *eenv,
-	const struct sched_group_energy * const sge)
+static int sge_cap_idx(const struct sched_group_energy * const sge,
+		       unsigned long util)
 {
-	int idx, max_idx = sge->nr_cap_states - 1;
-	unsigned long util = group_max_util(eenv);
-
-	/* default is max_cap if we don't find a match */
-	eenv->cap_idx = max_idx;
+	int idx;
 
 	for (idx = 0; idx < sge->nr_cap_states; idx++) {
-		if (sge->cap_states[idx].cap >= util) {
-			eenv->cap_idx = idx;
-			break;
-		}
+		if (sge->cap_states[idx].cap >= util)
+			return idx;
 	}
 
-	return eenv->cap_idx;
+	/* default is max_cap if we don't find a match */
+	return sge->nr_cap_states - 1;
 }
 
-static int group_idle_state(struct energy_env *eenv, struct sched_group *sg)
+static int find_new_capacity(struct energy_env *eenv,
+	const struct sched_group_energy * const sge)
 {
-	int i, state = INT_MAX;
-	int src_in_grp, dst_in_grp;
-	long grp_util = 0;
-
-	/* Find the shallowest idle state in the sched group. */
-	for_each_cpu(i, sched_group_span(sg))
-		state = min(state, idle_get_state_idx(cpu_rq(i)));
+	eenv->cap_idx = sge_cap_idx(sge, group_max_util(eenv));
 
-	/* Take non-cpuidle idling into account (active idle/arch_cpu_idle()) */
-	state++;
+	return eenv->cap_idx;
+}
 
-	src_in_grp = cpumask_test_cpu(eenv->src_cpu, sched_group_span(sg));
-	dst_in_grp = cpumask_test_cpu(eenv->dst_cpu, sched_group_span(sg));
-	if (src_in_grp == dst_in_grp) {
+/*
+ * Estimate the idle state a group of @weight cpus ends up in when a task
+ * migration changes its utilization to @grp_util, starting from the
+ * shallowest @state its cpus are currently in.
+ */
+static int estimate_idle_state(const struct sched_group_energy * const sge,
+			       int state, bool moving, long grp_util,
+			       unsigned long max_capacity, int weight)
+{
+	if (!moving) {
 		/* both CPUs under consideration are in the same group or not in
 		 * either group, migration should leave idle state the same.
 		 */
-		goto end;
-	}
-
-	/*
-	 * Try to estimate if a deeper idle state is
-	 * achievable when we move the task.
-	 */
-	for_each_cpu(i, sched_group_span(sg)) {
-		grp_util += cpu_util_without(i, eenv->task);
-		if (unlikely(i == eenv->trg_cpu))
-			grp_util += eenv->util_delta;
+		return state;
 	}
 
-	if (grp_util <=
-		((long)sg->sgc->max_capacity * (int)sg->group_weight)) {
+	if (grp_util <= ((long)max_capacity * weight)) {
 		/* after moving, this group is at most partly
 		 * occupied, so it should have some idle time.
 		 */
-		int max_idle_state_idx = sg->sge->nr_idle_states - 2;
+		int max_idle_state_idx = sge->nr_idle_states - 2;
 		int new_state = grp_util * max_idle_state_idx;
 		if (grp_util <= 0)
 			/* group will have no util, use lowest state */
@@ -5860,7 +5862,7 @@ static int group_idle_state(struct energy_env *eenv, struct sched_group *sg)
 			 * reality, but an indication of what might happen.
 			 */
 			new_state = min(max_idle_state_idx, (int)
-					(new_state / sg->sgc->max_capacity));
+					(new_state / max_capacity));
 			new_state = max_idle_state_idx - new_state;
 		}
 		state = new_state;
@@ -5870,10 +5872,42 @@ static int group_idle_state(struct energy_env *eenv, struct sched_group *sg)
 		 */
 		state = 0;
 	}
-end:
+
 	return state;
 }
 
+static int group_idle_state(struct energy_env *eenv, struct sched_group *sg)
+{
+	int i, state = INT_MAX;
+	int src_in_grp, dst_in_grp;
+	long grp_util = 0;
+
+	/* Find the shallowest idle state in the sched group. */
+	for_each_cpu(i, sched_group_span(sg))
+		state = min(state, idle_get_state_idx(cpu_rq(i)));
+
+	/* Take non-cpuidle idling into account (active idle/arch_cpu_idle()) */
+	state++;
+
+	src_in_grp = cpumask_test_cpu(eenv->src_cpu, sched_group_span(sg));
+	dst_in_grp = cpumask_test_cpu(eenv->dst_cpu, sched_group_span(sg));
+	if (src_in_grp == dst_in_grp)
+		return state;
+
+	/*
+	 * Try to estimate if a deeper idle state is
+	 * achievable when we move the task.
+	 */
+	for_each_cpu(i, sched_group_span(sg)) {
+		grp_util += cpu_util_without(i, eenv->task);
+		if (unlikely(i == eenv->trg_cpu))
+			grp_util += eenv->util_delta;
+	}
+
+	return estimate_idle_state(sg->sge, state, true, grp_util,
+				   sg->sgc->max_capacity, sg->group_weight);
+}
+
 /*
  * sched_group_energy(): Computes the absolute energy consumption of cpus
  * belonging to the sched_group including shared resources shared only by
@@ -6009,6 +6043,203 @@ next_cpu:
 	return 0;
 }
 
+/*
+ * Flattened energy model for the common two-level topology: per-cpu groups
+ * sharing capacity states inside a cluster, and clusters as the groups of
+ * the sd_ea level. It lets energy_diff() estimate a cluster's energy with
+ * two passes over its cpus, instead of walking the sched_domain hierarchy
+ * from every cpu and gathering the same utilization once per sched_group.
+ * Rebuilt together with the sched domains, i.e. also on hotplug. Topologies
+ * that do not fit leave it NULL and use sched_group_energy().
+ */
+struct energy_cluster {
+	struct cpumask cpus;
+	const struct sched_group_energy *sge;
+};
+
+struct energy_clusters {
+	struct rcu_head rcu;
+	int nr;
+	int cpu_cluster[NR_CPUS];
+	const struct sched_group_energy *core_sge[NR_CPUS];
+	struct energy_cluster cl[NR_CPUS];
+};
+
+static struct energy_clusters __rcu *energy_clusters;
+
+void update_energy_clusters(void)
+{
+	struct energy_clusters *ec, *old;
+	struct energy_cluster *cl;
+	struct sched_domain *sd, *ea_sd;
+	int cpu, i;
+
+	ec = kzalloc(sizeof(*ec), GFP_KERNEL);
+	if (!ec)
+		goto publish;
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++)
+		ec->cpu_cluster[cpu] = -1;
+
+	rcu_read_lock();
+	for_each_possible_cpu(cpu) {
+		sd = rcu_dereference(per_cpu(sd_scs, cpu));
+		ea_sd = rcu_dereference(per_cpu(sd_ea, cpu));
+		if (!sd)
+			continue;
+
+		if (sd->child || sd->parent != ea_sd ||
+		    sd->groups->group_weight != 1 || !sd->groups->sge ||
+		    !ea_sd->groups->sge ||
+		    !cpumask_equal(sched_group_span(ea_sd->groups),
+				   sched_domain_span(sd))) {
+			kfree(ec);
+			ec = NULL;
+			break;
+		}
+
+		ec->core_sge[cpu] = sd->groups->sge;
+		if (ec->cpu_cluster[cpu] >= 0)
+			continue;
+
+		cl = &ec->cl[ec->nr];
+		cpumask_copy(&cl->cpus, sched_domain_span(sd));
+		cl->sge = ea_sd->groups->sge;
+		for_each_cpu(i, &cl->cpus)
+			ec->cpu_cluster[i] = ec->nr;
+		ec->nr++;
+	}
+	rcu_read_unlock();
+
+publish:
+	old = rcu_dereference_protected(energy_clusters,
+			lockdep_is_held(&sched_domains_mutex));
+	rcu_assign_pointer(energy_clusters, ec);
+	if (old)
+		kfree_rcu(old, rcu);
+}
+
+static inline unsigned long eenv_cpu_util(struct energy_env *eenv, int cpu)
+{
+	unsigned long util = cpu_util_without(cpu, eenv->task);
+
+	if (unlikely(cpu == eenv->trg_cpu))
+		util += eenv->util_delta;
+
+	return util;
+}
+
+/*
+ * Same estimate sched_group_energy() computes for a cluster group of
+ * sd_ea, using the flattened model.
+ */
+static int cluster_energy(struct energy_clusters *ec, int idx,
+			  struct energy_env *eenv)
+{
+	struct energy_cluster *cl = &ec->cl[idx];
+	const struct sched_group_energy *core;
+	unsigned long util, max_util = 0, max_cap = 0;
+	unsigned long cap, cl_cap, norm, cl_norm = 0;
+	int cpu, cap_idx, cl_cap_idx, idle_idx, cl_idle = INT_MAX;
+	long grp_util = 0;
+	bool src_in, dst_in;
+	u64 energy = 0;
+
+	/* The shared capacity state follows the busiest cpu */
+	for_each_cpu(cpu, &cl->cpus) {
+		max_util = max(max_util, eenv_cpu_util(eenv, cpu));
+		max_util = max(max_util, capacity_min_of(cpu));
+		max_cap = max(max_cap, capacity_orig_of(cpu));
+	}
+
+	cl_cap_idx = sge_cap_idx(cl->sge, max_util);
+	cl_cap = cl->sge->cap_states[cl_cap_idx].cap;
+
+	for_each_cpu(cpu, &cl->cpus) {
+		core = ec->core_sge[cpu];
+		cap_idx = sge_cap_idx(core, max_util);
+		cap = core->cap_states[cap_idx].cap;
+
+		/* Remove capacity of src CPU (before task move) */
+		if (eenv->trg_cpu == eenv->src_cpu && cpu == eenv->src_cpu) {
+			eenv->cap.before = cap;
+			eenv->cap.delta -= eenv->cap.before;
+		}
+		/* Add capacity of dst CPU  (after task move) */
+		if (eenv->trg_cpu == eenv->dst_cpu && cpu == eenv->dst_cpu) {
+			eenv->cap.after = cap;
+			eenv->cap.delta += eenv->cap.after;
+		}
+
+		util = eenv_cpu_util(eenv, cpu);
+		grp_util += util;
+		cl_norm += __cpu_norm_util(util, cl_cap);
+
+		idle_idx = idle_get_state_idx(cpu_rq(cpu));
+		cl_idle = min(cl_idle, idle_idx);
+		idle_idx = estimate_idle_state(core, idle_idx + 1,
+				(cpu == eenv->src_cpu) != (cpu == eenv->dst_cpu),
+				util, capacity_orig_of(cpu), 1);
+
+		norm = __cpu_norm_util(util, cap);
+		energy += norm * core->cap_states[cap_idx].power;
+		energy += (SCHED_LOAD_SCALE - norm) *
+			  core->idle_states[idle_idx].power;
+	}
+
+	src_in = cpumask_test_cpu(eenv->src_cpu, &cl->cpus);
+	dst_in = cpumask_test_cpu(eenv->dst_cpu, &cl->cpus);
+	idle_idx = estimate_idle_state(cl->sge, cl_idle + 1, src_in != dst_in,
+				       grp_util, max_cap,
+				       cpumask_weight(&cl->cpus));
+
+	cl_norm = min_t(unsigned long, cl_norm, SCHED_CAPACITY_SCALE);
+	energy += cl_norm * cl->sge->cap_states[cl_cap_idx].power;
+	energy += (SCHED_LOAD_SCALE - cl_norm) *
+		  cl->sge->idle_states[idle_idx].power;
+
+	return energy >> SCHED_CAPACITY_SHIFT;
+}
+
+/*
+ * Fast path of __energy_diff(): only the clusters of the src and dst cpus
+ * are affected by the move. Returns false if the flattened model cannot
+ * be used.
+ */
+static bool energy_clusters_diff(struct energy_env *eenv,
+				 struct energy_env *eenv_before,
+				 int *energy_before, int *energy_after)
+{
+	struct energy_clusters *ec = rcu_dereference(energy_clusters);
+	int idx[2], nr = 0, i;
+
+	if (!ec)
+		return false;
+
+	if (eenv->src_cpu != -1)
+		idx[nr++] = ec->cpu_cluster[eenv->src_cpu];
+	if (eenv->dst_cpu != -1 &&
+	    (!nr || idx[0] != ec->cpu_cluster[eenv->dst_cpu]))
+		idx[nr++] = ec->cpu_cluster[eenv->dst_cpu];
+
+	for (i = 0; i < nr; i++) {
+		if (idx[i] < 0)
+			return false;
+	}
+
+	for (i = 0; i < nr; i++) {
+		*energy_before += cluster_energy(ec, idx[i], eenv_before);
+
+		/* Keep track of SRC cpu (before) capacity */
+		eenv->cap.before = eenv_before->cap.before;
+		eenv->cap.delta = eenv_before->cap.delta;
+
+		*energy_after += cluster_energy(ec, idx[i], eenv);
+	}
+
+	return true;
+}
+
 static inline bool cpu_in_sg(struct sched_group *sg, int cpu)
 {
 	return cpu != -1 && cpumask_test_cpu(cpu, sched_group_span(sg));
@@ -6041,6 +6272,10 @@ static inline int __energy_diff(struct energy_env *eenv)
 	if (eenv->src_cpu == eenv->dst_cpu)
 		return 0;
 
+	if (energy_clusters_diff(eenv, &eenv_before,
+				 &energy_before, &energy_after))
+		goto done;
+
 	sd_cpu = (eenv->src_cpu != -1) ? eenv->src_cpu : eenv->dst_cpu;
 	sd = rcu_dereference(per_cpu(sd_ea, sd_cpu));
 
@@ -6067,6 +6302,7 @@ static inline int __energy_diff(struct energy_env *eenv)
 		}
 	} while (sg = sg->next, sg != sd->groups);
 
+done:
 	eenv->nrg.before = energy_before;
 	eenv->nrg.after = energy_after;
 	eenv->nrg.diff = eenv->nrg.after - eenv->nrg.before;
@@ -6402,7 +6638,7 @@ boosted_cpu_util(int cpu)
 
 	trace_sched_boost_cpu(cpu, util, margin);
 
-	return util + margin;
+	return schedtune_cpu_util_clamp(cpu, util + margin);
 }
 
 static inline unsigned long
@@ -6413,7 +6649,7 @@ boosted_task_util(struct task_struct *task)
 
 	trace_sched_boost_task(task, util, margin);
 
-	return util + margin;
+	return schedtune_task_util_clamp(task, util + margin);
 }
 
 static unsigned long capacity_spare_without(int cpu, struct task_struct *p)
@@ -7076,7 +7312,7 @@ static inline unsigned long cpu_util_freq(int cpu)
 	if (likely(!walt_disabled && sysctl_sched_use_walt_cpu_util)) {
 		util = cpu_rq(cpu)->prev_runnable_sum;
 		util <<= SCHED_CAPACITY_SHIFT;
-		do_div(util, walt_ravg_window);
+		do_div(util, walt_window_of(cpu));
 	}
 #endif
 
@@ -7094,7 +7330,8 @@ static int start_cpu(bool boosted)
 }
 
 static inline int find_best_target(struct task_struct *p, int *backup_cpu,
-				   bool boosted, bool prefer_idle)
+				   bool boosted, bool prefer_idle, int hint_cpu,
+				   bool reserve)
 {
 	unsigned long min_util = boosted_task_util(p);
 	unsigned long target_capacity = ULONG_MAX;
@@ -7111,6 +7348,8 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 	int target_cpu = -1;
 	int cpu, i;
 	struct task_struct *curr_tsk;
+	struct sched_group *hint_sg = NULL;
+	bool avoid_reserved = !reserve;
 
 	*backup_cpu = -1;
 
@@ -7145,8 +7384,24 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 		return -1;
 	}
 
-	/* Scan CPUs in all SDs */
+	/*
+	 * The waker is a synchronous RPC partner about to block: look at its
+	 * cluster first, and only scan the others if nothing there fits.
+	 * Boosted tasks keep their bias towards big CPUs.
+	 */
 	sg = sd->groups;
+	if (hint_cpu >= 0 && !boosted) {
+		do {
+			if (cpumask_test_cpu(hint_cpu, sched_group_span(sg))) {
+				hint_sg = sg;
+				break;
+			}
+		} while (sg = sg->next, sg != sd->groups);
+	}
+
+retry:
+	/* Scan CPUs in all SDs */
+	sg = hint_sg ? hint_sg : sd->groups;
 	do {
 		for_each_cpu_and(i, tsk_cpus_allowed(p), sched_group_span(sg)) {
 			unsigned long capacity_curr = capacity_curr_of(i);
@@ -7161,6 +7416,13 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 			if (walt_cpu_high_irqload(i))
 				continue;
 
+			/*
+			 * Leave the CPUs reserved by latency-critical tasks
+			 * to them, unless nothing else can take p.
+			 */
+			if (avoid_reserved && schedtune_cpu_reserved(i))
+				continue;
+
 			/*
 			 * p's blocked utilization is still accounted for on prev_cpu
 			 * so prev_cpu will receive a negative bias due to the double
@@ -7391,7 +7653,19 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 			target_cpu = i;
 		}
 
-	} while (sg = sg->next, sg != sd->groups);
+	} while (!hint_sg && (sg = sg->next, sg != sd->groups));
+
+	if (hint_sg && target_cpu == -1 && best_idle_cpu == -1 &&
+	    best_active_cpu == -1) {
+		hint_sg = NULL;
+		goto retry;
+	}
+
+	if (avoid_reserved && target_cpu == -1 && best_idle_cpu == -1 &&
+	    best_active_cpu == -1) {
+		avoid_reserved = false;
+		goto retry;
+	}
 
 	/*
 	 * For non latency sensitive tasks, cases B and C in the previous loop,
@@ -7495,9 +7769,9 @@ cpu_is_in_target_set(struct task_struct *p, int cpu)
 }
 
 static int select_energy_cpu_brute(struct task_struct *p, int prev_cpu,
-				   int sync_boost)
+				   int sync_boost, int hint_cpu)
 {
-	bool boosted, prefer_idle;
+	bool boosted, prefer_idle, reserve;
 	struct sched_domain *sd;
 	int target_cpu;
 	int backup_cpu;
@@ -7512,6 +7786,7 @@ static int select_energy_cpu_brute(struct task_struct *p, int prev_cpu,
 #else
 	prefer_idle = 0;
 #endif
+	reserve = schedtune_reserve_cpu(p) > 0;
 
 	sd = rcu_dereference(per_cpu(sd_ea, prev_cpu));
 	if (!sd) {
@@ -7522,7 +7797,8 @@ static int select_energy_cpu_brute(struct task_struct *p, int prev_cpu,
 	sync_entity_load_avg(&p->se);
 
 	/* Find a cpu with sufficient capacity */
-	next_cpu = find_best_target(p, &backup_cpu, boosted || sync_boost, prefer_idle);
+	next_cpu = find_best_target(p, &backup_cpu, boosted || sync_boost,
+				    prefer_idle, hint_cpu, reserve);
 	if (next_cpu == -1) {
 		target_cpu = prev_cpu;
 		goto unlock;
@@ -7606,25 +7882,34 @@ static void nohz_balancer_kick(bool only_update);
  * preempt must be disabled.
  */
 static int
-select_task_rq_fair(struct task_struct *p, int prev_cpu, int sd_flag, int wake_flags,
-		    int sibling_count_hint)
+__select_task_rq_fair(struct task_struct *p, int prev_cpu, int sd_flag,
+		      int wake_flags, int sibling_count_hint, int *path)
 {
 	struct sched_domain *tmp, *affine_sd = NULL, *sd = NULL;
 	int cpu = smp_processor_id();
 	int new_cpu = prev_cpu;
 	int want_affine = 0;
 	int sync = (wake_flags & WF_SYNC) && !(current->flags & PF_EXITING);
+	int hint_cpu = -1;
 
 	if (sd_flag & SD_BALANCE_WAKE) {
 		int _wake_cap = wake_cap(p, cpu, prev_cpu);
 
+		if (READ_ONCE(p->wake_hint_cpu) >= 0) {
+			hint_cpu = xchg(&p->wake_hint_cpu, -1);
+			if (!sync || !sched_feat(SYNC_WAKE_HINT))
+				hint_cpu = -1;
+		}
+
 		if (cpumask_test_cpu(cpu, tsk_cpus_allowed(p))) {
 			bool about_to_idle = (cpu_rq(cpu)->nr_running < 2);
 
 			if (sysctl_sched_sync_hint_enable && sync &&
 			    !_wake_cap && about_to_idle &&
-			    cpu_is_in_target_set(p, cpu))
+			    cpu_is_in_target_set(p, cpu)) {
+				*path = WAKE_PATH_SYNC;
 				return cpu;
+			}
 		}
 
 		record_wakee(p);
@@ -7647,7 +7932,9 @@ select_task_rq_fair(struct task_struct *p, int prev_cpu, int sd_flag, int wake_f
 		 */
 		bool sync_boost = sync && cpu >= start_cpu(true);
 
-		new_cpu = select_energy_cpu_brute(p, prev_cpu, sync_boost);
+		new_cpu = select_energy_cpu_brute(p, prev_cpu, sync_boost,
+						  hint_cpu);
+		*path = WAKE_PATH_ENERGY;
 		goto unlock;
 	}
 
@@ -7695,12 +7982,14 @@ select_task_rq_fair(struct task_struct *p, int prev_cpu, int sd_flag, int wake_f
 pick_cpu:
 		if (sd_flag & SD_BALANCE_WAKE) { /* XXX always ? */
 			new_cpu = select_idle_sibling(p, prev_cpu, new_cpu);
+			*path = WAKE_PATH_IDLE;
 
 			if (want_affine)
 				current->recent_used_cpu = cpu;
 		}
 	} else {
 		new_cpu = find_idlest_cpu(sd, p, cpu, prev_cpu, sd_flag);
+		*path = WAKE_PATH_IDLEST;
 	}
 
 unlock:
@@ -7714,6 +8003,22 @@ unlock:
 	return new_cpu;
 }
 
+static int
+select_task_rq_fair(struct task_struct *p, int prev_cpu, int sd_flag, int wake_flags,
+		    int sibling_count_hint)
+{
+	int path = WAKE_PATH_IDLEST;
+	u64 start = wake_hist_start();
+	int cpu;
+
+	cpu = __select_task_rq_fair(p, prev_cpu, sd_flag, wake_flags,
+				    sibling_count_hint, &path);
+	if (sd_flag & SD_BALANCE_WAKE)
+		wake_hist_select(p, path, start);
+
+	return cpu;
+}
+
 static void detach_entity_cfs_rq(struct sched_entity *se);
 
 /*
@@ -10481,6 +10786,13 @@ static int idle_balance(struct rq *this_rq, struct rq_flags *rf)
 	if (!cpu_active(this_cpu))
 		return 0;
 
+	/*
+	 * Keep a CPU reserved by a latency-critical task free for its next
+	 * wakeup rather than pulling background work onto it.
+	 */
+	if (schedtune_cpu_reserved(this_cpu))
+		goto out;
+
 	if (!energy_aware() &&
 	    (this_rq->avg_idle < sysctl_sched_migration_cost ||
 	     !READ_ONCE(this_rq->rd->overload))) {
@@ -11275,7 +11587,7 @@ void check_for_migration(struct rq *rq, struct task_struct *p)
 		    rq->curr->nr_cpus_allowed == 1)
 			return;
 
-		new_cpu = select_energy_cpu_brute(p, cpu, 0);
+		new_cpu = select_energy_cpu_brute(p, cpu, 0, -1);
 		if (capacity_orig_of(new_cpu) > capacity_orig_of(cpu)) {
 			active_balance = kick_active_balance(rq, p, new_cpu);
 			if (active_balance)
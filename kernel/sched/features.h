@@ -112,6 +112,19 @@ SCHED_FEAT(EAS_PREFER_IDLE, true)
  */
 SCHED_FEAT(STUNE_BOOST_BIAS_BIG, true)
 
+/*
+ * Honour wake hints left by synchronous RPC partners (binder) and look
+ * for a target CPU in the waker's cluster first.
+ */
+SCHED_FEAT(SYNC_WAKE_HINT, true)
+
+/*
+ * Let a fair task holding an rt_mutex inherit the weight and the schedtune
+ * boost of the highest priority fair task blocked on it, not just its
+ * position in the rt_mutex wait lists.
+ */
+SCHED_FEAT(FAIR_PI, true)
+
 /*
  * Minimum capacity capping. Keep track of minimum capacity factor when
  * minimum frequency available to a policy is modified.
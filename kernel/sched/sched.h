@@ -239,6 +239,7 @@ struct cfs_bandwidth {
 	raw_spinlock_t lock;
 	ktime_t period;
 	u64 quota, runtime;
+	u64 burst, runtime_snap;
 	s64 hierarchical_quota;
 
 	u8 idle;
@@ -251,6 +252,8 @@ struct cfs_bandwidth {
 	/* statistics */
 	int nr_periods, nr_throttled;
 	u64 throttled_time;
+	int nr_burst;
+	u64 burst_time;
 #endif
 };
 
@@ -754,6 +757,7 @@ struct rq {
 	u64 avg_irqload;
 	u64 irqload_ts;
 	u64 cum_window_demand;
+	u64 cum_pred_demand;
 #endif /* CONFIG_SCHED_WALT */
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -1564,6 +1568,38 @@ extern void init_sched_dl_class(void);
 extern void init_sched_rt_class(void);
 extern void init_sched_fair_class(void);
 
+enum wake_path {
+	WAKE_PATH_SYNC,
+	WAKE_PATH_ENERGY,
+	WAKE_PATH_IDLE,
+	WAKE_PATH_IDLEST,
+	NR_WAKE_PATHS
+};
+
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+extern void wake_hist_select(struct task_struct *p, int path, u64 start);
+extern void wake_hist_arrive(struct task_struct *p);
+
+static inline u64 wake_hist_start(void)
+{
+	return local_clock();
+}
+
+static inline void wake_hist_switch(struct task_struct *next)
+{
+	if (next->wake_hist_ts)
+		wake_hist_arrive(next);
+}
+#else
+static inline void wake_hist_select(struct task_struct *p, int path,
+				    u64 start) { }
+static inline u64 wake_hist_start(void) { return 0; }
+static inline void wake_hist_switch(struct task_struct *next) { }
+#endif
+#ifdef CONFIG_SMP
+extern void update_energy_clusters(void);
+#endif
+
 extern void reweight_task(struct task_struct *p, int prio);
 
 extern void resched_curr(struct rq *rq);
@@ -1763,7 +1799,7 @@ static inline unsigned long task_util(struct task_struct *p)
 #ifdef CONFIG_SCHED_WALT
 	if (!walt_disabled && sysctl_sched_use_walt_task_util) {
 		unsigned long demand = p->ravg.demand;
-		return (demand << 10) / walt_ravg_window;
+		return (demand << 10) / walt_window_of(task_cpu(p));
 	}
 #endif
 	return READ_ONCE(p->se.avg.util_avg);
@@ -1815,7 +1851,7 @@ static inline unsigned long cpu_util(int cpu)
 #ifdef CONFIG_SCHED_WALT
 	if (likely(!walt_disabled && sysctl_sched_use_walt_cpu_util)) {
 		util = div64_u64(cpu_rq(cpu)->cfs->cumulative_runnable_avg,
-				 walt_ravg_window >> SCHED_LOAD_SHIFT);
+				 walt_window_of(cpu) >> SCHED_LOAD_SHIFT);
 
  		return min_t(unsigned long, util, capacity_orig_of(cpu));
 	}
@@ -1829,6 +1865,24 @@ static inline unsigned long cpu_util(int cpu)
 
 	return min_t(unsigned long, util, capacity_orig_of(cpu));
 }
+
+/*
+ * Predicted utilization of the tasks runnable on @cpu for the current
+ * WALT window, or 0 when WALT is not driving cpu utilization.
+ */
+static inline unsigned long cpu_pred_util(int cpu)
+{
+#ifdef CONFIG_SCHED_WALT
+	if (likely(!walt_disabled && sysctl_sched_use_walt_cpu_util)) {
+		u64 util = cpu_rq(cpu)->cum_pred_demand;
+
+		util <<= SCHED_CAPACITY_SHIFT;
+		do_div(util, walt_window_of(cpu));
+		return min_t(unsigned long, util, capacity_orig_of(cpu));
+	}
+#endif
+	return 0;
+}
 #endif
 
 static inline void sched_rt_avg_update(struct rq *rq, u64 rt_delta)
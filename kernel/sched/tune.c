@@ -1,6 +1,7 @@
 #include <linux/cgroup.h>
 #include <linux/err.h>
 #include <linux/kernel.h>
+#include <linux/mutex.h>
 #include <linux/percpu.h>
 #include <linux/printk.h>
 #include <linux/rcupdate.h>
@@ -130,6 +131,18 @@ struct schedtune {
 	/* Hint to bias scheduling of tasks on that SchedTune CGroup
 	 * towards idle CPUs */
 	int prefer_idle;
+
+	/* Utilization clamps, in [0..SCHED_CAPACITY_SCALE], for tasks on
+	 * that SchedTune CGroup */
+	int util_min;
+	int util_max;
+
+	/* Hint to keep other CFS tasks off the CPUs where tasks on that
+	 * SchedTune CGroup run */
+	int reserve_cpu;
+
+	/* The group is the top-app one, which gets the in-kernel hint boost */
+	bool top_app;
 };
 
 static inline struct schedtune *css_st(struct cgroup_subsys_state *css)
@@ -162,6 +175,8 @@ root_schedtune = {
 	.perf_boost_idx = 0,
 	.perf_constrain_idx = 0,
 	.prefer_idle = 0,
+	.util_min = 0,
+	.util_max = SCHED_CAPACITY_SCALE,
 };
 
 int
@@ -226,9 +241,27 @@ struct boost_groups {
 	/* Maximum boost value for all RUNNABLE tasks on a CPU */
 	bool idle;
 	int boost_max;
+	/*
+	 * Utilization clamps for the CPU: the maximum util_min and the
+	 * maximum util_max of the boost groups with RUNNABLE tasks, so
+	 * that a capped group never limits an uncapped one.
+	 */
+	int util_min;
+	int util_max;
+	/*
+	 * The CPU has RUNNABLE tasks of a reserve_cpu boost group, or had
+	 * until reserved_until (sched_clock() time).
+	 */
+	bool reserved;
+	u64 reserved_until;
 	struct {
 		/* The boost for tasks on that boost group */
 		int boost;
+		/* The utilization clamps for tasks on that boost group */
+		int util_min;
+		int util_max;
+		/* Whether that boost group reserves the CPUs it runs on */
+		bool reserve_cpu;
 		/* Count of RUNNABLE tasks on that boost group */
 		unsigned tasks;
 	} group[BOOSTGROUPS_COUNT];
@@ -239,11 +272,20 @@ struct boost_groups {
 /* Boost groups affecting each CPU in the system */
 DEFINE_PER_CPU(struct boost_groups, cpu_boost_groups);
 
+/*
+ * A latency-critical task usually blocks only briefly between the stages
+ * of a frame: keep its CPU reserved for that long after it last ran.
+ */
+#define SCHEDTUNE_RESERVE_HOLD_NS	(8 * NSEC_PER_MSEC)
+
 static void
 schedtune_cpu_update(int cpu)
 {
 	struct boost_groups *bg;
 	int boost_max = INT_MIN;
+	int util_min = 0;
+	int util_max = -1;
+	bool reserved = false;
 	int idx;
 
 	bg = &per_cpu(cpu_boost_groups, cpu);
@@ -257,12 +299,26 @@ schedtune_cpu_update(int cpu)
 			continue;
 
 		boost_max = max(boost_max, bg->group[idx].boost);
+		util_min = max(util_min, bg->group[idx].util_min);
+		util_max = max(util_max, bg->group[idx].util_max);
+		reserved |= bg->group[idx].reserve_cpu;
 	}
 
+	if (bg->reserved && !reserved)
+		WRITE_ONCE(bg->reserved_until,
+			   sched_clock() + SCHEDTUNE_RESERVE_HOLD_NS);
+	WRITE_ONCE(bg->reserved, reserved);
+
 	/* If there are no active boost groups on the CPU, set no boost  */
 	if (boost_max == INT_MIN)
 		boost_max = 0;
 	bg->boost_max = boost_max;
+
+	/* Likewise, no active boost groups means no clamping */
+	if (util_max < 0)
+		util_max = SCHED_CAPACITY_SCALE;
+	bg->util_min = min(util_min, util_max);
+	bg->util_max = util_max;
 }
 
 static int
@@ -308,6 +364,41 @@ schedtune_boostgroup_update(int idx, int boost)
 	return 0;
 }
 
+static void
+schedtune_boostgroup_update_clamp(int idx, int util_min, int util_max)
+{
+	struct boost_groups *bg;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		bg = &per_cpu(cpu_boost_groups, cpu);
+
+		bg->group[idx].util_min = util_min;
+		bg->group[idx].util_max = util_max;
+
+		/* Only CPUs with RUNNABLE tasks of this group are affected */
+		if (bg->group[idx].tasks)
+			schedtune_cpu_update(cpu);
+	}
+}
+
+static void
+schedtune_boostgroup_update_reserve(int idx, bool reserve_cpu)
+{
+	struct boost_groups *bg;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		bg = &per_cpu(cpu_boost_groups, cpu);
+
+		bg->group[idx].reserve_cpu = reserve_cpu;
+
+		/* Only CPUs with RUNNABLE tasks of this group are affected */
+		if (bg->group[idx].tasks)
+			schedtune_cpu_update(cpu);
+	}
+}
+
 #define ENQUEUE_TASK  1
 #define DEQUEUE_TASK -1
 
@@ -527,6 +618,73 @@ int schedtune_cpu_boost(int cpu)
 	return bg->boost_max;
 }
 
+/*
+ * Whether @cpu is running, or has just run, a task of a reserve_cpu boost
+ * group, and should be kept free of other CFS tasks.
+ */
+bool schedtune_cpu_reserved(int cpu)
+{
+	struct boost_groups *bg;
+
+	bg = &per_cpu(cpu_boost_groups, cpu);
+	return READ_ONCE(bg->reserved) ||
+	       sched_clock() < READ_ONCE(bg->reserved_until);
+}
+
+/*
+ * Clamp a CPU utilization to the util_min/util_max of the boost groups
+ * currently RUNNABLE on that CPU.
+ */
+unsigned long schedtune_cpu_util_clamp(int cpu, unsigned long util)
+{
+	struct boost_groups *bg;
+
+	bg = &per_cpu(cpu_boost_groups, cpu);
+	return clamp_t(unsigned long, util, READ_ONCE(bg->util_min),
+		       READ_ONCE(bg->util_max));
+}
+
+unsigned long schedtune_task_util_clamp(struct task_struct *p,
+					unsigned long util)
+{
+	struct schedtune *st;
+	int util_min, util_max;
+
+	if (!unlikely(schedtune_initialized))
+		return util;
+
+	rcu_read_lock();
+	st = task_schedtune(p);
+	util_min = st->util_min;
+	util_max = st->util_max;
+	rcu_read_unlock();
+
+	return clamp_t(unsigned long, util, util_min, util_max);
+}
+
+#ifdef CONFIG_RT_MUTEXES
+/*
+ * A task holding an rt_mutex runs with the boost of the top waiter if that
+ * is higher, see the FAIR_PI sched feature. Task structs are RCU freed and
+ * a donor can't exit before it has deboosted us, so it is safe to look at
+ * pi_top_task without the locks that set it.
+ */
+static int schedtune_pi_boost(struct task_struct *p, int task_boost)
+{
+	struct task_struct *pi_task = READ_ONCE(p->pi_top_task);
+
+	if (pi_task && sched_feat(FAIR_PI))
+		task_boost = max(task_boost, task_schedtune(pi_task)->boost);
+
+	return task_boost;
+}
+#else
+static inline int schedtune_pi_boost(struct task_struct *p, int task_boost)
+{
+	return task_boost;
+}
+#endif
+
 int schedtune_task_boost(struct task_struct *p)
 {
 	struct schedtune *st;
@@ -538,7 +696,7 @@ int schedtune_task_boost(struct task_struct *p)
 	/* Get task boost value */
 	rcu_read_lock();
 	st = task_schedtune(p);
-	task_boost = st->boost;
+	task_boost = schedtune_pi_boost(p, st->boost);
 	rcu_read_unlock();
 
 	return task_boost;
@@ -557,7 +715,7 @@ int schedtune_task_boost_rcu_locked(struct task_struct *p)
 
 	/* Get task boost value */
 	st = task_schedtune(p);
-	task_boost = st->boost;
+	task_boost = schedtune_pi_boost(p, st->boost);
 
 	return task_boost;
 }
@@ -579,6 +737,22 @@ int schedtune_prefer_idle(struct task_struct *p)
 	return prefer_idle;
 }
 
+int schedtune_reserve_cpu(struct task_struct *p)
+{
+	struct schedtune *st;
+	int reserve_cpu;
+
+	if (!unlikely(schedtune_initialized))
+		return 0;
+
+	rcu_read_lock();
+	st = task_schedtune(p);
+	reserve_cpu = st->reserve_cpu;
+	rcu_read_unlock();
+
+	return reserve_cpu;
+}
+
 static u64
 prefer_idle_read(struct cgroup_subsys_state *css, struct cftype *cft)
 {
@@ -597,6 +771,118 @@ prefer_idle_write(struct cgroup_subsys_state *css, struct cftype *cft,
 	return 0;
 }
 
+static u64
+reserve_cpu_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	struct schedtune *st = css_st(css);
+
+	return st->reserve_cpu;
+}
+
+static int
+reserve_cpu_write(struct cgroup_subsys_state *css, struct cftype *cft,
+		  u64 reserve_cpu)
+{
+	struct schedtune *st = css_st(css);
+
+	/* Reserving CPUs for every task would just disable placement */
+	if (css == &root_schedtune.css)
+		return -EINVAL;
+
+	st->reserve_cpu = !!reserve_cpu;
+	schedtune_boostgroup_update_reserve(st->idx, st->reserve_cpu);
+
+	return 0;
+}
+
+static u64
+util_min_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	struct schedtune *st = css_st(css);
+
+	return st->util_min;
+}
+
+static int
+util_min_write(struct cgroup_subsys_state *css, struct cftype *cft,
+	       u64 util_min)
+{
+	struct schedtune *st = css_st(css);
+
+	if (util_min > st->util_max)
+		return -EINVAL;
+
+	st->util_min = util_min;
+	schedtune_boostgroup_update_clamp(st->idx, st->util_min, st->util_max);
+
+	return 0;
+}
+
+static u64
+util_max_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	struct schedtune *st = css_st(css);
+
+	return st->util_max;
+}
+
+static int
+util_max_write(struct cgroup_subsys_state *css, struct cftype *cft,
+	       u64 util_max)
+{
+	struct schedtune *st = css_st(css);
+
+	if (util_max > SCHED_CAPACITY_SCALE || util_max < st->util_min)
+		return -EINVAL;
+
+	st->util_max = util_max;
+	schedtune_boostgroup_update_clamp(st->idx, st->util_min, st->util_max);
+
+	return 0;
+}
+
+/*
+ * Boost floor requested from within the kernel (e.g. by devfreq_boost hints)
+ * for the top-app group, on top of the boost configured through cgroupfs.
+ */
+static DEFINE_MUTEX(stune_hint_mutex);
+static int stune_hint_boost;
+
+static bool schedtune_is_top_app(struct schedtune *st)
+{
+	return st->top_app;
+}
+
+static int schedtune_effective_boost(struct schedtune *st)
+{
+	if (schedtune_is_top_app(st))
+		return max(st->boost, stune_hint_boost);
+
+	return st->boost;
+}
+
+void schedtune_set_hint_boost(int boost)
+{
+	int idx;
+
+	boost = clamp(boost, 0, 100);
+
+	mutex_lock(&stune_hint_mutex);
+	if (boost == stune_hint_boost)
+		goto unlock;
+
+	stune_hint_boost = boost;
+	for (idx = 1; idx < BOOSTGROUPS_COUNT; ++idx) {
+		struct schedtune *st = allocated_group[idx];
+
+		if (st && schedtune_is_top_app(st))
+			schedtune_boostgroup_update(st->idx,
+				schedtune_effective_boost(st));
+	}
+unlock:
+	mutex_unlock(&stune_hint_mutex);
+}
+
 static s64
 boost_read(struct cgroup_subsys_state *css, struct cftype *cft)
 {
@@ -630,6 +916,7 @@ boost_write(struct cgroup_subsys_state *css, struct cftype *cft,
 	st->perf_boost_idx = threshold_idx;
 	st->perf_constrain_idx = threshold_idx;
 
+	mutex_lock(&stune_hint_mutex);
 	st->boost = boost;
 	if (css == &root_schedtune.css) {
 		sysctl_sched_cfs_boost = boost;
@@ -638,7 +925,8 @@ boost_write(struct cgroup_subsys_state *css, struct cftype *cft,
 	}
 
 	/* Update CPU boost */
-	schedtune_boostgroup_update(st->idx, st->boost);
+	schedtune_boostgroup_update(st->idx, schedtune_effective_boost(st));
+	mutex_unlock(&stune_hint_mutex);
 
 	trace_sched_tune_config(st->boost);
 
@@ -656,6 +944,21 @@ static struct cftype files[] = {
 		.read_u64 = prefer_idle_read,
 		.write_u64 = prefer_idle_write,
 	},
+	{
+		.name = "reserve_cpu",
+		.read_u64 = reserve_cpu_read,
+		.write_u64 = reserve_cpu_write,
+	},
+	{
+		.name = "util_min",
+		.read_u64 = util_min_read,
+		.write_u64 = util_min_write,
+	},
+	{
+		.name = "util_max",
+		.read_u64 = util_max_read,
+		.write_u64 = util_max_write,
+	},
 	{ }	/* terminate */
 };
 
@@ -672,6 +975,9 @@ schedtune_boostgroup_init(struct schedtune *st)
 	for_each_possible_cpu(cpu) {
 		bg = &per_cpu(cpu_boost_groups, cpu);
 		bg->group[st->idx].boost = 0;
+		bg->group[st->idx].util_min = 0;
+		bg->group[st->idx].util_max = SCHED_CAPACITY_SCALE;
+		bg->group[st->idx].reserve_cpu = false;
 		bg->group[st->idx].tasks = 0;
 	}
 
@@ -709,6 +1015,7 @@ schedtune_css_alloc(struct cgroup_subsys_state *parent_css)
 
 	/* Initialize per CPUs boost group support */
 	st->idx = idx;
+	st->util_max = SCHED_CAPACITY_SCALE;
 	if (schedtune_boostgroup_init(st))
 		goto release;
 
@@ -720,14 +1027,40 @@ out:
 	return ERR_PTR(-ENOMEM);
 }
 
+/*
+ * The group name is only known once the cgroup is linked, so a top-app group
+ * created while a hint is in effect picks up the hint boost here.
+ */
+static int
+schedtune_css_online(struct cgroup_subsys_state *css)
+{
+	struct schedtune *st = css_st(css);
+
+	if (st == &root_schedtune)
+		return 0;
+
+	mutex_lock(&stune_hint_mutex);
+	st->top_app = !strcmp(css->cgroup->kn->name, "top-app");
+	if (st->top_app)
+		schedtune_boostgroup_update(st->idx,
+			schedtune_effective_boost(st));
+	mutex_unlock(&stune_hint_mutex);
+
+	return 0;
+}
+
 static void
 schedtune_boostgroup_release(struct schedtune *st)
 {
+	mutex_lock(&stune_hint_mutex);
 	/* Reset this boost group */
 	schedtune_boostgroup_update(st->idx, 0);
+	schedtune_boostgroup_update_clamp(st->idx, 0, SCHED_CAPACITY_SCALE);
+	schedtune_boostgroup_update_reserve(st->idx, false);
 
 	/* Keep track of allocated boost groups */
 	allocated_group[st->idx] = NULL;
+	mutex_unlock(&stune_hint_mutex);
 }
 
 static void
@@ -741,6 +1074,7 @@ schedtune_css_free(struct cgroup_subsys_state *css)
 
 struct cgroup_subsys schedtune_cgrp_subsys = {
 	.css_alloc	= schedtune_css_alloc,
+	.css_online	= schedtune_css_online,
 	.css_free	= schedtune_css_free,
 	.allow_attach   = schedtune_allow_attach,
 	.can_attach     = schedtune_can_attach,
@@ -753,12 +1087,15 @@ static inline void
 schedtune_init_cgroups(void)
 {
 	struct boost_groups *bg;
-	int cpu;
+	int cpu, idx;
 
 	/* Initialize the per CPU boost groups */
 	for_each_possible_cpu(cpu) {
 		bg = &per_cpu(cpu_boost_groups, cpu);
 		memset(bg, 0, sizeof(struct boost_groups));
+		bg->util_max = SCHED_CAPACITY_SCALE;
+		for (idx = 0; idx < BOOSTGROUPS_COUNT; ++idx)
+			bg->group[idx].util_max = SCHED_CAPACITY_SCALE;
 		raw_spin_lock_init(&bg->lock);
 	}
 
@@ -20,6 +20,13 @@ int schedtune_task_boost_rcu_locked(struct task_struct *tsk);
 
 int schedtune_prefer_idle(struct task_struct *tsk);
 
+bool schedtune_cpu_reserved(int cpu);
+int schedtune_reserve_cpu(struct task_struct *tsk);
+
+unsigned long schedtune_cpu_util_clamp(int cpu, unsigned long util);
+unsigned long schedtune_task_util_clamp(struct task_struct *tsk,
+					unsigned long util);
+
 void schedtune_exit_task(struct task_struct *tsk);
 
 void schedtune_enqueue_task(struct task_struct *p, int cpu);
@@ -30,6 +37,12 @@ void schedtune_dequeue_task(struct task_struct *p, int cpu);
 #define schedtune_cpu_boost(cpu)  get_sysctl_sched_cfs_boost()
 #define schedtune_task_boost(tsk) get_sysctl_sched_cfs_boost()
 
+#define schedtune_cpu_reserved(cpu) false
+#define schedtune_reserve_cpu(tsk) 0
+
+#define schedtune_cpu_util_clamp(cpu, util) (util)
+#define schedtune_task_util_clamp(tsk, util) (util)
+
 #define schedtune_exit_task(task) do { } while (0)
 
 #define schedtune_enqueue_task(task, cpu) do { } while (0)
@@ -46,6 +59,12 @@ int schedtune_accept_deltas(int nrg_delta, int cap_delta,
 #define schedtune_cpu_boost(cpu)  0
 #define schedtune_task_boost(tsk) 0
 
+#define schedtune_cpu_reserved(cpu) false
+#define schedtune_reserve_cpu(tsk) 0
+
+#define schedtune_cpu_util_clamp(cpu, util) (util)
+#define schedtune_task_util_clamp(tsk, util) (util)
+
 #define schedtune_exit_task(task) do { } while (0)
 
 #define schedtune_enqueue_task(task, cpu) do { } while (0)
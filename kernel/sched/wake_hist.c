@@ -0,0 +1,135 @@
+/*
+ * Wakeup placement histograms
+ *
+ * For every fair-class wakeup, record how long select_task_rq_fair() took
+ * and how long the task then waited before it got on a cpu, bucketed by
+ * the placement path that was taken. Histograms are per-cpu and exported
+ * through debugfs as /sys/kernel/debug/sched_wakeup_hist; writing to the
+ * file clears them.
+ */
+#include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "sched.h"
+
+/*
+ * Bucket 0 counts samples below 512ns, bucket n samples in
+ * [2^(n+8), 2^(n+9)) ns, and the last bucket everything above.
+ */
+#define WAKE_HIST_SHIFT		8
+#define WAKE_HIST_BUCKETS	20
+
+struct wake_hist {
+	unsigned long cost[NR_WAKE_PATHS][WAKE_HIST_BUCKETS];
+	unsigned long latency[NR_WAKE_PATHS][WAKE_HIST_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct wake_hist, wake_hist);
+
+static const char * const wake_path_names[NR_WAKE_PATHS] = {
+	[WAKE_PATH_SYNC]	= "sync",
+	[WAKE_PATH_ENERGY]	= "energy",
+	[WAKE_PATH_IDLE]	= "idle_sibling",
+	[WAKE_PATH_IDLEST]	= "idlest",
+};
+
+static inline int wake_hist_bucket(u64 ns)
+{
+	int idx;
+
+	ns >>= WAKE_HIST_SHIFT;
+	if (!ns)
+		return 0;
+
+	idx = ilog2(ns);
+	return min(idx, WAKE_HIST_BUCKETS - 1);
+}
+
+void wake_hist_select(struct task_struct *p, int path, u64 start)
+{
+	u64 now = local_clock();
+
+	__this_cpu_inc(wake_hist.cost[path][wake_hist_bucket(now - start)]);
+	p->wake_hist_ts = start;
+	p->wake_hist_path = path;
+}
+
+void wake_hist_arrive(struct task_struct *p)
+{
+	u64 delta = local_clock() - p->wake_hist_ts;
+
+	__this_cpu_inc(wake_hist.latency[p->wake_hist_path]
+					[wake_hist_bucket(delta)]);
+	p->wake_hist_ts = 0;
+}
+
+static void wake_hist_print(struct seq_file *m, const char *what, int path,
+			    unsigned long *hist)
+{
+	int i;
+
+	seq_printf(m, "  %-12s %-8s", wake_path_names[path], what);
+	for (i = 0; i < WAKE_HIST_BUCKETS; i++)
+		seq_printf(m, " %lu", hist[i]);
+	seq_putc(m, '\n');
+}
+
+static int wake_hist_show(struct seq_file *m, void *v)
+{
+	struct wake_hist *hist;
+	int cpu, path;
+
+	seq_printf(m, "# buckets: <%uns, then powers of two up to >=%lluns\n",
+		   1U << (WAKE_HIST_SHIFT + 1),
+		   1ULL << (WAKE_HIST_SHIFT + WAKE_HIST_BUCKETS - 1));
+
+	for_each_possible_cpu(cpu) {
+		hist = per_cpu_ptr(&wake_hist, cpu);
+		seq_printf(m, "cpu%d\n", cpu);
+		for (path = 0; path < NR_WAKE_PATHS; path++) {
+			wake_hist_print(m, "cost", path, hist->cost[path]);
+			wake_hist_print(m, "latency", path, hist->latency[path]);
+		}
+	}
+
+	return 0;
+}
+
+static ssize_t wake_hist_write(struct file *filp, const char __user *ubuf,
+			       size_t cnt, loff_t *ppos)
+{
+	int cpu;
+
+	/* Racy against concurrent updates, but good enough to start over */
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&wake_hist, cpu), 0, sizeof(struct wake_hist));
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static int wake_hist_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, wake_hist_show, NULL);
+}
+
+static const struct file_operations wake_hist_fops = {
+	.open		= wake_hist_open,
+	.write		= wake_hist_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static __init int wake_hist_init(void)
+{
+	debugfs_create_file("sched_wakeup_hist", 0644, NULL, NULL,
+			    &wake_hist_fops);
+
+	return 0;
+}
+late_initcall(wake_hist_init);
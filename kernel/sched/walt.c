@@ -50,6 +50,14 @@ bool __read_mostly walt_disabled = false;
  */
 __read_mostly unsigned int walt_ravg_window =
 					    (20000000 / TICK_NSEC) * TICK_NSEC;
+
+/*
+ * Per-cpu window size overrides, 0 meaning walt_ravg_window. Tasks keep
+ * their demand in units of the window of the cpu they are on and are
+ * rescaled by walt_fixup_busy_time() when they migrate.
+ */
+__read_mostly unsigned int walt_cpu_ravg_window[NR_CPUS];
+
 #define MIN_SCHED_RAVG_WINDOW ((10000000 / TICK_NSEC) * TICK_NSEC)
 #define MAX_SCHED_RAVG_WINDOW ((1000000000 / TICK_NSEC) * TICK_NSEC)
 
@@ -69,11 +77,19 @@ static inline void fixup_cum_window_demand(struct rq *rq, s64 delta)
 		rq->cum_window_demand = 0;
 }
 
+static inline void fixup_cum_pred_demand(struct rq *rq, s64 delta)
+{
+	rq->cum_pred_demand += delta;
+	if (unlikely((s64)rq->cum_pred_demand < 0))
+		rq->cum_pred_demand = 0;
+}
+
 void
 walt_inc_cumulative_runnable_avg(struct rq *rq,
 				 struct task_struct *p)
 {
 	rq->cumulative_runnable_avg += p->ravg.demand;
+	fixup_cum_pred_demand(rq, p->ravg.pred_demand);
 
 	/*
 	 * Add a task's contribution to the cumulative window demand when
@@ -92,6 +108,7 @@ walt_dec_cumulative_runnable_avg(struct rq *rq,
 {
 	rq->cumulative_runnable_avg -= p->ravg.demand;
 	BUG_ON((s64)rq->cumulative_runnable_avg < 0);
+	fixup_cum_pred_demand(rq, -(s64)p->ravg.pred_demand);
 
 	/*
 	 * on_rq will be 1 for sleeping tasks. So check if the task
@@ -199,9 +216,45 @@ static int __init set_walt_ravg_window(char *str)
 
 early_param("walt_ravg_window", set_walt_ravg_window);
 
+/*
+ * walt_cluster_window=<ns>@<cpulist>, may be given once per cluster, e.g.
+ * walt_cluster_window=8000000@4-7 for short windows on the big cores.
+ * Unlike walt_ravg_window, MIN_SCHED_RAVG_WINDOW is not enforced here
+ * since short windows are the point; one tick is the lower bound.
+ */
+static int __init set_walt_cluster_window(char *str)
+{
+	static struct cpumask mask __initdata;
+	unsigned int window;
+	char *cpus;
+	int cpu;
+
+	cpus = strchr(str, '@');
+	if (!cpus)
+		return -EINVAL;
+	*cpus++ = '\0';
+
+	if (kstrtouint(str, 0, &window) || cpulist_parse(cpus, &mask))
+		return -EINVAL;
+
+	window = (window / TICK_NSEC) * TICK_NSEC;
+	if (!window || window > MAX_SCHED_RAVG_WINDOW) {
+		pr_warn("WALT: invalid window %s for cpus %s\n", str, cpus);
+		return -EINVAL;
+	}
+
+	for_each_cpu(cpu, &mask)
+		walt_cpu_ravg_window[cpu] = window;
+
+	return 0;
+}
+
+early_param("walt_cluster_window", set_walt_cluster_window);
+
 static void
 update_window_start(struct rq *rq, u64 wallclock)
 {
+	u32 window_size = walt_window_of(cpu_of(rq));
 	s64 delta;
 	int nr_windows;
 
@@ -212,11 +265,11 @@ update_window_start(struct rq *rq, u64 wallclock)
 		WARN_ONCE(1, "WALT wallclock appears to have gone backwards or reset\n");
 	}
 
-	if (delta < walt_ravg_window)
+	if (delta < window_size)
 		return;
 
-	nr_windows = div64_u64(delta, walt_ravg_window);
-	rq->window_start += (u64)nr_windows * (u64)walt_ravg_window;
+	nr_windows = div64_u64(delta, window_size);
+	rq->window_start += (u64)nr_windows * (u64)window_size;
 
 	rq->cum_window_demand = rq->cumulative_runnable_avg;
 }
@@ -339,7 +392,7 @@ static void update_cpu_busy_time(struct task_struct *p, struct rq *rq,
 	int p_is_curr_task = (p == rq->curr);
 	u64 mark_start = p->ravg.mark_start;
 	u64 window_start = rq->window_start;
-	u32 window_size = walt_ravg_window;
+	u32 window_size = walt_window_of(cpu_of(rq));
 	u64 delta;
 
 	new_window = mark_start < window_start;
@@ -554,6 +607,126 @@ static int account_busy_for_task_demand(struct task_struct *p, int event)
 	return 1;
 }
 
+/*
+ * Busy time prediction: each task keeps a histogram of which tenth of the
+ * window its past window sums fell into. The bucket hit by the latest
+ * window is bumped and the others decay, so a task that reliably bursts
+ * to the same level every few windows (e.g. once per frame) keeps that
+ * bucket populated even across its quieter windows.
+ */
+#define DEC_STEP		2
+#define INC_STEP		8
+#define INC_STEP_BIG		16
+#define CONSISTENT_THRES	16
+
+static inline int busy_to_bucket(u32 normalized_rt, u32 window_size)
+{
+	int bidx;
+
+	bidx = mult_frac(normalized_rt, NUM_BUSY_BUCKETS, window_size);
+	bidx = min(bidx, NUM_BUSY_BUCKETS - 1);
+
+	/* Bucket 0 would predict nothing, so fold it into bucket 1 */
+	if (!bidx)
+		bidx++;
+
+	return bidx;
+}
+
+static void bucket_increase(u8 *buckets, int idx)
+{
+	int i, step;
+
+	for (i = 0; i < NUM_BUSY_BUCKETS; i++) {
+		if (idx != i) {
+			if (buckets[i] > DEC_STEP)
+				buckets[i] -= DEC_STEP;
+			else
+				buckets[i] = 0;
+		} else {
+			step = buckets[i] >= CONSISTENT_THRES ?
+						INC_STEP_BIG : INC_STEP;
+			if (buckets[i] > U8_MAX - step)
+				buckets[i] = U8_MAX;
+			else
+				buckets[i] += step;
+		}
+	}
+}
+
+/*
+ * Predict the busy time of the next window as the lowest past sample
+ * that falls in the first populated bucket at or above @start. When the
+ * history has no such sample, use the middle of that bucket.
+ */
+static u32 get_pred_busy(struct task_struct *p, int start, u32 runtime,
+			 u32 window_size)
+{
+	u8 *buckets = p->ravg.busy_buckets;
+	u32 *hist = p->ravg.sum_history;
+	u32 dmin, dmax, ret = 0;
+	int first = NUM_BUSY_BUCKETS, i;
+
+	for (i = start; i < NUM_BUSY_BUCKETS; i++) {
+		if (buckets[i]) {
+			first = i;
+			break;
+		}
+	}
+
+	/* Nothing seen at or above the current level, trust runtime */
+	if (first >= NUM_BUSY_BUCKETS)
+		return runtime;
+
+	/* Bucket 1 also holds the samples busy_to_bucket() folded from 0 */
+	if (first == 1)
+		dmin = 0;
+	else
+		dmin = mult_frac(first, window_size, NUM_BUSY_BUCKETS);
+	dmax = mult_frac(first + 1, window_size, NUM_BUSY_BUCKETS);
+
+	for (i = 0; i < walt_ravg_hist_size; i++) {
+		if (hist[i] >= dmin && hist[i] < dmax &&
+		    (!ret || hist[i] < ret))
+			ret = hist[i];
+	}
+
+	if (!ret)
+		ret = (dmin + dmax) / 2;
+
+	return max(runtime, ret);
+}
+
+static u32 predict_and_update_buckets(struct rq *rq, struct task_struct *p,
+				      u32 runtime)
+{
+	u32 window_size = walt_window_of(cpu_of(rq));
+	int bidx = busy_to_bucket(runtime, window_size);
+	u32 pred_demand = get_pred_busy(p, bidx, runtime, window_size);
+
+	bucket_increase(p->ravg.busy_buckets, bidx);
+
+	return pred_demand;
+}
+
+/*
+ * Raise the prediction as soon as the current window's busy time
+ * exceeds it, rather than waiting for the window to close.
+ */
+static void update_task_pred_demand(struct rq *rq, struct task_struct *p)
+{
+	u32 new = p->ravg.sum;
+
+	if (new <= p->ravg.pred_demand || is_idle_task(p) || exiting_task(p))
+		return;
+
+	if (task_on_rq_queued(p) &&
+	    (!task_has_dl_policy(p) || !p->dl.dl_throttled))
+		fixup_cum_pred_demand(rq, (s64)new - p->ravg.pred_demand);
+
+	p->ravg.pred_demand = new;
+}
+
 /*
  * Called when new window is starting for a task, to record cpu usage over
  * recently concluded window(s). Normally 'samples' should be 1. It can be > 1
@@ -565,7 +738,7 @@ static void update_history(struct rq *rq, struct task_struct *p,
 {
 	u32 *hist = &p->ravg.sum_history[0];
 	int ridx, widx;
-	u32 max = 0, avg, demand;
+	u32 max = 0, avg, demand, pred_demand;
 	u64 sum = 0;
 
 	/* Ignore windows where task had no activity */
@@ -602,6 +775,7 @@ static void update_history(struct rq *rq, struct task_struct *p,
 		else
 			demand = max(avg, runtime);
 	}
+	pred_demand = predict_and_update_buckets(rq, p, runtime);
 
 	/*
 	 * A throttled deadline sched class task gets dequeued without
@@ -616,13 +790,17 @@ static void update_history(struct rq *rq, struct task_struct *p,
 	 * demand.
 	 */
 	if (!task_has_dl_policy(p) || !p->dl.dl_throttled) {
-		if (task_on_rq_queued(p))
+		if (task_on_rq_queued(p)) {
 			fixup_cumulative_runnable_avg(rq, p, demand);
-		else if (rq->curr == p)
+			fixup_cum_pred_demand(rq, (s64)pred_demand -
+					      p->ravg.pred_demand);
+		} else if (rq->curr == p) {
 			fixup_cum_window_demand(rq, demand);
+		}
 	}
 
 	p->ravg.demand = demand;
+	p->ravg.pred_demand = pred_demand;
 
 done:
 	trace_walt_update_history(rq, p, runtime, samples, event);
@@ -632,10 +810,13 @@ done:
 static void add_to_task_demand(struct rq *rq, struct task_struct *p,
 				u64 delta)
 {
+	u32 window_size = walt_window_of(cpu_of(rq));
+
 	delta = scale_exec_time(delta, rq);
 	p->ravg.sum += delta;
-	if (unlikely(p->ravg.sum > walt_ravg_window))
-		p->ravg.sum = walt_ravg_window;
+	if (unlikely(p->ravg.sum > window_size))
+		p->ravg.sum = window_size;
+	update_task_pred_demand(rq, p);
 }
 
 /*
@@ -694,7 +875,7 @@ static void update_task_demand(struct task_struct *p, struct rq *rq,
 	u64 mark_start = p->ravg.mark_start;
 	u64 delta, window_start = rq->window_start;
 	int new_window, nr_full_windows;
-	u32 window_size = walt_ravg_window;
+	u32 window_size = walt_window_of(cpu_of(rq));
 
 	new_window = mark_start < window_start;
 	if (!account_busy_for_task_demand(p, event)) {
@@ -816,16 +997,53 @@ void walt_migrate_sync_cpu(int cpu)
 		sync_cpu = smp_processor_id();
 }
 
+/* Convert a busy time in units of window @from into units of window @to */
+static inline u32 scale_to_window(u32 val, u32 from, u32 to)
+{
+	if (from == to)
+		return val;
+
+	return min_t(u64, div64_u64((u64)val * to, from), to);
+}
+
+/*
+ * Moving between cpus with different window sizes: keep the task's demand
+ * the same fraction of a window. The busy buckets are already in tenths
+ * of a window and need no change.
+ */
+static void rescale_task_windows(struct task_struct *p, u32 from, u32 to)
+{
+	int i;
+
+	if (from == to)
+		return;
+
+	p->ravg.sum = scale_to_window(p->ravg.sum, from, to);
+	p->ravg.demand = scale_to_window(p->ravg.demand, from, to);
+	p->ravg.pred_demand = scale_to_window(p->ravg.pred_demand, from, to);
+	for (i = 0; i < RAVG_HIST_SIZE_MAX; i++)
+		p->ravg.sum_history[i] = scale_to_window(p->ravg.sum_history[i],
+							 from, to);
+}
+
 void walt_fixup_busy_time(struct task_struct *p, int new_cpu)
 {
 	struct rq *src_rq = task_rq(p);
 	struct rq *dest_rq = cpu_rq(new_cpu);
+	u32 src_window = walt_window_of(cpu_of(src_rq));
+	u32 dest_window = walt_window_of(new_cpu);
+	u32 curr_window, prev_window;
 	u64 wallclock;
 
-	if (!p->on_rq && p->state != TASK_WAKING)
+	if (exiting_task(p))
 		return;
 
-	if (exiting_task(p)) {
+	/*
+	 * A new or otherwise unqueued task carries no busy time on either
+	 * rq yet, but its demand must still follow the window size.
+	 */
+	if (!p->on_rq && p->state != TASK_WAKING) {
+		rescale_task_windows(p, src_window, dest_window);
 		return;
 	}
 
@@ -849,17 +1067,31 @@ void walt_fixup_busy_time(struct task_struct *p, int new_cpu)
 	if (p->state == TASK_WAKING &&
 	    p->last_sleep_ts >= src_rq->window_start) {
 		fixup_cum_window_demand(src_rq, -(s64)p->ravg.demand);
+		rescale_task_windows(p, src_window, dest_window);
 		fixup_cum_window_demand(dest_rq, p->ravg.demand);
+	} else {
+		rescale_task_windows(p, src_window, dest_window);
 	}
 
+	/*
+	 * The windows of the two rqs need not line up when their sizes
+	 * differ. Carry over the same fraction of a window, which is what
+	 * cpu utilization is computed from.
+	 */
 	if (p->ravg.curr_window) {
+		curr_window = scale_to_window(p->ravg.curr_window,
+					      src_window, dest_window);
 		src_rq->curr_runnable_sum -= p->ravg.curr_window;
-		dest_rq->curr_runnable_sum += p->ravg.curr_window;
+		dest_rq->curr_runnable_sum += curr_window;
+		p->ravg.curr_window = curr_window;
 	}
 
 	if (p->ravg.prev_window) {
+		prev_window = scale_to_window(p->ravg.prev_window,
+					      src_window, dest_window);
 		src_rq->prev_runnable_sum -= p->ravg.prev_window;
-		dest_rq->prev_runnable_sum += p->ravg.prev_window;
+		dest_rq->prev_runnable_sum += prev_window;
+		p->ravg.prev_window = prev_window;
 	}
 
 	if ((s64)src_rq->prev_runnable_sum < 0) {
@@ -881,9 +1113,10 @@ void walt_fixup_busy_time(struct task_struct *p, int new_cpu)
 void walt_init_new_task_load(struct task_struct *p)
 {
 	int i;
+	u32 window_size = walt_window_of(task_cpu(p));
 	u32 init_load_windows =
 			div64_u64((u64)sysctl_sched_walt_init_task_load_pct *
-                          (u64)walt_ravg_window, 100);
+                          (u64)window_size, 100);
 	u32 init_load_pct = current->init_load_pct;
 
 	p->init_load_pct = 0;
@@ -891,10 +1124,11 @@ void walt_init_new_task_load(struct task_struct *p)
 
 	if (init_load_pct) {
 		init_load_windows = div64_u64((u64)init_load_pct *
-			  (u64)walt_ravg_window, 100);
+			  (u64)window_size, 100);
 	}
 
 	p->ravg.demand = init_load_windows;
+	p->ravg.pred_demand = init_load_windows;
 	for (i = 0; i < RAVG_HIST_SIZE_MAX; ++i)
 		p->ravg.sum_history[i] = init_load_windows;
 }
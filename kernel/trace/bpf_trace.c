@@ -334,3 +334,48 @@ static int __init register_kprobe_prog_ops(void)
 	return 0;
 }
 late_initcall(register_kprobe_prog_ops);
+
+/* bpf_perf_event_output() needs the pt_regs a kprobe context points to */
+static const struct bpf_func_proto *tp_prog_func_proto(enum bpf_func_id func_id)
+{
+	switch (func_id) {
+	case BPF_FUNC_perf_event_output:
+		return NULL;
+	default:
+		return kprobe_prog_func_proto(func_id);
+	}
+}
+
+/*
+ * bpf+tracepoint programs get the raw record of the event, whose first
+ * 8 bytes perf_trace_##call() has replaced with the pt_regs pointer.
+ * How far into the record a program may read is checked against the
+ * event it is attached to in perf_event_set_bpf_prog().
+ */
+static bool tp_prog_is_valid_access(int off, int size, enum bpf_access_type type)
+{
+	if (off < sizeof(void *) || off >= PERF_MAX_TRACE_SIZE)
+		return false;
+	if (type != BPF_READ)
+		return false;
+	if (off % size != 0)
+		return false;
+	return true;
+}
+
+static struct bpf_verifier_ops tracepoint_prog_ops = {
+	.get_func_proto  = tp_prog_func_proto,
+	.is_valid_access = tp_prog_is_valid_access,
+};
+
+static struct bpf_prog_type_list tracepoint_tl = {
+	.ops	= &tracepoint_prog_ops,
+	.type	= BPF_PROG_TYPE_TRACEPOINT,
+};
+
+static int __init register_tracepoint_prog_ops(void)
+{
+	bpf_register_prog_type(&tracepoint_tl);
+	return 0;
+}
+late_initcall(register_tracepoint_prog_ops);
@@ -27,12 +27,18 @@
 #include <linux/wait.h>
 #include <linux/delay.h>
 #include <linux/completion.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
+#include <linux/ctype.h>
+#include <linux/notifier.h>
 #include <linux/ipc_logging.h>
+#include <asm/sections.h>
 
 #include "ipc_logging_private.h"
 
 #define LOG_PAGE_DATA_SIZE	sizeof(((struct ipc_log_page *)0)->data)
 #define LOG_PAGE_FLAG (1 << 31)
+#define IPC_LOG_FLUSH_DELAY msecs_to_jiffies(100)
 
 static LIST_HEAD(ipc_log_context_list);
 static DEFINE_RWLOCK(context_list_lock_lha1);
@@ -278,22 +284,14 @@ static void msg_drop(struct ipc_log_context *ilctxt)
 }
 
 /*
- * Commits messages to the FIFO.  If the FIFO is full, then enough
- * messages are dropped to create space for the new message.
+ * Copies a message into the log pages, with context_list_lock_lha1 and
+ * ilctxt->context_lock_lhb1 held.
  */
-void ipc_log_write(void *ctxt, struct encode_context *ectxt)
+static void __ipc_log_write(struct ipc_log_context *ilctxt,
+			    struct encode_context *ectxt)
 {
-	struct ipc_log_context *ilctxt = (struct ipc_log_context *)ctxt;
 	int bytes_to_write;
-	unsigned long flags;
 
-	if (!ilctxt || !ectxt) {
-		pr_err("%s: Invalid ipc_log or encode context\n", __func__);
-		return;
-	}
-
-	read_lock_irqsave(&context_list_lock_lha1, flags);
-	spin_lock(&ilctxt->context_lock_lhb1);
 	while (ilctxt->write_avail <= ectxt->offset)
 		msg_drop(ilctxt);
 
@@ -323,6 +321,25 @@ void ipc_log_write(void *ctxt, struct encode_context *ectxt)
 	ilctxt->write_page->hdr.write_offset += bytes_to_write;
 	ilctxt->write_avail -= ectxt->offset;
 	complete(&ilctxt->read_avail);
+}
+
+/*
+ * Commits messages to the FIFO.  If the FIFO is full, then enough
+ * messages are dropped to create space for the new message.
+ */
+void ipc_log_write(void *ctxt, struct encode_context *ectxt)
+{
+	struct ipc_log_context *ilctxt = (struct ipc_log_context *)ctxt;
+	unsigned long flags;
+
+	if (!ilctxt || !ectxt) {
+		pr_err("%s: Invalid ipc_log or encode context\n", __func__);
+		return;
+	}
+
+	read_lock_irqsave(&context_list_lock_lha1, flags);
+	spin_lock(&ilctxt->context_lock_lhb1);
+	__ipc_log_write(ilctxt, ectxt);
 	spin_unlock(&ilctxt->context_lock_lhb1);
 	read_unlock_irqrestore(&context_list_lock_lha1, flags);
 }
@@ -487,21 +504,203 @@ int tsv_byte_array_write(struct encode_context *ectxt,
 }
 EXPORT_SYMBOL(tsv_byte_array_write);
 
+/*
+ * Formats a staged string message into the same TSV_TYPE_STRING message
+ * ipc_log_string() would have written at the time it was logged.
+ */
+static void ipc_log_stage_encode(struct encode_context *ectxt,
+				 struct ipc_log_stage_entry *e)
+{
+	int avail_size, data_size, hdr_size = sizeof(struct tsv_header);
+
+	msg_encode_start(ectxt, TSV_TYPE_STRING);
+	tsv_write_header(ectxt, TSV_TYPE_TIMESTAMP, sizeof(e->t_now));
+	tsv_write_data(ectxt, &e->t_now, sizeof(e->t_now));
+	tsv_write_header(ectxt, TSV_TYPE_QTIMER, sizeof(e->qtimer));
+	tsv_write_data(ectxt, &e->qtimer, sizeof(e->qtimer));
+	avail_size = (MAX_MSG_SIZE - (ectxt->offset + hdr_size));
+	data_size = bstr_printf((ectxt->buff + ectxt->offset + hdr_size),
+				avail_size, e->fmt, e->args);
+	data_size = min(data_size, avail_size - 1);
+	tsv_write_header(ectxt, TSV_TYPE_BYTE_ARRAY, data_size);
+	ectxt->offset += data_size;
+	msg_encode_end(ectxt);
+}
+
+static inline uint32_t ipc_log_stage_entry_size(uint32_t words)
+{
+	return ALIGN(sizeof(struct ipc_log_stage_entry) +
+		     words * sizeof(uint32_t), 8);
+}
+
+/*
+ * Formats every message staged in @stage into the log pages.  Called with
+ * stage->lock, context_list_lock_lha1 and ilctxt->context_lock_lhb1 held.
+ */
+static void __ipc_log_drain_stage(struct ipc_log_context *ilctxt,
+				  struct ipc_log_stage *stage)
+{
+	struct encode_context ectxt;
+	struct ipc_log_stage_entry *e;
+	uint32_t off = 0;
+
+	while (off < stage->used) {
+		e = (struct ipc_log_stage_entry *)(stage->buf + off);
+		ipc_log_stage_encode(&ectxt, e);
+		__ipc_log_write(ilctxt, &ectxt);
+		off += ipc_log_stage_entry_size(e->words);
+	}
+	stage->used = 0;
+}
+
+/* Called with stage->lock held and interrupts disabled */
+static void ipc_log_drain_stage(struct ipc_log_context *ilctxt,
+				struct ipc_log_stage *stage)
+{
+	if (!stage->used)
+		return;
+
+	read_lock(&context_list_lock_lha1);
+	spin_lock(&ilctxt->context_lock_lhb1);
+	__ipc_log_drain_stage(ilctxt, stage);
+	spin_unlock(&ilctxt->context_lock_lhb1);
+	read_unlock(&context_list_lock_lha1);
+}
+
+static void ipc_log_flush_stages(struct ipc_log_context *ilctxt)
+{
+	struct ipc_log_stage *stage;
+	unsigned long flags;
+	int cpu;
+
+	if (!ilctxt->stage)
+		return;
+
+	clear_bit(0, &ilctxt->flush_pending);
+	for_each_possible_cpu(cpu) {
+		stage = per_cpu_ptr(ilctxt->stage, cpu);
+		spin_lock_irqsave(&stage->lock, flags);
+		ipc_log_drain_stage(ilctxt, stage);
+		spin_unlock_irqrestore(&stage->lock, flags);
+	}
+}
+
+static void ipc_log_flush_work(struct work_struct *work)
+{
+	struct ipc_log_context *ilctxt = container_of(to_delayed_work(work),
+					struct ipc_log_context, flush_work);
+
+	ipc_log_flush_stages(ilctxt);
+}
+
+/*
+ * Only formats whose arguments are still valid at read time can be staged:
+ * the format string itself must be built in (module text may be gone and
+ * dynamic formats may be reused by then), and %p extensions other than
+ * the symbol and plain pointer ones dereference their argument.
+ */
+static bool ipc_log_fmt_deferrable(const char *fmt)
+{
+	if (fmt < __start_rodata || fmt >= __end_rodata)
+		return false;
+
+	while ((fmt = strchr(fmt, '%'))) {
+		fmt++;
+		if (*fmt == '%') {
+			fmt++;
+			continue;
+		}
+		fmt += strspn(fmt, "-+ #0123456789.*hlLqjzt");
+		if (*fmt == 'p' && isalnum(fmt[1]) && !strchr("SsFfBK", fmt[1]))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Records a string message in this CPU's staging buffer, leaving the
+ * formatting to whoever moves it to the log pages.
+ *
+ * Returns 0 if staged, or -E2BIG if the packed arguments don't fit.
+ */
+static int ipc_log_stage_string(struct ipc_log_context *ilctxt,
+				const char *fmt, va_list args)
+{
+	uint32_t bin[IPC_LOG_STAGE_MAX_WORDS];
+	struct ipc_log_stage_entry *e;
+	struct ipc_log_stage *stage;
+	unsigned long flags;
+	uint32_t size;
+	int words;
+
+	words = vbin_printf(bin, ARRAY_SIZE(bin), fmt, args);
+	if (words < 0 || words > ARRAY_SIZE(bin))
+		return -E2BIG;
+	size = ipc_log_stage_entry_size(words);
+
+	local_irq_save(flags);
+	stage = this_cpu_ptr(ilctxt->stage);
+	spin_lock(&stage->lock);
+	if (stage->used + size > IPC_LOG_STAGE_SIZE)
+		ipc_log_drain_stage(ilctxt, stage);
+
+	e = (struct ipc_log_stage_entry *)(stage->buf + stage->used);
+	e->t_now = sched_clock();
+	e->qtimer = arch_counter_get_cntvct();
+	e->fmt = fmt;
+	e->words = words;
+	memcpy(e->args, bin, words * sizeof(uint32_t));
+	stage->used += size;
+	spin_unlock(&stage->lock);
+	local_irq_restore(flags);
+
+	if (!test_and_set_bit(0, &ilctxt->flush_pending))
+		schedule_delayed_work(&ilctxt->flush_work, IPC_LOG_FLUSH_DELAY);
+	return 0;
+}
+
 /*
  * Helper function to log a string
  *
  * @ilctxt ipc_log_context created using ipc_log_context_create()
  * @fmt Data specified using format specifiers
+ *
+ * Messages whose arguments can be formatted later are only packed into a
+ * per-CPU staging buffer here; they reach the log pages when the buffer
+ * fills up, when the log is read, or at the latest IPC_LOG_FLUSH_DELAY
+ * later.
  */
 int ipc_log_string(void *ilctxt, const char *fmt, ...)
 {
+	struct ipc_log_context *ctxt = (struct ipc_log_context *)ilctxt;
 	struct encode_context ectxt;
 	int avail_size, data_size, hdr_size = sizeof(struct tsv_header);
+	struct ipc_log_stage *stage;
+	unsigned long flags;
 	va_list arg_list;
+	int ret;
 
 	if (!ilctxt)
 		return -EINVAL;
 
+	if (ctxt->stage && ipc_log_fmt_deferrable(fmt)) {
+		va_start(arg_list, fmt);
+		ret = ipc_log_stage_string(ctxt, fmt, arg_list);
+		va_end(arg_list);
+		if (!ret)
+			return 0;
+	}
+
+	/* keep this CPU's messages in order */
+	if (ctxt->stage) {
+		local_irq_save(flags);
+		stage = this_cpu_ptr(ctxt->stage);
+		spin_lock(&stage->lock);
+		ipc_log_drain_stage(ctxt, stage);
+		spin_unlock(&stage->lock);
+		local_irq_restore(flags);
+	}
+
 	msg_encode_start(&ectxt, TSV_TYPE_STRING);
 	tsv_timestamp_write(&ectxt);
 	tsv_qtimer_write(&ectxt);
@@ -542,6 +741,8 @@ int ipc_log_extract(void *ctxt, char *buff, int size)
 	if (size < MAX_MSG_DECODED_SIZE)
 		return -EINVAL;
 
+	ipc_log_flush_stages(ilctxt);
+
 	dctxt.output_format = OUTPUT_DEBUGFS;
 	dctxt.buff = buff;
 	dctxt.size = size;
@@ -767,7 +968,7 @@ void *ipc_log_context_create(int max_num_pages,
 {
 	struct ipc_log_context *ctxt;
 	struct ipc_log_page *pg = NULL;
-	int page_cnt;
+	int page_cnt, cpu;
 	unsigned long flags;
 
 	ctxt = kzalloc(sizeof(struct ipc_log_context), GFP_KERNEL);
@@ -776,6 +977,13 @@ void *ipc_log_context_create(int max_num_pages,
 		return 0;
 	}
 
+	/* without staging buffers every message is formatted immediately */
+	ctxt->stage = alloc_percpu(struct ipc_log_stage);
+	if (ctxt->stage)
+		for_each_possible_cpu(cpu)
+			spin_lock_init(&per_cpu_ptr(ctxt->stage, cpu)->lock);
+	INIT_DELAYED_WORK(&ctxt->flush_work, ipc_log_flush_work);
+
 	init_completion(&ctxt->read_avail);
 	INIT_LIST_HEAD(&ctxt->page_list);
 	INIT_LIST_HEAD(&ctxt->dfunc_info_list);
@@ -828,6 +1036,7 @@ release_ipc_log_context:
 		list_del(&pg->hdr.list);
 		kfree(pg);
 	}
+	free_percpu(ctxt->stage);
 	kfree(ctxt);
 	return 0;
 }
@@ -847,26 +1056,72 @@ int ipc_log_context_destroy(void *ctxt)
 	if (!ilctxt)
 		return 0;
 
-	while (!list_empty(&ilctxt->page_list)) {
-		pg = get_first_page(ctxt);
-		list_del(&pg->hdr.list);
-		kfree(pg);
-	}
-
+	/*
+	 * Unpublish the context before freeing the stages, the panic notifier
+	 * and debugfs readers drain them.
+	 */
 	write_lock_irqsave(&context_list_lock_lha1, flags);
 	list_del(&ilctxt->list);
 	write_unlock_irqrestore(&context_list_lock_lha1, flags);
 
 	debugfs_remove_recursive(ilctxt->dent);
 
+	cancel_delayed_work_sync(&ilctxt->flush_work);
+	free_percpu(ilctxt->stage);
+
+	while (!list_empty(&ilctxt->page_list)) {
+		pg = get_first_page(ctxt);
+		list_del(&pg->hdr.list);
+		kfree(pg);
+	}
+
 	kfree(ilctxt);
 	return 0;
 }
 EXPORT_SYMBOL(ipc_log_context_destroy);
 
+/*
+ * Move whatever is still staged into the log pages so that it can be
+ * extracted from the ramdump.  Locks held by CPUs that were stopped while
+ * logging are skipped rather than waited for.
+ */
+static int ipc_log_panic_notify(struct notifier_block *nb,
+				unsigned long event, void *unused)
+{
+	struct ipc_log_context *ilctxt;
+	struct ipc_log_stage *stage;
+	int cpu;
+
+	if (!read_trylock(&context_list_lock_lha1))
+		return NOTIFY_DONE;
+
+	list_for_each_entry(ilctxt, &ipc_log_context_list, list) {
+		if (!ilctxt->stage)
+			continue;
+		for_each_possible_cpu(cpu) {
+			stage = per_cpu_ptr(ilctxt->stage, cpu);
+			if (!stage->used || !spin_trylock(&stage->lock))
+				continue;
+			if (spin_trylock(&ilctxt->context_lock_lhb1)) {
+				__ipc_log_drain_stage(ilctxt, stage);
+				spin_unlock(&ilctxt->context_lock_lhb1);
+			}
+			spin_unlock(&stage->lock);
+		}
+	}
+	read_unlock(&context_list_lock_lha1);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ipc_log_panic_nb = {
+	.notifier_call = ipc_log_panic_notify,
+};
+
 static int __init ipc_logging_init(void)
 {
 	check_and_create_debugfs();
+	atomic_notifier_chain_register(&panic_notifier_list,
+				       &ipc_log_panic_nb);
 	return 0;
 }
 
@@ -95,6 +95,9 @@ struct ipc_log_page {
  * @dfunc_info_list:  List of deserialization functions
  * @context_lock_lhb1:  Lock for entire structure
  * @read_avail:  Completed when new data is added to the log
+ * @stage:  Per-CPU staging buffers for unformatted string messages
+ * @flush_work:  Moves staged messages into the log pages
+ * @flush_pending:  Bit 0 set while @flush_work is scheduled
  */
 struct ipc_log_context {
 	uint32_t magic;
@@ -119,6 +122,42 @@ struct ipc_log_context {
 	struct list_head dfunc_info_list;
 	spinlock_t context_lock_lhb1;
 	struct completion read_avail;
+	struct ipc_log_stage __percpu *stage;
+	struct delayed_work flush_work;
+	unsigned long flush_pending;
+};
+
+#define IPC_LOG_STAGE_SIZE 1024
+#define IPC_LOG_STAGE_MAX_WORDS 64
+
+/**
+ * struct ipc_log_stage_entry - string message waiting to be formatted
+ *
+ * @t_now:  Scheduler clock when the message was logged
+ * @qtimer:  QTimer count when the message was logged
+ * @fmt:  Format string, always in kernel rodata
+ * @words:  Number of 32-bit words in @args
+ * @args:  Arguments as packed by vbin_printf()
+ */
+struct ipc_log_stage_entry {
+	uint64_t t_now;
+	uint64_t qtimer;
+	const char *fmt;
+	uint32_t words;
+	uint32_t args[];
+};
+
+/**
+ * struct ipc_log_stage - per-CPU staging buffer of a logging context
+ *
+ * @lock:  Only contended when the buffer is drained from another CPU
+ * @used:  Number of bytes of @buf holding staged entries
+ * @buf:  Packed struct ipc_log_stage_entry records
+ */
+struct ipc_log_stage {
+	spinlock_t lock;
+	uint32_t used;
+	char buf[IPC_LOG_STAGE_SIZE] __aligned(8);
 };
 
 struct dfunc_info {
@@ -754,6 +754,107 @@ void tracing_snapshot_alloc(void)
 	tracing_snapshot();
 }
 EXPORT_SYMBOL_GPL(tracing_snapshot_alloc);
+
+/*
+ * Flight recorder mode: userspace sizes the buffer, enables the events it
+ * cares about and arms the trigger through "snapshot_trigger".  The first
+ * anomaly reported with tracing_snapshot_trigger() afterwards swaps the
+ * live buffer into the snapshot buffer and disarms, so the capture stays
+ * put until userspace has read it and re-armed.
+ */
+static atomic_t snapshot_trigger_armed;
+static atomic_t snapshot_trigger_count;
+static const char *snapshot_trigger_reason;
+
+/**
+ * tracing_snapshot_trigger - snapshot if the flight recorder is armed
+ * @reason: static string recorded in the trace and in "snapshot_trigger"
+ *
+ * Cheap enough to call from hot paths when nothing is armed, and safe in
+ * any context except NMI, which is ignored.  Unlike tracing_snapshot(),
+ * it never stops tracing because the snapshot buffer is missing.
+ */
+void tracing_snapshot_trigger(const char *reason)
+{
+	struct trace_array *tr = &global_trace;
+	unsigned long flags;
+
+	if (likely(!atomic_read(&snapshot_trigger_armed)))
+		return;
+
+	if (in_nmi() || !tr->allocated_snapshot ||
+	    tr->current_trace->use_max_tr)
+		return;
+
+	if (atomic_cmpxchg(&snapshot_trigger_armed, 1, 0) != 1)
+		return;
+
+	WRITE_ONCE(snapshot_trigger_reason, reason);
+	atomic_inc(&snapshot_trigger_count);
+
+	internal_trace_puts("*** SNAPSHOT TRIGGERED: ");
+	internal_trace_puts(reason);
+	internal_trace_puts(" ***\n");
+
+	local_irq_save(flags);
+	update_max_tr(tr, current, smp_processor_id());
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(tracing_snapshot_trigger);
+
+static ssize_t
+tracing_snapshot_trigger_read(struct file *filp, char __user *ubuf,
+			      size_t cnt, loff_t *ppos)
+{
+	const char *reason = READ_ONCE(snapshot_trigger_reason);
+	char buf[96];
+	int r;
+
+	r = scnprintf(buf, sizeof(buf), "armed: %d\ncount: %d\nlast: %s\n",
+		      atomic_read(&snapshot_trigger_armed),
+		      atomic_read(&snapshot_trigger_count),
+		      reason ? reason : "none");
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static ssize_t
+tracing_snapshot_trigger_write(struct file *filp, const char __user *ubuf,
+			       size_t cnt, loff_t *ppos)
+{
+	struct trace_array *tr = &global_trace;
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul_from_user(ubuf, cnt, 10, &val);
+	if (ret)
+		return ret;
+
+	if (val > 1)
+		return -EINVAL;
+
+	if (val) {
+		mutex_lock(&trace_types_lock);
+		if (tr->current_trace->use_max_tr)
+			ret = -EBUSY;
+		else
+			ret = alloc_snapshot(tr);
+		mutex_unlock(&trace_types_lock);
+		if (ret < 0)
+			return ret;
+	}
+	atomic_set(&snapshot_trigger_armed, val);
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static const struct file_operations tracing_snapshot_trigger_fops = {
+	.open		= tracing_open_generic,
+	.read		= tracing_snapshot_trigger_read,
+	.write		= tracing_snapshot_trigger_write,
+	.llseek		= generic_file_llseek,
+};
 #else
 void tracing_snapshot(void)
 {
@@ -772,6 +873,10 @@ void tracing_snapshot_alloc(void)
 	tracing_snapshot();
 }
 EXPORT_SYMBOL_GPL(tracing_snapshot_alloc);
+void tracing_snapshot_trigger(const char *reason)
+{
+}
+EXPORT_SYMBOL_GPL(tracing_snapshot_trigger);
 #endif /* CONFIG_TRACER_SNAPSHOT */
 
 static void tracer_tracing_off(struct trace_array *tr)
@@ -7186,6 +7291,11 @@ static __init int tracer_init_tracefs(void)
 	trace_create_file("saved_cmdlines_size", 0644, d_tracer,
 			  NULL, &tracing_saved_cmdlines_size_fops);
 
+#ifdef CONFIG_TRACER_SNAPSHOT
+	trace_create_file("snapshot_trigger", 0644, d_tracer,
+			  NULL, &tracing_snapshot_trigger_fops);
+#endif
+
 	trace_enum_init();
 
 	trace_create_enum_file(d_tracer);
@@ -78,6 +78,26 @@ trace_get_fields(struct trace_event_call *event_call)
 	return event_call->class->get_fields(event_call);
 }
 
+/*
+ * Size of the fixed part of @call's record, which is how far into it a
+ * bpf program attached to the event may read.
+ */
+int trace_event_get_offsets(struct trace_event_call *call)
+{
+	struct ftrace_event_field *tail;
+	struct list_head *head;
+
+	head = trace_get_fields(call);
+	if (list_empty(head))
+		return 0;
+	/*
+	 * head->next points to the last field with the largest offset,
+	 * since it was added last by trace_define_field()
+	 */
+	tail = list_first_entry(head, struct ftrace_event_field, link);
+	return tail->offset + tail->size;
+}
+
 static struct ftrace_event_field *
 __find_event_field(struct list_head *head, char *name)
 {
@@ -46,6 +46,7 @@
 #include <linux/hashtable.h>
 #include <linux/rculist.h>
 #include <linux/nodemask.h>
+#include <linux/topology.h>
 #include <linux/moduleparam.h>
 #include <linux/uaccess.h>
 #include <linux/bug.h>
@@ -294,6 +295,19 @@ module_param_named(power_efficient, wq_power_efficient, bool, 0444);
 
 static bool wq_numa_enabled;		/* unbound NUMA affinity enabled */
 
+/*
+ * CPU clusters sharing a last level cache, numbered densely from zero.
+ * A workqueue with ->cluster set uses these instead of NUMA nodes to pick
+ * its per-"node" pwqs, so that work queued from one cluster also runs there.
+ */
+static cpumask_var_t *wq_cluster_possible_cpumask;
+					/* possible CPUs of each cluster */
+static int *wq_cpu_cluster;		/* cluster index of each CPU */
+static int wq_nr_clusters;		/* 0 if unavailable */
+
+static bool wq_cluster_affinity;
+module_param_named(cluster_affinity, wq_cluster_affinity, bool, 0444);
+
 /* buf for wq_update_unbound_numa_attrs(), protected by CPU hotplug exclusion */
 static struct workqueue_attrs *wq_update_unbound_numa_attrs_buf;
 
@@ -585,6 +599,25 @@ static struct pool_workqueue *unbound_pwq_by_node(struct workqueue_struct *wq,
 	return rcu_dereference_raw(wq->numa_pwq_tbl[node]);
 }
 
+/* number of entries in an unbound wq's numa_pwq_tbl[] */
+static int wq_nr_pwq_slots(void)
+{
+	return max_t(int, nr_node_ids, wq_nr_clusters);
+}
+
+static bool wq_attrs_cluster(const struct workqueue_attrs *attrs)
+{
+	return wq_nr_clusters && attrs->cluster;
+}
+
+/* numa_pwq_tbl[] index that work queued from @cpu should use */
+static int wq_cpu_pwq_slot(struct workqueue_struct *wq, int cpu)
+{
+	if (wq_attrs_cluster(wq->unbound_attrs))
+		return wq_cpu_cluster[cpu];
+	return cpu_to_node(cpu);
+}
+
 static unsigned int work_color_to_flags(int color)
 {
 	return color << WORK_STRUCT_COLOR_SHIFT;
@@ -1375,7 +1408,7 @@ retry:
 	if (!(wq->flags & WQ_UNBOUND))
 		pwq = per_cpu_ptr(wq->cpu_pwqs, cpu);
 	else
-		pwq = unbound_pwq_by_node(wq, cpu_to_node(cpu));
+		pwq = unbound_pwq_by_node(wq, wq_cpu_pwq_slot(wq, cpu));
 
 	/*
 	 * If @work was previously on a different pool, it might still be
@@ -3116,8 +3149,10 @@ static void copy_workqueue_attrs(struct workqueue_attrs *to,
 	 * Unlike hash and equality test, this function doesn't ignore
 	 * ->no_numa as it is used for both pool and wq attrs.  Instead,
 	 * get_unbound_pool() explicitly clears ->no_numa after copying.
+	 * The same goes for ->cluster.
 	 */
 	to->no_numa = from->no_numa;
+	to->cluster = from->cluster;
 }
 
 /* hash value of the content of @attr */
@@ -3322,10 +3357,11 @@ static struct worker_pool *get_unbound_pool(const struct workqueue_attrs *attrs)
 	pool->node = target_node;
 
 	/*
-	 * no_numa isn't a worker_pool attribute, always clear it.  See
-	 * 'struct workqueue_attrs' comments for detail.
+	 * no_numa and cluster aren't worker_pool attributes, always clear
+	 * them.  See 'struct workqueue_attrs' comments for detail.
 	 */
 	pool->attrs->no_numa = false;
+	pool->attrs->cluster = false;
 
 	if (worker_pool_assign_id(pool) < 0)
 		goto fail;
@@ -3495,7 +3531,8 @@ static struct pool_workqueue *alloc_unbound_pwq(struct workqueue_struct *wq,
 /**
  * wq_calc_node_cpumask - calculate a wq_attrs' cpumask for the specified node
  * @attrs: the wq_attrs of the default pwq of the target workqueue
- * @node: the target NUMA node
+ * @cluster: whether @node is a cluster index rather than a NUMA node
+ * @node: the target NUMA node or cluster
  * @cpu_going_down: if >= 0, the CPU to consider as offline
  * @cpumask: outarg, the resulting cpumask
  *
@@ -3506,7 +3543,7 @@ static struct pool_workqueue *alloc_unbound_pwq(struct workqueue_struct *wq,
  * If NUMA affinity is not enabled, @attrs->cpumask is always used.  If
  * enabled and @node has online CPUs requested by @attrs, the returned
  * cpumask is the intersection of the possible CPUs of @node and
- * @attrs->cpumask.
+ * @attrs->cpumask.  Clusters are handled the same way.
  *
  * The caller is responsible for ensuring that the cpumask of @node stays
  * stable.
@@ -3514,14 +3551,29 @@ static struct pool_workqueue *alloc_unbound_pwq(struct workqueue_struct *wq,
  * Return: %true if the resulting @cpumask is different from @attrs->cpumask,
  * %false if equal.
  */
-static bool wq_calc_node_cpumask(const struct workqueue_attrs *attrs, int node,
-				 int cpu_going_down, cpumask_t *cpumask)
+static bool wq_calc_node_cpumask(const struct workqueue_attrs *attrs,
+				 bool cluster, int node, int cpu_going_down,
+				 cpumask_t *cpumask)
 {
-	if (!wq_numa_enabled || attrs->no_numa)
-		goto use_dfl;
+	const struct cpumask *possible;
+
+	if (cluster) {
+		if (node >= wq_nr_clusters)
+			goto use_dfl;
 
-	/* does @node have any online CPUs @attrs wants? */
-	cpumask_and(cpumask, cpumask_of_node(node), attrs->cpumask);
+		possible = wq_cluster_possible_cpumask[node];
+		/* does @node have any online CPUs @attrs wants? */
+		cpumask_and(cpumask, possible, cpu_online_mask);
+		cpumask_and(cpumask, cpumask, attrs->cpumask);
+	} else {
+		if (!wq_numa_enabled || attrs->no_numa ||
+		    node >= nr_node_ids || !node_possible(node))
+			goto use_dfl;
+
+		possible = wq_numa_possible_cpumask[node];
+		/* does @node have any online CPUs @attrs wants? */
+		cpumask_and(cpumask, cpumask_of_node(node), attrs->cpumask);
+	}
 	if (cpu_going_down >= 0)
 		cpumask_clear_cpu(cpu_going_down, cpumask);
 
@@ -3529,7 +3581,7 @@ static bool wq_calc_node_cpumask(const struct workqueue_attrs *attrs, int node,
 		goto use_dfl;
 
 	/* yeap, return possible CPUs in @node that @attrs wants */
-	cpumask_and(cpumask, attrs->cpumask, wq_numa_possible_cpumask[node]);
+	cpumask_and(cpumask, attrs->cpumask, possible);
 	return !cpumask_equal(cpumask, attrs->cpumask);
 
 use_dfl:
@@ -3570,7 +3622,7 @@ static void apply_wqattrs_cleanup(struct apply_wqattrs_ctx *ctx)
 	if (ctx) {
 		int node;
 
-		for_each_node(node)
+		for (node = 0; node < wq_nr_pwq_slots(); node++)
 			put_pwq_unlocked(ctx->pwq_tbl[node]);
 		put_pwq_unlocked(ctx->dfl_pwq);
 
@@ -3591,8 +3643,8 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 
 	lockdep_assert_held(&wq_pool_mutex);
 
-	ctx = kzalloc(sizeof(*ctx) + nr_node_ids * sizeof(ctx->pwq_tbl[0]),
-		      GFP_KERNEL);
+	ctx = kzalloc(sizeof(*ctx) +
+		      wq_nr_pwq_slots() * sizeof(ctx->pwq_tbl[0]), GFP_KERNEL);
 
 	new_attrs = alloc_workqueue_attrs(GFP_KERNEL);
 	tmp_attrs = alloc_workqueue_attrs(GFP_KERNEL);
@@ -3625,8 +3677,14 @@ apply_wqattrs_prepare(struct workqueue_struct *wq,
 	if (!ctx->dfl_pwq)
 		goto out_free;
 
-	for_each_node(node) {
-		if (wq_calc_node_cpumask(new_attrs, node, -1, tmp_attrs->cpumask)) {
+	/*
+	 * Fill every slot, not only those of the current mode, so that a
+	 * lockless __queue_work() racing with a switch between NUMA and
+	 * cluster affinity always finds a valid pwq.
+	 */
+	for (node = 0; node < wq_nr_pwq_slots(); node++) {
+		if (wq_calc_node_cpumask(new_attrs, wq_attrs_cluster(new_attrs),
+					 node, -1, tmp_attrs->cpumask)) {
 			ctx->pwq_tbl[node] = alloc_unbound_pwq(wq, tmp_attrs);
 			if (!ctx->pwq_tbl[node])
 				goto out_free;
@@ -3663,7 +3721,7 @@ static void apply_wqattrs_commit(struct apply_wqattrs_ctx *ctx)
 	copy_workqueue_attrs(ctx->wq->unbound_attrs, ctx->attrs);
 
 	/* save the previous pwq and install the new one */
-	for_each_node(node)
+	for (node = 0; node < wq_nr_pwq_slots(); node++)
 		ctx->pwq_tbl[node] = numa_pwq_tbl_install(ctx->wq, node,
 							  ctx->pwq_tbl[node]);
 
@@ -3771,18 +3829,24 @@ int apply_workqueue_attrs(struct workqueue_struct *wq,
 static void wq_update_unbound_numa(struct workqueue_struct *wq, int cpu,
 				   bool online)
 {
-	int node = cpu_to_node(cpu);
+	int node;
 	int cpu_off = online ? -1 : cpu;
 	struct pool_workqueue *old_pwq = NULL, *pwq;
 	struct workqueue_attrs *target_attrs;
 	cpumask_t *cpumask;
+	bool cluster;
 
 	lockdep_assert_held(&wq_pool_mutex);
 
-	if (!wq_numa_enabled || !(wq->flags & WQ_UNBOUND) ||
-	    wq->unbound_attrs->no_numa)
+	if (!(wq->flags & WQ_UNBOUND))
 		return;
 
+	cluster = wq_attrs_cluster(wq->unbound_attrs);
+	if (!cluster && (!wq_numa_enabled || wq->unbound_attrs->no_numa))
+		return;
+
+	node = wq_cpu_pwq_slot(wq, cpu);
+
 	/*
 	 * We don't wanna alloc/free wq_attrs for each wq for each CPU.
 	 * Let's use a preallocated one.  The following buf is protected by
@@ -3800,7 +3864,8 @@ static void wq_update_unbound_numa(struct workqueue_struct *wq, int cpu,
 	 * and create a new one if they don't match.  If the target cpumask
 	 * equals the default pwq's, the default pwq should be used.
 	 */
-	if (wq_calc_node_cpumask(wq->dfl_pwq->pool->attrs, node, cpu_off, cpumask)) {
+	if (wq_calc_node_cpumask(wq->dfl_pwq->pool->attrs, cluster, node,
+				 cpu_off, cpumask)) {
 		if (cpumask_equal(cpumask, pwq->pool->attrs->cpumask))
 			return;
 	} else {
@@ -3905,7 +3970,7 @@ struct workqueue_struct *__alloc_workqueue_key(const char *fmt,
 
 	/* allocate wq and format name */
 	if (flags & WQ_UNBOUND)
-		tbl_size = nr_node_ids * sizeof(wq->numa_pwq_tbl[0]);
+		tbl_size = wq_nr_pwq_slots() * sizeof(wq->numa_pwq_tbl[0]);
 
 	wq = kzalloc(sizeof(*wq) + tbl_size, GFP_KERNEL);
 	if (!wq)
@@ -4070,7 +4135,7 @@ void destroy_workqueue(struct workqueue_struct *wq)
 		 * access numa_pwq_tbl[] and dfl_pwq to put the base refs.
 		 * @wq will be freed when the last pwq is released.
 		 */
-		for_each_node(node) {
+		for (node = 0; node < wq_nr_pwq_slots(); node++) {
 			pwq = rcu_access_pointer(wq->numa_pwq_tbl[node]);
 			RCU_INIT_POINTER(wq->numa_pwq_tbl[node], NULL);
 			put_pwq_unlocked(pwq);
@@ -4181,7 +4246,7 @@ bool workqueue_congested(int cpu, struct workqueue_struct *wq)
 	if (!(wq->flags & WQ_UNBOUND))
 		pwq = per_cpu_ptr(wq->cpu_pwqs, cpu);
 	else
-		pwq = unbound_pwq_by_node(wq, cpu_to_node(cpu));
+		pwq = unbound_pwq_by_node(wq, wq_cpu_pwq_slot(wq, cpu));
 
 	ret = !list_empty(&pwq->delayed_works);
 	rcu_read_unlock_sched();
@@ -5022,11 +5087,20 @@ static ssize_t wq_pool_ids_show(struct device *dev,
 	int node, written = 0;
 
 	rcu_read_lock_sched();
-	for_each_node(node) {
-		written += scnprintf(buf + written, PAGE_SIZE - written,
-				     "%s%d:%d", delim, node,
-				     unbound_pwq_by_node(wq, node)->pool->id);
-		delim = " ";
+	if (wq_attrs_cluster(wq->unbound_attrs)) {
+		for (node = 0; node < wq_nr_clusters; node++) {
+			written += scnprintf(buf + written, PAGE_SIZE - written,
+					"%sc%d:%d", delim, node,
+					unbound_pwq_by_node(wq, node)->pool->id);
+			delim = " ";
+		}
+	} else {
+		for_each_node(node) {
+			written += scnprintf(buf + written, PAGE_SIZE - written,
+					"%s%d:%d", delim, node,
+					unbound_pwq_by_node(wq, node)->pool->id);
+			delim = " ";
+		}
 	}
 	written += scnprintf(buf + written, PAGE_SIZE - written, "\n");
 	rcu_read_unlock_sched();
@@ -5163,11 +5237,52 @@ out_unlock:
 	return ret ?: count;
 }
 
+static ssize_t wq_cluster_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	int written;
+
+	mutex_lock(&wq->mutex);
+	written = scnprintf(buf, PAGE_SIZE, "%d\n",
+			    wq->unbound_attrs->cluster);
+	mutex_unlock(&wq->mutex);
+
+	return written;
+}
+
+static ssize_t wq_cluster_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int v, ret = -ENOMEM;
+
+	apply_wqattrs_lock();
+
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (!attrs)
+		goto out_unlock;
+
+	ret = -EINVAL;
+	if (sscanf(buf, "%d", &v) == 1 && (!v || wq_nr_clusters)) {
+		attrs->cluster = v;
+		ret = apply_workqueue_attrs_locked(wq, attrs);
+	}
+
+out_unlock:
+	apply_wqattrs_unlock();
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
 static struct device_attribute wq_sysfs_unbound_attrs[] = {
 	__ATTR(pool_ids, 0444, wq_pool_ids_show, NULL),
 	__ATTR(nice, 0644, wq_nice_show, wq_nice_store),
 	__ATTR(cpumask, 0644, wq_cpumask_show, wq_cpumask_store),
 	__ATTR(numa, 0644, wq_numa_show, wq_numa_store),
+	__ATTR(cluster, 0644, wq_cluster_show, wq_cluster_store),
 	__ATTR_NULL,
 };
 
@@ -5507,6 +5622,67 @@ static void __init wq_numa_init(void)
 	wq_numa_enabled = true;
 }
 
+/*
+ * Group the possible CPUs by topology_physical_package_id(), which is the
+ * cluster on arm64 and is what the energy model builds its groups from.
+ * The topology has been parsed by smp_prepare_cpus() at this point.
+ */
+static void __init wq_cluster_init(void)
+{
+	cpumask_var_t *tbl;
+	int *map;
+	int cpu, other, nr = 0;
+
+	map = kcalloc(nr_cpu_ids, sizeof(map[0]), GFP_KERNEL);
+	BUG_ON(!map);
+
+	for_each_possible_cpu(cpu) {
+		if (topology_physical_package_id(cpu) < 0) {
+			pr_info("workqueue: no cluster topology for cpu%d, cluster affinity disabled\n",
+				cpu);
+			kfree(map);
+			return;
+		}
+
+		map[cpu] = -1;
+		for_each_possible_cpu(other) {
+			if (other == cpu)
+				break;
+			if (topology_physical_package_id(other) ==
+			    topology_physical_package_id(cpu)) {
+				map[cpu] = map[other];
+				break;
+			}
+		}
+		if (map[cpu] < 0)
+			map[cpu] = nr++;
+	}
+
+	if (nr <= 1) {
+		kfree(map);
+		return;
+	}
+
+	if (!wq_update_unbound_numa_attrs_buf) {
+		wq_update_unbound_numa_attrs_buf =
+			alloc_workqueue_attrs(GFP_KERNEL);
+		BUG_ON(!wq_update_unbound_numa_attrs_buf);
+	}
+
+	tbl = kcalloc(nr, sizeof(tbl[0]), GFP_KERNEL);
+	BUG_ON(!tbl);
+
+	for (other = 0; other < nr; other++)
+		BUG_ON(!zalloc_cpumask_var(&tbl[other], GFP_KERNEL));
+
+	for_each_possible_cpu(cpu)
+		cpumask_set_cpu(cpu, tbl[map[cpu]]);
+
+	wq_cluster_possible_cpumask = tbl;
+	wq_cpu_cluster = map;
+	wq_nr_clusters = nr;
+}
+
 static int __init init_workqueues(void)
 {
 	int std_nice[NR_STD_WORKER_POOLS] = { 0, HIGHPRI_NICE_LEVEL };
@@ -5523,6 +5699,7 @@ static int __init init_workqueues(void)
 	hotcpu_notifier(workqueue_cpu_down_callback, CPU_PRI_WORKQUEUE_DOWN);
 
 	wq_numa_init();
+	wq_cluster_init();
 
 	/* initialize CPU pools */
 	for_each_possible_cpu(cpu) {
@@ -5559,6 +5736,7 @@ static int __init init_workqueues(void)
 
 		BUG_ON(!(attrs = alloc_workqueue_attrs(GFP_KERNEL)));
 		attrs->nice = std_nice[i];
+		attrs->cluster = wq_cluster_affinity;
 		unbound_std_wq_attrs[i] = attrs;
 
 		/*
@@ -92,8 +92,13 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 			ip += length;
 			break; /* EOF */
 		}
-		LZ4_WILDCOPY(ip, op, cpy);
-		ip -= (op - cpy);
+		if (LZ4_MEMCPY_MIN && length >= LZ4_MEMCPY_MIN) {
+			memcpy(op, ip, length);
+			ip += length;
+		} else {
+			LZ4_WILDCOPY(ip, op, cpy);
+			ip -= (op - cpy);
+		}
 		op = cpy;
 
 		/* get offset */
@@ -159,7 +164,12 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 				goto _output_error;
 			continue;
 		}
-		LZ4_SECURECOPY(ref, op, cpy);
+		/* a match further back than its length does not overlap */
+		if (LZ4_MEMCPY_MIN && cpy - op >= LZ4_MEMCPY_MIN &&
+		    op - ref >= cpy - op)
+			memcpy(op, ref, cpy - op);
+		else
+			LZ4_SECURECOPY(ref, op, cpy);
 		op = cpy; /* correction */
 	}
 	/* end of decoding */
@@ -218,8 +228,13 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 			op += length;
 			break;/* Necessarily EOF, due to parsing restrictions */
 		}
-		LZ4_WILDCOPY(ip, op, cpy);
-		ip -= (op - cpy);
+		if (LZ4_MEMCPY_MIN && length >= LZ4_MEMCPY_MIN) {
+			memcpy(op, ip, length);
+			ip += length;
+		} else {
+			LZ4_WILDCOPY(ip, op, cpy);
+			ip -= (op - cpy);
+		}
 		op = cpy;
 
 		/* get offset */
@@ -289,7 +304,12 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 				goto _output_error;
 			continue;
 		}
-		LZ4_SECURECOPY(ref, op, cpy);
+		/* a match further back than its length does not overlap */
+		if (LZ4_MEMCPY_MIN && cpy - op >= LZ4_MEMCPY_MIN &&
+		    op - ref >= cpy - op)
+			memcpy(op, ref, cpy - op);
+		else
+			LZ4_SECURECOPY(ref, op, cpy);
 		op = cpy; /* correction */
 	}
 	/* end of decoding */
@@ -144,6 +144,18 @@ typedef struct _U64_S { u64 v; } U64_S;
 
 #endif
 
+/*
+ * Runs at least this long are copied with memcpy() instead of the 8 byte
+ * wild copy loop. The arm64 memcpy() moves 16 bytes per load/store pair
+ * and unrolls to 64 bytes, which beats the loop on long literal runs and
+ * long matches. Zero disables it.
+ */
+#ifdef CONFIG_ARM64
+#define LZ4_MEMCPY_MIN	32
+#else
+#define LZ4_MEMCPY_MIN	0
+#endif
+
 #define LZ4_WILDCOPY(s, d, e)		\
 	do {				\
 		LZ4_COPYPACKET(s, d);	\
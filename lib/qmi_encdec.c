@@ -286,14 +286,61 @@ EXPORT_SYMBOL(qmi_kernel_encode);
 static int qmi_encode_basic_elem(void *buf_dst, void *buf_src,
 				 uint32_t elem_len, uint32_t elem_size)
 {
-	uint32_t i, rc = 0;
+	uint32_t rc = elem_len * elem_size;
 
-	for (i = 0; i < elem_len; i++) {
-		QMI_ENCDEC_ENCODE_N_BYTES(buf_dst, buf_src, elem_size);
-		rc += elem_size;
+	/* The elements are contiguous on both sides, copy them at once */
+	memcpy(buf_dst, buf_src, rc);
+	return rc;
+}
+
+/**
+ * qmi_struct_is_flat() - Check if a struct has the same layout on the wire
+ * @ei_array: Struct info array describing the struct.
+ * @elem_size: Size of a single instance of the struct.
+ *
+ * @return: true if the struct only holds fixed size elements of basic or
+ *          flat struct type, laid out back to back without padding.
+ *
+ * Elements of nested structures are encoded without any TLV or length
+ * information, so the wire format of such a struct is byte for byte its
+ * C layout and an array of them can be copied in one go instead of being
+ * encoded or decoded element by element.
+ */
+static bool qmi_struct_is_flat(struct elem_info *ei_array, uint32_t elem_size)
+{
+	struct elem_info *temp_ei;
+	uint32_t offset = 0;
+
+	if (!ei_array)
+		return false;
+
+	for (temp_ei = ei_array; temp_ei->data_type != QMI_EOTI; temp_ei++) {
+		if (temp_ei->is_array == VAR_LEN_ARRAY ||
+		    temp_ei->offset != offset)
+			return false;
+
+		switch (temp_ei->data_type) {
+		case QMI_UNSIGNED_1_BYTE:
+		case QMI_UNSIGNED_2_BYTE:
+		case QMI_UNSIGNED_4_BYTE:
+		case QMI_UNSIGNED_8_BYTE:
+		case QMI_SIGNED_2_BYTE_ENUM:
+		case QMI_SIGNED_4_BYTE_ENUM:
+			break;
+		case QMI_STRUCT:
+			if (!qmi_struct_is_flat(temp_ei->ei_array,
+						temp_ei->elem_size))
+				return false;
+			break;
+		default:
+			return false;
+		}
+
+		offset += temp_ei->elem_size * (temp_ei->is_array == NO_ARRAY ?
+						1 : temp_ei->elem_len);
 	}
 
-	return rc;
+	return offset == elem_size;
 }
 
 /**
@@ -322,6 +369,12 @@ static int qmi_encode_struct_elem(struct elem_info *ei_array,
 	int i, rc, encoded_bytes = 0;
 	struct elem_info *temp_ei = ei_array;
 
+	if (elem_len * temp_ei->elem_size + TLV_LEN_SIZE + TLV_TYPE_SIZE <=
+	    out_buf_len &&
+	    qmi_struct_is_flat(temp_ei->ei_array, temp_ei->elem_size))
+		return qmi_encode_basic_elem(buf_dst, buf_src, elem_len,
+					     temp_ei->elem_size);
+
 	for (i = 0; i < elem_len; i++) {
 		rc = _qmi_kernel_encode(temp_ei->ei_array, buf_dst, buf_src,
 					(out_buf_len - encoded_bytes),
@@ -617,13 +670,9 @@ EXPORT_SYMBOL(qmi_kernel_decode);
 static int qmi_decode_basic_elem(void *buf_dst, void *buf_src,
 				 uint32_t elem_len, uint32_t elem_size)
 {
-	uint32_t i, rc = 0;
-
-	for (i = 0; i < elem_len; i++) {
-		QMI_ENCDEC_DECODE_N_BYTES(buf_dst, buf_src, elem_size);
-		rc += elem_size;
-	}
+	uint32_t rc = elem_len * elem_size;
 
+	memcpy(buf_dst, buf_src, rc);
 	return rc;
 }
 
@@ -653,6 +702,14 @@ static int qmi_decode_struct_elem(struct elem_info *ei_array, void *buf_dst,
 	int i, rc, decoded_bytes = 0;
 	struct elem_info *temp_ei = ei_array;
 
+	if (elem_len * temp_ei->elem_size <= tlv_len &&
+	    qmi_struct_is_flat(temp_ei->ei_array, temp_ei->elem_size)) {
+		decoded_bytes = qmi_decode_basic_elem(buf_dst, buf_src,
+					elem_len, temp_ei->elem_size);
+		i = elem_len;
+		goto check;
+	}
+
 	for (i = 0; i < elem_len && decoded_bytes < tlv_len; i++) {
 		rc = _qmi_kernel_decode(temp_ei->ei_array, buf_dst, buf_src,
 					(tlv_len - decoded_bytes), dec_level);
@@ -663,6 +720,7 @@ static int qmi_decode_struct_elem(struct elem_info *ei_array, void *buf_dst,
 		decoded_bytes += rc;
 	}
 
+check:
 	if ((dec_level <= 2 && decoded_bytes != tlv_len) ||
 	    (dec_level > 2 && (i < elem_len || decoded_bytes > tlv_len))) {
 		pr_err("%s: Fault in decoding: dl(%d), db(%d), tl(%d), i(%d), el(%d)\n",
@@ -79,6 +79,12 @@ static unsigned long cma_bitmap_pages_to_bits(const struct cma *cma,
 	return ALIGN(pages, 1UL << cma->order_per_bit) >> cma->order_per_bit;
 }
 
+/* First pfn of the clean segment, see cma_set_clean_size() */
+static unsigned long cma_clean_base_pfn(const struct cma *cma)
+{
+	return cma->base_pfn + cma->count - cma->clean_count;
+}
+
 static void cma_clear_bitmap(struct cma *cma, unsigned long pfn,
 			     unsigned int count)
 {
@@ -92,6 +98,24 @@ static void cma_clear_bitmap(struct cma *cma, unsigned long pfn,
 	mutex_unlock(&cma->lock);
 }
 
+/*
+ * Pageblocks of the clean segment never reach the buddy allocator, so no
+ * movable page can end up there. They stay refcounted, just like pages
+ * returned by alloc_contig_range().
+ */
+static void __init cma_keep_clean_pageblock(struct page *page)
+{
+	unsigned i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		init_page_count(p);
+	} while (++p, --i);
+
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+}
+
 static int __init cma_activate_area(struct cma *cma)
 {
 	int bitmap_size = BITS_TO_LONGS(cma_bitmap_maxno(cma)) * sizeof(long);
@@ -124,9 +148,19 @@ static int __init cma_activate_area(struct cma *cma)
 			if (page_zone(pfn_to_page(pfn)) != zone)
 				goto err;
 		}
-		init_cma_reserved_pageblock(pfn_to_page(base_pfn));
+		if (base_pfn >= cma_clean_base_pfn(cma))
+			cma_keep_clean_pageblock(pfn_to_page(base_pfn));
+		else
+			init_cma_reserved_pageblock(pfn_to_page(base_pfn));
 	} while (--i);
 
+	if (cma->clean_count) {
+		phys_addr_t clean = PFN_PHYS(cma_clean_base_pfn(cma));
+
+		pr_info("Kept %lu KiB at %pa clean for migration-free allocations\n",
+			cma->clean_count << (PAGE_SHIFT - 10), &clean);
+	}
+
 	mutex_init(&cma->lock);
 
 #ifdef CONFIG_CMA_DEBUGFS
@@ -212,6 +246,26 @@ int __init cma_init_reserved_mem(phys_addr_t base, phys_addr_t size,
 	return 0;
 }
 
+/**
+ * cma_set_clean_size() - keep part of a contiguous area free of movable pages
+ * @cma:  Contiguous memory region created by cma_init_reserved_mem().
+ * @size: Size of the clean segment (in bytes).
+ *
+ * The top @size bytes of the area, rounded up to whole pageblocks, are
+ * kept away from the page allocator so that cma_alloc() can serve the
+ * allocations that fit in there without migrating anything. That memory
+ * is not available to the rest of the system, so size it to the typical
+ * allocation of the area's user rather than to the whole area.
+ *
+ * Must be called before the area is activated at core_initcall time.
+ */
+void __init cma_set_clean_size(struct cma *cma, phys_addr_t size)
+{
+	unsigned long pages = ALIGN(size >> PAGE_SHIFT, pageblock_nr_pages);
+
+	cma->clean_count = min(pages, cma->count);
+}
+
 /**
  * cma_declare_contiguous() - reserve custom contiguous area
  * @base: Base address of the reserved area optional, use 0 for any
@@ -372,6 +426,32 @@ err:
 	return ret;
 }
 
+/*
+ * The clean segment holds no movable pages, so taking a range of it is
+ * just a matter of marking the bitmap.
+ */
+static struct page *cma_alloc_clean(struct cma *cma,
+				    unsigned long bitmap_count,
+				    unsigned long mask, unsigned long offset)
+{
+	unsigned long bitmap_maxno = cma_bitmap_maxno(cma);
+	unsigned long start, bitmap_no;
+
+	start = (cma->count - cma->clean_count) >> cma->order_per_bit;
+
+	mutex_lock(&cma->lock);
+	bitmap_no = bitmap_find_next_zero_area_off(cma->bitmap, bitmap_maxno,
+				start, bitmap_count, mask, offset);
+	if (bitmap_no >= bitmap_maxno) {
+		mutex_unlock(&cma->lock);
+		return NULL;
+	}
+	bitmap_set(cma->bitmap, bitmap_no, bitmap_count);
+	mutex_unlock(&cma->lock);
+
+	return pfn_to_page(cma->base_pfn + (bitmap_no << cma->order_per_bit));
+}
+
 /**
  * cma_alloc() - allocate pages from contiguous area
  * @cma:   Contiguous memory region for which the allocation is performed.
@@ -410,6 +490,18 @@ struct page *cma_alloc(struct cma *cma, size_t count, unsigned int align)
 	if (bitmap_count > bitmap_maxno)
 		return NULL;
 
+	if (cma->clean_count) {
+		page = cma_alloc_clean(cma, bitmap_count, mask, offset);
+		if (page) {
+			pfn = page_to_pfn(page);
+			goto out;
+		}
+		/* The rest of the area is left to the migrating path */
+		bitmap_maxno -= cma->clean_count >> cma->order_per_bit;
+		if (bitmap_count > bitmap_maxno)
+			goto out;
+	}
+
 	for (;;) {
 		mutex_lock(&cma->lock);
 		bitmap_no = bitmap_find_next_zero_area_off(cma->bitmap,
@@ -464,6 +556,7 @@ struct page *cma_alloc(struct cma *cma, size_t count, unsigned int align)
 		start = bitmap_no + mask + 1;
 	}
 
+out:
 	trace_cma_alloc(pfn, page, count, align);
 
 	pr_debug("%s(): returned %p\n", __func__, page);
@@ -496,7 +589,9 @@ bool cma_release(struct cma *cma, const struct page *pages, unsigned int count)
 
 	VM_BUG_ON(pfn + count > cma->base_pfn + cma->count);
 
-	free_contig_range(pfn, count);
+	/* Pages of the clean segment stay out of the buddy allocator */
+	if (pfn < cma_clean_base_pfn(cma))
+		free_contig_range(pfn, count);
 	cma_clear_bitmap(cma, pfn, count);
 	trace_cma_release(pfn, pages, count);
 
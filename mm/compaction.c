@@ -20,6 +20,8 @@
 #include <linux/kthread.h>
 #include <linux/freezer.h>
 #include <linux/page_owner.h>
+#include <linux/simple_lmk.h>
+#include <linux/timer.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -1289,6 +1291,18 @@ static inline bool is_via_compact_memory(int order)
 	return order == -1;
 }
 
+/* Number of free blocks of @order that the zone could hand out right now */
+static unsigned long zone_free_blocks(struct zone *zone, int order)
+{
+	unsigned long blocks = 0;
+	int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		blocks += zone->free_area[o].nr_free << (o - order);
+
+	return blocks;
+}
+
 static int __compact_finished(struct zone *zone, struct compact_control *cc,
 			    const int migratetype)
 {
@@ -1318,6 +1332,13 @@ static int __compact_finished(struct zone *zone, struct compact_control *cc,
 	if (is_via_compact_memory(cc->order))
 		return COMPACT_CONTINUE;
 
+	/* Proactive compaction: run until the free block target is met */
+	if (cc->proactive_target) {
+		if (zone_free_blocks(zone, cc->order) >= cc->proactive_target)
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/* Compaction run is not finished if the watermark is not met */
 	watermark = low_wmark_pages(zone);
 
@@ -1430,6 +1451,26 @@ unsigned long compaction_suitable(struct zone *zone, int order,
 	return ret;
 }
 
+/*
+ * Proactive compaction only runs while the zone has comfortably more free
+ * memory than the high watermark, so that it never competes with reclaim
+ * for the pages migration needs.
+ */
+static unsigned long proactive_compaction_suitable(struct zone *zone,
+					int order, unsigned long target)
+{
+	unsigned long watermark;
+
+	if (zone_free_blocks(zone, order) >= target)
+		return COMPACT_PARTIAL;
+
+	watermark = high_wmark_pages(zone) + (2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return COMPACT_SKIPPED;
+
+	return COMPACT_CONTINUE;
+}
+
 static int compact_zone(struct zone *zone, struct compact_control *cc)
 {
 	int ret;
@@ -1438,7 +1479,11 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	const int migratetype = gfpflags_to_migratetype(cc->gfp_mask);
 	const bool sync = cc->mode != MIGRATE_ASYNC;
 
-	ret = compaction_suitable(zone, cc->order, cc->alloc_flags,
+	if (cc->proactive_target)
+		ret = proactive_compaction_suitable(zone, cc->order,
+						    cc->proactive_target);
+	else
+		ret = compaction_suitable(zone, cc->order, cc->alloc_flags,
 							cc->classzone_idx);
 	switch (ret) {
 	case COMPACT_PARTIAL:
@@ -1628,6 +1673,7 @@ unsigned long try_to_compact_pages(gfp_t gfp_mask, unsigned int order,
 	struct zone *zone;
 	int rc = COMPACT_DEFERRED;
 	int all_zones_contended = COMPACT_CONTENDED_LOCK; /* init for &= op */
+	u64 stall_start;
 
 	*contended = COMPACT_CONTENDED_NONE;
 
@@ -1636,6 +1682,7 @@ unsigned long try_to_compact_pages(gfp_t gfp_mask, unsigned int order,
 		return COMPACT_SKIPPED;
 
 	trace_mm_compaction_try_to_compact_pages(order, gfp_mask, mode);
+	stall_start = simple_lmk_stall_begin();
 
 	/* Compact each zone in the list */
 	for_each_zone_zonelist_nodemask(zone, z, ac->zonelist, ac->high_zoneidx,
@@ -1718,6 +1765,7 @@ break_loop:
 	if (rc > COMPACT_SKIPPED && all_zones_contended)
 		*contended = COMPACT_CONTENDED_LOCK;
 
+	simple_lmk_stall_end(stall_start);
 	return rc;
 }
 
@@ -1849,9 +1897,129 @@ void compaction_unregister_node(struct node *node)
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
 
+/*
+ * Proactive compaction: every sysctl_compaction_proactive_ms, kcompactd
+ * checks that each zone holds sysctl_compaction_order_target[i] free blocks
+ * of order COMPACT_PROACTIVE_MIN_ORDER + i. A zone short of its target is
+ * compacted only while its unusable free space index for that order keeps
+ * rising, i.e. while allocations are fragmenting it, so that the same zone
+ * is not rescanned over and over when compaction cannot make progress.
+ */
+int sysctl_compaction_proactive_ms = 500;
+int sysctl_compaction_order_target[COMPACT_PROACTIVE_ORDERS] = { 32, 16, 8 };
+
+static struct timer_list proactive_timer;
+
+static void proactive_timer_arm(void)
+{
+	if (sysctl_compaction_proactive_ms)
+		mod_timer(&proactive_timer, jiffies +
+			  msecs_to_jiffies(sysctl_compaction_proactive_ms));
+	else
+		del_timer(&proactive_timer);
+}
+
+static void proactive_timer_fn(unsigned long data)
+{
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		pgdat->kcompactd_proactive = true;
+		wake_up_interruptible(&pgdat->kcompactd_wait);
+	}
+
+	proactive_timer_arm();
+}
+
+int sysctl_compaction_proactive_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	proactive_timer_arm();
+	return 0;
+}
+
+/* Share of free memory, in thousandths, held in blocks smaller than order */
+static int zone_unusable_index(struct zone *zone, int order)
+{
+	unsigned long free = zone_page_state(zone, NR_FREE_PAGES);
+	unsigned long usable = zone_free_blocks(zone, order) << order;
+
+	if (!free)
+		return 1000;
+	if (usable > free)
+		usable = free;
+
+	return ((free - usable) * 1000) / free;
+}
+
+static void kcompactd_do_proactive(pg_data_t *pgdat)
+{
+	int zoneid;
+	int i;
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		/* Highest order first, it also produces the lower ones */
+		for (i = COMPACT_PROACTIVE_ORDERS - 1; i >= 0; i--) {
+			int order = COMPACT_PROACTIVE_MIN_ORDER + i;
+			int target = sysctl_compaction_order_target[i];
+			int index, last;
+			struct compact_control cc = {
+				.order = order,
+				.proactive_target = target,
+				.classzone_idx = zoneid,
+				.mode = MIGRATE_SYNC_LIGHT,
+			};
+
+			if (target <= 0)
+				continue;
+
+			index = zone_unusable_index(zone, order);
+			last = zone->compact_proactive_index[i];
+			zone->compact_proactive_index[i] = index;
+
+			if (index <= last)
+				continue;
+
+			if (proactive_compaction_suitable(zone, order,
+						target) != COMPACT_CONTINUE)
+				continue;
+
+			if (kthread_should_stop())
+				return;
+
+			count_vm_event(KCOMPACTD_PROACTIVE);
+			cc.zone = zone;
+			INIT_LIST_HEAD(&cc.freepages);
+			INIT_LIST_HEAD(&cc.migratepages);
+			compact_zone(zone, &cc);
+
+			VM_BUG_ON(!list_empty(&cc.freepages));
+			VM_BUG_ON(!list_empty(&cc.migratepages));
+
+			/* Judge the next trend against the compacted zone */
+			zone->compact_proactive_index[i] =
+				zone_unusable_index(zone, order);
+		}
+	}
+}
+
 static inline bool kcompactd_work_requested(pg_data_t *pgdat)
 {
-	return pgdat->kcompactd_max_order > 0 || kthread_should_stop();
+	return pgdat->kcompactd_max_order > 0 || pgdat->kcompactd_proactive ||
+		kthread_should_stop();
 }
 
 static bool kcompactd_node_suitable(pg_data_t *pgdat)
@@ -1992,7 +2160,13 @@ static int kcompactd(void *p)
 		wait_event_freezable(pgdat->kcompactd_wait,
 				kcompactd_work_requested(pgdat));
 
-		kcompactd_do_work(pgdat);
+		if (pgdat->kcompactd_proactive) {
+			pgdat->kcompactd_proactive = false;
+			kcompactd_do_proactive(pgdat);
+		}
+
+		if (pgdat->kcompactd_max_order > 0)
+			kcompactd_do_work(pgdat);
 	}
 
 	return 0;
@@ -2066,6 +2240,9 @@ static int __init kcompactd_init(void)
 	for_each_node_state(nid, N_MEMORY)
 		kcompactd_run(nid);
 	hotcpu_notifier(cpu_callback, 0);
+
+	setup_deferrable_timer(&proactive_timer, proactive_timer_fn, 0);
+	proactive_timer_arm();
 	return 0;
 }
 subsys_initcall(kcompactd_init)
@@ -1466,6 +1466,7 @@ int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 		 pmd_t *pmd, unsigned long addr)
 {
 	pmd_t orig_pmd;
+	pgtable_t pgtable;
 	spinlock_t *ptl;
 
 	if (__pmd_trans_huge_lock(pmd, vma, &ptl) != 1)
@@ -1484,9 +1485,15 @@ int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 		if (is_huge_zero_pmd(orig_pmd))
 			put_huge_zero_page();
 	} else if (is_huge_zero_pmd(orig_pmd)) {
-		pte_free(tlb->mm, pgtable_trans_huge_withdraw(tlb->mm, pmd));
+		pgtable = pgtable_trans_huge_withdraw(tlb->mm, pmd);
 		atomic_long_dec(&tlb->mm->nr_ptes);
 		spin_unlock(ptl);
+		/*
+		 * Speculative faults walk the page tables without mmap_sem,
+		 * so the deposited table goes through the RCU table freeing
+		 * of the mmu_gather like any other.
+		 */
+		pte_free_tlb(tlb, pgtable, addr);
 		put_huge_zero_page();
 	} else {
 		struct page *page = pmd_page(orig_pmd);
@@ -1494,9 +1501,10 @@ int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
 		VM_BUG_ON_PAGE(page_mapcount(page) < 0, page);
 		add_mm_counter(tlb->mm, MM_ANONPAGES, -HPAGE_PMD_NR);
 		VM_BUG_ON_PAGE(!PageHead(page), page);
-		pte_free(tlb->mm, pgtable_trans_huge_withdraw(tlb->mm, pmd));
+		pgtable = pgtable_trans_huge_withdraw(tlb->mm, pmd);
 		atomic_long_dec(&tlb->mm->nr_ptes);
 		spin_unlock(ptl);
+		pte_free_tlb(tlb, pgtable, addr);
 		tlb_remove_page(tlb, page);
 	}
 	return 1;
@@ -2603,6 +2611,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 		goto out;
 
 	anon_vma_lock_write(vma->anon_vma);
+	vm_write_begin(vma);
 
 	pte = pte_offset_map(pmd, address);
 	pte_ptl = pte_lockptr(mm, pmd);
@@ -2636,6 +2645,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 		 */
 		pmd_populate(mm, pmd, pmd_pgtable(_pmd));
 		spin_unlock(pmd_ptl);
+		vm_write_end(vma);
 		anon_vma_unlock_write(vma->anon_vma);
 		goto out;
 	}
@@ -2670,6 +2680,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 	set_pmd_at(mm, address, pmd, _pmd);
 	update_mmu_cache_pmd(vma, address, pmd);
 	spin_unlock(pmd_ptl);
+	vm_write_end(vma);
 
 	*hpage = NULL;
 
@@ -2451,6 +2451,18 @@ int __memcg_kmem_charge(struct page *page, gfp_t gfp, int order)
 	return ret;
 }
 
+int __memcg_kmem_charge_mm(struct page *page, gfp_t gfp, int order,
+			   struct mm_struct *mm)
+{
+	struct mem_cgroup *memcg;
+	int ret;
+
+	memcg = get_mem_cgroup_from_mm(mm);
+	ret = __memcg_kmem_charge_memcg(page, gfp, order, memcg);
+	css_put(&memcg->css);
+	return ret;
+}
+
 void __memcg_kmem_uncharge(struct page *page, int order)
 {
 	struct mem_cgroup *memcg = page->mem_cgroup;
@@ -2566,8 +2566,8 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
 	page = lookup_swap_cache(entry);
 	if (!page) {
-		page = swapin_readahead(entry,
-					GFP_HIGHUSER_MOVABLE, vma, address);
+		page = swap_vma_readahead(entry, GFP_HIGHUSER_MOVABLE,
+					  vma, address, pmd);
 		if (!page) {
 			/*
 			 * Back out if somebody else faulted in this pte
@@ -2888,10 +2888,80 @@ void do_set_pte(struct vm_area_struct *vma, unsigned long address,
 static unsigned long fault_around_bytes __read_mostly =
 	rounddown_pow_of_two(4096);
 
+/*
+ * Code in executable file mappings (APK, OAT, shared libraries) is read
+ * in runs, so fault it in a naturally aligned window at a time even
+ * though fault-around is off for everything else.
+ */
+static unsigned long fault_around_exec_bytes __read_mostly =
+	rounddown_pow_of_two(65536);
+
+static unsigned long vma_fault_around_bytes(struct vm_area_struct *vma)
+{
+	if (vma->vm_file && (vma->vm_flags & VM_EXEC) &&
+	    !(vma->vm_flags & VM_WRITE))
+		return READ_ONCE(fault_around_exec_bytes);
+
+	return READ_ONCE(fault_around_bytes);
+}
+
+/* Ceiling for windows grown by vma_fault_around_pages(). */
+static unsigned long fault_around_max_bytes __read_mostly =
+	rounddown_pow_of_two(65536);
+
+/*
+ * A vma starts out with the vma_fault_around_bytes() window, which then
+ * follows how the vma is accessed.  A fault past the previous one but no
+ * further than a window beyond it means the access stream ran through the
+ * pages mapped ahead, so the window doubles up to fault_around_max_bytes.
+ * A fault anywhere else means the pages mapped ahead of the previous fault
+ * were not what was needed: they are accounted as fault_around_unused and
+ * the window halves.
+ *
+ * The state is updated without locking, like f_ra.mmap_miss, so racing
+ * faults can only make the window a bit off.
+ */
+static unsigned long vma_fault_around_pages(struct vm_area_struct *vma,
+					    pgoff_t pgoff)
+{
+	unsigned long max_bytes = READ_ONCE(fault_around_max_bytes);
+	unsigned long nr_pages = READ_ONCE(vma->vm_fault_around_pages);
+	pgoff_t last = READ_ONCE(vma->vm_fault_around_last);
+	pgoff_t next = READ_ONCE(vma->vm_fault_around_next);
+
+	if (!nr_pages)
+		return vma_fault_around_bytes(vma) >> PAGE_SHIFT;
+	if (pgoff == last)
+		return nr_pages;
+
+	if (pgoff > last && pgoff < next + nr_pages) {
+		if (nr_pages < max_bytes >> PAGE_SHIFT)
+			nr_pages <<= 1;
+	} else {
+		count_vm_events(FAULT_AROUND_UNUSED,
+				READ_ONCE(vma->vm_fault_around_ahead));
+		if (nr_pages > 1)
+			nr_pages >>= 1;
+	}
+	return nr_pages;
+}
+
+static void vma_fault_around_update(struct vm_area_struct *vma,
+		unsigned long address, pgoff_t pgoff, unsigned long nr_pages,
+		unsigned long ahead)
+{
+	unsigned long off = (address >> PAGE_SHIFT) & (nr_pages - 1);
+
+	WRITE_ONCE(vma->vm_fault_around_pages, nr_pages);
+	WRITE_ONCE(vma->vm_fault_around_ahead, ahead);
+	WRITE_ONCE(vma->vm_fault_around_last, pgoff);
+	WRITE_ONCE(vma->vm_fault_around_next, pgoff + nr_pages - off);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static int fault_around_bytes_get(void *data, u64 *val)
 {
-	*val = fault_around_bytes;
+	*val = *(unsigned long *)data;
 	return 0;
 }
 
@@ -2902,12 +2972,14 @@ static int fault_around_bytes_get(void *data, u64 *val)
  */
 static int fault_around_bytes_set(void *data, u64 val)
 {
+	unsigned long *bytes = data;
+
 	if (val / PAGE_SIZE > PTRS_PER_PTE)
 		return -EINVAL;
 	if (val > PAGE_SIZE)
-		fault_around_bytes = rounddown_pow_of_two(val);
+		*bytes = rounddown_pow_of_two(val);
 	else
-		fault_around_bytes = PAGE_SIZE; /* rounddown_pow_of_two(0) is undefined */
+		*bytes = PAGE_SIZE; /* rounddown_pow_of_two(0) is undefined */
 	return 0;
 }
 DEFINE_SIMPLE_ATTRIBUTE(fault_around_bytes_fops,
@@ -2917,15 +2989,34 @@ static int __init fault_around_debugfs(void)
 {
 	void *ret;
 
-	ret = debugfs_create_file("fault_around_bytes", 0644, NULL, NULL,
-			&fault_around_bytes_fops);
+	ret = debugfs_create_file("fault_around_bytes", 0644, NULL,
+			&fault_around_bytes, &fault_around_bytes_fops);
 	if (!ret)
 		pr_warn("Failed to create fault_around_bytes in debugfs");
+
+	ret = debugfs_create_file("fault_around_exec_bytes", 0644, NULL,
+			&fault_around_exec_bytes, &fault_around_bytes_fops);
+	if (!ret)
+		pr_warn("Failed to create fault_around_exec_bytes in debugfs");
+
+	ret = debugfs_create_file("fault_around_max_bytes", 0644, NULL,
+			&fault_around_max_bytes, &fault_around_bytes_fops);
+	if (!ret)
+		pr_warn("Failed to create fault_around_max_bytes in debugfs");
 	return 0;
 }
 late_initcall(fault_around_debugfs);
 #endif
 
+static unsigned long count_pte_none(pte_t *pte, unsigned long nr)
+{
+	unsigned long none = 0;
+
+	while (nr--)
+		none += pte_none(*pte++);
+	return none;
+}
+
 /*
  * do_fault_around() tries to map few pages around the fault address. The hope
  * is that the pages will be needed soon and this will lower the number of
@@ -2941,23 +3032,26 @@ late_initcall(fault_around_debugfs);
  * This function doesn't cross the VMA boundaries, in order to call map_pages()
  * only once.
  *
- * fault_around_pages() defines how many pages we'll try to map.
- * do_fault_around() expects it to return a power of two less than or equal to
- * PTRS_PER_PTE.
+ * nr_pages, from vma_fault_around_pages(), defines how many pages we'll try
+ * to map. do_fault_around() expects it to be a power of two less than or
+ * equal to PTRS_PER_PTE.
  *
  * The virtual address of the area that we map is naturally aligned to the
  * fault_around_pages() value (and therefore to page order).  This way it's
  * easier to guarantee that we don't cross page table boundaries.
+ *
+ * Returns the number of pages mapped ahead of the fault address.
  */
-static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
-		pte_t *pte, pgoff_t pgoff, unsigned int flags)
+static unsigned long do_fault_around(struct vm_area_struct *vma,
+		unsigned long address, pte_t *pte, pgoff_t pgoff,
+		unsigned int flags, unsigned long nr_pages)
 {
-	unsigned long start_addr, nr_pages, mask;
-	pgoff_t max_pgoff;
+	unsigned long start_addr, mask, mapped, ahead;
+	pgoff_t max_pgoff, fault_pgoff = pgoff;
+	pte_t *fault_pte = pte;
 	struct vm_fault vmf;
 	int off;
 
-	nr_pages = READ_ONCE(fault_around_bytes) >> PAGE_SHIFT;
 	mask = ~(nr_pages * PAGE_SIZE - 1) & PAGE_MASK;
 
 	start_addr = max(address & mask, vma->vm_start);
@@ -2977,13 +3071,16 @@ static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
 	/* Check if it makes any sense to call ->map_pages */
 	while (!pte_none(*pte)) {
 		if (++pgoff > max_pgoff)
-			return;
+			return 0;
 		start_addr += PAGE_SIZE;
 		if (start_addr >= vma->vm_end)
-			return;
+			return 0;
 		pte++;
 	}
 
+	mapped = count_pte_none(pte, max_pgoff - pgoff + 1);
+	ahead = count_pte_none(fault_pte + 1, max_pgoff - fault_pgoff);
+
 	vmf.virtual_address = (void __user *) start_addr;
 	vmf.pte = pte;
 	vmf.pgoff = pgoff;
@@ -2991,6 +3088,14 @@ static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
 	vmf.flags = flags;
 	vmf.gfp_mask = __get_fault_gfp_mask(vma);
 	vma->vm_ops->map_pages(vma, &vmf);
+
+	mapped -= count_pte_none(pte, max_pgoff - pgoff + 1);
+	ahead -= count_pte_none(fault_pte + 1, max_pgoff - fault_pgoff);
+	/* The faulting page itself is not fault-around's doing */
+	if (mapped && !pte_none(*fault_pte))
+		mapped--;
+	count_vm_events(FAULT_AROUND_MAPPED, mapped);
+	return ahead;
 }
 
 static int do_read_fault(struct mm_struct *mm, struct vm_area_struct *vma,
@@ -3001,18 +3106,24 @@ static int do_read_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	spinlock_t *ptl;
 	pte_t *pte;
 	int ret = 0;
+	unsigned long nr_pages = vma_fault_around_pages(vma, pgoff);
+	unsigned long ahead;
 
 	/*
 	 * Let's call ->map_pages() first and use ->fault() as fallback
 	 * if page by the offset is not ready to be mapped (cold cache or
 	 * something).
 	 */
-	if (vma->vm_ops->map_pages && fault_around_bytes >> PAGE_SHIFT > 1) {
+	if (vma->vm_ops->map_pages && nr_pages > 1) {
 		pte = pte_offset_map_lock(mm, pmd, address, &ptl);
-		do_fault_around(vma, address, pte, pgoff, flags);
+		ahead = do_fault_around(vma, address, pte, pgoff, flags,
+					nr_pages);
+		vma_fault_around_update(vma, address, pgoff, nr_pages, ahead);
 		if (!pte_same(*pte, orig_pte))
 			goto unlock_out;
 		pte_unmap_unlock(pte, ptl);
+	} else {
+		vma_fault_around_update(vma, address, pgoff, nr_pages, 0);
 	}
 
 	ret = __do_fault(vma, address, pgoff, flags, NULL, &fault_page);
@@ -3524,6 +3635,205 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 }
 EXPORT_SYMBOL_GPL(handle_mm_fault);
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Look up the vma covering @address without mmap_sem.  A concurrent
+ * rebalance of the rb-tree can at worst make us miss the vma, in which
+ * case the caller falls back to the locked path.  A vma found here stays
+ * allocated until rcu_read_unlock(), see free_vma().
+ */
+static struct vm_area_struct *find_vma_rcu(struct mm_struct *mm,
+					   unsigned long address)
+{
+	struct rb_node *node = READ_ONCE(mm->mm_rb.rb_node);
+
+	while (node) {
+		struct vm_area_struct *vma;
+
+		vma = rb_entry(node, struct vm_area_struct, vm_rb);
+		if (address >= READ_ONCE(vma->vm_end))
+			node = READ_ONCE(node->rb_right);
+		else if (address < READ_ONCE(vma->vm_start))
+			node = READ_ONCE(node->rb_left);
+		else
+			return vma;
+	}
+	return NULL;
+}
+
+/*
+ * Only private anonymous vmas that already have an anon_vma are handled
+ * speculatively, everything else needs mmap_sem anyway.  On success the
+ * sampled sequence is returned in @seq.
+ */
+static bool spf_vma_suitable(struct vm_area_struct *vma,
+			     unsigned long address, unsigned long vm_flags,
+			     unsigned int *seq)
+{
+	*seq = raw_read_seqcount(&vma->vm_sequence);
+	if (*seq & 1)
+		return false;
+
+	if (address < vma->vm_start || address >= vma->vm_end)
+		return false;
+	if (!(vma->vm_flags & vm_flags))
+		return false;
+	if (vma->vm_ops || !vma->anon_vma || vma_policy(vma))
+		return false;
+	if (vma->vm_flags & (VM_SHARED | VM_HUGETLB | VM_PFNMAP | VM_MIXEDMAP))
+		return false;
+	if (userfaultfd_missing(vma))
+		return false;
+
+	return !read_seqcount_retry(&vma->vm_sequence, *seq);
+}
+
+/*
+ * Walk down to the pmd of @address.  Called with interrupts disabled,
+ * which keeps the page tables from being freed under us since they go
+ * through tlb_remove_table().
+ */
+static pmd_t *spf_find_pmd(struct mm_struct *mm, unsigned long address,
+			   pmd_t *orig_pmd)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd, pmdval;
+
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		return NULL;
+
+	pud = pud_offset(pgd, address);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		return NULL;
+
+	pmd = pmd_offset(pud, address);
+	pmdval = READ_ONCE(*pmd);
+	if (pmd_none(pmdval) || pmd_trans_huge(pmdval) ||
+	    unlikely(pmd_bad(pmdval)))
+		return NULL;
+
+	*orig_pmd = pmdval;
+	return pmd;
+}
+
+/*
+ * Handle a fault on a missing anonymous pte without mmap_sem.  The vma is
+ * looked up under RCU and validated against its vm_sequence once the pte
+ * lock is held; anything unusual returns VM_FAULT_RETRY and the caller
+ * goes through handle_mm_fault() with mmap_sem as before.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags, unsigned long vm_flags)
+{
+	struct vm_area_struct *vma;
+	struct mem_cgroup *memcg;
+	struct page *page = NULL;
+	unsigned int seq;
+	pmd_t *pmd, orig_pmd;
+	pte_t *pte, entry;
+	spinlock_t *ptl;
+	bool none;
+
+	address &= PAGE_MASK;
+
+	/* Don't bother allocating unless the pte is really missing. */
+	rcu_read_lock();
+	vma = find_vma_rcu(mm, address);
+	if (!vma || !spf_vma_suitable(vma, address, vm_flags, &seq)) {
+		rcu_read_unlock();
+		return VM_FAULT_RETRY;
+	}
+	local_irq_disable();
+	pmd = spf_find_pmd(mm, address, &orig_pmd);
+	none = false;
+	if (pmd) {
+		pte = pte_offset_map(pmd, address);
+		none = pte_none(READ_ONCE(*pte));
+		pte_unmap(pte);
+	}
+	local_irq_enable();
+	rcu_read_unlock();
+	if (!none)
+		return VM_FAULT_RETRY;
+
+	__set_current_state(TASK_RUNNING);
+
+	if ((flags & FAULT_FLAG_WRITE) || mm_forbids_zeropage(mm)) {
+		/* The vma may be gone by now, so no mempolicy here. */
+		page = alloc_zeroed_user_highpage_movable(NULL, address);
+		if (!page)
+			return VM_FAULT_RETRY;
+		if (mem_cgroup_try_charge(page, mm, GFP_KERNEL, &memcg)) {
+			page_cache_release(page);
+			return VM_FAULT_RETRY;
+		}
+		__SetPageUptodate(page);
+	}
+
+	rcu_read_lock();
+	vma = find_vma_rcu(mm, address);
+	if (!vma || !spf_vma_suitable(vma, address, vm_flags, &seq))
+		goto out_rcu;
+
+	/*
+	 * Spinning on the pte lock with interrupts off could deadlock
+	 * against a holder waiting for us in tlb_remove_table(), hence the
+	 * trylock.  Once the lock is held the page table can't be freed.
+	 */
+	local_irq_disable();
+	pmd = spf_find_pmd(mm, address, &orig_pmd);
+	if (!pmd)
+		goto out_irq;
+	ptl = pte_lockptr(mm, pmd);
+	if (!spin_trylock(ptl))
+		goto out_irq;
+	pte = pte_offset_map(pmd, address);
+	if (!pmd_same(*pmd, orig_pmd) || !pte_none(*pte) ||
+	    read_seqcount_retry(&vma->vm_sequence, seq)) {
+		pte_unmap_unlock(pte, ptl);
+		goto out_irq;
+	}
+	local_irq_enable();
+
+	if (page) {
+		entry = mk_pte(page, vma->vm_page_prot);
+		if (vma->vm_flags & VM_WRITE)
+			entry = pte_mkwrite(pte_mkdirty(entry));
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(page, vma, address);
+		mem_cgroup_commit_charge(page, memcg, false);
+		lru_cache_add_active_or_unevictable(page, vma);
+	} else {
+		entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
+					      vma->vm_page_prot));
+	}
+	set_pte_at(mm, address, pte, entry);
+
+	/* No need to invalidate - it was non-present before */
+	update_mmu_cache(vma, address, pte);
+	pte_unmap_unlock(pte, ptl);
+	rcu_read_unlock();
+
+	count_vm_event(PGFAULT);
+	count_vm_event(SPECULATIVE_PGFAULT);
+	mem_cgroup_count_vm_event(mm, PGFAULT);
+	check_sync_rss_stat(current);
+	return 0;
+
+out_irq:
+	local_irq_enable();
+out_rcu:
+	rcu_read_unlock();
+	if (page) {
+		mem_cgroup_cancel_charge(page, memcg);
+		page_cache_release(page);
+	}
+	return VM_FAULT_RETRY;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
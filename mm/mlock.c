@@ -423,7 +423,9 @@ static unsigned long __munlock_pagevec_fill(struct pagevec *pvec,
 void munlock_vma_pages_range(struct vm_area_struct *vma,
 			     unsigned long start, unsigned long end)
 {
+	vm_write_begin(vma);
 	vma->vm_flags &= VM_LOCKED_CLEAR_MASK;
+	vm_write_end(vma);
 
 	while (start < end) {
 		struct page *page = NULL;
@@ -549,9 +551,11 @@ success:
 	 * set VM_LOCKED, populate_vma_page_range will bring it back.
 	 */
 
-	if (lock)
+	if (lock) {
+		vm_write_begin(vma);
 		vma->vm_flags = newflags;
-	else
+		vm_write_end(vma);
+	} else
 		munlock_vma_pages_range(vma, start, end);
 
 out:
@@ -915,6 +915,67 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Free count base pages worth of pages from the high-order pcp-lists,
+ * taking one page from each non-empty list per pass.
+ */
+static void free_pcppages_high_order_bulk(struct zone *zone, int count,
+					struct per_cpu_pages *pcp)
+{
+	unsigned int order;
+	int migratetype;
+	unsigned long nr_scanned;
+
+	spin_lock(&zone->lock);
+	nr_scanned = zone_page_state(zone, NR_PAGES_SCANNED);
+	if (nr_scanned)
+		__mod_zone_page_state(zone, NR_PAGES_SCANNED, -nr_scanned);
+
+	while (count > 0 && pcp->high_order_count) {
+		for (order = 1; order <= PCP_HIGH_ORDER; order++) {
+			for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+			     migratetype++) {
+				struct list_head *list;
+				struct page *page;
+				int mt;
+
+				list = &pcp->high_order_lists[order - 1]
+							     [migratetype];
+				if (list_empty(list))
+					continue;
+
+				page = list_last_entry(list, struct page, lru);
+				list_del(&page->lru);
+
+				mt = get_pcppage_migratetype(page);
+				VM_BUG_ON_PAGE(is_migrate_isolate(mt), page);
+				if (unlikely(has_isolate_pageblock(zone)))
+					mt = get_pageblock_migratetype(page);
+
+				__free_one_page(page, page_to_pfn(page), zone,
+						order, mt);
+				trace_mm_page_pcpu_drain(page, order, mt);
+				pcp->high_order_count -= 1 << order;
+				count -= 1 << order;
+			}
+		}
+	}
+	spin_unlock(&zone->lock);
+}
+
+/* Free a page of order 1..PCP_HIGH_ORDER to the pcp-lists, irqs disabled */
+static void free_pcp_high_order(struct zone *zone, struct page *page,
+				unsigned int order, int migratetype)
+{
+	struct per_cpu_pages *pcp = &this_cpu_ptr(zone->pageset)->pcp;
+
+	set_pcppage_migratetype(page, migratetype);
+	list_add(&page->lru, &pcp->high_order_lists[order - 1][migratetype]);
+	pcp->high_order_count += 1 << order;
+	if (pcp->high_order_count >= pcp->high)
+		free_pcppages_high_order_bulk(zone, READ_ONCE(pcp->batch), pcp);
+}
+
 static void free_one_page(struct zone *zone,
 				struct page *page, unsigned long pfn,
 				unsigned int order,
@@ -1085,7 +1146,10 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	migratetype = get_pfnblock_migratetype(page, pfn);
 	local_irq_save(flags);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, pfn, order, migratetype);
+	if (order <= PCP_HIGH_ORDER && migratetype < MIGRATE_PCPTYPES)
+		free_pcp_high_order(page_zone(page), page, order, migratetype);
+	else
+		free_one_page(page_zone(page), page, pfn, order, migratetype);
 	local_irq_restore(flags);
 }
 
@@ -1170,6 +1234,9 @@ void __free_pages_bootmem(struct page *page, unsigned long pfn,
 }
 
 #ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+/* Serialises the zone->managed_pages updates of parallel init threads */
+static DEFINE_SPINLOCK(deferred_free_lock);
+
 static void __init deferred_free_range(struct page *page,
 					unsigned long pfn, int nr_pages)
 {
@@ -1178,16 +1245,17 @@ static void __init deferred_free_range(struct page *page,
 	if (!page)
 		return;
 
+	spin_lock(&deferred_free_lock);
 	/* Free a large naturally-aligned chunk if possible */
 	if (nr_pages == MAX_ORDER_NR_PAGES &&
 	    (pfn & (MAX_ORDER_NR_PAGES-1)) == 0) {
 		set_pageblock_migratetype(page, MIGRATE_MOVABLE);
 		__free_pages_boot_core(page, pfn, MAX_ORDER-1);
-		return;
+	} else {
+		for (i = 0; i < nr_pages; i++, page++, pfn++)
+			__free_pages_boot_core(page, pfn, 0);
 	}
-
-	for (i = 0; i < nr_pages; i++, page++, pfn++)
-		__free_pages_boot_core(page, pfn, 0);
+	spin_unlock(&deferred_free_lock);
 }
 
 /* Completion tracking for deferred_init_memmap() threads */
@@ -1200,56 +1268,35 @@ static inline void __init pgdat_init_report_one_done(void)
 		complete(&pgdat_init_all_done_comp);
 }
 
-/* Initialise remaining memory on a node */
-static int __init deferred_init_memmap(void *data)
+/* Initialise the pages of @zone within [start_pfn, end_pfn) */
+static unsigned long __init deferred_init_range(pg_data_t *pgdat,
+						struct zone *zone,
+						unsigned long start_pfn,
+						unsigned long end_pfn)
 {
-	pg_data_t *pgdat = data;
 	int nid = pgdat->node_id;
+	int zid = zone_idx(zone);
 	struct mminit_pfnnid_cache nid_init_state = { };
-	unsigned long start = jiffies;
 	unsigned long nr_pages = 0;
 	unsigned long walk_start, walk_end;
-	int i, zid;
-	struct zone *zone;
-	unsigned long first_init_pfn = pgdat->first_deferred_pfn;
-	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
-
-	if (first_init_pfn == ULONG_MAX) {
-		pgdat_init_report_one_done();
-		return 0;
-	}
-
-	/* Bind memory initialisation thread to a local node if possible */
-	if (!cpumask_empty(cpumask))
-		set_cpus_allowed_ptr(current, cpumask);
-
-	/* Sanity check boundaries */
-	BUG_ON(pgdat->first_deferred_pfn < pgdat->node_start_pfn);
-	BUG_ON(pgdat->first_deferred_pfn > pgdat_end_pfn(pgdat));
-	pgdat->first_deferred_pfn = ULONG_MAX;
-
-	/* Only the highest zone is deferred so find it */
-	for (zid = 0; zid < MAX_NR_ZONES; zid++) {
-		zone = pgdat->node_zones + zid;
-		if (first_init_pfn < zone_end_pfn(zone))
-			break;
-	}
+	unsigned long first_init_pfn = start_pfn;
+	int i;
 
 	for_each_mem_pfn_range(i, nid, &walk_start, &walk_end, NULL) {
-		unsigned long pfn, end_pfn;
+		unsigned long pfn, range_end;
 		struct page *page = NULL;
 		struct page *free_base_page = NULL;
 		unsigned long free_base_pfn = 0;
 		int nr_to_free = 0;
 
-		end_pfn = min(walk_end, zone_end_pfn(zone));
+		range_end = min(walk_end, end_pfn);
 		pfn = first_init_pfn;
 		if (pfn < walk_start)
 			pfn = walk_start;
 		if (pfn < zone->zone_start_pfn)
 			pfn = zone->zone_start_pfn;
 
-		for (; pfn < end_pfn; pfn++) {
+		for (; pfn < range_end; pfn++) {
 			if (!pfn_valid_within(pfn))
 				goto free_range;
 
@@ -1306,10 +1353,128 @@ free_range:
 			free_base_page = NULL;
 			free_base_pfn = nr_to_free = 0;
 		}
+		/* Free the last block of pages to allocator */
+		nr_pages += nr_to_free;
+		deferred_free_range(free_base_page, free_base_pfn, nr_to_free);
 
-		first_init_pfn = max(end_pfn, first_init_pfn);
+		first_init_pfn = max(range_end, first_init_pfn);
 	}
 
+	return nr_pages;
+}
+
+/* One slice of a node's deferred memmap, handled by its own thread */
+struct deferred_init_work {
+	pg_data_t *pgdat;
+	struct zone *zone;
+	unsigned long start_pfn;
+	unsigned long end_pfn;
+	unsigned long nr_pages;
+	atomic_t *nr_undone;
+	struct completion *done;
+};
+
+static int __init deferred_init_work_fn(void *data)
+{
+	struct deferred_init_work *work = data;
+
+	work->nr_pages = deferred_init_range(work->pgdat, work->zone,
+					     work->start_pfn, work->end_pfn);
+	if (atomic_dec_and_test(work->nr_undone))
+		complete(work->done);
+	return 0;
+}
+
+/* Initialise remaining memory on a node */
+static int __init deferred_init_memmap(void *data)
+{
+	pg_data_t *pgdat = data;
+	int nid = pgdat->node_id;
+	unsigned long start = jiffies;
+	unsigned long nr_pages = 0;
+	unsigned long first_init_pfn = pgdat->first_deferred_pfn;
+	unsigned long end_pfn, chunk;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	struct deferred_init_work *works = NULL;
+	DECLARE_COMPLETION_ONSTACK(done);
+	atomic_t nr_undone;
+	unsigned int nr_works = 1;
+	unsigned int i;
+	int zid;
+	struct zone *zone;
+
+	if (first_init_pfn == ULONG_MAX) {
+		pgdat_init_report_one_done();
+		return 0;
+	}
+
+	/* Bind memory initialisation thread to a local node if possible */
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	/* Sanity check boundaries */
+	BUG_ON(pgdat->first_deferred_pfn < pgdat->node_start_pfn);
+	BUG_ON(pgdat->first_deferred_pfn > pgdat_end_pfn(pgdat));
+	pgdat->first_deferred_pfn = ULONG_MAX;
+
+	/* Only the highest zone is deferred so find it */
+	for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+		zone = pgdat->node_zones + zid;
+		if (first_init_pfn < zone_end_pfn(zone))
+			break;
+	}
+	end_pfn = zone_end_pfn(zone);
+
+	/*
+	 * Split the range between the CPUs of the node. Slices start on a
+	 * MAX_ORDER boundary so that each one frees whole blocks, just as
+	 * a single walk would.
+	 */
+	if (!cpumask_empty(cpumask))
+		nr_works = cpumask_weight(cpumask);
+	chunk = ALIGN(DIV_ROUND_UP(end_pfn - first_init_pfn, nr_works),
+		      MAX_ORDER_NR_PAGES);
+	nr_works = DIV_ROUND_UP(end_pfn - first_init_pfn, chunk);
+	if (nr_works > 1)
+		works = kcalloc(nr_works, sizeof(*works), GFP_KERNEL);
+
+	if (!works) {
+		nr_pages = deferred_init_range(pgdat, zone, first_init_pfn,
+					       end_pfn);
+		goto out;
+	}
+
+	atomic_set(&nr_undone, nr_works);
+	for (i = 0; i < nr_works; i++) {
+		struct deferred_init_work *work = &works[i];
+		struct task_struct *tsk = ERR_PTR(-EINVAL);
+
+		work->pgdat = pgdat;
+		work->zone = zone;
+		work->start_pfn = first_init_pfn + i * chunk;
+		work->end_pfn = min(work->start_pfn + chunk, end_pfn);
+		work->nr_undone = &nr_undone;
+		work->done = &done;
+
+		/* This thread takes the last slice itself */
+		if (i < nr_works - 1)
+			tsk = kthread_create(deferred_init_work_fn, work,
+					     "pgdatinit%d.%u", nid, i);
+		if (IS_ERR(tsk)) {
+			deferred_init_work_fn(work);
+			continue;
+		}
+		if (!cpumask_empty(cpumask))
+			set_cpus_allowed_ptr(tsk, cpumask);
+		wake_up_process(tsk);
+	}
+	wait_for_completion(&done);
+
+	for (i = 0; i < nr_works; i++)
+		nr_pages += works[i].nr_pages;
+	kfree(works);
+
+out:
 	/* Sanity check that the next zone really is unpopulated */
 	WARN_ON(++zid < MAX_NR_ZONES && populated_zone(++zone));
 
@@ -2017,6 +2182,39 @@ static struct list_head *get_populated_pcp_list(struct zone *zone,
 	return list;
 }
 
+/*
+ * Take a page of order 1..PCP_HIGH_ORDER from the pcp-lists, refilling the
+ * list from the buddy lists in one batch if it is empty. Called with irqs
+ * disabled.
+ */
+static struct page *rmqueue_pcp_high_order(struct zone *zone,
+			unsigned int order, int migratetype, bool cold)
+{
+	struct per_cpu_pages *pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	struct list_head *list = &pcp->high_order_lists[order - 1][migratetype];
+	struct page *page;
+
+	if (list_empty(list)) {
+		int batch = max(READ_ONCE(pcp->batch) >> order, 1);
+
+		pcp->high_order_count += rmqueue_bulk(zone, order, batch, list,
+						migratetype, cold) << order;
+		if (list_empty(list))
+			return NULL;
+		__count_vm_event(PGALLOC_PCP_HIGH_REFILL);
+	}
+
+	if (cold)
+		page = list_last_entry(list, struct page, lru);
+	else
+		page = list_first_entry(list, struct page, lru);
+
+	list_del(&page->lru);
+	pcp->high_order_count -= 1 << order;
+	__count_vm_event(PGALLOC_PCP_HIGH);
+	return page;
+}
+
 #ifdef CONFIG_NUMA
 /*
  * Called from the vmstat counter updater to drain pagesets of this
@@ -2063,6 +2261,8 @@ static void drain_pages_zone(unsigned int cpu, struct zone *zone)
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		pcp->count = 0;
 	}
+	if (pcp->high_order_count)
+		free_pcppages_high_order_bulk(zone, pcp->high_order_count, pcp);
 	local_irq_restore(flags);
 }
 
@@ -2132,12 +2332,13 @@ void drain_all_pages(struct zone *zone)
 
 		if (zone) {
 			pcp = per_cpu_ptr(zone->pageset, cpu);
-			if (pcp->pcp.count)
+			if (pcp->pcp.count || pcp->pcp.high_order_count)
 				has_pcps = true;
 		} else {
 			for_each_populated_zone(z) {
 				pcp = per_cpu_ptr(z->pageset, cpu);
-				if (pcp->pcp.count) {
+				if (pcp->pcp.count ||
+				    pcp->pcp.high_order_count) {
 					has_pcps = true;
 					break;
 				}
@@ -2326,7 +2527,8 @@ int __isolate_free_page(struct page *page, unsigned int order)
 }
 
 /*
- * Allocate a page from the given zone. Use pcplists for order-0 allocations.
+ * Allocate a page from the given zone. Use pcplists for order-0 and small
+ * high-order allocations.
  */
 static inline
 struct page *buffered_rmqueue(struct zone *preferred_zone,
@@ -2384,26 +2586,42 @@ struct page *buffered_rmqueue(struct zone *preferred_zone,
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
+		local_irq_save(flags);
 
+		/*
+		 * Small high orders come from the pcp-lists unless the caller
+		 * wants the highatomic reserve or CMA pages.
+		 */
 		page = NULL;
-		if (alloc_flags & ALLOC_HARDER) {
-			page = __rmqueue_smallest(zone, order, MIGRATE_HIGHATOMIC);
-			if (page)
-				trace_mm_page_alloc_zone_locked(page, order, migratetype);
-		}
-		if (!page && migratetype == MIGRATE_MOVABLE &&
-				gfp_flags & __GFP_CMA)
-			page = __rmqueue_cma(zone, order);
+		if (order <= PCP_HIGH_ORDER && migratetype < MIGRATE_PCPTYPES &&
+		    !(alloc_flags & ALLOC_HARDER) && !(gfp_flags & __GFP_CMA))
+			page = rmqueue_pcp_high_order(zone, order, migratetype,
+						      cold);
+
+		if (!page) {
+			spin_lock(&zone->lock);
+
+			if (alloc_flags & ALLOC_HARDER) {
+				page = __rmqueue_smallest(zone, order,
+							  MIGRATE_HIGHATOMIC);
+				if (page)
+					trace_mm_page_alloc_zone_locked(page,
+							order, migratetype);
+			}
+			if (!page && migratetype == MIGRATE_MOVABLE &&
+					gfp_flags & __GFP_CMA)
+				page = __rmqueue_cma(zone, order);
 
-		if (!page)
-			page = __rmqueue(zone, order, migratetype, gfp_flags);
+			if (!page)
+				page = __rmqueue(zone, order, migratetype,
+						 gfp_flags);
 
-		spin_unlock(&zone->lock);
-		if (!page)
-			goto failed;
-		__mod_zone_freepage_state(zone, -(1 << order),
-					  get_pcppage_migratetype(page));
+			spin_unlock(&zone->lock);
+			if (!page)
+				goto failed;
+			__mod_zone_freepage_state(zone, -(1 << order),
+					get_pcppage_migratetype(page));
+		}
 	}
 
 	__mod_zone_page_state(zone, NR_ALLOC_BATCH, -(1 << order));
@@ -2980,15 +3198,21 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 }
 #endif /* CONFIG_COMPACTION */
 
+/* direct reclaim taking longer fires the trace snapshot trigger, 0 = never */
+static unsigned int direct_reclaim_snapshot_ms = 100;
+module_param(direct_reclaim_snapshot_ms, uint, 0644);
+
 /* Perform direct synchronous page reclaim */
 static int
 __perform_reclaim(gfp_t gfp_mask, unsigned int order,
 					const struct alloc_context *ac)
 {
 	struct reclaim_state reclaim_state;
+	unsigned long start;
 	int progress;
 
 	cond_resched();
+	start = jiffies;
 
 	/* We now go into synchronous reclaim */
 	cpuset_memory_pressure_bump();
@@ -3004,6 +3228,11 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order,
 	lockdep_clear_current_reclaim_state();
 	current->flags &= ~PF_MEMALLOC;
 
+	if (direct_reclaim_snapshot_ms &&
+	    time_after(jiffies, start +
+		       msecs_to_jiffies(direct_reclaim_snapshot_ms)))
+		tracing_snapshot_trigger("slow direct reclaim");
+
 	cond_resched();
 
 	return progress;
@@ -3892,6 +4121,13 @@ static void show_migration_types(unsigned char type)
  * SHOW_MEM_FILTER_NODES: suppress nodes that are not allowed by current's
  *   cpuset.
  */
+static unsigned long pcp_free_pages(struct zone *zone, int cpu)
+{
+	struct per_cpu_pages *pcp = &per_cpu_ptr(zone->pageset, cpu)->pcp;
+
+	return pcp->count + pcp->high_order_count;
+}
+
 void show_free_areas(unsigned int filter)
 {
 	unsigned long free_pcp = 0;
@@ -3903,7 +4139,7 @@ void show_free_areas(unsigned int filter)
 			continue;
 
 		for_each_online_cpu(cpu)
-			free_pcp += per_cpu_ptr(zone->pageset, cpu)->pcp.count;
+			free_pcp += pcp_free_pages(zone, cpu);
 	}
 
 	printk("active_anon:%lu inactive_anon:%lu isolated_anon:%lu\n"
@@ -3940,7 +4176,7 @@ void show_free_areas(unsigned int filter)
 
 		free_pcp = 0;
 		for_each_online_cpu(cpu)
-			free_pcp += per_cpu_ptr(zone->pageset, cpu)->pcp.count;
+			free_pcp += pcp_free_pages(zone, cpu);
 
 		show_node(zone);
 		printk("%s"
@@ -4768,8 +5004,15 @@ static void pageset_init(struct per_cpu_pageset *p)
 
 	pcp = &p->pcp;
 	pcp->count = 0;
-	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
+	pcp->high_order_count = 0;
+	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++) {
+		int order;
+
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+		for (order = 0; order < PCP_HIGH_ORDER; order++)
+			INIT_LIST_HEAD(&pcp->high_order_lists[order]
+							     [migratetype]);
+	}
 }
 
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
@@ -0,0 +1,251 @@
+/*
+ * Pre-zeroed page reservoir
+ *
+ * Reservoir of pages zeroed ahead of time by a SCHED_IDLE kthread, so that
+ * GPU and camera buffer allocations do not memset on the caller's time.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/highmem.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/sched.h>
+#include <linux/shrinker.h>
+#include <linux/topology.h>
+#include <linux/prezero.h>
+
+/* Total size of the reservoir, split evenly between the orders */
+static unsigned int prezero_budget_kb = 8192;
+module_param_named(budget_kb, prezero_budget_kb, uint, S_IRUGO | S_IWUSR);
+
+struct prezero_pool {
+	unsigned int order;
+	unsigned int count;
+	spinlock_t lock;
+	struct list_head pages;
+};
+
+static struct prezero_pool prezero_pools[] = {
+	{ .order = 0 },
+	{ .order = 4 },
+	{ .order = 8 },
+};
+
+static DECLARE_WAIT_QUEUE_HEAD(prezero_wait);
+static atomic_t prezero_kicked = ATOMIC_INIT(0);
+static struct task_struct *prezero_task;
+
+/* Number of entries of @pool's order making up its share of the budget */
+static unsigned int prezero_target(struct prezero_pool *pool)
+{
+	unsigned long pages = prezero_budget_kb >> (PAGE_SHIFT - 10);
+
+	return (pages / ARRAY_SIZE(prezero_pools)) >> pool->order;
+}
+
+static void prezero_kick(void)
+{
+	if (!atomic_xchg(&prezero_kicked, 1))
+		wake_up(&prezero_wait);
+}
+
+struct page *prezero_alloc_page(unsigned int order)
+{
+	struct prezero_pool *pool = NULL;
+	struct page *page = NULL;
+	unsigned int count;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(prezero_pools); i++) {
+		if (prezero_pools[i].order == order) {
+			pool = &prezero_pools[i];
+			break;
+		}
+	}
+	if (!pool || !READ_ONCE(pool->count))
+		return NULL;
+
+	spin_lock(&pool->lock);
+	if (pool->count) {
+		page = list_first_entry(&pool->pages, struct page, lru);
+		list_del(&page->lru);
+		pool->count--;
+	}
+	count = pool->count;
+	spin_unlock(&pool->lock);
+
+	/* Top up once we are down to half of the target */
+	if (count < prezero_target(pool) / 2)
+		prezero_kick();
+
+	return page;
+}
+EXPORT_SYMBOL(prezero_alloc_page);
+
+static gfp_t prezero_gfp_mask(unsigned int order)
+{
+	/*
+	 * Never reclaim on behalf of the reservoir: it only takes memory
+	 * that is already free.
+	 */
+	gfp_t gfp_mask = (GFP_HIGHUSER | __GFP_NOWARN | __GFP_NORETRY) &
+				~__GFP_RECLAIM;
+
+	if (order)
+		gfp_mask |= __GFP_COMP;
+
+	return gfp_mask;
+}
+
+/* Fill @pool up to its target, returns false if allocation failed */
+static bool prezero_refill(struct prezero_pool *pool)
+{
+	struct page *page;
+	int i;
+
+	while (READ_ONCE(pool->count) < prezero_target(pool)) {
+		if (kthread_should_stop())
+			return true;
+
+		page = alloc_pages(prezero_gfp_mask(pool->order), pool->order);
+		if (!page)
+			return false;
+
+		for (i = 0; i < (1 << pool->order); i++) {
+			clear_highpage(nth_page(page, i));
+			cond_resched();
+		}
+
+		spin_lock(&pool->lock);
+		list_add_tail(&page->lru, &pool->pages);
+		pool->count++;
+		spin_unlock(&pool->lock);
+	}
+
+	return true;
+}
+
+static int prezero_thread(void *data)
+{
+	int i;
+
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(prezero_wait,
+				     atomic_read(&prezero_kicked) ||
+				     kthread_should_stop());
+		atomic_set(&prezero_kicked, 0);
+
+		/*
+		 * A failed allocation means free memory is short; stop here
+		 * and wait for the next kick rather than retrying.
+		 */
+		for (i = 0; i < ARRAY_SIZE(prezero_pools); i++)
+			if (!prezero_refill(&prezero_pools[i]))
+				break;
+	}
+
+	return 0;
+}
+
+static unsigned long prezero_shrink_count(struct shrinker *shrinker,
+					  struct shrink_control *sc)
+{
+	unsigned long total = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(prezero_pools); i++)
+		total += READ_ONCE(prezero_pools[i].count) <<
+				prezero_pools[i].order;
+
+	return total;
+}
+
+/* Give back the highest orders first, they are the most useful to others */
+static unsigned long prezero_shrink_scan(struct shrinker *shrinker,
+					 struct shrink_control *sc)
+{
+	unsigned long freed = 0;
+	struct page *page;
+	int i;
+
+	for (i = ARRAY_SIZE(prezero_pools) - 1; i >= 0; i--) {
+		struct prezero_pool *pool = &prezero_pools[i];
+
+		while (freed < sc->nr_to_scan) {
+			spin_lock(&pool->lock);
+			if (!pool->count) {
+				spin_unlock(&pool->lock);
+				break;
+			}
+			page = list_first_entry(&pool->pages, struct page, lru);
+			list_del(&page->lru);
+			pool->count--;
+			spin_unlock(&pool->lock);
+
+			__free_pages(page, pool->order);
+			freed += 1 << pool->order;
+		}
+	}
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker prezero_shrinker = {
+	.count_objects = prezero_shrink_count,
+	.scan_objects = prezero_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+/* Keep the zeroing off the big cores where it would cost the most energy */
+static void prezero_set_affinity(struct task_struct *tsk)
+{
+#ifdef arch_scale_cpu_capacity
+	unsigned long min_cap = ULONG_MAX;
+	cpumask_var_t mask;
+	int cpu;
+
+	if (!zalloc_cpumask_var(&mask, GFP_KERNEL))
+		return;
+
+	for_each_possible_cpu(cpu)
+		min_cap = min(min_cap, arch_scale_cpu_capacity(NULL, cpu));
+	for_each_possible_cpu(cpu)
+		if (arch_scale_cpu_capacity(NULL, cpu) == min_cap)
+			cpumask_set_cpu(cpu, mask);
+
+	set_cpus_allowed_ptr(tsk, mask);
+	free_cpumask_var(mask);
+#endif
+}
+
+static int __init prezero_init(void)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(prezero_pools); i++) {
+		spin_lock_init(&prezero_pools[i].lock);
+		INIT_LIST_HEAD(&prezero_pools[i].pages);
+	}
+
+	prezero_task = kthread_create(prezero_thread, NULL, "kprezerod");
+	if (IS_ERR(prezero_task)) {
+		pr_err("prezero: failed to start kprezerod\n");
+		prezero_task = NULL;
+		return 0;
+	}
+
+	sched_setscheduler_nocheck(prezero_task, SCHED_IDLE, &param);
+	prezero_set_affinity(prezero_task);
+	register_shrinker(&prezero_shrinker);
+
+	atomic_set(&prezero_kicked, 1);
+	wake_up_process(prezero_task);
+
+	return 0;
+}
+late_initcall(prezero_init);
@@ -67,10 +67,60 @@ module_param_named(swap_eff_win, swap_eff_win, int, S_IRUGO | S_IWUSR);
 static int swap_opt_eff = 50;
 module_param_named(swap_opt_eff, swap_opt_eff, int, S_IRUGO | S_IWUSR);
 
+/*
+ * Only reclaim pages that stayed unreferenced since the previous run
+ * looked at them, instead of whatever anon pages the walk finds first.
+ */
+static bool idle_only = true;
+module_param_named(idle_only, idle_only, bool, S_IRUGO | S_IWUSR);
+
+/*
+ * Pages reclaimed from a task that come straight back as major faults
+ * were not idle. A task whose major faults since the previous run exceed
+ * refault_pct percent of the pages reclaimed from it is left alone for
+ * one run.
+ */
+static int refault_pct = 25;
+module_param_named(refault_pct, refault_pct, int, S_IRUGO | S_IWUSR);
+
 static atomic_t skip_reclaim = ATOMIC_INIT(0);
 /* Not atomic since only a single instance of swap_fn run at a time */
 static int monitor_eff;
 
+/* Called under rcu_read_lock() */
+static unsigned long task_maj_flt(struct task_struct *p)
+{
+	struct task_struct *t;
+	unsigned long maj_flt = p->signal->maj_flt;
+
+	for_each_thread(p, t)
+		maj_flt += t->maj_flt;
+
+	return maj_flt;
+}
+
+/* Called with the task locked so that mm is stable */
+static bool task_refaulting(struct mm_struct *mm, unsigned long maj_flt)
+{
+	struct mm_reclaim_stat *stat = &mm->reclaim_stat;
+	unsigned long refaults, last;
+	bool ret = false;
+
+	spin_lock(&stat->lock);
+	refaults = maj_flt - stat->maj_flt;
+	last = stat->last;
+	stat->maj_flt = maj_flt;
+	stat->last = 0;
+
+	if (last && refaults * 100 > last * refault_pct) {
+		stat->backoffs++;
+		ret = true;
+	}
+	spin_unlock(&stat->lock);
+
+	return ret;
+}
+
 struct selected_task {
 	struct task_struct *p;
 	int tasksize;
@@ -144,6 +194,11 @@ static void swap_fn(struct work_struct *work)
 			continue;
 		}
 
+		if (task_refaulting(p->mm, task_maj_flt(p))) {
+			task_unlock(p);
+			continue;
+		}
+
 		tasksize = get_mm_counter(p->mm, MM_ANONPAGES);
 		task_unlock(p);
 
@@ -188,7 +243,8 @@ static void swap_fn(struct work_struct *work)
 		if (!nr_to_reclaim)
 			nr_to_reclaim = 1;
 
-		rp = reclaim_task_anon(selected[si].p, nr_to_reclaim);
+		rp = reclaim_task_anon(selected[si].p, nr_to_reclaim,
+				       idle_only);
 
 		trace_process_reclaim(selected[si].tasksize,
 				selected[si].oom_score_adj, rp.nr_scanned,
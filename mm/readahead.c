@@ -18,6 +18,7 @@
 #include <linux/syscalls.h>
 #include <linux/file.h>
 #include <linux/blk-cgroup.h>
+#include <linux/readahead_profile.h>
 
 #include "internal.h"
 
@@ -196,8 +197,10 @@ int __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
 		read_pages(mapping, filp, &page_pool, ret, gfp_mask);
+		ra_profile_record(filp, offset, nr_to_read);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
@@ -0,0 +1,558 @@
+/*
+ * Launch readahead profiles
+ *
+ * Record the readahead a process submits while it is launching, under a
+ * name chosen by userspace (typically the package), and replay it as one
+ * batch of asynchronous readahead the next time the same app launches, so
+ * that its APK/OAT pages are mostly in the page cache before it asks.
+ *
+ *   echo "<pid> <name>" > /sys/kernel/mm/readahead_profile/record
+ *   echo "<name>" > /sys/kernel/mm/readahead_profile/replay
+ *
+ * Files are remembered by path and reopened from a kworker at replay time,
+ * so files the kworker cannot see under that path are simply skipped.
+ */
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/dcache.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/sched.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
+#include <linux/blkdev.h>
+#include <linux/sort.h>
+#include <linux/kref.h>
+#include <linux/readahead_profile.h>
+
+#define RA_PROFILE_NAME_LEN	64
+#define RA_PROFILE_MAX_FILES	128
+#define RA_PROFILE_MAX_EXTENTS	4096
+#define RA_PROFILE_RECORDERS	4
+
+/* How long a launch is recorded for */
+static unsigned int ra_profile_record_ms = 5000;
+/* Number of profiles kept, least recently replayed ones go first */
+static unsigned int ra_profile_max = 16;
+
+struct ra_profile_file {
+	char *path;
+	/* only used while recording, turned into @path once it is done */
+	struct path f_path;
+	dev_t dev;
+	unsigned long ino;
+	unsigned int last;
+};
+
+struct ra_profile_extent {
+	unsigned int file;
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct ra_profile {
+	struct kref ref;
+	struct list_head list;
+	char name[RA_PROFILE_NAME_LEN];
+	unsigned int nr_files;
+	unsigned int nr_extents;
+	unsigned long nr_pages;
+	struct ra_profile_file *files;
+	struct ra_profile_extent *extents;
+};
+
+struct ra_profile_recorder {
+	pid_t tgid;
+	struct ra_profile *profile;
+	struct delayed_work work;
+};
+
+struct ra_profile_replay {
+	struct work_struct work;
+	struct ra_profile *profile;
+};
+
+/* Protects the profile list and the recorders */
+static DEFINE_MUTEX(ra_profile_lock);
+static LIST_HEAD(ra_profiles);
+static unsigned int ra_profile_count;
+static struct ra_profile_recorder ra_recorders[RA_PROFILE_RECORDERS];
+
+atomic_t ra_profile_recording = ATOMIC_INIT(0);
+
+static void *ra_profile_alloc(size_t size)
+{
+	void *p = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+
+	return p ? p : vzalloc(size);
+}
+
+static void ra_profile_free(struct ra_profile *p)
+{
+	unsigned int i;
+
+	for (i = 0; i < p->nr_files; i++) {
+		kfree(p->files[i].path);
+		if (p->files[i].f_path.dentry)
+			path_put(&p->files[i].f_path);
+	}
+	kvfree(p->files);
+	kvfree(p->extents);
+	kfree(p);
+}
+
+static void ra_profile_release(struct kref *ref)
+{
+	ra_profile_free(container_of(ref, struct ra_profile, ref));
+}
+
+static void ra_profile_put(struct ra_profile *p)
+{
+	kref_put(&p->ref, ra_profile_release);
+}
+
+static struct ra_profile_recorder *ra_profile_find_recorder(pid_t tgid)
+{
+	int i;
+
+	for (i = 0; i < RA_PROFILE_RECORDERS; i++)
+		if (READ_ONCE(ra_recorders[i].tgid) == tgid)
+			return &ra_recorders[i];
+	return NULL;
+}
+
+/*
+ * Only keep a reference to the file's path while recording, resolving it
+ * to a string is left to ra_profile_resolve() once the recording is done.
+ * The reference, and so the mount, is held for ra_profile_record_ms at
+ * most; stored profiles only keep the path string.
+ */
+static int ra_profile_add_file(struct ra_profile *p, struct file *filp)
+{
+	struct inode *inode = file_inode(filp);
+	struct ra_profile_file *f;
+
+	if (p->nr_files == RA_PROFILE_MAX_FILES)
+		return -ENOSPC;
+
+	f = &p->files[p->nr_files];
+	f->f_path = filp->f_path;
+	path_get(&f->f_path);
+	f->dev = inode->i_sb->s_dev;
+	f->ino = inode->i_ino;
+	f->last = UINT_MAX;
+
+	return p->nr_files++;
+}
+
+void __ra_profile_record(struct file *filp, pgoff_t offset,
+			 unsigned long nr_pages)
+{
+	struct inode *inode = file_inode(filp);
+	struct ra_profile_recorder *rec;
+	struct ra_profile_extent *ext;
+	struct ra_profile_file *f;
+	struct ra_profile *p;
+	int i;
+
+	if (!S_ISREG(inode->i_mode))
+		return;
+
+	/* Readahead from everybody else must not serialize on the lock */
+	if (!ra_profile_find_recorder(current->tgid))
+		return;
+
+	mutex_lock(&ra_profile_lock);
+	rec = ra_profile_find_recorder(current->tgid);
+	if (!rec)
+		goto out;
+	p = rec->profile;
+
+	for (i = 0; i < p->nr_files; i++)
+		if (p->files[i].ino == inode->i_ino &&
+		    p->files[i].dev == inode->i_sb->s_dev)
+			break;
+	if (i == p->nr_files) {
+		i = ra_profile_add_file(p, filp);
+		if (i < 0)
+			goto out;
+	}
+	f = &p->files[i];
+
+	/* Most launches read files in runs, extend the last one if we can */
+	if (f->last != UINT_MAX) {
+		ext = &p->extents[f->last];
+		if (offset >= ext->start && offset <= ext->start + ext->nr) {
+			unsigned long end = offset + nr_pages - ext->start;
+
+			if (end > ext->nr) {
+				p->nr_pages += end - ext->nr;
+				ext->nr = end;
+			}
+			goto out;
+		}
+	}
+
+	if (p->nr_extents == RA_PROFILE_MAX_EXTENTS)
+		goto out;
+	ext = &p->extents[p->nr_extents];
+	ext->file = i;
+	ext->start = offset;
+	ext->nr = nr_pages;
+	f->last = p->nr_extents++;
+	p->nr_pages += nr_pages;
+out:
+	mutex_unlock(&ra_profile_lock);
+}
+
+static int ra_profile_extent_cmp(const void *a, const void *b)
+{
+	const struct ra_profile_extent *ea = a, *eb = b;
+
+	if (ea->file != eb->file)
+		return ea->file < eb->file ? -1 : 1;
+	if (ea->start != eb->start)
+		return ea->start < eb->start ? -1 : 1;
+	return 0;
+}
+
+static struct ra_profile *ra_profile_lookup(const char *name)
+{
+	struct ra_profile *p;
+
+	list_for_each_entry(p, &ra_profiles, list)
+		if (!strcmp(p->name, name))
+			return p;
+	return NULL;
+}
+
+/* Turn the recorded paths into the names replay reopens them by */
+static void ra_profile_resolve(struct ra_profile *p)
+{
+	struct ra_profile_file *f;
+	char *buf, *path;
+	unsigned int i;
+
+	buf = (char *)__get_free_page(GFP_KERNEL);
+
+	for (i = 0; i < p->nr_files; i++) {
+		f = &p->files[i];
+		if (buf && !d_unlinked(f->f_path.dentry)) {
+			path = d_path(&f->f_path, buf, PAGE_SIZE);
+			/* files without a path are skipped on replay */
+			if (!IS_ERR(path))
+				f->path = kstrdup(path, GFP_KERNEL);
+		}
+		path_put(&f->f_path);
+		f->f_path.dentry = NULL;
+	}
+
+	if (buf)
+		free_page((unsigned long)buf);
+}
+
+/* Trim a finished recording and make it the profile for its name */
+static void ra_profile_install(struct ra_profile *p)
+{
+	struct ra_profile_extent *extents;
+	struct ra_profile *old;
+
+	/* Replay walks each file once, in offset order */
+	sort(p->extents, p->nr_extents, sizeof(*p->extents),
+	     ra_profile_extent_cmp, NULL);
+	extents = ra_profile_alloc(p->nr_extents * sizeof(*extents));
+	if (extents) {
+		memcpy(extents, p->extents, p->nr_extents * sizeof(*extents));
+		kvfree(p->extents);
+		p->extents = extents;
+	}
+
+	old = ra_profile_lookup(p->name);
+	if (old) {
+		list_del(&old->list);
+		ra_profile_count--;
+		ra_profile_put(old);
+	}
+	list_add(&p->list, &ra_profiles);
+	ra_profile_count++;
+
+	while (ra_profile_count > ra_profile_max) {
+		old = list_last_entry(&ra_profiles, struct ra_profile, list);
+		list_del(&old->list);
+		ra_profile_count--;
+		ra_profile_put(old);
+	}
+}
+
+static void ra_profile_record_done(struct work_struct *work)
+{
+	struct ra_profile_recorder *rec = container_of(to_delayed_work(work),
+					struct ra_profile_recorder, work);
+	struct ra_profile *p;
+
+	mutex_lock(&ra_profile_lock);
+	p = rec->profile;
+	rec->profile = NULL;
+	WRITE_ONCE(rec->tgid, 0);
+	atomic_dec(&ra_profile_recording);
+	mutex_unlock(&ra_profile_lock);
+
+	/*
+	 * Nobody can record into @p any more. Drop its path references, which
+	 * may sleep for a final dput() or mntput(), without stalling the
+	 * readahead of other recorders on the lock.
+	 */
+	if (!p->nr_extents) {
+		ra_profile_put(p);
+		return;
+	}
+	ra_profile_resolve(p);
+
+	mutex_lock(&ra_profile_lock);
+	ra_profile_install(p);
+	mutex_unlock(&ra_profile_lock);
+}
+
+static int ra_profile_start(pid_t pid, const char *name)
+{
+	struct ra_profile_recorder *rec;
+	struct task_struct *task;
+	struct ra_profile *p;
+	pid_t tgid = 0;
+	int err;
+
+	rcu_read_lock();
+	task = find_task_by_vpid(pid);
+	if (task)
+		tgid = task->tgid;
+	rcu_read_unlock();
+	if (!tgid)
+		return -ESRCH;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return -ENOMEM;
+	kref_init(&p->ref);
+	INIT_LIST_HEAD(&p->list);
+	strlcpy(p->name, name, sizeof(p->name));
+	p->files = ra_profile_alloc(RA_PROFILE_MAX_FILES * sizeof(*p->files));
+	p->extents = ra_profile_alloc(RA_PROFILE_MAX_EXTENTS *
+				      sizeof(*p->extents));
+	if (!p->files || !p->extents) {
+		ra_profile_free(p);
+		return -ENOMEM;
+	}
+
+	mutex_lock(&ra_profile_lock);
+	err = -EBUSY;
+	if (ra_profile_find_recorder(tgid))
+		goto out_unlock;
+	rec = ra_profile_find_recorder(0);
+	if (!rec)
+		goto out_unlock;
+
+	rec->profile = p;
+	WRITE_ONCE(rec->tgid, tgid);
+	atomic_inc(&ra_profile_recording);
+	schedule_delayed_work(&rec->work,
+			      msecs_to_jiffies(ra_profile_record_ms));
+	p = NULL;
+	err = 0;
+out_unlock:
+	mutex_unlock(&ra_profile_lock);
+	if (p)
+		ra_profile_free(p);
+	return err;
+}
+
+static void ra_profile_replay_fn(struct work_struct *work)
+{
+	struct ra_profile_replay *replay = container_of(work,
+					struct ra_profile_replay, work);
+	struct ra_profile *p = replay->profile;
+	struct ra_profile_extent *ext = p->extents;
+	struct ra_profile_extent *end = p->extents + p->nr_extents;
+	struct blk_plug plug;
+	struct file *filp;
+	unsigned int i;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < p->nr_files && ext < end; i++) {
+		if (p->files[i].path)
+			filp = filp_open(p->files[i].path,
+					 O_RDONLY | O_LARGEFILE, 0);
+		else
+			filp = ERR_PTR(-ENOENT);
+		for (; ext < end && ext->file == i; ext++) {
+			if (IS_ERR(filp))
+				continue;
+			force_page_cache_readahead(filp->f_mapping, filp,
+						   ext->start, ext->nr);
+		}
+		if (!IS_ERR(filp))
+			filp_close(filp, NULL);
+		cond_resched();
+	}
+	blk_finish_plug(&plug);
+
+	ra_profile_put(p);
+	kfree(replay);
+}
+
+static int ra_profile_replay(const char *name)
+{
+	struct ra_profile_replay *replay;
+	struct ra_profile *p;
+
+	replay = kmalloc(sizeof(*replay), GFP_KERNEL);
+	if (!replay)
+		return -ENOMEM;
+
+	mutex_lock(&ra_profile_lock);
+	p = ra_profile_lookup(name);
+	if (p) {
+		list_move(&p->list, &ra_profiles);
+		kref_get(&p->ref);
+	}
+	mutex_unlock(&ra_profile_lock);
+
+	if (!p) {
+		kfree(replay);
+		return -ENOENT;
+	}
+
+	INIT_WORK(&replay->work, ra_profile_replay_fn);
+	replay->profile = p;
+	queue_work(system_unbound_wq, &replay->work);
+	return 0;
+}
+
+static ssize_t record_store(struct kobject *kobj, struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	char name[RA_PROFILE_NAME_LEN];
+	int pid, err;
+
+	if (sscanf(buf, "%d %63s", &pid, name) != 2)
+		return -EINVAL;
+
+	err = ra_profile_start(pid, name);
+	return err ? err : count;
+}
+static struct kobj_attribute record_attr = __ATTR_WO(record);
+
+static ssize_t replay_store(struct kobject *kobj, struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	char name[RA_PROFILE_NAME_LEN];
+	int err;
+
+	if (sscanf(buf, "%63s", name) != 1)
+		return -EINVAL;
+
+	err = ra_profile_replay(name);
+	return err ? err : count;
+}
+static struct kobj_attribute replay_attr = __ATTR_WO(replay);
+
+static ssize_t profiles_show(struct kobject *kobj, struct kobj_attribute *attr,
+			     char *buf)
+{
+	struct ra_profile *p;
+	ssize_t len = 0;
+
+	mutex_lock(&ra_profile_lock);
+	list_for_each_entry(p, &ra_profiles, list)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%s files=%u extents=%u pages=%lu\n",
+				 p->name, p->nr_files, p->nr_extents,
+				 p->nr_pages);
+	mutex_unlock(&ra_profile_lock);
+
+	return len;
+}
+static struct kobj_attribute profiles_attr = __ATTR_RO(profiles);
+
+static ssize_t record_ms_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ra_profile_record_ms);
+}
+
+static ssize_t record_ms_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 10, &val) || !val)
+		return -EINVAL;
+
+	ra_profile_record_ms = val;
+	return count;
+}
+static struct kobj_attribute record_ms_attr =
+	__ATTR(record_ms, 0644, record_ms_show, record_ms_store);
+
+static ssize_t max_profiles_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ra_profile_max);
+}
+
+static ssize_t max_profiles_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct ra_profile *old;
+	unsigned int val;
+
+	if (kstrtouint(buf, 10, &val))
+		return -EINVAL;
+
+	mutex_lock(&ra_profile_lock);
+	ra_profile_max = val;
+	while (ra_profile_count > ra_profile_max) {
+		old = list_last_entry(&ra_profiles, struct ra_profile, list);
+		list_del(&old->list);
+		ra_profile_count--;
+		ra_profile_put(old);
+	}
+	mutex_unlock(&ra_profile_lock);
+
+	return count;
+}
+static struct kobj_attribute max_profiles_attr =
+	__ATTR(max_profiles, 0644, max_profiles_show, max_profiles_store);
+
+static struct attribute *ra_profile_attrs[] = {
+	&record_attr.attr,
+	&replay_attr.attr,
+	&profiles_attr.attr,
+	&record_ms_attr.attr,
+	&max_profiles_attr.attr,
+	NULL,
+};
+
+static struct attribute_group ra_profile_attr_group = {
+	.attrs = ra_profile_attrs,
+	.name = "readahead_profile",
+};
+
+static int __init ra_profile_init(void)
+{
+	int i;
+
+	for (i = 0; i < RA_PROFILE_RECORDERS; i++)
+		INIT_DELAYED_WORK(&ra_recorders[i].work,
+				  ra_profile_record_done);
+
+	if (sysfs_create_group(mm_kobj, &ra_profile_attr_group))
+		pr_err("readahead_profile: failed to create sysfs group\n");
+
+	return 0;
+}
+late_initcall(ra_profile_init);
@@ -2198,6 +2198,24 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	c->freelist = NULL;
 }
 
+#ifdef CONFIG_SLUB_CPU_ARRAY
+static void cpu_array_flush(struct kmem_cache *s, void **p, size_t size,
+			    unsigned long addr);
+static void cpu_array_drain(struct kmem_cache *s, int cpu);
+
+static inline bool has_cpu_array(struct kmem_cache *s, int cpu)
+{
+	return s->cpu_array && per_cpu_ptr(s->cpu_array, cpu)->count;
+}
+#else
+static inline void cpu_array_drain(struct kmem_cache *s, int cpu) { }
+
+static inline bool has_cpu_array(struct kmem_cache *s, int cpu)
+{
+	return false;
+}
+#endif
+
 /*
  * Flush cpu slab.
  *
@@ -2207,6 +2225,8 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	cpu_array_drain(s, cpu);
+
 	if (likely(c)) {
 		if (c->page)
 			flush_slab(s, c);
@@ -2227,7 +2247,7 @@ static bool has_cpu_slab(int cpu, void *info)
 	struct kmem_cache *s = info;
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	return c->page || c->partial;
+	return c->page || c->partial || has_cpu_array(s, cpu);
 }
 
 static void flush_all(struct kmem_cache *s)
@@ -2529,6 +2549,102 @@ static void *__slab_alloc(struct kmem_cache *s, gfp_t gfpflags, int node,
 	return p;
 }
 
+#ifdef CONFIG_SLUB_CPU_ARRAY
+/*
+ * Take an object from the cpu array, refilling it in one go from the
+ * lockless freelist of the cpu slab when it is empty. Returns NULL when
+ * both are empty so that the caller takes the regular path to get a new
+ * cpu slab.
+ *
+ * The array never holds objects of pfmemalloc slabs, which are reserved
+ * for allocations allowed to dip into the emergency reserves and are left
+ * to the pfmemalloc_match() checks of the regular path.
+ */
+static __always_inline void *cpu_array_alloc(struct kmem_cache *s, int node)
+{
+	struct kmem_cache_array *a;
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	void *object = NULL;
+
+	if (!s->cpu_array || node != NUMA_NO_NODE)
+		return NULL;
+
+	local_irq_save(flags);
+	a = this_cpu_ptr(s->cpu_array);
+	if (unlikely(!a->count)) {
+		c = this_cpu_ptr(s->cpu_slab);
+		while (c->freelist && a->count < SLUB_CPU_ARRAY_BATCH &&
+		       !PageSlabPfmemalloc(c->page)) {
+			void *p = c->freelist;
+
+			c->freelist = get_freepointer(s, p);
+			a->objects[a->count++] = p;
+		}
+		if (a->count) {
+			/* Same as kmem_cache_alloc_bulk() */
+			c->tid = next_tid(c->tid);
+			stat(s, CPU_ARRAY_REFILL);
+		}
+	}
+	if (likely(a->count)) {
+		object = a->objects[--a->count];
+		stat(s, ALLOC_CPU_ARRAY);
+	}
+	local_irq_restore(flags);
+
+	return object;
+}
+
+/*
+ * Put an object on the cpu array. A full array has its oldest half
+ * flushed back to the slabs, outside of the irq disabled section.
+ */
+static __always_inline bool cpu_array_free(struct kmem_cache *s,
+					   struct page *page, void *object,
+					   unsigned long addr)
+{
+	void *flush[SLUB_CPU_ARRAY_BATCH];
+	struct kmem_cache_array *a;
+	unsigned long flags;
+
+	if (!s->cpu_array || unlikely(PageSlabPfmemalloc(page)))
+		return false;
+
+	local_irq_save(flags);
+	a = this_cpu_ptr(s->cpu_array);
+	if (likely(a->count < SLUB_CPU_ARRAY_SIZE)) {
+		a->objects[a->count++] = object;
+		stat(s, FREE_CPU_ARRAY);
+		local_irq_restore(flags);
+		return true;
+	}
+
+	memcpy(flush, a->objects, sizeof(flush));
+	memmove(a->objects, a->objects + SLUB_CPU_ARRAY_BATCH,
+		(SLUB_CPU_ARRAY_SIZE - SLUB_CPU_ARRAY_BATCH) * sizeof(void *));
+	a->count -= SLUB_CPU_ARRAY_BATCH;
+	a->objects[a->count++] = object;
+	stat(s, FREE_CPU_ARRAY);
+	local_irq_restore(flags);
+
+	cpu_array_flush(s, flush, SLUB_CPU_ARRAY_BATCH, addr);
+	return true;
+}
+#else
+static __always_inline void *cpu_array_alloc(struct kmem_cache *s, int node)
+{
+	return NULL;
+}
+
+static __always_inline bool cpu_array_free(struct kmem_cache *s,
+					   struct page *page, void *object,
+					   unsigned long addr)
+{
+	return false;
+}
+#endif
+
 /*
  * Inlined fastpath so that allocation functions (kmalloc, kmem_cache_alloc)
  * have the fastpath folded into their functions. So no function call
@@ -2550,6 +2666,10 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 	s = slab_pre_alloc_hook(s, gfpflags);
 	if (!s)
 		return NULL;
+
+	object = cpu_array_alloc(s, node);
+	if (object)
+		goto out;
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -2618,6 +2738,7 @@ redo:
 		stat(s, ALLOC_FASTPATH);
 	}
 
+out:
 	if (unlikely(gfpflags & __GFP_ZERO) && object)
 		memset(object, 0, s->object_size);
 
@@ -2872,6 +2993,8 @@ static __always_inline void slab_free(struct kmem_cache *s, struct page *page,
 	 */
 	if (s->flags & SLAB_KASAN && !(s->flags & SLAB_DESTROY_BY_RCU))
 		return;
+	if (!tail && cpu_array_free(s, page, head, addr))
+		return;
 	do_slab_free(s, page, head, tail, cnt, addr);
 }
 
@@ -2968,6 +3091,46 @@ int build_detached_freelist(struct kmem_cache *s, size_t size,
 	return first_skipped_index;
 }
 
+#ifdef CONFIG_SLUB_CPU_ARRAY
+/*
+ * Free objects taken off a cpu array. The free hooks already ran when the
+ * objects were put on the array, so go straight to do_slab_free().
+ */
+static void cpu_array_flush(struct kmem_cache *s, void **p, size_t size,
+			    unsigned long addr)
+{
+	stat(s, CPU_ARRAY_FLUSH);
+
+	while (size) {
+		struct detached_freelist df;
+
+		size = build_detached_freelist(s, size, p, &df);
+		if (unlikely(!df.page))
+			continue;
+
+		do_slab_free(df.s, df.page, df.freelist, df.tail, df.cnt, addr);
+	}
+}
+
+/*
+ * Called with interrupts disabled on the cpu owning the array, or for an
+ * offline cpu.
+ */
+static void cpu_array_drain(struct kmem_cache *s, int cpu)
+{
+	struct kmem_cache_array *a;
+
+	if (!s->cpu_array)
+		return;
+
+	a = per_cpu_ptr(s->cpu_array, cpu);
+	if (a->count) {
+		cpu_array_flush(s, a->objects, a->count, _RET_IP_);
+		a->count = 0;
+	}
+}
+#endif
+
 /* Note that interrupts must be enabled when calling this function. */
 void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
 {
@@ -3263,6 +3426,9 @@ static void free_kmem_cache_nodes(struct kmem_cache *s)
 
 void __kmem_cache_release(struct kmem_cache *s)
 {
+#ifdef CONFIG_SLUB_CPU_ARRAY
+	free_percpu(s->cpu_array);
+#endif
 	free_percpu(s->cpu_slab);
 	free_kmem_cache_nodes(s);
 }
@@ -3423,6 +3589,59 @@ static int calculate_sizes(struct kmem_cache *s, int forced_order)
 	return !!oo_objects(s->oo);
 }
 
+#ifdef CONFIG_SLUB_CPU_ARRAY
+/* Comma separated names of the caches that get a cpu array */
+static char slub_cpu_array_names[128] = "skbuff_head_cache,dentry,filp";
+
+static int __init setup_slub_cpu_array(char *str)
+{
+	strlcpy(slub_cpu_array_names, str, sizeof(slub_cpu_array_names));
+
+	return 1;
+}
+
+__setup("slub_cpu_array=", setup_slub_cpu_array);
+
+static bool cpu_array_wanted(const char *name)
+{
+	const char *p = slub_cpu_array_names;
+	size_t len = strlen(name);
+
+	while (*p) {
+		size_t n = strcspn(p, ",");
+
+		if (n == len && !strncmp(p, name, len))
+			return true;
+		p += n;
+		if (*p)
+			p++;
+	}
+
+	return false;
+}
+
+/*
+ * The array bypasses the debug checks of the slowpath and the KASAN
+ * quarantine, so it is only set up for caches using neither. A failed
+ * allocation just leaves the cache without an array.
+ */
+static void init_cpu_array(struct kmem_cache *s)
+{
+	if (kmem_cache_debug(s) || (s->flags & SLAB_KASAN))
+		return;
+
+	if (cpu_array_wanted(s->name))
+		s->cpu_array = alloc_percpu(struct kmem_cache_array);
+}
+#else
+static inline bool cpu_array_wanted(const char *name)
+{
+	return false;
+}
+
+static inline void init_cpu_array(struct kmem_cache *s) { }
+#endif
+
 static int kmem_cache_open(struct kmem_cache *s, unsigned long flags)
 {
 	s->flags = kmem_cache_flags(s->size, flags, s->name, s->ctor);
@@ -3493,8 +3712,10 @@ static int kmem_cache_open(struct kmem_cache *s, unsigned long flags)
 	if (!init_kmem_cache_nodes(s))
 		goto error;
 
-	if (alloc_kmem_cache_cpus(s))
+	if (alloc_kmem_cache_cpus(s)) {
+		init_cpu_array(s);
 		return 0;
+	}
 
 	free_kmem_cache_nodes(s);
 error:
@@ -4066,6 +4287,10 @@ __kmem_cache_alias(const char *name, size_t size, size_t align,
 {
 	struct kmem_cache *s, *c;
 
+	/* A cpu array is set up when the named cache is opened */
+	if (cpu_array_wanted(name))
+		return NULL;
+
 	s = find_mergeable(size, align, flags, name, ctor);
 	if (s) {
 		s->refcount++;
@@ -5230,6 +5455,10 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(ALLOC_CPU_ARRAY, alloc_cpu_array);
+STAT_ATTR(FREE_CPU_ARRAY, free_cpu_array);
+STAT_ATTR(CPU_ARRAY_REFILL, cpu_array_refill);
+STAT_ATTR(CPU_ARRAY_FLUSH, cpu_array_flush);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -5297,6 +5526,10 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&alloc_cpu_array_attr.attr,
+	&free_cpu_array_attr.attr,
+	&cpu_array_refill_attr.attr,
+	&cpu_array_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
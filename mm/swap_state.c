@@ -282,8 +282,10 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	if (page) {
 		INC_CACHE_INFO(find_success);
-		if (TestClearPageReadahead(page))
+		if (TestClearPageReadahead(page)) {
 			atomic_inc(&swapin_readahead_hits);
+			count_vm_event(SWAP_RA_HIT);
+		}
 	}
 
 	INC_CACHE_INFO(find_total);
@@ -495,8 +497,10 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 						gfp_mask, vma, addr);
 		if (!page)
 			continue;
-		if (offset != entry_offset)
+		if (offset != entry_offset) {
 			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+		}
 		page_cache_release(page);
 	}
 	blk_finish_plug(&plug);
@@ -505,3 +509,116 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 skip:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/*
+ * Fast swap devices (zram) gain nothing from reading neighbouring swap
+ * slots: readahead there only costs decompression. Instead follow the
+ * faulting VMA and prefetch the swap entries of the following virtual
+ * pages, with a window that doubles on every in-order miss and drops to
+ * zero as soon as the fault pattern looks random.
+ *
+ * vma->swap_readahead_info packs the page-aligned address of the last
+ * miss with the window used for it in the low bits.
+ */
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK)
+#define SWAP_RA_WIN_MAX		16
+
+static unsigned int swap_vma_ra_win(struct vm_area_struct *vma,
+				    unsigned long addr)
+{
+	unsigned long info, prev, win, max_win;
+
+	max_win = min(1UL << READ_ONCE(page_cluster), SWAP_RA_WIN_MAX + 1UL);
+	if (max_win <= 1)
+		return 0;
+
+	addr &= PAGE_MASK;
+	info = atomic_long_read(&vma->swap_readahead_info);
+	prev = info & PAGE_MASK;
+	win = info & SWAP_RA_WIN_MASK;
+
+	/*
+	 * With a window of @win pages the next in-order miss lands right
+	 * past the pages read ahead for the previous one.
+	 */
+	if (prev && addr > prev && addr <= prev + ((win + 1) << PAGE_SHIFT))
+		win = win ? min(win * 2, max_win - 1) : 1;
+	else
+		win = 0;
+
+	atomic_long_set(&vma->swap_readahead_info, addr | win);
+
+	return win;
+}
+
+/**
+ * swap_vma_readahead - swap in a faulting page and its VMA neighbours
+ * @fentry: swap entry of the faulting page
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma the faulting address belongs to
+ * @addr: faulting address
+ * @pmd: pmd covering @addr
+ *
+ * Like swapin_readahead(), but for fast swap devices read ahead along the
+ * virtual address space of @vma, as described above. Only the page table
+ * covering @addr is looked at.
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+				struct vm_area_struct *vma, unsigned long addr,
+				pmd_t *pmd)
+{
+	unsigned long start, end, pos;
+	pte_t ptes[SWAP_RA_WIN_MAX], *pte;
+	struct blk_plug plug;
+	struct page *page;
+	swp_entry_t entry;
+	unsigned int win, i, nr;
+
+	if (!is_swap_fast(fentry))
+		return swapin_readahead(fentry, gfp_mask, vma, addr);
+
+	win = swap_vma_ra_win(vma, addr);
+	if (!win || (current->flags & PF_EXITING))
+		goto skip;
+
+	/*
+	 * Stay within the page table of @addr: when @addr is on the last
+	 * page of its pmd, start is already past it and end clamps to it.
+	 */
+	start = (addr & PAGE_MASK) + PAGE_SIZE;
+	end = min(start + ((unsigned long)win << PAGE_SHIFT),
+		  pmd_addr_end(addr, vma->vm_end));
+	if (start >= end)
+		goto skip;
+
+	nr = min_t(unsigned int, (end - start) >> PAGE_SHIFT,
+		   ARRAY_SIZE(ptes));
+
+	/* Racy snapshot: read_swap_cache_async() validates every entry */
+	pte = pte_offset_map(pmd, start);
+	for (i = 0; i < nr; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	blk_start_plug(&plug);
+	for (i = 0, pos = start; i < nr; i++, pos += PAGE_SIZE) {
+		if (!is_swap_pte(ptes[i]))
+			continue;
+		entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		page = read_swap_cache_async(entry, gfp_mask, vma, pos);
+		if (!page)
+			continue;
+		SetPageReadahead(page);
+		count_vm_event(SWAP_RA);
+		page_cache_release(page);
+	}
+	blk_finish_plug(&plug);
+
+	lru_add_drain();
+skip:
+	return read_swap_cache_async(fentry, gfp_mask, vma, addr);
+}
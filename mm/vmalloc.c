@@ -653,6 +653,15 @@ void set_iounmap_nonlazy(void)
 	atomic_set(&vmap_lazy_nr, lazy_max_pages()+1);
 }
 
+/*
+ * The lazily freed areas are scattered over the vmalloc space, and
+ * flushing the span covering all of them degrades into a full TLB flush
+ * on most architectures even when only a few pages were mapped. When
+ * there are few areas and they cover less than half of that span, flush
+ * each of them on its own instead.
+ */
+#define VMAP_PURGE_MAX_RANGES	32
+
 /*
  * Purges all lazily-freed vmap areas.
  */
@@ -661,23 +670,35 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 	struct llist_node *valist;
 	struct vmap_area *va;
 	struct vmap_area *n_va;
-	bool do_free = false;
+	unsigned long span_start = ULONG_MAX, span_end = 0;
+	unsigned long nr_pages = 0;
+	int nr_areas = 0;
 
 	lockdep_assert_held(&vmap_purge_lock);
 
 	valist = llist_del_all(&vmap_purge_list);
 	llist_for_each_entry(va, valist, purge_list) {
-		if (va->va_start < start)
-			start = va->va_start;
-		if (va->va_end > end)
-			end = va->va_end;
-		do_free = true;
+		if (va->va_start < span_start)
+			span_start = va->va_start;
+		if (va->va_end > span_end)
+			span_end = va->va_end;
+		nr_pages += (va->va_end - va->va_start) >> PAGE_SHIFT;
+		nr_areas++;
 	}
 
-	if (!do_free)
+	if (!nr_areas)
 		return false;
 
-	flush_tlb_kernel_range(start, end);
+	if (nr_areas <= VMAP_PURGE_MAX_RANGES &&
+	    ((span_end - span_start) >> PAGE_SHIFT) > 2 * nr_pages) {
+		if (start < end)
+			flush_tlb_kernel_range(start, end);
+		llist_for_each_entry(va, valist, purge_list)
+			flush_tlb_kernel_range(va->va_start, va->va_end);
+	} else {
+		flush_tlb_kernel_range(min(start, span_start),
+				       max(end, span_end));
+	}
 
 	spin_lock(&vmap_area_lock);
 	llist_for_each_entry_safe(va, n_va, valist, purge_list) {
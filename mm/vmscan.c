@@ -46,6 +46,7 @@
 #include <linux/oom.h>
 #include <linux/prefetch.h>
 #include <linux/printk.h>
+#include <linux/simple_lmk.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -147,6 +148,11 @@ struct scan_control {
  * From 0 .. 100.  Higher means more swappy.
  */
 int vm_swappiness = 60;
+/*
+ * Stop trimming only the page cache while it is thrashing, so that hot file
+ * pages aren't evicted ahead of cold anonymous memory.
+ */
+int sysctl_refault_aware_reclaim __read_mostly;
 /*
  * The total number of pages which are beyond the high watermark within all
  * zones.
@@ -2116,6 +2122,23 @@ enum scan_balance {
  * nr[0] = anon inactive pages to scan; nr[1] = anon active pages to scan
  * nr[2] = file inactive pages to scan; nr[3] = file active pages to scan
  */
+/*
+ * A plentiful inactive file list only means the page cache is cheap to
+ * reclaim if it isn't the working set. Evicted file pages that come back
+ * while still within the refault distance are activated by the workingset
+ * code, so any activations since this lruvec was last reclaimed mean that
+ * trimming only the cache would evict pages that are in use.
+ */
+static bool file_is_thrashing(struct lruvec *lruvec)
+{
+	struct zone *zone = lruvec_zone(lruvec);
+
+	if (!sysctl_refault_aware_reclaim)
+		return false;
+
+	return zone_page_state(zone, WORKINGSET_ACTIVATE) != lruvec->refaults;
+}
+
 static void get_scan_count(struct lruvec *lruvec, int swappiness,
 			   struct scan_control *sc, unsigned long *nr,
 			   unsigned long *lru_pages)
@@ -2214,7 +2237,8 @@ static void get_scan_count(struct lruvec *lruvec, int swappiness,
 	 */
 	if (!IS_ENABLED(CONFIG_BALANCE_ANON_FILE_RECLAIM) &&
 			!inactive_file_is_low(lruvec) &&
-			get_lru_size(lruvec, LRU_INACTIVE_FILE) >> sc->priority) {
+			get_lru_size(lruvec, LRU_INACTIVE_FILE) >> sc->priority &&
+			!file_is_thrashing(lruvec)) {
 		scan_balance = SCAN_FILE;
 		goto out;
 	}
@@ -2555,6 +2579,8 @@ static bool shrink_zone(struct zone *zone, struct scan_control *sc,
 
 			shrink_lruvec(lruvec, swappiness, sc, &lru_pages);
 			zone_lru_pages += lru_pages;
+			lruvec->refaults = zone_page_state(zone,
+							   WORKINGSET_ACTIVATE);
 
 			if (memcg && is_classzone)
 				shrink_slab(sc->gfp_mask, zone_to_nid(zone),
@@ -2986,6 +3012,7 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 				gfp_t gfp_mask, nodemask_t *nodemask)
 {
 	unsigned long nr_reclaimed;
+	u64 stall_start;
 	struct scan_control sc = {
 		.nr_to_reclaim = SWAP_CLUSTER_MAX,
 		.gfp_mask = (gfp_mask = memalloc_noio_flags(gfp_mask)),
@@ -3009,7 +3036,9 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 				sc.may_writepage,
 				gfp_mask);
 
+	stall_start = simple_lmk_stall_begin();
 	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
+	simple_lmk_stall_end(stall_start);
 
 	trace_mm_vmscan_direct_reclaim_end(nr_reclaimed);
 
@@ -242,6 +242,27 @@ struct link_free {
 	};
 };
 
+#ifdef CONFIG_ZSMALLOC_PCP_CACHE
+/*
+ * Number of objects a per-CPU magazine can hold for one size class and
+ * the upper bound on the object bytes a CPU may keep across all classes.
+ */
+#define ZS_MAG_SIZE	8
+#define ZS_PCP_BYTES	(64 << 10)
+
+struct zs_magazine {
+	unsigned int count;
+	unsigned long handles[ZS_MAG_SIZE];
+};
+
+struct zs_pcp {
+	/* only contended by zs_pcp_drain() */
+	spinlock_t lock;
+	unsigned long bytes;
+	struct zs_magazine *mags;	/* zs_size_classes entries */
+};
+#endif
+
 struct zs_pool {
 	const char *name;
 
@@ -267,6 +288,9 @@ struct zs_pool {
 	struct inode *inode;
 	struct work_struct free_work;
 #endif
+#ifdef CONFIG_ZSMALLOC_PCP_CACHE
+	struct zs_pcp __percpu *pcp;
+#endif
 };
 
 /*
@@ -284,6 +308,8 @@ struct zspage {
 		unsigned int class:CLASS_BITS;
 		unsigned int isolated:ISOLATED_BITS;
 		unsigned int magic:MAGIC_VAL_BITS;
+		/* sub-pages are physically contiguous, in chain order */
+		unsigned int contig:1;
 	};
 	unsigned int inuse;
 	unsigned int freeobj;
@@ -1114,6 +1140,56 @@ static void create_page_chain(struct size_class *class, struct zspage *zspage,
 	}
 }
 
+#ifdef CONFIG_ZSMALLOC_CONTIG_ZSPAGE
+/*
+ * Opportunistically grab all pages of a zspage as one higher-order block.
+ * Never reclaim or compact for it; individual pages are just as good.
+ */
+static bool alloc_contig_pages(struct size_class *class,
+				struct page *pages[], gfp_t gfp)
+{
+	int nr_pages = class->pages_per_zspage;
+	unsigned int order;
+	struct page *page;
+	int i;
+
+	if (nr_pages == 1)
+		return false;
+
+	order = get_order(nr_pages << PAGE_SHIFT);
+	gfp = (gfp & ~__GFP_DIRECT_RECLAIM) | __GFP_NORETRY | __GFP_NOWARN;
+	page = alloc_pages(gfp, order);
+	if (!page)
+		return false;
+
+	split_page(page, order);
+	for (i = 0; i < (1 << order); i++) {
+		if (i < nr_pages)
+			pages[i] = page + i;
+		else
+			__free_page(page + i);
+	}
+
+	return true;
+}
+
+static inline bool zspage_contig(struct zspage *zspage)
+{
+	return zspage->contig;
+}
+#else
+static bool alloc_contig_pages(struct size_class *class,
+				struct page *pages[], gfp_t gfp)
+{
+	return false;
+}
+
+static inline bool zspage_contig(struct zspage *zspage)
+{
+	return false;
+}
+#endif
+
 /*
  * Allocate a zspage for the given size class
  */
@@ -1132,6 +1208,11 @@ static struct zspage *alloc_zspage(struct zs_pool *pool,
 	zspage->magic = ZSPAGE_MAGIC;
 	migrate_lock_init(zspage);
 
+	if (alloc_contig_pages(class, pages, gfp)) {
+		zspage->contig = 1;
+		goto chain;
+	}
+
 	for (i = 0; i < class->pages_per_zspage; i++) {
 		struct page *page;
 
@@ -1145,6 +1226,7 @@ static struct zspage *alloc_zspage(struct zs_pool *pool,
 		pages[i] = page;
 	}
 
+chain:
 	create_page_chain(class, zspage, pages);
 	init_zspage(class, zspage);
 
@@ -1431,8 +1513,11 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 
 	area = &get_cpu_var(zs_map_area);
 	area->vm_mm = mm;
-	if (off + class->size <= PAGE_SIZE) {
-		/* this object is contained entirely within a page */
+	if (off + class->size <= PAGE_SIZE || zspage_contig(zspage)) {
+		/*
+		 * this object is contained entirely within a page, or its
+		 * second half directly follows it in the linear map
+		 */
 		area->vm_addr = kmap_atomic(page);
 		ret = area->vm_addr + off;
 		goto out;
@@ -1472,7 +1557,7 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 	off = (class->size * obj_idx) & ~PAGE_MASK;
 
 	area = this_cpu_ptr(&zs_map_area);
-	if (off + class->size <= PAGE_SIZE)
+	if (off + class->size <= PAGE_SIZE || zspage_contig(zspage))
 		kunmap_atomic(area->vm_addr);
 	else {
 		struct page *pages[2];
@@ -1550,6 +1635,10 @@ static unsigned long obj_malloc(struct size_class *class,
 	return obj;
 }
 
+static unsigned long zs_pcp_pop(struct zs_pool *pool,
+				struct size_class *class);
+static void zs_pcp_refill(struct zs_pool *pool, struct size_class *class,
+			  gfp_t gfp);
 
 /**
  * zs_malloc - Allocate block of given size from pool.
@@ -1570,14 +1659,18 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
 		return 0;
 
-	handle = cache_alloc_handle(pool, gfp);
-	if (!handle)
-		return 0;
-
 	/* extra space in chunk to keep the handle */
 	size += ZS_HANDLE_SIZE;
 	class = pool->size_class[get_size_class_index(size)];
 
+	handle = zs_pcp_pop(pool, class);
+	if (handle)
+		return handle;
+
+	handle = cache_alloc_handle(pool, gfp);
+	if (!handle)
+		return 0;
+
 	spin_lock(&class->lock);
 	zspage = find_get_zspage(class);
 	if (likely(zspage)) {
@@ -1587,6 +1680,7 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 		record_obj(handle, obj);
 		spin_unlock(&class->lock);
 
+		zs_pcp_refill(pool, class, gfp);
 		return handle;
 	}
 
@@ -1642,7 +1736,7 @@ static void obj_free(struct size_class *class, unsigned long obj)
 	zs_stat_dec(class, OBJ_USED, 1);
 }
 
-void zs_free(struct zs_pool *pool, unsigned long handle)
+static void __zs_free(struct zs_pool *pool, unsigned long handle)
 {
 	struct zspage *zspage;
 	struct page *f_page;
@@ -1653,9 +1747,6 @@ void zs_free(struct zs_pool *pool, unsigned long handle)
 	enum fullness_group fullness;
 	bool isolated;
 
-	if (unlikely(!handle))
-		return;
-
 	pin_tag(handle);
 	obj = handle_to_obj(handle);
 	obj_to_location(obj, &f_page, &f_objidx);
@@ -1685,6 +1776,226 @@ out:
 	unpin_tag(handle);
 	cache_free_handle(pool, handle);
 }
+
+#ifdef CONFIG_ZSMALLOC_PCP_CACHE
+static bool zs_pcp_class_ok(struct size_class *class)
+{
+	/* huge objects would blow the byte budget on their own */
+	return class->objs_per_zspage > 1;
+}
+
+static unsigned long zs_pcp_pop(struct zs_pool *pool,
+				struct size_class *class)
+{
+	struct zs_pcp *pcp;
+	struct zs_magazine *mag;
+	unsigned long handle = 0;
+
+	if (!pool->pcp || !zs_pcp_class_ok(class))
+		return 0;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	mag = &pcp->mags[class->index];
+	if (mag->count) {
+		handle = mag->handles[--mag->count];
+		pcp->bytes -= class->size;
+	}
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+
+	return handle;
+}
+
+static bool zs_pcp_push(struct zs_pool *pool, struct size_class *class,
+			unsigned long handle)
+{
+	struct zs_pcp *pcp;
+	struct zs_magazine *mag;
+	bool ret = false;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	mag = &pcp->mags[class->index];
+	if (mag->count < ZS_MAG_SIZE &&
+	    pcp->bytes + class->size <= ZS_PCP_BYTES) {
+		mag->handles[mag->count++] = handle;
+		pcp->bytes += class->size;
+		ret = true;
+	}
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+
+	return ret;
+}
+
+/*
+ * Top up this CPU's magazine for @class with objects carved from zspages
+ * the class already owns. New zspages are never allocated for the cache,
+ * so it cannot grow the pool by itself.
+ */
+static void zs_pcp_refill(struct zs_pool *pool, struct size_class *class,
+			  gfp_t gfp)
+{
+	unsigned long handles[ZS_MAG_SIZE / 2];
+	struct zspage *zspage;
+	unsigned long obj;
+	int i, nr = 0, used = 0;
+
+	if (!pool->pcp || !zs_pcp_class_ok(class))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(handles); i++) {
+		handles[i] = cache_alloc_handle(pool, gfp | __GFP_NOWARN);
+		if (!handles[i])
+			break;
+		nr++;
+	}
+
+	spin_lock(&class->lock);
+	while (used < nr) {
+		zspage = find_get_zspage(class);
+		if (!zspage)
+			break;
+		obj = obj_malloc(class, zspage, handles[used]);
+		fix_fullness_group(class, zspage);
+		record_obj(handles[used], obj);
+		used++;
+	}
+	spin_unlock(&class->lock);
+
+	for (i = 0; i < used; i++) {
+		if (!zs_pcp_push(pool, class, handles[i]))
+			__zs_free(pool, handles[i]);
+	}
+	for (; i < nr; i++)
+		cache_free_handle(pool, handles[i]);
+}
+
+static bool zs_pcp_free(struct zs_pool *pool, unsigned long handle)
+{
+	struct zspage *zspage;
+	struct page *f_page;
+	unsigned int f_objidx;
+	int class_idx;
+	enum fullness_group fullness;
+	struct size_class *class;
+
+	if (!pool->pcp)
+		return false;
+
+	/* the object cannot move while pinned, nor can its zspage change class */
+	pin_tag(handle);
+	obj_to_location(handle_to_obj(handle), &f_page, &f_objidx);
+	zspage = get_zspage(f_page);
+	get_zspage_mapping(zspage, &class_idx, &fullness);
+	unpin_tag(handle);
+
+	class = pool->size_class[class_idx];
+	if (!zs_pcp_class_ok(class))
+		return false;
+
+	return zs_pcp_push(pool, class, handle);
+}
+
+/* Hand every cached object back to its zspage, e.g. ahead of compaction */
+static void zs_pcp_drain(struct zs_pool *pool)
+{
+	unsigned long handles[ZS_MAG_SIZE];
+	struct zs_magazine *mag;
+	struct zs_pcp *pcp;
+	int cpu, i, j, nr;
+
+	if (!pool->pcp)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(pool->pcp, cpu);
+		if (!pcp->mags)
+			continue;
+
+		for (i = 0; i < zs_size_classes; i++) {
+			spin_lock(&pcp->lock);
+			mag = &pcp->mags[i];
+			nr = mag->count;
+			if (nr) {
+				memcpy(handles, mag->handles,
+				       nr * sizeof(handles[0]));
+				mag->count = 0;
+				pcp->bytes -= nr * pool->size_class[i]->size;
+			}
+			spin_unlock(&pcp->lock);
+
+			for (j = 0; j < nr; j++)
+				__zs_free(pool, handles[j]);
+		}
+	}
+}
+
+static int zs_pcp_create(struct zs_pool *pool)
+{
+	struct zs_pcp *pcp;
+	int cpu;
+
+	pool->pcp = alloc_percpu(struct zs_pcp);
+	if (!pool->pcp)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(pool->pcp, cpu);
+		spin_lock_init(&pcp->lock);
+		pcp->mags = kcalloc(zs_size_classes, sizeof(*pcp->mags),
+				    GFP_KERNEL);
+		if (!pcp->mags)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void zs_pcp_destroy(struct zs_pool *pool)
+{
+	int cpu;
+
+	if (!pool->pcp)
+		return;
+
+	zs_pcp_drain(pool);
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(pool->pcp, cpu)->mags);
+	free_percpu(pool->pcp);
+	pool->pcp = NULL;
+}
+#else
+static unsigned long zs_pcp_pop(struct zs_pool *pool,
+				struct size_class *class)
+{
+	return 0;
+}
+
+static void zs_pcp_refill(struct zs_pool *pool, struct size_class *class,
+			  gfp_t gfp) {}
+
+static bool zs_pcp_free(struct zs_pool *pool, unsigned long handle)
+{
+	return false;
+}
+
+static void zs_pcp_drain(struct zs_pool *pool) {}
+static int zs_pcp_create(struct zs_pool *pool) { return 0; }
+static void zs_pcp_destroy(struct zs_pool *pool) {}
+#endif
+
+void zs_free(struct zs_pool *pool, unsigned long handle)
+{
+	if (unlikely(!handle))
+		return;
+
+	if (zs_pcp_free(pool, handle))
+		return;
+
+	__zs_free(pool, handle);
+}
 EXPORT_SYMBOL_GPL(zs_free);
 
 static void zs_object_copy(struct size_class *class, unsigned long dst,
@@ -1974,6 +2285,8 @@ static void replace_sub_page(struct size_class *class, struct zspage *zspage,
 	} while ((page = get_next_page(page)) != NULL);
 
 	create_page_chain(class, zspage, pages);
+	/* newpage lands wherever the migration target was allocated */
+	zspage->contig = 0;
 	set_first_obj_offset(newpage, get_first_obj_offset(oldpage));
 	if (unlikely(PageHugeObject(oldpage)))
 		newpage->index = oldpage->index;
@@ -2333,6 +2646,9 @@ unsigned long zs_compact(struct zs_pool *pool)
 	int i;
 	struct size_class *class;
 
+	/* cached objects would pin otherwise evacuable zspages */
+	zs_pcp_drain(pool);
+
 	for (i = zs_size_classes - 1; i >= 0; i--) {
 		class = pool->size_class[i];
 		if (!class)
@@ -2517,6 +2833,9 @@ struct zs_pool *zs_create_pool(const char *name)
 		prev_class = class;
 	}
 
+	if (zs_pcp_create(pool))
+		goto err;
+
 	if (zs_pool_stat_create(pool, name))
 		goto err;
 
@@ -2542,6 +2861,7 @@ void zs_destroy_pool(struct zs_pool *pool)
 	int i;
 
 	zs_unregister_shrinker(pool);
+	zs_pcp_destroy(pool);
 	zs_unregister_migration(pool);
 	zs_pool_stat_destroy(pool);
 
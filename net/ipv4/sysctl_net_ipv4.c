@@ -1018,6 +1018,15 @@ static struct ctl_table ipv4_net_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec,
 	},
+	{
+		.procname	= "tcp_mobile_autotune",
+		.data		= &init_net.ipv4.sysctl_tcp_mobile_autotune,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 	{
 		.procname	= "igmp_link_local_mcast_reports",
 		.data		= &sysctl_igmp_llm_reports,
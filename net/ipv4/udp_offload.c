@@ -175,6 +175,66 @@ out_unlock:
 	return segs;
 }
 
+/* Split a UDP_SEGMENT datagram into gso_size sized datagrams, each with its
+ * own UDP header. The checksum field holds the pseudo header sum of the
+ * whole datagram, it is adjusted for the length of every segment.
+ */
+struct sk_buff *__udp_gso_segment(struct sk_buff *gso_skb,
+				  netdev_features_t features)
+{
+	struct sk_buff *segs, *seg;
+	struct udphdr *uh;
+	unsigned int mss;
+	__sum16 check;
+	__be16 newlen;
+
+	mss = skb_shinfo(gso_skb)->gso_size;
+	if (gso_skb->len <= sizeof(*uh) + mss)
+		return ERR_PTR(-EINVAL);
+
+	skb_pull(gso_skb, sizeof(*uh));
+
+	segs = skb_segment(gso_skb, features);
+	if (unlikely(IS_ERR_OR_NULL(segs)))
+		return segs;
+
+	seg = segs;
+	uh = udp_hdr(seg);
+
+	/* compute checksum adjustment based on old length versus new */
+	newlen = htons(sizeof(*uh) + mss);
+	check = csum16_add(csum16_sub(uh->check, uh->len), newlen);
+
+	for (;;) {
+		if (!seg->next)
+			break;
+
+		uh->len = newlen;
+		uh->check = check;
+
+		if (seg->ip_summed != CHECKSUM_PARTIAL)
+			uh->check = gso_make_checksum(seg, ~check) ? :
+				    CSUM_MANGLED_0;
+
+		seg = seg->next;
+		uh = udp_hdr(seg);
+	}
+
+	/* last packet can be partial gso_size, account for that in checksum */
+	newlen = htons(skb_tail_pointer(seg) - skb_transport_header(seg) +
+		       seg->data_len);
+	check = csum16_add(csum16_sub(uh->check, uh->len), newlen);
+
+	uh->len = newlen;
+	uh->check = check;
+
+	if (seg->ip_summed != CHECKSUM_PARTIAL)
+		uh->check = gso_make_checksum(seg, ~check) ? : CSUM_MANGLED_0;
+
+	return segs;
+}
+EXPORT_SYMBOL_GPL(__udp_gso_segment);
+
 static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 					 netdev_features_t features)
 {
@@ -194,6 +254,9 @@ static struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	if (!pskb_may_pull(skb, sizeof(struct udphdr)))
 		goto out;
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4)
+		return __udp_gso_segment(skb, features);
+
 	mss = skb_shinfo(skb)->gso_size;
 	if (unlikely(skb->len <= mss))
 		goto out;
@@ -349,6 +412,72 @@ out:
 	return pp;
 }
 
+#define UDP_GRO_CNT_MAX 64
+
+/* Aggregate datagrams of one flow for a UDP_GRO socket. Only the last
+ * datagram of a GRO packet may be shorter than the others.
+ */
+static struct sk_buff **udp_gro_receive_segment(struct sk_buff **head,
+						struct sk_buff *skb,
+						struct udphdr *uh)
+{
+	unsigned int off = skb_gro_offset(skb);
+	struct sk_buff *p, **pp;
+	struct udphdr *uh2 = NULL;
+
+	/* requires non zero csum, for symmetry with GSO */
+	if (!uh->check)
+		NAPI_GRO_CB(skb)->flush = 1;
+
+	for (pp = head; (p = *pp); pp = &p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+
+		/* Match ports only, as csum is always non zero */
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+		break;
+	}
+
+	skb_gro_pull(skb, sizeof(struct udphdr));
+	skb_gro_postpull_rcsum(skb, uh, sizeof(struct udphdr));
+
+	if (!p)
+		return NULL;
+
+	/* Terminate the flow on len mismatch or if it grows "too much".
+	 * Under small packet flood GRO count could elsewhere grow a lot
+	 * leading to excessive truesize values.
+	 */
+	if (NAPI_GRO_CB(skb)->flush || uh->len > uh2->len ||
+	    skb_gro_receive(pp, skb) || uh->len != uh2->len ||
+	    NAPI_GRO_CB(p)->count >= UDP_GRO_CNT_MAX)
+		return pp;
+
+	return NULL;
+}
+
+/* Does the socket this datagram is delivered to accept GRO packets? */
+static bool udp4_gro_sk_enabled(struct sk_buff *skb, struct udphdr *uh)
+{
+	const struct iphdr *iph = skb_gro_network_header(skb);
+	struct sock *sk;
+	bool enabled;
+
+	sk = udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
+			     iph->daddr, uh->dest, skb->dev->ifindex);
+	if (!sk)
+		return false;
+
+	enabled = udp_sk(sk)->gro_enabled;
+	sock_put(sk);
+	return enabled;
+}
+
 static struct sk_buff **udp4_gro_receive(struct sk_buff **head,
 					 struct sk_buff *skb)
 {
@@ -369,6 +498,9 @@ static struct sk_buff **udp4_gro_receive(struct sk_buff **head,
 					     inet_gro_compute_pseudo);
 skip:
 	NAPI_GRO_CB(skb)->is_ipv6 = 0;
+	if (static_key_false(&udp_gro_needed) &&
+	    !NAPI_GRO_CB(skb)->encap_mark && udp4_gro_sk_enabled(skb, uh))
+		return udp_gro_receive_segment(head, skb, uh);
 	return udp_gro_receive(head, skb, uh);
 
 flush:
@@ -412,11 +544,32 @@ int udp_gro_complete(struct sk_buff *skb, int nhoff)
 	return err;
 }
 
+static int udp_gro_complete_segment(struct sk_buff *skb, struct udphdr *uh)
+{
+	skb->csum_start = (unsigned char *)uh - skb->head;
+	skb->csum_offset = offsetof(struct udphdr, check);
+	skb->ip_summed = CHECKSUM_PARTIAL;
+
+	skb_shinfo(skb)->gso_segs = NAPI_GRO_CB(skb)->count;
+	skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_L4;
+	return 0;
+}
+
 static int udp4_gro_complete(struct sk_buff *skb, int nhoff)
 {
 	const struct iphdr *iph = ip_hdr(skb);
 	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
 
+	/* Tunnel GRO marks the outer header, everything else which got
+	 * aggregated came from udp_gro_receive_segment().
+	 */
+	if (!NAPI_GRO_CB(skb)->encap_mark) {
+		uh->len = htons(skb->len - nhoff);
+		uh->check = ~udp_v4_check(skb->len - nhoff, iph->saddr,
+					  iph->daddr, 0);
+		return udp_gro_complete_segment(skb, uh);
+	}
+
 	if (uh->check) {
 		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL_CSUM;
 		uh->check = ~udp_v4_check(skb->len - nhoff, iph->saddr,
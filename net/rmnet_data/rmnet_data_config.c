@@ -23,8 +23,10 @@
 #include <linux/rmnet_data.h>
 #include <net/rmnet_config.h>
 #include "rmnet_data_config.h"
+#include "rmnet_map.h"
 #include "rmnet_data_handlers.h"
 #include "rmnet_data_vnd.h"
+#include "rmnet_data_steer.h"
 #include "rmnet_data_private.h"
 #include "rmnet_data_trace.h"
 
@@ -720,6 +722,7 @@ int rmnet_unassociate_network_device(struct net_device *dev)
 	if (!config)
 		return RMNET_CONFIG_UNKNOWN_ERROR;
 
+	rmnet_map_aggregate_exit(config->config);
 	kfree(config);
 
 	netdev_rx_handler_unregister(dev);
@@ -852,7 +855,7 @@ int rmnet_associate_network_device(struct net_device *dev)
 
 	config->config = conf;
 	conf->dev = dev;
-	spin_lock_init(&conf->agg_lock);
+	rmnet_map_aggregate_init(conf);
 	config->recycle = kfree_skb;
 
 	rc = netdev_rx_handler_register(dev, rmnet_rx_handler, config);
@@ -1264,6 +1267,7 @@ int rmnet_config_notify_cb(struct notifier_block *nb,
 		trace_rmnet_unregister_cb_entry(dev);
 		LOGH("Kernel is trying to unregister %s", dev->name);
 		rmnet_force_unassociate_device(dev);
+		rmnet_steer_flush_dev(dev);
 		trace_rmnet_unregister_cb_exit(dev);
 		break;
 
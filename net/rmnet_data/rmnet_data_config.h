@@ -18,6 +18,8 @@
 #include <linux/types.h>
 #include <linux/time.h>
 #include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 #include <net/rmnet_config.h>
 
 #ifndef _RMNET_DATA_CONFIG_H_
@@ -40,8 +42,6 @@ struct rmnet_logical_ep_conf_s {
 	uint8_t refcount;
 	uint8_t rmnet_mode;
 	uint8_t mux_id;
-	struct timespec flush_time;
-	unsigned int flush_byte_count;
 	struct net_device *egress_dev;
 };
 
@@ -64,6 +64,11 @@ struct rmnet_logical_ep_conf_s {
  * @tail_spacing: Guaranteed padding (bytes) when de-aggregating ingress frames
  * @agg_time: Wall clock time when aggregated frame was created
  * @agg_last: Last time the aggregation routing was invoked
+ * @agg_timer: Flushes the aggregated frame when it has been open too long
+ * @agg_tasklet: Transmits the aggregated frame on behalf of @agg_timer
+ * @agg_gap_ns: Moving average of the spacing between egress packets
+ * @agg_byte_limit: Adaptive size limit of the aggregated frame, at most
+ *                  @egress_agg_size
  */
 struct rmnet_phys_ep_config {
 	struct net_device *dev;
@@ -86,6 +91,10 @@ struct rmnet_phys_ep_config {
 	uint8_t agg_count;
 	struct timespec agg_time;
 	struct timespec agg_last;
+	struct hrtimer agg_timer;
+	struct tasklet_struct agg_tasklet;
+	uint32_t agg_gap_ns;
+	uint16_t agg_byte_limit;
 };
 
 int rmnet_config_init(void);
@@ -23,11 +23,13 @@
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <net/rmnet_config.h>
+#include <net/busy_poll.h>
 #include "rmnet_data_private.h"
 #include "rmnet_data_config.h"
 #include "rmnet_data_vnd.h"
 #include "rmnet_map.h"
 #include "rmnet_data_stats.h"
+#include "rmnet_data_steer.h"
 #include "rmnet_data_trace.h"
 
 RMNET_LOG_MODULE(RMNET_DATA_LOGMASK_HANDLER);
@@ -67,6 +69,16 @@ unsigned int upper_byte_limit __read_mostly = 10500;
 module_param(upper_byte_limit, uint, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(upper_byte_limit, "Upper byte limit");
 
+/* Dynamic GRO flush state of the NAPI instance running on a CPU */
+struct rmnet_gro_flush_s {
+	struct timespec flush_time;
+	unsigned int byte_count;
+	long time_limit;
+	unsigned int byte_limit;
+};
+
+static DEFINE_PER_CPU(struct rmnet_gro_flush_s, rmnet_gro_flush);
+
 #define RMNET_DATA_IP_VERSION_4 0x40
 #define RMNET_DATA_IP_VERSION_6 0x60
 
@@ -139,8 +151,8 @@ void rmnet_print_packet(const struct sk_buff *skb, const char *dev, char dir)
 	pr_err("[%s][%c] - PKT skb->tail=%pK skb->end=%pK\n",
 	       dev, dir, skb_tail_pointer(skb), skb_end_pointer(skb));
 
-	if (skb->len > 0)
-		len = skb->len;
+	if (skb_headlen(skb) > 0)
+		len = skb_headlen(skb);
 	else
 		len = ((unsigned int)(uintptr_t)skb->end) -
 		      ((unsigned int)(uintptr_t)skb->data);
@@ -247,70 +259,73 @@ static int rmnet_check_skb_can_gro(struct sk_buff *skb)
  *
  * Tuning this parameter will trade TCP slow start performance for GRO coalesce
  * ratio.
+ *
+ * Called from NAPI context. The state is per CPU, as is the NAPI instance
+ * whose GRO list it flushes once steering spreads ingress over several CPUs.
  */
 static void rmnet_optional_gro_flush(struct napi_struct *napi,
-				     struct rmnet_logical_ep_conf_s *ep,
-					 unsigned int skb_size)
+				     unsigned int skb_size)
 {
+	struct rmnet_gro_flush_s *gf = this_cpu_ptr(&rmnet_gro_flush);
+	long flush_time = READ_ONCE(gro_flush_time);
 	struct timespec curr_time, diff;
 
-	if (!gro_flush_time)
+	if (!flush_time)
 		return;
 
-	if (unlikely(ep->flush_time.tv_sec == 0)) {
-		getnstimeofday(&ep->flush_time);
-		ep->flush_byte_count = 0;
+	if (unlikely(gf->flush_time.tv_sec == 0)) {
+		getnstimeofday(&gf->flush_time);
+		gf->byte_count = 0;
+		gf->time_limit = flush_time;
+		gf->byte_limit = READ_ONCE(gro_min_byte_thresh);
 	} else {
 		getnstimeofday(&(curr_time));
-		diff = timespec_sub(curr_time, ep->flush_time);
-		ep->flush_byte_count += skb_size;
+		diff = timespec_sub(curr_time, gf->flush_time);
+		gf->byte_count += skb_size;
 
-		if (dynamic_gro_on) {
+		if (READ_ONCE(dynamic_gro_on)) {
 			if ((!(diff.tv_sec > 0) || diff.tv_nsec <=
-					gro_flush_time) &&
-					ep->flush_byte_count >=
-					gro_min_byte_thresh) {
+					gf->time_limit) &&
+					gf->byte_count >= gf->byte_limit) {
 				/* Processed many bytes in a small time window.
 				 * No longer need to flush so often and we can
 				 * increase our byte limit
 				 */
-				gro_flush_time = upper_flush_time;
-				gro_min_byte_thresh = upper_byte_limit;
+				gf->time_limit = READ_ONCE(upper_flush_time);
+				gf->byte_limit = READ_ONCE(upper_byte_limit);
 			} else if ((diff.tv_sec > 0 ||
-					diff.tv_nsec > gro_flush_time) &&
-					ep->flush_byte_count <
-					gro_min_byte_thresh) {
+					diff.tv_nsec > gf->time_limit) &&
+					gf->byte_count < gf->byte_limit) {
 				/* We have not hit our time limit and we are not
 				 * receive many bytes. Demote ourselves to the
 				 * lowest limits and flush
 				 */
 				napi_gro_flush(napi, false);
-				getnstimeofday(&ep->flush_time);
-				ep->flush_byte_count = 0;
-				gro_flush_time = 10000L;
-				gro_min_byte_thresh = 7500L;
+				getnstimeofday(&gf->flush_time);
+				gf->byte_count = 0;
+				gf->time_limit = flush_time;
+				gf->byte_limit = READ_ONCE(gro_min_byte_thresh);
 			} else if ((diff.tv_sec > 0 ||
-					diff.tv_nsec > gro_flush_time) &&
-					ep->flush_byte_count >=
-					gro_min_byte_thresh) {
+					diff.tv_nsec > gf->time_limit) &&
+					gf->byte_count >= gf->byte_limit) {
 				/* Above byte and time limt, therefore we can
 				 * move/maintain our limits to be the max
 				 * and flush
 				 */
 				napi_gro_flush(napi, false);
-				getnstimeofday(&ep->flush_time);
-				ep->flush_byte_count = 0;
-				gro_flush_time = upper_flush_time;
-				gro_min_byte_thresh = upper_byte_limit;
+				getnstimeofday(&gf->flush_time);
+				gf->byte_count = 0;
+				gf->time_limit = READ_ONCE(upper_flush_time);
+				gf->byte_limit = READ_ONCE(upper_byte_limit);
 			}
 			/* else, below time limit and below
 			 * byte thresh, so change nothing
 			 */
 		} else if (diff.tv_sec > 0 ||
-				diff.tv_nsec >= gro_flush_time) {
+				diff.tv_nsec >= flush_time) {
 			napi_gro_flush(napi, false);
-			getnstimeofday(&ep->flush_time);
-			ep->flush_byte_count = 0;
+			getnstimeofday(&gf->flush_time);
+			gf->byte_count = 0;
 		}
 	}
 }
@@ -350,16 +365,18 @@ static rx_handler_result_t __rmnet_deliver_skb(struct sk_buff *skb,
 		case RX_HANDLER_PASS:
 			skb->pkt_type = PACKET_HOST;
 			rmnet_reset_mac_header(skb);
+			/* Lets busy polling sockets find the physical NAPI */
+			napi = get_current_napi_context();
+			if (napi != NULL)
+				skb_mark_napi_id(skb, napi);
 			if (rmnet_check_skb_can_gro(skb) &&
 			    (skb->dev->features & NETIF_F_GRO)) {
-				napi = get_current_napi_context();
 				if (napi != NULL) {
 					skb_size = skb->len;
 					gro_res = napi_gro_receive(napi, skb);
 					trace_rmnet_gro_downlink(gro_res);
-					rmnet_optional_gro_flush(
-								napi, ep,
-								skb_size);
+					rmnet_optional_gro_flush(napi,
+								 skb_size);
 				} else {
 					WARN_ONCE(1, "current napi is NULL\n");
 					netif_receive_skb(skb);
@@ -417,14 +434,15 @@ static rx_handler_result_t rmnet_ingress_deliver_packet(struct sk_buff *skb,
  * @config:     Physical endpoint configuration for the ingress device
  *
  * Most MAP ingress functions are processed here. Packets are processed
- * individually; aggregated packets should use rmnet_map_ingress_handler()
+ * individually; aggregated packets should use rmnet_map_ingress_handler().
+ * Also called from the flow steering NAPI poll for steered packets.
  *
  * Return:
  *      - RX_HANDLER_CONSUMED if packet is dropped
  *      - result of __rmnet_deliver_skb() for all other cases
  */
-static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
-					   struct rmnet_phys_ep_config *config)
+rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
+					       struct rmnet_phys_ep_config *config)
 {
 	struct rmnet_logical_ep_conf_s *ep;
 	uint8_t mux_id;
@@ -481,7 +499,8 @@ static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 			 ckresult != RMNET_MAP_CHECKSUM_VALIDATION_FAILED &&
 			 ckresult != RMNET_MAP_CHECKSUM_ERR_UNKNOWN_TRANSPORT &&
 			 ckresult != RMNET_MAP_CHECKSUM_VALID_FLAG_NOT_SET &&
-			 ckresult != RMNET_MAP_CHECKSUM_FRAGMENTED_PACKET) {
+			 ckresult != RMNET_MAP_CHECKSUM_FRAGMENTED_PACKET &&
+			 ckresult != RMNET_MAP_CHECKSUM_COMPLETE) {
 			rmnet_kfree_skb(skb,
 				RMNET_STATS_SKBFREE_INGRESS_BAD_MAP_CKSUM);
 			return RX_HANDLER_CONSUMED;
@@ -490,7 +509,10 @@ static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 
 	/* Subtract MAP header */
 	skb_pull(skb, sizeof(struct rmnet_map_header_s));
-	skb_trim(skb, len);
+	if (pskb_trim(skb, len)) {
+		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_DEAGG_MALFORMED);
+		return RX_HANDLER_CONSUMED;
+	}
 	__rmnet_data_set_skb_proto(skb);
 	return __rmnet_deliver_skb(skb, ep);
 }
@@ -518,7 +540,8 @@ static rx_handler_result_t rmnet_map_ingress_handler(struct sk_buff *skb,
 	if (config->ingress_data_format & RMNET_INGRESS_FORMAT_DEAGGREGATION) {
 		trace_rmnet_start_deaggregation(skb);
 		while ((skbn = rmnet_map_deaggregate(skb, config)) != 0) {
-			_rmnet_map_ingress_handler(skbn, config);
+			if (!rmnet_steer_skb(skbn))
+				_rmnet_map_ingress_handler(skbn, config);
 			co++;
 		}
 		trace_rmnet_end_deaggregation(skb, co);
@@ -526,6 +549,8 @@ static rx_handler_result_t rmnet_map_ingress_handler(struct sk_buff *skb,
 		rmnet_stats_deagg_pkts(co);
 		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_MAPINGRESS_AGGBUF);
 		rc = RX_HANDLER_CONSUMED;
+	} else if (rmnet_steer_skb(skb)) {
+		rc = RX_HANDLER_CONSUMED;
 	} else {
 		rc = _rmnet_map_ingress_handler(skb, config);
 	}
@@ -21,5 +21,7 @@ void rmnet_egress_handler(struct sk_buff *skb,
 			  struct rmnet_logical_ep_conf_s *ep);
 
 rx_handler_result_t rmnet_rx_handler(struct sk_buff **pskb);
+rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
+				       struct rmnet_phys_ep_config *config);
 
 #endif /* _RMNET_DATA_HANDLERS_H_ */
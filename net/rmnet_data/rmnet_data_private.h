@@ -42,6 +42,7 @@ extern unsigned int rmnet_data_log_module_mask;
 #define RMNET_DATA_LOGMASK_VND     (1<<2)
 #define RMNET_DATA_LOGMASK_MAPD    (1<<3)
 #define RMNET_DATA_LOGMASK_MAPC    (1<<4)
+#define RMNET_DATA_LOGMASK_STEER   (1<<5)
 
 #define LOGE(fmt, ...) do { if (rmnet_data_log_level & RMNET_LOG_LVL_ERR) \
 			pr_err("[RMNET:ERR] %s(): " fmt "\n", __func__, \
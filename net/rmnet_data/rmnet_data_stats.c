@@ -63,6 +63,14 @@ unsigned long int checksum_ul_stats[RMNET_MAP_CHECKSUM_ENUM_LENGTH];
 module_param_array(checksum_ul_stats, ulong, 0, S_IRUGO);
 MODULE_PARM_DESC(checksum_ul_stats, "Uplink Checksum Statistics");
 
+unsigned long int checksum_dl_proto[RMNET_STATS_CSUM_PROTO_MAX];
+module_param_array(checksum_dl_proto, ulong, 0, S_IRUGO);
+MODULE_PARM_DESC(checksum_dl_proto, "Downlink Checksum Offload per Protocol");
+
+unsigned long int checksum_ul_proto[RMNET_STATS_CSUM_PROTO_MAX];
+module_param_array(checksum_ul_proto, ulong, 0, S_IRUGO);
+MODULE_PARM_DESC(checksum_ul_proto, "Uplink Checksum Offload per Protocol");
+
 void rmnet_kfree_skb(struct sk_buff *skb, unsigned int reason)
 {
 	unsigned long flags;
@@ -148,3 +156,27 @@ void rmnet_stats_ul_checksum(unsigned int rc)
 	checksum_ul_stats[rc]++;
 	spin_unlock_irqrestore(&rmnet_checksum_ul_stats, flags);
 }
+
+void rmnet_stats_dl_checksum_proto(unsigned int proto)
+{
+	unsigned long flags;
+
+	if (proto >= RMNET_STATS_CSUM_PROTO_MAX)
+		proto = RMNET_STATS_CSUM_OTHER;
+
+	spin_lock_irqsave(&rmnet_checksum_dl_stats, flags);
+	checksum_dl_proto[proto]++;
+	spin_unlock_irqrestore(&rmnet_checksum_dl_stats, flags);
+}
+
+void rmnet_stats_ul_checksum_proto(unsigned int proto)
+{
+	unsigned long flags;
+
+	if (proto >= RMNET_STATS_CSUM_PROTO_MAX)
+		proto = RMNET_STATS_CSUM_OTHER;
+
+	spin_lock_irqsave(&rmnet_checksum_ul_stats, flags);
+	checksum_ul_proto[proto]++;
+	spin_unlock_irqrestore(&rmnet_checksum_ul_stats, flags);
+}
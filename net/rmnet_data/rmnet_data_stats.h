@@ -40,6 +40,7 @@ enum rmnet_skb_free_e {
 	RMNET_STATS_SKBFREE_DEAGG_DATA_LEN_0,
 	RMNET_STATS_SKBFREE_INGRESS_BAD_MAP_CKSUM,
 	RMNET_STATS_SKBFREE_MAPC_UNSUPPORTED,
+	RMNET_STATS_SKBFREE_STEER_BACKLOG,
 	RMNET_STATS_SKBFREE_MAX
 };
 
@@ -53,10 +54,23 @@ enum rmnet_queue_xmit_e {
 	RMNET_STATS_QUEUE_XMIT_MAX
 };
 
+enum rmnet_csum_proto_e {
+	RMNET_STATS_CSUM_TCP4,
+	RMNET_STATS_CSUM_UDP4,
+	RMNET_STATS_CSUM_TCP6,
+	RMNET_STATS_CSUM_UDP6,
+	RMNET_STATS_CSUM_FRAG4,
+	RMNET_STATS_CSUM_FRAG6,
+	RMNET_STATS_CSUM_OTHER,
+	RMNET_STATS_CSUM_PROTO_MAX
+};
+
 void rmnet_kfree_skb(struct sk_buff *skb, unsigned int reason);
 void rmnet_stats_queue_xmit(int rc, unsigned int reason);
 void rmnet_stats_deagg_pkts(int aggcount);
 void rmnet_stats_agg_pkts(int aggcount);
 void rmnet_stats_dl_checksum(unsigned int rc);
 void rmnet_stats_ul_checksum(unsigned int rc);
+void rmnet_stats_dl_checksum_proto(unsigned int proto);
+void rmnet_stats_ul_checksum_proto(unsigned int proto);
 #endif /* _RMNET_DATA_STATS_H_ */
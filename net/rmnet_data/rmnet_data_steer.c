@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2013-2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * RMNET Data ingress flow steering
+ *
+ * De-aggregated MAP packets are hashed on mux id and 5-tuple and queued to
+ * one of the CPUs in steer_cpu_mask, where a per-CPU NAPI instance runs the
+ * rest of the MAP ingress path and GRO. All packets of a flow land on the
+ * same CPU queue so ordering within a flow is kept.
+ */
+
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/smp.h>
+#include <linux/jhash.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/net_map.h>
+#include <net/ip.h>
+#include <net/ipv6.h>
+#include "rmnet_data_private.h"
+#include "rmnet_data_config.h"
+#include "rmnet_data_handlers.h"
+#include "rmnet_data_steer.h"
+#include "rmnet_data_stats.h"
+
+RMNET_LOG_MODULE(RMNET_DATA_LOGMASK_STEER);
+
+/* ***************** Module Parameters ************************************** */
+unsigned long steer_cpu_mask __read_mostly;
+module_param(steer_cpu_mask, ulong, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(steer_cpu_mask, "CPUs to spread ingress flows on, 0 = off");
+
+/* ***************** Per-CPU Queues ***************************************** */
+
+struct rmnet_steer_cpu {
+	struct sk_buff_head q;
+	struct napi_struct napi;
+	struct call_single_data csd;
+	unsigned long kicked;
+};
+
+static DEFINE_PER_CPU(struct rmnet_steer_cpu, rmnet_steer_cpus);
+static struct net_device rmnet_steer_dummy_dev;
+
+/**
+ * rmnet_steer_hash() - Hash a MAP data packet on mux id and 5-tuple
+ * @skb: MAP packet, skb->data at the MAP header
+ *
+ * Ports are only used for unfragmented TCP and UDP, everything else is
+ * hashed on addresses alone so that fragments follow their first packet.
+ *
+ * Return:
+ *      - flow hash
+ */
+static u32 rmnet_steer_hash(struct sk_buff *skb)
+{
+	unsigned int off = sizeof(struct rmnet_map_header_s);
+	u32 saddr, daddr, ports = 0;
+	u8 proto, ver, *vp;
+	union {
+		struct iphdr v4;
+		struct ipv6hdr v6;
+	} _iph, *iph;
+	__be32 _ports, *pp;
+
+	vp = skb_header_pointer(skb, off, sizeof(ver), &ver);
+	if (!vp)
+		return 0;
+
+	switch (*vp & RMNET_IP_VER_MASK) {
+	case RMNET_IPV4:
+		iph = skb_header_pointer(skb, off, sizeof(struct iphdr), &_iph);
+		if (!iph)
+			return 0;
+		saddr = (__force u32)iph->v4.saddr;
+		daddr = (__force u32)iph->v4.daddr;
+		proto = iph->v4.protocol;
+		if (ip_is_fragment(&iph->v4))
+			proto = 0;
+		off += iph->v4.ihl * 4;
+		break;
+	case RMNET_IPV6:
+		iph = skb_header_pointer(skb, off, sizeof(struct ipv6hdr),
+					 &_iph);
+		if (!iph)
+			return 0;
+		saddr = ipv6_addr_hash(&iph->v6.saddr);
+		daddr = ipv6_addr_hash(&iph->v6.daddr);
+		proto = iph->v6.nexthdr;
+		off += sizeof(struct ipv6hdr);
+		break;
+	default:
+		return 0;
+	}
+
+	if (proto == IPPROTO_TCP || proto == IPPROTO_UDP) {
+		pp = skb_header_pointer(skb, off, sizeof(_ports), &_ports);
+		if (pp)
+			ports = (__force u32)*pp;
+	}
+
+	return jhash_3words(saddr, daddr, ports, RMNET_MAP_GET_MUX_ID(skb));
+}
+
+/* Pick the online CPU in steer_cpu_mask owning @hash, -1 if none */
+static int rmnet_steer_cpu(u32 hash, unsigned long mask)
+{
+	unsigned int n;
+	int cpu;
+
+	mask &= cpumask_bits(cpu_online_mask)[0];
+	if (!mask)
+		return -1;
+
+	n = reciprocal_scale(hash, hweight_long(mask));
+	for_each_set_bit(cpu, &mask, BITS_PER_LONG)
+		if (!n--)
+			return cpu;
+
+	return -1;
+}
+
+static void rmnet_steer_ipi(void *info)
+{
+	struct rmnet_steer_cpu *sc = info;
+
+	clear_bit(0, &sc->kicked);
+	napi_schedule(&sc->napi);
+}
+
+/**
+ * rmnet_steer_skb() - Queue a MAP data packet to the CPU owning its flow
+ * @skb: MAP packet, skb->data at the MAP header
+ *
+ * The packet is queued even when the owning CPU is the current one, so a
+ * flow never overtakes packets of its own still sitting in the queue.
+ *
+ * Return:
+ *      - 1 if the packet was queued or dropped
+ *      - 0 if steering is off and the caller should process the packet
+ */
+int rmnet_steer_skb(struct sk_buff *skb)
+{
+	unsigned long mask = READ_ONCE(steer_cpu_mask);
+	struct rmnet_steer_cpu *sc;
+	unsigned long flags;
+	int cpu;
+
+	if (!mask || RMNET_MAP_GET_CD_BIT(skb))
+		return 0;
+
+	cpu = rmnet_steer_cpu(rmnet_steer_hash(skb), mask);
+	if (cpu < 0)
+		return 0;
+
+	sc = &per_cpu(rmnet_steer_cpus, cpu);
+
+	spin_lock_irqsave(&sc->q.lock, flags);
+	if (skb_queue_len(&sc->q) >= netdev_max_backlog) {
+		spin_unlock_irqrestore(&sc->q.lock, flags);
+		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_STEER_BACKLOG);
+		return 1;
+	}
+	__skb_queue_tail(&sc->q, skb);
+	spin_unlock_irqrestore(&sc->q.lock, flags);
+
+	if (cpu == smp_processor_id()) {
+		napi_schedule(&sc->napi);
+	} else if (!test_and_set_bit(0, &sc->kicked)) {
+		/* CPU went offline under us; its NAPI can run here instead */
+		if (smp_call_function_single_async(cpu, &sc->csd))
+			rmnet_steer_ipi(sc);
+	}
+
+	return 1;
+}
+
+static int rmnet_steer_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_steer_cpu *sc;
+	struct rmnet_phys_ep_config *config;
+	struct sk_buff *skb;
+	int work = 0;
+
+	sc = container_of(napi, struct rmnet_steer_cpu, napi);
+
+	while (work < budget) {
+		skb = skb_dequeue(&sc->q);
+		if (!skb)
+			break;
+
+		/* The device may have been unassociated since queueing */
+		rcu_read_lock();
+		config = _rmnet_get_phys_ep_config(skb->dev);
+		if (config)
+			_rmnet_map_ingress_handler(skb, config);
+		else
+			kfree_skb(skb);
+		rcu_read_unlock();
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete_done(napi, work);
+		if (!skb_queue_empty(&sc->q))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
+/**
+ * rmnet_steer_flush_dev() - Drop all queued packets received on a device
+ * @dev: Device being unassociated
+ *
+ * Must be called after the rx handler is unregistered so nothing new can be
+ * queued for @dev.
+ */
+void rmnet_steer_flush_dev(struct net_device *dev)
+{
+	struct rmnet_steer_cpu *sc;
+	struct sk_buff *skb, *tmp;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		sc = &per_cpu(rmnet_steer_cpus, cpu);
+
+		spin_lock_irqsave(&sc->q.lock, flags);
+		skb_queue_walk_safe(&sc->q, skb, tmp) {
+			if (skb->dev == dev) {
+				__skb_unlink(skb, &sc->q);
+				kfree_skb(skb);
+			}
+		}
+		spin_unlock_irqrestore(&sc->q.lock, flags);
+	}
+}
+
+/* ***************** Startup/Shutdown *************************************** */
+
+int rmnet_steer_init(void)
+{
+	struct rmnet_steer_cpu *sc;
+	int cpu;
+
+	init_dummy_netdev(&rmnet_steer_dummy_dev);
+
+	for_each_possible_cpu(cpu) {
+		sc = &per_cpu(rmnet_steer_cpus, cpu);
+		skb_queue_head_init(&sc->q);
+		sc->csd.func = rmnet_steer_ipi;
+		sc->csd.info = sc;
+		netif_napi_add(&rmnet_steer_dummy_dev, &sc->napi,
+			       rmnet_steer_poll, NAPI_POLL_WEIGHT);
+		napi_enable(&sc->napi);
+	}
+
+	return 0;
+}
+
+void rmnet_steer_exit(void)
+{
+	struct rmnet_steer_cpu *sc;
+	int cpu;
+
+	steer_cpu_mask = 0;
+	synchronize_net();
+
+	for_each_possible_cpu(cpu) {
+		sc = &per_cpu(rmnet_steer_cpus, cpu);
+		napi_disable(&sc->napi);
+		netif_napi_del(&sc->napi);
+		skb_queue_purge(&sc->q);
+	}
+}
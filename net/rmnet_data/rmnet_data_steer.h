@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2013-2017, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * RMNET Data ingress flow steering
+ *
+ */
+
+#include <linux/types.h>
+
+#ifndef _RMNET_DATA_STEER_H_
+#define _RMNET_DATA_STEER_H_
+
+int rmnet_steer_skb(struct sk_buff *skb);
+void rmnet_steer_flush_dev(struct net_device *dev);
+int rmnet_steer_init(void);
+void rmnet_steer_exit(void);
+
+#endif /* _RMNET_DATA_STEER_H_ */
@@ -62,6 +62,9 @@ struct rmnet_vnd_private_s {
 	rwlock_t flow_map_lock;
 	struct list_head flow_head;
 	struct rmnet_map_flow_mapping_s root_flow;
+
+	/* ingress may run on several CPUs at once when steering */
+	struct pcpu_sw_netstats __percpu *pcpu_stats;
 };
 
 #define RMNET_VND_FC_QUEUED      0
@@ -120,11 +123,18 @@ static void rmnet_vnd_add_qos_header(struct sk_buff *skb,
  */
 int rmnet_vnd_rx_fixup(struct sk_buff *skb, struct net_device *dev)
 {
+	struct rmnet_vnd_private_s *dev_conf;
+	struct pcpu_sw_netstats *stats;
+
 	if (unlikely(!dev || !skb))
 		BUG();
 
-	dev->stats.rx_packets++;
-	dev->stats.rx_bytes += skb->len;
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	stats = this_cpu_ptr(dev_conf->pcpu_stats);
+	u64_stats_update_begin(&stats->syncp);
+	stats->rx_packets++;
+	stats->rx_bytes += skb->len;
+	u64_stats_update_end(&stats->syncp);
 
 	return RX_HANDLER_PASS;
 }
@@ -143,13 +153,17 @@ int rmnet_vnd_rx_fixup(struct sk_buff *skb, struct net_device *dev)
 int rmnet_vnd_tx_fixup(struct sk_buff *skb, struct net_device *dev)
 {
 	struct rmnet_vnd_private_s *dev_conf;
-	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	struct pcpu_sw_netstats *stats;
 
 	if (unlikely(!dev || !skb))
 		BUG();
 
-	dev->stats.tx_packets++;
-	dev->stats.tx_bytes += skb->len;
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	stats = this_cpu_ptr(dev_conf->pcpu_stats);
+	u64_stats_update_begin(&stats->syncp);
+	stats->tx_packets++;
+	stats->tx_bytes += skb->len;
+	u64_stats_update_end(&stats->syncp);
 
 	return RX_HANDLER_PASS;
 }
@@ -183,7 +197,7 @@ static netdev_tx_t rmnet_vnd_start_xmit(struct sk_buff *skb,
 		skb_orphan(skb);
 		rmnet_egress_handler(skb, &dev_conf->local_ep);
 	} else {
-		dev->stats.tx_dropped++;
+		atomic_long_inc(&dev->tx_dropped);
 		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_VND_NO_EGRESS);
 	}
 	return NETDEV_TX_OK;
@@ -462,8 +476,67 @@ static int rmnet_vnd_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd)
 	return rc;
 }
 
+static int rmnet_vnd_init_dev(struct net_device *dev)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	dev_conf->pcpu_stats = netdev_alloc_pcpu_stats(struct pcpu_sw_netstats);
+	if (!dev_conf->pcpu_stats)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void rmnet_vnd_uninit_dev(struct net_device *dev)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	free_percpu(dev_conf->pcpu_stats);
+	dev_conf->pcpu_stats = NULL;
+}
+
+/**
+ * rmnet_vnd_get_stats64() - Statistics NDO callback
+ * @dev:         Virtual network device
+ * @stats:       Zeroed statistics to fill in
+ *
+ * Sums the per-CPU packet and byte counters. Drops are added by the core.
+ */
+static struct rtnl_link_stats64 *rmnet_vnd_get_stats64(struct net_device *dev,
+						struct rtnl_link_stats64 *stats)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+	struct pcpu_sw_netstats *pstats;
+	u64 rx_packets, rx_bytes, tx_packets, tx_bytes;
+	unsigned int start;
+	int cpu;
+
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	for_each_possible_cpu(cpu) {
+		pstats = per_cpu_ptr(dev_conf->pcpu_stats, cpu);
+		do {
+			start = u64_stats_fetch_begin_irq(&pstats->syncp);
+			rx_packets = pstats->rx_packets;
+			rx_bytes = pstats->rx_bytes;
+			tx_packets = pstats->tx_packets;
+			tx_bytes = pstats->tx_bytes;
+		} while (u64_stats_fetch_retry_irq(&pstats->syncp, start));
+
+		stats->rx_packets += rx_packets;
+		stats->rx_bytes += rx_bytes;
+		stats->tx_packets += tx_packets;
+		stats->tx_bytes += tx_bytes;
+	}
+
+	return stats;
+}
+
 static const struct net_device_ops rmnet_data_vnd_ops = {
-	.ndo_init = 0,
+	.ndo_init = rmnet_vnd_init_dev,
+	.ndo_uninit = rmnet_vnd_uninit_dev,
+	.ndo_get_stats64 = rmnet_vnd_get_stats64,
 	.ndo_start_xmit = rmnet_vnd_start_xmit,
 	.ndo_do_ioctl = rmnet_vnd_ioctl,
 	.ndo_change_mtu = rmnet_vnd_change_mtu,
@@ -618,6 +691,8 @@ int rmnet_vnd_create_dev(int id, struct net_device **new_device,
 		dev->hw_features |= NETIF_F_GSO;
 		dev->hw_features |= NETIF_F_GSO_UDP_TUNNEL;
 		dev->hw_features |= NETIF_F_GSO_UDP_TUNNEL_CSUM;
+		/* Pass paged skbs down to the physical device as is */
+		dev->features |= NETIF_F_SG;
 	}
 
 	rc = register_netdevice(dev);
@@ -106,6 +106,7 @@ enum rmnet_map_checksum_errors_e {
 	RMNET_MAP_CHECKSUM_FRAGMENTED_PACKET,
 	RMNET_MAP_CHECKSUM_SKIPPED,
 	RMNET_MAP_CHECKSUM_SW,
+	RMNET_MAP_CHECKSUM_COMPLETE,
 	/* This should always be the last element */
 	RMNET_MAP_CHECKSUM_ENUM_LENGTH
 };
@@ -142,6 +143,8 @@ rx_handler_result_t rmnet_map_command(struct sk_buff *skb,
 				      struct rmnet_phys_ep_config *config);
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_config *config);
+void rmnet_map_aggregate_init(struct rmnet_phys_ep_config *config);
+void rmnet_map_aggregate_exit(struct rmnet_phys_ep_config *config);
 
 int rmnet_map_checksum_downlink_packet(struct sk_buff *skb);
 int rmnet_map_checksum_uplink_packet(struct sk_buff *skb,
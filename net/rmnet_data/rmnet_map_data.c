@@ -21,6 +21,8 @@
 #include <linux/rmnet_data.h>
 #include <linux/spinlock.h>
 #include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 #include <linux/time.h>
 #include <linux/net_map.h>
 #include <linux/ip.h>
@@ -31,6 +33,7 @@
 #include <net/ip.h>
 #include <net/checksum.h>
 #include <net/ip6_checksum.h>
+#include <net/ipv6.h>
 #include <net/rmnet_config.h>
 #include "rmnet_data_config.h"
 #include "rmnet_map.h"
@@ -50,14 +53,20 @@ long agg_bypass_time __read_mostly = 10000000L;
 module_param(agg_bypass_time, long, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(agg_bypass_time, "Skip agg when apart spaced more than this");
 
+long agg_min_time __read_mostly = 100000L;
+module_param(agg_min_time, long, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(agg_min_time, "Minimum time packets sit in the agg buf");
 
-struct agg_work {
-	struct delayed_work work;
-	struct rmnet_phys_ep_config *config;
-};
+/* Floor of the adaptive byte limit, two full sized IP packets */
+#define RMNET_MAP_AGG_MIN_BYTES 3000
 
 #define RMNET_MAP_DEAGGR_SPACING  64
 #define RMNET_MAP_DEAGGR_HEADROOM (RMNET_MAP_DEAGGR_SPACING/2)
+
+/* Bytes copied into the head of a deaggregated skb: MAP, IP and L4 headers
+ * needed by checksum offload and GRO. The rest references the aggregate.
+ */
+#define RMNET_MAP_DEAGGR_COPY_LEN 128
 /******************************************************************************/
 
 /**
@@ -88,6 +97,11 @@ struct rmnet_map_header_s *rmnet_map_add_map_header(struct sk_buff *skb,
 	if (skb_headroom(skb) < sizeof(struct rmnet_map_header_s))
 		return 0;
 
+	/* Padding is appended to the linear data */
+	if (pad != RMNET_MAP_NO_PAD_BYTES && skb_is_nonlinear(skb) &&
+	    skb_linearize(skb))
+		return 0;
+
 	map_datalen = skb->len - hdrlen;
 	map_header = (struct rmnet_map_header_s *)
 			skb_push(skb, sizeof(struct rmnet_map_header_s));
@@ -122,7 +136,11 @@ done:
  * @skb:        Source socket buffer containing multiple MAP frames
  * @config:     Physical endpoint configuration of the ingress device
  *
- * A whole new buffer is allocated for each portion of an aggregated frame.
+ * When the aggregate sits in a page fragment, only the headers of each data
+ * packet are copied; the payload is attached as a fragment of that page, so
+ * GRO can coalesce the packets without another copy. Otherwise (and for MAP
+ * commands) a whole new buffer is allocated for each portion of an
+ * aggregated frame.
  * Caller should keep calling deaggregate() on the source skb until 0 is
  * returned, indicating that there are no more packets to deaggregate. Caller
  * is responsible for freeing the original skb.
@@ -153,14 +171,37 @@ struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
 		return 0;
 	}
 
-	skbn = alloc_skb(packet_len + RMNET_MAP_DEAGGR_SPACING, GFP_ATOMIC);
-	if (!skbn)
-		return 0;
+	if (skb->head_frag && !skb_is_nonlinear(skb) && !maph->cd_bit &&
+	    packet_len > RMNET_MAP_DEAGGR_COPY_LEN) {
+		struct page *page = virt_to_head_page(skb->data);
+		unsigned int offset = skb->data - (unsigned char *)
+				      page_address(page);
+		unsigned int frag_len = packet_len - RMNET_MAP_DEAGGR_COPY_LEN;
+
+		skbn = alloc_skb(RMNET_MAP_DEAGGR_COPY_LEN +
+				 RMNET_MAP_DEAGGR_SPACING, GFP_ATOMIC);
+		if (!skbn)
+			return 0;
+
+		skb_reserve(skbn, RMNET_MAP_DEAGGR_HEADROOM);
+		memcpy(skb_put(skbn, RMNET_MAP_DEAGGR_COPY_LEN), skb->data,
+		       RMNET_MAP_DEAGGR_COPY_LEN);
+		get_page(page);
+		skb_add_rx_frag(skbn, 0, page,
+				offset + RMNET_MAP_DEAGGR_COPY_LEN,
+				frag_len, frag_len);
+	} else {
+		skbn = alloc_skb(packet_len + RMNET_MAP_DEAGGR_SPACING,
+				 GFP_ATOMIC);
+		if (!skbn)
+			return 0;
+
+		skb_reserve(skbn, RMNET_MAP_DEAGGR_HEADROOM);
+		skb_put(skbn, packet_len);
+		memcpy(skbn->data, skb->data, packet_len);
+	}
 
 	skbn->dev = skb->dev;
-	skb_reserve(skbn, RMNET_MAP_DEAGGR_HEADROOM);
-	skb_put(skbn, packet_len);
-	memcpy(skbn->data, skb->data, packet_len);
 	skb_pull(skb, packet_len);
 
 
@@ -174,26 +215,73 @@ struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
 	return skbn;
 }
 
+/**
+ * rmnet_map_agg_flush_ns() - Time the current aggregate may stay open
+ * @config:     Physical endpoint configuration of the egress device
+ *
+ * Twice the average packet spacing: long enough for a busy flow to keep
+ * filling the buffer, short enough that the tail of a burst does not sit
+ * in it. Clamped to [agg_min_time, agg_time_limit].
+ */
+static u64 rmnet_map_agg_flush_ns(struct rmnet_phys_ep_config *config)
+{
+	u64 ns = max_t(u64, (u64)config->agg_gap_ns * 2, agg_min_time);
+
+	return min_t(u64, ns, agg_time_limit);
+}
+
+/* Average the packet spacing over the last ~8 packets */
+static void rmnet_map_agg_update_gap(struct rmnet_phys_ep_config *config,
+				     struct timespec *diff)
+{
+	u64 gap = min_t(u64, timespec_to_ns(diff), agg_bypass_time);
+
+	config->agg_gap_ns = ((u64)config->agg_gap_ns * 7 + gap) >> 3;
+}
+
+/**
+ * rmnet_map_agg_resize() - Adapt the byte limit to how the buffer was sent
+ * @config:     Physical endpoint configuration of the egress device
+ * @filled:     True if the buffer left because the next packet did not fit
+ *
+ * Same idea as BQL: a buffer that keeps filling up means the flow can use
+ * a larger one, a buffer that keeps timing out half empty means packets
+ * were only waiting for nothing. Must be called under agg_lock.
+ */
+static void rmnet_map_agg_resize(struct rmnet_phys_ep_config *config,
+				 bool filled)
+{
+	unsigned int limit = config->agg_byte_limit;
+
+	if (filled)
+		limit += limit >> 2;
+	else
+		limit = max_t(unsigned int, config->agg_skb->len,
+			      limit - (limit >> 2));
+
+	limit = max_t(unsigned int, limit, RMNET_MAP_AGG_MIN_BYTES);
+	config->agg_byte_limit = min_t(unsigned int, limit,
+				       config->egress_agg_size);
+}
+
 /**
  * rmnet_map_flush_packet_queue() - Transmits aggregeted frame on timeout
- * @work:        struct agg_work containing delayed work and skb to flush
+ * @data:        struct rmnet_phys_ep_config of the egress device
  *
- * This function is scheduled to run in a specified number of jiffies after
- * the last frame transmitted by the network stack. When run, the buffer
- * containing aggregated packets is finally transmitted on the underlying link.
+ * This tasklet is scheduled by the aggregation timer once the buffer has
+ * been open for rmnet_map_agg_flush_ns(). When run, the buffer containing
+ * aggregated packets is finally transmitted on the underlying link.
  *
  */
-static void rmnet_map_flush_packet_queue(struct work_struct *work)
+static void rmnet_map_flush_packet_queue(unsigned long data)
 {
-	struct agg_work *real_work;
 	struct rmnet_phys_ep_config *config;
 	unsigned long flags;
 	struct sk_buff *skb;
 	int rc, agg_count = 0;
 
 	skb = 0;
-	real_work = (struct agg_work *)work;
-	config = real_work->config;
+	config = (struct rmnet_phys_ep_config *)data;
 	LOGD("%s", "Entering flush thread");
 	spin_lock_irqsave(&config->agg_lock, flags);
 	if (likely(config->agg_state == RMNET_MAP_TXFER_SCHEDULED)) {
@@ -202,6 +290,7 @@ static void rmnet_map_flush_packet_queue(struct work_struct *work)
 			rmnet_stats_agg_pkts(config->agg_count);
 			if (config->agg_count > 1)
 				LOGL("Agg count: %d", config->agg_count);
+			rmnet_map_agg_resize(config, false);
 			skb = config->agg_skb;
 			agg_count = config->agg_count;
 			config->agg_skb = 0;
@@ -221,7 +310,52 @@ static void rmnet_map_flush_packet_queue(struct work_struct *work)
 		rc = dev_queue_xmit(skb);
 		rmnet_stats_queue_xmit(rc, RMNET_STATS_QUEUE_XMIT_AGG_TIMEOUT);
 	}
-	kfree(work);
+}
+
+/* dev_queue_xmit() cannot be called from hard irq context, defer it */
+static enum hrtimer_restart rmnet_map_agg_timer(struct hrtimer *t)
+{
+	struct rmnet_phys_ep_config *config;
+
+	config = container_of(t, struct rmnet_phys_ep_config, agg_timer);
+	tasklet_schedule(&config->agg_tasklet);
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * rmnet_map_aggregate_init() - Set up aggregation state of an endpoint
+ * @config:     Physical endpoint configuration of the egress device
+ */
+void rmnet_map_aggregate_init(struct rmnet_phys_ep_config *config)
+{
+	spin_lock_init(&config->agg_lock);
+	hrtimer_init(&config->agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	config->agg_timer.function = rmnet_map_agg_timer;
+	tasklet_init(&config->agg_tasklet, rmnet_map_flush_packet_queue,
+		     (unsigned long)config);
+}
+
+/**
+ * rmnet_map_aggregate_exit() - Stop aggregation on an endpoint
+ * @config:     Physical endpoint configuration of the egress device
+ *
+ * Drops any partially filled buffer, nothing can be sent on the device at
+ * this point anyway.
+ */
+void rmnet_map_aggregate_exit(struct rmnet_phys_ep_config *config)
+{
+	unsigned long flags;
+
+	hrtimer_cancel(&config->agg_timer);
+	tasklet_kill(&config->agg_tasklet);
+
+	spin_lock_irqsave(&config->agg_lock, flags);
+	if (config->agg_skb)
+		dev_kfree_skb_any(config->agg_skb);
+	config->agg_skb = 0;
+	config->agg_count = 0;
+	config->agg_state = RMNET_MAP_AGG_IDLE;
+	spin_unlock_irqrestore(&config->agg_lock, flags);
 }
 
 /**
@@ -232,15 +366,19 @@ static void rmnet_map_flush_packet_queue(struct work_struct *work)
  * Aggregates multiple SKBs into a single large SKB for transmission. MAP
  * protocol is used to separate the packets in the buffer. This funcion consumes
  * the argument SKB and should not be further processed by any other function.
+ *
+ * The buffer is sent once the next packet would exceed an adaptive byte
+ * limit, once egress_agg_count packets are in it, or after the adaptive
+ * flush time, whichever comes first.
  */
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_config *config) {
 	uint8_t *dest_buff;
-	struct agg_work *work;
 	unsigned long flags;
 	struct sk_buff *agg_skb;
 	struct timespec diff, last;
 	int size, rc, agg_count = 0;
+	bool filled;
 
 
 	if (!skb || !config)
@@ -257,14 +395,18 @@ new_packet:
 
 	memcpy(&last, &(config->agg_last), sizeof(struct timespec));
 	getnstimeofday(&(config->agg_last));
+	diff = timespec_sub(config->agg_last, last);
+
+	if (!config->agg_byte_limit ||
+	    config->agg_byte_limit > config->egress_agg_size)
+		config->agg_byte_limit = config->egress_agg_size;
 
 	if (!config->agg_skb) {
 		/* Check to see if we should agg first. If the traffic is very
-		 * sparse, don't aggregate. We will need to tune this later
+		 * sparse, don't aggregate.
 		 */
-		diff = timespec_sub(config->agg_last, last);
-
 		if ((diff.tv_sec > 0) || (diff.tv_nsec > agg_bypass_time)) {
+			config->agg_gap_ns = agg_bypass_time;
 			spin_unlock_irqrestore(&config->agg_lock, flags);
 			LOGL("delta t: %ld.%09lu\tcount: bypass", diff.tv_sec,
 			     diff.tv_nsec);
@@ -275,6 +417,7 @@ new_packet:
 					       RMNET_STATS_QUEUE_XMIT_AGG_SKIP);
 			return;
 		}
+		rmnet_map_agg_update_gap(config, &diff);
 
 		config->agg_skb = skb_copy_expand(skb, 0, size, GFP_ATOMIC);
 		if (!config->agg_skb) {
@@ -295,17 +438,24 @@ new_packet:
 		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_AGG_CPY_EXPAND);
 		goto schedule;
 	}
+	rmnet_map_agg_update_gap(config, &diff);
 	diff = timespec_sub(config->agg_last, config->agg_time);
 
-	if (skb->len > (config->egress_agg_size - config->agg_skb->len)
-	    || (config->agg_count >= config->egress_agg_count)
-	    ||  (diff.tv_sec > 0) || (diff.tv_nsec > agg_time_limit)) {
+	filled = skb->len > (config->agg_byte_limit - config->agg_skb->len);
+	if (filled || (config->agg_count >= config->egress_agg_count)
+	    || (timespec_to_ns(&diff) > rmnet_map_agg_flush_ns(config))) {
 		rmnet_stats_agg_pkts(config->agg_count);
+		if (filled)
+			rmnet_map_agg_resize(config, true);
 		agg_skb = config->agg_skb;
 		agg_count = config->agg_count;
 		config->agg_skb = 0;
 		config->agg_count = 0;
 		memset(&(config->agg_time), 0, sizeof(struct timespec));
+		/* The next buffer gets a timer of its own */
+		if (config->agg_state == RMNET_MAP_TXFER_SCHEDULED &&
+		    hrtimer_try_to_cancel(&config->agg_timer) == 1)
+			config->agg_state = RMNET_MAP_AGG_IDLE;
 		spin_unlock_irqrestore(&config->agg_lock, flags);
 		LOGL("delta t: %ld.%09lu\tcount: %d", diff.tv_sec,
 		     diff.tv_nsec, agg_count);
@@ -317,25 +467,16 @@ new_packet:
 	}
 
 	dest_buff = skb_put(config->agg_skb, skb->len);
-	memcpy(dest_buff, skb->data, skb->len);
+	skb_copy_bits(skb, 0, dest_buff, skb->len);
 	config->agg_count++;
 	rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_AGG_INTO_BUFF);
 
 schedule:
 	if (config->agg_state != RMNET_MAP_TXFER_SCHEDULED) {
-		work = kmalloc(sizeof(*work), GFP_ATOMIC);
-		if (!work) {
-			LOGE("Failed to allocate work item for packet %s",
-			     "transfer. DATA PATH LIKELY BROKEN!");
-			config->agg_state = RMNET_MAP_AGG_IDLE;
-			spin_unlock_irqrestore(&config->agg_lock, flags);
-			return;
-		}
-		INIT_DELAYED_WORK((struct delayed_work *)work,
-				  rmnet_map_flush_packet_queue);
-		work->config = config;
 		config->agg_state = RMNET_MAP_TXFER_SCHEDULED;
-		schedule_delayed_work((struct delayed_work *)work, 1);
+		hrtimer_start(&config->agg_timer,
+			      ns_to_ktime(rmnet_map_agg_flush_ns(config)),
+			      HRTIMER_MODE_REL);
 	}
 	spin_unlock_irqrestore(&config->agg_lock, flags);
 	return;
@@ -468,10 +609,12 @@ static int rmnet_map_validate_ipv4_packet_checksum(unsigned char *map_payload,
 	~ntohs(cksum_trailer->checksum_value), ntohs(*checksum_field),
 	pseudo_checksum, checksum_value_final);
 
-	if (checksum_value_final == ntohs(*checksum_field))
-		return RMNET_MAP_CHECKSUM_OK;
-	else
+	if (checksum_value_final != ntohs(*checksum_field))
 		return RMNET_MAP_CHECKSUM_VALIDATION_FAILED;
+
+	rmnet_stats_dl_checksum_proto(ip4h->protocol == IPPROTO_TCP ?
+		RMNET_STATS_CSUM_TCP4 : RMNET_STATS_CSUM_UDP4);
+	return RMNET_MAP_CHECKSUM_OK;
 }
 
 /**
@@ -493,14 +636,18 @@ static int rmnet_map_validate_ipv4_packet_checksum(unsigned char *map_payload,
  * 5. Compares the value from step 4 to the checksum value from the TCP/UDP
  *    header
  *
- * Fragmentation, extension headers and tunneling are not supported.
+ * Hop-by-hop, routing and destination options headers are skipped, and
+ * step 2 covers them as part of the IPv6 header. Fragments and tunneling
+ * are not supported.
  *
  * Return: 0 is validation succeeded.
  */
 static int rmnet_map_validate_ipv6_packet_checksum(unsigned char *map_payload,
+	unsigned int hdr_limit,
 	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer)
 {
 	struct ipv6hdr *ip6h;
+	struct ipv6_opt_hdr *opth;
 	uint16_t *checksum_field;
 	void *txporthdr;
 	uint16_t pseudo_checksum;
@@ -510,12 +657,32 @@ static int rmnet_map_validate_ipv6_packet_checksum(unsigned char *map_payload,
 	uint16_t ip_pseudo_payload_checksum;
 	uint16_t checksum_value_final;
 	uint32_t length;
+	unsigned int off;
+	uint8_t nexthdr;
 
 	ip6h = (struct ipv6hdr *) map_payload;
+	nexthdr = ip6h->nexthdr;
+	off = sizeof(struct ipv6hdr);
+
+	while (ipv6_ext_hdr(nexthdr) && nexthdr != NEXTHDR_NONE) {
+		if (nexthdr == NEXTHDR_FRAGMENT)
+			return RMNET_MAP_CHECKSUM_FRAGMENTED_PACKET;
+		if (nexthdr == NEXTHDR_AUTH || nexthdr == NEXTHDR_ESP)
+			return RMNET_MAP_CHECKSUM_ERR_UNKNOWN_TRANSPORT;
+		if (off + sizeof(*opth) > hdr_limit)
+			return RMNET_MAP_CHECKSUM_ERR_UNKNOWN_TRANSPORT;
+
+		opth = (struct ipv6_opt_hdr *)(map_payload + off);
+		nexthdr = opth->nexthdr;
+		off += ipv6_optlen(opth);
+	}
 
-	txporthdr = map_payload + sizeof(struct ipv6hdr);
-	checksum_field = rmnet_map_get_checksum_field(ip6h->nexthdr,
-		txporthdr);
+	if (off + (nexthdr == IPPROTO_UDP ? sizeof(struct udphdr) :
+		   sizeof(struct tcphdr)) > hdr_limit)
+		return RMNET_MAP_CHECKSUM_ERR_UNKNOWN_TRANSPORT;
+
+	txporthdr = map_payload + off;
+	checksum_field = rmnet_map_get_checksum_field(nexthdr, txporthdr);
 
 	if (unlikely(!checksum_field))
 		return RMNET_MAP_CHECKSUM_ERR_UNKNOWN_TRANSPORT;
@@ -526,11 +693,11 @@ static int rmnet_map_validate_ipv6_packet_checksum(unsigned char *map_payload,
 	ip_payload_checksum = rmnet_map_subtract_checksums(checksum_value,
 		ip_hdr_checksum);
 
-	length = (ip6h->nexthdr == IPPROTO_UDP) ?
+	length = (nexthdr == IPPROTO_UDP) ?
 		ntohs(((struct udphdr *)txporthdr)->len) :
-		ntohs(ip6h->payload_len);
+		ntohs(ip6h->payload_len) - (off - sizeof(struct ipv6hdr));
 	pseudo_checksum = ~ntohs(csum_ipv6_magic(&ip6h->saddr, &ip6h->daddr,
-		length, ip6h->nexthdr, 0));
+		length, nexthdr, 0));
 	ip_pseudo_payload_checksum = rmnet_map_add_checksums(
 		ip_payload_checksum, pseudo_checksum);
 
@@ -538,7 +705,7 @@ static int rmnet_map_validate_ipv6_packet_checksum(unsigned char *map_payload,
 		ip_pseudo_payload_checksum, ntohs(*checksum_field));
 
 	if (unlikely(checksum_value_final == 0)) {
-		switch (ip6h->nexthdr) {
+		switch (nexthdr) {
 		case IPPROTO_UDP:
 			/* RFC 2460 section 8.1 */
 			LOGD("DL6 One's complement rule for UDP checksum 0");
@@ -560,11 +727,33 @@ static int rmnet_map_validate_ipv6_packet_checksum(unsigned char *map_payload,
 	~ntohs(cksum_trailer->checksum_value), ntohs(*checksum_field),
 	pseudo_checksum, checksum_value_final);
 
-	if (checksum_value_final == ntohs(*checksum_field))
-		return RMNET_MAP_CHECKSUM_OK;
-	else
+	if (checksum_value_final != ntohs(*checksum_field))
 		return RMNET_MAP_CHECKSUM_VALIDATION_FAILED;
-	}
+
+	rmnet_stats_dl_checksum_proto(nexthdr == IPPROTO_TCP ?
+		RMNET_STATS_CSUM_TCP6 : RMNET_STATS_CSUM_UDP6);
+	return RMNET_MAP_CHECKSUM_OK;
+}
+
+/**
+ * rmnet_map_dl_checksum_complete() - Hand the hardware checksum to the stack
+ * @skb:		Pointer to the packet's skb.
+ * @cksum_trailer:	Pointer to the checksum trailer
+ *
+ * For packets which cannot be validated here, e.g. fragments, the trailer
+ * still holds the 1's complement sum over the whole IP packet. Passing it
+ * as CHECKSUM_COMPLETE lets reassembly and the transport protocol verify
+ * the checksum without walking the payload again.
+ *
+ * Return: RMNET_MAP_CHECKSUM_COMPLETE
+ */
+static int rmnet_map_dl_checksum_complete(struct sk_buff *skb,
+	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer)
+{
+	skb->csum = (__force __wsum)(uint16_t)~cksum_trailer->checksum_value;
+	skb->ip_summed = CHECKSUM_COMPLETE;
+	return RMNET_MAP_CHECKSUM_COMPLETE;
+}
 
 /**
  * rmnet_map_checksum_downlink_packet() - Validates checksum on
@@ -575,25 +764,27 @@ static int rmnet_map_validate_ipv6_packet_checksum(unsigned char *map_payload,
  * the beginning of a buffer which contains the entire MAP
  * frame: MAP header + IP payload + padding + checksum trailer.
  * Currently, only IPv4 and IPv6 are supported along with
- * TCP & UDP. Fragmented or tunneled packets are not supported.
+ * TCP & UDP, across IPv6 extension headers. Fragments and other transports
+ * are not validated here; their trailer checksum is passed to the stack as
+ * CHECKSUM_COMPLETE instead.
  *
  * Return:
  *   - RMNET_MAP_CHECKSUM_OK: Validation of checksum succeeded.
  *   - RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER: Skb buffer given is corrupted.
  *   - RMNET_MAP_CHECKSUM_VALID_FLAG_NOT_SET: Valid flag is not set in the
  *					      checksum trailer.
- *   - RMNET_MAP_CHECKSUM_FRAGMENTED_PACKET: The packet is a fragment.
- *   - RMNET_MAP_CHECKSUM_ERR_UNKNOWN_TRANSPORT: The transport header is
- *						   not TCP/UDP.
+ *   - RMNET_MAP_CHECKSUM_COMPLETE: The packet is a fragment or not TCP/UDP,
+ *				    skb->csum holds the hardware checksum.
  *   - RMNET_MAP_CHECKSUM_ERR_UNKNOWN_IP_VERSION: Unrecognized IP header.
  *   - RMNET_MAP_CHECKSUM_VALIDATION_FAILED: In case the validation failed.
  */
 int rmnet_map_checksum_downlink_packet(struct sk_buff *skb)
 {
-	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer;
-	unsigned int data_len;
+	struct rmnet_map_dl_checksum_trailer_s *cksum_trailer, trailer;
+	unsigned int data_len, hdr_limit;
 	unsigned char *map_payload;
 	unsigned char ip_version;
+	int rc, frag_proto;
 
 	data_len = RMNET_MAP_GET_LENGTH(skb);
 
@@ -601,25 +792,45 @@ int rmnet_map_checksum_downlink_packet(struct sk_buff *skb)
 	    sizeof(struct rmnet_map_dl_checksum_trailer_s))))
 		return RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER;
 
-	cksum_trailer = (struct rmnet_map_dl_checksum_trailer_s *)
-			(skb->data + data_len
-			+ sizeof(struct rmnet_map_header_s));
+	/* the trailer may be in a page fragment, see rmnet_map_deaggregate() */
+	cksum_trailer = skb_header_pointer(skb,
+			data_len + sizeof(struct rmnet_map_header_s),
+			sizeof(trailer), &trailer);
 
 	if (unlikely(!ntohs(cksum_trailer->valid)))
 		return RMNET_MAP_CHECKSUM_VALID_FLAG_NOT_SET;
 
 	map_payload = (unsigned char *)(skb->data
 		+ sizeof(struct rmnet_map_header_s));
+	hdr_limit = skb_headlen(skb) - sizeof(struct rmnet_map_header_s);
 
 	ip_version = (*map_payload & 0xF0) >> 4;
-	if (ip_version == 0x04)
-		return rmnet_map_validate_ipv4_packet_checksum(map_payload,
-			cksum_trailer);
-	else if (ip_version == 0x06)
-		return rmnet_map_validate_ipv6_packet_checksum(map_payload,
+	if (ip_version == 0x04) {
+		if (unlikely(hdr_limit < sizeof(struct iphdr)))
+			return RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER;
+		rc = rmnet_map_validate_ipv4_packet_checksum(map_payload,
 			cksum_trailer);
+		frag_proto = RMNET_STATS_CSUM_FRAG4;
+	} else if (ip_version == 0x06) {
+		if (unlikely(hdr_limit < sizeof(struct ipv6hdr)))
+			return RMNET_MAP_CHECKSUM_ERR_BAD_BUFFER;
+		rc = rmnet_map_validate_ipv6_packet_checksum(map_payload,
+			hdr_limit, cksum_trailer);
+		frag_proto = RMNET_STATS_CSUM_FRAG6;
+	} else {
+		return RMNET_MAP_CHECKSUM_ERR_UNKNOWN_IP_VERSION;
+	}
 
-	return RMNET_MAP_CHECKSUM_ERR_UNKNOWN_IP_VERSION;
+	switch (rc) {
+	case RMNET_MAP_CHECKSUM_FRAGMENTED_PACKET:
+		rmnet_stats_dl_checksum_proto(frag_proto);
+		return rmnet_map_dl_checksum_complete(skb, cksum_trailer);
+	case RMNET_MAP_CHECKSUM_ERR_UNKNOWN_TRANSPORT:
+		rmnet_stats_dl_checksum_proto(RMNET_STATS_CSUM_OTHER);
+		return rmnet_map_dl_checksum_complete(skb, cksum_trailer);
+	default:
+		return rc;
+	}
 }
 
 static void rmnet_map_fill_ipv4_packet_ul_checksum_header(void *iphdr,
@@ -658,35 +869,16 @@ static void rmnet_map_fill_ipv6_packet_ul_checksum_header(void *iphdr,
 	skb->ip_summed = CHECKSUM_NONE;
 }
 
-static void rmnet_map_complement_ipv4_txporthdr_csum_field(void *iphdr)
-{
-	struct iphdr *ip4h = (struct iphdr *)iphdr;
-	void *txporthdr;
-	uint16_t *csum;
-
-	txporthdr = iphdr + ip4h->ihl*4;
-
-	if ((ip4h->protocol == IPPROTO_TCP) ||
-	    (ip4h->protocol == IPPROTO_UDP)) {
-		csum = (uint16_t *)rmnet_map_get_checksum_field(ip4h->protocol,
-								txporthdr);
-		*csum = ~(*csum);
-	}
-}
-
-static void rmnet_map_complement_ipv6_txporthdr_csum_field(void *ip6hdr)
+/*
+ * MAPv4 wants the pseudo header checksum complemented in the transport header.
+ * The field is found through csum_start so extension headers are covered.
+ */
+static void rmnet_map_complement_txporthdr_csum_field(struct sk_buff *skb)
 {
-	struct ipv6hdr *ip6h = (struct ipv6hdr *)ip6hdr;
-	void *txporthdr;
 	uint16_t *csum;
 
-	txporthdr = ip6hdr + sizeof(struct ipv6hdr);
-
-	if ((ip6h->nexthdr == IPPROTO_TCP) || (ip6h->nexthdr == IPPROTO_UDP)) {
-		csum = (uint16_t *)rmnet_map_get_checksum_field(ip6h->nexthdr,
-								txporthdr);
-		*csum = ~(*csum);
-	}
+	csum = (uint16_t *)(skb_checksum_start(skb) + skb->csum_offset);
+	*csum = ~(*csum);
 }
 
 /**
@@ -724,20 +916,23 @@ int rmnet_map_checksum_uplink_packet(struct sk_buff *skb,
 			sizeof(struct rmnet_map_ul_checksum_header_s);
 		ip_version = (*(char *)iphdr & 0xF0) >> 4;
 		if (ip_version == 0x04) {
-			rmnet_map_fill_ipv4_packet_ul_checksum_header(iphdr,
-				ul_header, skb);
 			if (egress_data_format &
 			    RMNET_EGRESS_FORMAT_MAP_CKSUMV4)
-				rmnet_map_complement_ipv4_txporthdr_csum_field(
-					iphdr);
+				rmnet_map_complement_txporthdr_csum_field(skb);
+			rmnet_map_fill_ipv4_packet_ul_checksum_header(iphdr,
+				ul_header, skb);
+			rmnet_stats_ul_checksum_proto(ul_header->udp_ip4_ind ?
+				RMNET_STATS_CSUM_UDP4 : RMNET_STATS_CSUM_TCP4);
 			return RMNET_MAP_CHECKSUM_OK;
 		} else if (ip_version == 0x06) {
-			rmnet_map_fill_ipv6_packet_ul_checksum_header(iphdr,
-				ul_header, skb);
 			if (egress_data_format &
 			    RMNET_EGRESS_FORMAT_MAP_CKSUMV4)
-				rmnet_map_complement_ipv6_txporthdr_csum_field(
-					iphdr);
+				rmnet_map_complement_txporthdr_csum_field(skb);
+			rmnet_map_fill_ipv6_packet_ul_checksum_header(iphdr,
+				ul_header, skb);
+			rmnet_stats_ul_checksum_proto(skb->csum_offset ==
+				offsetof(struct udphdr, check) ?
+				RMNET_STATS_CSUM_UDP6 : RMNET_STATS_CSUM_TCP6);
 			return RMNET_MAP_CHECKSUM_OK;
 		} else {
 			ret = RMNET_MAP_CHECKSUM_ERR_UNKNOWN_IP_VERSION;
@@ -21,6 +21,9 @@
  * cache eviction are simple, linear and based on last usage timestamp, i.e
  * the node that will be evicted is the one with the oldest timestamp.
  * Empty entries always have the oldest timestamp.
+ * The timestamp is a use counter rather than jiffies, so that entries used
+ * within the same tick are still ordered and a hot key is never evicted in
+ * favour of a colder one.
  */
 
 #include <linux/module.h>
@@ -29,7 +32,7 @@
 #include <crypto/ice.h>
 #include <linux/errno.h>
 #include <linux/string.h>
-#include <linux/jiffies.h>
+#include <linux/jhash.h>
 #include <linux/slab.h>
 #include <linux/printk.h>
 #include <linux/sched.h>
@@ -58,6 +61,8 @@ static DEFINE_SPINLOCK(kc_lock);
 static unsigned long flags;
 static bool kc_ready;
 static char *s_type = "sdcc";
+/* Last usage timestamp handed out, protected by kc_lock */
+static u64 kc_lru_clock;
 
 /**
  * enum pfk_kc_entry_state - state of the entry inside kc table
@@ -93,6 +98,7 @@ enum pfk_kc_entry_state {
 struct kc_entry {
 	 unsigned char key[PFK_MAX_KEY_SIZE];
 	 size_t key_size;
+	 u32 key_hash;
 
 	 unsigned char salt[PFK_MAX_SALT_SIZE];
 	 size_t salt_size;
@@ -233,7 +239,7 @@ static inline struct kc_entry *kc_min_entry(struct kc_entry *a,
 	if (!a)
 		return b;
 
-	if (time_before64(b->time_stamp, a->time_stamp))
+	if (b->time_stamp < a->time_stamp)
 		return b;
 
 	return a;
@@ -268,11 +274,19 @@ static struct kc_entry *kc_find_key_at_index(const unsigned char *key,
 	int *starting_index)
 {
 	struct kc_entry *entry = NULL;
+	u32 key_hash = jhash(key, key_size, 0);
 	int i = 0;
 
 	for (i = *starting_index; i < PFK_KC_TABLE_SIZE; i++) {
 		entry = kc_entry_at_index(i);
 
+		/* the hash rules out most entries without touching the keys */
+		if (entry->key_size != key_size || entry->key_hash != key_hash)
+			continue;
+
+		if (0 != memcmp(entry->key, key, key_size))
+			continue;
+
 		if (NULL != salt) {
 			if (entry->salt_size != salt_size)
 				continue;
@@ -281,13 +295,8 @@ static struct kc_entry *kc_find_key_at_index(const unsigned char *key,
 				continue;
 		}
 
-		if (entry->key_size != key_size)
-			continue;
-
-		if (0 == memcmp(entry->key, key, key_size)) {
-			*starting_index = i;
-			return entry;
-		}
+		*starting_index = i;
+		return entry;
 	}
 
 	return NULL;
@@ -350,7 +359,7 @@ static void kc_update_timestamp(struct kc_entry *entry)
 	if (!entry)
 		return;
 
-	entry->time_stamp = get_jiffies_64();
+	entry->time_stamp = ++kc_lru_clock;
 }
 
 /**
@@ -369,6 +378,7 @@ static void kc_clear_entry(struct kc_entry *entry)
 	memset(entry->salt, 0, entry->salt_size);
 
 	entry->key_size = 0;
+	entry->key_hash = 0;
 	entry->salt_size = 0;
 
 	entry->time_stamp = 0;
@@ -398,6 +408,7 @@ static int kc_update_entry(struct kc_entry *entry, const unsigned char *key,
 
 	memcpy(entry->key, key, key_size);
 	entry->key_size = key_size;
+	entry->key_hash = jhash(key, key_size, 0);
 
 	memcpy(entry->salt, salt, salt_size);
 	entry->salt_size = salt_size;